@@ -311,6 +311,9 @@ class DlgImportVector(QDialog, Ui_Dialog):
             if self.chkSinglePart.isEnabled() and self.chkSinglePart.isChecked():
                 options['forceSinglePartGeometryType'] = True
 
+            # the spatial index is created below, if requested
+            options['spatialIndex'] = False
+
             outCrs = None
             if self.chkTargetSrid.isEnabled() and self.chkTargetSrid.isChecked():
                 targetSrid = int(self.editTargetSrid.text())
@@ -13,6 +13,7 @@
  *                                                                         *
  ***************************************************************************/
 #include "qgsstatisticalsummarydockwidget.h"
+#include "qgsaggregatecalculator.h"
 #include "qgsstatisticalsummary.h"
 #include "qgsmaplayerregistry.h"
 #include "qgisapp.h"
@@ -114,16 +115,7 @@ void QgsStatisticalSummaryDockWidget::refreshStatistics()
   }
 
   QString sourceFieldExp = mFieldExpressionWidget->currentField();
-
-  bool ok;
   bool selectedOnly = mSelectedOnlyCheckBox->isChecked();
-  int missingValues = 0;
-  QList< double > values = mLayer->getDoubleValues( sourceFieldExp, ok, selectedOnly, &missingValues );
-
-  if ( ! ok )
-  {
-    return;
-  }
 
   QList< QgsStatisticalSummary::Statistic > statsToDisplay;
   QgsStatisticalSummary::Statistics statsToCalc = 0;
@@ -136,14 +128,79 @@ void QgsStatisticalSummaryDockWidget::refreshStatistics()
     }
   }
 
+  bool showMissing = mStatsActions.value( MISSING_VALUES )->isChecked();
+
+  // values of the statistics by statistic, MISSING_VALUES for the count of NULL values
+  QMap< int, double > results;
+
+  // the provider or a single pass calculates the statistics which have an aggregate,
+  // the others need all values of the layer
+  QList< QgsAggregateCalculator::Aggregate > aggregates;
+  QList< int > aggregateStats;
+  aggregates << QgsAggregateCalculator::Count;
+  aggregateStats << QgsStatisticalSummary::Count;
+  if ( showMissing )
+  {
+    aggregates << QgsAggregateCalculator::CountMissing;
+    aggregateStats << MISSING_VALUES;
+  }
+
+  bool useAggregates = !selectedOnly || mLayer->selectedFeatureCount() > 0;
+  Q_FOREACH ( QgsStatisticalSummary::Statistic stat, statsToDisplay )
+  {
+    QgsAggregateCalculator::Aggregate aggregate;
+    if ( !statisticAggregate( stat, aggregate ) )
+    {
+      useAggregates = false;
+      break;
+    }
+    aggregates << aggregate;
+    aggregateStats << stat;
+  }
+
+  bool ok = false;
+  if ( useAggregates )
+  {
+    QgsAggregateCalculator calculator( mLayer );
+    if ( selectedOnly )
+      calculator.setFidsFilter( mLayer->selectedFeaturesIds() );
+
+    QList< QVariant > values = calculator.calculate( aggregates, sourceFieldExp, &ok );
+    for ( int i = 0; ok && i < values.count(); ++i )
+    {
+      results.insert( aggregateStats.at( i ), values.at( i ).toDouble() );
+    }
+  }
+
+  if ( !ok )
+  {
+    int missingValues = 0;
+    QList< double > values = mLayer->getDoubleValues( sourceFieldExp, ok, selectedOnly, &missingValues );
+
+    if ( ! ok )
+    {
+      return;
+    }
+
+    QgsStatisticalSummary stats;
+    stats.setStatistics( statsToCalc );
+    stats.calculate( values );
+
+    results.insert( QgsStatisticalSummary::Count, stats.count() );
+    results.insert( MISSING_VALUES, missingValues );
+    Q_FOREACH ( QgsStatisticalSummary::Statistic stat, statsToDisplay )
+    {
+      results.insert( stat, stats.statistic( stat ) );
+    }
+  }
+
+  int count = results.value( QgsStatisticalSummary::Count );
+  int missingValues = results.value( MISSING_VALUES );
+
   int extraRows = 0;
-  if ( mStatsActions.value( MISSING_VALUES )->isChecked() )
+  if ( showMissing )
     extraRows++;
 
-  QgsStatisticalSummary stats;
-  stats.setStatistics( statsToCalc );
-  stats.calculate( values );
-
   mStatisticsTable->setRowCount( statsToDisplay.count() + extraRows );
   mStatisticsTable->setColumnCount( 2 );
 
@@ -156,9 +213,9 @@ void QgsStatisticalSummaryDockWidget::refreshStatistics()
     mStatisticsTable->setItem( row, 0, nameItem );
 
     QTableWidgetItem* valueItem = new QTableWidgetItem();
-    if ( stats.count() != 0 )
+    if ( count != 0 )
     {
-      valueItem->setText( QString::number( stats.statistic( stat ) ) );
+      valueItem->setText( QString::number( results.value( stat ) ) );
     }
     valueItem->setToolTip( valueItem->text() );
     valueItem->setFlags( Qt::ItemIsSelectable | Qt::ItemIsEnabled );
@@ -167,7 +224,7 @@ void QgsStatisticalSummaryDockWidget::refreshStatistics()
     row++;
   }
 
-  if ( mStatsActions.value( MISSING_VALUES )->isChecked() )
+  if ( showMissing )
   {
     QTableWidgetItem* nameItem = new QTableWidgetItem( tr( "Missing (null) values" ) );
     nameItem->setToolTip( nameItem->text() );
@@ -175,7 +232,7 @@ void QgsStatisticalSummaryDockWidget::refreshStatistics()
     mStatisticsTable->setItem( row, 0, nameItem );
 
     QTableWidgetItem* valueItem = new QTableWidgetItem();
-    if ( stats.count() != 0 || missingValues != 0 )
+    if ( count != 0 || missingValues != 0 )
     {
       valueItem->setText( QString::number( missingValues ) );
     }
@@ -186,6 +243,46 @@ void QgsStatisticalSummaryDockWidget::refreshStatistics()
   }
 }
 
+bool QgsStatisticalSummaryDockWidget::statisticAggregate( QgsStatisticalSummary::Statistic statistic, QgsAggregateCalculator::Aggregate& aggregate )
+{
+  switch ( statistic )
+  {
+    case QgsStatisticalSummary::Count:
+      aggregate = QgsAggregateCalculator::Count;
+      return true;
+    case QgsStatisticalSummary::Sum:
+      aggregate = QgsAggregateCalculator::Sum;
+      return true;
+    case QgsStatisticalSummary::Mean:
+      aggregate = QgsAggregateCalculator::Mean;
+      return true;
+    case QgsStatisticalSummary::Median:
+      aggregate = QgsAggregateCalculator::Median;
+      return true;
+    case QgsStatisticalSummary::StDev:
+      aggregate = QgsAggregateCalculator::StDev;
+      return true;
+    case QgsStatisticalSummary::StDevSample:
+      aggregate = QgsAggregateCalculator::StDevSample;
+      return true;
+    case QgsStatisticalSummary::Min:
+      aggregate = QgsAggregateCalculator::Min;
+      return true;
+    case QgsStatisticalSummary::Max:
+      aggregate = QgsAggregateCalculator::Max;
+      return true;
+    case QgsStatisticalSummary::Range:
+      aggregate = QgsAggregateCalculator::Range;
+      return true;
+    case QgsStatisticalSummary::Variety:
+      aggregate = QgsAggregateCalculator::CountDistinct;
+      return true;
+    default:
+      // the quartiles are Tukey's hinges and minority and majority need the counts of all values
+      return false;
+  }
+}
+
 void QgsStatisticalSummaryDockWidget::layerChanged( QgsMapLayer *layer )
 {
   QgsVectorLayer* newLayer = dynamic_cast< QgsVectorLayer* >( layer );
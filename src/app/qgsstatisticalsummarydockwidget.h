@@ -19,6 +19,7 @@
 #include <QMap>
 #include "ui_qgsstatisticalsummarybase.h"
 
+#include "qgsaggregatecalculator.h"
 #include "qgsstatisticalsummary.h"
 
 class QgsBrowserModel;
@@ -62,6 +63,9 @@ class APP_EXPORT QgsStatisticalSummaryDockWidget : public QDockWidget, private U
 
     QMap< int, QAction* > mStatsActions;
     static QList< QgsStatisticalSummary::Statistic > mDisplayStats;
+
+    //! Returns the aggregate which calculates a statistic, false if there is none
+    static bool statisticAggregate( QgsStatisticalSummary::Statistic statistic, QgsAggregateCalculator::Aggregate& aggregate );
 };
 
 #endif // QGSSTATISTICALSUMMARYDOCKWIDGET_H
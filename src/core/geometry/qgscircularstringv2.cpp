@@ -588,23 +588,8 @@ void QgsCircularStringV2::draw( QPainter& p ) const
 
 void QgsCircularStringV2::transform( const QgsCoordinateTransform& ct, QgsCoordinateTransform::TransformDirection d )
 {
-  double* zArray = mZ.data();
-
-  bool hasZ = is3D();
-  int nPoints = numPoints();
-  if ( !hasZ )
-  {
-    zArray = new double[nPoints];
-    for ( int i = 0; i < nPoints; ++i )
-    {
-      zArray[i] = 0;
-    }
-  }
-  ct.transformCoords( nPoints, mX.data(), mY.data(), zArray, d );
-  if ( !hasZ )
-  {
-    delete[] zArray;
-  }
+  double* zArray = is3D() ? mZ.data() : 0;
+  ct.transformStridedCoords( numPoints(), mX.data(), mY.data(), zArray, 1, d );
 }
 
 void QgsCircularStringV2::transform( const QTransform& t )
@@ -0,0 +1,318 @@
+/***************************************************************************
+                              qgstwkbreader.cpp
+                              -----------------
+  begin                : October 2015
+  copyright            : (C) 2015 by the QGIS project
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgstwkbreader.h"
+#include "qgswkbtypes.h"
+
+#include <QtEndian>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+  // TWKB geometry types
+  enum
+  {
+    TwkbPoint = 1,
+    TwkbLineString,
+    TwkbPolygon,
+    TwkbMultiPoint,
+    TwkbMultiLineString,
+    TwkbMultiPolygon,
+    TwkbGeometryCollection
+  };
+
+  class TwkbDecoder
+  {
+    public:
+      TwkbDecoder( const unsigned char* twkb, int size, QByteArray& buffer )
+          : mP( twkb )
+          , mEnd( twkb + size )
+          , mBuffer( buffer )
+          , mPos( 0 )
+          , mOk( true )
+          , mDims( 2 )
+      {
+      }
+
+      int decode()
+      {
+        readGeometry();
+        return mOk ? mPos : -1;
+      }
+
+    private:
+      const unsigned char* mP;
+      const unsigned char* mEnd;
+      QByteArray& mBuffer;
+      int mPos;
+      bool mOk;
+
+      // state of the geometry being decoded
+      int mDims;
+      double mFactor[4];
+      qint64 mLast[4];
+
+      quint64 readVarInt()
+      {
+        quint64 value = 0;
+        int shift = 0;
+        while ( mP < mEnd && shift < 64 )
+        {
+          unsigned char b = *mP++;
+          value |= ( quint64 )( b & 0x7f ) << shift;
+          if ( !( b & 0x80 ) )
+            return value;
+          shift += 7;
+        }
+
+        mOk = false;
+        return 0;
+      }
+
+      qint64 readSignedVarInt()
+      {
+        quint64 value = readVarInt();
+        return ( qint64 )( value >> 1 ) ^ -( qint64 )( value & 1 );
+      }
+
+      //! Reads a count and checks that the remaining data can hold at least minBytes per element
+      quint32 readCount( int minBytes )
+      {
+        quint64 count = readVarInt();
+        if ( count * minBytes > ( quint64 )( mEnd - mP ) )
+        {
+          mOk = false;
+          return 0;
+        }
+        return count;
+      }
+
+      void write( const void* data, int size )
+      {
+        if ( mPos + size > mBuffer.size() )
+          mBuffer.resize( qMax( mPos + size, 2 * mBuffer.size() ) );
+        memcpy( mBuffer.data() + mPos, data, size );
+        mPos += size;
+      }
+
+      void writeUInt( quint32 value )
+      {
+        unsigned char data[4];
+        qToLittleEndian( value, data );
+        write( data, sizeof( data ) );
+      }
+
+      void writeDouble( double value )
+      {
+        quint64 bits;
+        memcpy( &bits, &value, sizeof( bits ) );
+        unsigned char data[8];
+        qToLittleEndian( bits, data );
+        write( data, sizeof( data ) );
+      }
+
+      void writeHeader( QgsWKBTypes::Type type )
+      {
+        char byteOrder = 1;
+        write( &byteOrder, 1 );
+        writeUInt( type );
+      }
+
+      void readPoint()
+      {
+        for ( int i = 0; i < mDims; ++i )
+        {
+          mLast[i] += readSignedVarInt();
+          writeDouble( mLast[i] / mFactor[i] );
+        }
+      }
+
+      void readLineString()
+      {
+        quint32 nPoints = readCount( mDims );
+        writeUInt( nPoints );
+        for ( quint32 i = 0; i < nPoints && mOk; ++i )
+          readPoint();
+      }
+
+      void readPolygon()
+      {
+        quint32 nRings = readCount( 1 );
+        writeUInt( nRings );
+        for ( quint32 i = 0; i < nRings && mOk; ++i )
+          readLineString();
+      }
+
+      void readGeometry()
+      {
+        if ( mEnd - mP < 2 )
+        {
+          mOk = false;
+          return;
+        }
+
+        // type and precision (zig-zag encoded), then the metadata flags
+        unsigned char typeAndPrecision = *mP++;
+        unsigned char metadata = *mP++;
+        int twkbType = typeAndPrecision & 0x0f;
+        int precisionBits = typeAndPrecision >> 4;
+        int precision = ( precisionBits >> 1 ) ^ -( precisionBits & 1 );
+
+        bool hasBBox = metadata & 0x01;
+        bool hasSize = metadata & 0x02;
+        bool hasIdList = metadata & 0x04;
+        bool hasExtendedPrecision = metadata & 0x08;
+        bool isEmpty = metadata & 0x10;
+
+        bool hasZ = false;
+        bool hasM = false;
+        int precisionZ = 0;
+        int precisionM = 0;
+        if ( hasExtendedPrecision )
+        {
+          if ( mP >= mEnd )
+          {
+            mOk = false;
+            return;
+          }
+          unsigned char ext = *mP++;
+          hasZ = ext & 0x01;
+          hasM = ext & 0x02;
+          precisionZ = ( ext >> 2 ) & 0x07;
+          precisionM = ( ext >> 5 ) & 0x07;
+        }
+
+        mDims = 2 + ( hasZ ? 1 : 0 ) + ( hasM ? 1 : 0 );
+        mFactor[0] = mFactor[1] = std::pow( 10.0, precision );
+        int dim = 2;
+        if ( hasZ )
+          mFactor[dim++] = std::pow( 10.0, precisionZ );
+        if ( hasM )
+          mFactor[dim++] = std::pow( 10.0, precisionM );
+        for ( int i = 0; i < 4; ++i )
+          mLast[i] = 0;
+
+        if ( hasSize )
+          readVarInt();
+
+        if ( hasBBox && !isEmpty )
+        {
+          for ( int i = 0; i < 2 * mDims; ++i )
+            readVarInt();
+        }
+
+        if ( twkbType < TwkbPoint || twkbType > TwkbGeometryCollection )
+        {
+          mOk = false;
+          return;
+        }
+
+        // TWKB and WKB share the numbering of the simple feature types
+        QgsWKBTypes::Type type = ( QgsWKBTypes::Type ) twkbType;
+        if ( hasZ )
+          type = QgsWKBTypes::addZ( type );
+        if ( hasM )
+          type = QgsWKBTypes::addM( type );
+
+        writeHeader( type );
+
+        if ( isEmpty )
+        {
+          if ( twkbType == TwkbPoint )
+          {
+            // empty points have NaN coordinates in WKB
+            for ( int i = 0; i < mDims; ++i )
+              writeDouble( std::numeric_limits<double>::quiet_NaN() );
+          }
+          else
+          {
+            writeUInt( 0 );
+          }
+          return;
+        }
+
+        switch ( twkbType )
+        {
+          case TwkbPoint:
+            readPoint();
+            break;
+
+          case TwkbLineString:
+            readLineString();
+            break;
+
+          case TwkbPolygon:
+            readPolygon();
+            break;
+
+          case TwkbMultiPoint:
+          case TwkbMultiLineString:
+          case TwkbMultiPolygon:
+          {
+            quint32 nParts = readCount( 1 );
+            if ( hasIdList )
+            {
+              for ( quint32 i = 0; i < nParts; ++i )
+                readVarInt();
+            }
+
+            // the parts continue the delta encoding of the previous part
+            QgsWKBTypes::Type partType = QgsWKBTypes::singleType( type );
+            writeUInt( nParts );
+            for ( quint32 i = 0; i < nParts && mOk; ++i )
+            {
+              writeHeader( partType );
+              if ( twkbType == TwkbMultiPoint )
+                readPoint();
+              else if ( twkbType == TwkbMultiLineString )
+                readLineString();
+              else
+                readPolygon();
+            }
+            break;
+          }
+
+          case TwkbGeometryCollection:
+          {
+            quint32 nParts = readCount( 2 );
+            if ( hasIdList )
+            {
+              for ( quint32 i = 0; i < nParts; ++i )
+                readVarInt();
+            }
+
+            // each member is a complete TWKB geometry
+            writeUInt( nParts );
+            for ( quint32 i = 0; i < nParts && mOk; ++i )
+              readGeometry();
+            break;
+          }
+        }
+      }
+  };
+}
+
+int QgsTwkbReader::toWkb( const unsigned char* twkb, int size, QByteArray& buffer )
+{
+  if ( !twkb || size <= 0 )
+    return -1;
+
+  TwkbDecoder decoder( twkb, size, buffer );
+  return decoder.decode();
+}
@@ -0,0 +1,47 @@
+/***************************************************************************
+                              qgstwkbreader.h
+                              ---------------
+  begin                : October 2015
+  copyright            : (C) 2015 by the QGIS project
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSTWKBREADER_H
+#define QGSTWKBREADER_H
+
+#include <QByteArray>
+
+/** \ingroup core
+ * Decodes Tiny WKB (TWKB), the compact geometry format of PostGIS (ST_AsTWKB).
+ *
+ * TWKB stores coordinates as integers quantized to a given number of decimal
+ * digits, delta encoded against the previous coordinate and written as
+ * variable length integers. Geometries at screen resolution typically need
+ * only one to three bytes per ordinate instead of eight.
+ *
+ * @note added in 2.12
+ * @note not available in python bindings
+ */
+class CORE_EXPORT QgsTwkbReader
+{
+  public:
+    /** Converts a TWKB geometry to little endian WKB with QgsWKBTypes geometry types.
+     * The WKB is written to the start of buffer, which is grown if it is too small
+     * but never shrunk, so that it can be reused for the next geometry.
+     * @param twkb TWKB geometry
+     * @param size size of the TWKB geometry
+     * @param buffer receives the WKB
+     * @returns size of the WKB or -1 if the TWKB is malformed or of an unsupported type
+     */
+    static int toWkb( const unsigned char* twkb, int size, QByteArray& buffer );
+};
+
+#endif // QGSTWKBREADER_H
@@ -0,0 +1,463 @@
+/***************************************************************************
+  qgsaggregatecalculator.cpp
+  --------------------------
+  begin                : October 2015
+  copyright            : (C) 2015 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgsaggregatecalculator.h"
+#include "qgsexpression.h"
+#include "qgsexpressioncontext.h"
+#include "qgsfeatureiterator.h"
+#include "qgsvectordataprovider.h"
+#include "qgsvectorlayer.h"
+#include "qgslogger.h"
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+
+#include <algorithm>
+#include <qmath.h>
+
+namespace
+{
+  //! Key which tells distinct values apart, NULL gets a null string
+  QString distinctKey( const QVariant& value )
+  {
+    return value.isNull() ? QString() : QString( "v" ) + value.toString();
+  }
+
+  //! Linear interpolation between the closest ranks, like percentile_cont in SQL
+  QVariant percentile( const QList<double>& sorted, double fraction )
+  {
+    if ( sorted.isEmpty() )
+      return QVariant( QVariant::Double );
+
+    double position = qBound( 0.0, fraction, 1.0 ) * ( sorted.size() - 1 );
+    int lower = ( int ) qFloor( position );
+    int upper = qMin( lower + 1, sorted.size() - 1 );
+    return sorted.at( lower ) + ( position - lower ) * ( sorted.at( upper ) - sorted.at( lower ) );
+  }
+
+  bool groupLessThan( const QgsAggregateCalculator::GroupResult& a, const QgsAggregateCalculator::GroupResult& b )
+  {
+    if ( a.group.isNull() || b.group.isNull() )
+      return a.group.isNull() && !b.group.isNull();
+    return qgsVariantLessThan( a.group, b.group );
+  }
+
+  /** Accumulates the values of one group. Only what the requested aggregates need is kept. */
+  class Accumulator
+  {
+    public:
+      Accumulator( bool keepDistinct, bool keepNumbers, bool keepStrings )
+          : mCount( 0 )
+          , mMissing( 0 )
+          , mNumericCount( 0 )
+          , mSum( 0 )
+          , mMean( 0 )
+          , mM2( 0 )
+          , mNumbersSorted( true )
+          , mKeepDistinct( keepDistinct )
+          , mKeepNumbers( keepNumbers )
+          , mKeepStrings( keepStrings )
+      {}
+
+      //! Adds a value, returns false if a number was needed but the value cannot be converted
+      bool add( const QVariant& value, bool numeric )
+      {
+        if ( value.isNull() )
+        {
+          mMissing++;
+          return true;
+        }
+
+        mCount++;
+        if ( mMin.isNull() || qgsVariantLessThan( value, mMin ) )
+          mMin = value;
+        if ( mMax.isNull() || qgsVariantLessThan( mMax, value ) )
+          mMax = value;
+
+        if ( mKeepDistinct )
+          mDistinct.insert( distinctKey( value ) );
+        if ( mKeepStrings )
+          mStrings << value.toString();
+
+        if ( !numeric )
+          return true;
+
+        bool ok;
+        double number = value.toDouble( &ok );
+        if ( !ok )
+          return false;
+
+        // Welford's update keeps the variance accurate in a single pass
+        mNumericCount++;
+        mSum += number;
+        double delta = number - mMean;
+        mMean += delta / mNumericCount;
+        mM2 += delta * ( number - mMean );
+
+        if ( mKeepNumbers )
+        {
+          mNumbers << number;
+          mNumbersSorted = false;
+        }
+        return true;
+      }
+
+      QVariant result( QgsAggregateCalculator::Aggregate aggregate, const QgsAggregateCalculator::AggregateParameters& parameters )
+      {
+        switch ( aggregate )
+        {
+          case QgsAggregateCalculator::Count:
+            return QVariant( mCount );
+          case QgsAggregateCalculator::CountDistinct:
+            return QVariant(( qlonglong ) mDistinct.size() );
+          case QgsAggregateCalculator::CountMissing:
+            return QVariant( mMissing );
+          case QgsAggregateCalculator::Min:
+            return mMin;
+          case QgsAggregateCalculator::Max:
+            return mMax;
+          case QgsAggregateCalculator::StringConcatenate:
+            return mCount > 0 ? QVariant( mStrings.join( parameters.delimiter ) ) : QVariant( QVariant::String );
+          default:
+            break;
+        }
+
+        if ( mNumericCount == 0 )
+          return QVariant( QVariant::Double );
+
+        switch ( aggregate )
+        {
+          case QgsAggregateCalculator::Sum:
+            return mSum;
+          case QgsAggregateCalculator::Mean:
+            return mMean;
+          case QgsAggregateCalculator::StDev:
+            return qSqrt( mM2 / mNumericCount );
+          case QgsAggregateCalculator::StDevSample:
+            return mNumericCount > 1 ? QVariant( qSqrt( mM2 / ( mNumericCount - 1 ) ) ) : QVariant( QVariant::Double );
+          case QgsAggregateCalculator::Range:
+            return mMax.toDouble() - mMin.toDouble();
+          case QgsAggregateCalculator::Median:
+            return percentile( sortedNumbers(), 0.5 );
+          case QgsAggregateCalculator::FirstQuartile:
+            return percentile( sortedNumbers(), 0.25 );
+          case QgsAggregateCalculator::ThirdQuartile:
+            return percentile( sortedNumbers(), 0.75 );
+          case QgsAggregateCalculator::InterQuartileRange:
+            return percentile( sortedNumbers(), 0.75 ).toDouble() - percentile( sortedNumbers(), 0.25 ).toDouble();
+          case QgsAggregateCalculator::Percentile:
+            return percentile( sortedNumbers(), parameters.percentile );
+          default:
+            break;
+        }
+        return QVariant();
+      }
+
+    private:
+      qlonglong mCount;
+      qlonglong mMissing;
+      qlonglong mNumericCount;
+      double mSum;
+      double mMean;
+      double mM2;
+      QVariant mMin;
+      QVariant mMax;
+      QSet<QString> mDistinct;
+      QList<double> mNumbers;
+      bool mNumbersSorted;
+      QStringList mStrings;
+      bool mKeepDistinct;
+      bool mKeepNumbers;
+      bool mKeepStrings;
+
+      QList<double>& sortedNumbers()
+      {
+        if ( !mNumbersSorted )
+        {
+          std::sort( mNumbers.begin(), mNumbers.end() );
+          mNumbersSorted = true;
+        }
+        return mNumbers;
+      }
+  };
+}
+
+QgsAggregateCalculator::QgsAggregateCalculator( QgsVectorLayer* layer )
+    : mLayer( layer )
+{
+}
+
+QVariant QgsAggregateCalculator::calculate( Aggregate aggregate, const QString& fieldOrExpression, bool* ok ) const
+{
+  QList<QVariant> values = calculate( QList<Aggregate>() << aggregate, fieldOrExpression, ok );
+  return values.isEmpty() ? QVariant() : values.first();
+}
+
+QList<QVariant> QgsAggregateCalculator::calculate( const QList<Aggregate>& aggregates, const QString& fieldOrExpression, bool* ok ) const
+{
+  GroupResults results = calculateGrouped( aggregates, fieldOrExpression, QString(), ok );
+  if ( results.isEmpty() )
+    return QList<QVariant>();
+  return results.first().values;
+}
+
+QgsAggregateCalculator::GroupResults QgsAggregateCalculator::calculateGrouped( Aggregate aggregate, const QString& fieldOrExpression, const QString& groupByExpression, bool* ok ) const
+{
+  return calculateGrouped( QList<Aggregate>() << aggregate, fieldOrExpression, groupByExpression, ok );
+}
+
+QgsAggregateCalculator::GroupResults QgsAggregateCalculator::calculateGrouped( const QList<Aggregate>& aggregates, const QString& fieldOrExpression, const QString& groupByExpression, bool* ok ) const
+{
+  GroupResults results;
+  bool success = false;
+
+  if ( mLayer && !aggregates.isEmpty() )
+  {
+    success = providerAggregate( aggregates, fieldOrExpression, groupByExpression, results );
+    if ( !success )
+    {
+      results.clear();
+      success = iterateAggregate( aggregates, fieldOrExpression, groupByExpression, results );
+    }
+  }
+
+  if ( !success )
+    results.clear();
+  else if ( groupByExpression.isEmpty() && results.isEmpty() )
+  {
+    // aggregates of no features
+    Accumulator empty( false, false, false );
+    GroupResult result;
+    Q_FOREACH ( Aggregate aggregate, aggregates )
+      result.values << empty.result( aggregate, mParameters );
+    results << result;
+  }
+  else
+    std::stable_sort( results.begin(), results.end(), groupLessThan );
+
+  if ( ok )
+    *ok = success;
+  return results;
+}
+
+bool QgsAggregateCalculator::providerAggregate( const QList<Aggregate>& aggregates, const QString& fieldOrExpression, const QString& groupByExpression, GroupResults& results ) const
+{
+  QgsVectorDataProvider* provider = mLayer->dataProvider();
+
+  // the provider does not know about uncommitted changes or the feature ids
+  if ( !provider || !mFidsFilter.isEmpty() || mLayer->isModified() )
+    return false;
+
+  return provider->aggregate( aggregates, fieldOrExpression, groupByExpression, mParameters, results );
+}
+
+bool QgsAggregateCalculator::iterateAggregate( const QList<Aggregate>& aggregates, const QString& fieldOrExpression, const QString& groupByExpression, GroupResults& results ) const
+{
+  QgsExpressionContext context;
+  context << QgsExpressionContextUtils::globalScope()
+  << QgsExpressionContextUtils::projectScope()
+  << QgsExpressionContextUtils::layerScope( mLayer );
+
+  QgsFields fields = mLayer->pendingFields();
+  QStringList columns;
+  bool needsGeometry = false;
+
+  int attrNum = fields.fieldNameIndex( fieldOrExpression );
+  QScopedPointer<QgsExpression> expression;
+  if ( attrNum == -1 )
+  {
+    expression.reset( new QgsExpression( fieldOrExpression ) );
+    if ( expression->hasParserError() || !expression->prepare( &context ) )
+    {
+      QgsDebugMsg( QString( "Invalid expression %1" ).arg( fieldOrExpression ) );
+      return false;
+    }
+    columns << expression->referencedColumns();
+    needsGeometry = expression->needsGeometry();
+  }
+  else
+  {
+    columns << fieldOrExpression;
+  }
+
+  int groupAttrNum = -1;
+  QScopedPointer<QgsExpression> groupBy;
+  if ( !groupByExpression.isEmpty() )
+  {
+    groupAttrNum = fields.fieldNameIndex( groupByExpression );
+    if ( groupAttrNum == -1 )
+    {
+      groupBy.reset( new QgsExpression( groupByExpression ) );
+      if ( groupBy->hasParserError() || !groupBy->prepare( &context ) )
+      {
+        QgsDebugMsg( QString( "Invalid group expression %1" ).arg( groupByExpression ) );
+        return false;
+      }
+      columns << groupBy->referencedColumns();
+      needsGeometry = needsGeometry || groupBy->needsGeometry();
+    }
+    else
+    {
+      columns << groupByExpression;
+    }
+  }
+
+  QgsFeatureRequest request;
+  if ( !mParameters.filter.isEmpty() )
+  {
+    QgsExpression filter( mParameters.filter );
+    if ( filter.hasParserError() )
+      return false;
+    columns << filter.referencedColumns();
+    needsGeometry = needsGeometry || filter.needsGeometry();
+    request.setFilterExpression( mParameters.filter );
+    request.setExpressionContext( context );
+  }
+  if ( !mFidsFilter.isEmpty() )
+    request.setFilterFids( mFidsFilter );
+
+  request.setFlags( needsGeometry ? QgsFeatureRequest::NoFlags : QgsFeatureRequest::NoGeometry );
+  if ( !columns.contains( QgsFeatureRequest::AllAttributes ) )
+    request.setSubsetOfAttributes( columns, fields );
+
+  bool numeric = false;
+  bool keepDistinct = false;
+  bool keepNumbers = false;
+  bool keepStrings = false;
+  Q_FOREACH ( Aggregate aggregate, aggregates )
+  {
+    numeric = numeric || isNumeric( aggregate );
+    keepDistinct = keepDistinct || aggregate == CountDistinct;
+    keepNumbers = keepNumbers || aggregate == Median || aggregate == FirstQuartile || aggregate == ThirdQuartile
+                  || aggregate == InterQuartileRange || aggregate == Percentile;
+    keepStrings = keepStrings || aggregate == StringConcatenate;
+  }
+
+  QList<Accumulator> accumulators;
+  QList<QVariant> groups;
+  QHash<QString, int> groupIndex;
+
+  QgsFeatureIterator fit = mLayer->getFeatures( request );
+  QgsFeature f;
+  while ( fit.nextFeature( f ) )
+  {
+    context.setFeature( f );
+    QVariant value = expression ? expression->evaluate( &context ) : f.attribute( attrNum );
+
+    QVariant group;
+    if ( groupBy )
+      group = groupBy->evaluate( &context );
+    else if ( groupAttrNum != -1 )
+      group = f.attribute( groupAttrNum );
+
+    QString key = distinctKey( group );
+    QHash<QString, int>::const_iterator it = groupIndex.constFind( key );
+    int index;
+    if ( it == groupIndex.constEnd() )
+    {
+      index = accumulators.size();
+      groupIndex.insert( key, index );
+      accumulators << Accumulator( keepDistinct, keepNumbers, keepStrings );
+      groups << group;
+    }
+    else
+    {
+      index = it.value();
+    }
+
+    if ( !accumulators[index].add( value, numeric ) )
+    {
+      QgsDebugMsg( QString( "Numeric aggregate of non numeric value %1" ).arg( value.toString() ) );
+      return false;
+    }
+  }
+
+  for ( int i = 0; i < accumulators.size(); ++i )
+  {
+    GroupResult result;
+    result.group = groups.at( i );
+    Q_FOREACH ( Aggregate aggregate, aggregates )
+      result.values << accumulators[i].result( aggregate, mParameters );
+    results << result;
+  }
+  return true;
+}
+
+bool QgsAggregateCalculator::isNumeric( Aggregate aggregate )
+{
+  switch ( aggregate )
+  {
+    case Count:
+    case CountDistinct:
+    case CountMissing:
+    case Min:
+    case Max:
+    case StringConcatenate:
+      return false;
+    case Sum:
+    case Mean:
+    case Median:
+    case StDev:
+    case StDevSample:
+    case Range:
+    case FirstQuartile:
+    case ThirdQuartile:
+    case InterQuartileRange:
+    case Percentile:
+      return true;
+  }
+  return false;
+}
+
+QString QgsAggregateCalculator::displayName( Aggregate aggregate )
+{
+  switch ( aggregate )
+  {
+    case Count:
+      return QObject::tr( "Count" );
+    case CountDistinct:
+      return QObject::tr( "Count distinct" );
+    case CountMissing:
+      return QObject::tr( "Count missing" );
+    case Min:
+      return QObject::tr( "Minimum" );
+    case Max:
+      return QObject::tr( "Maximum" );
+    case Sum:
+      return QObject::tr( "Sum" );
+    case Mean:
+      return QObject::tr( "Mean" );
+    case Median:
+      return QObject::tr( "Median" );
+    case StDev:
+      return QObject::tr( "St dev (pop)" );
+    case StDevSample:
+      return QObject::tr( "St dev (sample)" );
+    case Range:
+      return QObject::tr( "Range" );
+    case FirstQuartile:
+      return QObject::tr( "Q1" );
+    case ThirdQuartile:
+      return QObject::tr( "Q3" );
+    case InterQuartileRange:
+      return QObject::tr( "IQR" );
+    case Percentile:
+      return QObject::tr( "Percentile" );
+    case StringConcatenate:
+      return QObject::tr( "Concatenation" );
+  }
+  return QString();
+}
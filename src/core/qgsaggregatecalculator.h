@@ -0,0 +1,189 @@
+/***************************************************************************
+  qgsaggregatecalculator.h
+  ------------------------
+  begin                : October 2015
+  copyright            : (C) 2015 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSAGGREGATECALCULATOR_H
+#define QGSAGGREGATECALCULATOR_H
+
+#include "qgsfeature.h"
+
+#include <QList>
+#include <QString>
+#include <QVariant>
+
+class QgsVectorLayer;
+
+/** \ingroup core
+ * \class QgsAggregateCalculator
+ * \brief Calculates aggregates of a field or an expression over the features of a vector layer.
+ *
+ * The values can be filtered by an expression and grouped by a second expression.
+ * If the layer has no uncommitted changes and no feature ids are set as filter, the
+ * data provider gets the chance to compute the aggregates itself, e.g. in SQL. Otherwise
+ * the features are read once and the aggregates are accumulated while iterating. Counts,
+ * sums, means, extremes and standard deviations need constant memory per group, distinct
+ * counts keep the distinct values and percentiles and concatenations keep all values.
+ *
+ * Like in SQL, NULL values are ignored by all aggregates except CountMissing, and numeric
+ * aggregates of no values are NULL.
+ *
+ * \note added in 2.12
+ */
+class CORE_EXPORT QgsAggregateCalculator
+{
+  public:
+
+    /** Available aggregates */
+    enum Aggregate
+    {
+      Count, //!< Count of non-NULL values
+      CountDistinct, //!< Number of distinct non-NULL values
+      CountMissing, //!< Number of NULL values
+      Min, //!< Minimum value, strings and dates are compared in their own order
+      Max, //!< Maximum value, strings and dates are compared in their own order
+      Sum, //!< Sum of values
+      Mean, //!< Mean of values
+      Median, //!< Median of values, interpolated between the two middle values
+      StDev, //!< Population standard deviation of values
+      StDevSample, //!< Sample standard deviation of values
+      Range, //!< Range of values (max - min)
+      FirstQuartile, //!< 25th percentile of values
+      ThirdQuartile, //!< 75th percentile of values
+      InterQuartileRange, //!< Inter quartile range (IQR)
+      Percentile, //!< Percentile of values set with AggregateParameters::percentile
+      StringConcatenate //!< Values joined with AggregateParameters::delimiter, in the order of the features
+    };
+
+    /** Parameters of the aggregates */
+    struct CORE_EXPORT AggregateParameters
+    {
+      AggregateParameters()
+          : percentile( 0.5 )
+      {}
+
+      //! Expression which the features have to match, empty for all features
+      QString filter;
+
+      //! Delimiter for StringConcatenate
+      QString delimiter;
+
+      //! Fraction between 0 and 1 for Percentile, interpolated linearly between the closest values
+      double percentile;
+    };
+
+    /** Aggregates of one group */
+    struct CORE_EXPORT GroupResult
+    {
+      //! Value of the group expression, NULL if the aggregates are not grouped
+      QVariant group;
+
+      //! Values of the aggregates, in the order they were requested
+      QList<QVariant> values;
+    };
+
+    //! Aggregates of all groups
+    typedef QList<GroupResult> GroupResults;
+
+    /** Constructor for QgsAggregateCalculator.
+     * @param layer vector layer to calculate the aggregates for
+     */
+    explicit QgsAggregateCalculator( QgsVectorLayer* layer );
+
+    /** Returns the layer the aggregates are calculated for */
+    QgsVectorLayer* layer() const { return mLayer; }
+
+    /** Sets the parameters of the aggregates.
+     * @see parameters
+     */
+    void setParameters( const AggregateParameters& parameters ) { mParameters = parameters; }
+
+    /** Returns the parameters of the aggregates.
+     * @see setParameters
+     */
+    const AggregateParameters& parameters() const { return mParameters; }
+
+    /** Sets an expression which the features have to match, empty for all features.
+     * @see setParameters
+     */
+    void setFilter( const QString& filterExpression ) { mParameters.filter = filterExpression; }
+
+    /** Sets the delimiter for StringConcatenate.
+     * @see setParameters
+     */
+    void setDelimiter( const QString& delimiter ) { mParameters.delimiter = delimiter; }
+
+    /** Sets the fraction between 0 and 1 for Percentile.
+     * @see setParameters
+     */
+    void setPercentile( double percentile ) { mParameters.percentile = percentile; }
+
+    /** Restricts the aggregates to the features with the given ids, e.g. the selected features.
+     * An empty set removes the restriction.
+     */
+    void setFidsFilter( const QgsFeatureIds& fids ) { mFidsFilter = fids; }
+
+    /** Calculates an aggregate over all features.
+     * @param aggregate aggregate to calculate
+     * @param fieldOrExpression field name or expression to aggregate
+     * @param ok set to false if the expression is invalid or a numeric aggregate meets a non numeric value
+     */
+    QVariant calculate( Aggregate aggregate, const QString& fieldOrExpression, bool* ok = 0 ) const;
+
+    /** Calculates several aggregates in a single pass over the features.
+     * @param aggregates aggregates to calculate
+     * @param fieldOrExpression field name or expression to aggregate
+     * @param ok set to false if the expression is invalid or a numeric aggregate meets a non numeric value
+     * @returns values of the aggregates in the order of aggregates
+     * @note not available in Python bindings
+     */
+    QList<QVariant> calculate( const QList<Aggregate>& aggregates, const QString& fieldOrExpression, bool* ok = 0 ) const;
+
+    /** Calculates an aggregate for each distinct value of a group expression.
+     * @param aggregate aggregate to calculate
+     * @param fieldOrExpression field name or expression to aggregate
+     * @param groupByExpression field name or expression to group by
+     * @param ok set to false if an expression is invalid or a numeric aggregate meets a non numeric value
+     * @returns one result for each group, ordered by the group values with the NULL group first
+     */
+    GroupResults calculateGrouped( Aggregate aggregate, const QString& fieldOrExpression, const QString& groupByExpression, bool* ok = 0 ) const;
+
+    /** Calculates several aggregates for each distinct value of a group expression in a single pass over the features.
+     * @param aggregates aggregates to calculate
+     * @param fieldOrExpression field name or expression to aggregate
+     * @param groupByExpression field name or expression to group by, empty for a single group
+     * @param ok set to false if an expression is invalid or a numeric aggregate meets a non numeric value
+     * @returns one result for each group, ordered by the group values with the NULL group first
+     * @note not available in Python bindings
+     */
+    GroupResults calculateGrouped( const QList<Aggregate>& aggregates, const QString& fieldOrExpression, const QString& groupByExpression, bool* ok = 0 ) const;
+
+    /** Returns true if the aggregate only accepts numeric values */
+    static bool isNumeric( Aggregate aggregate );
+
+    /** Returns the friendly display name of an aggregate */
+    static QString displayName( Aggregate aggregate );
+
+  private:
+
+    QgsVectorLayer* mLayer;
+    AggregateParameters mParameters;
+    QgsFeatureIds mFidsFilter;
+
+    //! Lets the data provider calculate the aggregates, returns false if it cannot
+    bool providerAggregate( const QList<Aggregate>& aggregates, const QString& fieldOrExpression, const QString& groupByExpression, GroupResults& results ) const;
+
+    //! Accumulates the aggregates while iterating over the features of the layer
+    bool iterateAggregate( const QList<Aggregate>& aggregates, const QString& fieldOrExpression, const QString& groupByExpression, GroupResults& results ) const;
+};
+
+#endif // QGSAGGREGATECALCULATOR_H
@@ -14,6 +14,7 @@
  ***************************************************************************/
 
 #include "qgscachedfeatureiterator.h"
+#include "qgsfeaturebatch.h"
 #include "qgsvectorlayercache.h"
 
 QgsCachedFeatureIterator::QgsCachedFeatureIterator( QgsVectorLayerCache *vlCache, const QgsFeatureRequest& featureRequest, const QgsFeatureIds& featureIds )
@@ -57,10 +58,14 @@ bool QgsCachedFeatureIterator::fetchFeature( QgsFeature& f )
   if ( mClosed )
     return false;
 
+  bool needGeometry = !( mRequest.flags() & QgsFeatureRequest::NoGeometry );
   while ( mFeatureIdIterator != mFeatureIds.constEnd() )
   {
-    f = QgsFeature( *mVectorLayerCache->mCache[*mFeatureIdIterator]->feature() );
+    QgsFeatureId fid = *mFeatureIdIterator;
     ++mFeatureIdIterator;
+    // skip features which have been removed from the cache meanwhile
+    if ( !mVectorLayerCache->cachedFeature( fid, f, needGeometry ) )
+      continue;
     if ( mRequest.acceptFeature( f ) )
       return true;
   }
@@ -93,7 +98,7 @@ bool QgsCachedFeatureWriterIterator::fetchFeature( QgsFeature& f )
   if ( mFeatIt.nextFeature( f ) )
   {
     // As long as features can be fetched from the provider: Write them to cache
-    mVectorLayerCache->cacheFeature( f );
+    mVectorLayerCache->cacheFeature( f, !( mRequest.flags() & QgsFeatureRequest::NoGeometry ) );
     mFids.insert( f.id() );
     return true;
   }
@@ -106,6 +111,29 @@ bool QgsCachedFeatureWriterIterator::fetchFeature( QgsFeature& f )
   }
 }
 
+int QgsCachedFeatureWriterIterator::fetchFeatures( QgsFeatureBatch& batch, int maxCount )
+{
+  int count = mFeatIt.nextFeatures( batch, maxCount );
+  if ( count == 0 )
+  {
+    // Once no more features can be fetched: Inform the cache, that
+    // the request has been completed
+    mVectorLayerCache->requestCompleted( mRequest, mFids );
+    return 0;
+  }
+
+  // Write the batch to the cache
+  bool hasGeometry = !( mRequest.flags() & QgsFeatureRequest::NoGeometry );
+  QgsFeature f;
+  for ( int row = 0; row < count; ++row )
+  {
+    batch.feature( row, f );
+    mVectorLayerCache->cacheFeature( f, hasGeometry );
+    mFids.insert( f.id() );
+  }
+  return count;
+}
+
 bool QgsCachedFeatureWriterIterator::rewind()
 {
   mFids.clear();
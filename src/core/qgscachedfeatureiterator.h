@@ -132,6 +132,14 @@ class CORE_EXPORT QgsCachedFeatureWriterIterator : public QgsAbstractFeatureIter
      */
     virtual bool fetchFeature( QgsFeature& f ) override;
 
+    /**
+     * Fetches a batch of features from the backend and writes them to the cache.
+     *
+     * @note added in 2.12
+     * @note not available in python bindings
+     */
+    virtual int fetchFeatures( QgsFeatureBatch& batch, int maxCount ) override;
+
   private:
     QgsFeatureIterator mFeatIt;
     QgsVectorLayerCache* mVectorLayerCache;
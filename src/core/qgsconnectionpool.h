@@ -77,10 +77,14 @@ class QgsConnectionPoolGroup
       }
     }
 
-    T acquire()
+    T acquire( bool wait = true )
     {
       // we are going to acquire a resource - if no resource is available, we will block here
-      sem.acquire();
+      // (or give up right away, if the caller does not want to wait)
+      if ( wait )
+        sem.acquire();
+      else if ( !sem.tryAcquire() )
+        return 0;
 
       // quick (preferred) way - use cached connection
       {
@@ -244,16 +248,16 @@ class QgsConnectionPool
     //! @return initialized connection or null on error
     T acquireConnection( const QString& connInfo )
     {
-      mMutex.lock();
-      typename T_Groups::iterator it = mGroups.find( connInfo );
-      if ( it == mGroups.end() )
-      {
-        it = mGroups.insert( connInfo, new T_Group( connInfo ) );
-      }
-      T_Group* group = *it;
-      mMutex.unlock();
+      return group( connInfo )->acquire();
+    }
 
-      return group->acquire();
+    //! Try to acquire a connection without blocking, e.g. for additional connections of a
+    //! thread that already holds one and would deadlock waiting for its own release.
+    //! @return initialized connection or null if the limit of connections is reached or on error
+    //! @note added in 2.12
+    T tryAcquireConnection( const QString& connInfo )
+    {
+      return group( connInfo )->acquire( false );
     }
 
     //! Release an existing connection so it will get back into the pool and can be reused
@@ -283,6 +287,18 @@ class QgsConnectionPool
 
 
   protected:
+    //! Returns the group of connections to the resource, creating it if necessary
+    T_Group* group( const QString& connInfo )
+    {
+      QMutexLocker locker( &mMutex );
+      typename T_Groups::iterator it = mGroups.find( connInfo );
+      if ( it == mGroups.end() )
+      {
+        it = mGroups.insert( connInfo, new T_Group( connInfo ) );
+      }
+      return *it;
+    }
+
     T_Groups mGroups;
     QMutex mMutex;
 };
@@ -31,6 +31,7 @@
 
 #include "qgsapplication.h"
 #include "qgscrscache.h"
+#include "qgscrsdatabaseindex.h"
 #include "qgslogger.h"
 #include "qgsmessagelog.h"
 #include "qgis.h" //const vals declared here
@@ -224,8 +225,17 @@ bool QgsCoordinateReferenceSystem::createFromOgcWmsCrs( QString theCrs )
     }
   }
 
-  if ( loadFromDb( QgsApplication::srsDbFilePath(), "lower(auth_name||':'||auth_id)", theCrs.toLower() ) )
+  QgsCrsDatabaseIndex* index = QgsCrsDatabaseIndex::instance();
+  if ( index->isValid() )
+  {
+    QgsCrsDatabaseRecord record;
+    if ( loadFromRecord( index->recordByAuthId( theCrs, record ) ? &record : 0 ) )
+      return true;
+  }
+  else if ( loadFromDb( QgsApplication::srsDbFilePath(), "lower(auth_name||':'||auth_id)", theCrs.toLower() ) )
+  {
     return true;
+  }
 
   // NAD27
   if ( theCrs.compare( "CRS:27", Qt::CaseInsensitive ) == 0 ||
@@ -308,11 +318,25 @@ void QgsCoordinateReferenceSystem::validate()
 
 bool QgsCoordinateReferenceSystem::createFromSrid( long id )
 {
+  QgsCrsDatabaseIndex* index = QgsCrsDatabaseIndex::instance();
+  if ( index->isValid() )
+  {
+    QgsCrsDatabaseRecord record;
+    return loadFromRecord( index->recordBySrid( id, record ) ? &record : 0 );
+  }
+
   return loadFromDb( QgsApplication::srsDbFilePath(), "srid", QString::number( id ) );
 }
 
 bool QgsCoordinateReferenceSystem::createFromSrsId( long id )
 {
+  QgsCrsDatabaseIndex* index = QgsCrsDatabaseIndex::instance();
+  if ( id < USER_CRS_START_ID && index->isValid() )
+  {
+    QgsCrsDatabaseRecord record;
+    return loadFromRecord( index->recordBySrsId( id, record ) ? &record : 0 );
+  }
+
   return loadFromDb( id < USER_CRS_START_ID ? QgsApplication::srsDbFilePath() :
                      QgsApplication::qgisUserDbFilePath(),
                      "srs_id", QString::number( id ) );
@@ -364,34 +388,19 @@ bool QgsCoordinateReferenceSystem::loadFromDb( const QString& db, const QString&
   // XXX Need to free memory from the error msg if one is set
   if ( myResult == SQLITE_OK && sqlite3_step( myPreparedStatement ) == SQLITE_ROW )
   {
-    mSrsId = QString::fromUtf8(( char * )sqlite3_column_text(
-                                 myPreparedStatement, 0 ) ).toLong();
-    mDescription = QString::fromUtf8(( char * )sqlite3_column_text(
-                                       myPreparedStatement, 1 ) );
-    mProjectionAcronym = QString::fromUtf8(( char * )sqlite3_column_text( myPreparedStatement, 2 ) );
-    mEllipsoidAcronym = QString::fromUtf8(( char * )sqlite3_column_text( myPreparedStatement, 3 ) );
-    mProj4 = QString::fromUtf8(( char * )sqlite3_column_text( myPreparedStatement, 4 ) );
-    mSRID = QString::fromUtf8(( char * )sqlite3_column_text( myPreparedStatement, 5 ) ).toLong();
-    mAuthId = QString::fromUtf8(( char * )sqlite3_column_text( myPreparedStatement, 6 ) );
-    mGeoFlag = QString::fromUtf8(( char * )sqlite3_column_text( myPreparedStatement, 7 ) ).toInt() != 0;
-    mAxisInverted = -1;
-
-    if ( mSrsId >= USER_CRS_START_ID && mAuthId.isEmpty() )
-    {
-      mAuthId = QString( "USER:%1" ).arg( mSrsId );
-    }
-    else if ( mAuthId.startsWith( "EPSG:", Qt::CaseInsensitive ) )
-    {
-      OSRDestroySpatialReference( mCRS );
-      mCRS = OSRNewSpatialReference( NULL );
-      mIsValidFlag = OSRSetFromUserInput( mCRS, mAuthId.toLower().toAscii() ) == OGRERR_NONE;
-      setMapUnits();
-    }
-
-    if ( !mIsValidFlag )
-    {
-      setProj4String( mProj4 );
-    }
+    QgsCrsDatabaseRecord record;
+    record.srsId = QString::fromUtf8(( char * )sqlite3_column_text(
+                                       myPreparedStatement, 0 ) ).toLong();
+    record.description = QString::fromUtf8(( char * )sqlite3_column_text(
+                                             myPreparedStatement, 1 ) );
+    record.projectionAcronym = QString::fromUtf8(( char * )sqlite3_column_text( myPreparedStatement, 2 ) );
+    record.ellipsoidAcronym = QString::fromUtf8(( char * )sqlite3_column_text( myPreparedStatement, 3 ) );
+    record.parameters = QString::fromUtf8(( char * )sqlite3_column_text( myPreparedStatement, 4 ) );
+    record.srid = QString::fromUtf8(( char * )sqlite3_column_text( myPreparedStatement, 5 ) ).toLong();
+    record.authId = QString::fromUtf8(( char * )sqlite3_column_text( myPreparedStatement, 6 ) );
+    record.isGeo = QString::fromUtf8(( char * )sqlite3_column_text( myPreparedStatement, 7 ) ).toInt() != 0;
+    record.deprecated = false;
+    loadFromRecord( &record );
   }
   else
   {
@@ -402,6 +411,46 @@ bool QgsCoordinateReferenceSystem::loadFromDb( const QString& db, const QString&
   return mIsValidFlag;
 }
 
+bool QgsCoordinateReferenceSystem::loadFromRecord( const QgsCrsDatabaseRecord* record )
+{
+  mIsValidFlag = false;
+  mWkt.clear();
+
+  if ( !record )
+  {
+    return mIsValidFlag;
+  }
+
+  mSrsId = record->srsId;
+  mDescription = record->description;
+  mProjectionAcronym = record->projectionAcronym;
+  mEllipsoidAcronym = record->ellipsoidAcronym;
+  mProj4 = record->parameters;
+  mSRID = record->srid;
+  mAuthId = record->authId;
+  mGeoFlag = record->isGeo;
+  mAxisInverted = -1;
+
+  if ( mSrsId >= USER_CRS_START_ID && mAuthId.isEmpty() )
+  {
+    mAuthId = QString( "USER:%1" ).arg( mSrsId );
+  }
+  else if ( mAuthId.startsWith( "EPSG:", Qt::CaseInsensitive ) )
+  {
+    OSRDestroySpatialReference( mCRS );
+    mCRS = OSRNewSpatialReference( NULL );
+    mIsValidFlag = OSRSetFromUserInput( mCRS, mAuthId.toLower().toAscii() ) == OGRERR_NONE;
+    setMapUnits();
+  }
+
+  if ( !mIsValidFlag )
+  {
+    setProj4String( mProj4 );
+  }
+
+  return mIsValidFlag;
+}
+
 bool QgsCoordinateReferenceSystem::axisInverted() const
 {
   if ( mAxisInverted == -1 )
@@ -564,12 +613,26 @@ bool QgsCoordinateReferenceSystem::createFromProj4( const QString &theProj4Strin
   long mySrsId = 0;
   QgsCoordinateReferenceSystem::RecordMap myRecord;
 
+  // system definitions are looked up in the in-memory index, only user
+  // definitions require database queries
+  QgsCrsDatabaseIndex* index = QgsCrsDatabaseIndex::instance();
+  bool indexed = index->isValid();
+  QgsCrsDatabaseRecord indexRecord;
+  bool foundInIndex = false;
+
   /*
    * - if the above does not match perform a whole text search on proj4 string (if not null)
    */
   // QgsDebugMsg( "wholetext match on name failed, trying proj4string match" );
-  myRecord = getRecord( "select * from tbl_srs where parameters=" + quotedValue( myProj4String ) + " order by deprecated" );
-  if ( myRecord.empty() )
+  if ( indexed )
+  {
+    foundInIndex = index->recordByParameters( myProj4String, indexRecord );
+  }
+  if ( !foundInIndex )
+  {
+    myRecord = getRecord( "select * from tbl_srs where parameters=" + quotedValue( myProj4String ) + " order by deprecated", indexed );
+  }
+  if ( !foundInIndex && myRecord.empty() )
   {
     // Ticket #722 - aaronr
     // Check if we can swap the lat_1 and lat_2 params (if they exist) to see if we match...
@@ -603,11 +666,24 @@ bool QgsCoordinateReferenceSystem::createFromProj4( const QString &theProj4Strin
       myStart2 = myLat2RegExp.indexIn( theProj4String, myStart2 );
       theProj4StringModified.replace( myStart2 + LAT_PREFIX_LEN, myLength2 - LAT_PREFIX_LEN, lat1Str );
       QgsDebugMsg( "trying proj4string match with swapped lat_1,lat_2" );
-      myRecord = getRecord( "select * from tbl_srs where parameters=" + quotedValue( theProj4StringModified.trimmed() ) + " order by deprecated" );
+      if ( indexed )
+      {
+        foundInIndex = index->recordByParameters( theProj4StringModified.trimmed(), indexRecord );
+      }
+      if ( !foundInIndex )
+      {
+        myRecord = getRecord( "select * from tbl_srs where parameters=" + quotedValue( theProj4StringModified.trimmed() ) + " order by deprecated", indexed );
+      }
     }
   }
 
-  if ( myRecord.empty() )
+  if ( !foundInIndex && myRecord.empty() && indexed )
+  {
+    // match all parameters individually, see below
+    foundInIndex = index->recordByParameterSet( myProj4String, indexRecord );
+  }
+
+  if ( !foundInIndex && myRecord.empty() )
   {
     // match all parameters individually:
     // - order of parameters doesn't matter
@@ -639,13 +715,13 @@ bool QgsCoordinateReferenceSystem::createFromProj4( const QString &theProj4Strin
 
     if ( !datum.isEmpty() )
     {
-      myRecord = getRecord( sql + delim + datum + " order by deprecated" );
+      myRecord = getRecord( sql + delim + datum + " order by deprecated", indexed );
     }
 
     if ( myRecord.empty() )
     {
       // datum might have disappeared in definition - retry without it
-      myRecord = getRecord( sql + " order by deprecated" );
+      myRecord = getRecord( sql + " order by deprecated", indexed );
     }
 
     if ( !myRecord.empty() )
@@ -668,9 +744,9 @@ bool QgsCoordinateReferenceSystem::createFromProj4( const QString &theProj4Strin
     }
   }
 
-  if ( !myRecord.empty() )
+  if ( foundInIndex || !myRecord.empty() )
   {
-    mySrsId = myRecord["srs_id"].toLong();
+    mySrsId = foundInIndex ? indexRecord.srsId : myRecord["srs_id"].toLong();
     QgsDebugMsg( "proj4string param match search for srsid returned srsid: " + QString::number( mySrsId ) );
     if ( mySrsId > 0 )
     {
@@ -706,7 +782,7 @@ bool QgsCoordinateReferenceSystem::createFromProj4( const QString &theProj4Strin
 }
 
 //private method meant for internal use by this class only
-QgsCoordinateReferenceSystem::RecordMap QgsCoordinateReferenceSystem::getRecord( const QString& theSql )
+QgsCoordinateReferenceSystem::RecordMap QgsCoordinateReferenceSystem::getRecord( const QString& theSql, bool theUserDbOnly )
 {
   QString myDatabaseFileName;
   QgsCoordinateReferenceSystem::RecordMap myMap;
@@ -721,22 +797,26 @@ QgsCoordinateReferenceSystem::RecordMap QgsCoordinateReferenceSystem::getRecord(
   // Get the full path name to the sqlite3 spatial reference database.
   myDatabaseFileName = QgsApplication::srsDbFilePath();
   QFileInfo myInfo( myDatabaseFileName );
-  if ( !myInfo.exists() )
+  if ( !theUserDbOnly && !myInfo.exists() )
   {
     QgsDebugMsg( "failed : " + myDatabaseFileName + " does not exist!" );
     return myMap;
   }
 
   //check the db is available
-  myResult = openDb( myDatabaseFileName, &myDatabase );
+  myResult = theUserDbOnly ? SQLITE_OK : openDb( myDatabaseFileName, &myDatabase );
   if ( myResult != SQLITE_OK )
   {
     return myMap;
   }
 
-  myResult = sqlite3_prepare( myDatabase, theSql.toUtf8(), theSql.toUtf8().length(), &myPreparedStatement, &myTail );
+  myPreparedStatement = 0;
+  if ( !theUserDbOnly )
+  {
+    myResult = sqlite3_prepare( myDatabase, theSql.toUtf8(), theSql.toUtf8().length(), &myPreparedStatement, &myTail );
+  }
   // XXX Need to free memory from the error msg if one is set
-  if ( myResult == SQLITE_OK && sqlite3_step( myPreparedStatement ) == SQLITE_ROW )
+  if ( !theUserDbOnly && myResult == SQLITE_OK && sqlite3_step( myPreparedStatement ) == SQLITE_ROW )
   {
     QgsDebugMsg( "trying system srs.db" );
     int myColumnCount = sqlite3_column_count( myPreparedStatement );
@@ -761,8 +841,11 @@ QgsCoordinateReferenceSystem::RecordMap QgsCoordinateReferenceSystem::getRecord(
   if ( myMap.empty() )
   {
     QgsDebugMsg( "trying user qgis.db" );
-    sqlite3_finalize( myPreparedStatement );
-    sqlite3_close( myDatabase );
+    if ( !theUserDbOnly )
+    {
+      sqlite3_finalize( myPreparedStatement );
+      sqlite3_close( myDatabase );
+    }
 
     myDatabaseFileName = QgsApplication::qgisUserDbFilePath();
     QFileInfo myFileInfo;
@@ -1044,40 +1127,56 @@ long QgsCoordinateReferenceSystem::findMatchingProj()
   // Get the full path name to the sqlite3 spatial reference database.
   QString myDatabaseFileName = QgsApplication::srsDbFilePath();
 
-  //check the db is available
-  myResult = openDb( myDatabaseFileName, &myDatabase );
-  if ( myResult != SQLITE_OK )
+  QgsCrsDatabaseIndex* index = QgsCrsDatabaseIndex::instance();
+  if ( index->isValid() )
   {
-    return 0;
+    QString myProj4 = toProj4();
+    Q_FOREACH ( const QgsCrsDatabaseRecord& record, index->recordsByAcronyms( mProjectionAcronym, mEllipsoidAcronym ) )
+    {
+      if ( myProj4 == record.parameters )
+      {
+        QgsDebugMsg( "-------> MATCH FOUND in srs.db srsid: " + QString::number( record.srsId ) );
+        return record.srsId;
+      }
+    }
   }
-
-  myResult = sqlite3_prepare( myDatabase, mySql.toUtf8(), mySql.toUtf8().length(), &myPreparedStatement, &myTail );
-// XXX Need to free memory from the error msg if one is set
-  if ( myResult == SQLITE_OK )
+  else
   {
+    //check the db is available
+    myResult = openDb( myDatabaseFileName, &myDatabase );
+    if ( myResult != SQLITE_OK )
+    {
+      return 0;
+    }
 
-    while ( sqlite3_step( myPreparedStatement ) == SQLITE_ROW )
+    myResult = sqlite3_prepare( myDatabase, mySql.toUtf8(), mySql.toUtf8().length(), &myPreparedStatement, &myTail );
+// XXX Need to free memory from the error msg if one is set
+    if ( myResult == SQLITE_OK )
     {
-      QString mySrsId = QString::fromUtf8(( char * )sqlite3_column_text( myPreparedStatement, 0 ) );
-      QString myProj4String = QString::fromUtf8(( char * )sqlite3_column_text( myPreparedStatement, 1 ) );
-      if ( toProj4() == myProj4String.trimmed() )
-      {
-        QgsDebugMsg( "-------> MATCH FOUND in srs.db srsid: " + mySrsId );
-        // close the sqlite3 statement
-        sqlite3_finalize( myPreparedStatement );
-        sqlite3_close( myDatabase );
-        return mySrsId.toLong();
-      }
-      else
+
+      while ( sqlite3_step( myPreparedStatement ) == SQLITE_ROW )
       {
+        QString mySrsId = QString::fromUtf8(( char * )sqlite3_column_text( myPreparedStatement, 0 ) );
+        QString myProj4String = QString::fromUtf8(( char * )sqlite3_column_text( myPreparedStatement, 1 ) );
+        if ( toProj4() == myProj4String.trimmed() )
+        {
+          QgsDebugMsg( "-------> MATCH FOUND in srs.db srsid: " + mySrsId );
+          // close the sqlite3 statement
+          sqlite3_finalize( myPreparedStatement );
+          sqlite3_close( myDatabase );
+          return mySrsId.toLong();
+        }
+        else
+        {
 // QgsDebugMsg(QString(" Not matched : %1").arg(myProj4String));
+        }
       }
     }
+    // close the sqlite3 statement
+    sqlite3_finalize( myPreparedStatement );
+    sqlite3_close( myDatabase );
   }
   QgsDebugMsg( "no match found in srs.db, trying user db now!" );
-  // close the sqlite3 statement
-  sqlite3_finalize( myPreparedStatement );
-  sqlite3_close( myDatabase );
   //
   // Try the users db now
   //
@@ -1197,8 +1296,10 @@ bool QgsCoordinateReferenceSystem::readXML( QDomNode & theNode )
     {
       myNode = srsNode.namedItem( "proj4" );
 
-      if ( createFromProj4( myNode.toElement().text() ) )
+      const QgsCoordinateReferenceSystem& proj4Crs = QgsCRSCache::instance()->crsByProj4( myNode.toElement().text() );
+      if ( proj4Crs.isValid() )
       {
+        operator=( proj4Crs );
         // createFromProj4() sets everything, including map units
         QgsDebugMsg( "Setting from proj4 string" );
       }
@@ -1943,6 +2044,9 @@ int QgsCoordinateReferenceSystem::syncDb()
 
   sqlite3_close( database );
 
+  // definitions have changed, reload them on next use
+  QgsCrsDatabaseIndex::instance()->invalidate();
+
   qWarning( "CRS update (inserted:%d updated:%d deleted:%d errors:%d)", inserted, updated, deleted, errors );
 
   if ( errors > 0 )
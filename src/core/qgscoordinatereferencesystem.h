@@ -28,6 +28,7 @@
 
 class QDomNode;
 class QDomDocument;
+struct QgsCrsDatabaseRecord;
 
 // forward declaration for sqlite3
 typedef struct sqlite3 sqlite3;
@@ -424,9 +425,10 @@ class CORE_EXPORT QgsCoordinateReferenceSystem
      * @note only handles queries that return a single record.
      * @note it will first try the system srs.db then the users qgis.db!
      * @param theSql The sql query to execute
+     * @param theUserDbOnly skip the system srs.db, e.g. because it was already searched using QgsCrsDatabaseIndex
      * @return An associative array of field name <-> value pairs
      */
-    RecordMap getRecord( const QString& theSql );
+    RecordMap getRecord( const QString& theSql, bool theUserDbOnly = false );
 
     // Open SQLite db and show message if cannot be opened
     // returns the same code as sqlite3_open
@@ -464,6 +466,9 @@ class CORE_EXPORT QgsCoordinateReferenceSystem
 
     bool loadFromDb( const QString& db, const QString& expression, const QString& value );
 
+    //! Initialises the CRS from a srs.db definition, returns false and invalidates the CRS if record is null
+    bool loadFromRecord( const QgsCrsDatabaseRecord* record );
+
     QString mValidationHint;
     mutable QString mWkt;
     mutable QString mProj4;
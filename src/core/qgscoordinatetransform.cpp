@@ -27,6 +27,10 @@
 #include <QPolygonF>
 #include <QStringList>
 #include <QVector>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QHash>
+#include <QThreadStorage>
 
 extern "C"
 {
@@ -37,12 +41,204 @@ extern "C"
 // if defined shows all information about transform to stdout
 // #define COORDINATE_TRANSFORM_VERBOSE
 
+#if defined(PJ_VERSION) && PJ_VERSION >= 480
+#define QGS_PROJ_THREAD_CONTEXT
+#endif
+
+class QgsProjThreadStore;
+
+/** Registry of the proj4 definitions used by coordinate transforms. Each definition
+ * gets an integer id, which is used to look up the per thread proj handles
+ * without hashing the definition string for every transformation.
+ * Definitions are reference counted by the transforms using them. Once the last
+ * transform releases a definition, its proj handles are freed in all threads and
+ * the id is reused for the next new definition. */
+class QgsProjDefinitionRegistry
+{
+  public:
+    //! Returns the id of a definition and adds a reference to it
+    int acquire( const QString& definition )
+    {
+      QMutexLocker locker( &mMutex );
+      QHash< QString, int >::const_iterator it = mIds.constFind( definition );
+      if ( it != mIds.constEnd() )
+      {
+        mRefCounts[it.value()]++;
+        return it.value();
+      }
+
+      int newId;
+      if ( !mFreeIds.isEmpty() )
+      {
+        newId = mFreeIds.takeLast();
+        mDefinitions[newId] = definition.toUtf8();
+        mRefCounts[newId] = 1;
+      }
+      else
+      {
+        newId = mDefinitions.size();
+        mDefinitions.append( definition.toUtf8() );
+        mRefCounts.append( 1 );
+      }
+      mIds.insert( definition, newId );
+      return newId;
+    }
+
+    //! Removes a reference to a definition, freeing it when it is no longer used
+    void release( int id );
+
+    QByteArray definition( int id )
+    {
+      QMutexLocker locker( &mMutex );
+      return mDefinitions.value( id );
+    }
+
+    void addStore( QgsProjThreadStore* store )
+    {
+      QMutexLocker locker( &mMutex );
+      mStores.append( store );
+    }
+
+    void removeStore( QgsProjThreadStore* store )
+    {
+      QMutexLocker locker( &mMutex );
+      mStores.removeAll( store );
+    }
+
+  private:
+    QMutex mMutex;
+    QHash< QString, int > mIds;
+    QList< QByteArray > mDefinitions;
+    QVector< int > mRefCounts;
+    QList< int > mFreeIds;
+    QList< QgsProjThreadStore* > mStores;
+};
+
+Q_GLOBAL_STATIC( QgsProjDefinitionRegistry, projDefinitionRegistry )
+
+/** Proj handles of a single thread. Proj4 projections must not be used concurrently
+ * from several threads, so every thread initialises its own handles (and, with proj >= 4.8,
+ * its own proj context). Handles are shared by all transforms of the thread and freed
+ * when the thread finishes or when their definition is released. */
+class QgsProjThreadStore
+{
+  public:
+    QgsProjThreadStore()
+#ifdef QGS_PROJ_THREAD_CONTEXT
+        : mContext( pj_ctx_alloc() )
+#endif
+    {
+      if ( QgsProjDefinitionRegistry* registry = projDefinitionRegistry() )
+        registry->addStore( this );
+    }
+
+    ~QgsProjThreadStore()
+    {
+      if ( QgsProjDefinitionRegistry* registry = projDefinitionRegistry() )
+        registry->removeStore( this );
+
+      Q_FOREACH ( projPJ pj, mProjections )
+      {
+        if ( pj )
+          pj_free( pj );
+      }
+#ifdef QGS_PROJ_THREAD_CONTEXT
+      pj_ctx_free( mContext );
+#endif
+    }
+
+    projPJ projection( int id )
+    {
+      if ( id < 0 )
+        return 0;
+
+      QMutexLocker locker( &mMutex );
+      if ( id >= mProjections.size() )
+      {
+        mProjections.resize( id + 1 );
+        mInitialised.resize( id + 1 );
+      }
+
+      if ( !mInitialised[id] )
+      {
+        // the registry calls freeProjection() with its own lock held, so do not hold ours while asking it
+        locker.unlock();
+        QByteArray definition = projDefinitionRegistry()->definition( id );
+#ifdef QGS_PROJ_THREAD_CONTEXT
+        projPJ pj = pj_init_plus_ctx( mContext, definition.constData() );
+#else
+        projPJ pj = pj_init_plus( definition.constData() );
+#endif
+        locker.relock();
+        mProjections[id] = pj;
+        mInitialised[id] = true;
+      }
+      return mProjections[id];
+    }
+
+    /** Frees the handle of a released definition. Called from the releasing thread,
+     * no transform of this thread uses the handle anymore. */
+    void freeProjection( int id )
+    {
+      QMutexLocker locker( &mMutex );
+      if ( id >= mProjections.size() || !mInitialised[id] )
+        return;
+
+      if ( mProjections[id] )
+        pj_free( mProjections[id] );
+      mProjections[id] = 0;
+      mInitialised[id] = false;
+    }
+
+  private:
+#ifdef QGS_PROJ_THREAD_CONTEXT
+    projCtx mContext;
+#endif
+    QMutex mMutex;
+    QVector< projPJ > mProjections;
+    QVector< bool > mInitialised;
+};
+
+void QgsProjDefinitionRegistry::release( int id )
+{
+  if ( id < 0 )
+    return;
+
+  QMutexLocker locker( &mMutex );
+  if ( id >= mRefCounts.size() || mRefCounts[id] <= 0 || --mRefCounts[id] > 0 )
+    return;
+
+  Q_FOREACH ( QgsProjThreadStore* store, mStores )
+  {
+    store->freeProjection( id );
+  }
+  mIds.remove( QString::fromUtf8( mDefinitions.at( id ) ) );
+  mDefinitions[id] = QByteArray();
+  mFreeIds.append( id );
+}
+
+static QThreadStorage< QgsProjThreadStore* > sProjThreadStore;
+
+static projPJ threadProjection( int id )
+{
+  if ( !sProjThreadStore.hasLocalData() )
+    sProjThreadStore.setLocalData( new QgsProjThreadStore() );
+  return sProjThreadStore.localData()->projection( id );
+}
+
+static void releaseProjDefinition( int id )
+{
+  // the registry may already be gone when transforms are deleted on exit
+  if ( QgsProjDefinitionRegistry* registry = projDefinitionRegistry() )
+    registry->release( id );
+}
+
 QgsCoordinateTransform::QgsCoordinateTransform()
     : QObject()
     , mShortCircuit( false )
     , mInitialisedFlag( false )
-    , mSourceProjection( 0 )
-    , mDestinationProjection( 0 )
+    , mSourceProjId( -1 )
+    , mDestinationProjId( -1 )
     , mSourceDatumTransform( -1 )
     , mDestinationDatumTransform( -1 )
 {
@@ -53,8 +249,8 @@ QgsCoordinateTransform::QgsCoordinateTransform( const QgsCoordinateReferenceSyst
     : QObject()
     , mShortCircuit( false )
     , mInitialisedFlag( false )
-    , mSourceProjection( 0 )
-    , mDestinationProjection( 0 )
+    , mSourceProjId( -1 )
+    , mDestinationProjId( -1 )
     , mSourceDatumTransform( -1 )
     , mDestinationDatumTransform( -1 )
 {
@@ -69,8 +265,8 @@ QgsCoordinateTransform::QgsCoordinateTransform( long theSourceSrsId, long theDes
     , mInitialisedFlag( false )
     , mSourceCRS( theSourceSrsId, QgsCoordinateReferenceSystem::InternalCrsId )
     , mDestCRS( theDestSrsId, QgsCoordinateReferenceSystem::InternalCrsId )
-    , mSourceProjection( 0 )
-    , mDestinationProjection( 0 )
+    , mSourceProjId( -1 )
+    , mDestinationProjId( -1 )
     , mSourceDatumTransform( -1 )
     , mDestinationDatumTransform( -1 )
 {
@@ -80,8 +276,8 @@ QgsCoordinateTransform::QgsCoordinateTransform( long theSourceSrsId, long theDes
 QgsCoordinateTransform::QgsCoordinateTransform( const QString& theSourceCRS, const QString& theDestCRS )
     : QObject()
     , mInitialisedFlag( false )
-    , mSourceProjection( 0 )
-    , mDestinationProjection( 0 )
+    , mSourceProjId( -1 )
+    , mDestinationProjId( -1 )
     , mSourceDatumTransform( -1 )
     , mDestinationDatumTransform( -1 )
 {
@@ -100,8 +296,8 @@ QgsCoordinateTransform::QgsCoordinateTransform( long theSourceSrid,
     QgsCoordinateReferenceSystem::CrsType theSourceCRSType )
     : QObject()
     , mInitialisedFlag( false )
-    , mSourceProjection( 0 )
-    , mDestinationProjection( 0 )
+    , mSourceProjId( -1 )
+    , mDestinationProjId( -1 )
     , mSourceDatumTransform( -1 )
     , mDestinationDatumTransform( -1 )
 {
@@ -118,15 +314,9 @@ QgsCoordinateTransform::QgsCoordinateTransform( long theSourceSrid,
 
 QgsCoordinateTransform::~QgsCoordinateTransform()
 {
-  // free the proj objects
-  if ( mSourceProjection )
-  {
-    pj_free( mSourceProjection );
-  }
-  if ( mDestinationProjection )
-  {
-    pj_free( mDestinationProjection );
-  }
+  // proj objects are owned by the per thread stores
+  releaseProjDefinition( mSourceProjId );
+  releaseProjDefinition( mDestinationProjId );
 }
 
 QgsCoordinateTransform* QgsCoordinateTransform::clone() const
@@ -152,7 +342,7 @@ void QgsCoordinateTransform::setDestCRS( const QgsCoordinateReferenceSystem& the
 void QgsCoordinateTransform::setDestCRSID( long theCRSID )
 {
   //!todo Add some logic here to determine if the srsid is a system or user one
-  mDestCRS.createFromSrsId( theCRSID );
+  mDestCRS = QgsCRSCache::instance()->crsBySrsId( theCRSID );
   initialise();
 }
 
@@ -182,7 +372,6 @@ void QgsCoordinateTransform::initialise()
 
   // init the projections (destination and source)
 
-  pj_free( mSourceProjection );
   QString sourceProjString = mSourceCRS.toProj4();
   if ( !useDefaultDatumTransform )
   {
@@ -193,7 +382,6 @@ void QgsCoordinateTransform::initialise()
     sourceProjString += ( " " + datumTransformString( mSourceDatumTransform ) );
   }
 
-  pj_free( mDestinationProjection );
   QString destProjString = mDestCRS.toProj4();
   if ( !useDefaultDatumTransform )
   {
@@ -209,8 +397,13 @@ void QgsCoordinateTransform::initialise()
     addNullGridShifts( sourceProjString, destProjString );
   }
 
-  mSourceProjection = pj_init_plus( sourceProjString.toUtf8() );
-  mDestinationProjection = pj_init_plus( destProjString.toUtf8() );
+  // acquire the new definitions before releasing the old ones, so unchanged handles are kept
+  int oldSourceProjId = mSourceProjId;
+  int oldDestinationProjId = mDestinationProjId;
+  mSourceProjId = projDefinitionRegistry()->acquire( sourceProjString );
+  mDestinationProjId = projDefinitionRegistry()->acquire( destProjString );
+  releaseProjDefinition( oldSourceProjId );
+  releaseProjDefinition( oldDestinationProjId );
 
 #ifdef COORDINATE_TRANSFORM_VERBOSE
   QgsDebugMsg( "From proj : " + mSourceCRS.toProj4() );
@@ -218,11 +411,11 @@ void QgsCoordinateTransform::initialise()
 #endif
 
   mInitialisedFlag = true;
-  if ( !mDestinationProjection )
+  if ( !destinationProjection() )
   {
     mInitialisedFlag = false;
   }
-  if ( !mSourceProjection )
+  if ( !sourceProjection() )
   {
     mInitialisedFlag = false;
   }
@@ -251,10 +444,11 @@ void QgsCoordinateTransform::initialise()
   //XXX todo overload == operator for QgsCoordinateReferenceSystem
   //at the moment srs.parameters contains the whole proj def...soon it wont...
   //if (mSourceCRS->toProj4() == mDestCRS->toProj4())
-  if ( mSourceCRS == mDestCRS )
+  if ( mSourceCRS == mDestCRS || mSourceProjId == mDestinationProjId )
   {
-    // If the source and destination projection are the same, set the short
-    // circuit flag (no transform takes place)
+    // If the source and destination projection are the same (or equivalent, i.e.
+    // they resolve to the same proj4 definition), set the short circuit flag
+    // (no transform takes place)
     mShortCircuit = true;
     QgsDebugMsgLevel( "Source/Dest CRS equal, shortcircuit is set.", 3 );
   }
@@ -412,24 +606,42 @@ void QgsCoordinateTransform::transformPolygon( QPolygonF& poly, TransformDirecti
     return;
   }
 
-  //create x, y arrays
   int nVertices = poly.size();
-
-  QVector<double> x( nVertices );
-  QVector<double> y( nVertices );
-  QVector<double> z( nVertices );
-
-  for ( int i = 0; i < nVertices; ++i )
+  if ( nVertices == 0 )
   {
-    const QPointF& pt = poly.at( i );
-    x[i] = pt.x();
-    y[i] = pt.y();
-    z[i] = 0;
+    return;
   }
 
   try
   {
-    transformCoords( nVertices, x.data(), y.data(), z.data(), direction );
+    if ( sizeof( qreal ) == sizeof( double ) )
+    {
+      // QPointF stores x and y next to each other, transform them in place
+      QPointF* data = poly.data();
+      transformStridedCoords( nVertices, reinterpret_cast<double*>( &data->rx() ), reinterpret_cast<double*>( &data->ry() ), 0,
+                              sizeof( QPointF ) / sizeof( double ), direction );
+      return;
+    }
+
+    //qreal is float, create x, y arrays
+    QVector<double> x( nVertices );
+    QVector<double> y( nVertices );
+
+    for ( int i = 0; i < nVertices; ++i )
+    {
+      const QPointF& pt = poly.at( i );
+      x[i] = pt.x();
+      y[i] = pt.y();
+    }
+
+    transformStridedCoords( nVertices, x.data(), y.data(), 0, 1, direction );
+
+    for ( int i = 0; i < nVertices; ++i )
+    {
+      QPointF& pt = poly[i];
+      pt.rx() = x[i];
+      pt.ry() = y[i];
+    }
   }
   catch ( const QgsCsException & )
   {
@@ -437,13 +649,6 @@ void QgsCoordinateTransform::transformPolygon( QPolygonF& poly, TransformDirecti
     QgsDebugMsg( "rethrowing exception" );
     throw;
   }
-
-  for ( int i = 0; i < nVertices; ++i )
-  {
-    QPointF& pt = poly[i];
-    pt.rx() = x[i];
-    pt.ry() = y[i];
-  }
 }
 
 void QgsCoordinateTransform::transformInPlace(
@@ -627,6 +832,14 @@ QgsRectangle QgsCoordinateTransform::transformBoundingBox( const QgsRectangle &r
 
 void QgsCoordinateTransform::transformCoords( const int& numPoints, double *x, double *y, double *z, TransformDirection direction ) const
 {
+  transformStridedCoords( numPoints, x, y, z, 1, direction );
+}
+
+void QgsCoordinateTransform::transformStridedCoords( int numPoints, double *x, double *y, double *z, int stride, TransformDirection direction ) const
+{
+  if ( mShortCircuit || !mInitialisedFlag || numPoints <= 0 )
+    return;
+
   // Refuse to transform the points if the srs's are invalid
   if ( !mSourceCRS.isValid() )
   {
@@ -648,31 +861,40 @@ void QgsCoordinateTransform::transformCoords( const int& numPoints, double *x, d
   QgsDebugMsg( QString( "[[[[[[ Number of points to transform: %1 ]]]]]]" ).arg( numPoints ) );
 #endif
 
+  projPJ sourceProj = sourceProjection();
+  projPJ destProj = destinationProjection();
+  if ( !sourceProj || !destProj )
+  {
+    QgsDebugMsg( "Transform not initialised" );
+    return;
+  }
+
+  const int last = ( numPoints - 1 ) * stride;
+
   // use proj4 to do the transform
   QString dir;
   // if the source/destination projection is lat/long, convert the points to radians
   // prior to transforming
-  if (( pj_is_latlong( mDestinationProjection ) && ( direction == ReverseTransform ) )
-      || ( pj_is_latlong( mSourceProjection ) && ( direction == ForwardTransform ) ) )
+  if (( pj_is_latlong( destProj ) && ( direction == ReverseTransform ) )
+      || ( pj_is_latlong( sourceProj ) && ( direction == ForwardTransform ) ) )
   {
-    for ( int i = 0; i < numPoints; ++i )
+    for ( int i = 0; i <= last; i += stride )
     {
       x[i] *= DEG_TO_RAD;
       y[i] *= DEG_TO_RAD;
-      z[i] *= DEG_TO_RAD;
+      if ( z )
+        z[i] *= DEG_TO_RAD;
     }
 
   }
   int projResult;
   if ( direction == ReverseTransform )
   {
-    projResult = pj_transform( mDestinationProjection, mSourceProjection, numPoints, 0, x, y, z );
+    projResult = pj_transform( destProj, sourceProj, numPoints, stride, x, y, z );
   }
   else
   {
-    Q_ASSERT( mSourceProjection != 0 );
-    Q_ASSERT( mDestinationProjection != 0 );
-    projResult = pj_transform( mSourceProjection, mDestinationProjection, numPoints, 0, x, y, z );
+    projResult = pj_transform( sourceProj, destProj, numPoints, stride, x, y, z );
   }
 
   if ( projResult != 0 )
@@ -680,7 +902,7 @@ void QgsCoordinateTransform::transformCoords( const int& numPoints, double *x, d
     //something bad happened....
     QString points;
 
-    for ( int i = 0; i < numPoints; ++i )
+    for ( int i = 0; i <= last; i += stride )
     {
       if ( direction == ForwardTransform )
       {
@@ -694,8 +916,8 @@ void QgsCoordinateTransform::transformCoords( const int& numPoints, double *x, d
 
     dir = ( direction == ForwardTransform ) ? tr( "forward transform" ) : tr( "inverse transform" );
 
-    char *srcdef = pj_get_def( mSourceProjection, 0 );
-    char *dstdef = pj_get_def( mDestinationProjection, 0 );
+    char *srcdef = pj_get_def( sourceProj, 0 );
+    char *dstdef = pj_get_def( destProj, 0 );
 
     QString msg = tr( "%1 of\n"
                       "%2"
@@ -720,14 +942,15 @@ void QgsCoordinateTransform::transformCoords( const int& numPoints, double *x, d
 
   // if the result is lat/long, convert the results from radians back
   // to degrees
-  if (( pj_is_latlong( mDestinationProjection ) && ( direction == ForwardTransform ) )
-      || ( pj_is_latlong( mSourceProjection ) && ( direction == ReverseTransform ) ) )
+  if (( pj_is_latlong( destProj ) && ( direction == ForwardTransform ) )
+      || ( pj_is_latlong( sourceProj ) && ( direction == ReverseTransform ) ) )
   {
-    for ( int i = 0; i < numPoints; ++i )
+    for ( int i = 0; i <= last; i += stride )
     {
       x[i] *= RAD_TO_DEG;
       y[i] *= RAD_TO_DEG;
-      z[i] *= RAD_TO_DEG;
+      if ( z )
+        z[i] *= RAD_TO_DEG;
     }
   }
 #ifdef COORDINATE_TRANSFORM_VERBOSE
@@ -776,6 +999,16 @@ bool QgsCoordinateTransform::writeXML( QDomNode & theNode, QDomDocument & theDoc
   return true;
 }
 
+projPJ QgsCoordinateTransform::sourceProjection() const
+{
+  return threadProjection( mSourceProjId );
+}
+
+projPJ QgsCoordinateTransform::destinationProjection() const
+{
+  return threadProjection( mDestinationProjId );
+}
+
 const char *finder( const char *name )
 {
   QString proj;
@@ -192,6 +192,21 @@ class CORE_EXPORT QgsCoordinateTransform : public QObject
      */
     void transformCoords( const int &numPoint, double *x, double *y, double *z, TransformDirection direction = ForwardTransform ) const;
 
+    /** Transform a batch of coordinates in place, reading them directly from interleaved
+     * storage. Consecutive x (and y, z) values are \a stride doubles apart, so e.g. the points of
+     * a QPolygonF or a packed x/y(/z) vertex buffer can be transformed without first copying them
+     * into separate coordinate arrays. Nothing is done if the transform is short circuited.
+     * @param numPoints number of points to transform
+     * @param x pointer to the first x coordinate
+     * @param y pointer to the first y coordinate
+     * @param z pointer to the first z coordinate or 0 if there are no z values
+     * @param stride distance between two consecutive values of a coordinate, in doubles
+     * @param direction TransformDirection (defaults to ForwardTransform)
+     * @note added in QGIS 2.12
+     * @note not available in python bindings
+     */
+    void transformStridedCoords( int numPoints, double *x, double *y, double *z, int stride, TransformDirection direction = ForwardTransform ) const;
+
     /*!
      * Flag to indicate whether the coordinate systems have been initialised
      * @return true if initialised, otherwise false
@@ -201,7 +216,7 @@ class CORE_EXPORT QgsCoordinateTransform : public QObject
     /** See if the transform short circuits because src and dest are equivalent
      * @return bool True if it short circuits
      */
-    bool isShortCircuited() {return mShortCircuit;}
+    bool isShortCircuited() const {return mShortCircuit;}
 
     /** Change the destination coordinate system by passing it a qgis srsid
     * A QGIS srsid is a unique key value to an entry on the tbl_srs in the
@@ -273,14 +288,22 @@ class CORE_EXPORT QgsCoordinateTransform : public QObject
     QgsCoordinateReferenceSystem mDestCRS;
 
     /*!
-     * Proj4 data structure of the source projection (layer coordinate system)
+     * Id of the proj4 definition of the source projection (layer coordinate system).
+     * Proj4 data structures must not be shared between threads, so the actual handle is
+     * created lazily for each thread using the transform, see sourceProjection()
      */
-    projPJ mSourceProjection;
+    int mSourceProjId;
 
     /*!
-     * Proj4 data structure of the destination projection (map canvas coordinate system)
+     * Id of the proj4 definition of the destination projection (map canvas coordinate system)
      */
-    projPJ mDestinationProjection;
+    int mDestinationProjId;
+
+    /** Returns proj4 data structure of the source projection, valid for the calling thread only */
+    projPJ sourceProjection() const;
+
+    /** Returns proj4 data structure of the destination projection, valid for the calling thread only */
+    projPJ destinationProjection() const;
 
     int mSourceDatumTransform;
     int mDestinationDatumTransform;
@@ -18,6 +18,9 @@
 #include "qgscrscache.h"
 #include "qgscoordinatetransform.h"
 
+#include <QReadLocker>
+#include <QWriteLocker>
+
 
 QgsCoordinateTransformCache* QgsCoordinateTransformCache::instance()
 {
@@ -27,44 +30,81 @@ QgsCoordinateTransformCache* QgsCoordinateTransformCache::instance()
 
 QgsCoordinateTransformCache::~QgsCoordinateTransformCache()
 {
-  QHash< QPair< QString, QString >, QgsCoordinateTransform* >::const_iterator tIt = mTransforms.constBegin();
-  for ( ; tIt != mTransforms.constEnd(); ++tIt )
+}
+
+QgsCoordinateTransformCache::TransformPtr QgsCoordinateTransformCache::findTransform( const QString& srcAuthId, const QString& destAuthId, int srcDatumTransform, int destDatumTransform ) const
+{
+  QHash< QPair< QString, QString >, TransformPtr >::const_iterator valIt = mTransforms.constFind( qMakePair( srcAuthId, destAuthId ) );
+  for ( ; valIt != mTransforms.constEnd() && valIt.key().first == srcAuthId && valIt.key().second == destAuthId; ++valIt )
   {
-    delete tIt.value();
+    if ( valIt.value() &&
+         valIt.value()->sourceDatumTransform() == srcDatumTransform &&
+         valIt.value()->destinationDatumTransform() == destDatumTransform )
+    {
+      return valIt.value();
+    }
   }
+  return TransformPtr();
 }
 
 const QgsCoordinateTransform* QgsCoordinateTransformCache::transform( const QString& srcAuthId, const QString& destAuthId, int srcDatumTransform, int destDatumTransform )
 {
-  QList< QgsCoordinateTransform* > values =
-    mTransforms.values( qMakePair( srcAuthId, destAuthId ) );
+  TransformPtr ct = sharedTransform( srcAuthId, destAuthId, srcDatumTransform, destDatumTransform );
 
-  QList< QgsCoordinateTransform* >::const_iterator valIt = values.constBegin();
-  for ( ; valIt != values.constEnd(); ++valIt )
   {
-    if ( *valIt &&
-         ( *valIt )->sourceDatumTransform() == srcDatumTransform &&
-         ( *valIt )->destinationDatumTransform() == destDatumTransform )
+    QReadLocker locker( &mLock );
+    if ( mLentTransforms.contains( ct.data() ) )
+      return ct.data();
+  }
+
+  // the caller does not share ownership, so the transform has to outlive its invalidation
+  QWriteLocker locker( &mLock );
+  mLentTransforms.insert( ct.data(), ct );
+  return ct.data();
+}
+
+QSharedPointer<const QgsCoordinateTransform> QgsCoordinateTransformCache::sharedTransform( const QString& srcAuthId, const QString& destAuthId, int srcDatumTransform, int destDatumTransform )
+{
+  {
+    QReadLocker locker( &mLock );
+    TransformPtr ct = findTransform( srcAuthId, destAuthId, srcDatumTransform, destDatumTransform );
+    if ( ct )
     {
-      return *valIt;
+      mHits.ref();
+      return ct;
     }
   }
 
-  //not found, insert new value
-  const QgsCoordinateReferenceSystem& srcCrs = QgsCRSCache::instance()->crsByAuthId( srcAuthId );
-  const QgsCoordinateReferenceSystem& destCrs = QgsCRSCache::instance()->crsByAuthId( destAuthId );
+  //not found, create the transform outside of the lock as this may be slow
+  QgsCoordinateReferenceSystem srcCrs = QgsCRSCache::instance()->crsByAuthId( srcAuthId );
+  QgsCoordinateReferenceSystem destCrs = QgsCRSCache::instance()->crsByAuthId( destAuthId );
   QgsCoordinateTransform* ct = new QgsCoordinateTransform( srcCrs, destCrs );
   ct->setSourceDatumTransform( srcDatumTransform );
   ct->setDestinationDatumTransform( destDatumTransform );
   ct->initialise();
-  mTransforms.insertMulti( qMakePair( srcAuthId, destAuthId ), ct );
-  return ct;
+
+  QWriteLocker locker( &mLock );
+  //another thread may have been faster
+  TransformPtr existing = findTransform( srcAuthId, destAuthId, srcDatumTransform, destDatumTransform );
+  if ( existing )
+  {
+    delete ct;
+    mHits.ref();
+    return existing;
+  }
+
+  mMisses.ref();
+  TransformPtr shared( ct );
+  mTransforms.insertMulti( qMakePair( srcAuthId, destAuthId ), shared );
+  return shared;
 }
 
 void QgsCoordinateTransformCache::invalidateCrs( const QString& crsAuthId )
 {
+  QWriteLocker locker( &mLock );
+
   //get keys to remove first
-  QHash< QPair< QString, QString >, QgsCoordinateTransform* >::const_iterator it = mTransforms.constBegin();
+  QHash< QPair< QString, QString >, TransformPtr >::const_iterator it = mTransforms.constBegin();
   QList< QPair< QString, QString > > updateList;
 
   for ( ; it != mTransforms.constEnd(); ++it )
@@ -75,7 +115,7 @@ void QgsCoordinateTransformCache::invalidateCrs( const QString& crsAuthId )
     }
   }
 
-  //and remove after
+  //and remove after. Transforms still in use are deleted by their last user.
   QList< QPair< QString, QString > >::const_iterator updateIt = updateList.constBegin();
   for ( ; updateIt != updateList.constEnd(); ++updateIt )
   {
@@ -83,6 +123,12 @@ void QgsCoordinateTransformCache::invalidateCrs( const QString& crsAuthId )
   }
 }
 
+void QgsCoordinateTransformCache::resetStatistics()
+{
+  mHits = 0;
+  mMisses = 0;
+}
+
 
 QgsCRSCache* QgsCRSCache::instance()
 {
@@ -101,37 +147,117 @@ QgsCRSCache::~QgsCRSCache()
 void QgsCRSCache::updateCRSCache( const QString& authid )
 {
   QgsCoordinateReferenceSystem s;
-  if ( s.createFromOgcWmsCrs( authid ) )
-  {
-    mCRS.insert( authid, s );
-  }
-  else
+  bool valid = s.createFromOgcWmsCrs( authid );
+
   {
-    mCRS.remove( authid );
+    QWriteLocker locker( &mLock );
+    if ( valid )
+    {
+      mCRS.insert( authid, s );
+    }
+    else
+    {
+      mCRS.remove( authid );
+    }
+    // srs id and proj4 entries of a changed (user) CRS are outdated as well
+    mCRSSrsId.clear();
+    mCRSProj4.clear();
   }
 
   QgsCoordinateTransformCache::instance()->invalidateCrs( authid );
 }
 
-const QgsCoordinateReferenceSystem& QgsCRSCache::crsByAuthId( const QString& authid )
+QgsCoordinateReferenceSystem QgsCRSCache::crsByAuthId( const QString& authid )
 {
-  QHash< QString, QgsCoordinateReferenceSystem >::const_iterator crsIt = mCRS.find( authid );
-  if ( crsIt == mCRS.constEnd() )
   {
-    QgsCoordinateReferenceSystem s;
-    if ( ! s.createFromOgcWmsCrs( authid ) )
+    QReadLocker locker( &mLock );
+    QHash< QString, QgsCoordinateReferenceSystem >::const_iterator crsIt = mCRS.constFind( authid );
+    if ( crsIt != mCRS.constEnd() )
     {
-      return mInvalidCRS;
+      mHits.ref();
+      return crsIt.value();
     }
-    return mCRS.insert( authid, s ).value();
   }
-  else
+
+  mMisses.ref();
+  QgsCoordinateReferenceSystem s;
+  if ( ! s.createFromOgcWmsCrs( authid ) )
+  {
+    return mInvalidCRS;
+  }
+
+  QWriteLocker locker( &mLock );
+  QHash< QString, QgsCoordinateReferenceSystem >::iterator crsIt = mCRS.find( authid );
+  if ( crsIt != mCRS.end() )
   {
     return crsIt.value();
   }
+  return mCRS.insert( authid, s ).value();
 }
 
-const QgsCoordinateReferenceSystem& QgsCRSCache::crsByEpsgId( long epsg )
+QgsCoordinateReferenceSystem QgsCRSCache::crsByEpsgId( long epsg )
 {
   return crsByAuthId( "EPSG:" + QString::number( epsg ) );
 }
+
+QgsCoordinateReferenceSystem QgsCRSCache::crsBySrsId( long srsId )
+{
+  {
+    QReadLocker locker( &mLock );
+    QHash< long, QgsCoordinateReferenceSystem >::const_iterator crsIt = mCRSSrsId.constFind( srsId );
+    if ( crsIt != mCRSSrsId.constEnd() )
+    {
+      mHits.ref();
+      return crsIt.value();
+    }
+  }
+
+  mMisses.ref();
+  QgsCoordinateReferenceSystem s;
+  if ( ! s.createFromSrsId( srsId ) )
+  {
+    return mInvalidCRS;
+  }
+
+  QWriteLocker locker( &mLock );
+  QHash< long, QgsCoordinateReferenceSystem >::iterator crsIt = mCRSSrsId.find( srsId );
+  if ( crsIt != mCRSSrsId.end() )
+  {
+    return crsIt.value();
+  }
+  return mCRSSrsId.insert( srsId, s ).value();
+}
+
+QgsCoordinateReferenceSystem QgsCRSCache::crsByProj4( const QString& proj4 )
+{
+  {
+    QReadLocker locker( &mLock );
+    QHash< QString, QgsCoordinateReferenceSystem >::const_iterator crsIt = mCRSProj4.constFind( proj4 );
+    if ( crsIt != mCRSProj4.constEnd() )
+    {
+      mHits.ref();
+      return crsIt.value();
+    }
+  }
+
+  mMisses.ref();
+  QgsCoordinateReferenceSystem s;
+  if ( ! s.createFromProj4( proj4 ) )
+  {
+    return mInvalidCRS;
+  }
+
+  QWriteLocker locker( &mLock );
+  QHash< QString, QgsCoordinateReferenceSystem >::iterator crsIt = mCRSProj4.find( proj4 );
+  if ( crsIt != mCRSProj4.end() )
+  {
+    return crsIt.value();
+  }
+  return mCRSProj4.insert( proj4, s ).value();
+}
+
+void QgsCRSCache::resetStatistics()
+{
+  mHits = 0;
+  mMisses = 0;
+}
@@ -20,49 +20,111 @@
 
 #include "qgscoordinatereferencesystem.h"
 #include <QHash>
+#include <QReadWriteLock>
+#include <QSharedPointer>
+#include <QAtomicInt>
 
 class QgsCoordinateTransform;
 
 /** Cache coordinate transform by authid of source/dest transformation to avoid the
-overhead of initialisation for each redraw*/
+overhead of initialisation for each redraw.
+
+The cache is shared by the whole process and may be used from several threads
+(e.g. parallel render jobs or server workers). Cached transforms can be used
+concurrently, as proj handles are created separately for each thread.*/
 class CORE_EXPORT QgsCoordinateTransformCache
 {
   public:
     static QgsCoordinateTransformCache* instance();
     ~QgsCoordinateTransformCache();
-    /** Returns coordinate transformation. Cache keeps ownership
+    /** Returns coordinate transformation. Cache keeps ownership. As the caller does not
+        share ownership, a transform returned here is kept until the end of the session even
+        if it is removed from the cache by invalidateCrs(). Prefer sharedTransform().
         @param srcAuthId auth id string of source crs
         @param destAuthId auth id string of dest crs
         @param srcDatumTransform id of source's datum transform
         @param destDatumTransform id of destinations's datum transform
      */
     const QgsCoordinateTransform* transform( const QString& srcAuthId, const QString& destAuthId, int srcDatumTransform = -1, int destDatumTransform = -1 );
+
+    /** Returns coordinate transformation shared with the cache. A transform removed from
+     * the cache by invalidateCrs() is deleted once its last user drops it.
+     * @note added in 2.12
+     * @note not available in python bindings
+     */
+    QSharedPointer<const QgsCoordinateTransform> sharedTransform( const QString& srcAuthId, const QString& destAuthId, int srcDatumTransform = -1, int destDatumTransform = -1 );
+
     /** Removes transformations where a changed crs is involved from the cache*/
     void invalidateCrs( const QString& crsAuthId );
 
+    /** Returns number of transform requests answered from the cache
+     * @note added in 2.12 */
+    int hits() const { return mHits; }
+    /** Returns number of transform requests which required a new transform to be created
+     * @note added in 2.12 */
+    int misses() const { return mMisses; }
+    /** Resets the hit and miss counters
+     * @note added in 2.12 */
+    void resetStatistics();
+
   private:
     static QgsCoordinateTransformCache* mInstance;
-    QMultiHash< QPair< QString, QString >, QgsCoordinateTransform* > mTransforms; //same auth_id pairs might have different datum transformations
+    typedef QSharedPointer<const QgsCoordinateTransform> TransformPtr;
+
+    QMultiHash< QPair< QString, QString >, TransformPtr > mTransforms; //same auth_id pairs might have different datum transformations
+    //! Transforms handed out by transform() without shared ownership, they are never deleted
+    QHash< const QgsCoordinateTransform*, TransformPtr > mLentTransforms;
+    mutable QReadWriteLock mLock;
+    QAtomicInt mHits;
+    QAtomicInt mMisses;
+
+    TransformPtr findTransform( const QString& srcAuthId, const QString& destAuthId, int srcDatumTransform, int destDatumTransform ) const;
 };
 
+/** Cache of coordinate reference systems, avoiding the database lookups needed to
+ * create a CRS. The cache is shared by the whole process and may be used from several threads.
+ */
 class CORE_EXPORT QgsCRSCache
 {
   public:
     static QgsCRSCache* instance();
     ~QgsCRSCache();
     /** Returns the CRS for authid, e.g. 'EPSG:4326' (or an invalid CRS in case of error)*/
-    const QgsCoordinateReferenceSystem& crsByAuthId( const QString& authid );
-    const QgsCoordinateReferenceSystem& crsByEpsgId( long epsg );
+    QgsCoordinateReferenceSystem crsByAuthId( const QString& authid );
+    QgsCoordinateReferenceSystem crsByEpsgId( long epsg );
+
+    /** Returns the CRS for a QGIS internal srs id (or an invalid CRS in case of error)
+     * @note added in 2.12 */
+    QgsCoordinateReferenceSystem crsBySrsId( long srsId );
+
+    /** Returns the CRS for a proj4 string (or an invalid CRS in case of error)
+     * @note added in 2.12 */
+    QgsCoordinateReferenceSystem crsByProj4( const QString& proj4 );
 
     void updateCRSCache( const QString &authid );
 
+    /** Returns number of CRS requests answered from the cache
+     * @note added in 2.12 */
+    int hits() const { return mHits; }
+    /** Returns number of CRS requests which required a database lookup
+     * @note added in 2.12 */
+    int misses() const { return mMisses; }
+    /** Resets the hit and miss counters
+     * @note added in 2.12 */
+    void resetStatistics();
+
   protected:
     QgsCRSCache();
 
   private:
     QHash< QString, QgsCoordinateReferenceSystem > mCRS;
+    QHash< long, QgsCoordinateReferenceSystem > mCRSSrsId;
+    QHash< QString, QgsCoordinateReferenceSystem > mCRSProj4;
     /** CRS that is not initialised (returned in case of error)*/
     QgsCoordinateReferenceSystem mInvalidCRS;
+    mutable QReadWriteLock mLock;
+    QAtomicInt mHits;
+    QAtomicInt mMisses;
 };
 
 #endif // QGSCRSCACHE_H
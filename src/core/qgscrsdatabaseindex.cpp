@@ -0,0 +1,283 @@
+/***************************************************************************
+                              qgscrsdatabaseindex.cpp
+                              -----------------------
+  begin                : October 2015
+  copyright            : (C) 2015 by the QGIS project
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgscrsdatabaseindex.h"
+#include "qgsapplication.h"
+#include "qgslogger.h"
+
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRegExp>
+
+#include <sqlite3.h>
+
+QgsCrsDatabaseIndex* QgsCrsDatabaseIndex::instance()
+{
+  static QgsCrsDatabaseIndex sInstance;
+  return &sInstance;
+}
+
+QgsCrsDatabaseIndex::QgsCrsDatabaseIndex()
+    : mLoaded( false )
+    , mValid( false )
+{
+}
+
+bool QgsCrsDatabaseIndex::isValid()
+{
+  QMutexLocker locker( &mMutex );
+  return ensureLoaded();
+}
+
+bool QgsCrsDatabaseIndex::recordByAuthId( const QString& authId, QgsCrsDatabaseRecord& record )
+{
+  QMutexLocker locker( &mMutex );
+  if ( !ensureLoaded() )
+    return false;
+
+  int idx = mAuthIdIndex.value( authId.toLower(), -1 );
+  if ( idx < 0 )
+    return false;
+
+  record = mRecords.at( idx );
+  return true;
+}
+
+bool QgsCrsDatabaseIndex::recordBySrsId( long srsId, QgsCrsDatabaseRecord& record )
+{
+  QMutexLocker locker( &mMutex );
+  if ( !ensureLoaded() )
+    return false;
+
+  int idx = mSrsIdIndex.value( srsId, -1 );
+  if ( idx < 0 )
+    return false;
+
+  record = mRecords.at( idx );
+  return true;
+}
+
+bool QgsCrsDatabaseIndex::recordBySrid( long srid, QgsCrsDatabaseRecord& record )
+{
+  QMutexLocker locker( &mMutex );
+  if ( !ensureLoaded() )
+    return false;
+
+  int idx = mSridIndex.value( srid, -1 );
+  if ( idx < 0 )
+    return false;
+
+  record = mRecords.at( idx );
+  return true;
+}
+
+bool QgsCrsDatabaseIndex::recordByParameters( const QString& proj4, QgsCrsDatabaseRecord& record )
+{
+  QMutexLocker locker( &mMutex );
+  if ( !ensureLoaded() )
+    return false;
+
+  int idx = mParametersIndex.value( proj4.trimmed(), -1 );
+  if ( idx < 0 )
+    return false;
+
+  record = mRecords.at( idx );
+  return true;
+}
+
+bool QgsCrsDatabaseIndex::recordByParameterSet( const QString& proj4, QgsCrsDatabaseRecord& record )
+{
+  QMutexLocker locker( &mMutex );
+  if ( !ensureLoaded() )
+    return false;
+
+  QString datum;
+  QString key = parameterSetKey( proj4Parameters( proj4 ), &datum );
+  QList<int> candidates = mParameterSetIndex.values( key );
+  if ( candidates.isEmpty() )
+    return false;
+
+  // QMultiHash returns the most recently inserted value first, restore database order
+  // so that the first candidate is the one the former "order by deprecated" queries returned
+  qSort( candidates );
+
+  if ( !datum.isEmpty() )
+  {
+    // prefer definitions with the same datum
+    Q_FOREACH ( int idx, candidates )
+    {
+      if ( proj4Parameters( mRecords.at( idx ).parameters ).contains( datum ) )
+      {
+        record = mRecords.at( idx );
+        return true;
+      }
+    }
+  }
+
+  record = mRecords.at( candidates.first() );
+  return true;
+}
+
+QList<QgsCrsDatabaseRecord> QgsCrsDatabaseIndex::recordsByAcronyms( const QString& projectionAcronym, const QString& ellipsoidAcronym )
+{
+  QList<QgsCrsDatabaseRecord> records;
+
+  QMutexLocker locker( &mMutex );
+  if ( !ensureLoaded() )
+    return records;
+
+  // QMultiHash returns the most recently inserted value first, restore database order
+  QList<int> indexes = mAcronymIndex.values( qMakePair( projectionAcronym, ellipsoidAcronym ) );
+  qSort( indexes );
+  Q_FOREACH ( int idx, indexes )
+  {
+    records << mRecords.at( idx );
+  }
+  return records;
+}
+
+void QgsCrsDatabaseIndex::invalidate()
+{
+  QMutexLocker locker( &mMutex );
+  clear();
+}
+
+QStringList QgsCrsDatabaseIndex::proj4Parameters( const QString& proj4 )
+{
+  // split on spaces followed by a plus sign (+) to deal
+  // also with parameters containing spaces (e.g. +nadgrids)
+  QStringList params;
+  Q_FOREACH ( const QString& param, proj4.split( QRegExp( "\\s+(?=\\+)" ), QString::SkipEmptyParts ) )
+  {
+    QString trimmed = param.trimmed();
+    if ( !trimmed.isEmpty() )
+      params << trimmed;
+  }
+  return params;
+}
+
+QString QgsCrsDatabaseIndex::parameterSetKey( const QStringList& params, QString* datum )
+{
+  QStringList keyParams;
+  Q_FOREACH ( const QString& param, params )
+  {
+    if ( param.startsWith( "+datum=" ) )
+    {
+      if ( datum )
+        *datum = param;
+    }
+    else
+    {
+      keyParams << param;
+    }
+  }
+  keyParams.sort();
+  return keyParams.join( " " );
+}
+
+bool QgsCrsDatabaseIndex::ensureLoaded()
+{
+  QString dbPath = QgsApplication::srsDbFilePath();
+  if ( mLoaded && dbPath == mDbPath )
+    return mValid;
+
+  clear();
+  mDbPath = dbPath;
+  mValid = load( dbPath );
+  mLoaded = true;
+  return mValid;
+}
+
+bool QgsCrsDatabaseIndex::load( const QString& dbPath )
+{
+  if ( !QFileInfo( dbPath ).exists() )
+  {
+    QgsDebugMsg( "failed : " + dbPath + " does not exist!" );
+    return false;
+  }
+
+  sqlite3 *database;
+  if ( sqlite3_open_v2( dbPath.toUtf8().constData(), &database, SQLITE_OPEN_READONLY, NULL ) != SQLITE_OK )
+  {
+    QgsDebugMsg( "failed : " + dbPath + " could not be opened!" );
+    sqlite3_close( database );
+    return false;
+  }
+
+  // preferred (non deprecated) definitions first, so that the first definition
+  // inserted for a key is the one the former "order by deprecated" queries returned
+  const char *sql = "SELECT srs_id,description,projection_acronym,ellipsoid_acronym,parameters,"
+                    "srid,auth_name||':'||auth_id,is_geo,deprecated FROM tbl_srs ORDER BY deprecated,srs_id";
+
+  sqlite3_stmt *stmt;
+  if ( sqlite3_prepare_v2( database, sql, -1, &stmt, NULL ) != SQLITE_OK )
+  {
+    QgsDebugMsg( QString( "failed : %1" ).arg( sql ) );
+    sqlite3_close( database );
+    return false;
+  }
+
+  while ( sqlite3_step( stmt ) == SQLITE_ROW )
+  {
+    QgsCrsDatabaseRecord rec;
+    rec.srsId = sqlite3_column_int64( stmt, 0 );
+    rec.description = QString::fromUtf8(( const char * ) sqlite3_column_text( stmt, 1 ) );
+    rec.projectionAcronym = QString::fromUtf8(( const char * ) sqlite3_column_text( stmt, 2 ) );
+    rec.ellipsoidAcronym = QString::fromUtf8(( const char * ) sqlite3_column_text( stmt, 3 ) );
+    rec.parameters = QString::fromUtf8(( const char * ) sqlite3_column_text( stmt, 4 ) ).trimmed();
+    rec.srid = sqlite3_column_int64( stmt, 5 );
+    rec.authId = QString::fromUtf8(( const char * ) sqlite3_column_text( stmt, 6 ) );
+    rec.isGeo = sqlite3_column_int( stmt, 7 ) != 0;
+    rec.deprecated = sqlite3_column_int( stmt, 8 ) != 0;
+
+    int idx = mRecords.size();
+    mRecords << rec;
+
+    QString authId = rec.authId.toLower();
+    if ( !mAuthIdIndex.contains( authId ) )
+      mAuthIdIndex.insert( authId, idx );
+    if ( !mSrsIdIndex.contains( rec.srsId ) )
+      mSrsIdIndex.insert( rec.srsId, idx );
+    if ( !mSridIndex.contains( rec.srid ) )
+      mSridIndex.insert( rec.srid, idx );
+
+    // definitions sharing a proj4 string resolve to the first one, like the former queries
+    if ( !mParametersIndex.contains( rec.parameters ) )
+      mParametersIndex.insert( rec.parameters, idx );
+
+    mParameterSetIndex.insert( parameterSetKey( proj4Parameters( rec.parameters ), 0 ), idx );
+    mAcronymIndex.insert( qMakePair( rec.projectionAcronym, rec.ellipsoidAcronym ), idx );
+  }
+
+  sqlite3_finalize( stmt );
+  sqlite3_close( database );
+
+  QgsDebugMsg( QString( "%1 CRS definitions loaded from %2" ).arg( mRecords.size() ).arg( dbPath ) );
+  return !mRecords.isEmpty();
+}
+
+void QgsCrsDatabaseIndex::clear()
+{
+  mLoaded = false;
+  mValid = false;
+  mRecords.clear();
+  mAuthIdIndex.clear();
+  mSrsIdIndex.clear();
+  mSridIndex.clear();
+  mParametersIndex.clear();
+  mParameterSetIndex.clear();
+  mAcronymIndex.clear();
+}
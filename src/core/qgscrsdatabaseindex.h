@@ -0,0 +1,129 @@
+/***************************************************************************
+                              qgscrsdatabaseindex.h
+                              ---------------------
+  begin                : October 2015
+  copyright            : (C) 2015 by the QGIS project
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSCRSDATABASEINDEX_H
+#define QGSCRSDATABASEINDEX_H
+
+#include <QHash>
+#include <QMultiHash>
+#include <QMutex>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/** \ingroup core
+ * A single CRS definition of the system srs.db.
+ * @note added in 2.12
+ * @note not available in python bindings
+ */
+struct CORE_EXPORT QgsCrsDatabaseRecord
+{
+  long srsId;
+  QString description;
+  QString projectionAcronym;
+  QString ellipsoidAcronym;
+  //! proj4 definition (trimmed)
+  QString parameters;
+  long srid;
+  //! authority identifier, e.g. EPSG:4326
+  QString authId;
+  bool isGeo;
+  bool deprecated;
+};
+
+/** \ingroup core
+ * In-memory index of the CRS definitions in the system srs.db.
+ *
+ * The database is read once, the first time the index is used. Afterwards CRS lookups
+ * by auth id, srs id, srid and proj4 definition are answered from hash tables and never
+ * open the sqlite database again. The user database (qgis.db) is not indexed, as custom
+ * CRS may change at any time.
+ *
+ * Lookups honour the same precedence as the sql queries they replace: non deprecated
+ * definitions are preferred over deprecated ones, and among those the definition with
+ * the lowest srs id is returned if several match.
+ *
+ * The index may be used from several threads at once.
+ *
+ * @note added in 2.12
+ * @note not available in python bindings
+ */
+class CORE_EXPORT QgsCrsDatabaseIndex
+{
+  public:
+    //! Returns the index for the current system srs.db (see QgsApplication::srsDbFilePath())
+    static QgsCrsDatabaseIndex* instance();
+
+    //! Returns true if the database could be read
+    bool isValid();
+
+    //! Finds definition with given auth id (case insensitive). Returns false if there is none.
+    bool recordByAuthId( const QString& authId, QgsCrsDatabaseRecord& record );
+
+    //! Finds definition with given QGIS srs id. Returns false if there is none.
+    bool recordBySrsId( long srsId, QgsCrsDatabaseRecord& record );
+
+    //! Finds definition with given postgis srid. Returns false if there is none.
+    bool recordBySrid( long srid, QgsCrsDatabaseRecord& record );
+
+    /** Finds the definition with exactly the given proj4 string.
+     * Returns false if there is no such definition.
+     */
+    bool recordByParameters( const QString& proj4, QgsCrsDatabaseRecord& record );
+
+    /** Finds the definition with the same set of proj4 parameters, ignoring their
+     * order. A datum (+datum=) is used to pick a definition if several match,
+     * but is not required to be present in the definition.
+     * Returns false if there is no such definition.
+     */
+    bool recordByParameterSet( const QString& proj4, QgsCrsDatabaseRecord& record );
+
+    //! Returns all definitions with given projection and ellipsoid acronyms, preferred ones first
+    QList<QgsCrsDatabaseRecord> recordsByAcronyms( const QString& projectionAcronym, const QString& ellipsoidAcronym );
+
+    //! Drops the loaded definitions, they will be reloaded on next use
+    void invalidate();
+
+    //! Splits a proj4 string into its parameters
+    static QStringList proj4Parameters( const QString& proj4 );
+
+  private:
+    QgsCrsDatabaseIndex();
+
+    //! Loads the database, if not done yet. Returns true if the index is usable. Must be called with locked mutex.
+    bool ensureLoaded();
+    bool load( const QString& dbPath );
+    void clear();
+
+    //! Returns key of the parameters (without datum) used for the parameter set lookup
+    static QString parameterSetKey( const QStringList& params, QString* datum );
+
+    QMutex mMutex;
+    QString mDbPath;
+    bool mLoaded;
+    bool mValid;
+
+    QVector<QgsCrsDatabaseRecord> mRecords;
+    QHash<QString, int> mAuthIdIndex;
+    QHash<long, int> mSrsIdIndex;
+    QHash<long, int> mSridIndex;
+    QHash<QString, int> mParametersIndex;
+    QMultiHash<QString, int> mParameterSetIndex;
+    QMultiHash< QPair<QString, QString>, int > mAcronymIndex;
+};
+
+#endif // QGSCRSDATABASEINDEX_H
@@ -19,6 +19,12 @@
 #include "qgslogger.h"
 #include "qgsmaplayer.h"
 
+#include <QMutex>
+#include <QMutexLocker>
+
+//! guards the transforms held by all stores, as copies of map settings are used from several threads
+static QMutex sTransformsMutex;
+
 QgsDatumTransformStore::QgsDatumTransformStore( const QgsCoordinateReferenceSystem& destCrs )
     : mDestCRS( destCrs )
 {
@@ -27,6 +33,9 @@ QgsDatumTransformStore::QgsDatumTransformStore( const QgsCoordinateReferenceSyst
 void QgsDatumTransformStore::clear()
 {
   mEntries.clear();
+
+  QMutexLocker locker( &sTransformsMutex );
+  mTransforms.clear();
 }
 
 void QgsDatumTransformStore::setDestinationCrs( const QgsCoordinateReferenceSystem& destCrs )
@@ -63,15 +72,21 @@ const QgsCoordinateTransform* QgsDatumTransformStore::transformation( QgsMapLaye
     return 0;
   }
 
+  QSharedPointer<const QgsCoordinateTransform> ct;
   QHash< QString, Entry >::const_iterator ctIt = mEntries.find( layer->id() );
   if ( ctIt != mEntries.constEnd() && ctIt->srcAuthId == srcAuthId && ctIt->destAuthId == dstAuthId )
   {
-    return QgsCoordinateTransformCache::instance()->transform( ctIt->srcAuthId, ctIt->destAuthId, ctIt->srcDatumTransform, ctIt->destDatumTransform );
+    ct = QgsCoordinateTransformCache::instance()->sharedTransform( ctIt->srcAuthId, ctIt->destAuthId, ctIt->srcDatumTransform, ctIt->destDatumTransform );
   }
   else
   {
-    return QgsCoordinateTransformCache::instance()->transform( srcAuthId, dstAuthId );
+    ct = QgsCoordinateTransformCache::instance()->sharedTransform( srcAuthId, dstAuthId );
   }
+
+  // keep the transform alive for the caller, even if the cache drops it meanwhile
+  QMutexLocker locker( &sTransformsMutex );
+  mTransforms.insert( layer->id(), ct );
+  return ct.data();
 }
 
 void QgsDatumTransformStore::readXML( const QDomNode& parentNode )
@@ -17,6 +17,8 @@
 
 #include "qgscoordinatereferencesystem.h"
 
+#include <QSharedPointer>
+
 class QgsCoordinateTransform;
 class QgsMapLayer;
 
@@ -44,7 +46,8 @@ class CORE_EXPORT QgsDatumTransformStore
 
     /** Will return transform from layer's CRS to current destination CRS.
      *  Will emit datumTransformInfoRequested signal if the layer has no entry.
-     *  Returns an instance from QgsCoordinateTransformCache
+     *  Returns an instance from QgsCoordinateTransformCache, which stays valid
+     *  until the next call for the same layer or until the store is cleared
      */
     const QgsCoordinateTransform* transformation( QgsMapLayer* layer ) const;
 
@@ -65,6 +68,9 @@ class CORE_EXPORT QgsDatumTransformStore
 
     //! key = layer ID
     QHash< QString, Entry > mEntries;
+
+    //! transforms returned by transformation(), key = layer ID
+    mutable QHash< QString, QSharedPointer<const QgsCoordinateTransform> > mTransforms;
 };
 
 #endif // QGSDATUMTRANSFORMSTORE_H
@@ -24,6 +24,7 @@
 #include "qgspoint.h"
 #include "qgscoordinatetransform.h"
 #include "qgscoordinatereferencesystem.h"
+#include "qgscrscache.h"
 #include "qgsgeometry.h"
 #include "qgsgeometrycollectionv2.h"
 #include "qgsdistancearea.h"
@@ -100,9 +101,7 @@ void QgsDistanceArea::setEllipsoidalMode( bool flag )
 
 void QgsDistanceArea::setSourceCrs( long srsid )
 {
-  QgsCoordinateReferenceSystem srcCRS;
-  srcCRS.createFromSrsId( srsid );
-  mCoordTransform->setSourceCrs( srcCRS );
+  mCoordTransform->setSourceCrs( QgsCRSCache::instance()->crsBySrsId( srsid ) );
 }
 
 void QgsDistanceArea::setSourceCrs( const QgsCoordinateReferenceSystem& srcCRS )
@@ -0,0 +1,173 @@
+/***************************************************************************
+                              qgsfeaturebatch.cpp
+                              -------------------
+  begin                : October 2015
+  copyright            : (C) 2015 by the QGIS project
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgsfeaturebatch.h"
+#include "qgsgeometry.h"
+
+#include <cstring>
+
+QgsFeatureBatch::QgsFeatureBatch()
+    : mFieldCount( 0 )
+    , mSize( 0 )
+    , mArenaUsed( 0 )
+{
+}
+
+void QgsFeatureBatch::setFields( const QgsFields& fields )
+{
+  mFields = fields;
+  if ( mFields.count() == mFieldCount )
+    return;
+
+  clear();
+  mFieldCount = mFields.count();
+  mValues.resize( mIds.size() * mFieldCount );
+}
+
+void QgsFeatureBatch::clear()
+{
+  // storage is kept, rows are reset when they are reused
+  mSize = 0;
+  mArenaUsed = 0;
+}
+
+void QgsFeatureBatch::reserve( int count )
+{
+  if ( count <= mIds.size() )
+    return;
+
+  mIds.resize( count );
+  mValues.resize( count * mFieldCount );
+  mWkbOffsets.resize( count );
+  mWkbSizes.resize( count );
+}
+
+int QgsFeatureBatch::addFeature( QgsFeatureId id )
+{
+  if ( mSize == mIds.size() )
+    reserve( qMax( 64, 2 * mSize ) );
+
+  int row = mSize++;
+  mIds[row] = id;
+  mWkbOffsets[row] = 0;
+  mWkbSizes[row] = 0;
+
+  // drop the values of the previous fill
+  QVariant* values = mValues.data() + row * mFieldCount;
+  for ( int i = 0; i < mFieldCount; ++i )
+  {
+    if ( !values[i].isNull() )
+      values[i] = QVariant();
+  }
+  return row;
+}
+
+int QgsFeatureBatch::addFeature( const QgsFeature& feature )
+{
+  int row = addFeature( feature.id() );
+  setAttributes( row, feature.attributes() );
+  setGeometry( row, feature.constGeometry() );
+  return row;
+}
+
+void QgsFeatureBatch::setAttributes( int row, const QgsAttributes& attributes )
+{
+  int count = qMin( attributes.size(), mFieldCount );
+  QVariant* values = mValues.data() + row * mFieldCount;
+  const QVariant* src = attributes.constData();
+  for ( int i = 0; i < count; ++i )
+    values[i] = src[i];
+}
+
+void QgsFeatureBatch::setGeometryWkb( int row, const unsigned char* wkb, int size )
+{
+  if ( !wkb || size <= 0 )
+  {
+    mWkbSizes[row] = 0;
+    return;
+  }
+
+  memcpy( allocateGeometryWkb( row, size ), wkb, size );
+}
+
+void QgsFeatureBatch::setGeometry( int row, const QgsGeometry* geometry )
+{
+  if ( !geometry )
+  {
+    mWkbSizes[row] = 0;
+    return;
+  }
+
+  setGeometryWkb( row, geometry->asWkb(), geometry->wkbSize() );
+}
+
+unsigned char* QgsFeatureBatch::allocateGeometryWkb( int row, int size )
+{
+  int required = mArenaUsed + size;
+  if ( required > mArena.size() )
+    mArena.resize( qMax( required, 2 * mArena.size() ) );
+
+  mWkbOffsets[row] = mArenaUsed;
+  mWkbSizes[row] = size;
+  mArenaUsed = required;
+  return reinterpret_cast<unsigned char*>( mArena.data() ) + mWkbOffsets.at( row );
+}
+
+const unsigned char* QgsFeatureBatch::geometryWkb( int row ) const
+{
+  if ( mWkbSizes.at( row ) <= 0 )
+    return 0;
+
+  return reinterpret_cast<const unsigned char*>( mArena.constData() ) + mWkbOffsets.at( row );
+}
+
+bool QgsFeatureBatch::feature( int row, QgsFeature& feature ) const
+{
+  if ( row < 0 || row >= mSize )
+    return false;
+
+  feature.setFeatureId( mIds.at( row ) );
+  feature.setFields( mFields );
+  feature.setValid( true );
+
+  // the attribute vector of a reused feature keeps its size, so no reallocation here
+  if ( feature.attributes().size() != mFieldCount )
+    feature.initAttributes( mFieldCount );
+  const QVariant* values = mValues.constData() + row * mFieldCount;
+  for ( int i = 0; i < mFieldCount; ++i )
+    feature.setAttribute( i, values[i] );
+
+  int wkbSize = mWkbSizes.at( row );
+  if ( wkbSize > 0 )
+  {
+    // the geometry takes ownership of its wkb, it cannot point into the arena
+    unsigned char* wkb = new unsigned char[wkbSize];
+    memcpy( wkb, geometryWkb( row ), wkbSize );
+    feature.setGeometryAndOwnership( wkb, wkbSize );
+  }
+  else
+  {
+    feature.setGeometry( 0 );
+  }
+  return true;
+}
+
+QgsFeature QgsFeatureBatch::feature( int row ) const
+{
+  QgsFeature f;
+  feature( row, f );
+  return f;
+}
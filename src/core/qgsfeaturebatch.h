@@ -0,0 +1,142 @@
+/***************************************************************************
+                              qgsfeaturebatch.h
+                              -----------------
+  begin                : October 2015
+  copyright            : (C) 2015 by the QGIS project
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSFEATUREBATCH_H
+#define QGSFEATUREBATCH_H
+
+#include "qgsfeature.h"
+#include "qgsfield.h"
+
+#include <QByteArray>
+#include <QVector>
+
+/** \ingroup core
+ * A reusable block of features for bulk iteration.
+ *
+ * Instead of one QgsFeature (with its own attribute vector and geometry) per row, a batch
+ * stores the attribute values of all its rows in one flat array and the WKB geometries
+ * of all rows in one byte arena. Clearing a batch keeps the allocated storage, so a batch
+ * that is refilled over and over again (e.g. by QgsFeatureIterator::nextFeatures())
+ * stops allocating once it has grown to the size of the largest block.
+ *
+ * Consumers that only need attribute values or raw WKB read them directly from the batch.
+ * Consumers that need the QgsFeature API get a view of a row with feature(), which copies
+ * the row into a (preferably reused) QgsFeature.
+ *
+ * Pointers returned by geometryWkb() and allocateGeometryWkb() are only valid until the
+ * next geometry of the batch is stored or the batch is cleared.
+ *
+ * @note added in 2.12
+ * @note not available in python bindings
+ */
+class CORE_EXPORT QgsFeatureBatch
+{
+  public:
+    QgsFeatureBatch();
+
+    /** Sets the fields of the features in the batch. Clears the batch if the
+     * number of fields changes.
+     */
+    void setFields( const QgsFields& fields );
+
+    //! Returns the fields of the features in the batch
+    const QgsFields& fields() const { return mFields; }
+
+    //! Returns the number of features in the batch
+    int size() const { return mSize; }
+
+    //! Returns true if the batch contains no features
+    bool isEmpty() const { return mSize == 0; }
+
+    //! Removes all features, but keeps the allocated storage for the next fill
+    void clear();
+
+    //! Makes sure that at least count features fit in the batch without reallocation
+    void reserve( int count );
+
+    /** Appends a feature without geometry and with all attributes set to null.
+     * @returns row of the new feature
+     */
+    int addFeature( QgsFeatureId id );
+
+    /** Appends a copy of a feature. The attributes are truncated or padded with nulls
+     * to the number of fields of the batch.
+     * @returns row of the new feature
+     */
+    int addFeature( const QgsFeature& feature );
+
+    //! Sets an attribute value. Neither row nor field are checked.
+    void setAttribute( int row, int field, const QVariant& value ) { mValues[ row * mFieldCount + field ] = value; }
+
+    //! Sets the attribute values of a row (at most the number of fields of the batch)
+    void setAttributes( int row, const QgsAttributes& attributes );
+
+    //! Copies the geometry of a row into the arena
+    void setGeometryWkb( int row, const unsigned char* wkb, int size );
+
+    //! Copies the geometry of a row into the arena, a null or empty geometry removes the geometry of the row
+    void setGeometry( int row, const QgsGeometry* geometry );
+
+    /** Reserves size bytes in the arena for the WKB geometry of a row and returns
+     * a pointer to them, e.g. to decode a provider geometry in place.
+     */
+    unsigned char* allocateGeometryWkb( int row, int size );
+
+    //! Returns the id of the feature in a row
+    QgsFeatureId id( int row ) const { return mIds.at( row ); }
+
+    //! Returns an attribute value. Neither row nor field are checked.
+    const QVariant& attribute( int row, int field ) const { return mValues.at( row * mFieldCount + field ); }
+
+    //! Returns true if the feature in a row has a geometry
+    bool hasGeometry( int row ) const { return mWkbSizes.at( row ) > 0; }
+
+    //! Returns the WKB of the geometry of a row, or 0 if the row has no geometry
+    const unsigned char* geometryWkb( int row ) const;
+
+    //! Returns the size of the WKB of the geometry of a row
+    int geometryWkbSize( int row ) const { return mWkbSizes.at( row ); }
+
+    /** Copies a row into a feature. Passing the same feature for all rows avoids
+     * reallocating its attributes. The geometry is only created if the row has one.
+     * @returns false if row is out of range
+     */
+    bool feature( int row, QgsFeature& feature ) const;
+
+    //! Returns a row as feature
+    QgsFeature feature( int row ) const;
+
+    //! Returns the number of bytes currently used by the geometry arena
+    int arenaSize() const { return mArenaUsed; }
+
+  private:
+    QgsFields mFields;
+    int mFieldCount;
+    int mSize;
+
+    QVector<QgsFeatureId> mIds;
+    //! attribute values of all rows, row major
+    QVector<QVariant> mValues;
+    //! offsets of the geometries in the arena
+    QVector<int> mWkbOffsets;
+    //! sizes of the geometries, 0 for rows without geometry
+    QVector<int> mWkbSizes;
+
+    QByteArray mArena;
+    int mArenaUsed;
+};
+
+#endif // QGSFEATUREBATCH_H
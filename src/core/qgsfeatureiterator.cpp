@@ -13,17 +13,101 @@
  *                                                                         *
  ***************************************************************************/
 #include "qgsfeatureiterator.h"
+#include "qgsfeaturebatch.h"
 #include "qgslogger.h"
 
 #include "qgsgeometrysimplifier.h"
 #include "qgssimplifymethod.h"
 
+#include <algorithm>
+
+namespace
+{
+  //! a feature with the values of the expressions to order by
+  struct OrderedFeature
+  {
+    QgsFeature feature;
+    QVariantList keys;
+    //! position in the order of the provider, to keep it for equal keys
+    int index;
+  };
+
+  class OrderByComparator
+  {
+    public:
+      explicit OrderByComparator( const QgsFeatureRequest::OrderBy& orderBy )
+          : mOrderBy( orderBy )
+      {
+      }
+
+      //! returns true if a is ordered before b
+      bool operator()( const OrderedFeature& a, const OrderedFeature& b ) const
+      {
+        for ( int i = 0; i < mOrderBy.size(); ++i )
+        {
+          int c = compare( a.keys.at( i ), b.keys.at( i ), mOrderBy.at( i ) );
+          if ( c != 0 )
+            return c < 0;
+        }
+        return a.index < b.index;
+      }
+
+    private:
+      QgsFeatureRequest::OrderBy mOrderBy;
+
+      static bool isNumeric( QVariant::Type type )
+      {
+        return type == QVariant::Int || type == QVariant::UInt || type == QVariant::LongLong ||
+               type == QVariant::ULongLong || type == QVariant::Double || type == QVariant::Bool;
+      }
+
+      static int compare( const QVariant& a, const QVariant& b, const QgsFeatureRequest::OrderByClause& clause )
+      {
+        if ( a.isNull() || b.isNull() )
+        {
+          if ( a.isNull() && b.isNull() )
+            return 0;
+          return a.isNull() == clause.nullsFirst() ? -1 : 1;
+        }
+
+        int c;
+        if ( isNumeric( a.type() ) && isNumeric( b.type() ) )
+        {
+          if ( a.type() == QVariant::Double || b.type() == QVariant::Double )
+          {
+            double da = a.toDouble(), db = b.toDouble();
+            c = da < db ? -1 : ( da > db ? 1 : 0 );
+          }
+          else
+          {
+            qlonglong la = a.toLongLong(), lb = b.toLongLong();
+            c = la < lb ? -1 : ( la > lb ? 1 : 0 );
+          }
+        }
+        else if ( a.type() == b.type() && ( a.type() == QVariant::Date || a.type() == QVariant::DateTime || a.type() == QVariant::Time ) )
+        {
+          c = a < b ? -1 : ( b < a ? 1 : 0 );
+        }
+        else
+        {
+          c = a.toString().localeAwareCompare( b.toString() );
+        }
+
+        return clause.ascending() ? c : -c;
+      }
+  };
+}
+
 QgsAbstractFeatureIterator::QgsAbstractFeatureIterator( const QgsFeatureRequest& request )
     : mRequest( request )
     , mClosed( false )
     , refs( 0 )
     , mGeometrySimplifier( NULL )
     , mLocalSimplification( false )
+    , mOrderByLocal( false )
+    , mSorted( false )
+    , mSortedIndex( 0 )
+    , mFetchedCount( 0 )
 {
 }
 
@@ -34,6 +118,33 @@ QgsAbstractFeatureIterator::~QgsAbstractFeatureIterator()
 }
 
 bool QgsAbstractFeatureIterator::nextFeature( QgsFeature& f )
+{
+  if ( mRequest.limit() >= 0 && mFetchedCount >= mRequest.limit() )
+    return false;
+
+  bool dataOk = false;
+  if ( mOrderByLocal )
+  {
+    if ( !mSorted )
+      sortFeatures();
+
+    if ( mSortedIndex < mSortedFeatures.size() )
+    {
+      f = mSortedFeatures.at( mSortedIndex++ );
+      dataOk = true;
+    }
+  }
+  else
+  {
+    dataOk = nextFilteredFeature( f );
+  }
+
+  if ( dataOk )
+    mFetchedCount++;
+  return dataOk;
+}
+
+bool QgsAbstractFeatureIterator::nextFilteredFeature( QgsFeature& f )
 {
   bool dataOk = false;
 
@@ -62,6 +173,63 @@ bool QgsAbstractFeatureIterator::nextFeature( QgsFeature& f )
   return dataOk;
 }
 
+int QgsAbstractFeatureIterator::nextFeatures( QgsFeatureBatch& batch, int maxCount )
+{
+  batch.clear();
+  if ( maxCount <= 0 )
+    return 0;
+
+  if ( !fetchesBatches() )
+    return fillBatch( batch, maxCount, true );
+
+  return fetchFeatures( batch, maxCount );
+}
+
+bool QgsAbstractFeatureIterator::hasNativeBatches() const
+{
+  return fetchesBatches() && providesBatches();
+}
+
+bool QgsAbstractFeatureIterator::hasNativeLimit() const
+{
+  return mRequest.limit() >= 0 && !mOrderByLocal && providesLimit();
+}
+
+bool QgsAbstractFeatureIterator::fetchesBatches() const
+{
+  if ( mOrderByLocal || mRequest.limit() >= 0 || mLocalSimplification )
+    return false;
+
+  return mRequest.filterType() != QgsFeatureRequest::FilterExpression
+         && mRequest.filterType() != QgsFeatureRequest::FilterFids;
+}
+
+int QgsAbstractFeatureIterator::fetchFeatures( QgsFeatureBatch& batch, int maxCount )
+{
+  return fillBatch( batch, maxCount, false );
+}
+
+bool QgsAbstractFeatureIterator::providesBatches() const
+{
+  return false;
+}
+
+bool QgsAbstractFeatureIterator::providesLimit() const
+{
+  return false;
+}
+
+int QgsAbstractFeatureIterator::fillBatch( QgsFeatureBatch& batch, int maxCount, bool filtered )
+{
+  while ( batch.size() < maxCount && ( filtered ? nextFeature( mBatchFeature ) : fetchFeature( mBatchFeature ) ) )
+  {
+    if ( batch.isEmpty() )
+      batch.setFields( *mBatchFeature.fields() );
+    batch.addFeature( mBatchFeature );
+  }
+  return batch.size();
+}
+
 bool QgsAbstractFeatureIterator::nextFeatureFilterExpression( QgsFeature& f )
 {
   while ( fetchFeature( f ) )
@@ -83,6 +251,86 @@ bool QgsAbstractFeatureIterator::nextFeatureFilterFids( QgsFeature& f )
   return false;
 }
 
+void QgsAbstractFeatureIterator::sortFeatures()
+{
+  mSorted = true;
+  mSortedFeatures.clear();
+  mSortedIndex = 0;
+
+  const QgsFeatureRequest::OrderBy& orderBy = mRequest.orderBy();
+  OrderByComparator lessThan( orderBy );
+  long limit = mRequest.limit();
+
+  QgsExpressionContext* context = mRequest.expressionContext();
+  QList<QgsExpression*> expressions;
+
+  // with a limit only the first features are kept, in a heap with the last of them on top
+  QVector<OrderedFeature> features;
+  OrderedFeature feature;
+  int index = 0;
+  while ( nextFilteredFeature( feature.feature ) )
+  {
+    if ( expressions.isEmpty() )
+    {
+      if ( feature.feature.fields() )
+        context->setFields( *feature.feature.fields() );
+      Q_FOREACH ( const QgsFeatureRequest::OrderByClause& clause, orderBy )
+      {
+        QgsExpression* expression = new QgsExpression( clause.expression() );
+        expression->prepare( context );
+        expressions << expression;
+      }
+    }
+
+    context->setFeature( feature.feature );
+    feature.keys.clear();
+    Q_FOREACH ( QgsExpression* expression, expressions )
+      feature.keys << expression->evaluate( context );
+    feature.index = index++;
+
+    if ( limit < 0 )
+    {
+      features << feature;
+    }
+    else if ( features.size() < limit )
+    {
+      features << feature;
+      std::push_heap( features.begin(), features.end(), lessThan );
+    }
+    else if ( limit > 0 && lessThan( feature, features.first() ) )
+    {
+      std::pop_heap( features.begin(), features.end(), lessThan );
+      features.last() = feature;
+      std::push_heap( features.begin(), features.end(), lessThan );
+    }
+  }
+
+  qDeleteAll( expressions );
+
+  if ( limit < 0 )
+    std::sort( features.begin(), features.end(), lessThan );
+  else
+    std::sort_heap( features.begin(), features.end(), lessThan );
+
+  mSortedFeatures.reserve( features.size() );
+  for ( int i = 0; i < features.size(); ++i )
+    mSortedFeatures << features.at( i ).feature;
+}
+
+bool QgsAbstractFeatureIterator::rewindRequest()
+{
+  mFetchedCount = 0;
+
+  // the sorted features are returned again, the provider is not read twice
+  if ( mSorted )
+  {
+    mSortedIndex = 0;
+    return true;
+  }
+
+  return rewind();
+}
+
 void QgsAbstractFeatureIterator::ref()
 {
   // Prepare if required the simplification of geometries to fetch:
@@ -93,6 +341,10 @@ void QgsAbstractFeatureIterator::ref()
   if ( refs == 0 )
   {
     prepareSimplification( mRequest.simplifyMethod() );
+
+    // ordering by the provider is set up in the same way
+    if ( !mRequest.orderBy().isEmpty() )
+      mOrderByLocal = !prepareOrderBy( mRequest.orderBy() );
   }
   refs++;
 }
@@ -121,6 +373,12 @@ bool QgsAbstractFeatureIterator::prepareSimplification( const QgsSimplifyMethod&
   return false;
 }
 
+bool QgsAbstractFeatureIterator::prepareOrderBy( const QList<QgsFeatureRequest::OrderByClause>& orderBys )
+{
+  Q_UNUSED( orderBys )
+  return false;
+}
+
 bool QgsAbstractFeatureIterator::providerCanSimplify( QgsSimplifyMethod::MethodType methodType ) const
 {
   Q_UNUSED( methodType )
@@ -19,6 +19,7 @@
 #include "qgslogger.h"
 
 class QgsAbstractGeometrySimplifier;
+class QgsFeatureBatch;
 
 /** \ingroup core
  * Internal feature iterator to be implemented within data providers
@@ -35,6 +36,29 @@ class CORE_EXPORT QgsAbstractFeatureIterator
     //! fetch next feature, return true on success
     virtual bool nextFeature( QgsFeature& f );
 
+    /** Clears the batch and fetches up to maxCount features into it.
+     * @returns number of features in the batch, 0 if there are no more features
+     * @note added in 2.12
+     * @note not available in python bindings
+     */
+    virtual int nextFeatures( QgsFeatureBatch& batch, int maxCount );
+
+    /** Returns true if nextFeatures() fills batches without creating a QgsFeature for each
+     * feature. Otherwise the batch is filled feature by feature and consumers which need
+     * a QgsFeature for each row are better off with nextFeature().
+     * @note added in 2.12
+     * @note not available in python bindings
+     */
+    bool hasNativeBatches() const;
+
+    /** Returns true if the provider stops at the limit of the request itself. This requires
+     * that it filters and orders the features as requested, so that it does not read more
+     * features than are returned.
+     * @note added in 2.12
+     * @note not available in python bindings
+     */
+    bool hasNativeLimit() const;
+
     //! reset the iterator to the starting position
     virtual bool rewind() = 0;
     //! end of iterating: free the resources / lock
@@ -50,6 +74,40 @@ class CORE_EXPORT QgsAbstractFeatureIterator
      */
     virtual bool fetchFeature( QgsFeature& f ) = 0;
 
+    /**
+     * Fetches up to maxCount features into the (cleared) batch. Reimplement it if your
+     * provider can fill a batch directly, without creating a QgsFeature for each row.
+     * It is only called if neither an expression nor a set of feature ids has to be
+     * filtered and no local simplification is required, so an implementation just
+     * needs to honour the rectangle and single fid filters (like fetchFeature).
+     * The default implementation calls fetchFeature for each feature.
+     *
+     * @param batch The batch to write to
+     * @param maxCount Maximum number of features to fetch
+     * @return number of features written to the batch
+     * @note added in 2.12
+     * @note not available in python bindings
+     */
+    virtual int fetchFeatures( QgsFeatureBatch& batch, int maxCount );
+
+    /**
+     * Returns true if fetchFeatures() fills the batch directly, without calling fetchFeature()
+     * for each feature. Reimplement it together with fetchFeatures().
+     * The default implementation returns false.
+     * @note added in 2.12
+     * @note not available in python bindings
+     */
+    virtual bool providesBatches() const;
+
+    /**
+     * Returns true if the provider applies the limit of the request. Reimplement it if your
+     * provider passes the limit on to its backend when it filters and orders the features there.
+     * The default implementation returns false.
+     * @note added in 2.12
+     * @note not available in python bindings
+     */
+    virtual bool providesLimit() const;
+
     /**
      * By default, the iterator will fetch all features and check if the feature
      * matches the expression.
@@ -90,12 +148,54 @@ class CORE_EXPORT QgsAbstractFeatureIterator
     //! Setup the simplification of geometries to fetch using the specified simplify method
     virtual bool prepareSimplification( const QgsSimplifyMethod& simplifyMethod );
 
+    /**
+     * Returns true if the features are fetched in the order of the request.
+     * Reimplement it if your provider can order the features in its backend. Otherwise
+     * the iterator reads all the features and sorts them before returning the first one,
+     * keeping only as many features as the limit of the request.
+     * It is only called if the request has clauses to order by.
+     *
+     * @param orderBys clauses to order by
+     * @return true if the provider orders the features
+     * @note added in 2.12
+     */
+    virtual bool prepareOrderBy( const QList<QgsFeatureRequest::OrderByClause>& orderBys );
+
   private:
     //! optional object to locally simplify geometries fetched by this feature iterator
     QgsAbstractGeometrySimplifier* mGeometrySimplifier;
     //! this iterator runs local simplification
     bool mLocalSimplification;
 
+    //! feature reused to fill batches feature by feature
+    QgsFeature mBatchFeature;
+
+    //! fills batch feature by feature, with nextFeature() or (if filtered is false) fetchFeature()
+    int fillBatch( QgsFeatureBatch& batch, int maxCount, bool filtered );
+
+    //! returns true if neither filters, ordering, limit nor simplification keep nextFeatures() from calling fetchFeatures()
+    bool fetchesBatches() const;
+
+    //! fetches the next feature which matches the filter of the request and simplifies it
+    bool nextFilteredFeature( QgsFeature& f );
+
+    //! reads all the features and sorts them in the order of the request
+    void sortFeatures();
+
+    //! starts over again, used by QgsFeatureIterator::rewind()
+    bool rewindRequest();
+
+    //! the features are sorted by the iterator and not by the provider
+    bool mOrderByLocal;
+    //! the features are read and sorted into mSortedFeatures
+    bool mSorted;
+    QList<QgsFeature> mSortedFeatures;
+    //! index of the next feature of mSortedFeatures to return
+    int mSortedIndex;
+
+    //! number of features returned, to stop at the limit of the request
+    long mFetchedCount;
+
     //! returns whether the iterator supports simplify geometries on provider side
     virtual bool providerCanSimplify( QgsSimplifyMethod::MethodType methodType ) const;
 
@@ -151,6 +251,29 @@ class CORE_EXPORT QgsFeatureIterator
     QgsFeatureIterator& operator=( const QgsFeatureIterator& other );
 
     bool nextFeature( QgsFeature& f );
+
+    /** Clears the batch and fetches up to maxCount features into it. Fetching features
+     * in batches avoids most of the per feature overhead of nextFeature() on large layers.
+     * @returns number of features in the batch, 0 if there are no more features
+     * @note added in 2.12
+     * @note not available in python bindings
+     */
+    int nextFeatures( QgsFeatureBatch& batch, int maxCount = 1000 );
+
+    /** Returns true if nextFeatures() fills batches without creating a QgsFeature for each feature.
+     * Consumers which need a QgsFeature for each row should only fetch batches if it does.
+     * @note added in 2.12
+     * @note not available in python bindings
+     */
+    bool hasNativeBatches() const;
+
+    /** Returns true if the provider stops at the limit of the request itself, without
+     * reading, filtering or sorting more features than are returned.
+     * @note added in 2.12
+     * @note not available in python bindings
+     */
+    bool hasNativeLimit() const;
+
     bool rewind();
     bool close();
 
@@ -196,9 +319,24 @@ inline bool QgsFeatureIterator::nextFeature( QgsFeature& f )
   return mIter ? mIter->nextFeature( f ) : false;
 }
 
+inline int QgsFeatureIterator::nextFeatures( QgsFeatureBatch& batch, int maxCount )
+{
+  return mIter ? mIter->nextFeatures( batch, maxCount ) : 0;
+}
+
+inline bool QgsFeatureIterator::hasNativeBatches() const
+{
+  return mIter && mIter->hasNativeBatches();
+}
+
+inline bool QgsFeatureIterator::hasNativeLimit() const
+{
+  return mIter && mIter->hasNativeLimit();
+}
+
 inline bool QgsFeatureIterator::rewind()
 {
-  return mIter ? mIter->rewind() : false;
+  return mIter ? mIter->rewindRequest() : false;
 }
 
 inline bool QgsFeatureIterator::close()
@@ -27,6 +27,7 @@ QgsFeatureRequest::QgsFeatureRequest()
     , mFilterFid( -1 )
     , mFilterExpression( 0 )
     , mFlags( 0 )
+    , mLimit( -1 )
 {
 }
 
@@ -35,6 +36,7 @@ QgsFeatureRequest::QgsFeatureRequest( QgsFeatureId fid )
     , mFilterFid( fid )
     , mFilterExpression( 0 )
     , mFlags( 0 )
+    , mLimit( -1 )
 {
 }
 
@@ -44,6 +46,7 @@ QgsFeatureRequest::QgsFeatureRequest( const QgsRectangle& rect )
     , mFilterFid( -1 )
     , mFilterExpression( 0 )
     , mFlags( 0 )
+    , mLimit( -1 )
 {
 }
 
@@ -53,6 +56,7 @@ QgsFeatureRequest::QgsFeatureRequest( const QgsExpression& expr, const QgsExpres
     , mFilterExpression( new QgsExpression( expr.expression() ) )
     , mExpressionContext( context )
     , mFlags( 0 )
+    , mLimit( -1 )
 {
 }
 
@@ -79,6 +83,8 @@ QgsFeatureRequest& QgsFeatureRequest::operator=( const QgsFeatureRequest & rh )
   mExpressionContext = rh.mExpressionContext;
   mAttrs = rh.mAttrs;
   mSimplifyMethod = rh.mSimplifyMethod;
+  mOrderBy = rh.mOrderBy;
+  mLimit = rh.mLimit;
   return *this;
 }
 
@@ -163,6 +169,41 @@ QgsFeatureRequest& QgsFeatureRequest::setSimplifyMethod( const QgsSimplifyMethod
   return *this;
 }
 
+QgsFeatureRequest& QgsFeatureRequest::setOrderBy( const QgsFeatureRequest::OrderBy& orderBy )
+{
+  mOrderBy = orderBy;
+  return *this;
+}
+
+QgsFeatureRequest& QgsFeatureRequest::addOrderBy( const QString& expression, bool ascending )
+{
+  mOrderBy << OrderByClause( expression, ascending );
+  return *this;
+}
+
+QgsFeatureRequest& QgsFeatureRequest::addOrderBy( const QString& expression, bool ascending, bool nullsFirst )
+{
+  mOrderBy << OrderByClause( expression, ascending, nullsFirst );
+  return *this;
+}
+
+QSet<QString> QgsFeatureRequest::orderByAttributes() const
+{
+  QSet<QString> attributes;
+  Q_FOREACH ( const OrderByClause& clause, mOrderBy )
+  {
+    QgsExpression expression( clause.expression() );
+    attributes += expression.referencedColumns().toSet();
+  }
+  return attributes;
+}
+
+QgsFeatureRequest& QgsFeatureRequest::setLimit( long limit )
+{
+  mLimit = limit;
+  return *this;
+}
+
 bool QgsFeatureRequest::acceptFeature( const QgsFeature& feature )
 {
   switch ( mFilter )
@@ -204,6 +245,25 @@ bool QgsFeatureRequest::acceptFeature( const QgsFeature& feature )
   return true;
 }
 
+QgsFeatureRequest::OrderByClause::OrderByClause( const QString& expression, bool ascending )
+    : mExpression( expression )
+    , mAscending( ascending )
+    , mNullsFirst( !ascending )
+{
+}
+
+QgsFeatureRequest::OrderByClause::OrderByClause( const QString& expression, bool ascending, bool nullsFirst )
+    : mExpression( expression )
+    , mAscending( ascending )
+    , mNullsFirst( nullsFirst )
+{
+}
+
+bool QgsFeatureRequest::OrderByClause::operator==( const QgsFeatureRequest::OrderByClause& other ) const
+{
+  return mExpression == other.mExpression && mAscending == other.mAscending && mNullsFirst == other.mNullsFirst;
+}
+
 #include "qgsfeatureiterator.h"
 #include "qgslogger.h"
 
@@ -44,6 +44,10 @@ typedef QList<int> QgsAttributeList;
  * - SubsetOfAttributes flag
  * - SimplifyMethod for geometries to fetch
  *
+ * The features can be ordered by one or more expressions and their number can be limited.
+ * Providers which can do it in their backend order and limit the features themselves,
+ * otherwise the feature iterator sorts the features before returning the first one.
+ *
  * The options may be chained, e.g.:
  *   QgsFeatureRequest().setFilterRect(QgsRectangle(0,0,1,1)).setFlags(QgsFeatureRequest::ExactIntersect)
  *
@@ -58,6 +62,8 @@ typedef QList<int> QgsAttributeList;
  *     QgsFeatureRequest().setFilterRect(QgsRectangle(0,0,1,1))
  * - fetch only one feature
  *     QgsFeatureRequest().setFilterFid(45)
+ * - fetch the ten features with the largest population
+ *     QgsFeatureRequest().addOrderBy("population", false).setLimit(10)
  *
  */
 class CORE_EXPORT QgsFeatureRequest
@@ -68,7 +74,8 @@ class CORE_EXPORT QgsFeatureRequest
       NoFlags            = 0,
       NoGeometry         = 1,  //!< Geometry is not required. It may still be returned if e.g. required for a filter condition.
       SubsetOfAttributes = 2,  //!< Fetch only a subset of attributes (setSubsetOfAttributes sets this flag)
-      ExactIntersect     = 4   //!< Use exact geometry intersection (slower) instead of bounding boxes
+      ExactIntersect     = 4,  //!< Use exact geometry intersection (slower) instead of bounding boxes
+      ParallelScan       = 8   //!< Features may be read over several connections at once and come in no particular order. Providers that cannot split a scan ignore it. Added in 2.12.
     };
     Q_DECLARE_FLAGS( Flags, Flag )
 
@@ -89,6 +96,55 @@ class CORE_EXPORT QgsFeatureRequest
      */
     static const QString AllAttributes;
 
+    /** \ingroup core
+     * An expression and a direction to order features by.
+     * @note added in 2.12
+     */
+    class CORE_EXPORT OrderByClause
+    {
+      public:
+        /**
+         * Creates a clause. NULL values are sorted like in PostgreSQL, after the other
+         * values in ascending order and before them in descending order.
+         * @param expression expression to order by
+         * @param ascending true for ascending, false for descending order
+         */
+        explicit OrderByClause( const QString& expression, bool ascending = true );
+
+        /**
+         * Creates a clause.
+         * @param expression expression to order by
+         * @param ascending true for ascending, false for descending order
+         * @param nullsFirst true to put NULL values before the other values, false to put them after
+         */
+        OrderByClause( const QString& expression, bool ascending, bool nullsFirst );
+
+        //! Returns the expression to order by
+        QString expression() const { return mExpression; }
+
+        //! Returns true for ascending and false for descending order
+        bool ascending() const { return mAscending; }
+
+        //! Sets the direction of the order
+        void setAscending( bool ascending ) { mAscending = ascending; }
+
+        //! Returns true if NULL values are sorted before the other values
+        bool nullsFirst() const { return mNullsFirst; }
+
+        //! Sets whether NULL values are sorted before the other values
+        void setNullsFirst( bool nullsFirst ) { mNullsFirst = nullsFirst; }
+
+        bool operator==( const OrderByClause& other ) const;
+
+      private:
+        QString mExpression;
+        bool mAscending;
+        bool mNullsFirst;
+    };
+
+    //! Clauses to order features by, the first clause has the highest precedence
+    typedef QList<OrderByClause> OrderBy;
+
     //! construct a default request: for all features get attributes and geometries
     QgsFeatureRequest();
     //! construct a request with feature ID filter
@@ -191,6 +247,53 @@ class CORE_EXPORT QgsFeatureRequest
     //! @note added in 2.2
     const QgsSimplifyMethod& simplifyMethod() const { return mSimplifyMethod; }
 
+    /** Sets the clauses to order the features by, an empty list returns the features in
+     * the order of the provider.
+     * @note added in 2.12
+     * @see addOrderBy
+     */
+    QgsFeatureRequest& setOrderBy( const OrderBy& orderBy );
+
+    /** Returns the clauses to order the features by.
+     * @note added in 2.12
+     * @see setOrderBy
+     */
+    const OrderBy& orderBy() const { return mOrderBy; }
+
+    /** Adds a clause to order the features by, after the clauses already set.
+     * NULL values are sorted after the other values in ascending order and before them in descending order.
+     * @param expression expression to order by
+     * @param ascending true for ascending, false for descending order
+     * @note added in 2.12
+     */
+    QgsFeatureRequest& addOrderBy( const QString& expression, bool ascending = true );
+
+    /** Adds a clause to order the features by, after the clauses already set.
+     * @param expression expression to order by
+     * @param ascending true for ascending, false for descending order
+     * @param nullsFirst true to put NULL values before the other values
+     * @note added in 2.12
+     */
+    QgsFeatureRequest& addOrderBy( const QString& expression, bool ascending, bool nullsFirst );
+
+    /** Returns the names of the attributes used by the clauses to order by. Contains
+     * QgsFeatureRequest::AllAttributes if an expression needs all of them.
+     * @note added in 2.12
+     */
+    QSet<QString> orderByAttributes() const;
+
+    /** Sets the maximum number of features to return, -1 for no limit.
+     * @note added in 2.12
+     * @see limit
+     */
+    QgsFeatureRequest& setLimit( long limit );
+
+    /** Returns the maximum number of features to return, -1 if there is no limit.
+     * @note added in 2.12
+     * @see setLimit
+     */
+    long limit() const { return mLimit; }
+
     /**
      * Check if a feature is accepted by this requests filter
      *
@@ -204,7 +307,6 @@ class CORE_EXPORT QgsFeatureRequest
 
     // TODO: in future
     // void setFilterNativeExpression(con QString& expr);   // using provider's SQL (if supported)
-    // void setLimit(int limit);
 
   protected:
     FilterType mFilter;
@@ -216,6 +318,8 @@ class CORE_EXPORT QgsFeatureRequest
     Flags mFlags;
     QgsAttributeList mAttrs;
     QgsSimplifyMethod mSimplifyMethod;
+    OrderBy mOrderBy;
+    long mLimit;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS( QgsFeatureRequest::Flags )
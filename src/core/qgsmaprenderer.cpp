@@ -1103,28 +1103,36 @@ const QgsCoordinateTransform *QgsMapRenderer::transformation( const QgsMapLayer
     return 0;
   }
 
+  QSharedPointer<const QgsCoordinateTransform> ct;
   QHash< QString, QgsLayerCoordinateTransform >::const_iterator ctIt = mLayerCoordinateTransformInfo.find( layer->id() );
   if ( ctIt != mLayerCoordinateTransformInfo.constEnd()
        && ctIt->srcAuthId == layer->crs().authid()
        && ctIt->destAuthId == mDestCRS->authid() )
   {
-    return QgsCoordinateTransformCache::instance()->transform( ctIt->srcAuthId, ctIt->destAuthId, ctIt->srcDatumTransform, ctIt->destDatumTransform );
+    ct = QgsCoordinateTransformCache::instance()->sharedTransform( ctIt->srcAuthId, ctIt->destAuthId, ctIt->srcDatumTransform, ctIt->destDatumTransform );
   }
   else
   {
     emit datumTransformInfoRequested( layer, layer->crs().authid(), mDestCRS->authid() );
-  }
 
-  //still not present? get coordinate transformation with -1/-1 datum transform as default
-  ctIt = mLayerCoordinateTransformInfo.find( layer->id() );
-  if ( ctIt == mLayerCoordinateTransformInfo.constEnd()
-       || ctIt->srcAuthId == layer->crs().authid()
-       || ctIt->destAuthId == mDestCRS->authid()
-     )
-  {
-    return QgsCoordinateTransformCache::instance()->transform( layer->crs().authid(), mDestCRS->authid() );
+    //still not present? get coordinate transformation with -1/-1 datum transform as default
+    ctIt = mLayerCoordinateTransformInfo.find( layer->id() );
+    if ( ctIt == mLayerCoordinateTransformInfo.constEnd()
+         || ctIt->srcAuthId == layer->crs().authid()
+         || ctIt->destAuthId == mDestCRS->authid()
+       )
+    {
+      ct = QgsCoordinateTransformCache::instance()->sharedTransform( layer->crs().authid(), mDestCRS->authid() );
+    }
+    else
+    {
+      ct = QgsCoordinateTransformCache::instance()->sharedTransform( ctIt->srcAuthId, ctIt->destAuthId, ctIt->srcDatumTransform, ctIt->destDatumTransform );
+    }
   }
-  return QgsCoordinateTransformCache::instance()->transform( ctIt->srcAuthId, ctIt->destAuthId, ctIt->srcDatumTransform, ctIt->destDatumTransform );
+
+  // keep the transform alive for the caller, even if the cache drops it meanwhile
+  mLayerTransforms.insert( layer->id(), ct );
+  return ct.data();
 }
 
 /** Returns a QPainter::CompositionMode corresponding to a QgsMapRenderer::BlendMode
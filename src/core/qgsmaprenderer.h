@@ -21,6 +21,7 @@
 #include <QStringList>
 #include <QVector>
 #include <QPainter>
+#include <QSharedPointer>
 
 #include "qgis.h"
 #include "qgsrectangle.h"
@@ -446,6 +447,9 @@ class CORE_EXPORT QgsMapRenderer : public QObject
     QgsMapSettings mMapSettings;
 
     QHash< QString, QgsLayerCoordinateTransform > mLayerCoordinateTransformInfo;
+
+    //! transforms returned by transformation(), key = layer ID
+    mutable QHash< QString, QSharedPointer<const QgsCoordinateTransform> > mLayerTransforms;
 };
 
 #endif
@@ -15,13 +15,17 @@
 
 #include "qgspointlocator.h"
 
+#include "qgscoordinatetransform.h"
 #include "qgsgeometry.h"
 #include "qgsvectorlayer.h"
-#include "qgswkbptr.h"
+#include "qgsvectorlayerfeatureiterator.h"
+#include "qgsabstractgeometryv2.h"
+#include "qgspointv2.h"
 
 #include <spatialindex/SpatialIndex.h>
 
 #include <QLinkedListIterator>
+#include <QtConcurrentRun>
 
 using namespace SpatialIndex;
 
@@ -53,6 +57,11 @@ static SpatialIndex::Region rect2region( const QgsRectangle& rect )
 // is lower than epsilon it will have a special logic...
 static const double POINT_LOC_EPSILON = 1e-12;
 
+// R-Tree parameters
+static const double RTREE_FILL_FACTOR = 0.7;
+static const unsigned long RTREE_INDEX_CAPACITY = 10;
+static const unsigned long RTREE_LEAF_CAPACITY = 10;
+
 ////////////////////////////////////////////////////////////////////////////
 
 
@@ -78,116 +87,6 @@ class QgsPointLocator_Stream : public IDataStream
 ////////////////////////////////////////////////////////////////////////////
 
 
-/** Helper class used when traversing the index looking for vertices - builds a list of matches. */
-class QgsPointLocator_VisitorNearestVertex : public IVisitor
-{
-  public:
-    QgsPointLocator_VisitorNearestVertex( QgsPointLocator* pl, QgsPointLocator::Match& m, const QgsPoint& srcPoint, QgsPointLocator::MatchFilter* filter = 0 )
-        : mLocator( pl ), mBest( m ), mSrcPoint( srcPoint ), mFilter( filter ) {}
-
-    void visitNode( const INode& n ) override { Q_UNUSED( n ); }
-    void visitData( std::vector<const IData*>& v ) override { Q_UNUSED( v ); }
-
-    void visitData( const IData& d ) override
-    {
-      QgsFeatureId id = d.getIdentifier();
-      QgsGeometry* geom = mLocator->mGeoms.value( id );
-      int vertexIndex, beforeVertex, afterVertex;
-      double sqrDist;
-      QgsPoint pt = geom->closestVertex( mSrcPoint, vertexIndex, beforeVertex, afterVertex, sqrDist );
-
-      QgsPointLocator::Match m( QgsPointLocator::Vertex, mLocator->mLayer, id, sqrt( sqrDist ), pt, vertexIndex );
-      // in range queries the filter may reject some matches
-      if ( mFilter && !mFilter->acceptMatch( m ) )
-        return;
-
-      if ( !mBest.isValid() || m.distance() < mBest.distance() )
-        mBest = m;
-    }
-
-  private:
-    QgsPointLocator* mLocator;
-    QgsPointLocator::Match& mBest;
-    QgsPoint mSrcPoint;
-    QgsPointLocator::MatchFilter* mFilter;
-};
-
-
-////////////////////////////////////////////////////////////////////////////
-
-
-/** Helper class used when traversing the index looking for edges - builds a list of matches. */
-class QgsPointLocator_VisitorNearestEdge : public IVisitor
-{
-  public:
-    QgsPointLocator_VisitorNearestEdge( QgsPointLocator* pl, QgsPointLocator::Match& m, const QgsPoint& srcPoint, QgsPointLocator::MatchFilter* filter = 0 )
-        : mLocator( pl ), mBest( m ), mSrcPoint( srcPoint ), mFilter( filter ) {}
-
-    void visitNode( const INode& n ) override { Q_UNUSED( n ); }
-    void visitData( std::vector<const IData*>& v ) override { Q_UNUSED( v ); }
-
-    void visitData( const IData& d ) override
-    {
-      QgsFeatureId id = d.getIdentifier();
-      QgsGeometry* geom = mLocator->mGeoms.value( id );
-      QgsPoint pt;
-      int afterVertex;
-      double sqrDist = geom->closestSegmentWithContext( mSrcPoint, pt, afterVertex, 0, POINT_LOC_EPSILON );
-      if ( sqrDist < 0 )
-        return;
-
-      QgsPoint edgePoints[2];
-      edgePoints[0] = geom->vertexAt( afterVertex - 1 );
-      edgePoints[1] = geom->vertexAt( afterVertex );
-      QgsPointLocator::Match m( QgsPointLocator::Edge, mLocator->mLayer, id, sqrt( sqrDist ), pt, afterVertex - 1, edgePoints );
-      // in range queries the filter may reject some matches
-      if ( mFilter && !mFilter->acceptMatch( m ) )
-        return;
-
-      if ( !mBest.isValid() || m.distance() < mBest.distance() )
-        mBest = m;
-    }
-
-  private:
-    QgsPointLocator* mLocator;
-    QgsPointLocator::Match& mBest;
-    QgsPoint mSrcPoint;
-    QgsPointLocator::MatchFilter* mFilter;
-};
-
-
-////////////////////////////////////////////////////////////////////////////
-
-
-/** Helper class used when traversing the index with areas - builds a list of matches. */
-class QgsPointLocator_VisitorArea : public IVisitor
-{
-  public:
-    //! constructor
-    QgsPointLocator_VisitorArea( QgsPointLocator* pl, const QgsPoint& origPt, QgsPointLocator::MatchList& list )
-        : mLocator( pl ), mList( list ), mGeomPt( QgsGeometry::fromPoint( origPt ) ) {}
-
-    ~QgsPointLocator_VisitorArea() { delete mGeomPt; }
-
-    void visitNode( const INode& n ) override { Q_UNUSED( n ); }
-    void visitData( std::vector<const IData*>& v ) override { Q_UNUSED( v ); }
-
-    void visitData( const IData& d ) override
-    {
-      QgsFeatureId id = d.getIdentifier();
-      QgsGeometry* g = mLocator->mGeoms.value( id );
-      if ( g->intersects( mGeomPt ) )
-        mList << QgsPointLocator::Match( QgsPointLocator::Area, mLocator->mLayer, id, 0, QgsPoint() );
-    }
-  private:
-    QgsPointLocator* mLocator;
-    QgsPointLocator::MatchList& mList;
-    QgsGeometry* mGeomPt;
-};
-
-
-////////////////////////////////////////////////////////////////////////////
-
 // code adapted from
 // http://en.wikipedia.org/wiki/Cohen%E2%80%93Sutherland_algorithm
 struct _CohenSutherland
@@ -293,200 +192,553 @@ struct _CohenSutherland
 };
 
 
-static QgsPointLocator::MatchList _geometrySegmentsInRect( QgsGeometry* geom, const QgsRectangle& rect, QgsVectorLayer* vl, QgsFeatureId fid )
+////////////////////////////////////////////////////////////////////////////
+
+
+/** Vertices of a feature geometry, packed into flat arrays of coordinates.
+ * Vertices are numbered in the same way as by QgsGeometry. Geometries with curved
+ * segments keep a copy of the QgsGeometry instead.
+ * Queries may be restricted to the vertices first to last (inclusive) and the segments
+ * between them, last == -1 stands for the last vertex. Curved geometries ignore the range. */
+class QgsPointLocator_Geometry
+{
+  public:
+    //! Returns packed vertices of the geometry or null for empty geometries
+    static QgsPointLocator_Geometry* fromGeometry( const QgsGeometry* geom );
+
+    ~QgsPointLocator_Geometry() { delete mCurved; }
+
+    const QgsRectangle& boundingBox() const { return mBBox; }
+    //! Bounding box of the vertices first to last
+    QgsRectangle boundingBox( int first, int last ) const;
+
+    //! Split the rings into runs of at most maxSegments segments, returns first and last vertex of each run
+    QList< QPair<int, int> > chunks( int maxSegments ) const;
+
+    //! Find the vertex closest to the point, returns false if there is none
+    bool closestVertex( const QgsPoint& pt, QgsPoint& vertex, int& vertexIndex, double& sqrDist, int first = 0, int last = -1 ) const;
+    //! Find the segment closest to the point, returns false if there is none
+    bool closestSegment( const QgsPoint& pt, QgsPoint& minDistPoint, int& afterVertex, QgsPoint* edgePoints, double& sqrDist, int first = 0, int last = -1 ) const;
+    //! Add matches for the segments intersecting the rectangle to the list
+    void segmentsInRect( const QgsRectangle& rect, QgsVectorLayer* vl, QgsFeatureId fid, QgsPointLocator::MatchList& lst, int first = 0, int last = -1 ) const;
+    //! Whether the point is inside or on the boundary of the geometry
+    bool contains( const QgsPoint& pt ) const;
+
+  private:
+    QgsPointLocator_Geometry() : mPolygon( false ), mCurved( 0 ) {}
+
+    double x( int i ) const { return mCoords[2 * i]; }
+    double y( int i ) const { return mCoords[2 * i + 1]; }
+    int ringCount() const { return mRings.size() - 1; }
+    int vertexCount() const { return mCoords.size() / 2; }
+    //! ring of the vertex
+    int ringOf( int vertex ) const { return qUpperBound( mRings.constBegin(), mRings.constEnd(), vertex ) - mRings.constBegin() - 1; }
+    //! vertices after which segments end in ring r and range first to last
+    void segmentRange( int r, int first, int last, int& from, int& to ) const;
+    //! squared distance of the point to the segment ending at vertex i
+    double sqrDistToSegment( const QgsPoint& pt, int i, QgsPoint& minDistPoint ) const;
+    //! whether the point lies on a segment or vertex of the rings in [firstRing, lastRing)
+    bool touches( const QgsPoint& pt, int firstRing, int lastRing ) const;
+
+    //! whether the geometry is a polygon or multi polygon
+    bool mPolygon;
+    //! x and y of all vertices
+    QVector<double> mCoords;
+    //! index of the first vertex of each ring (or linestring or point), followed by the number of vertices
+    QVector<int> mRings;
+    //! index of the first ring of each part, followed by the number of rings
+    QVector<int> mParts;
+    QgsRectangle mBBox;
+    //! geometry with curved segments
+    QgsGeometry* mCurved;
+};
+
+QgsPointLocator_Geometry* QgsPointLocator_Geometry::fromGeometry( const QgsGeometry* geom )
+{
+  const QgsAbstractGeometryV2* g = geom ? geom->geometry() : 0;
+  if ( !g || g->isEmpty() )
+    return 0;
+
+  QgsPointLocator_Geometry* pg = new QgsPointLocator_Geometry;
+  pg->mBBox = geom->boundingBox();
+  pg->mPolygon = QgsWKBTypes::geometryType( g->wkbType() ) == QgsWKBTypes::PolygonGeometry;
+
+  if ( g->hasCurvedSegments() )
+  {
+    pg->mCurved = new QgsGeometry( *geom );
+    return pg;
+  }
+
+  QList< QList< QList< QgsPointV2 > > > coords;
+  g->coordinateSequence( coords );
+
+  int nVertices = 0, nRings = 0;
+  Q_FOREACH ( const QList< QList< QgsPointV2 > >& part, coords )
+  {
+    nRings += part.size();
+    Q_FOREACH ( const QList< QgsPointV2 >& ring, part )
+      nVertices += ring.size();
+  }
+
+  pg->mCoords.reserve( 2 * nVertices );
+  pg->mRings.reserve( nRings + 1 );
+  pg->mParts.reserve( coords.size() + 1 );
+  Q_FOREACH ( const QList< QList< QgsPointV2 > >& part, coords )
+  {
+    pg->mParts << pg->mRings.size();
+    Q_FOREACH ( const QList< QgsPointV2 >& ring, part )
+    {
+      pg->mRings << pg->mCoords.size() / 2;
+      Q_FOREACH ( const QgsPointV2& pt, ring )
+        pg->mCoords << pt.x() << pt.y();
+    }
+  }
+  pg->mParts << pg->mRings.size();
+  pg->mRings << nVertices;
+  return pg;
+}
+
+double QgsPointLocator_Geometry::sqrDistToSegment( const QgsPoint& pt, int i, QgsPoint& minDistPoint ) const
+{
+  if ( x( i - 1 ) == x( i ) && y( i - 1 ) == y( i ) )
+  {
+    // repeated vertex
+    minDistPoint.set( x( i ), y( i ) );
+    return pt.sqrDist( minDistPoint );
+  }
+  return pt.sqrDistToSegment( x( i - 1 ), y( i - 1 ), x( i ), y( i ), minDistPoint, POINT_LOC_EPSILON );
+}
+
+QgsRectangle QgsPointLocator_Geometry::boundingBox( int first, int last ) const
+{
+  if ( mCurved || last < 0 )
+    return mBBox;
+
+  QgsRectangle rect( x( first ), y( first ), x( first ), y( first ) );
+  for ( int i = first + 1; i <= last; ++i )
+  {
+    rect.setXMinimum( qMin( rect.xMinimum(), x( i ) ) );
+    rect.setYMinimum( qMin( rect.yMinimum(), y( i ) ) );
+    rect.setXMaximum( qMax( rect.xMaximum(), x( i ) ) );
+    rect.setYMaximum( qMax( rect.yMaximum(), y( i ) ) );
+  }
+  return rect;
+}
+
+QList< QPair<int, int> > QgsPointLocator_Geometry::chunks( int maxSegments ) const
+{
+  QList< QPair<int, int> > lst;
+  if ( mCurved )
+  {
+    lst << qMakePair( 0, -1 );
+    return lst;
+  }
+
+  for ( int r = 0; r < ringCount(); ++r )
+  {
+    int start = mRings[r], end = mRings[r + 1] - 1;
+    if ( start == end )
+      lst << qMakePair( start, end ); // point
+    // consecutive runs share a vertex so that each segment belongs to exactly one run
+    for ( int i = start; i < end; i += maxSegments )
+      lst << qMakePair( i, qMin( i + maxSegments, end ) );
+  }
+  return lst;
+}
+
+void QgsPointLocator_Geometry::segmentRange( int r, int first, int last, int& from, int& to ) const
+{
+  from = qMax( mRings[r] + 1, first + 1 );
+  to = mRings[r + 1] - 1;
+  if ( last >= 0 )
+    to = qMin( to, last );
+}
+
+bool QgsPointLocator_Geometry::closestVertex( const QgsPoint& pt, QgsPoint& vertex, int& vertexIndex, double& sqrDist, int first, int last ) const
+{
+  if ( mCurved )
+  {
+    int beforeVertex, afterVertex;
+    vertex = mCurved->closestVertex( pt, vertexIndex, beforeVertex, afterVertex, sqrDist );
+    return sqrDist >= 0;
+  }
+
+  if ( last < 0 )
+    last = vertexCount() - 1;
+  if ( first > last )
+    return false;
+
+  vertexIndex = first;
+  sqrDist = pt.sqrDist( x( first ), y( first ) );
+  for ( int i = first + 1; i <= last; ++i )
+  {
+    double d = pt.sqrDist( x( i ), y( i ) );
+    if ( d < sqrDist )
+    {
+      sqrDist = d;
+      vertexIndex = i;
+    }
+  }
+  vertex.set( x( vertexIndex ), y( vertexIndex ) );
+  return true;
+}
+
+bool QgsPointLocator_Geometry::closestSegment( const QgsPoint& pt, QgsPoint& minDistPoint, int& afterVertex, QgsPoint* edgePoints, double& sqrDist, int first, int last ) const
+{
+  if ( mCurved )
+  {
+    sqrDist = mCurved->closestSegmentWithContext( pt, minDistPoint, afterVertex, 0, POINT_LOC_EPSILON );
+    if ( sqrDist < 0 )
+      return false;
+
+    edgePoints[0] = mCurved->vertexAt( afterVertex - 1 );
+    edgePoints[1] = mCurved->vertexAt( afterVertex );
+    return true;
+  }
+
+  bool found = false;
+  for ( int r = ringOf( first ); r < ringCount() && ( last < 0 || mRings[r] <= last ); ++r )
+  {
+    int from, to;
+    segmentRange( r, first, last, from, to );
+    for ( int i = from; i <= to; ++i )
+    {
+      QgsPoint segmentPt;
+      double d = sqrDistToSegment( pt, i, segmentPt );
+      if ( !found || d < sqrDist )
+      {
+        found = true;
+        sqrDist = d;
+        minDistPoint = segmentPt;
+        afterVertex = i;
+      }
+    }
+  }
+
+  if ( found )
+  {
+    edgePoints[0].set( x( afterVertex - 1 ), y( afterVertex - 1 ) );
+    edgePoints[1].set( x( afterVertex ), y( afterVertex ) );
+  }
+  return found;
+}
+
+void QgsPointLocator_Geometry::segmentsInRect( const QgsRectangle& rect, QgsVectorLayer* vl, QgsFeatureId fid, QgsPointLocator::MatchList& lst, int first, int last ) const
+{
+  if ( mCurved )
+    return; // only linear segments are supported
+
+  _CohenSutherland cs( rect );
+
+  for ( int r = ringOf( first ); r < ringCount() && ( last < 0 || mRings[r] <= last ); ++r )
+  {
+    int from, to;
+    segmentRange( r, first, last, from, to );
+    for ( int i = from; i <= to; ++i )
+    {
+      if ( cs.isSegmentInRect( x( i - 1 ), y( i - 1 ), x( i ), y( i ) ) )
+      {
+        QgsPoint edgePoints[2];
+        edgePoints[0].set( x( i - 1 ), y( i - 1 ) );
+        edgePoints[1].set( x( i ), y( i ) );
+        lst << QgsPointLocator::Match( QgsPointLocator::Edge, vl, fid, 0, QgsPoint(), i - 1, edgePoints );
+      }
+    }
+  }
+}
+
+bool QgsPointLocator_Geometry::touches( const QgsPoint& pt, int firstRing, int lastRing ) const
+{
+  for ( int r = firstRing; r < lastRing; ++r )
+  {
+    if ( mRings[r + 1] - mRings[r] == 1 && pt.sqrDist( x( mRings[r] ), y( mRings[r] ) ) == 0 )
+      return true;
+
+    for ( int i = mRings[r] + 1; i < mRings[r + 1]; ++i )
+    {
+      QgsPoint segmentPt;
+      if ( sqrDistToSegment( pt, i, segmentPt ) == 0 )
+        return true;
+    }
+  }
+  return false;
+}
+
+bool QgsPointLocator_Geometry::contains( const QgsPoint& pt ) const
+{
+  if ( mCurved )
+  {
+    QgsGeometry* geomPt = QgsGeometry::fromPoint( pt );
+    bool res = mCurved->intersects( geomPt );
+    delete geomPt;
+    return res;
+  }
+
+  if ( !mBBox.contains( pt ) )
+    return false;
+
+  if ( !mPolygon )
+    return touches( pt, 0, ringCount() );
+
+  for ( int p = 0; p < mParts.size() - 1; ++p )
+  {
+    if ( touches( pt, mParts[p], mParts[p + 1] ) )
+      return true;
+
+    // even-odd rule over all rings of the part takes care of the holes
+    bool inside = false;
+    for ( int r = mParts[p]; r < mParts[p + 1]; ++r )
+    {
+      for ( int i = mRings[r] + 1; i < mRings[r + 1]; ++i )
+      {
+        double x0 = x( i - 1 ), y0 = y( i - 1 ), x1 = x( i ), y1 = y( i );
+        if (( y0 > pt.y() ) != ( y1 > pt.y() ) && pt.x() < ( x1 - x0 ) * ( pt.y() - y0 ) / ( y1 - y0 ) + x0 )
+          inside = !inside;
+      }
+    }
+    if ( inside )
+      return true;
+  }
+  return false;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+
+
+/** Index of the vertices and segments of the features, stored as runs of up to ChunkSize
+ * segments so that the cost of queries does not depend on the size of the features.
+ * Geometries with curved segments are stored as a single entry. */
+class QgsPointLocator_SegmentIndex
+{
+  public:
+    static const int ChunkSize = 32;
+
+    //! Create the index of the geometries in the storage
+    QgsPointLocator_SegmentIndex( IStorageManager& storage, const QHash<QgsFeatureId, QgsPointLocator_Geometry*>& geoms );
+    ~QgsPointLocator_SegmentIndex() { delete mRTree; }
+
+    ISpatialIndex* tree() const { return mRTree; }
+
+    void addFeature( QgsFeatureId fid, const QgsPointLocator_Geometry* geom );
+    void removeFeature( QgsFeatureId fid, const QgsPointLocator_Geometry* geom );
+
+    //! Get the feature and the range of vertices of an entry of the index
+    void resolve( id_type entry, QgsFeatureId& fid, int& first, int& last ) const
+    {
+      const Chunk& c = mChunks[entry];
+      fid = c.fid;
+      first = c.first;
+      last = c.last;
+    }
+
+  private:
+    struct Chunk
+    {
+      QgsFeatureId fid;
+      int first;
+      int last;
+    };
+
+    //! Store the chunks of the geometry in the table, returns their ids and bounding boxes
+    QList< QPair<int, QgsRectangle> > registerChunks( QgsFeatureId fid, const QgsPointLocator_Geometry* geom );
+
+    ISpatialIndex* mRTree;
+    QVector<Chunk> mChunks;
+    //! ids of removed chunks, reused by new ones
+    QVector<int> mFreeIds;
+    //! ids of the chunks of each feature
+    QHash<QgsFeatureId, QVector<int> > mFeatureChunks;
+};
+
+QgsPointLocator_SegmentIndex::QgsPointLocator_SegmentIndex( IStorageManager& storage, const QHash<QgsFeatureId, QgsPointLocator_Geometry*>& geoms )
+    : mRTree( 0 )
+{
+  QLinkedList<RTree::Data*> dataList;
+  QHash<QgsFeatureId, QgsPointLocator_Geometry*>::const_iterator it = geoms.constBegin();
+  for ( ; it != geoms.constEnd(); ++it )
+  {
+    QList< QPair<int, QgsRectangle> > lst = registerChunks( it.key(), it.value() );
+    for ( int i = 0; i < lst.count(); ++i )
+      dataList << new RTree::Data( 0, 0, rect2region( lst[i].second ), lst[i].first );
+  }
+
+  SpatialIndex::id_type indexId;
+  if ( dataList.isEmpty() )
+  {
+    mRTree = RTree::createNewRTree( storage, RTREE_FILL_FACTOR, RTREE_INDEX_CAPACITY, RTREE_LEAF_CAPACITY, 2, RTree::RV_RSTAR, indexId );
+    return;
+  }
+
+  QgsPointLocator_Stream stream( dataList );
+  mRTree = RTree::createAndBulkLoadNewRTree( RTree::BLM_STR, stream, storage, RTREE_FILL_FACTOR, RTREE_INDEX_CAPACITY,
+           RTREE_LEAF_CAPACITY, 2, RTree::RV_RSTAR, indexId );
+}
+
+QList< QPair<int, QgsRectangle> > QgsPointLocator_SegmentIndex::registerChunks( QgsFeatureId fid, const QgsPointLocator_Geometry* geom )
+{
+  QList< QPair<int, QgsRectangle> > res;
+  QVector<int>& ids = mFeatureChunks[fid];
+  QList< QPair<int, int> > ranges = geom->chunks( ChunkSize );
+  for ( int i = 0; i < ranges.count(); ++i )
+  {
+    Chunk c;
+    c.fid = fid;
+    c.first = ranges[i].first;
+    c.last = ranges[i].second;
+
+    int id;
+    if ( !mFreeIds.isEmpty() )
+    {
+      id = mFreeIds.last();
+      mFreeIds.pop_back();
+      mChunks[id] = c;
+    }
+    else
+    {
+      id = mChunks.count();
+      mChunks.append( c );
+    }
+
+    ids << id;
+    res << qMakePair( id, geom->boundingBox( c.first, c.last ) );
+  }
+  return res;
+}
+
+void QgsPointLocator_SegmentIndex::addFeature( QgsFeatureId fid, const QgsPointLocator_Geometry* geom )
+{
+  QList< QPair<int, QgsRectangle> > lst = registerChunks( fid, geom );
+  for ( int i = 0; i < lst.count(); ++i )
+    mRTree->insertData( 0, 0, rect2region( lst[i].second ), lst[i].first );
+}
+
+void QgsPointLocator_SegmentIndex::removeFeature( QgsFeatureId fid, const QgsPointLocator_Geometry* geom )
 {
-  // this code is stupidly based on QgsGeometry::closestSegmentWithContext
-  // we need iterator for segments...
+  Q_FOREACH ( int id, mFeatureChunks.take( fid ) )
+  {
+    const Chunk& c = mChunks[id];
+    mRTree->deleteData( rect2region( geom->boundingBox( c.first, c.last ) ), id );
+    mFreeIds << id;
+  }
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+
+
+/** Helper class used when traversing the index looking for vertices - builds a list of matches. */
+class QgsPointLocator_VisitorNearestVertex : public IVisitor
+{
+  public:
+    QgsPointLocator_VisitorNearestVertex( QgsPointLocator* pl, QgsPointLocator::Match& m, const QgsPoint& srcPoint, QgsPointLocator::MatchFilter* filter = 0 )
+        : mLocator( pl ), mBest( m ), mSrcPoint( srcPoint ), mFilter( filter ) {}
+
+    void visitNode( const INode& n ) override { Q_UNUSED( n ); }
+    void visitData( std::vector<const IData*>& v ) override { Q_UNUSED( v ); }
+
+    void visitData( const IData& d ) override
+    {
+      QgsFeatureId id;
+      int first, last;
+      mLocator->resolveEntry( d.getIdentifier(), id, first, last );
+      QgsPointLocator_Geometry* geom = mLocator->mGeoms.value( id );
+      int vertexIndex;
+      double sqrDist;
+      QgsPoint pt;
+      if ( !geom->closestVertex( mSrcPoint, pt, vertexIndex, sqrDist, first, last ) )
+        return;
 
-  QgsPointLocator::MatchList lst;
-  unsigned char* wkb = const_cast<unsigned char*>( geom->asWkb() ); // we're not changing wkb, just need non-const for QgsWkbPtr
-  if ( !wkb )
-    return lst;
+      QgsPointLocator::Match m( QgsPointLocator::Vertex, mLocator->mLayer, id, sqrt( sqrDist ), pt, vertexIndex );
+      // in range queries the filter may reject some matches
+      if ( mFilter && !mFilter->acceptMatch( m ) )
+        return;
 
-  _CohenSutherland cs( rect );
+      if ( !mBest.isValid() || m.distance() < mBest.distance() )
+        mBest = m;
+    }
 
-  QgsWkbPtr wkbPtr( wkb + 1 );
-  QGis::WkbType wkbType;
-  wkbPtr >> wkbType;
+  private:
+    QgsPointLocator* mLocator;
+    QgsPointLocator::Match& mBest;
+    QgsPoint mSrcPoint;
+    QgsPointLocator::MatchFilter* mFilter;
+};
 
-  bool hasZValue = false;
-  switch ( wkbType )
-  {
-    case QGis::WKBPoint25D:
-    case QGis::WKBPoint:
-    case QGis::WKBMultiPoint25D:
-    case QGis::WKBMultiPoint:
-    {
-      // Points have no lines
-      return lst;
-    }
 
-    case QGis::WKBLineString25D:
-      hasZValue = true;
-      //intentional fall-through
-    case QGis::WKBLineString:
-    {
-      int nPoints;
-      wkbPtr >> nPoints;
+////////////////////////////////////////////////////////////////////////////
 
-      double prevx = 0.0, prevy = 0.0;
-      for ( int index = 0; index < nPoints; ++index )
-      {
-        double thisx, thisy;
-        wkbPtr >> thisx >> thisy;
-        if ( hasZValue )
-          wkbPtr += sizeof( double );
 
-        if ( index > 0 )
-        {
-          if ( cs.isSegmentInRect( prevx, prevy, thisx, thisy ) )
-          {
-            QgsPoint edgePoints[2];
-            edgePoints[0].set( prevx, prevy );
-            edgePoints[1].set( thisx, thisy );
-            lst << QgsPointLocator::Match( QgsPointLocator::Edge, vl, fid, 0, QgsPoint(), index - 1, edgePoints );
-          }
-        }
+/** Helper class used when traversing the index looking for edges - builds a list of matches. */
+class QgsPointLocator_VisitorNearestEdge : public IVisitor
+{
+  public:
+    QgsPointLocator_VisitorNearestEdge( QgsPointLocator* pl, QgsPointLocator::Match& m, const QgsPoint& srcPoint, QgsPointLocator::MatchFilter* filter = 0 )
+        : mLocator( pl ), mBest( m ), mSrcPoint( srcPoint ), mFilter( filter ) {}
 
-        prevx = thisx;
-        prevy = thisy;
-      }
-      break;
-    }
+    void visitNode( const INode& n ) override { Q_UNUSED( n ); }
+    void visitData( std::vector<const IData*>& v ) override { Q_UNUSED( v ); }
 
-    case QGis::WKBMultiLineString25D:
-      hasZValue = true;
-      //intentional fall-through
-    case QGis::WKBMultiLineString:
+    void visitData( const IData& d ) override
     {
-      int nLines;
-      wkbPtr >> nLines;
-      for ( int linenr = 0, pointIndex = 0; linenr < nLines; ++linenr )
-      {
-        wkbPtr += 1 + sizeof( int );
-        int nPoints;
-        wkbPtr >> nPoints;
-
-        double prevx = 0.0, prevy = 0.0;
-        for ( int pointnr = 0; pointnr < nPoints; ++pointnr )
-        {
-          double thisx, thisy;
-          wkbPtr >> thisx >> thisy;
-          if ( hasZValue )
-            wkbPtr += sizeof( double );
+      QgsFeatureId id;
+      int first, last;
+      mLocator->resolveEntry( d.getIdentifier(), id, first, last );
+      QgsPointLocator_Geometry* geom = mLocator->mGeoms.value( id );
+      QgsPoint pt;
+      int afterVertex;
+      double sqrDist;
+      QgsPoint edgePoints[2];
+      if ( !geom->closestSegment( mSrcPoint, pt, afterVertex, edgePoints, sqrDist, first, last ) )
+        return;
 
-          if ( pointnr > 0 )
-          {
-            if ( cs.isSegmentInRect( prevx, prevy, thisx, thisy ) )
-            {
-              QgsPoint edgePoints[2];
-              edgePoints[0].set( prevx, prevy );
-              edgePoints[1].set( thisx, thisy );
-              lst << QgsPointLocator::Match( QgsPointLocator::Edge, vl, fid, 0, QgsPoint(), pointIndex - 1, edgePoints );
-            }
-          }
+      QgsPointLocator::Match m( QgsPointLocator::Edge, mLocator->mLayer, id, sqrt( sqrDist ), pt, afterVertex - 1, edgePoints );
+      // in range queries the filter may reject some matches
+      if ( mFilter && !mFilter->acceptMatch( m ) )
+        return;
 
-          prevx = thisx;
-          prevy = thisy;
-          ++pointIndex;
-        }
-      }
-      break;
+      if ( !mBest.isValid() || m.distance() < mBest.distance() )
+        mBest = m;
     }
 
-    case QGis::WKBPolygon25D:
-      hasZValue = true;
-      //intentional fall-through
-    case QGis::WKBPolygon:
-    {
-      int nRings;
-      wkbPtr >> nRings;
+  private:
+    QgsPointLocator* mLocator;
+    QgsPointLocator::Match& mBest;
+    QgsPoint mSrcPoint;
+    QgsPointLocator::MatchFilter* mFilter;
+};
 
-      for ( int ringnr = 0, pointIndex = 0; ringnr < nRings; ++ringnr )//loop over rings
-      {
-        int nPoints;
-        wkbPtr >> nPoints;
 
-        double prevx = 0.0, prevy = 0.0;
-        for ( int pointnr = 0; pointnr < nPoints; ++pointnr )//loop over points in a ring
-        {
-          double thisx, thisy;
-          wkbPtr >> thisx >> thisy;
-          if ( hasZValue )
-            wkbPtr += sizeof( double );
+////////////////////////////////////////////////////////////////////////////
 
-          if ( pointnr > 0 )
-          {
-            if ( cs.isSegmentInRect( prevx, prevy, thisx, thisy ) )
-            {
-              QgsPoint edgePoints[2];
-              edgePoints[0].set( prevx, prevy );
-              edgePoints[1].set( thisx, thisy );
-              lst << QgsPointLocator::Match( QgsPointLocator::Edge, vl, fid, 0, QgsPoint(), pointIndex - 1, edgePoints );
-            }
-          }
 
-          prevx = thisx;
-          prevy = thisy;
-          ++pointIndex;
-        }
-      }
-      break;
-    }
+/** Helper class used when traversing the index with areas - builds a list of matches. */
+class QgsPointLocator_VisitorArea : public IVisitor
+{
+  public:
+    //! constructor
+    QgsPointLocator_VisitorArea( QgsPointLocator* pl, const QgsPoint& origPt, QgsPointLocator::MatchList& list )
+        : mLocator( pl ), mList( list ), mPoint( origPt ) {}
 
-    case QGis::WKBMultiPolygon25D:
-      hasZValue = true;
-      //intentional fall-through
-    case QGis::WKBMultiPolygon:
-    {
-      int nPolygons;
-      wkbPtr >> nPolygons;
-      for ( int polynr = 0, pointIndex = 0; polynr < nPolygons; ++polynr )
-      {
-        wkbPtr += 1 + sizeof( int );
-        int nRings;
-        wkbPtr >> nRings;
-        for ( int ringnr = 0; ringnr < nRings; ++ringnr )
-        {
-          int nPoints;
-          wkbPtr >> nPoints;
+    void visitNode( const INode& n ) override { Q_UNUSED( n ); }
+    void visitData( std::vector<const IData*>& v ) override { Q_UNUSED( v ); }
 
-          double prevx = 0.0, prevy = 0.0;
-          for ( int pointnr = 0; pointnr < nPoints; ++pointnr )
-          {
-            double thisx, thisy;
-            wkbPtr >> thisx >> thisy;
-            if ( hasZValue )
-              wkbPtr += sizeof( double );
-
-            if ( pointnr > 0 )
-            {
-              if ( cs.isSegmentInRect( prevx, prevy, thisx, thisy ) )
-              {
-                QgsPoint edgePoints[2];
-                edgePoints[0].set( prevx, prevy );
-                edgePoints[1].set( thisx, thisy );
-                lst << QgsPointLocator::Match( QgsPointLocator::Edge, vl, fid, 0, QgsPoint(), pointIndex - 1, edgePoints );
-              }
-            }
-
-            prevx = thisx;
-            prevy = thisy;
-            ++pointIndex;
-          }
-        }
-      }
-      break;
+    void visitData( const IData& d ) override
+    {
+      QgsFeatureId id = d.getIdentifier();
+      QgsPointLocator_Geometry* g = mLocator->mGeoms.value( id );
+      if ( g->contains( mPoint ) )
+        mList << QgsPointLocator::Match( QgsPointLocator::Area, mLocator->mLayer, id, 0, QgsPoint() );
     }
+  private:
+    QgsPointLocator* mLocator;
+    QgsPointLocator::MatchList& mList;
+    QgsPoint mPoint;
+};
 
-    case QGis::WKBUnknown:
-    default:
-      return lst;
-      break;
-  } // switch (wkbType)
 
-  return lst;
-}
+////////////////////////////////////////////////////////////////////////////
+
 
 /** Helper class used when traversing the index looking for edges - builds a list of matches. */
 class QgsPointLocator_VisitorEdgesInRect : public IVisitor
@@ -500,10 +752,14 @@ class QgsPointLocator_VisitorEdgesInRect : public IVisitor
 
     void visitData( const IData& d ) override
     {
-      QgsFeatureId id = d.getIdentifier();
-      QgsGeometry* geom = mLocator->mGeoms.value( id );
-
-      Q_FOREACH ( const QgsPointLocator::Match& m, _geometrySegmentsInRect( geom, mSrcRect, mLocator->mLayer, id ) )
+      QgsFeatureId id;
+      int first, last;
+      mLocator->resolveEntry( d.getIdentifier(), id, first, last );
+      QgsPointLocator_Geometry* geom = mLocator->mGeoms.value( id );
+
+      QgsPointLocator::MatchList lst;
+      geom->segmentsInRect( mSrcRect, mLocator->mLayer, id, lst, first, last );
+      Q_FOREACH ( const QgsPointLocator::Match& m, lst )
       {
         // in range queries the filter may reject some matches
         if ( mFilter && !mFilter->acceptMatch( m ) )
@@ -523,6 +779,8 @@ class QgsPointLocator_VisitorEdgesInRect : public IVisitor
 
 
 ////////////////////////////////////////////////////////////////////////////
+
+
 #include <QStack>
 
 /** Helper class to dump the R-index nodes and their content */
@@ -571,6 +829,168 @@ class QgsPointLocator_DumpTree : public SpatialIndex::IQueryStrategy
 ////////////////////////////////////////////////////////////////////////////
 
 
+
+
+/** Builds the spatial index of a layer, possibly in a worker thread.
+ * Everything it needs from the layer is copied in the constructor, which runs in the main thread. */
+class QgsPointLocator_Builder
+{
+  public:
+    QgsPointLocator_Builder( QgsVectorLayer* layer, const QgsCoordinateTransform* transform, const QgsRectangle* extent, int maxFeaturesToIndex, QgsPointLocator::IndexGranularity granularity )
+        : mOk( true )
+        , mIsEmptyLayer( false )
+        , mStorage( 0 )
+        , mRTree( 0 )
+        , mSegments( 0 )
+        , mGranularity( granularity )
+        , mSource( 0 )
+        , mTransform( 0 )
+        , mMaxFeaturesToIndex( maxFeaturesToIndex )
+    {
+      if ( layer->geometryType() == QGis::NoGeometry )
+        return; // nothing to index
+
+      mSource = new QgsVectorLayerFeatureSource( layer );
+      if ( transform )
+        mTransform = new QgsCoordinateTransform( transform->sourceCrs(), transform->destCRS() );
+
+      mRequest.setSubsetOfAttributes( QgsAttributeList() );
+      if ( extent )
+      {
+        QgsRectangle rect = *extent;
+        if ( mTransform )
+        {
+          try
+          {
+            rect = mTransform->transformBoundingBox( rect, QgsCoordinateTransform::ReverseTransform );
+          }
+          catch ( const QgsException& e )
+          {
+            // See http://hub.qgis.org/issues/12634
+            QgsDebugMsg( QString( "could not transform bounding box to map, skipping the snap filter (%1)" ).arg( e.what() ) );
+          }
+        }
+        mRequest.setFilterRect( rect );
+      }
+    }
+
+    ~QgsPointLocator_Builder()
+    {
+      delete mSegments;
+      delete mRTree;
+      delete mStorage;
+      qDeleteAll( mGeoms );
+      delete mSource;
+      delete mTransform;
+    }
+
+    //! Reads the features and builds the index
+    void build()
+    {
+      if ( !mSource )
+        return;
+
+      QLinkedList<RTree::Data*> dataList;
+      QgsFeature f;
+      QgsFeatureIterator fi = mSource->getFeatures( mRequest );
+      int indexedCount = 0;
+      while ( fi.nextFeature( f ) )
+      {
+        if ( mCanceled )
+          break;
+
+        if ( !f.constGeometry() )
+          continue;
+
+        if ( mTransform )
+        {
+          try
+          {
+            f.geometry()->transform( *mTransform );
+          }
+          catch ( const QgsException& e )
+          {
+            // See http://hub.qgis.org/issues/12634
+            QgsDebugMsg( QString( "could not transform geometry to map, skipping the snap for it (%1)" ).arg( e.what() ) );
+            continue;
+          }
+        }
+
+        QgsPointLocator_Geometry* geom = QgsPointLocator_Geometry::fromGeometry( f.constGeometry() );
+        if ( !geom )
+          continue;
+
+        dataList << new RTree::Data( 0, 0, rect2region( geom->boundingBox() ), f.id() );
+
+        if ( mGeoms.contains( f.id() ) )
+          delete mGeoms.take( f.id() );
+        mGeoms[f.id()] = geom;
+        ++indexedCount;
+
+        if ( mMaxFeaturesToIndex != -1 && indexedCount > mMaxFeaturesToIndex )
+        {
+          mOk = false;
+          break;
+        }
+      }
+
+      if ( !mOk || mCanceled )
+      {
+        qDeleteAll( dataList );
+        qDeleteAll( mGeoms );
+        mGeoms.clear();
+        return;
+      }
+
+      if ( dataList.isEmpty() )
+      {
+        mIsEmptyLayer = true;
+        return; // no features
+      }
+
+      mStorage = StorageManager::createNewMemoryStorageManager();
+      QgsPointLocator_Stream stream( dataList );
+      SpatialIndex::id_type indexId;
+      mRTree = RTree::createAndBulkLoadNewRTree( RTree::BLM_STR, stream, *mStorage, RTREE_FILL_FACTOR, RTREE_INDEX_CAPACITY,
+               RTREE_LEAF_CAPACITY, 2, RTree::RV_RSTAR, indexId );
+
+      if ( mGranularity == QgsPointLocator::IndexSegments )
+        mSegments = new QgsPointLocator_SegmentIndex( *mStorage, mGeoms );
+    }
+
+    //! Stops the build, the result is discarded
+    void cancel() { mCanceled = 1; }
+
+    //! Creates an empty index for a layer which had no features when it was indexed
+    static ISpatialIndex* createEmptyRTree( IStorageManager& storage )
+    {
+      SpatialIndex::id_type indexId;
+      return RTree::createNewRTree( storage, RTREE_FILL_FACTOR, RTREE_INDEX_CAPACITY, RTREE_LEAF_CAPACITY, 2, RTree::RV_RSTAR, indexId );
+    }
+
+    //! false if the build stopped due to the limit of features
+    bool mOk;
+    bool mIsEmptyLayer;
+    IStorageManager* mStorage;
+    ISpatialIndex* mRTree;
+    //! index of vertices and segments, only built for IndexSegments
+    QgsPointLocator_SegmentIndex* mSegments;
+    QHash<QgsFeatureId, QgsPointLocator_Geometry*> mGeoms;
+
+  private:
+    QgsPointLocator::IndexGranularity mGranularity;
+    QgsVectorLayerFeatureSource* mSource;
+    QgsCoordinateTransform* mTransform;
+    QgsFeatureRequest mRequest;
+    int mMaxFeaturesToIndex;
+    QAtomicInt mCanceled;
+};
+
+
+
+////////////////////////////////////////////////////////////////////////////
+
+
 QgsPointLocator::QgsPointLocator( QgsVectorLayer* layer, const QgsCoordinateReferenceSystem* destCRS, const QgsRectangle* extent )
     : mStorage( 0 )
     , mRTree( 0 )
@@ -578,6 +998,9 @@ QgsPointLocator::QgsPointLocator( QgsVectorLayer* layer, const QgsCoordinateRefe
     , mTransform( 0 )
     , mLayer( layer )
     , mExtent( 0 )
+    , mGranularity( IndexFeatures )
+    , mSegments( 0 )
+    , mBuilder( 0 )
 {
   if ( destCRS )
   {
@@ -589,18 +1012,23 @@ QgsPointLocator::QgsPointLocator( QgsVectorLayer* layer, const QgsCoordinateRefe
     mExtent = new QgsRectangle( *extent );
   }
 
-  mStorage = StorageManager::createNewMemoryStorageManager();
-
   connect( mLayer, SIGNAL( featureAdded( QgsFeatureId ) ), this, SLOT( onFeatureAdded( QgsFeatureId ) ) );
   connect( mLayer, SIGNAL( featureDeleted( QgsFeatureId ) ), this, SLOT( onFeatureDeleted( QgsFeatureId ) ) );
   connect( mLayer, SIGNAL( geometryChanged( QgsFeatureId, QgsGeometry& ) ), this, SLOT( onGeometryChanged( QgsFeatureId, QgsGeometry& ) ) );
+  connect( &mFutureWatcher, SIGNAL( finished() ), this, SLOT( onInitTaskFinished() ) );
 }
 
 
 QgsPointLocator::~QgsPointLocator()
 {
+  if ( mBuilder )
+  {
+    mBuilder->cancel();
+    mFutureWatcher.waitForFinished();
+    delete mBuilder;
+  }
+
   destroyIndex();
-  delete mStorage;
   delete mTransform;
   delete mExtent;
 }
@@ -608,108 +1036,138 @@ QgsPointLocator::~QgsPointLocator()
 
 bool QgsPointLocator::init( int maxFeaturesToIndex )
 {
+  waitForIndexingFinished();
   return hasIndex() ? true : rebuildIndex( maxFeaturesToIndex );
 }
 
-bool QgsPointLocator::hasIndex() const
+void QgsPointLocator::initInBackground( int maxFeaturesToIndex )
 {
-  return mRTree != 0 || mIsEmptyLayer;
+  if ( mBuilder || hasIndex() )
+    return; // already indexing or indexed
+
+  mPendingChanges.clear();
+  mBuilder = new QgsPointLocator_Builder( mLayer, mTransform, mExtent, maxFeaturesToIndex, mGranularity );
+  mFutureWatcher.setFuture( QtConcurrent::run( mBuilder, &QgsPointLocator_Builder::build ) );
+}
+
+bool QgsPointLocator::isIndexing() const
+{
+  return mBuilder != 0;
 }
 
+void QgsPointLocator::waitForIndexingFinished()
+{
+  if ( !mBuilder )
+    return;
 
+  mFutureWatcher.waitForFinished();
+  onInitTaskFinished();
+}
 
-bool QgsPointLocator::rebuildIndex( int maxFeaturesToIndex )
+void QgsPointLocator::onInitTaskFinished()
 {
-  destroyIndex();
+  // the task may have been finished already by waitForIndexingFinished()
+  if ( !mBuilder )
+    return;
 
-  QLinkedList<RTree::Data*> dataList;
-  QgsFeature f;
-  QGis::GeometryType geomType = mLayer->geometryType();
-  if ( geomType == QGis::NoGeometry )
-    return true; // nothing to index
+  QgsPointLocator_Builder* builder = mBuilder;
+  mBuilder = 0;
+  bool ok = adoptIndex( builder );
+  delete builder;
 
-  QgsFeatureRequest request;
-  request.setSubsetOfAttributes( QgsAttributeList() );
-  if ( mExtent )
+  // apply the edits done while the layer was being indexed
+  if ( ok )
   {
-    QgsRectangle rect = *mExtent;
-    if ( mTransform )
+    Q_FOREACH ( QgsFeatureId fid, mPendingChanges )
     {
-      try
-      {
-        rect = mTransform->transformBoundingBox( rect, QgsCoordinateTransform::ReverseTransform );
-      }
-      catch ( const QgsException& e )
-      {
-        // See http://hub.qgis.org/issues/12634
-        QgsDebugMsg( QString( "could not transform bounding box to map, skipping the snap filter (%1)" ).arg( e.what() ) );
-      }
+      onFeatureDeleted( fid );
+      onFeatureAdded( fid );
     }
-    request.setFilterRect( rect );
   }
-  QgsFeatureIterator fi = mLayer->getFeatures( request );
-  int indexedCount = 0;
-  while ( fi.nextFeature( f ) )
-  {
-    if ( !f.constGeometry() )
-      continue;
+  mPendingChanges.clear();
 
-    if ( mTransform )
-    {
-      try
-      {
-        f.geometry()->transform( *mTransform );
-      }
-      catch ( const QgsException& e )
-      {
-        // See http://hub.qgis.org/issues/12634
-        QgsDebugMsg( QString( "could not transform geometry to map, skipping the snap for it (%1)" ).arg( e.what() ) );
-        continue;
-      }
-    }
+  emit initFinished( ok );
+}
+
+bool QgsPointLocator::hasIndex() const
+{
+  return mRTree != 0 || mIsEmptyLayer;
+}
 
-    SpatialIndex::Region r( rect2region( f.constGeometry()->boundingBox() ) );
-    dataList << new RTree::Data( 0, 0, r, f.id() );
 
-    if ( mGeoms.contains( f.id() ) )
-      delete mGeoms.take( f.id() );
-    mGeoms[f.id()] = new QgsGeometry( *f.constGeometry() );
-    ++indexedCount;
 
-    if ( maxFeaturesToIndex != -1 && indexedCount > maxFeaturesToIndex )
-    {
-      qDeleteAll( dataList );
-      destroyIndex();
-      return false;
-    }
-  }
+bool QgsPointLocator::rebuildIndex( int maxFeaturesToIndex )
+{
+  destroyIndex();
 
-  // R-Tree parameters
-  double fillFactor = 0.7;
-  unsigned long indexCapacity = 10;
-  unsigned long leafCapacity = 10;
-  unsigned long dimension = 2;
-  RTree::RTreeVariant variant = RTree::RV_RSTAR;
-  SpatialIndex::id_type indexId;
+  QgsPointLocator_Builder builder( mLayer, mTransform, mExtent, maxFeaturesToIndex, mGranularity );
+  builder.build();
+  return adoptIndex( &builder );
+}
 
-  if ( dataList.isEmpty() )
+
+bool QgsPointLocator::adoptIndex( QgsPointLocator_Builder* builder )
+{
+  destroyIndex();
+
+  if ( !builder->mOk )
+    return false;
+
+  mStorage = builder->mStorage;
+  mRTree = builder->mRTree;
+  mSegments = builder->mSegments;
+  mGeoms = builder->mGeoms;
+  mIsEmptyLayer = builder->mIsEmptyLayer || !builder->mRTree;
+
+  builder->mStorage = 0;
+  builder->mRTree = 0;
+  builder->mSegments = 0;
+  builder->mGeoms.clear();
+  return true;
+}
+
+void QgsPointLocator::setIndexGranularity( IndexGranularity granularity )
+{
+  if ( granularity == mGranularity )
+    return;
+
+  // the index is rebuilt on the next query
+  waitForIndexingFinished();
+  destroyIndex();
+  mGranularity = granularity;
+}
+
+void QgsPointLocator::resolveEntry( SpatialIndex::id_type entry, QgsFeatureId& fid, int& first, int& last ) const
+{
+  if ( mSegments )
+  {
+    mSegments->resolve( entry, fid, first, last );
+  }
+  else
   {
-    mIsEmptyLayer = true;
-    return true; // no features
+    fid = entry;
+    first = 0;
+    last = -1;
   }
+}
 
-  QgsPointLocator_Stream stream( dataList );
-  mRTree = RTree::createAndBulkLoadNewRTree( RTree::BLM_STR, stream, *mStorage, fillFactor, indexCapacity,
-           leafCapacity, dimension, variant, indexId );
-  return true;
+SpatialIndex::ISpatialIndex* QgsPointLocator::segmentTree() const
+{
+  return mSegments ? mSegments->tree() : mRTree;
 }
 
 
 void QgsPointLocator::destroyIndex()
 {
+  delete mSegments;
+  mSegments = 0;
+
   delete mRTree;
   mRTree = 0;
 
+  delete mStorage;
+  mStorage = 0;
+
   mIsEmptyLayer = false;
 
   qDeleteAll( mGeoms );
@@ -719,15 +1177,27 @@ void QgsPointLocator::destroyIndex()
 
 void QgsPointLocator::onFeatureAdded( QgsFeatureId fid )
 {
+  if ( mBuilder )
+  {
+    mPendingChanges << fid;
+    return; // applied when the index is ready
+  }
+
   if ( !mRTree )
   {
-    if ( mIsEmptyLayer )
-      rebuildIndex(); // first feature - let's built the index
-    return; // nothing to do if we are not initialized yet
+    if ( !mIsEmptyLayer )
+      return; // nothing to do if we are not initialized yet
+
+    // first feature - create an empty index and add the feature to it
+    mStorage = StorageManager::createNewMemoryStorageManager();
+    mRTree = QgsPointLocator_Builder::createEmptyRTree( *mStorage );
+    if ( mGranularity == IndexSegments )
+      mSegments = new QgsPointLocator_SegmentIndex( *mStorage, mGeoms );
+    mIsEmptyLayer = false;
   }
 
   QgsFeature f;
-  if ( mLayer->getFeatures( QgsFeatureRequest( fid ) ).nextFeature( f ) )
+  if ( mLayer->getFeatures( QgsFeatureRequest( fid ).setSubsetOfAttributes( QgsAttributeList() ) ).nextFeature( f ) )
   {
     if ( !f.constGeometry() )
       return;
@@ -746,27 +1216,37 @@ void QgsPointLocator::onFeatureAdded( QgsFeatureId fid )
       }
     }
 
-    QgsRectangle bbox = f.constGeometry()->boundingBox();
-    if ( !bbox.isNull() )
+    QgsPointLocator_Geometry* geom = QgsPointLocator_Geometry::fromGeometry( f.constGeometry() );
+    if ( geom )
     {
-      SpatialIndex::Region r( rect2region( bbox ) );
-      mRTree->insertData( 0, 0, r, f.id() );
-
       if ( mGeoms.contains( f.id() ) )
-        delete mGeoms.take( f.id() );
-      mGeoms[fid] = new QgsGeometry( *f.constGeometry() );
+        onFeatureDeleted( f.id() );
+
+      mRTree->insertData( 0, 0, rect2region( geom->boundingBox() ), f.id() );
+      if ( mSegments )
+        mSegments->addFeature( f.id(), geom );
+
+      mGeoms[fid] = geom;
     }
   }
 }
 
 void QgsPointLocator::onFeatureDeleted( QgsFeatureId fid )
 {
+  if ( mBuilder )
+  {
+    mPendingChanges << fid;
+    return; // applied when the index is ready
+  }
+
   if ( !mRTree )
     return; // nothing to do if we are not initialized yet
 
   if ( mGeoms.contains( fid ) )
   {
     mRTree->deleteData( rect2region( mGeoms[fid]->boundingBox() ), fid );
+    if ( mSegments )
+      mSegments->removeFeature( fid, mGeoms[fid] );
     delete mGeoms.take( fid );
   }
 }
@@ -791,7 +1271,7 @@ QgsPointLocator::Match QgsPointLocator::nearestVertex( const QgsPoint& point, do
   Match m;
   QgsPointLocator_VisitorNearestVertex visitor( this, m, point, filter );
   QgsRectangle rect( point.x() - tolerance, point.y() - tolerance, point.x() + tolerance, point.y() + tolerance );
-  mRTree->intersectsWithQuery( rect2region( rect ), visitor );
+  segmentTree()->intersectsWithQuery( rect2region( rect ), visitor );
   if ( m.isValid() && m.distance() > tolerance )
     return Match(); // // make sure that only match strictly within the tolerance is returned
   return m;
@@ -809,7 +1289,7 @@ QgsPointLocator::Match QgsPointLocator::nearestEdge( const QgsPoint& point, doub
   Match m;
   QgsPointLocator_VisitorNearestEdge visitor( this, m, point, filter );
   QgsRectangle rect( point.x() - tolerance, point.y() - tolerance, point.x() + tolerance, point.y() + tolerance );
-  mRTree->intersectsWithQuery( rect2region( rect ), visitor );
+  segmentTree()->intersectsWithQuery( rect2region( rect ), visitor );
   if ( m.isValid() && m.distance() > tolerance )
     return Match(); // // make sure that only match strictly within the tolerance is returned
   return m;
@@ -826,7 +1306,7 @@ QgsPointLocator::MatchList QgsPointLocator::edgesInRect( const QgsRectangle& rec
 
   MatchList lst;
   QgsPointLocator_VisitorEdgesInRect visitor( this, lst, rect, filter );
-  mRTree->intersectsWithQuery( rect2region( rect ), visitor );
+  segmentTree()->intersectsWithQuery( rect2region( rect ), visitor );
 
   return lst;
 }
@@ -26,6 +26,7 @@ class QgsVectorLayer;
 
 #include <spatialindex/SpatialIndex.h>
 
+#include <QFutureWatcher>
 
 class QgsCoordinateTransform;
 class QgsCoordinateReferenceSystem;
@@ -34,6 +35,9 @@ class QgsPointLocator_VisitorNearestVertex;
 class QgsPointLocator_VisitorNearestEdge;
 class QgsPointLocator_VisitorArea;
 class QgsPointLocator_VisitorEdgesInRect;
+class QgsPointLocator_Geometry;
+class QgsPointLocator_Builder;
+class QgsPointLocator_SegmentIndex;
 
 /**
  * @brief The class defines interface for querying point location:
@@ -68,12 +72,49 @@ class CORE_EXPORT QgsPointLocator : public QObject
 
     Q_DECLARE_FLAGS( Types, Type )
 
+    /** Determines what the entries of the spatial index are
+     * @note added in 2.12
+     */
+    enum IndexGranularity
+    {
+      IndexFeatures,  //!< one entry per feature. Uses less memory, queries are slower with features with many vertices.
+      IndexSegments   //!< additional entries for runs of segments of the features. Queries for vertices and edges do not depend on the size of the features.
+    };
+
+    /** Set what the entries of the spatial index are. The existing index is dropped if the granularity changes.
+     * @note added in 2.12
+     */
+    void setIndexGranularity( IndexGranularity granularity );
+
+    /** Find out what the entries of the spatial index are - by default one entry per feature
+     * @note added in 2.12
+     */
+    IndexGranularity indexGranularity() const { return mGranularity; }
+
     /** Prepare the index for queries. Does nothing if the index already exists.
      * If the number of features is greater than the value of maxFeaturesToIndex, creation of index is stopped
      * to make sure we do not run out of memory. If maxFeaturesToIndex is -1, no limits are used. Returns
      * false if the creation of index has been prematurely stopped due to the limit of features, otherwise true */
     bool init( int maxFeaturesToIndex = -1 );
 
+    /** Start building the index in a worker thread and return immediately. Does nothing if the index
+     * already exists or is being built. The initFinished() signal is emitted once the index is ready.
+     * Changes of the layer done while the index is being built are applied when it is ready.
+     * Queries and init() block until the index is built.
+     * @note added in 2.12
+     */
+    void initInBackground( int maxFeaturesToIndex = -1 );
+
+    /** Indicate whether the index is being built in the background
+     * @note added in 2.12
+     */
+    bool isIndexing() const;
+
+    /** Block until the index being built in the background is ready. Does nothing if it is not being built.
+     * @note added in 2.12
+     */
+    void waitForIndexingFinished();
+
     /** Indicate whether the data have been already indexed */
     bool hasIndex() const;
 
@@ -163,6 +204,13 @@ class CORE_EXPORT QgsPointLocator : public QObject
     MatchList pointInPolygon( const QgsPoint& point );
 
 
+  signals:
+    /** Emitted when the index built by initInBackground() is ready.
+     * @param ok false if the creation of index has been stopped due to the limit of features
+     * @note added in 2.12
+     */
+    void initFinished( bool ok );
+
   protected:
     bool rebuildIndex( int maxFeaturesToIndex = -1 );
     void destroyIndex();
@@ -171,12 +219,20 @@ class CORE_EXPORT QgsPointLocator : public QObject
     void onFeatureAdded( QgsFeatureId fid );
     void onFeatureDeleted( QgsFeatureId fid );
     void onGeometryChanged( QgsFeatureId fid, QgsGeometry& geom );
+    void onInitTaskFinished();
 
   private:
+    //! take over the index built by the builder, returns false if the build failed
+    bool adoptIndex( QgsPointLocator_Builder* builder );
+    //! get the feature and the range of its vertices covered by an entry of the index used for vertex and edge queries
+    void resolveEntry( SpatialIndex::id_type entry, QgsFeatureId& fid, int& first, int& last ) const;
+    //! index used for vertex and edge queries
+    SpatialIndex::ISpatialIndex* segmentTree() const;
+
     /** Storage manager */
     SpatialIndex::IStorageManager* mStorage;
 
-    QHash<QgsFeatureId, QgsGeometry*> mGeoms;
+    QHash<QgsFeatureId, QgsPointLocator_Geometry*> mGeoms;
     SpatialIndex::ISpatialIndex* mRTree;
 
     //! flag whether the layer is currently empty (i.e. mRTree is null but it is not necessary to rebuild it)
@@ -187,6 +243,16 @@ class CORE_EXPORT QgsPointLocator : public QObject
     QgsVectorLayer* mLayer;
     QgsRectangle* mExtent;
 
+    IndexGranularity mGranularity;
+    //! index of runs of segments, only with IndexSegments granularity
+    QgsPointLocator_SegmentIndex* mSegments;
+
+    //! builder of the index while it is built in the background
+    QgsPointLocator_Builder* mBuilder;
+    QFutureWatcher<void> mFutureWatcher;
+    //! features changed while the index was being built
+    QSet<QgsFeatureId> mPendingChanges;
+
     friend class QgsPointLocator_VisitorNearestVertex;
     friend class QgsPointLocator_VisitorNearestEdge;
     friend class QgsPointLocator_VisitorArea;
@@ -31,6 +31,7 @@ QgsSnappingUtils::QgsSnappingUtils( QObject* parent )
     , mDefaultUnit( QgsTolerance::Pixels )
     , mSnapOnIntersection( false )
     , mIsIndexing( false )
+    , mIndexInBackground( true )
 {
   connect( QgsMapLayerRegistry::instance(), SIGNAL( layersWillBeRemoved( QStringList ) ), this, SLOT( onLayersWillBeRemoved( QStringList ) ) );
 }
@@ -49,6 +50,7 @@ QgsPointLocator* QgsSnappingUtils::locatorForLayer( QgsVectorLayer* vl )
   if ( !mLocators.contains( vl ) )
   {
     QgsPointLocator* vlpl = new QgsPointLocator( vl, destCRS() );
+    connect( vlpl, SIGNAL( initFinished( bool ) ), this, SLOT( onInitFinished( bool ) ) );
     mLocators.insert( vl, vlpl );
   }
   return mLocators.value( vl );
@@ -68,7 +70,8 @@ void QgsSnappingUtils::clearAllLocators()
 
 QgsPointLocator* QgsSnappingUtils::locatorForLayerUsingStrategy( QgsVectorLayer* vl, const QgsPoint& pointMap, double tolerance )
 {
-  if ( willUseIndex( vl ) )
+  // while the index is built in the background, query just the area around the point
+  if ( willUseIndex( vl ) && !locatorForLayer( vl )->isIndexing() )
     return locatorForLayer( vl );
   else
     return temporaryLocatorForLayer( vl, pointMap, tolerance );
@@ -320,7 +323,16 @@ void QgsSnappingUtils::prepareIndex( const QList<QgsVectorLayer*>& layers )
     if ( willUseIndex( vl ) && !locatorForLayer( vl )->hasIndex() )
       layersToIndex << vl;
   }
-  if ( !layersToIndex.isEmpty() )
+  if ( !layersToIndex.isEmpty() && mIndexInBackground )
+  {
+    // the indexes are used once they are ready, until then temporary locators are used
+    Q_FOREACH ( QgsVectorLayer* vl, layersToIndex )
+    {
+      if ( !locatorForLayer( vl )->isIndexing() )
+        locatorForLayer( vl )->initInBackground( mStrategy == IndexHybrid ? 1000000 : -1 );
+    }
+  }
+  else if ( !layersToIndex.isEmpty() )
   {
     // build indexes
     QTime t; t.start();
@@ -339,6 +351,14 @@ void QgsSnappingUtils::prepareIndex( const QList<QgsVectorLayer*>& layers )
   mIsIndexing = false;
 }
 
+void QgsSnappingUtils::onInitFinished( bool ok )
+{
+  QgsPointLocator* loc = qobject_cast<QgsPointLocator*>( sender() );
+  QgsVectorLayer* vl = mLocators.key( loc );
+  if ( !ok && vl )
+    mHybridNonindexableLayers.insert( vl->id() );
+}
+
 
 QgsPointLocator::Match QgsSnappingUtils::snapToCurrentLayer( const QPoint& point, int type, QgsPointLocator::MatchFilter* filter )
 {
@@ -127,6 +127,16 @@ class CORE_EXPORT QgsSnappingUtils : public QObject
     /** Query whether to consider intersections of nearby segments for snapping */
     bool snapOnIntersections() const { return mSnapOnIntersection; }
 
+    /** Set whether the indexes of layers are built in a worker thread. While a layer is being indexed,
+     * snapping to it queries just the area around the point. Enabled by default.
+     * @note added in 2.12
+     */
+    void setIndexInBackground( bool enabled ) { mIndexInBackground = enabled; }
+    /** Query whether the indexes of layers are built in a worker thread
+     * @note added in 2.12
+     */
+    bool indexInBackground() const { return mIndexInBackground; }
+
   public slots:
     /** Read snapping configuration from the project */
     void readConfigFromProject();
@@ -139,6 +149,7 @@ class CORE_EXPORT QgsSnappingUtils : public QObject
 
   private slots:
     void onLayersWillBeRemoved( const QStringList& layerIds );
+    void onInitFinished( bool ok );
 
   private:
     //! get from map settings pointer to destination CRS - or 0 if projections are disabled
@@ -182,6 +193,8 @@ class CORE_EXPORT QgsSnappingUtils : public QObject
 
     //! internal flag that an indexing process is going on. Prevents starting two processes in parallel.
     bool mIsIndexing;
+    //! whether indexes are built in a worker thread
+    bool mIndexInBackground;
 };
 
 
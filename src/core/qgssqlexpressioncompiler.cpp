@@ -0,0 +1,305 @@
+/***************************************************************************
+    qgssqlexpressioncompiler.cpp
+    ---------------------
+    begin                : October 2015
+    copyright            : (C) 2015 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgssqlexpressioncompiler.h"
+
+#include <QSettings>
+
+QgsSqlExpressionCompiler::QgsSqlExpressionCompiler( const QgsFields& fields, const Flags& flags )
+    : mFields( fields )
+    , mFlags( flags )
+{
+}
+
+QgsSqlExpressionCompiler::~QgsSqlExpressionCompiler()
+{
+
+}
+
+QgsSqlExpressionCompiler::Result QgsSqlExpressionCompiler::compile( const QgsExpression* exp )
+{
+  if ( exp->rootNode() )
+    return compileNode( exp->rootNode(), mResult );
+  else
+    return Fail;
+}
+
+QString QgsSqlExpressionCompiler::result()
+{
+  return mResult;
+}
+
+bool QgsSqlExpressionCompiler::compilationEnabled()
+{
+  QSettings settings;
+  return settings.value( "/qgis/compileExpressions", settings.value( "/qgis/postgres/compileExpressions", false ) ).toBool();
+}
+
+QString QgsSqlExpressionCompiler::quotedIdentifier( const QString& identifier )
+{
+  QString quoted = identifier;
+  quoted.replace( '"', "\"\"" );
+  quoted = quoted.prepend( '\"' ).append( '\"' );
+  return quoted;
+}
+
+QString QgsSqlExpressionCompiler::quotedValue( const QVariant& value, bool& ok )
+{
+  ok = true;
+
+  if ( value.isNull() )
+    return "NULL";
+
+  switch ( value.type() )
+  {
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+      return value.toString();
+
+    case QVariant::Double:
+      return QString::number( value.toDouble(), 'g', 17 );
+
+    case QVariant::Bool:
+      return value.toBool() ? "1" : "0";
+
+    case QVariant::String:
+    {
+      QString v = value.toString();
+      v.replace( '\'', "''" );
+      return v.prepend( '\'' ).append( '\'' );
+    }
+
+    default:
+      ok = false;
+      return QString();
+  }
+}
+
+QgsSqlExpressionCompiler::Result QgsSqlExpressionCompiler::compileNode( const QgsExpression::Node* node, QString& result )
+{
+  switch ( node->nodeType() )
+  {
+    case QgsExpression::ntUnaryOperator:
+    {
+      const QgsExpression::NodeUnaryOperator* n = static_cast<const QgsExpression::NodeUnaryOperator*>( node );
+
+      // the negation of a partial filter would miss matching features
+      QString operand;
+      if ( compileNode( n->operand(), operand ) != Complete )
+        return Fail;
+
+      switch ( n->op() )
+      {
+        case QgsExpression::uoNot:
+          result = "NOT " + operand;
+          return Complete;
+
+        case QgsExpression::uoMinus:
+          result = "-(" + operand + ")";
+          return Complete;
+      }
+
+      break;
+    }
+
+    case QgsExpression::ntBinaryOperator:
+    {
+      const QgsExpression::NodeBinaryOperator* n = static_cast<const QgsExpression::NodeBinaryOperator*>( node );
+
+      QString left;
+      Result lr( compileNode( n->opLeft(), left ) );
+
+      QString right;
+      Result rr( compileNode( n->opRight(), right ) );
+
+      switch ( n->op() )
+      {
+        case QgsExpression::boAnd:
+          // an operand which cannot be compiled is left to the local evaluation
+          if ( lr == Fail && rr == Fail )
+            return Fail;
+          if ( lr == Fail )
+          {
+            result = right;
+            return Partial;
+          }
+          if ( rr == Fail )
+          {
+            result = left;
+            return Partial;
+          }
+          result = "(" + left + " AND " + right + ")";
+          return ( lr == Complete && rr == Complete ) ? Complete : Partial;
+
+        case QgsExpression::boOr:
+          if ( lr == Fail || rr == Fail )
+            return Fail;
+          result = "(" + left + " OR " + right + ")";
+          return ( lr == Complete && rr == Complete ) ? Complete : Partial;
+
+        default:
+          break;
+      }
+
+      if ( lr != Complete || rr != Complete )
+        return Fail;
+
+      Result res = Complete;
+      QString op;
+      switch ( n->op() )
+      {
+        case QgsExpression::boEQ:
+          op = "=";
+          break;
+
+        case QgsExpression::boGE:
+          op = ">=";
+          break;
+
+        case QgsExpression::boGT:
+          op = ">";
+          break;
+
+        case QgsExpression::boLE:
+          op = "<=";
+          break;
+
+        case QgsExpression::boLT:
+          op = "<";
+          break;
+
+        case QgsExpression::boIs:
+          op = "IS";
+          break;
+
+        case QgsExpression::boIsNot:
+          op = "IS NOT";
+          break;
+
+        case QgsExpression::boLike:
+          op = "LIKE";
+          // a case insensitive LIKE also matches features which differ in case
+          if ( mFlags.testFlag( LikeIsCaseInsensitive ) )
+            res = Partial;
+          break;
+
+        case QgsExpression::boILike:
+          op = mFlags.testFlag( LikeIsCaseInsensitive ) ? "LIKE" : "ILIKE";
+          break;
+
+        case QgsExpression::boNotLike:
+          if ( mFlags.testFlag( LikeIsCaseInsensitive ) )
+            return Fail;
+          op = "NOT LIKE";
+          break;
+
+        case QgsExpression::boNotILike:
+          op = mFlags.testFlag( LikeIsCaseInsensitive ) ? "NOT LIKE" : "NOT ILIKE";
+          break;
+
+        case QgsExpression::boNE:
+          op = "<>";
+          break;
+
+        case QgsExpression::boMul:
+          op = "*";
+          break;
+
+        case QgsExpression::boPlus:
+          op = "+";
+          break;
+
+        case QgsExpression::boMinus:
+          op = "-";
+          break;
+
+        case QgsExpression::boConcat:
+          op = "||";
+          break;
+
+        case QgsExpression::boDiv:
+          return Fail;  // handle cast to real
+
+        case QgsExpression::boIntDiv:
+          return Fail;  // handle cast to int
+
+        case QgsExpression::boMod:
+        case QgsExpression::boPow:
+        case QgsExpression::boRegexp:
+          return Fail;  // backend specific
+
+        case QgsExpression::boAnd:
+        case QgsExpression::boOr:
+          break;
+      }
+
+      if ( op.isNull() )
+        return Fail;
+
+      result = "(" + left + " " + op + " " + right + ")";
+      return res;
+    }
+
+    case QgsExpression::ntLiteral:
+    {
+      const QgsExpression::NodeLiteral* n = static_cast<const QgsExpression::NodeLiteral*>( node );
+      bool ok;
+      result = quotedValue( n->value(), ok );
+      return ok ? Complete : Fail;
+    }
+
+    case QgsExpression::ntColumnRef:
+    {
+      const QgsExpression::NodeColumnRef* n = static_cast<const QgsExpression::NodeColumnRef*>( node );
+
+      if ( mFields.indexFromName( n->name() ) == -1 )
+        // Not a provider field
+        return Fail;
+
+      result = quotedIdentifier( n->name() );
+
+      return Complete;
+    }
+
+    case QgsExpression::ntInOperator:
+    {
+      const QgsExpression::NodeInOperator* n = static_cast<const QgsExpression::NodeInOperator*>( node );
+      QStringList list;
+
+      Q_FOREACH ( const QgsExpression::Node* ln, n->list()->list() )
+      {
+        QString s;
+        if ( compileNode( ln, s ) != Complete )
+          return Fail;
+
+        list << s;
+      }
+
+      QString nd;
+      if ( compileNode( n->node(), nd ) != Complete )
+        return Fail;
+
+      result = QString( "%1 %2IN(%3)" ).arg( nd, n->isNotIn() ? "NOT " : "", list.join( "," ) );
+      return Complete;
+    }
+
+    case QgsExpression::ntFunction:
+    case QgsExpression::ntCondition:
+      break;
+  }
+
+  return Fail;
+}
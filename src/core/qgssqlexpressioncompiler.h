@@ -0,0 +1,109 @@
+/***************************************************************************
+    qgssqlexpressioncompiler.h
+    ---------------------
+    begin                : October 2015
+    copyright            : (C) 2015 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSSQLEXPRESSIONCOMPILER_H
+#define QGSSQLEXPRESSIONCOMPILER_H
+
+#include "qgsexpression.h"
+#include "qgsfield.h"
+
+/** \ingroup core
+ * \class QgsSqlExpressionCompiler
+ * \brief Generic translator of filter expressions to SQL WHERE clauses.
+ *
+ * Providers subclass it to quote identifiers and values in the dialect of their
+ * backend and to add the operators and functions the backend supports.
+ *
+ * If only some AND operands of an expression can be translated the compiler returns
+ * a Partial result, a filter which selects all the features matching the expression
+ * and possibly others. The provider can use it to reduce the number of features it
+ * reads, but the expression still has to be evaluated on each feature.
+ *
+ * \note added in 2.12
+ */
+class CORE_EXPORT QgsSqlExpressionCompiler
+{
+  public:
+
+    /** Possible results from expression compilation */
+    enum Result
+    {
+      None, /*!< No expression */
+      Complete, /*!< Expression was fully compiled */
+      Partial, /*!< Expression was partially compiled, the result selects a superset of the matching features */
+      Fail /*!< Provider cannot handle expression */
+    };
+
+    /** Enumeration of flags for how the backend handles expressions */
+    enum Flag
+    {
+      LikeIsCaseInsensitive = 0x1 /*!< LIKE ignores case, there is no ILIKE */
+    };
+    Q_DECLARE_FLAGS( Flags, Flag )
+
+    /** Constructor for expression compiler.
+     * @param fields fields of the provider, expressions referring to other fields fail
+     * @param flags flags which control how the expression is compiled
+     */
+    explicit QgsSqlExpressionCompiler( const QgsFields& fields, const Flags& flags = Flags() );
+    virtual ~QgsSqlExpressionCompiler();
+
+    /** Compiles an expression and returns the result of the compilation.
+     */
+    virtual Result compile( const QgsExpression* exp );
+
+    /** Returns the compiled expression string for use by the provider.
+     */
+    virtual QString result();
+
+    /** Returns true if providers should compile expressions, as set in the options.
+     * Falls back to the former "/qgis/postgres/compileExpressions" setting, which only
+     * applied to the PostgreSQL provider.
+     */
+    static bool compilationEnabled();
+
+  protected:
+
+    /** Returns a quoted column identifier, in the format expected by the provider.
+     * The default implementation quotes with double quotes.
+     */
+    virtual QString quotedIdentifier( const QString& identifier );
+
+    /** Returns a quoted attribute value, in the format expected by the provider.
+     * The default implementation handles NULL, numbers and strings.
+     * @param value value to quote
+     * @param ok set to false if the value cannot be represented
+     */
+    virtual QString quotedValue( const QVariant& value, bool& ok );
+
+    /** Compiles an expression node and returns the result of the compilation.
+     * Subclasses override it to handle additional nodes and fall back to this
+     * implementation for the rest.
+     * @param node node to compile
+     * @param str receives the compiled SQL
+     */
+    virtual Result compileNode( const QgsExpression::Node* node, QString& str );
+
+    QString mResult;
+    QgsFields mFields;
+
+  private:
+
+    Flags mFlags;
+
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS( QgsSqlExpressionCompiler::Flags )
+
+#endif // QGSSQLEXPRESSIONCOMPILER_H
@@ -19,9 +19,43 @@
 #include <QString>
 #include <QObject>
 
+#include <cstring>
+
+namespace
+{
+  // smallest magnitude which gets a logarithmic bucket, smaller values count as zero
+  const double MinBucketValue = 1e-300;
+
+  //! SplitMix64 finalizer, spreads the bits of a double over the hash
+  quint64 hashValue( double value )
+  {
+    if ( value == 0.0 )
+      value = 0.0; // -0.0 and 0.0 are the same value
+
+    quint64 h;
+    memcpy( &h, &value, sizeof( h ) );
+    h ^= h >> 30;
+    h *= Q_UINT64_C( 0xbf58476d1ce4e5b9 );
+    h ^= h >> 27;
+    h *= Q_UINT64_C( 0x94d049bb133111eb );
+    h ^= h >> 31;
+    return h;
+  }
+
+  //! Median of count values of a sorted list, starting at index first
+  double medianOf( const QList<double>& sorted, int first, int count )
+  {
+    if ( count % 2 == 0 )
+      return ( sorted[first + count / 2 - 1] + sorted[first + count / 2] ) / 2.0;
+    return sorted[first + ( count + 1 ) / 2 - 1];
+  }
+}
+
 QgsStatisticalSummary::QgsStatisticalSummary( const Statistics& stats )
     : mStatistics( stats )
+    , mExact( true )
 {
+  setRelativeError( 0.01 );
   reset();
 }
 
@@ -30,11 +64,18 @@ QgsStatisticalSummary::~QgsStatisticalSummary()
 
 }
 
+void QgsStatisticalSummary::setRelativeError( double error )
+{
+  mRelativeError = qBound( 0.0001, error, 0.5 );
+  mLogGamma = log( gamma() );
+}
+
 void QgsStatisticalSummary::reset()
 {
   mCount = 0;
   mSum = 0;
   mMean = 0;
+  mM2 = 0;
   mMedian = 0;
   mMin = std::numeric_limits<double>::max();
   mMax = -std::numeric_limits<double>::max();
@@ -44,122 +85,260 @@ void QgsStatisticalSummary::reset()
   mMajority = 0;
   mFirstQuartile = 0;
   mThirdQuartile = 0;
+  mVariety = 0;
   mValueCount.clear();
+  mValues.clear();
+  mPositiveBuckets.clear();
+  mNegativeBuckets.clear();
+  mZeroCount = 0;
+  mRegisters.clear();
+  mRegisterBits = 0;
 }
 
 void QgsStatisticalSummary::calculate( const QList<double> &values )
 {
   reset();
+  addValues( values );
+  finalize();
+}
 
-  Q_FOREACH ( double value, values )
-  {
-    mCount++;
-    mSum += value;
-    mMin = qMin( mMin, value );
-    mMax = qMax( mMax, value );
+bool QgsStatisticalSummary::needsQuantiles() const
+{
+  return mStatistics & QgsStatisticalSummary::Median
+         || mStatistics & QgsStatisticalSummary::FirstQuartile
+         || mStatistics & QgsStatisticalSummary::ThirdQuartile
+         || mStatistics & QgsStatisticalSummary::InterQuartileRange;
+}
 
-    if ( mStatistics & QgsStatisticalSummary::Majority || mStatistics & QgsStatisticalSummary::Minority || mStatistics & QgsStatisticalSummary::Variety )
-      mValueCount.insert( value, mValueCount.value( value, 0 ) + 1 );
-  }
+bool QgsStatisticalSummary::needsValueCounts() const
+{
+  return mStatistics & QgsStatisticalSummary::Majority
+         || mStatistics & QgsStatisticalSummary::Minority
+         || ( mExact && mStatistics & QgsStatisticalSummary::Variety );
+}
 
-  if ( mCount == 0 )
-    return;
+double QgsStatisticalSummary::gamma() const
+{
+  return ( 1.0 + mRelativeError ) / ( 1.0 - mRelativeError );
+}
 
-  mMean = mSum / mCount;
+void QgsStatisticalSummary::addValue( double value )
+{
+  // Welford's update keeps the variance accurate without a second pass
+  mCount++;
+  mSum += value;
+  double delta = value - mMean;
+  mMean += delta / mCount;
+  mM2 += delta * ( value - mMean );
+  mMin = qMin( mMin, value );
+  mMax = qMax( mMax, value );
 
-  if ( mStatistics & QgsStatisticalSummary::StDev || mStatistics & QgsStatisticalSummary::StDevSample )
+  if ( needsValueCounts() )
+    mValueCount.insert( value, mValueCount.value( value, 0 ) + 1 );
+
+  if ( needsQuantiles() )
   {
-    double sumSquared = 0;
-    Q_FOREACH ( double value, values )
+    if ( mExact )
     {
-      double diff = value - mMean;
-      sumSquared += diff * diff;
+      mValues << value;
+    }
+    else if ( qAbs( value ) < MinBucketValue )
+    {
+      mZeroCount++;
+    }
+    else
+    {
+      // the bucket k holds the values between gamma^(k-1) and gamma^k
+      int bucket = qCeil( log( qAbs( value ) ) / mLogGamma );
+      QMap< int, qint64 >& buckets = value > 0 ? mPositiveBuckets : mNegativeBuckets;
+      buckets[bucket]++;
     }
-    mStdev = qPow( sumSquared / values.count(), 0.5 );
-    mSampleStdev = qPow( sumSquared / ( values.count() - 1 ), 0.5 );
   }
 
-  QList<double> sorted;
-  if ( mStatistics & QgsStatisticalSummary::Median
-       || mStatistics & QgsStatisticalSummary::FirstQuartile
-       || mStatistics & QgsStatisticalSummary::ThirdQuartile
-       || mStatistics & QgsStatisticalSummary::InterQuartileRange )
+  if ( !mExact && mStatistics & QgsStatisticalSummary::Variety )
   {
-    sorted = values;
-    qSort( sorted.begin(), sorted.end() );
-    bool even = ( mCount % 2 ) < 1;
-    if ( even )
+    if ( mRegisters.isEmpty() )
     {
-      mMedian = ( sorted[mCount / 2 - 1] + sorted[mCount / 2] ) / 2.0;
+      // the standard error of HyperLogLog is 1.04 / sqrt( registers )
+      mRegisterBits = qBound( 4, qCeil( log( pow( 1.04 / mRelativeError, 2 ) ) / log( 2.0 ) ), 16 );
+      mRegisters.fill( 0, 1 << mRegisterBits );
     }
-    else //odd
+
+    int bits = mRegisterBits;
+    quint64 hash = hashValue( value );
+    int index = ( int )( hash >> ( 64 - bits ) );
+    quint64 rest = hash << bits;
+    char rank = 1;
+    while ( rank <= 64 - bits && !( rest & Q_UINT64_C( 0x8000000000000000 ) ) )
     {
-      mMedian = sorted[( mCount + 1 ) / 2 - 1];
+      rank++;
+      rest <<= 1;
     }
+    if ( rank > mRegisters.at( index ) )
+      mRegisters[index] = rank;
   }
+}
 
-  if ( mStatistics & QgsStatisticalSummary::FirstQuartile
-       || mStatistics & QgsStatisticalSummary::InterQuartileRange )
+void QgsStatisticalSummary::addValues( const QList<double>& values )
+{
+  Q_FOREACH ( double value, values )
+    addValue( value );
+}
+
+void QgsStatisticalSummary::merge( const QgsStatisticalSummary& other )
+{
+  if ( other.mCount == 0 )
+    return;
+
+  if ( mCount == 0 )
   {
-    if (( mCount % 2 ) < 1 )
-    {
-      int halfCount = mCount / 2;
-      bool even = ( halfCount % 2 ) < 1;
-      if ( even )
-      {
-        mFirstQuartile = ( sorted[halfCount / 2 - 1] + sorted[halfCount / 2] ) / 2.0;
-      }
-      else //odd
-      {
-        mFirstQuartile = sorted[( halfCount  + 1 ) / 2 - 1];
-      }
-    }
-    else
+    *this = other;
+    return;
+  }
+
+  // Chan's formula combines the moments of both parts
+  int count = mCount + other.mCount;
+  double delta = other.mMean - mMean;
+  mM2 += other.mM2 + delta * delta * mCount * other.mCount / count;
+  mMean += delta * other.mCount / count;
+  mCount = count;
+  mSum += other.mSum;
+  mMin = qMin( mMin, other.mMin );
+  mMax = qMax( mMax, other.mMax );
+
+  for ( QMap< double, int >::const_iterator it = other.mValueCount.constBegin(); it != other.mValueCount.constEnd(); ++it )
+    mValueCount[it.key()] += it.value();
+
+  mValues << other.mValues;
+
+  for ( QMap< int, qint64 >::const_iterator it = other.mPositiveBuckets.constBegin(); it != other.mPositiveBuckets.constEnd(); ++it )
+    mPositiveBuckets[it.key()] += it.value();
+  for ( QMap< int, qint64 >::const_iterator it = other.mNegativeBuckets.constBegin(); it != other.mNegativeBuckets.constEnd(); ++it )
+    mNegativeBuckets[it.key()] += it.value();
+  mZeroCount += other.mZeroCount;
+
+  if ( mRegisters.isEmpty() )
+  {
+    mRegisters = other.mRegisters;
+    mRegisterBits = other.mRegisterBits;
+  }
+  else if ( mRegisters.size() == other.mRegisters.size() )
+  {
+    for ( int i = 0; i < mRegisters.size(); ++i )
     {
-      int halfCount = mCount / 2 + 1;
-      bool even = ( halfCount % 2 ) < 1;
-      if ( even )
-      {
-        mFirstQuartile = ( sorted[halfCount / 2 - 1] + sorted[halfCount / 2] ) / 2.0;
-      }
-      else //odd
-      {
-        mFirstQuartile = sorted[( halfCount  + 1 ) / 2 - 1];
-      }
+      if ( other.mRegisters.at( i ) > mRegisters.at( i ) )
+        mRegisters[i] = other.mRegisters.at( i );
     }
   }
+}
+
+double QgsStatisticalSummary::estimatedQuantile( double fraction ) const
+{
+  // the rank of the value in the sorted values, from the most negative to the largest bucket
+  double rank = fraction * ( mCount - 1 );
+  double g = gamma();
+  qint64 seen = 0;
+
+  QMapIterator< int, qint64 > negative( mNegativeBuckets );
+  negative.toBack();
+  while ( negative.hasPrevious() )
+  {
+    negative.previous();
+    seen += negative.value();
+    if ( seen > rank )
+      return qBound( mMin, -2.0 * pow( g, negative.key() ) / ( g + 1.0 ), mMax );
+  }
+
+  seen += mZeroCount;
+  if ( seen > rank )
+    return qBound( mMin, 0.0, mMax );
+
+  for ( QMap< int, qint64 >::const_iterator it = mPositiveBuckets.constBegin(); it != mPositiveBuckets.constEnd(); ++it )
+  {
+    seen += it.value();
+    if ( seen > rank )
+      return qBound( mMin, 2.0 * pow( g, it.key() ) / ( g + 1.0 ), mMax );
+  }
+
+  return mMax;
+}
+
+double QgsStatisticalSummary::estimatedVariety() const
+{
+  if ( mRegisters.isEmpty() )
+    return 0;
+
+  double m = mRegisters.size();
+  double sum = 0;
+  int zeros = 0;
+  for ( int i = 0; i < mRegisters.size(); ++i )
+  {
+    sum += pow( 2.0, -mRegisters.at( i ) );
+    if ( mRegisters.at( i ) == 0 )
+      zeros++;
+  }
+
+  double alpha = m <= 16 ? 0.673 : m <= 32 ? 0.697 : m <= 64 ? 0.709 : 0.7213 / ( 1.0 + 1.079 / m );
+  double estimate = alpha * m * m / sum;
+
+  // linear counting is more accurate for small cardinalities
+  if ( estimate <= 2.5 * m && zeros > 0 )
+    estimate = m * log( m / zeros );
+
+  return estimate;
+}
+
+void QgsStatisticalSummary::calculateHinges()
+{
+  const QList<double>& sorted = mValues;
+
+  // the quartiles are the medians of the lower and upper half, the median belongs to both for odd counts
+  int halfCount = mCount % 2 == 0 ? mCount / 2 : mCount / 2 + 1;
+  if ( mStatistics & QgsStatisticalSummary::FirstQuartile
+       || mStatistics & QgsStatisticalSummary::InterQuartileRange )
+  {
+    mFirstQuartile = medianOf( sorted, 0, halfCount );
+  }
 
   if ( mStatistics & QgsStatisticalSummary::ThirdQuartile
        || mStatistics & QgsStatisticalSummary::InterQuartileRange )
   {
-    if (( mCount % 2 ) < 1 )
+    mThirdQuartile = medianOf( sorted, mCount - halfCount, halfCount );
+  }
+}
+
+void QgsStatisticalSummary::finalize()
+{
+  if ( mCount == 0 )
+    return;
+
+  if ( mStatistics & QgsStatisticalSummary::StDev || mStatistics & QgsStatisticalSummary::StDevSample )
+  {
+    mStdev = qPow( mM2 / mCount, 0.5 );
+    mSampleStdev = qPow( mM2 / ( mCount - 1 ), 0.5 );
+  }
+
+  if ( needsQuantiles() )
+  {
+    if ( mExact )
     {
-      int halfCount = mCount / 2;
-      bool even = ( halfCount % 2 ) < 1;
-      if ( even )
-      {
-        mThirdQuartile = ( sorted[ halfCount + halfCount / 2 - 1] + sorted[ halfCount + halfCount / 2] ) / 2.0;
-      }
-      else //odd
-      {
-        mThirdQuartile = sorted[( halfCount + 1 ) / 2 - 1 + halfCount ];
-      }
+      qSort( mValues.begin(), mValues.end() );
+      mMedian = medianOf( mValues, 0, mCount );
+      calculateHinges();
     }
     else
     {
-      int halfCount = mCount / 2 + 1;
-      bool even = ( halfCount % 2 ) < 1;
-      if ( even )
-      {
-        mThirdQuartile = ( sorted[ halfCount + halfCount / 2 - 2 ] + sorted[ halfCount + halfCount / 2 - 1 ] ) / 2.0;
-      }
-      else //odd
-      {
-        mThirdQuartile = sorted[( halfCount + 1 ) / 2 - 2 + halfCount ];
-      }
+      mMedian = estimatedQuantile( 0.5 );
+      mFirstQuartile = estimatedQuantile( 0.25 );
+      mThirdQuartile = estimatedQuantile( 0.75 );
     }
   }
 
+  if ( mStatistics & QgsStatisticalSummary::Variety )
+  {
+    mVariety = mExact ? mValueCount.count() : qRound( estimatedVariety() );
+  }
+
   if ( mStatistics & QgsStatisticalSummary::Minority || mStatistics & QgsStatisticalSummary::Majority )
   {
     QList<int> valueCounts = mValueCount.values();
@@ -173,7 +352,6 @@ void QgsStatisticalSummary::calculate( const QList<double> &values )
       mMajority = mValueCount.key( valueCounts.last() );
     }
   }
-
 }
 
 double QgsStatisticalSummary::statistic( QgsStatisticalSummary::Statistic stat ) const
@@ -203,7 +381,7 @@ double QgsStatisticalSummary::statistic( QgsStatisticalSummary::Statistic stat )
     case Majority:
       return mMajority;
     case Variety:
-      return mValueCount.count();
+      return mVariety;
     case FirstQuartile:
       return mFirstQuartile;
     case ThirdQuartile:
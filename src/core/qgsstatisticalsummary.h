@@ -16,6 +16,8 @@
 #ifndef QGSSTATISTICALSUMMARY_H
 #define QGSSTATISTICALSUMMARY_H
 
+#include <QByteArray>
+#include <QList>
 #include <QMap>
 
 /** \ingroup core
@@ -27,6 +29,15 @@
  * are calculated by default. Statistics which require slower computations are only calculated by
  * specifying the statistic in the constructor or via @link setStatistics @endlink.
  *
+ * Instead of passing a complete list, values can also be streamed in with @link addValue @endlink
+ * and the statistics derived with @link finalize @endlink. Summaries of separate parts of the values,
+ * e.g. calculated in parallel over feature chunks or raster tiles, can be combined with @link merge @endlink.
+ * The count, sum, mean, extremes and standard deviations are accumulated in constant memory. Exact
+ * medians and quartiles keep all values and an exact variety keeps the distinct values. If exact results
+ * are not needed, @link setExact @endlink switches to sketches of bounded size: quantiles are estimated
+ * within a relative error and the variety is estimated with HyperLogLog. Minority and majority always
+ * keep the counts of the distinct values.
+ *
  * \note Added in version 2.9
  */
 
@@ -76,6 +87,36 @@ class CORE_EXPORT QgsStatisticalSummary
      */
     void setStatistics( const Statistics& stats ) { mStatistics = stats; }
 
+    /** Returns true if the median, quartiles and variety are calculated exactly.
+     * @see setExact
+     * @note added in QGIS 2.12
+     */
+    bool exact() const { return mExact; }
+
+    /** Sets whether the median, quartiles and variety are calculated exactly, which needs memory
+     * proportional to the number of (distinct) values, or estimated in bounded memory.
+     * Has to be set before values are added.
+     * @param exact false to estimate the median, quartiles and variety
+     * @see exact
+     * @see setRelativeError
+     * @note added in QGIS 2.12
+     */
+    void setExact( bool exact ) { mExact = exact; }
+
+    /** Returns the relative error of estimated quantiles and varieties.
+     * @see setRelativeError
+     * @note added in QGIS 2.12
+     */
+    double relativeError() const { return mRelativeError; }
+
+    /** Sets the relative error of estimated quantiles and varieties, the default is 0.01. Smaller
+     * errors need larger sketches. Only used if the statistics are not exact. Has to be set before
+     * values are added.
+     * @see setExact
+     * @note added in QGIS 2.12
+     */
+    void setRelativeError( double error );
+
     /** Resets the calculated values
      */
     void reset();
@@ -85,6 +126,29 @@ class CORE_EXPORT QgsStatisticalSummary
      */
     void calculate( const QList<double>& values );
 
+    /** Adds a value to the summary. The statistics are updated by @link finalize @endlink.
+     * @see addValues
+     * @note added in QGIS 2.12
+     */
+    void addValue( double value );
+
+    /** Adds a list of values to the summary. The statistics are updated by @link finalize @endlink.
+     * @see addValue
+     * @note added in QGIS 2.12
+     */
+    void addValues( const QList<double>& values );
+
+    /** Adds the values accumulated by another summary, which has to calculate the same statistics
+     * in the same mode. The statistics are updated by @link finalize @endlink.
+     * @note added in QGIS 2.12
+     */
+    void merge( const QgsStatisticalSummary& other );
+
+    /** Derives the statistics from the values added so far. More values can be added afterwards.
+     * @note added in QGIS 2.12
+     */
+    void finalize();
+
     /** Returns the value of a specified statistic
      * @param stat statistic to return
      * @returns calculated value of statistic
@@ -136,7 +200,7 @@ class CORE_EXPORT QgsStatisticalSummary
      * This is only calculated if Statistic::Variety has been specified in the constructor
      * or via setStatistics.
      */
-    int variety() const { return mValueCount.count(); }
+    int variety() const { return mVariety; }
 
     /** Returns minority of values. The minority is the value with least occurances in the list
      * This is only calculated if Statistic::Minority has been specified in the constructor
@@ -181,10 +245,14 @@ class CORE_EXPORT QgsStatisticalSummary
   private:
 
     Statistics mStatistics;
+    bool mExact;
+    double mRelativeError;
+    double mLogGamma;
 
     int mCount;
     double mSum;
     double mMean;
+    double mM2;
     double mMedian;
     double mMin;
     double mMax;
@@ -194,7 +262,27 @@ class CORE_EXPORT QgsStatisticalSummary
     double mMajority;
     double mFirstQuartile;
     double mThirdQuartile;
+    int mVariety;
     QMap< double, int > mValueCount;
+
+    //! All values, for exact quantiles
+    QList< double > mValues;
+
+    //! Counts of values in logarithmic buckets by bucket, for estimated quantiles
+    QMap< int, qint64 > mPositiveBuckets;
+    QMap< int, qint64 > mNegativeBuckets;
+    qint64 mZeroCount;
+
+    //! HyperLogLog registers, for the estimated variety
+    QByteArray mRegisters;
+    int mRegisterBits;
+
+    bool needsQuantiles() const;
+    bool needsValueCounts() const;
+    double gamma() const;
+    double estimatedQuantile( double fraction ) const;
+    double estimatedVariety() const;
+    void calculateHinges();
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS( QgsStatisticalSummary::Statistics )
@@ -371,6 +371,42 @@ void QgsVectorDataProvider::uniqueValues( int index, QList<QVariant> &values, in
   }
 }
 
+bool QgsVectorDataProvider::aggregate( const QList<QgsAggregateCalculator::Aggregate>& aggregates, const QString& expression, const QString& groupByExpression,
+                                       const QgsAggregateCalculator::AggregateParameters& parameters, QgsAggregateCalculator::GroupResults& results )
+{
+  // minimum and maximum of a numeric field are answered by minimumValue() and maximumValue(),
+  // which providers implement in their backend or cache
+  int index = fields().fieldNameIndex( expression );
+  if ( index < 0 || !groupByExpression.isEmpty() || !parameters.filter.isEmpty() )
+    return false;
+
+  QVariant::Type type = fields().at( index ).type();
+  if ( type != QVariant::Int && type != QVariant::LongLong && type != QVariant::Double )
+    return false;
+
+  Q_FOREACH ( QgsAggregateCalculator::Aggregate aggregate, aggregates )
+  {
+    if ( aggregate != QgsAggregateCalculator::Min && aggregate != QgsAggregateCalculator::Max )
+      return false;
+  }
+
+  QVariant minimum = minimumValue( index );
+  QVariant maximum = maximumValue( index );
+  if ( minimum.isNull() || maximum.isNull() || minimum.toDouble() > maximum.toDouble() )
+  {
+    // no values, the cache keeps its initial extremes
+    minimum = maximum = QVariant( type );
+  }
+
+  QgsAggregateCalculator::GroupResult result;
+  Q_FOREACH ( QgsAggregateCalculator::Aggregate aggregate, aggregates )
+  {
+    result.values << ( aggregate == QgsAggregateCalculator::Min ? minimum : maximum );
+  }
+  results << result;
+  return true;
+}
+
 void QgsVectorDataProvider::clearMinMaxCache()
 {
   mCacheMinMaxDirty = true;
@@ -24,6 +24,7 @@ class QTextCodec;
 
 //QGIS Includes
 #include "qgis.h"
+#include "qgsaggregatecalculator.h"
 #include "qgsdataprovider.h"
 #include "qgsfeature.h"
 #include "qgsfield.h"
@@ -205,6 +206,24 @@ class CORE_EXPORT QgsVectorDataProvider : public QgsDataProvider
      */
     virtual void enumValues( int index, QStringList& enumList ) { Q_UNUSED( index ); enumList.clear(); }
 
+    /**
+     * Calculates aggregates of an expression in the backend of the provider.
+     * Providers which can do it, e.g. in SQL, override this method. It is called by
+     * QgsAggregateCalculator, which iterates over the features if it returns false.
+     * @param aggregates aggregates to calculate
+     * @param expression field name or expression to aggregate
+     * @param groupByExpression field name or expression to group by, empty for a single group
+     * @param parameters filter and parameters of the aggregates
+     * @param results receives one result for each group, in any order
+     * @returns false if the provider cannot calculate the aggregates
+     *
+     * Default implementation answers minimum and maximum of a numeric field without filter
+     * and grouping through minimumValue() and maximumValue() and returns false otherwise.
+     * @note added in 2.12
+     */
+    virtual bool aggregate( const QList<QgsAggregateCalculator::Aggregate>& aggregates, const QString& expression, const QString& groupByExpression,
+                            const QgsAggregateCalculator::AggregateParameters& parameters, QgsAggregateCalculator::GroupResults& results );
+
     /**
      * Adds a list of features
      * @return true in case of success and false in case of failure
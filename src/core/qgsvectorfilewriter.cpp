@@ -19,6 +19,7 @@
 #include "qgsapplication.h"
 #include "qgsfield.h"
 #include "qgsfeature.h"
+#include "qgsfeaturebatch.h"
 #include "qgsgeometry.h"
 #include "qgslogger.h"
 #include "qgsmessagelog.h"
@@ -1611,6 +1612,7 @@ bool QgsVectorFileWriter::addFeature( QgsFeature& feature, QgsFeatureRendererV2*
           OGR_F_SetStyleString( poFeature, currentStyle.toLocal8Bit().data() );
           if ( !writeFeature( mLayer, poFeature ) )
           {
+            OGR_F_Destroy( poFeature );
             return false;
           }
         }
@@ -1623,6 +1625,7 @@ bool QgsVectorFileWriter::addFeature( QgsFeature& feature, QgsFeatureRendererV2*
   {
     if ( !writeFeature( mLayer, poFeature ) )
     {
+      OGR_F_Destroy( poFeature );
       return false;
     }
   }
@@ -1637,85 +1640,15 @@ OGRFeatureH QgsVectorFileWriter::createFeature( QgsFeature& feature )
 
   OGRFeatureH poFeature = OGR_F_Create( OGR_L_GetLayerDefn( mLayer ) );
 
-  qint64 fid = FID_TO_NUMBER( feature.id() );
-  if ( fid > std::numeric_limits<int>::max() )
-  {
-    QgsDebugMsg( QString( "feature id %1 too large." ).arg( fid ) );
-    OGRErr err = OGR_F_SetFID( poFeature, static_cast<long>( fid ) );
-    if ( err != OGRERR_NONE )
-    {
-      QgsDebugMsg( QString( "Failed to set feature id to %1: %2 (OGR error: %3)" )
-                   .arg( feature.id() )
-                   .arg( err ).arg( CPLGetLastErrorMsg() )
-                 );
-    }
-  }
+  setFeatureId( poFeature, feature.id() );
 
   // attribute handling
   for ( int fldIdx = 0; fldIdx < mFields.count(); ++fldIdx )
   {
-    if ( !mAttrIdxToOgrIdx.contains( fldIdx ) )
-    {
-      QgsDebugMsg( QString( "no ogr field for field %1" ).arg( fldIdx ) );
-      continue;
-    }
-
-    const QVariant& attrValue = feature.attribute( fldIdx );
-    int ogrField = mAttrIdxToOgrIdx[ fldIdx ];
-
-    if ( !attrValue.isValid() || attrValue.isNull() )
-      continue;
-
-    switch ( attrValue.type() )
+    if ( !setFeatureAttribute( poFeature, fldIdx, feature.attribute( fldIdx ) ) )
     {
-      case QVariant::Int:
-        OGR_F_SetFieldInteger( poFeature, ogrField, attrValue.toInt() );
-        break;
-      case QVariant::Double:
-        OGR_F_SetFieldDouble( poFeature, ogrField, attrValue.toDouble() );
-        break;
-      case QVariant::LongLong:
-      case QVariant::UInt:
-      case QVariant::ULongLong:
-      case QVariant::String:
-        OGR_F_SetFieldString( poFeature, ogrField, mCodec->fromUnicode( attrValue.toString() ).data() );
-        break;
-      case QVariant::Date:
-        OGR_F_SetFieldDateTime( poFeature, ogrField,
-                                attrValue.toDate().year(),
-                                attrValue.toDate().month(),
-                                attrValue.toDate().day(),
-                                0, 0, 0, 0 );
-        break;
-      case QVariant::DateTime:
-        OGR_F_SetFieldDateTime( poFeature, ogrField,
-                                attrValue.toDateTime().date().year(),
-                                attrValue.toDateTime().date().month(),
-                                attrValue.toDateTime().date().day(),
-                                attrValue.toDateTime().time().hour(),
-                                attrValue.toDateTime().time().minute(),
-                                attrValue.toDateTime().time().second(),
-                                0 );
-        break;
-      case QVariant::Time:
-        OGR_F_SetFieldDateTime( poFeature, ogrField,
-                                0, 0, 0,
-                                attrValue.toDateTime().time().hour(),
-                                attrValue.toDateTime().time().minute(),
-                                attrValue.toDateTime().time().second(),
-                                0 );
-        break;
-      case QVariant::Invalid:
-        break;
-      default:
-        mErrorMessage = QObject::tr( "Invalid variant type for field %1[%2]: received %3 with type %4" )
-                        .arg( mFields.at( fldIdx ).name() )
-                        .arg( ogrField )
-                        .arg( attrValue.typeName(),
-                              attrValue.toString() );
-        QgsMessageLog::logMessage( mErrorMessage, QObject::tr( "OGR" ) );
-        mError = ErrFeatureWriteFailed;
-        return 0;
+      OGR_F_Destroy( poFeature );
+      return 0;
     }
   }
 
@@ -1783,26 +1716,169 @@ OGRFeatureH QgsVectorFileWriter::createFeature( QgsFeature& feature )
       // pass ownership to geometry
       OGR_F_SetGeometryDirectly( poFeature, mGeom2 );
     }
-    else if ( geom )
+    else if ( geom && !setFeatureGeometry( poFeature, geom->asWkb(), ( int ) geom->wkbSize() ) )
     {
-      OGRErr err = OGR_G_ImportFromWkb( mGeom, const_cast<unsigned char *>( geom->asWkb() ), ( int ) geom->wkbSize() );
-      if ( err != OGRERR_NONE )
-      {
-        mErrorMessage = QObject::tr( "Feature geometry not imported (OGR error: %1)" )
-                        .arg( QString::fromUtf8( CPLGetLastErrorMsg() ) );
-        mError = ErrFeatureWriteFailed;
-        QgsMessageLog::logMessage( mErrorMessage, QObject::tr( "OGR" ) );
-        OGR_F_Destroy( poFeature );
-        return 0;
-      }
+      OGR_F_Destroy( poFeature );
+      return 0;
+    }
+  }
+  return poFeature;
+}
+
+bool QgsVectorFileWriter::addFeature( const QgsFeatureBatch& batch, int row )
+{
+  OGRFeatureH poFeature = createFeature( batch, row );
+  if ( !poFeature )
+    return false;
+
+  bool written = writeFeature( mLayer, poFeature );
+  OGR_F_Destroy( poFeature );
+  return written;
+}
+
+OGRFeatureH QgsVectorFileWriter::createFeature( const QgsFeatureBatch& batch, int row )
+{
+  const unsigned char* wkb = mWkbType != QGis::WKBNoGeometry ? batch.geometryWkb( row ) : 0;
+  if ( wkb )
+  {
+    QGis::WkbType wkbType;
+    memcpy( &wkbType, wkb + 1, sizeof( wkbType ) );
+    if ( wkbType != mWkbType )
+    {
+      // let QgsGeometry convert it
+      QgsFeature feature;
+      batch.feature( row, feature );
+      return createFeature( feature );
+    }
+  }
+
+  QgsLocaleNumC l;
 
-      // set geometry (ownership is not passed to OGR)
-      OGR_F_SetGeometry( poFeature, mGeom );
+  OGRFeatureH poFeature = OGR_F_Create( OGR_L_GetLayerDefn( mLayer ) );
+
+  setFeatureId( poFeature, batch.id( row ) );
+
+  int attributeCount = batch.fields().count();
+  for ( int fldIdx = 0; fldIdx < mFields.count(); ++fldIdx )
+  {
+    if ( !setFeatureAttribute( poFeature, fldIdx, fldIdx < attributeCount ? batch.attribute( row, fldIdx ) : QVariant() ) )
+    {
+      OGR_F_Destroy( poFeature );
+      return 0;
     }
   }
+
+  if ( wkb && !setFeatureGeometry( poFeature, wkb, batch.geometryWkbSize( row ) ) )
+  {
+    OGR_F_Destroy( poFeature );
+    return 0;
+  }
+
   return poFeature;
 }
 
+void QgsVectorFileWriter::setFeatureId( OGRFeatureH poFeature, QgsFeatureId id )
+{
+  qint64 fid = FID_TO_NUMBER( id );
+  if ( fid > std::numeric_limits<int>::max() )
+  {
+    QgsDebugMsg( QString( "feature id %1 too large." ).arg( fid ) );
+    OGRErr err = OGR_F_SetFID( poFeature, static_cast<long>( fid ) );
+    if ( err != OGRERR_NONE )
+    {
+      QgsDebugMsg( QString( "Failed to set feature id to %1: %2 (OGR error: %3)" )
+                   .arg( id )
+                   .arg( err ).arg( CPLGetLastErrorMsg() )
+                 );
+    }
+  }
+}
+
+bool QgsVectorFileWriter::setFeatureAttribute( OGRFeatureH poFeature, int fldIdx, const QVariant& attrValue )
+{
+  if ( !mAttrIdxToOgrIdx.contains( fldIdx ) )
+  {
+    QgsDebugMsg( QString( "no ogr field for field %1" ).arg( fldIdx ) );
+    return true;
+  }
+
+  int ogrField = mAttrIdxToOgrIdx[ fldIdx ];
+
+  if ( !attrValue.isValid() || attrValue.isNull() )
+    return true;
+
+  switch ( attrValue.type() )
+  {
+    case QVariant::Int:
+      OGR_F_SetFieldInteger( poFeature, ogrField, attrValue.toInt() );
+      break;
+    case QVariant::Double:
+      OGR_F_SetFieldDouble( poFeature, ogrField, attrValue.toDouble() );
+      break;
+    case QVariant::LongLong:
+    case QVariant::UInt:
+    case QVariant::ULongLong:
+    case QVariant::String:
+      OGR_F_SetFieldString( poFeature, ogrField, mCodec->fromUnicode( attrValue.toString() ).data() );
+      break;
+    case QVariant::Date:
+      OGR_F_SetFieldDateTime( poFeature, ogrField,
+                              attrValue.toDate().year(),
+                              attrValue.toDate().month(),
+                              attrValue.toDate().day(),
+                              0, 0, 0, 0 );
+      break;
+    case QVariant::DateTime:
+      OGR_F_SetFieldDateTime( poFeature, ogrField,
+                              attrValue.toDateTime().date().year(),
+                              attrValue.toDateTime().date().month(),
+                              attrValue.toDateTime().date().day(),
+                              attrValue.toDateTime().time().hour(),
+                              attrValue.toDateTime().time().minute(),
+                              attrValue.toDateTime().time().second(),
+                              0 );
+      break;
+    case QVariant::Time:
+      OGR_F_SetFieldDateTime( poFeature, ogrField,
+                              0, 0, 0,
+                              attrValue.toDateTime().time().hour(),
+                              attrValue.toDateTime().time().minute(),
+                              attrValue.toDateTime().time().second(),
+                              0 );
+      break;
+    case QVariant::Invalid:
+      break;
+    default:
+      mErrorMessage = QObject::tr( "Invalid variant type for field %1[%2]: received %3 with type %4" )
+                      .arg( mFields.at( fldIdx ).name() )
+                      .arg( ogrField )
+                      .arg( attrValue.typeName(),
+                            attrValue.toString() );
+      QgsMessageLog::logMessage( mErrorMessage, QObject::tr( "OGR" ) );
+      mError = ErrFeatureWriteFailed;
+      return false;
+  }
+
+  return true;
+}
+
+bool QgsVectorFileWriter::setFeatureGeometry( OGRFeatureH poFeature, const unsigned char* wkb, int wkbSize )
+{
+  OGRErr err = OGR_G_ImportFromWkb( mGeom, const_cast<unsigned char *>( wkb ), wkbSize );
+  if ( err != OGRERR_NONE )
+  {
+    mErrorMessage = QObject::tr( "Feature geometry not imported (OGR error: %1)" )
+                    .arg( QString::fromUtf8( CPLGetLastErrorMsg() ) );
+    mError = ErrFeatureWriteFailed;
+    QgsMessageLog::logMessage( mErrorMessage, QObject::tr( "OGR" ) );
+    return false;
+  }
+
+  // set geometry (ownership is not passed to OGR)
+  OGR_F_SetGeometry( poFeature, mGeom );
+  return true;
+}
+
 bool QgsVectorFileWriter::writeFeature( OGRLayerH layer, OGRFeatureH feature )
 {
   if ( OGR_L_CreateFeature( layer, feature ) != OGRERR_NONE )
@@ -1810,7 +1886,6 @@ bool QgsVectorFileWriter::writeFeature( OGRLayerH layer, OGRFeatureH feature )
     mErrorMessage = QObject::tr( "Feature creation error (OGR error: %1)" ).arg( QString::fromUtf8( CPLGetLastErrorMsg() ) );
     mError = ErrFeatureWriteFailed;
     QgsMessageLog::logMessage( mErrorMessage, QObject::tr( "OGR" ) );
-    OGR_F_Destroy( feature );
     return false;
   }
   return true;
@@ -2025,43 +2100,74 @@ QgsVectorFileWriter::WriterError QgsVectorFileWriter::writeAsVectorFormat( QgsVe
   }
 
   // write all features
-  while ( fit.nextFeature( fet ) )
-  {
-    if ( onlySelected && !ids.contains( fet.id() ) )
-      continue;
+  // rows of batches filled natively by the provider are written without a QgsFeature
+  bool writeRows = fit.hasNativeBatches() && !shallTransform && !filterExtent &&
+                   writer->symbologyExport() == NoSymbology;
+  QgsFeatureBatch batch;
+  int row = 0;
+  for ( ;; )
+  {
+    bool written;
+    if ( writeRows )
+    {
+      if ( row == batch.size() )
+      {
+        if ( fit.nextFeatures( batch ) == 0 )
+          break;
+        row = 0;
+      }
+
+      if ( onlySelected && !ids.contains( batch.id( row ) ) )
+      {
+        row++;
+        continue;
+      }
 
-    if ( shallTransform )
+      written = writer->addFeature( batch, row++ );
+    }
+    else
     {
-      try
+      if ( !fit.nextFeature( fet ) )
+        break;
+
+      if ( onlySelected && !ids.contains( fet.id() ) )
+        continue;
+
+      if ( shallTransform )
       {
-        if ( fet.geometry() )
+        try
         {
-          fet.geometry()->transform( *ct );
+          if ( fet.geometry() )
+          {
+            fet.geometry()->transform( *ct );
+          }
         }
-      }
-      catch ( QgsCsException &e )
-      {
-        delete writer;
+        catch ( QgsCsException &e )
+        {
+          delete writer;
 
-        QString msg = QObject::tr( "Failed to transform a point while drawing a feature with ID '%1'. Writing stopped. (Exception: %2)" )
-                      .arg( fet.id() ).arg( e.what() );
-        QgsLogger::warning( msg );
-        if ( errorMessage )
-          *errorMessage = msg;
+          QString msg = QObject::tr( "Failed to transform a point while drawing a feature with ID '%1'. Writing stopped. (Exception: %2)" )
+                        .arg( fet.id() ).arg( e.what() );
+          QgsLogger::warning( msg );
+          if ( errorMessage )
+            *errorMessage = msg;
 
-        return ErrProjection;
+          return ErrProjection;
+        }
       }
-    }
 
-    if ( fet.constGeometry() && filterExtent && !fet.constGeometry()->intersects( *filterExtent ) )
-      continue;
+      if ( fet.constGeometry() && filterExtent && !fet.constGeometry()->intersects( *filterExtent ) )
+        continue;
 
-    if ( allAttr.size() < 1 && skipAttributeCreation )
-    {
-      fet.initAttributes( 0 );
+      if ( allAttr.size() < 1 && skipAttributeCreation )
+      {
+        fet.initAttributes( 0 );
+      }
+
+      written = writer->addFeature( fet, layer->rendererV2(), mapUnits );
     }
 
-    if ( !writer->addFeature( fet, layer->rendererV2(), mapUnits ) )
+    if ( !written )
     {
       WriterError err = writer->hasError();
       if ( err != NoError && errorMessage )
@@ -27,6 +27,7 @@
 #include <QPair>
 
 
+class QgsFeatureBatch;
 class QgsSymbolLayerV2;
 class QTextCodec;
 
@@ -311,8 +312,20 @@ class CORE_EXPORT QgsVectorFileWriter
     static bool driverMetadata( const QString& driverName, QString &longName, QString &trLongName, QString &glob, QString &ext );
     void createSymbolLayerTable( QgsVectorLayer* vl,  const QgsCoordinateTransform* ct, OGRDataSourceH ds );
     OGRFeatureH createFeature( QgsFeature& feature );
+    //! writes a feature to the layer, the caller keeps ownership of the feature
     bool writeFeature( OGRLayerH layer, OGRFeatureH feature );
 
+    /** Writes a row of a batch without creating a QgsFeature, unless its geometry needs
+     * converting to the geometry type of the layer. Symbology is not exported. */
+    bool addFeature( const QgsFeatureBatch& batch, int row );
+    OGRFeatureH createFeature( const QgsFeatureBatch& batch, int row );
+
+    void setFeatureId( OGRFeatureH poFeature, QgsFeatureId id );
+    //! sets the OGR field of an attribute, returns false if the value has an unsupported type
+    bool setFeatureAttribute( OGRFeatureH poFeature, int fldIdx, const QVariant& attrValue );
+    //! sets the geometry of a feature from WKB of the geometry type of the layer
+    bool setFeatureGeometry( OGRFeatureH poFeature, const unsigned char* wkb, int wkbSize );
+
     /** Writes features considering symbol level order*/
     WriterError exportFeaturesSymbolLevels( QgsVectorLayer* layer, QgsFeatureIterator& fit, const QgsCoordinateTransform* ct, QString* errorMessage = 0 );
     double mmScaleFactor( double scaleDenominator, QgsSymbolV2::OutputUnit symbolUnits, QGis::UnitType mapUnits );
@@ -18,10 +18,471 @@
 #include "qgsvectorlayercache.h"
 #include "qgscacheindex.h"
 #include "qgscachedfeatureiterator.h"
+#include "qgsfeaturebatch.h"
+#include "qgsvectorlayerfeatureiterator.h"
+
+#include <QBitArray>
+#include <QtConcurrentRun>
+
+#include <limits>
+
+namespace
+{
+  // approximate memory used by a QVariant or QString besides its characters
+  const int VariantBytes = 16;
+  // approximate memory used by the cache for each feature besides its data
+  const int FeatureOverheadBytes = 64;
+  // string columns with more distinct values are not stored with a dictionary
+  const int MaxDictionarySize = 4096;
+
+  //! The values of an attribute of the cached features
+  class CachedColumn
+  {
+    public:
+      explicit CachedColumn( QVariant::Type type ) : mType( type ) {}
+      virtual ~CachedColumn() {}
+
+      virtual void resize( int slots ) = 0;
+
+      //! Stores the value, returns the number of bytes it uses
+      int set( int slot, const QVariant& value )
+      {
+        mOther.remove( slot );
+        if ( value.type() != mType )
+        {
+          // values of an unexpected type are kept as they are
+          mOther.insert( slot, value );
+          return VariantBytes + setTyped( slot, QVariant( mType ) );
+        }
+        return setTyped( slot, value );
+      }
+
+      QVariant value( int slot ) const
+      {
+        if ( !mOther.isEmpty() )
+        {
+          QHash<int, QVariant>::const_iterator it = mOther.constFind( slot );
+          if ( it != mOther.constEnd() )
+            return it.value();
+        }
+        return typedValue( slot );
+      }
+
+      //! Returns the number of bytes used by the value
+      int bytes( int slot ) const
+      {
+        return mOther.contains( slot ) ? VariantBytes + typedBytes( slot ) : typedBytes( slot );
+      }
+
+      void release( int slot )
+      {
+        mOther.remove( slot );
+        setTyped( slot, QVariant( mType ) );
+      }
+
+    protected:
+      virtual int setTyped( int slot, const QVariant& value ) = 0;
+      virtual QVariant typedValue( int slot ) const = 0;
+      virtual int typedBytes( int slot ) const = 0;
+
+      QVariant::Type mType;
+
+    private:
+      QHash<int, QVariant> mOther;
+  };
+
+  class IntColumn : public CachedColumn
+  {
+    public:
+      explicit IntColumn( QVariant::Type type ) : CachedColumn( type ) {}
+
+      void resize( int slots ) override
+      {
+        mValues.resize( slots );
+        mNull.resize( slots );
+      }
+
+    protected:
+      int setTyped( int slot, const QVariant& value ) override
+      {
+        mNull.setBit( slot, value.isNull() );
+        mValues[slot] = value.toLongLong();
+        return sizeof( qint64 );
+      }
+
+      QVariant typedValue( int slot ) const override
+      {
+        if ( mNull.testBit( slot ) )
+          return QVariant( mType );
+
+        qint64 v = mValues[slot];
+        switch ( mType )
+        {
+          case QVariant::Int:
+            return QVariant(( int ) v );
+          case QVariant::UInt:
+            return QVariant(( uint ) v );
+          case QVariant::Bool:
+            return QVariant( v != 0 );
+          default:
+            return QVariant(( qlonglong ) v );
+        }
+      }
+
+      int typedBytes( int slot ) const override
+      {
+        Q_UNUSED( slot );
+        return sizeof( qint64 );
+      }
+
+    private:
+      QVector<qint64> mValues;
+      QBitArray mNull;
+  };
+
+  class DoubleColumn : public CachedColumn
+  {
+    public:
+      DoubleColumn() : CachedColumn( QVariant::Double ) {}
+
+      void resize( int slots ) override
+      {
+        mValues.resize( slots );
+        mNull.resize( slots );
+      }
+
+    protected:
+      int setTyped( int slot, const QVariant& value ) override
+      {
+        mNull.setBit( slot, value.isNull() );
+        mValues[slot] = value.toDouble();
+        return sizeof( double );
+      }
+
+      QVariant typedValue( int slot ) const override
+      {
+        return mNull.testBit( slot ) ? QVariant( mType ) : QVariant( mValues[slot] );
+      }
+
+      int typedBytes( int slot ) const override
+      {
+        Q_UNUSED( slot );
+        return sizeof( double );
+      }
+
+    private:
+      QVector<double> mValues;
+      QBitArray mNull;
+  };
+
+  /** Strings are stored as indexes into a dictionary of the distinct values,
+   * until there are too many distinct values to make it worthwhile. */
+  class StringColumn : public CachedColumn
+  {
+    public:
+      StringColumn() : CachedColumn( QVariant::String ), mUseDictionary( true ) {}
+
+      void resize( int slots ) override
+      {
+        if ( mUseDictionary )
+          mCodes.resize( slots );
+        else
+          mValues.resize( slots );
+      }
+
+    protected:
+      int setTyped( int slot, const QVariant& value ) override
+      {
+        QString str = value.toString();
+        if ( mUseDictionary )
+        {
+          if ( str.isNull() )
+          {
+            mCodes[slot] = -1;
+            return sizeof( int );
+          }
+
+          QHash<QString, int>::const_iterator it = mLookup.constFind( str );
+          if ( it != mLookup.constEnd() )
+          {
+            mCodes[slot] = it.value();
+            return sizeof( int );
+          }
+
+          if ( mDictionary.size() < MaxDictionarySize )
+          {
+            mCodes[slot] = mDictionary.size();
+            mLookup.insert( str, mDictionary.size() );
+            mDictionary << str;
+            // the new value is accounted to the feature which introduced it
+            return sizeof( int ) + VariantBytes + 2 * str.size();
+          }
+
+          convertToPlainStrings();
+        }
+
+        mValues[slot] = str;
+        return VariantBytes + 2 * str.size();
+      }
+
+      QVariant typedValue( int slot ) const override
+      {
+        if ( mUseDictionary )
+          return mCodes[slot] < 0 ? QVariant( mType ) : QVariant( mDictionary[mCodes[slot]] );
+        else
+          return mValues[slot].isNull() ? QVariant( mType ) : QVariant( mValues[slot] );
+      }
+
+      int typedBytes( int slot ) const override
+      {
+        // the dictionary entries stay accounted to the features which introduced them
+        return mUseDictionary ? sizeof( int ) : VariantBytes + 2 * mValues[slot].size();
+      }
+
+    private:
+      void convertToPlainStrings()
+      {
+        mValues.resize( mCodes.size() );
+        for ( int i = 0; i < mCodes.size(); ++i )
+        {
+          if ( mCodes[i] >= 0 )
+            mValues[i] = mDictionary[mCodes[i]];
+        }
+        mCodes.clear();
+        mDictionary.clear();
+        mLookup.clear();
+        mUseDictionary = false;
+      }
+
+      bool mUseDictionary;
+      QVector<int> mCodes;
+      QVector<QString> mDictionary;
+      QHash<QString, int> mLookup;
+      QVector<QString> mValues;
+  };
+
+  //! Values of other types are kept in variants
+  class VariantColumn : public CachedColumn
+  {
+    public:
+      explicit VariantColumn( QVariant::Type type ) : CachedColumn( type ) {}
+
+      void resize( int slots ) override { mValues.resize( slots ); }
+
+    protected:
+      int setTyped( int slot, const QVariant& value ) override
+      {
+        mValues[slot] = value;
+        return VariantBytes + ( value.type() == QVariant::ByteArray ? value.toByteArray().size() : 0 );
+      }
+
+      QVariant typedValue( int slot ) const override { return mValues[slot]; }
+
+      int typedBytes( int slot ) const override
+      {
+        return VariantBytes + ( mValues[slot].type() == QVariant::ByteArray ? mValues[slot].toByteArray().size() : 0 );
+      }
+
+    private:
+      QVector<QVariant> mValues;
+  };
+
+  CachedColumn* createColumn( QVariant::Type type )
+  {
+    switch ( type )
+    {
+      case QVariant::Int:
+      case QVariant::UInt:
+      case QVariant::LongLong:
+      case QVariant::Bool:
+        return new IntColumn( type );
+      case QVariant::Double:
+        return new DoubleColumn();
+      case QVariant::String:
+        return new StringColumn();
+      default:
+        return new VariantColumn( type );
+    }
+  }
+
+  QgsFeatureList fetchFeatures( QgsAbstractFeatureSource* source, QgsFeatureRequest request )
+  {
+    QgsFeatureList features;
+    QgsFeatureIterator it = source->getFeatures( request );
+    QgsFeature f;
+    while ( it.nextFeature( f ) )
+      features << f;
+    return features;
+  }
+}
+
+/**
+ * Attributes and geometries of the cached features. Each feature occupies a slot,
+ * the attributes are stored in a typed array per cached attribute.
+ */
+class QgsCachedFeatureStore
+{
+  public:
+    QgsCachedFeatureStore( const QgsFields& fields, const QgsAttributeList& attributes )
+        : mFields( fields )
+        , mColumns( fields.count(), 0 )
+        , mSlotCount( 0 )
+        , mBytes( 0 )
+    {
+      Q_FOREACH ( int attr, attributes )
+      {
+        if ( attr >= 0 && attr < mColumns.size() && !mColumns[attr] )
+          mColumns[attr] = createColumn( fields[attr].type() );
+      }
+    }
+
+    ~QgsCachedFeatureStore()
+    {
+      qDeleteAll( mColumns );
+      qDeleteAll( mGeometries );
+    }
+
+    //! Stores the cached attributes and, if hasGeometry is set, the geometry of the feature, returns its slot
+    int add( const QgsFeature& f, bool hasGeometry, int& bytes )
+    {
+      int slot;
+      if ( !mFreeSlots.isEmpty() )
+      {
+        slot = mFreeSlots.last();
+        mFreeSlots.pop_back();
+      }
+      else
+      {
+        slot = mSlotCount++;
+        if ( slot >= mBytesPerSlot.size() )
+          resize( qMax( 64, 2 * mBytesPerSlot.size() ) );
+      }
+
+      bytes = FeatureOverheadBytes;
+      const QgsAttributes& attrs = f.attributes();
+      for ( int i = 0; i < mColumns.size(); ++i )
+      {
+        if ( mColumns[i] )
+          bytes += mColumns[i]->set( slot, i < attrs.size() ? attrs.at( i ) : QVariant() );
+      }
+
+      mGeometryLoaded.setBit( slot, hasGeometry );
+      if ( hasGeometry && f.constGeometry() )
+      {
+        mGeometries[slot] = new QgsGeometry( *f.constGeometry() );
+        bytes += mGeometries[slot]->wkbSize();
+      }
+
+      mBytesPerSlot[slot] = bytes;
+      mBytes += bytes;
+      return slot;
+    }
+
+    void remove( int slot )
+    {
+      for ( int i = 0; i < mColumns.size(); ++i )
+      {
+        if ( mColumns[i] )
+          mColumns[i]->release( slot );
+      }
+      delete mGeometries[slot];
+      mGeometries[slot] = 0;
+      mGeometryLoaded.clearBit( slot );
+
+      mBytes -= mBytesPerSlot[slot];
+      mBytesPerSlot[slot] = 0;
+      mFreeSlots << slot;
+    }
+
+    void feature( int slot, QgsFeature& f ) const
+    {
+      f.setFields( mFields, true );
+      for ( int i = 0; i < mColumns.size(); ++i )
+      {
+        if ( mColumns[i] )
+          f.setAttribute( i, mColumns[i]->value( slot ) );
+      }
+      f.setGeometry( mGeometries[slot] ? new QgsGeometry( *mGeometries[slot] ) : 0 );
+      f.setValid( true );
+    }
+
+    //! Changes a cached attribute of the feature, returns the number of bytes the feature uses
+    int setAttribute( int slot, int field, const QVariant& value )
+    {
+      if ( field >= 0 && field < mColumns.size() && mColumns[field] )
+      {
+        int bytes = mColumns[field]->bytes( slot );
+        addBytes( slot, mColumns[field]->set( slot, value ) - bytes );
+      }
+      return mBytesPerSlot[slot];
+    }
+
+    bool hasGeometry( int slot ) const { return mGeometryLoaded.testBit( slot ); }
+
+    //! Changes the geometry of the feature, returns the number of bytes the feature uses
+    int setGeometry( int slot, const QgsGeometry* geom )
+    {
+      int bytes = mGeometries[slot] ? -mGeometries[slot]->wkbSize() : 0;
+      delete mGeometries[slot];
+      mGeometries[slot] = geom ? new QgsGeometry( *geom ) : 0;
+      mGeometryLoaded.setBit( slot );
+      if ( mGeometries[slot] )
+        bytes += mGeometries[slot]->wkbSize();
+
+      addBytes( slot, bytes );
+      return mBytesPerSlot[slot];
+    }
+
+    //! approximate memory used by the features
+    qint64 bytes() const { return mBytes; }
+
+  private:
+    void addBytes( int slot, int bytes )
+    {
+      mBytesPerSlot[slot] += bytes;
+      mBytes += bytes;
+    }
+
+    void resize( int slots )
+    {
+      Q_FOREACH ( CachedColumn* column, mColumns )
+      {
+        if ( column )
+          column->resize( slots );
+      }
+      mGeometries.resize( slots );
+      mGeometryLoaded.resize( slots );
+      mBytesPerSlot.resize( slots );
+    }
+
+    QgsFields mFields;
+    //! columns by field index, null for attributes which are not cached
+    QVector<CachedColumn*> mColumns;
+    QVector<QgsGeometry*> mGeometries;
+    QBitArray mGeometryLoaded;
+    QVector<int> mBytesPerSlot;
+    QVector<int> mFreeSlots;
+    int mSlotCount;
+    qint64 mBytes;
+};
+
+
+QgsVectorLayerCache::QgsCachedFeature::~QgsCachedFeature()
+{
+  // That's the reason we need this wrapper:
+  // Inform the cache that this feature has been removed
+  mCache->mStore->remove( mSlot );
+  mCache->featureRemoved( mFid );
+}
 
 QgsVectorLayerCache::QgsVectorLayerCache( QgsVectorLayer* layer, int cacheSize, QObject* parent )
     : QObject( parent )
     , mLayer( layer )
+    , mStore( 0 )
+    , mMemoryLimit( -1 )
+    , mPrefetchSource( 0 )
+    , mGeneration( 0 )
+    , mPrefetchGeneration( 0 )
     , mFullCache( false )
 {
   mCache.setMaxCost( cacheSize );
@@ -38,22 +499,55 @@ QgsVectorLayerCache::QgsVectorLayerCache( QgsVectorLayer* layer, int cacheSize,
   connect( mLayer, SIGNAL( updatedFields() ), SLOT( invalidate() ) );
   connect( mLayer, SIGNAL( dataChanged() ), SLOT( invalidate() ) );
   connect( mLayer, SIGNAL( attributeValueChanged( QgsFeatureId, int, const QVariant& ) ), SLOT( onAttributeValueChanged( QgsFeatureId, int, const QVariant& ) ) );
+  connect( &mPrefetchWatcher, SIGNAL( finished() ), SLOT( onPrefetchFinished() ) );
 }
 
 QgsVectorLayerCache::~QgsVectorLayerCache()
 {
+  if ( mPrefetchSource )
+  {
+    mPrefetchWatcher.waitForFinished();
+    delete mPrefetchSource;
+  }
+
+  // the cached features release their slots in the store
+  mCache.clear();
+  delete mStore;
+
   qDeleteAll( mCacheIndices );
   mCacheIndices.clear();
 }
 
 void QgsVectorLayerCache::setCacheSize( int cacheSize )
 {
+  if ( mMemoryLimit >= 0 )
+  {
+    // the costs of the cached features are in bytes
+    mMemoryLimit = -1;
+    mCache.clear();
+  }
   mCache.setMaxCost( cacheSize );
 }
 
 int QgsVectorLayerCache::cacheSize()
 {
-  return mCache.maxCost();
+  return mMemoryLimit >= 0 ? mCache.size() : mCache.maxCost();
+}
+
+void QgsVectorLayerCache::setCacheMemoryLimit( qint64 bytes )
+{
+  if ( mMemoryLimit < 0 )
+  {
+    // the costs of the cached features are counts
+    mCache.clear();
+  }
+  mMemoryLimit = qMax( ( qint64 ) 0, bytes );
+  mCache.setMaxCost(( int ) qMin( mMemoryLimit, ( qint64 ) std::numeric_limits<int>::max() ) );
+}
+
+qint64 QgsVectorLayerCache::cacheMemoryUsed() const
+{
+  return mStore->bytes();
 }
 
 void QgsVectorLayerCache::setCacheGeometry( bool cacheGeometry )
@@ -72,6 +566,7 @@ void QgsVectorLayerCache::setCacheGeometry( bool cacheGeometry )
 void QgsVectorLayerCache::setCacheSubsetOfAttributes( const QgsAttributeList& attributes )
 {
   mCachedAttributes = attributes;
+  resetStore();
 }
 
 void QgsVectorLayerCache::setFullCache( bool fullCache )
@@ -93,10 +588,10 @@ void QgsVectorLayerCache::setFullCache( bool fullCache )
     QTime t;
     t.start();
 
-    QgsFeature f;
-    while ( it.nextFeature( f ) )
+    QgsFeatureBatch batch;
+    while ( it.nextFeatures( batch ) > 0 )
     {
-      ++i;
+      i += batch.size();
 
       if ( t.elapsed() > 1000 )
       {
@@ -136,16 +631,8 @@ bool QgsVectorLayerCache::featureAtId( QgsFeatureId featureId, QgsFeature& featu
 {
   bool featureFound = false;
 
-  QgsCachedFeature* cachedFeature = NULL;
-
-  if ( !skipCache )
+  if ( !skipCache && cachedFeature( featureId, feature, mCacheGeometry ) )
   {
-    cachedFeature = mCache[ featureId ];
-  }
-
-  if ( cachedFeature != NULL )
-  {
-    feature = QgsFeature( *cachedFeature->feature() );
     featureFound = true;
   }
   else if ( mLayer->getFeatures( QgsFeatureRequest()
@@ -154,13 +641,111 @@ bool QgsVectorLayerCache::featureAtId( QgsFeatureId featureId, QgsFeature& featu
                                  .setFlags( !mCacheGeometry ? QgsFeatureRequest::NoGeometry : QgsFeatureRequest::Flags( 0 ) ) )
             .nextFeature( feature ) )
   {
-    cacheFeature( feature );
+    cacheFeature( feature, mCacheGeometry );
     featureFound = true;
   }
 
   return featureFound;
 }
 
+void QgsVectorLayerCache::cacheFeature( const QgsFeature& feat, bool hasGeometry )
+{
+  int bytes;
+  int slot = mStore->add( feat, hasGeometry && mCacheGeometry, bytes );
+  mCache.insert( feat.id(), new QgsCachedFeature( feat.id(), slot, this ), mMemoryLimit >= 0 ? bytes : 1 );
+}
+
+bool QgsVectorLayerCache::cachedFeature( QgsFeatureId fid, QgsFeature& feature, bool needGeometry )
+{
+  QgsCachedFeature* cachedFeat = mCache[ fid ];
+  if ( !cachedFeat )
+    return false;
+
+  if ( needGeometry && mCacheGeometry && !mStore->hasGeometry( cachedFeat->mSlot ) )
+  {
+    // load the geometry lazily
+    QgsFeature f;
+    if ( mLayer->getFeatures( QgsFeatureRequest().setFilterFid( fid ).setSubsetOfAttributes( QgsAttributeList() ) ).nextFeature( f ) )
+    {
+      updateCost( fid, mStore->setGeometry( cachedFeat->mSlot, f.constGeometry() ) );
+      // the feature may have been evicted if it no longer fits in the cache
+      cachedFeat = mCache[ fid ];
+      if ( !cachedFeat )
+        return false;
+    }
+  }
+
+  mStore->feature( cachedFeat->mSlot, feature );
+  feature.setFeatureId( fid );
+  return true;
+}
+
+void QgsVectorLayerCache::updateCost( QgsFeatureId fid, int bytes )
+{
+  if ( mMemoryLimit < 0 )
+    return;
+
+  // QCache only sets the cost on insertion, taking the feature out keeps its slot
+  QgsCachedFeature* cachedFeat = mCache.take( fid );
+  if ( cachedFeat )
+    mCache.insert( fid, cachedFeat, bytes );
+}
+
+void QgsVectorLayerCache::resetStore()
+{
+  // features being prefetched may lack attributes
+  ++mGeneration;
+
+  // the cached features release their slots in the old store
+  mCache.clear();
+  delete mStore;
+  mStore = new QgsCachedFeatureStore( mLayer ? mLayer->fields() : QgsFields(), mCachedAttributes );
+}
+
+void QgsVectorLayerCache::prefetchFeatures( const QgsFeatureIds& fids )
+{
+  if ( mPrefetchSource || !mLayer )
+    return;
+
+  QgsFeatureIds missing;
+  Q_FOREACH ( QgsFeatureId fid, fids )
+  {
+    if ( !mCache.contains( fid ) )
+      missing << fid;
+  }
+  if ( missing.isEmpty() )
+    return;
+
+  // the source is a snapshot of the layer which can be read in a worker thread
+  mPrefetchSource = new QgsVectorLayerFeatureSource( mLayer );
+  mPrefetchGeneration = mGeneration;
+  QgsFeatureRequest request = QgsFeatureRequest()
+                              .setFilterFids( missing )
+                              .setSubsetOfAttributes( mCachedAttributes )
+                              .setFlags( QgsFeatureRequest::NoGeometry );
+  mPrefetchWatcher.setFuture( QtConcurrent::run( fetchFeatures, mPrefetchSource, request ) );
+}
+
+void QgsVectorLayerCache::onPrefetchFinished()
+{
+  if ( !mPrefetchSource )
+    return;
+
+  delete mPrefetchSource;
+  mPrefetchSource = 0;
+
+  // the features may be outdated if the layer has been changed meanwhile
+  if ( mPrefetchGeneration != mGeneration )
+    return;
+
+  QgsFeatureList features = mPrefetchWatcher.result();
+  Q_FOREACH ( const QgsFeature& f, features )
+  {
+    if ( !mCache.contains( f.id() ) )
+      cacheFeature( f, false );
+  }
+}
+
 bool QgsVectorLayerCache::removeCachedFeature( QgsFeatureId fid )
 {
   return mCache.remove( fid );
@@ -193,11 +778,12 @@ void QgsVectorLayerCache::featureRemoved( QgsFeatureId fid )
 
 void QgsVectorLayerCache::onAttributeValueChanged( QgsFeatureId fid, int field, const QVariant& value )
 {
+  ++mGeneration;
   QgsCachedFeature* cachedFeat = mCache[ fid ];
 
   if ( NULL != cachedFeat )
   {
-    cachedFeat->mFeature->setAttribute( field, value );
+    updateCost( fid, mStore->setAttribute( cachedFeat->mSlot, field, value ) );
   }
 
   emit attributeValueChanged( fid, field, value );
@@ -205,11 +791,13 @@ void QgsVectorLayerCache::onAttributeValueChanged( QgsFeatureId fid, int field,
 
 void QgsVectorLayerCache::featureDeleted( QgsFeatureId fid )
 {
+  ++mGeneration;
   mCache.remove( fid );
 }
 
 void QgsVectorLayerCache::onFeatureAdded( QgsFeatureId fid )
 {
+  ++mGeneration;
   if ( mFullCache )
   {
     if ( cacheSize() <= mLayer->featureCount() )
@@ -225,9 +813,8 @@ void QgsVectorLayerCache::onFeatureAdded( QgsFeatureId fid )
 
 void QgsVectorLayerCache::attributeAdded( int field )
 {
-  Q_UNUSED( field )
   mCachedAttributes.append( field );
-  mCache.clear();
+  resetStore();
 }
 
 void QgsVectorLayerCache::attributeDeleted( int field )
@@ -242,15 +829,18 @@ void QgsVectorLayerCache::attributeDeleted( int field )
     else if ( attr > field )
       mCachedAttributes << attr - 1;
   }
+
+  resetStore();
 }
 
 void QgsVectorLayerCache::geometryChanged( QgsFeatureId fid, QgsGeometry& geom )
 {
+  ++mGeneration;
   QgsCachedFeature* cachedFeat = mCache[ fid ];
 
   if ( cachedFeat != NULL )
   {
-    cachedFeat->mFeature->setGeometry( geom );
+    updateCost( fid, mStore->setGeometry( cachedFeat->mSlot, &geom ) );
   }
 }
 
@@ -262,7 +852,8 @@ void QgsVectorLayerCache::layerDeleted()
 
 void QgsVectorLayerCache::invalidate()
 {
-  mCache.clear();
+  // the fields may have changed
+  resetStore();
   emit invalidated();
 }
 
@@ -305,9 +896,8 @@ QgsFeatureIterator QgsVectorLayerCache::getFeatures( const QgsFeatureRequest &fe
     // No index was able to satisfy the request
     QgsFeatureRequest myRequest = QgsFeatureRequest( featureRequest );
 
-    // Make sure if we cache the geometry, it gets fetched
-    if ( mCacheGeometry && mLayer->hasGeometryType() )
-      myRequest.setFlags( featureRequest.flags() & ~QgsFeatureRequest::NoGeometry );
+    // Geometries are not fetched if they are not requested, they are loaded
+    // once a cached feature is queried with its geometry
 
     // Make sure, all the cached attributes are requested as well
     QSet<int> attrs = featureRequest.subsetOfAttributes().toSet() + mCachedAttributes.toSet();
@@ -20,11 +20,14 @@
 #define QgsVectorLayerCache_H
 
 #include <QCache>
+#include <QFutureWatcher>
 
 #include "qgsvectorlayer.h"
 
 class QgsCachedFeatureIterator;
 class QgsAbstractCacheIndex;
+class QgsAbstractFeatureSource;
+class QgsCachedFeatureStore;
 
 /**
  * This class caches features of a given QgsVectorLayer.
@@ -33,6 +36,10 @@ class QgsAbstractCacheIndex;
  * The cached features can be indexed by @link QgsAbstractCacheIndex @endlink.
  *
  * Proper indexing for a given use-case may speed up performance substantially.
+ *
+ * The attributes of the cached features are stored column by column, strings of
+ * columns with few distinct values are stored only once. The size of the cache
+ * is limited either by a number of features or by the memory they use.
  */
 
 class CORE_EXPORT QgsVectorLayerCache : public QObject
@@ -41,9 +48,10 @@ class CORE_EXPORT QgsVectorLayerCache : public QObject
 
   private:
     /**
-     * This is a wrapper class around a cached @link QgsFeature @endlink, which
-     * will inform the cache, when it has been deleted, so indexes can be
-     * updated that the wrapped feature needs to be fetched again if needed.
+     * This is a handle of a cached @link QgsFeature @endlink, whose data are kept in
+     * a slot of the feature store. It will release the slot and inform the cache when
+     * it has been deleted, so indexes can be updated that the feature needs to be
+     * fetched again if needed.
      */
     class QgsCachedFeature
     {
@@ -51,27 +59,22 @@ class CORE_EXPORT QgsVectorLayerCache : public QObject
         /**
          * Will create a new cached feature.
          *
-         * @param feat     The feature to cache. A copy will be made.
+         * @param fid      The id of the feature
+         * @param slot     The slot of the feature store holding the data of the feature
          * @param vlCache  The cache to inform when the feature has been removed from the cache.
          */
-        QgsCachedFeature( const QgsFeature& feat, QgsVectorLayerCache* vlCache )
-            : mCache( vlCache )
-        {
-          mFeature = new QgsFeature( feat );
-        }
-
-        ~QgsCachedFeature()
+        QgsCachedFeature( QgsFeatureId fid, int slot, QgsVectorLayerCache* vlCache )
+            : mFid( fid )
+            , mSlot( slot )
+            , mCache( vlCache )
         {
-          // That's the reason we need this wrapper:
-          // Inform the cache that this feature has been removed
-          mCache->featureRemoved( mFeature->id() );
-          delete mFeature;
         }
 
-        inline const QgsFeature* feature() { return mFeature; }
+        ~QgsCachedFeature();
 
       private:
-        QgsFeature* mFeature;
+        QgsFeatureId mFid;
+        int mSlot;
         QgsVectorLayerCache* mCache;
 
         friend class QgsVectorLayerCache;
@@ -94,13 +97,39 @@ class CORE_EXPORT QgsVectorLayerCache : public QObject
      * @brief
      * Returns the maximum number of features this cache will hold.
      * In case full caching is enabled, this number can change, as new features get added.
+     * If the cache is limited by memory, the number of features currently held is returned.
      *
      * @return int
      */
     int cacheSize();
 
     /**
-     * Enable or disable the caching of geometries
+     * Limits the memory used by the cached features instead of their number. The features
+     * used least recently are removed from the cache when the limit is reached.
+     * Calling setCacheSize() limits the number of features again. The cache is cleared
+     * when the kind of limit changes.
+     *
+     * @param bytes  Approximate maximum number of bytes used by the cached features
+     * @note added in 2.12
+     */
+    void setCacheMemoryLimit( qint64 bytes );
+
+    /**
+     * Returns the limit set by setCacheMemoryLimit() or -1 if the number of features is limited.
+     * @note added in 2.12
+     */
+    qint64 cacheMemoryLimit() const { return mMemoryLimit; }
+
+    /**
+     * Returns the approximate number of bytes used by the cached features.
+     * @note added in 2.12
+     */
+    qint64 cacheMemoryUsed() const;
+
+    /**
+     * Enable or disable the caching of geometries.
+     * Geometries are cached along with the attributes if a request fetches them, otherwise
+     * they are only loaded when a cached feature is queried with its geometry.
      *
      * @param cacheGeometry    Enable or disable the caching of geometries
      */
@@ -134,6 +163,13 @@ class CORE_EXPORT QgsVectorLayerCache : public QObject
      */
     void setFullCache( bool fullCache );
 
+    /**
+     * Returns true if all features are held in the cache.
+     * @see setFullCache()
+     * @note added in 2.12
+     */
+    bool hasFullCache() const { return mFullCache; }
+
     /**
      * @brief
      * Adds a {@link QgsAbstractCacheIndex} to this cache. Cache indices know about features present
@@ -183,6 +219,23 @@ class CORE_EXPORT QgsVectorLayerCache : public QObject
      */
     QgsVectorLayer* layer();
 
+    /**
+     * Fetches the features in a worker thread and adds them to the cache once they are available.
+     * Features already cached are skipped, geometries are not fetched. Does nothing if a prefetch
+     * is already running. Use it to load features which are likely to be needed soon, e.g. the
+     * rows following the visible ones of a table in the direction it is being scrolled.
+     *
+     * @param fids  The ids of the features to fetch
+     * @note added in 2.12
+     */
+    void prefetchFeatures( const QgsFeatureIds& fids );
+
+    /**
+     * Returns true while features are fetched by prefetchFeatures().
+     * @note added in 2.12
+     */
+    bool isPrefetching() const { return mPrefetchSource != 0; }
+
   protected:
     /**
      * @brief
@@ -270,17 +323,38 @@ class CORE_EXPORT QgsVectorLayerCache : public QObject
     void geometryChanged( QgsFeatureId fid, QgsGeometry& geom );
     void layerDeleted();
     void invalidate();
+    void onPrefetchFinished();
 
   private:
 
-    inline void cacheFeature( QgsFeature& feat )
-    {
-      QgsCachedFeature* cachedFeature = new QgsCachedFeature( feat, this );
-      mCache.insert( feat.id(), cachedFeature );
-    }
+    //! Adds the feature to the cache, hasGeometry tells whether its geometry has been fetched
+    void cacheFeature( const QgsFeature& feat, bool hasGeometry );
+
+    /**
+     * Reads a feature from the cache, returns false if it is not cached.
+     * The geometry is loaded from the layer if it is needed and not cached yet.
+     */
+    bool cachedFeature( QgsFeatureId fid, QgsFeature& feature, bool needGeometry );
+
+    //! Sets the cost of a cached feature after its size in bytes changed, if the memory is limited
+    void updateCost( QgsFeatureId fid, int bytes );
+
+    //! Empties the cache and sets up the store for the current fields and cached attributes
+    void resetStore();
 
     QgsVectorLayer* mLayer;
     QCache< QgsFeatureId, QgsCachedFeature > mCache;
+    //! attributes and geometries of the cached features
+    QgsCachedFeatureStore* mStore;
+    //! maximum memory used by the features in bytes, -1 to limit the number of features
+    qint64 mMemoryLimit;
+
+    //! source of the features being prefetched, null if no prefetch is running
+    QgsAbstractFeatureSource* mPrefetchSource;
+    QFutureWatcher<QgsFeatureList> mPrefetchWatcher;
+    //! incremented on every change of the layer, prefetched features are discarded if it changed meanwhile
+    int mGeneration;
+    int mPrefetchGeneration;
 
     bool mCacheGeometry;
     bool mFullCache;
@@ -15,6 +15,7 @@
 #include "qgsvectorlayerfeatureiterator.h"
 
 #include "qgsexpressionfieldbuffer.h"
+#include "qgsfeaturebatch.h"
 #include "qgsgeometrysimplifier.h"
 #include "qgsmaplayerregistry.h"
 #include "qgssimplifymethod.h"
@@ -89,8 +90,13 @@ QgsFeatureIterator QgsVectorLayerFeatureSource::getFeatures( const QgsFeatureReq
 QgsVectorLayerFeatureIterator::QgsVectorLayerFeatureIterator( QgsVectorLayerFeatureSource* source, bool ownSource, const QgsFeatureRequest& request )
     : QgsAbstractFeatureIteratorFromSource<QgsVectorLayerFeatureSource>( source, ownSource, request )
     , mFetchedFid( false )
+    , mProviderOrderBy( false )
     , mEditGeometrySimplifier( 0 )
 {
+  // the attributes to order by may be virtual fields which need more attributes
+  if ( !mRequest.orderBy().isEmpty() )
+    prepareOrderByAttributes();
+
   prepareExpressions();
 
   // prepare joins: may add more attributes to fetch (in order to allow join)
@@ -133,6 +139,25 @@ QgsVectorLayerFeatureIterator::QgsVectorLayerFeatureIterator( QgsVectorLayerFeat
     }
   }
 
+  // Features from the edit buffer are merged into the features of the provider and
+  // virtual fields are unknown to it, in these cases the features are ordered here.
+  // The provider can only stop at the limit if it returns exactly the features to return.
+  mProviderOrderBy = !mSource->mHasEditBuffer && !mRequest.orderBy().isEmpty();
+  Q_FOREACH ( const QString& field, mRequest.orderByAttributes() )
+  {
+    int idx = mSource->mFields.fieldNameIndex( field );
+    if ( idx == -1 || mSource->mFields.fieldOrigin( idx ) != QgsFields::OriginProvider )
+      mProviderOrderBy = false;
+  }
+
+  bool providerLimit = !mSource->mHasEditBuffer &&
+                       ( mRequest.orderBy().isEmpty() || mProviderOrderBy ) &&
+                       mProviderRequest.filterType() == mRequest.filterType();
+  if ( !mProviderOrderBy )
+    mProviderRequest.setOrderBy( QgsFeatureRequest::OrderBy() );
+  if ( !providerLimit )
+    mProviderRequest.setLimit( -1 );
+
   if ( mSource->mHasEditBuffer )
   {
     mChangedFeaturesRequest = mProviderRequest;
@@ -251,6 +276,48 @@ bool QgsVectorLayerFeatureIterator::fetchFeature( QgsFeature& f )
 
 
 
+int QgsVectorLayerFeatureIterator::fetchFeatures( QgsFeatureBatch& batch, int maxCount )
+{
+  if ( mClosed )
+    return 0;
+
+  // without edit buffer, joins and expression fields the layer fields are
+  // the provider fields and the provider features need no changes
+  if ( mSource->mHasEditBuffer || mHasVirtualAttributes || mRequest.filterType() == QgsFeatureRequest::FilterFid )
+    return QgsAbstractFeatureIterator::fetchFeatures( batch, maxCount );
+
+  if ( mProviderIterator.isClosed() )
+  {
+    mChangedFeaturesIterator.close();
+    mProviderIterator = mSource->mProviderFeatureSource->getFeatures( mProviderRequest );
+  }
+
+  int count = mProviderIterator.nextFeatures( batch, maxCount );
+  if ( count == 0 )
+  {
+    close();
+    return 0;
+  }
+
+  // allow name-based attribute lookups with the layer fields
+  batch.setFields( mSource->mFields );
+  return count;
+}
+
+bool QgsVectorLayerFeatureIterator::providesBatches() const
+{
+  return !mSource->mHasEditBuffer && !mHasVirtualAttributes &&
+         mRequest.filterType() != QgsFeatureRequest::FilterFid &&
+         mProviderIterator.hasNativeBatches();
+}
+
+bool QgsVectorLayerFeatureIterator::providesLimit() const
+{
+  return mProviderRequest.limit() >= 0 && mProviderIterator.hasNativeLimit();
+}
+
+
+
 bool QgsVectorLayerFeatureIterator::rewind()
 {
   if ( mClosed )
@@ -501,6 +568,32 @@ void QgsVectorLayerFeatureIterator::prepareJoins()
     mRequest.setSubsetOfAttributes( mRequest.subsetOfAttributes() + sourceJoinFields );
 }
 
+void QgsVectorLayerFeatureIterator::prepareOrderByAttributes()
+{
+  QSet<QString> attributes = mRequest.orderByAttributes();
+  if ( attributes.contains( QgsFeatureRequest::AllAttributes ) )
+  {
+    mRequest.setFlags( mRequest.flags() & ~QgsFeatureRequest::SubsetOfAttributes );
+  }
+  else if ( mRequest.flags() & QgsFeatureRequest::SubsetOfAttributes )
+  {
+    QgsAttributeList subset = mRequest.subsetOfAttributes();
+    Q_FOREACH ( const QString& attribute, attributes )
+    {
+      int idx = mSource->mFields.fieldNameIndex( attribute );
+      if ( idx != -1 && !subset.contains( idx ) )
+        subset << idx;
+    }
+    mRequest.setSubsetOfAttributes( subset );
+  }
+
+  Q_FOREACH ( const QgsFeatureRequest::OrderByClause& clause, mRequest.orderBy() )
+  {
+    if ( QgsExpression( clause.expression() ).needsGeometry() )
+      mRequest.setFlags( mRequest.flags() & ~QgsFeatureRequest::NoGeometry );
+  }
+}
+
 void QgsVectorLayerFeatureIterator::prepareExpressions()
 {
   const QList<QgsExpressionFieldBuffer::ExpressionField> exps = mSource->mExpressionFieldBuffer->expressions();
@@ -588,6 +681,12 @@ void QgsVectorLayerFeatureIterator::addVirtualAttributes( QgsFeature& f )
   }
 }
 
+bool QgsVectorLayerFeatureIterator::prepareOrderBy( const QList<QgsFeatureRequest::OrderByClause>& orderBys )
+{
+  Q_UNUSED( orderBys )
+  return mProviderOrderBy;
+}
+
 bool QgsVectorLayerFeatureIterator::prepareSimplification( const QgsSimplifyMethod& simplifyMethod )
 {
   delete mEditGeometrySimplifier;
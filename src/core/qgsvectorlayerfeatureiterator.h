@@ -84,6 +84,12 @@ class CORE_EXPORT QgsVectorLayerFeatureIterator : public QgsAbstractFeatureItera
     //! fetch next feature, return true on success
     virtual bool fetchFeature( QgsFeature& feature ) override;
 
+    //! Passes batches of the provider through if there is nothing to add to its features
+    virtual int fetchFeatures( QgsFeatureBatch& batch, int maxCount ) override;
+    virtual bool providesBatches() const override;
+    //! The limit is applied by the provider if it gets the whole request and there are no edits
+    virtual bool providesLimit() const override;
+
     //! Overrides default method as we only need to filter features in the edit buffer
     //! while for others filtering is left to the provider implementation.
     inline virtual bool nextFeatureFilterExpression( QgsFeature &f ) override { return fetchFeature( f ); }
@@ -91,6 +97,9 @@ class CORE_EXPORT QgsVectorLayerFeatureIterator : public QgsAbstractFeatureItera
     //! Setup the simplification of geometries to fetch using the specified simplify method
     virtual bool prepareSimplification( const QgsSimplifyMethod& simplifyMethod ) override;
 
+    //! The provider orders the features if there are no edits and it knows the fields to order by
+    virtual bool prepareOrderBy( const QList<QgsFeatureRequest::OrderByClause>& orderBys ) override;
+
 
     QgsFeatureRequest mProviderRequest;
     QgsFeatureIterator mProviderIterator;
@@ -105,9 +114,13 @@ class CORE_EXPORT QgsVectorLayerFeatureIterator : public QgsAbstractFeatureItera
 
     bool mFetchedFid; // when iterating by FID: indicator whether it has been fetched yet or not
 
+    //! the provider iterator returns the features in the order of the request
+    bool mProviderOrderBy;
+
     void rewindEditBuffer();
     void prepareJoins();
     void prepareExpressions();
+    void prepareOrderByAttributes();
     bool fetchNextAddedFeature( QgsFeature& f );
     bool fetchNextChangedGeomFeature( QgsFeature& f );
     bool fetchNextChangedAttributeFeature( QgsFeature& f );
@@ -27,6 +27,7 @@
 #include "qgsdatasourceuri.h"
 
 #include <QProgressDialog>
+#include <QTime>
 
 #define FEATURE_BUFFER_SIZE 200
 
@@ -52,11 +53,22 @@ QgsVectorLayerImport::QgsVectorLayerImport( const QString &uri,
     QProgressDialog *progress )
     : mErrorCount( 0 )
     , mAttributeCount( -1 )
+    , mFeatureBufferSize( FEATURE_BUFFER_SIZE )
     , mProgress( progress )
 
 {
   mProvider = NULL;
 
+  // the batch size is not a provider option
+  QMap<QString, QVariant> providerOptions;
+  if ( options )
+  {
+    providerOptions = *options;
+    int batchSize = providerOptions.take( "batchSize" ).toInt();
+    if ( batchSize > 0 )
+      mFeatureBufferSize = batchSize;
+  }
+
   QgsProviderRegistry * pReg = QgsProviderRegistry::instance();
 
   QLibrary *myLib = pReg->providerLibrary( providerKey );
@@ -80,7 +92,7 @@ QgsVectorLayerImport::QgsVectorLayerImport( const QString &uri,
 
   // create an empty layer
   QString errMsg;
-  mError = pCreateEmpty( uri, fields, geometryType, crs, overwrite, &mOldToNewAttrIdx, &errMsg, options );
+  mError = pCreateEmpty( uri, fields, geometryType, crs, overwrite, &mOldToNewAttrIdx, &errMsg, options ? &providerOptions : 0 );
   if ( hasError() )
   {
     mErrorMessage = errMsg;
@@ -155,7 +167,7 @@ bool QgsVectorLayerImport::addFeature( QgsFeature& feat )
 
   mFeatureBuffer.append( newFeat );
 
-  if ( mFeatureBuffer.count() >= FEATURE_BUFFER_SIZE )
+  if ( mFeatureBuffer.count() >= mFeatureBufferSize )
   {
     return flushBuffer();
   }
@@ -237,10 +249,13 @@ QgsVectorLayerImport::importLayer( QgsVectorLayer* layer,
 
   bool overwrite = false;
   bool forceSinglePartGeom = false;
+  bool spatialIndex = true;
   if ( options )
   {
     overwrite = options->take( "overwrite" ).toBool();
     forceSinglePartGeom = options->take( "forceSinglePartGeometryType" ).toBool();
+    if ( options->contains( "spatialIndex" ) )
+      spatialIndex = options->take( "spatialIndex" ).toBool();
   }
 
   QgsFields fields = skipAttributeCreation ? QgsFields() : layer->fields();
@@ -305,9 +320,11 @@ QgsVectorLayerImport::importLayer( QgsVectorLayer* layer,
   QgsAttributeList allAttr = skipAttributeCreation ? QgsAttributeList() : layer->attributeList();
   QgsFeature fet;
 
+  // the order of the features does not matter, so the provider may read them over several connections
   QgsFeatureRequest req;
+  req.setFlags( QgsFeatureRequest::ParallelScan );
   if ( wkbType == QGis::WKBNoGeometry )
-    req.setFlags( QgsFeatureRequest::NoGeometry );
+    req.setFlags( req.flags() | QgsFeatureRequest::NoGeometry );
   if ( skipAttributeCreation )
     req.setSubsetOfAttributes( QgsAttributeList() );
 
@@ -327,6 +344,9 @@ QgsVectorLayerImport::importLayer( QgsVectorLayer* layer,
     shallTransform = false;
   }
 
+  QTime time;
+  time.start();
+
   int n = 0;
 
   if ( errorMessage )
@@ -415,7 +435,14 @@ QgsVectorLayerImport::importLayer( QgsVectorLayer* layer,
   }
   int errors = writer->errorCount();
 
-  if ( !writer->createSpatialIndex() )
+  QgsMessageLog::logMessage( QObject::tr( "%1 features imported in %2 s (%3 features/s)" )
+                             .arg( n - errors )
+                             .arg( time.elapsed() / 1000.0, 0, 'f', 1 )
+                             .arg( time.elapsed() > 0 ? ( n - errors ) * 1000.0 / time.elapsed() : 0.0, 0, 'f', 0 ),
+                             QObject::tr( "Vector import" ), QgsMessageLog::INFO );
+
+  // the index is created after loading, that is faster than updating it for every feature
+  if ( spatialIndex && !writer->createSpatialIndex() )
   {
     if ( writer->hasError() && errorMessage )
     {
@@ -53,7 +53,13 @@ class CORE_EXPORT QgsVectorLayerImport
       ErrConnectionFailed
     };
 
-    /** Write contents of vector layer to a different datasource */
+    /** Write contents of vector layer to a different datasource.
+     * Besides provider specific options, options may contain "overwrite", "forceSinglePartGeometryType",
+     * "batchSize" (number of features passed to the provider at once, e.g. per transaction, since 2.12)
+     * and "spatialIndex" (false to not create a spatial index after loading, since 2.12).
+     * Providers which can create a spatial index create it after loading by default, e.g. a .qix
+     * file for shapefiles and, since 2.12, a GiST index on the geometry column for PostGIS.
+     */
     static ImportError importLayer( QgsVectorLayer* layer,
                                     const QString& uri,
                                     const QString& providerKey,
@@ -110,6 +116,8 @@ class CORE_EXPORT QgsVectorLayerImport
     int mAttributeCount;
 
     QgsFeatureList mFeatureBuffer;
+    //! number of features passed to the provider at once
+    int mFeatureBufferSize;
     QProgressDialog *mProgress;
 };
 
@@ -169,7 +169,7 @@ bool QgsVectorLayerRenderer::render()
     const QgsCoordinateTransform* ct = mContext.coordinateTransform();
 
     // resize the tolerance using the change of size of an 1-BBOX from the source CoordinateSystem to the target CoordinateSystem
-    if ( ct && !(( QgsCoordinateTransform* )ct )->isShortCircuited() )
+    if ( ct && !ct->isShortCircuited() )
     {
       try
       {
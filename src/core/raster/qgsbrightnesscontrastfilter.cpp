@@ -150,22 +150,38 @@ QgsRasterBlock * QgsBrightnessContrastFilter::block( int bandNo, QgsRectangle  c
   int r, g, b, alpha;
   double f = qPow(( mContrast + 100 ) / 100.0, 2 );
 
+  // Components of opaque pixels only depend on the component value -> adjust each value once
+  int myOpaqueComponents[256];
+  for ( int myComponent = 0; myComponent < 256; myComponent++ )
+  {
+    myOpaqueComponents[myComponent] = adjustColorComponent( myComponent, 255, mBrightness, f );
+  }
+
+  // Both blocks are images of 4 byte pixels, read and write them directly
+  const QRgb* myInputColors = reinterpret_cast<const QRgb*>( inputBlock->bits() );
+  QRgb* myOutputColors = reinterpret_cast<QRgb*>( outputBlock->bits() );
+
   for ( qgssize i = 0; i < ( qgssize )width*height; i++ )
   {
-    if ( inputBlock->color( i ) == myNoDataColor )
+    myColor = myInputColors[i];
+    if ( myColor == myNoDataColor )
     {
-      outputBlock->setColor( i, myNoDataColor );
+      myOutputColors[i] = myNoDataColor;
       continue;
     }
 
-    myColor = inputBlock->color( i );
     alpha = qAlpha( myColor );
+    if ( alpha == 255 )
+    {
+      myOutputColors[i] = qRgba( myOpaqueComponents[qRed( myColor )], myOpaqueComponents[qGreen( myColor )], myOpaqueComponents[qBlue( myColor )], alpha );
+      continue;
+    }
 
     r = adjustColorComponent( qRed( myColor ), alpha, mBrightness, f );
     g = adjustColorComponent( qGreen( myColor ), alpha, mBrightness, f );
     b = adjustColorComponent( qBlue( myColor ), alpha, mBrightness, f );
 
-    outputBlock->setColor( i, qRgba( r, g, b, alpha ) );
+    myOutputColors[i] = qRgba( r, g, b, alpha );
   }
 
   delete inputBlock;
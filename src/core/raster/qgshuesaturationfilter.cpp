@@ -160,15 +160,30 @@ QgsRasterBlock * QgsHueSaturationFilter::block( int bandNo, QgsRectangle  const
   int r, g, b, alpha;
   double alphaFactor = 1.0;
 
+  // Both blocks are images of 4 byte pixels, read and write them directly
+  const QRgb* myInputColors = reinterpret_cast<const QRgb*>( inputBlock->bits() );
+  QRgb* myOutputColors = reinterpret_cast<QRgb*>( outputBlock->bits() );
+
+  // Neighbouring pixels often have the same color, the result of the last color is reused
+  // because the conversions to and from HSL are expensive
+  QRgb myLastRgb = myNoDataColor;
+  QRgb myLastResult = myNoDataColor;
+
   for ( qgssize i = 0; i < ( qgssize )width*height; i++ )
   {
-    if ( inputBlock->color( i ) == myNoDataColor )
+    myRgb = myInputColors[i];
+    if ( myRgb == myNoDataColor )
+    {
+      myOutputColors[i] = myNoDataColor;
+      continue;
+    }
+
+    if ( myRgb == myLastRgb )
     {
-      outputBlock->setColor( i, myNoDataColor );
+      myOutputColors[i] = myLastResult;
       continue;
     }
 
-    myRgb = inputBlock->color( i );
     myColor = QColor( myRgb );
 
     // Alpha must be taken from QRgb, since conversion from QRgb->QColor loses alpha
@@ -177,7 +192,7 @@ QgsRasterBlock * QgsHueSaturationFilter::block( int bandNo, QgsRectangle  const
     if ( alpha == 0 )
     {
       // totally transparent, no changes required
-      outputBlock->setColor( i, myRgb );
+      myOutputColors[i] = myRgb;
       continue;
     }
 
@@ -217,7 +232,9 @@ QgsRasterBlock * QgsHueSaturationFilter::block( int bandNo, QgsRectangle  const
       b *= alphaFactor;
     }
 
-    outputBlock->setColor( i, qRgba( r, g, b, alpha ) );
+    myLastRgb = myRgb;
+    myLastResult = qRgba( r, g, b, alpha );
+    myOutputColors[i] = myLastResult;
   }
 
   delete inputBlock;
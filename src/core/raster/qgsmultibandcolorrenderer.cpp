@@ -17,6 +17,7 @@
 
 #include "qgsmultibandcolorrenderer.h"
 #include "qgscontrastenhancement.h"
+#include "qgsrasterlookup_p.h"
 #include "qgsrastertransparency.h"
 #include "qgsrasterviewport.h"
 #include <QDomDocument>
@@ -220,6 +221,19 @@ QgsRasterBlock* QgsMultiBandColorRenderer::block( int bandNo, QgsRectangle  cons
 
   QRgb myDefaultColor = NODATA_COLOR;
 
+  if ( mAlphaBand < 1 && mRedBand > 0 && mGreenBand > 0 && mBlueBand > 0 )
+  {
+    if ( lookupBlock( redBlock, greenBlock, blueBlock, outputBlock ) )
+    {
+      QMap<int, QgsRasterBlock*>::const_iterator bandDelIt = bandBlocks.constBegin();
+      for ( ; bandDelIt != bandBlocks.constEnd(); ++bandDelIt )
+      {
+        delete bandDelIt.value();
+      }
+      return outputBlock;
+    }
+  }
+
   for ( qgssize i = 0; i < ( qgssize )width*height; i++ )
   {
     if ( fastDraw ) //fast rendering if no transparency, stretching, color inversion, etc.
@@ -319,6 +333,89 @@ QgsRasterBlock* QgsMultiBandColorRenderer::block( int bandNo, QgsRectangle  cons
   return outputBlock;
 }
 
+bool QgsMultiBandColorRenderer::lookupBlock( QgsRasterBlock* redBlock, QgsRasterBlock* greenBlock, QgsRasterBlock* blueBlock, QgsRasterBlock* outputBlock )
+{
+  // Components are stretched to 0-255 or come from Byte bands, so -1 can mark the pixels
+  // drawn with the default color
+  if (( !mRedContrastEnhancement && redBlock->dataType() != QGis::Byte ) ||
+      ( !mGreenContrastEnhancement && greenBlock->dataType() != QGis::Byte ) ||
+      ( !mBlueContrastEnhancement && blueBlock->dataType() != QGis::Byte ) )
+  {
+    return false;
+  }
+
+  int redMin, redMax, greenMin, greenMax, blueMin, blueMax;
+  if ( !QgsRasterLookup::valueRange( redBlock, redMin, redMax ) ||
+       !QgsRasterLookup::valueRange( greenBlock, greenMin, greenMax ) ||
+       !QgsRasterLookup::valueRange( blueBlock, blueMin, blueMax ) )
+  {
+    return false;
+  }
+
+  // The displayable range of all bands is tested with the red value like in block()
+  QVector<short> redTable( redMax - redMin + 1 );
+  for ( int value = redMin; value <= redMax; value++ )
+  {
+    if (( mRedContrastEnhancement && !mRedContrastEnhancement->isValueInDisplayableRange( value ) )
+        || ( mGreenContrastEnhancement && !mGreenContrastEnhancement->isValueInDisplayableRange( value ) )
+        || ( mBlueContrastEnhancement && !mBlueContrastEnhancement->isValueInDisplayableRange( value ) ) )
+    {
+      redTable[value - redMin] = -1;
+    }
+    else
+    {
+      redTable[value - redMin] = mRedContrastEnhancement ? mRedContrastEnhancement->enhanceContrast( value ) : value;
+    }
+  }
+  QVector<short> greenTable( greenMax - greenMin + 1 );
+  for ( int value = greenMin; value <= greenMax; value++ )
+  {
+    greenTable[value - greenMin] = mGreenContrastEnhancement ? mGreenContrastEnhancement->enhanceContrast( value ) : value;
+  }
+  QVector<short> blueTable( blueMax - blueMin + 1 );
+  for ( int value = blueMin; value <= blueMax; value++ )
+  {
+    blueTable[value - blueMin] = mBlueContrastEnhancement ? mBlueContrastEnhancement->enhanceContrast( value ) : value;
+  }
+
+  qgssize count = ( qgssize )outputBlock->width() * outputBlock->height();
+  QVector<short> redValues( count );
+  QVector<short> greenValues( count );
+  QVector<short> blueValues( count );
+  QgsRasterLookup::lookup( redBlock, redTable, redMin, static_cast<short>( -1 ), redValues.data() );
+  QgsRasterLookup::lookup( greenBlock, greenTable, greenMin, static_cast<short>( -1 ), greenValues.data() );
+  QgsRasterLookup::lookup( blueBlock, blueTable, blueMin, static_cast<short>( -1 ), blueValues.data() );
+
+  QRgb* colors = reinterpret_cast<QRgb*>( outputBlock->bits() );
+  for ( qgssize i = 0; i < count; i++ )
+  {
+    double redVal = redValues[i];
+    double greenVal = greenValues[i];
+    double blueVal = blueValues[i];
+    if ( redVal < 0 || greenVal < 0 || blueVal < 0 )
+    {
+      colors[i] = NODATA_COLOR;
+      continue;
+    }
+
+    double currentOpacity = mOpacity;
+    if ( mRasterTransparency )
+    {
+      currentOpacity = mRasterTransparency->alphaValue( redVal, greenVal, blueVal, mOpacity * 255 ) / 255.0;
+    }
+
+    if ( qgsDoubleNear( currentOpacity, 1.0 ) )
+    {
+      colors[i] = qRgba( redVal, greenVal, blueVal, 255 );
+    }
+    else
+    {
+      colors[i] = qRgba( currentOpacity * redVal, currentOpacity * greenVal, currentOpacity * blueVal, currentOpacity * 255 );
+    }
+  }
+  return true;
+}
+
 void QgsMultiBandColorRenderer::writeXML( QDomDocument& doc, QDomElement& parentElem ) const
 {
   if ( parentElem.isNull() )
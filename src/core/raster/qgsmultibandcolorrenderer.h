@@ -70,6 +70,12 @@ class CORE_EXPORT QgsMultiBandColorRenderer: public QgsRasterRenderer
     QgsContrastEnhancement* mRedContrastEnhancement;
     QgsContrastEnhancement* mGreenContrastEnhancement;
     QgsContrastEnhancement* mBlueContrastEnhancement;
+
+    /** Draws the blocks of integer bands without alpha band by looking up the stretched
+     * components in tables of the values in the blocks.
+     * @returns false if the blocks cannot be looked up, outputBlock is not changed then
+     */
+    bool lookupBlock( QgsRasterBlock* redBlock, QgsRasterBlock* greenBlock, QgsRasterBlock* blueBlock, QgsRasterBlock* outputBlock );
 };
 
 #endif // QGSMULTIBANDCOLORRENDERER_H
@@ -20,9 +20,118 @@
 #include "qgsrasteriterator.h"
 #include "qgsrasterviewport.h"
 #include "qgsmaptopixel.h"
+#include <QFuture>
 #include <QImage>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QPainter>
 #include <QPrinter>
+#include <QThread>
+#include <QWaitCondition>
+#include <QtConcurrentRun>
+
+namespace
+{
+  //! Part of the viewport read in one block
+  struct RasterPart
+  {
+    int nCols;
+    int nRows;
+    int topLeftCol;
+    int topLeftRow;
+    QgsRectangle extent;
+  };
+
+  QImage partImage( QgsRasterInterface* input, int bandNumber, const RasterPart& part )
+  {
+    QgsRasterBlock *block = input->block( bandNumber, part.extent, part.nCols, part.nRows );
+    if ( !block )
+    {
+      return QImage();
+    }
+    QImage img = block->image();
+    delete block;
+    return img;
+  }
+
+  /** Parts shared by the drawing thread and the reader threads. Parts are handed out in
+   * order, and only while fewer than maxPending parts are read or waiting to be drawn,
+   * which bounds the memory held by finished images.
+   */
+  struct PartQueue
+  {
+    QList<RasterPart> parts;
+    int bandNumber;
+    int maxPending;
+    int nextPart; //!< first part not handed out yet
+    int nextDrawn; //!< first part not drawn yet
+    QMap<int, QImage> images; //!< read parts waiting to be drawn
+    QMutex mutex;
+    QWaitCondition changed;
+
+    //! Hands out the next part or returns -1, must be called with the mutex locked
+    int takePart()
+    {
+      if ( nextPart >= parts.size() || nextPart >= nextDrawn + maxPending )
+      {
+        return -1;
+      }
+      return nextPart++;
+    }
+  };
+
+  //! Reads parts with a clone of the pipe until all parts are handed out
+  void readParts( QgsRasterInterface* input, PartQueue* queue )
+  {
+    QMutexLocker locker( &queue->mutex );
+    while ( queue->nextPart < queue->parts.size() )
+    {
+      int i = queue->takePart();
+      if ( i < 0 )
+      {
+        queue->changed.wait( &queue->mutex );
+        continue;
+      }
+      locker.unlock();
+      QImage img = partImage( input, queue->bandNumber, queue->parts.at( i ) );
+      locker.relock();
+      queue->images.insert( i, img );
+      queue->changed.wakeAll();
+    }
+  }
+
+  /** Clones the interfaces from the provider to last like QgsRasterPipe does.
+   * The clones are appended to clones, the caller deletes them.
+   * @returns clone of last or 0 if an interface cannot be cloned
+   */
+  QgsRasterInterface* clonePipe( const QgsRasterInterface* last, QList<QgsRasterInterface*>& clones )
+  {
+    QList<const QgsRasterInterface*> interfaces;
+    for ( const QgsRasterInterface* interface = last; interface; interface = interface->input() )
+    {
+      interfaces.prepend( interface );
+    }
+
+    QgsRasterInterface* input = 0;
+    Q_FOREACH ( const QgsRasterInterface* interface, interfaces )
+    {
+      QgsRasterInterface* clone = interface->clone();
+      if ( !clone )
+      {
+        return 0;
+      }
+      clones << clone;
+      clone->setOn( interface->on() );
+      if ( input )
+      {
+        clone->setInput( input );
+      }
+      input = clone;
+    }
+    return input;
+  }
+}
 
 QgsRasterDrawer::QgsRasterDrawer( QgsRasterIterator* iterator ): mIterator( iterator )
 {
@@ -44,33 +153,77 @@ void QgsRasterDrawer::draw( QPainter* p, QgsRasterViewPort* viewPort, const QgsM
   int bandNumber = 1;
   mIterator->startRasterRead( bandNumber, viewPort->mWidth, viewPort->mHeight, viewPort->mDrawnExtent );
 
-  //number of cols/rows in output pixels
-  int nCols = 0;
-  int nRows = 0;
-  //shift to top left point for the raster part
-  int topLeftCol = 0;
-  int topLeftRow = 0;
+  // The parts are the same as if read sequentially, so the image does not depend on the
+  // number of threads. Parts are also read from copies of the pipe in other threads,
+  // because data sources cannot be read concurrently. The copies open their own data
+  // source, so there is one per spare core, and each reads parts until none are left.
+  PartQueue queue;
+  queue.bandNumber = bandNumber;
+  queue.nextPart = 0;
+  queue.nextDrawn = 0;
+  RasterPart part;
+  while ( mIterator->nextRasterPart( bandNumber, part.nCols, part.nRows, part.extent, part.topLeftCol, part.topLeftRow ) )
+  {
+    queue.parts << part;
+  }
 
-  // We know that the output data type of last pipe filter is QImage data
+  // the iterator was created with a non const input
+  QgsRasterInterface* input = const_cast<QgsRasterInterface*>( mIterator->input() );
 
-  QgsRasterBlock *block;
+  int readers = qMin( QThread::idealThreadCount() - 1, queue.parts.size() - 1 );
+  // one part in progress per thread and one more ready to be drawn
+  queue.maxPending = qMax( readers, 0 ) + 2;
 
-  // readNextRasterPart calcs and resets  nCols, nRows, topLeftCol, topLeftRow
-  while ( mIterator->readNextRasterPart( bandNumber, nCols, nRows,
-                                         &block, topLeftCol, topLeftRow ) )
+  QList<QgsRasterInterface*> clones;
+  QList< QFuture<void> > futures;
+  for ( int i = 0; i < readers; i++ )
   {
-    if ( !block )
+    QgsRasterInterface* readerInput = clonePipe( input, clones );
+    if ( !readerInput )
+    {
+      QgsDebugMsg( "Cannot clone pipe, reading remaining parts in fewer threads" );
+      break;
+    }
+    futures << QtConcurrent::run( readParts, readerInput, &queue );
+  }
+
+  // Because of bug in Acrobat Reader we must use "white" transparent color instead
+  // of "black" for PDF. See #9101.
+  QPrinter *printer = dynamic_cast<QPrinter *>( p->device() );
+  bool pdf = printer && printer->outputFormat() == QPrinter::PdfFormat;
+
+  // We know that the output data type of last pipe filter is QImage data
+  for ( int i = 0; i < queue.parts.size(); i++ )
+  {
+    // read parts here as well until the next part to draw is ready, the reader threads
+    // may not have started if the thread pool is busy
+    QImage img;
+    QMutexLocker locker( &queue.mutex );
+    while ( !queue.images.contains( i ) )
+    {
+      int readPart = queue.takePart();
+      if ( readPart < 0 )
+      {
+        queue.changed.wait( &queue.mutex );
+        continue;
+      }
+      locker.unlock();
+      QImage readImg = partImage( input, bandNumber, queue.parts.at( readPart ) );
+      locker.relock();
+      queue.images.insert( readPart, readImg );
+    }
+    img = queue.images.take( i );
+    queue.nextDrawn = i + 1;
+    queue.changed.wakeAll();
+    locker.unlock();
+
+    if ( img.isNull() )
     {
       QgsDebugMsg( "Cannot get block" );
       continue;
     }
 
-    QImage img = block->image();
-
-    // Because of bug in Acrobat Reader we must use "white" transparent color instead
-    // of "black" for PDF. See #9101.
-    QPrinter *printer = dynamic_cast<QPrinter *>( p->device() );
-    if ( printer && printer->outputFormat() == QPrinter::PdfFormat )
+    if ( pdf )
     {
       QgsDebugMsg( "PdfFormat" );
 
@@ -89,10 +242,14 @@ void QgsRasterDrawer::draw( QPainter* p, QgsRasterViewPort* viewPort, const QgsM
       }
     }
 
-    drawImage( p, viewPort, img, topLeftCol, topLeftRow, theQgsMapToPixel );
+    drawImage( p, viewPort, img, queue.parts.at( i ).topLeftCol, queue.parts.at( i ).topLeftRow, theQgsMapToPixel );
+  }
 
-    delete block;
+  Q_FOREACH ( QFuture<void> future, futures )
+  {
+    future.waitForFinished();
   }
+  qDeleteAll( clones );
 }
 
 void QgsRasterDrawer::drawImage( QPainter* p, QgsRasterViewPort* viewPort, const QImage& img, int topLeftCol, int topLeftRow, const QgsMapToPixel* theQgsMapToPixel ) const
@@ -19,7 +19,10 @@
 #include <typeinfo>
 
 #include <QByteArray>
+#include <QFuture>
+#include <QThread>
 #include <QTime>
+#include <QtConcurrentRun>
 
 #include <qmath.h>
 
@@ -29,6 +32,266 @@
 #include "qgsrasterinterface.h"
 #include "qgsrectangle.h"
 
+namespace
+{
+  //! Minimum number of blocks read by each thread when statistics are computed in parallel
+  const int sMinBlocksPerThread = 8;
+
+  //! A block of the raster sampled for statistics or histograms
+  struct SampleBlock
+  {
+    QgsRectangle extent;
+    int width;
+    int height;
+  };
+
+  //! Statistics of some blocks which can be merged with the statistics of other blocks
+  struct PartialStatistics
+  {
+    PartialStatistics()
+        : count( 0 )
+        , sum( 0 )
+        , mean( 0 )
+        , m2( 0 )
+        , minimum( std::numeric_limits<double>::max() )
+        , maximum( -std::numeric_limits<double>::max() )
+    {}
+
+    void add( double value )
+    {
+      count++;
+      sum += value;
+      if ( value < minimum ) minimum = value;
+      if ( value > maximum ) maximum = value;
+
+      // Single pass stdev
+      double delta = value - mean;
+      mean += delta / count;
+      m2 += delta * ( value - mean );
+    }
+
+    // Pairwise update of Chan et al., equivalent to adding all values of other
+    void merge( const PartialStatistics& other )
+    {
+      if ( other.count == 0 )
+        return;
+      if ( count == 0 )
+      {
+        *this = other;
+        return;
+      }
+
+      qgssize n = count + other.count;
+      double delta = other.mean - mean;
+      mean += delta * other.count / n;
+      m2 += other.m2 + delta * delta * ( static_cast<double>( count ) * other.count / n );
+      count = n;
+      sum += other.sum;
+      minimum = qMin( minimum, other.minimum );
+      maximum = qMax( maximum, other.maximum );
+    }
+
+    qgssize count;
+    double sum;
+    double mean;
+    double m2;
+    double minimum;
+    double maximum;
+  };
+
+  struct HistogramBins
+  {
+    double minimum;
+    double binSize;
+    int binCount;
+    bool includeOutOfRange;
+  };
+
+  //! Histogram counts of some blocks, merged by adding the counts
+  struct PartialHistogram
+  {
+    PartialHistogram()
+        : nonNullCount( 0 )
+    {}
+
+    void merge( const PartialHistogram& other )
+    {
+      for ( int i = 0; i < counts.size() && i < other.counts.size(); i++ )
+      {
+        counts[i] += other.counts[i];
+      }
+      nonNullCount += other.nonNullCount;
+    }
+
+    QgsRasterHistogram::HistogramVector counts;
+    int nonNullCount;
+  };
+
+  PartialStatistics blocksStatistics( QgsRasterInterface* interface, int bandNo, const QList<SampleBlock>& blocks )
+  {
+    PartialStatistics part;
+    Q_FOREACH ( const SampleBlock& sample, blocks )
+    {
+      QgsRasterBlock* blk = interface->block( bandNo, sample.extent, sample.width, sample.height );
+      for ( qgssize i = 0; i < (( qgssize ) sample.height ) * sample.width; i++ )
+      {
+        if ( blk->isNoData( i ) ) continue; // NULL
+
+        part.add( blk->value( i ) );
+      }
+      delete blk;
+    }
+    return part;
+  }
+
+  PartialHistogram blocksHistogram( QgsRasterInterface* interface, int bandNo, const QList<SampleBlock>& blocks, const HistogramBins& bins )
+  {
+    PartialHistogram part;
+    part.counts.resize( bins.binCount );
+    Q_FOREACH ( const SampleBlock& sample, blocks )
+    {
+      QgsRasterBlock* blk = interface->block( bandNo, sample.extent, sample.width, sample.height );
+
+      // Collect the histogram counts.
+      for ( qgssize i = 0; i < (( qgssize ) sample.height ) * sample.width; i++ )
+      {
+        if ( blk->isNoData( i ) )
+        {
+          continue; // NULL
+        }
+        double myValue = blk->value( i );
+
+        int myBinIndex = static_cast <int>( qFloor(( myValue - bins.minimum ) / bins.binSize ) );
+
+        if (( myBinIndex < 0 || myBinIndex > ( bins.binCount - 1 ) ) && !bins.includeOutOfRange )
+        {
+          continue;
+        }
+        if ( myBinIndex < 0 ) myBinIndex = 0;
+        if ( myBinIndex > ( bins.binCount - 1 ) ) myBinIndex = bins.binCount - 1;
+
+        part.counts[myBinIndex] += 1;
+        part.nonNullCount++;
+      }
+      delete blk;
+    }
+    return part;
+  }
+
+  /** Splits the sampled raster into blocks of the interface block size and distributes them
+   * over one list per thread. Rows of blocks are kept together to read neighbouring data.
+   */
+  QList< QList<SampleBlock> > sampleBlocks( QgsRasterInterface* interface, bool parallel, const QgsRectangle& extent, int width, int height )
+  {
+    int myXBlockSize = interface->xBlockSize();
+    int myYBlockSize = interface->yBlockSize();
+    if ( myXBlockSize == 0 ) // should not happen, but happens
+    {
+      myXBlockSize = 500;
+    }
+    if ( myYBlockSize == 0 ) // should not happen, but happens
+    {
+      myYBlockSize = 500;
+    }
+
+    int myNXBlocks = ( width + myXBlockSize - 1 ) / myXBlockSize;
+    int myNYBlocks = ( height + myYBlockSize - 1 ) / myYBlockSize;
+
+    double myXRes = extent.width() / width;
+    double myYRes = extent.height() / height;
+
+    int myThreads = 1;
+    if ( parallel )
+    {
+      myThreads = qBound( 1, qMin( QThread::idealThreadCount(), myNXBlocks * myNYBlocks / sMinBlocksPerThread ), myNYBlocks );
+    }
+
+    QList< QList<SampleBlock> > threadBlocks;
+    for ( int myThread = 0; myThread < myThreads; myThread++ )
+    {
+      QList<SampleBlock> blocks;
+      for ( int myYBlock = myThread * myNYBlocks / myThreads; myYBlock < ( myThread + 1 ) * myNYBlocks / myThreads; myYBlock++ )
+      {
+        for ( int myXBlock = 0; myXBlock < myNXBlocks; myXBlock++ )
+        {
+          SampleBlock sample;
+          sample.width = qMin( myXBlockSize, width - myXBlock * myXBlockSize );
+          sample.height = qMin( myYBlockSize, height - myYBlock * myYBlockSize );
+
+          double xmin = extent.xMinimum() + myXBlock * myXBlockSize * myXRes;
+          double xmax = xmin + sample.width * myXRes;
+          double ymin = extent.yMaximum() - myYBlock * myYBlockSize * myYRes;
+          double ymax = ymin - sample.height * myYRes;
+          sample.extent = QgsRectangle( xmin, ymin, xmax, ymax );
+          blocks << sample;
+        }
+      }
+      threadBlocks << blocks;
+    }
+    return threadBlocks;
+  }
+
+  /** Computes the statistics of the blocks. The blocks of the first thread are read from the
+   * interface itself in the calling thread, the blocks of the other threads from clones of
+   * the interface, because data sources cannot be read concurrently.
+   * Only interfaces without input may be cloned, a clone does not copy the input.
+   */
+  PartialStatistics computeStatistics( QgsRasterInterface* interface, bool parallel, int bandNo, const QgsRectangle& extent, int width, int height )
+  {
+    QList< QList<SampleBlock> > threadBlocks = sampleBlocks( interface, parallel, extent, width, height );
+
+    QList<QgsRasterInterface*> clones;
+    QList< QFuture<PartialStatistics> > futures;
+    for ( int i = 1; i < threadBlocks.size(); i++ )
+    {
+      QgsRasterInterface* clone = interface->clone();
+      if ( !clone )
+      {
+        threadBlocks[0] << threadBlocks[i];
+        continue;
+      }
+      clones << clone;
+      futures << QtConcurrent::run( blocksStatistics, clone, bandNo, threadBlocks[i] );
+    }
+
+    PartialStatistics statistics = blocksStatistics( interface, bandNo, threadBlocks[0] );
+    for ( int i = 0; i < futures.size(); i++ )
+    {
+      statistics.merge( futures[i].result() );
+    }
+    qDeleteAll( clones );
+    return statistics;
+  }
+
+  //! Computes the histogram of the blocks, in parallel like computeStatistics()
+  PartialHistogram computeHistogram( QgsRasterInterface* interface, bool parallel, int bandNo, const QgsRectangle& extent, int width, int height, const HistogramBins& bins )
+  {
+    QList< QList<SampleBlock> > threadBlocks = sampleBlocks( interface, parallel, extent, width, height );
+
+    QList<QgsRasterInterface*> clones;
+    QList< QFuture<PartialHistogram> > futures;
+    for ( int i = 1; i < threadBlocks.size(); i++ )
+    {
+      QgsRasterInterface* clone = interface->clone();
+      if ( !clone )
+      {
+        threadBlocks[0] << threadBlocks[i];
+        continue;
+      }
+      clones << clone;
+      futures << QtConcurrent::run( blocksHistogram, clone, bandNo, threadBlocks[i], bins );
+    }
+
+    PartialHistogram histogram = blocksHistogram( interface, bandNo, threadBlocks[0], bins );
+    for ( int i = 0; i < futures.size(); i++ )
+    {
+      histogram.merge( futures[i].result() );
+    }
+    qDeleteAll( clones );
+    return histogram;
+  }
+}
+
 QgsRasterInterface::QgsRasterInterface( QgsRasterInterface * input )
     : mInput( input )
     , mOn( true )
@@ -139,88 +402,12 @@ QgsRasterBandStats QgsRasterInterface::bandStatistics( int theBandNo,
     }
   }
 
-  QgsRectangle myExtent = myRasterBandStats.extent;
-  int myWidth = myRasterBandStats.width;
-  int myHeight = myRasterBandStats.height;
-
-  //int myDataType = dataType( theBandNo );
-
-  int myXBlockSize = xBlockSize();
-  int myYBlockSize = yBlockSize();
-  if ( myXBlockSize == 0 ) // should not happen, but happens
-  {
-    myXBlockSize = 500;
-  }
-  if ( myYBlockSize == 0 ) // should not happen, but happens
-  {
-    myYBlockSize = 500;
-  }
-
-  int myNXBlocks = ( myWidth + myXBlockSize - 1 ) / myXBlockSize;
-  int myNYBlocks = ( myHeight + myYBlockSize - 1 ) / myYBlockSize;
-
-  double myXRes = myExtent.width() / myWidth;
-  double myYRes = myExtent.height() / myHeight;
-  // TODO: progress signals
-
-  // used by single pass stdev
-  double myMean = 0;
-  double mySumOfSquares = 0;
-
-  bool myFirstIterationFlag = true;
-  for ( int myYBlock = 0; myYBlock < myNYBlocks; myYBlock++ )
-  {
-    for ( int myXBlock = 0; myXBlock < myNXBlocks; myXBlock++ )
-    {
-      QgsDebugMsg( QString( "myYBlock = %1 myXBlock = %2" ).arg( myYBlock ).arg( myXBlock ) );
-      int myBlockWidth = qMin( myXBlockSize, myWidth - myXBlock * myXBlockSize );
-      int myBlockHeight = qMin( myYBlockSize, myHeight - myYBlock * myYBlockSize );
-
-      double xmin = myExtent.xMinimum() + myXBlock * myXBlockSize * myXRes;
-      double xmax = xmin + myBlockWidth * myXRes;
-      double ymin = myExtent.yMaximum() - myYBlock * myYBlockSize * myYRes;
-      double ymax = ymin - myBlockHeight * myYRes;
-
-      QgsRectangle myPartExtent( xmin, ymin, xmax, ymax );
-
-      QgsRasterBlock* blk = block( theBandNo, myPartExtent, myBlockWidth, myBlockHeight );
-
-      // Collect the histogram counts.
-      for ( qgssize i = 0; i < (( qgssize ) myBlockHeight ) * myBlockWidth; i++ )
-      {
-        if ( blk->isNoData( i ) ) continue; // NULL
-
-        double myValue = blk->value( i );
-
-        myRasterBandStats.sum += myValue;
-        myRasterBandStats.elementCount++;
-
-        if ( myFirstIterationFlag )
-        {
-          myFirstIterationFlag = false;
-          myRasterBandStats.minimumValue = myValue;
-          myRasterBandStats.maximumValue = myValue;
-        }
-        else
-        {
-          if ( myValue < myRasterBandStats.minimumValue )
-          {
-            myRasterBandStats.minimumValue = myValue;
-          }
-          if ( myValue > myRasterBandStats.maximumValue )
-          {
-            myRasterBandStats.maximumValue = myValue;
-          }
-        }
-
-        // Single pass stdev
-        double myDelta = myValue - myMean;
-        myMean += myDelta / myRasterBandStats.elementCount;
-        mySumOfSquares += myDelta * ( myValue - myMean );
-      }
-      delete blk;
-    }
-  }
+  PartialStatistics myPart = computeStatistics( this, !mInput, theBandNo, myRasterBandStats.extent, myRasterBandStats.width, myRasterBandStats.height );
+  myRasterBandStats.elementCount = myPart.count;
+  myRasterBandStats.sum = myPart.sum;
+  myRasterBandStats.minimumValue = myPart.minimum;
+  myRasterBandStats.maximumValue = myPart.maximum;
+  double mySumOfSquares = myPart.m2;
 
   myRasterBandStats.range = myRasterBandStats.maximumValue - myRasterBandStats.minimumValue;
   myRasterBandStats.mean = myRasterBandStats.sum / myRasterBandStats.elementCount;
@@ -414,29 +601,6 @@ QgsRasterHistogram QgsRasterInterface::histogram( int theBandNo,
     }
   }
 
-  int myBinCount = myHistogram.binCount;
-  int myWidth = myHistogram.width;
-  int myHeight = myHistogram.height;
-  QgsRectangle myExtent = myHistogram.extent;
-  myHistogram.histogramVector.resize( myBinCount );
-
-  int myXBlockSize = xBlockSize();
-  int myYBlockSize = yBlockSize();
-  if ( myXBlockSize == 0 ) // should not happen, but happens
-  {
-    myXBlockSize = 500;
-  }
-  if ( myYBlockSize == 0 ) // should not happen, but happens
-  {
-    myYBlockSize = 500;
-  }
-
-  int myNXBlocks = ( myWidth + myXBlockSize - 1 ) / myXBlockSize;
-  int myNYBlocks = ( myHeight + myYBlockSize - 1 ) / myYBlockSize;
-
-  double myXRes = myExtent.width() / myWidth;
-  double myYRes = myExtent.height() / myHeight;
-
   double myMinimum = myHistogram.minimum;
   double myMaximum = myHistogram.maximum;
 
@@ -448,49 +612,15 @@ QgsRasterHistogram QgsRasterInterface::histogram( int theBandNo,
 
   QgsDebugMsg( QString( "binCount = %1 myMinimum = %2 myMaximum = %3" ).arg( myHistogram.binCount ).arg( myMinimum ).arg( myMaximum ) );
 
-  double myBinSize = ( myMaximum - myMinimum ) / myBinCount;
-
-  // TODO: progress signals
-  for ( int myYBlock = 0; myYBlock < myNYBlocks; myYBlock++ )
-  {
-    for ( int myXBlock = 0; myXBlock < myNXBlocks; myXBlock++ )
-    {
-      int myBlockWidth = qMin( myXBlockSize, myWidth - myXBlock * myXBlockSize );
-      int myBlockHeight = qMin( myYBlockSize, myHeight - myYBlock * myYBlockSize );
-
-      double xmin = myExtent.xMinimum() + myXBlock * myXBlockSize * myXRes;
-      double xmax = xmin + myBlockWidth * myXRes;
-      double ymin = myExtent.yMaximum() - myYBlock * myYBlockSize * myYRes;
-      double ymax = ymin - myBlockHeight * myYRes;
+  HistogramBins myBins;
+  myBins.minimum = myMinimum;
+  myBins.binSize = ( myMaximum - myMinimum ) / myHistogram.binCount;
+  myBins.binCount = myHistogram.binCount;
+  myBins.includeOutOfRange = theIncludeOutOfRange;
 
-      QgsRectangle myPartExtent( xmin, ymin, xmax, ymax );
-
-      QgsRasterBlock* blk = block( theBandNo, myPartExtent, myBlockWidth, myBlockHeight );
-
-      // Collect the histogram counts.
-      for ( qgssize i = 0; i < (( qgssize ) myBlockHeight ) * myBlockWidth; i++ )
-      {
-        if ( blk->isNoData( i ) )
-        {
-          continue; // NULL
-        }
-        double myValue = blk->value( i );
-
-        int myBinIndex = static_cast <int>( qFloor(( myValue - myMinimum ) /  myBinSize ) );
-
-        if (( myBinIndex < 0 || myBinIndex > ( myBinCount - 1 ) ) && !theIncludeOutOfRange )
-        {
-          continue;
-        }
-        if ( myBinIndex < 0 ) myBinIndex = 0;
-        if ( myBinIndex > ( myBinCount - 1 ) ) myBinIndex = myBinCount - 1;
-
-        myHistogram.histogramVector[myBinIndex] += 1;
-        myHistogram.nonNullCount++;
-      }
-      delete blk;
-    }
-  }
+  PartialHistogram myPart = computeHistogram( this, !mInput, theBandNo, myHistogram.extent, myHistogram.width, myHistogram.height, myBins );
+  myHistogram.histogramVector = myPart.counts;
+  myHistogram.nonNullCount = myPart.nonNullCount;
 
   myHistogram.valid = true;
   mHistograms.append( myHistogram );
@@ -56,6 +56,24 @@ class CORE_EXPORT QgsRasterIterator
                              QgsRasterBlock **block,
                              int& topLeftCol, int& topLeftRow );
 
+    /** Fetches the position of the next part of raster data without reading it.
+       The data of the part can be read with QgsRasterInterface::block() of the input,
+       which allows to read the parts in parallel from copies of the input.
+       @param bandNumber band to read
+       @param nCols number of columns on output device
+       @param nRows number of rows on output device
+       @param blockExtent extent of the part
+       @param topLeftCol top left column
+       @param topLeftRow top left row
+       @return false if the last part was already returned
+       @note added in 2.12
+       @note not available in Python bindings
+     */
+    bool nextRasterPart( int bandNumber,
+                         int& nCols, int& nRows,
+                         QgsRectangle& blockExtent,
+                         int& topLeftCol, int& topLeftRow );
+
     void stopRasterRead( int bandNumber );
 
     const QgsRasterInterface* input() const { return mInput; }
@@ -0,0 +1,187 @@
+/***************************************************************************
+                         qgsrasterlookup_p.h
+                         -------------------
+    begin                : October 2015
+    copyright            : (C) 2015 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSRASTERLOOKUP_PRIVATE_H
+#define QGSRASTERLOOKUP_PRIVATE_H
+
+/// @cond
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QGIS API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+
+#include "qgsrasterblock.h"
+
+#include <limits>
+
+#include <QVector>
+
+/** Looks up the result for each pixel of an integer block in a table indexed by the value.
+ * Renderers fill the table once for the range of values in the block, the pixels are then
+ * read directly from the block data instead of being converted to double one by one.
+ */
+class QgsRasterLookup
+{
+  public:
+
+    /** Returns the range of the values of a block with an integer data type, ignoring the
+     * no data value. Returns false for other data types, for blocks without values and if a
+     * table for the range would have more entries than the block has pixels, because then
+     * processing the pixels one by one is faster.
+     */
+    static bool valueRange( QgsRasterBlock* block, int& minimum, int& maximum )
+    {
+      const char* data = block->bits();
+      if ( !data )
+        return false;
+
+      qint64 min, max;
+      bool ok = false;
+      switch ( block->dataType() )
+      {
+        case QGis::Byte:
+          ok = dataRange( reinterpret_cast<const quint8*>( data ), block, min, max );
+          break;
+        case QGis::UInt16:
+          ok = dataRange( reinterpret_cast<const quint16*>( data ), block, min, max );
+          break;
+        case QGis::Int16:
+          ok = dataRange( reinterpret_cast<const qint16*>( data ), block, min, max );
+          break;
+        case QGis::UInt32:
+          ok = dataRange( reinterpret_cast<const quint32*>( data ), block, min, max );
+          break;
+        case QGis::Int32:
+          ok = dataRange( reinterpret_cast<const qint32*>( data ), block, min, max );
+          break;
+        default:
+          break;
+      }
+
+      if ( !ok || min < std::numeric_limits<int>::min() || max > std::numeric_limits<int>::max() ||
+           max - min + 1 > ( qint64 )block->width() * block->height() )
+        return false;
+
+      minimum = min;
+      maximum = max;
+      return true;
+    }
+
+    /** Sets output[i] to table[value - minimum] for each pixel of the block, and to noData for
+     * pixels without data. The range must have been returned by valueRange() for the block.
+     */
+    template <typename T>
+    static void lookup( QgsRasterBlock* block, const QVector<T>& table, int minimum, T noData, T* output )
+    {
+      const char* data = block->bits();
+      switch ( block->dataType() )
+      {
+        case QGis::Byte:
+          lookupData( reinterpret_cast<const quint8*>( data ), block, table, minimum, noData, output );
+          break;
+        case QGis::UInt16:
+          lookupData( reinterpret_cast<const quint16*>( data ), block, table, minimum, noData, output );
+          break;
+        case QGis::Int16:
+          lookupData( reinterpret_cast<const qint16*>( data ), block, table, minimum, noData, output );
+          break;
+        case QGis::UInt32:
+          lookupData( reinterpret_cast<const quint32*>( data ), block, table, minimum, noData, output );
+          break;
+        case QGis::Int32:
+          lookupData( reinterpret_cast<const qint32*>( data ), block, table, minimum, noData, output );
+          break;
+        default:
+          break;
+      }
+    }
+
+  private:
+
+    //! Same test as the private QgsRasterBlock::isNoDataValue()
+    static bool isNoDataValue( double value, double noDataValue )
+    {
+      return qIsNaN( value ) || qgsDoubleNear( value, noDataValue );
+    }
+
+    template <typename D>
+    static bool dataRange( const D* data, QgsRasterBlock* block, qint64& minimum, qint64& maximum )
+    {
+      qgssize count = ( qgssize )block->width() * block->height();
+      bool hasNoDataValue = block->hasNoDataValue();
+      double noDataValue = block->noDataValue();
+      bool found = false;
+      D min = 0;
+      D max = 0;
+      for ( qgssize i = 0; i < count; i++ )
+      {
+        D value = data[i];
+        if ( hasNoDataValue && isNoDataValue( value, noDataValue ) )
+          continue;
+
+        if ( !found )
+        {
+          min = max = value;
+          found = true;
+        }
+        else if ( value < min )
+          min = value;
+        else if ( value > max )
+          max = value;
+      }
+      minimum = min;
+      maximum = max;
+      return found;
+    }
+
+    template <typename D, typename T>
+    static void lookupData( const D* data, QgsRasterBlock* block, const QVector<T>& table, int minimum, T noData, T* output )
+    {
+      qgssize count = ( qgssize )block->width() * block->height();
+      const T* values = table.constData();
+
+      // like QgsRasterBlock::isNoData(), a no data value takes precedence over the bitmap
+      if ( block->hasNoDataValue() )
+      {
+        double noDataValue = block->noDataValue();
+        for ( qgssize i = 0; i < count; i++ )
+        {
+          output[i] = isNoDataValue( data[i], noDataValue ) ? noData : values[data[i] - minimum];
+        }
+      }
+      else if ( block->hasNoData() )
+      {
+        for ( qgssize i = 0; i < count; i++ )
+        {
+          output[i] = block->isNoData( i ) ? noData : values[data[i] - minimum];
+        }
+      }
+      else
+      {
+        for ( qgssize i = 0; i < count; i++ )
+        {
+          output[i] = values[data[i] - minimum];
+        }
+      }
+    }
+};
+
+/// @endcond
+
+#endif // QGSRASTERLOOKUP_PRIVATE_H
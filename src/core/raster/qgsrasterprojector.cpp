@@ -263,7 +263,7 @@ void QgsRasterProjector::calc()
   double myDestRes = mDestXRes < mDestYRes ? mDestXRes : mDestYRes;
   mSqrTolerance = myDestRes * myDestRes;
 
-  const QgsCoordinateTransform* inverseCt = QgsCoordinateTransformCache::instance()->transform( mDestCRS.authid(), mSrcCRS.authid(), mDestDatumTransform, mSrcDatumTransform );
+  QSharedPointer<const QgsCoordinateTransform> inverseCt = QgsCoordinateTransformCache::instance()->sharedTransform( mDestCRS.authid(), mSrcCRS.authid(), mDestDatumTransform, mSrcDatumTransform );
 
   if ( mPrecision == Approximate )
   {
@@ -286,20 +286,20 @@ void QgsRasterProjector::calc()
     }
     for ( int i = 0; i < mCPRows; i++ )
     {
-      calcRow( i, inverseCt );
+      calcRow( i, inverseCt.data() );
     }
 
     while ( true )
     {
-      bool myColsOK = checkCols( inverseCt );
+      bool myColsOK = checkCols( inverseCt.data() );
       if ( !myColsOK )
       {
-        insertRows( inverseCt );
+        insertRows( inverseCt.data() );
       }
-      bool myRowsOK = checkRows( inverseCt );
+      bool myRowsOK = checkRows( inverseCt.data() );
       if ( !myRowsOK )
       {
-        insertCols( inverseCt );
+        insertCols( inverseCt.data() );
       }
       if ( myColsOK && myRowsOK )
       {
@@ -367,7 +367,7 @@ void QgsRasterProjector::calcSrcExtent()
   }
   else
   {
-    const QgsCoordinateTransform* inverseCt = QgsCoordinateTransformCache::instance()->transform( mDestCRS.authid(), mSrcCRS.authid(), mDestDatumTransform, mSrcDatumTransform );
+    QSharedPointer<const QgsCoordinateTransform> inverseCt = QgsCoordinateTransformCache::instance()->sharedTransform( mDestCRS.authid(), mSrcCRS.authid(), mDestDatumTransform, mSrcDatumTransform );
     mSrcExtent = inverseCt->transformBoundingBox( mDestExtent );
   }
 
@@ -474,11 +474,11 @@ void QgsRasterProjector::calcSrcRowsCols()
   else
   {
     // take highest from corners, points in in the middle of corners and center (3 x 3 )
-    const QgsCoordinateTransform* inverseCt = QgsCoordinateTransformCache::instance()->transform( mDestCRS.authid(), mSrcCRS.authid(), mDestDatumTransform, mSrcDatumTransform );
+    QSharedPointer<const QgsCoordinateTransform> inverseCt = QgsCoordinateTransformCache::instance()->sharedTransform( mDestCRS.authid(), mSrcCRS.authid(), mDestDatumTransform, mSrcDatumTransform );
     //double
     QgsRectangle srcExtent;
     int srcXSize, srcYSize;
-    if ( extentSize( inverseCt, mDestExtent, mDestCols, mDestRows, srcExtent, srcXSize, srcYSize ) )
+    if ( extentSize( inverseCt.data(), mDestExtent, mDestCols, mDestRows, srcExtent, srcXSize, srcYSize ) )
     {
       double srcXRes = srcExtent.width() / srcXSize;
       double srcYRes = srcExtent.height() / srcYSize;
@@ -605,6 +605,54 @@ bool QgsRasterProjector::preciseSrcRowCol( int theDestRow, int theDestCol, int *
   QgsDebugMsgLevel( QString( "x = %1 y = %2" ).arg( x ).arg( y ), 5 );
 #endif
 
+  return srcRowColForPoint( x, y, theSrcRow, theSrcCol );
+}
+
+void QgsRasterProjector::preciseSrcRowCols( int theDestRow, int *theSrcRows, int *theSrcCols, const QgsCoordinateTransform* ct )
+{
+  QVector<double> x( mDestCols );
+  QVector<double> y( mDestCols, mDestExtent.yMaximum() - ( theDestRow + 0.5 ) * mDestYRes );
+  for ( int i = 0; i < mDestCols; ++i )
+  {
+    x[i] = mDestExtent.xMinimum() + ( i + 0.5 ) * mDestXRes;
+  }
+
+  bool transformed = true;
+  if ( ct )
+  {
+    try
+    {
+      // transform all cell centers of the row in one go
+      ct->transformStridedCoords( mDestCols, x.data(), y.data(), 0, 1 );
+    }
+    catch ( QgsCsException & )
+    {
+      transformed = false;
+    }
+  }
+
+  for ( int i = 0; i < mDestCols; ++i )
+  {
+    bool inside;
+    if ( transformed )
+    {
+      inside = srcRowColForPoint( x[i], y[i], &theSrcRows[i], &theSrcCols[i] );
+    }
+    else
+    {
+      // the batch failed, transform cell by cell so that only the offending cells are lost
+      inside = preciseSrcRowCol( theDestRow, i, &theSrcRows[i], &theSrcCols[i], ct );
+    }
+    if ( !inside )
+    {
+      theSrcRows[i] = -1;
+      theSrcCols[i] = -1;
+    }
+  }
+}
+
+bool QgsRasterProjector::srcRowColForPoint( double x, double y, int *theSrcRow, int *theSrcCol )
+{
   if ( !mExtent.contains( QgsPoint( x, y ) ) )
   {
     return false;
@@ -758,9 +806,44 @@ void QgsRasterProjector::calcCP( int theRow, int theCol, const QgsCoordinateTran
 bool QgsRasterProjector::calcRow( int theRow, const QgsCoordinateTransform* ct )
 {
   QgsDebugMsgLevel( QString( "theRow = %1" ).arg( theRow ), 3 );
+  if ( !ct )
+  {
+    for ( int i = 0; i < mCPCols; i++ )
+    {
+      mCPLegalMatrix[theRow][i] = false;
+    }
+    return true;
+  }
+
+  // transform the whole row at once, x/y stay interleaved in the buffer
+  QVector<double> xy( 2 * mCPCols );
   for ( int i = 0; i < mCPCols; i++ )
   {
-    calcCP( theRow, i, ct );
+    destPointOnCPMatrix( theRow, i, &xy[2 * i], &xy[2 * i + 1] );
+  }
+
+  try
+  {
+    ct->transformStridedCoords( mCPCols, xy.data(), xy.data() + 1, 0, 2 );
+  }
+  catch ( QgsCsException & )
+  {
+    // fall back to single points, so that only the failing points become illegal
+    for ( int i = 0; i < mCPCols; i++ )
+    {
+      calcCP( theRow, i, ct );
+    }
+    return true;
+  }
+
+  for ( int i = 0; i < mCPCols; i++ )
+  {
+    double x = xy[2 * i];
+    double y = xy[2 * i + 1];
+    // proj marks points it could not transform within a batch with HUGE_VAL
+    bool legal = qIsFinite( x ) && qIsFinite( y );
+    mCPMatrix[theRow][i] = QgsPoint( x, y );
+    mCPLegalMatrix[theRow][i] = legal;
   }
 
   return true;
@@ -951,21 +1034,41 @@ QgsRasterBlock * QgsRasterProjector::block( int bandNo, QgsRectangle  const & ex
   // we cannot fill output block with no data because we use memcpy for data, not setValue().
   bool doNoData = !QgsRasterBlock::typeIsNumeric( inputBlock->dataType() ) && inputBlock->hasNoData() && !inputBlock->hasNoDataValue();
 
-  const QgsCoordinateTransform* inverseCt = 0;
+  QSharedPointer<const QgsCoordinateTransform> inverseCt;
   if ( !mApproximate )
   {
-    inverseCt = QgsCoordinateTransformCache::instance()->transform( mDestCRS.authid(), mSrcCRS.authid(), mDestDatumTransform, mSrcDatumTransform );
+    inverseCt = QgsCoordinateTransformCache::instance()->sharedTransform( mDestCRS.authid(), mSrcCRS.authid(), mDestDatumTransform, mSrcDatumTransform );
   }
 
   outputBlock->setIsNoData();
 
   int srcRow, srcCol;
+  QVector<int> preciseSrcRows, preciseSrcCols;
+  if ( !mApproximate )
+  {
+    preciseSrcRows.resize( width );
+    preciseSrcCols.resize( width );
+  }
   for ( int i = 0; i < height; ++i )
   {
+    if ( !mApproximate )
+    {
+      preciseSrcRowCols( i, preciseSrcRows.data(), preciseSrcCols.data(), inverseCt.data() );
+    }
+
     for ( int j = 0; j < width; ++j )
     {
-      bool inside = srcRowCol( i, j, &srcRow, &srcCol, inverseCt );
-      if ( !inside ) continue; // we have everything set to no data
+      if ( mApproximate )
+      {
+        bool inside = approximateSrcRowCol( i, j, &srcRow, &srcCol );
+        if ( !inside ) continue; // we have everything set to no data
+      }
+      else
+      {
+        srcRow = preciseSrcRows[j];
+        srcCol = preciseSrcCols[j];
+        if ( srcRow < 0 ) continue; // we have everything set to no data
+      }
 
       qgssize srcIndex = ( qgssize )srcRow * mSrcCols + srcCol;
       QgsDebugMsgLevel( QString( "row = %1 col = %2 srcRow = %3 srcCol = %4" ).arg( i ).arg( j ).arg( srcRow ).arg( srcCol ), 5 );
@@ -1007,9 +1110,9 @@ bool QgsRasterProjector::destExtentSize( const QgsRectangle& theSrcExtent, int t
   {
     return false;
   }
-  const QgsCoordinateTransform* ct = QgsCoordinateTransformCache::instance()->transform( mSrcCRS.authid(), mDestCRS.authid(), mSrcDatumTransform, mDestDatumTransform );
+  QSharedPointer<const QgsCoordinateTransform> ct = QgsCoordinateTransformCache::instance()->sharedTransform( mSrcCRS.authid(), mDestCRS.authid(), mSrcDatumTransform, mDestDatumTransform );
 
-  return extentSize( ct, theSrcExtent, theSrcXSize, theSrcYSize, theDestExtent, theDestXSize, theDestYSize );
+  return extentSize( ct.data(), theSrcExtent, theSrcXSize, theSrcYSize, theDestExtent, theDestXSize, theDestYSize );
 }
 
 bool QgsRasterProjector::extentSize( const QgsCoordinateTransform* ct,
@@ -154,6 +154,15 @@ class CORE_EXPORT QgsRasterProjector : public QgsRasterInterface
     /** \brief Get precise source row and column indexes for current source extent and resolution */
     inline bool preciseSrcRowCol( int theDestRow, int theDestCol, int *theSrcRow, int *theSrcCol, const QgsCoordinateTransform* ct );
 
+    /** \brief Get precise source row and column indexes for all cells of a destination row.
+      * Cell centers of the row are transformed in one batch. Cells outside of the source get row and column -1.
+      * @note added in 2.12 */
+    void preciseSrcRowCols( int theDestRow, int *theSrcRows, int *theSrcCols, const QgsCoordinateTransform* ct );
+
+    /** \brief Get source row and column indexes for a point in source coordinates
+      * @note added in 2.12 */
+    bool srcRowColForPoint( double x, double y, int *theSrcRow, int *theSrcCol );
+
     /** \brief Get approximate source row and column indexes for current source extent and resolution */
     inline bool approximateSrcRowCol( int theDestRow, int theDestCol, int *theSrcRow, int *theSrcCol );
 
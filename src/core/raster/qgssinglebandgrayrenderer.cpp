@@ -17,6 +17,7 @@
 
 #include "qgssinglebandgrayrenderer.h"
 #include "qgscontrastenhancement.h"
+#include "qgsrasterlookup_p.h"
 #include "qgsrastertransparency.h"
 #include <QDomDocument>
 #include <QDomElement>
@@ -124,47 +125,29 @@ QgsRasterBlock* QgsSingleBandGrayRenderer::block( int bandNo, QgsRectangle  cons
   }
 
   QRgb myDefaultColor = NODATA_COLOR;
-  for ( qgssize i = 0; i < ( qgssize )width*height; i++ )
-  {
-    if ( inputBlock->isNoData( i ) )
-    {
-      outputBlock->setColor( i, myDefaultColor );
-      continue;
-    }
-    double grayVal = inputBlock->value( i );
 
-    double currentAlpha = mOpacity;
-    if ( mRasterTransparency )
-    {
-      currentAlpha = mRasterTransparency->alphaValue( grayVal, mOpacity * 255 ) / 255.0;
-    }
-    if ( mAlphaBand > 0 )
+  int myMinimum, myMaximum;
+  if ( mAlphaBand < 1 && QgsRasterLookup::valueRange( inputBlock, myMinimum, myMaximum ) )
+  {
+    // Without alpha band the color only depends on the value -> compute the color of each
+    // value in the block once
+    QVector<QRgb> myColors( myMaximum - myMinimum + 1 );
+    for ( int myValue = myMinimum; myValue <= myMaximum; myValue++ )
     {
-      currentAlpha *= alphaBlock->value( i ) / 255.0;
+      myColors[myValue - myMinimum] = grayColor( myValue, 255 );
     }
-
-    if ( mContrastEnhancement )
+    QgsRasterLookup::lookup( inputBlock, myColors, myMinimum, myDefaultColor, reinterpret_cast<QRgb*>( outputBlock->bits() ) );
+  }
+  else
+  {
+    for ( qgssize i = 0; i < ( qgssize )width*height; i++ )
     {
-      if ( !mContrastEnhancement->isValueInDisplayableRange( grayVal ) )
+      if ( inputBlock->isNoData( i ) )
       {
         outputBlock->setColor( i, myDefaultColor );
         continue;
       }
-      grayVal = mContrastEnhancement->enhanceContrast( grayVal );
-    }
-
-    if ( mGradient == WhiteToBlack )
-    {
-      grayVal = 255 - grayVal;
-    }
-
-    if ( qgsDoubleNear( currentAlpha, 1.0 ) )
-    {
-      outputBlock->setColor( i, qRgba( grayVal, grayVal, grayVal, 255 ) );
-    }
-    else
-    {
-      outputBlock->setColor( i, qRgba( currentAlpha * grayVal, currentAlpha * grayVal, currentAlpha * grayVal, currentAlpha * 255 ) );
+      outputBlock->setColor( i, grayColor( inputBlock->value( i ), mAlphaBand > 0 ? alphaBlock->value( i ) : 255 ) );
     }
   }
 
@@ -177,6 +160,42 @@ QgsRasterBlock* QgsSingleBandGrayRenderer::block( int bandNo, QgsRectangle  cons
   return outputBlock;
 }
 
+QRgb QgsSingleBandGrayRenderer::grayColor( double grayVal, double alphaVal )
+{
+  double currentAlpha = mOpacity;
+  if ( mRasterTransparency )
+  {
+    currentAlpha = mRasterTransparency->alphaValue( grayVal, mOpacity * 255 ) / 255.0;
+  }
+  if ( mAlphaBand > 0 )
+  {
+    currentAlpha *= alphaVal / 255.0;
+  }
+
+  if ( mContrastEnhancement )
+  {
+    if ( !mContrastEnhancement->isValueInDisplayableRange( grayVal ) )
+    {
+      return NODATA_COLOR;
+    }
+    grayVal = mContrastEnhancement->enhanceContrast( grayVal );
+  }
+
+  if ( mGradient == WhiteToBlack )
+  {
+    grayVal = 255 - grayVal;
+  }
+
+  if ( qgsDoubleNear( currentAlpha, 1.0 ) )
+  {
+    return qRgba( grayVal, grayVal, grayVal, 255 );
+  }
+  else
+  {
+    return qRgba( currentAlpha * grayVal, currentAlpha * grayVal, currentAlpha * grayVal, currentAlpha * 255 );
+  }
+}
+
 void QgsSingleBandGrayRenderer::writeXML( QDomDocument& doc, QDomElement& parentElem ) const
 {
   if ( parentElem.isNull() )
@@ -62,6 +62,12 @@ class CORE_EXPORT QgsSingleBandGrayRenderer: public QgsRasterRenderer
     int mGrayBand;
     Gradient mGradient;
     QgsContrastEnhancement* mContrastEnhancement;
+
+    /** Returns the color of a gray value
+     * @param grayVal value of the gray band
+     * @param alphaVal value of the alpha band, if an alpha band is used
+     */
+    QRgb grayColor( double grayVal, double alphaVal );
 };
 
 #endif // QGSSINGLEBANDGRAYRENDERER_H
@@ -16,6 +16,7 @@
  ***************************************************************************/
 
 #include "qgssinglebandpseudocolorrenderer.h"
+#include "qgsrasterlookup_p.h"
 #include "qgsrastershader.h"
 #include "qgsrastertransparency.h"
 #include "qgsrasterviewport.h"
@@ -157,47 +158,28 @@ QgsRasterBlock* QgsSingleBandPseudoColorRenderer::block( int bandNo, QgsRectangl
 
   QRgb myDefaultColor = NODATA_COLOR;
 
-  for ( qgssize i = 0; i < ( qgssize )width*height; i++ )
+  int myMinimum, myMaximum;
+  if ( mAlphaBand < 1 && QgsRasterLookup::valueRange( inputBlock, myMinimum, myMaximum ) )
   {
-    if ( inputBlock->isNoData( i ) )
+    // Without alpha band the color only depends on the value -> shade each value in the
+    // block once
+    QVector<QRgb> myColors( myMaximum - myMinimum + 1 );
+    for ( int myValue = myMinimum; myValue <= myMaximum; myValue++ )
     {
-      outputBlock->setColor( i, myDefaultColor );
-      continue;
+      myColors[myValue - myMinimum] = pseudoColor( myValue, 255, hasTransparency );
     }
-    double val = inputBlock->value( i );
-    int red, green, blue, alpha;
-    if ( !mShader->shade( val, &red, &green, &blue, &alpha ) )
-    {
-      outputBlock->setColor( i, myDefaultColor );
-      continue;
-    }
-
-    if ( alpha < 255 )
-    {
-      // Working with premultiplied colors, so multiply values by alpha
-      red *= ( alpha / 255.0 );
-      blue *= ( alpha / 255.0 );
-      green *= ( alpha / 255.0 );
-    }
-
-    if ( !hasTransparency )
-    {
-      outputBlock->setColor( i, qRgba( red, green, blue, alpha ) );
-    }
-    else
+    QgsRasterLookup::lookup( inputBlock, myColors, myMinimum, myDefaultColor, reinterpret_cast<QRgb*>( outputBlock->bits() ) );
+  }
+  else
+  {
+    for ( qgssize i = 0; i < ( qgssize )width*height; i++ )
     {
-      //opacity
-      double currentOpacity = mOpacity;
-      if ( mRasterTransparency )
-      {
-        currentOpacity = mRasterTransparency->alphaValue( val, mOpacity * 255 ) / 255.0;
-      }
-      if ( mAlphaBand > 0 )
+      if ( inputBlock->isNoData( i ) )
       {
-        currentOpacity *= alphaBlock->value( i ) / 255.0;
+        outputBlock->setColor( i, myDefaultColor );
+        continue;
       }
-
-      outputBlock->setColor( i, qRgba( currentOpacity * red, currentOpacity * green, currentOpacity * blue, currentOpacity * alpha ) );
+      outputBlock->setColor( i, pseudoColor( inputBlock->value( i ), mAlphaBand > 0 ? alphaBlock->value( i ) : 255, hasTransparency ) );
     }
   }
 
@@ -210,6 +192,41 @@ QgsRasterBlock* QgsSingleBandPseudoColorRenderer::block( int bandNo, QgsRectangl
   return outputBlock;
 }
 
+QRgb QgsSingleBandPseudoColorRenderer::pseudoColor( double val, double alphaVal, bool hasTransparency )
+{
+  int red, green, blue, alpha;
+  if ( !mShader->shade( val, &red, &green, &blue, &alpha ) )
+  {
+    return NODATA_COLOR;
+  }
+
+  if ( alpha < 255 )
+  {
+    // Working with premultiplied colors, so multiply values by alpha
+    red *= ( alpha / 255.0 );
+    blue *= ( alpha / 255.0 );
+    green *= ( alpha / 255.0 );
+  }
+
+  if ( !hasTransparency )
+  {
+    return qRgba( red, green, blue, alpha );
+  }
+
+  //opacity
+  double currentOpacity = mOpacity;
+  if ( mRasterTransparency )
+  {
+    currentOpacity = mRasterTransparency->alphaValue( val, mOpacity * 255 ) / 255.0;
+  }
+  if ( mAlphaBand > 0 )
+  {
+    currentOpacity *= alphaVal / 255.0;
+  }
+
+  return qRgba( currentOpacity * red, currentOpacity * green, currentOpacity * blue, currentOpacity * alpha );
+}
+
 void QgsSingleBandPseudoColorRenderer::writeXML( QDomDocument& doc, QDomElement& parentElem ) const
 {
   if ( parentElem.isNull() )
@@ -77,6 +77,13 @@ class CORE_EXPORT QgsSingleBandPseudoColorRenderer: public QgsRasterRenderer
     double mClassificationMax;
 
     int mClassificationMinMaxOrigin;
+
+    /** Returns the color of a value
+     * @param val value of the band
+     * @param alphaVal value of the alpha band, if an alpha band is used
+     * @param hasTransparency whether opacity and transparency are applied
+     */
+    QRgb pseudoColor( double val, double alphaVal, bool hasTransparency );
 };
 
 #endif // QGSSINGLEBANDPSEUDOCOLORRENDERER_H
@@ -25,6 +25,7 @@
 #include "qgsscaleexpression.h"
 #include "qgsdatadefined.h"
 
+#include "qgsaggregatecalculator.h"
 #include "qgsfeature.h"
 #include "qgsvectorlayer.h"
 #include "qgslogger.h"
@@ -623,7 +624,7 @@ static QList<double> _calcQuantileBreaks( QList<double> values, int classes )
   return breaks;
 }
 
-static QList<double> _calcStdDevBreaks( QList<double> values, int classes, QList<double> &labels )
+static QList<double> _calcStdDevBreaks( double mean, double stdDev, double minimum, double maximum, int classes, QList<double> &labels )
 {
 
   // C++ implementation of the standard deviation class interval algorithm
@@ -631,33 +632,7 @@ static QList<double> _calcStdDevBreaks( QList<double> values, int classes, QList
   // prgramming language.
 
   // Returns breaks based on 'prettyBreaks' of the centred and scaled
-  // values of 'values', and may have a number of classes different from 'classes'.
-
-  // If there are no values to process: bail out
-  if ( !values.count() )
-    return QList<double>();
-
-  double mean = 0.0;
-  double stdDev = 0.0;
-  int n = values.count();
-  double minimum = values[0];
-  double maximum = values[0];
-
-  for ( int i = 0; i < n; i++ )
-  {
-    mean += values[i];
-    minimum = qMin( values[i], minimum ); // could use precomputed max and min
-    maximum = qMax( values[i], maximum ); // but have to go through entire list anyway
-  }
-  mean = mean / ( double ) n;
-
-  double sd = 0.0;
-  for ( int i = 0; i < n; i++ )
-  {
-    sd = values[i] - mean;
-    stdDev += sd * sd;
-  }
-  stdDev = sqrt( stdDev / n );
+  // values, and may have a number of classes different from 'classes'.
 
   QList<double> breaks = QgsSymbolLayerV2Utils::prettyBreaks(( minimum - mean ) / stdDev, ( maximum - mean ) / stdDev, classes );
   for ( int i = 0; i < breaks.count(); i++ )
@@ -841,30 +816,19 @@ void QgsGraduatedSymbolRendererV2::updateClasses( QgsVectorLayer *vlayer, Mode m
   if ( nclasses < 1 )
     nclasses = 1;
 
-  QList<double> values;
-  bool valuesLoaded = false;
-  double minimum;
-  double maximum;
-
-  int attrNum = vlayer->fieldNameIndex( mAttrName );
+  // minimum, maximum and the moments need a single pass or a single query
+  QList<QgsAggregateCalculator::Aggregate> aggregates;
+  aggregates << QgsAggregateCalculator::Min << QgsAggregateCalculator::Max;
+  if ( mode == StdDev )
+    aggregates << QgsAggregateCalculator::Mean << QgsAggregateCalculator::StDev;
 
   bool ok;
-  if ( attrNum == -1 )
-  {
-    values = vlayer->getDoubleValues( mAttrName, ok );
-    if ( !ok || values.isEmpty() )
-      return;
+  QList<QVariant> stats = QgsAggregateCalculator( vlayer ).calculate( aggregates, mAttrName, &ok );
+  if ( !ok || stats.at( 0 ).isNull() )
+    return;
 
-    qSort( values ); // vmora: is wondering if O( n log(n) ) is really necessary here, min and max are O( n )
-    minimum = values.first();
-    maximum = values.last();
-    valuesLoaded = true;
-  }
-  else
-  {
-    minimum = vlayer->minimumValue( attrNum ).toDouble();
-    maximum = vlayer->maximumValue( attrNum ).toDouble();
-  }
+  double minimum = stats.at( 0 ).toDouble();
+  double maximum = stats.at( 1 ).toDouble();
 
   QgsDebugMsg( QString( "min %1 // max %2" ).arg( minimum ).arg( maximum ) );
   QList<double> breaks;
@@ -877,13 +841,14 @@ void QgsGraduatedSymbolRendererV2::updateClasses( QgsVectorLayer *vlayer, Mode m
   {
     breaks = QgsSymbolLayerV2Utils::prettyBreaks( minimum, maximum, nclasses );
   }
-  else if ( mode == Quantile || mode == Jenks || mode == StdDev )
+  else if ( mode == StdDev )
+  {
+    breaks = _calcStdDevBreaks( stats.at( 2 ).toDouble(), stats.at( 3 ).toDouble(), minimum, maximum, nclasses, labels );
+  }
+  else if ( mode == Quantile || mode == Jenks )
   {
     // get values from layer
-    if ( !valuesLoaded )
-    {
-      values = vlayer->getDoubleValues( mAttrName, ok );
-    }
+    QList<double> values = vlayer->getDoubleValues( mAttrName, ok );
 
     // calculate the breaks
     if ( mode == Quantile )
@@ -894,10 +859,6 @@ void QgsGraduatedSymbolRendererV2::updateClasses( QgsVectorLayer *vlayer, Mode m
     {
       breaks = _calcJenksBreaks( values, nclasses, minimum, maximum );
     }
-    else if ( mode == StdDev )
-    {
-      breaks = _calcStdDevBreaks( values, nclasses, labels );
-    }
   }
   else
   {
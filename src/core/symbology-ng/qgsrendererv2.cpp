@@ -443,19 +443,23 @@ void QgsFeatureRendererV2::renderFeatureWithSymbol( QgsFeature& feature, QgsSymb
 
     QgsPointV2 vertexPoint;
     QgsVertexId vertexId;
-    double x, y, z;
-    QPointF mapPoint;
+    QPolygonF vertices;
     while ( geom->geometry()->nextVertex( vertexId, vertexPoint ) )
     {
-      //transform
-      x = vertexPoint.x(); y = vertexPoint.y(); z = vertexPoint.z();
-      if ( ct )
-      {
-        ct->transformInPlace( x, y, z );
-      }
-      mapPoint.setX( x ); mapPoint.setY( y );
-      mtp.transformInPlace( mapPoint.rx(), mapPoint.ry() );
-      renderVertexMarker( mapPoint, context );
+      vertices << QPointF( vertexPoint.x(), vertexPoint.y() );
+    }
+
+    //transform all vertices at once
+    if ( ct )
+    {
+      ct->transformPolygon( vertices );
+    }
+
+    QPointF* ptr = vertices.data();
+    for ( int i = 0; i < vertices.size(); ++i, ++ptr )
+    {
+      mtp.transformInPlace( ptr->rx(), ptr->ry() );
+      renderVertexMarker( *ptr, context );
     }
   }
 
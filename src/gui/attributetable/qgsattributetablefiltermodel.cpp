@@ -93,6 +93,10 @@ bool QgsAttributeTableFilterModel::lessThan( const QModelIndex &left, const QMod
 
 void QgsAttributeTableFilterModel::sort( int column, Qt::SortOrder order )
 {
+  // the rows fetched later would only be sorted among themselves. The provider is not asked
+  // to sort the pages, its collation may differ from lessThan() and misplace later pages.
+  if ( column >= 0 )
+    masterModel()->fetchAllRows();
   masterModel()->prefetchColumnData( column );
   QSortFilterProxyModel::sort( column, order );
 }
@@ -116,6 +120,8 @@ void QgsAttributeTableFilterModel::setSourceModel( QgsAttributeTableModel* sourc
   mTableModel = sourceModel;
 
   QSortFilterProxyModel::setSourceModel( sourceModel );
+
+  connect( sourceModel, SIGNAL( modelReset() ), this, SLOT( sourceModelReset() ) );
 }
 
 bool QgsAttributeTableFilterModel::selectedOnTop()
@@ -145,6 +151,10 @@ void QgsAttributeTableFilterModel::setFilterMode( FilterMode filterMode )
 {
   if ( filterMode != mFilterMode )
   {
+    // rows which are not fetched yet could match the filter
+    if ( filterMode != ShowAll )
+      masterModel()->fetchAllRows();
+
     if ( filterMode == ShowVisible )
     {
       connect( mCanvas, SIGNAL( extentsChanged() ), this, SLOT( extentsChanged() ) );
@@ -223,6 +233,12 @@ void QgsAttributeTableFilterModel::selectionChanged()
   }
 }
 
+void QgsAttributeTableFilterModel::sourceModelReset()
+{
+  if ( mFilterMode != ShowAll || sortColumn() >= 0 )
+    masterModel()->fetchAllRows();
+}
+
 void QgsAttributeTableFilterModel::generateListOfVisibleFeatures()
 {
   if ( !layer() )
@@ -144,7 +144,9 @@ class GUI_EXPORT QgsAttributeTableFilterModel: public QSortFilterProxyModel, pub
 
     /**
      * Sort by the given column using the given order.
-     * Prefetches all the data from the layer to speed up sorting.
+     * Fetches all the rows and prefetches the data of the column from the layer to speed up sorting.
+     * The rows are sorted here and not by the provider, also if the master model fetches rows
+     * on demand, as the order of the provider may differ from the comparison of this model.
      *
      * @param column The column which should be sorted
      * @param order  The order ( Qt::AscendingOrder or Qt::DescendingOrder )
@@ -183,6 +185,12 @@ class GUI_EXPORT QgsAttributeTableFilterModel: public QSortFilterProxyModel, pub
   private slots:
     void selectionChanged();
 
+    /**
+     * Fetches all the rows of the reloaded master model if they are needed
+     * to sort or filter the table.
+     */
+    void sourceModelReset();
+
   private:
     QgsFeatureIds mFilteredFeatures;
     QgsMapCanvas* mCanvas;
@@ -29,6 +29,7 @@
 #include "qgsrendererv2.h"
 #include "qgsvectorlayer.h"
 #include "qgsvectordataprovider.h"
+#include "qgsvectorlayereditbuffer.h"
 #include "qgssymbollayerv2utils.h"
 
 #include <QVariant>
@@ -39,6 +40,12 @@ QgsAttributeTableModel::QgsAttributeTableModel( QgsVectorLayerCache *layerCache,
     : QAbstractTableModel( parent )
     , mLayerCache( layerCache )
     , mFieldCount( 0 )
+    , mRowsPending( false )
+    , mHasLastPageId( false )
+    , mLastPageId( 0 )
+    , mPendingIdsRead( false )
+    , mFetchRowsOnDemand( false )
+    , mLastLoadedRow( 0 )
     , mCachedField( -1 )
 {
   QgsDebugMsg( "entered." );
@@ -80,6 +87,28 @@ bool QgsAttributeTableModel::loadFeatureAtId( QgsFeatureId fid ) const
   return mLayerCache->featureAtId( fid, mFeat );
 }
 
+void QgsAttributeTableModel::prefetchRows( int row ) const
+{
+  // number of rows fetched at once and distance from the last fetched row to fetch again
+  const int prefetchCount = 500;
+  const int prefetchDistance = 100;
+
+  int step = row >= mLastLoadedRow ? 1 : -1;
+  mLastLoadedRow = row;
+
+  if ( mLayerCache->isPrefetching() || mRowIdMap.isEmpty() )
+    return;
+
+  int ahead = qBound( 0, row + step * prefetchDistance, mRowIdMap.size() - 1 );
+  if ( mLayerCache->isFidCached( rowToId( ahead ) ) )
+    return;
+
+  QgsFeatureIds fids;
+  for ( int r = row + step; r >= 0 && r < mRowIdMap.size() && fids.size() < prefetchCount; r += step )
+    fids << rowToId( r );
+  mLayerCache->prefetchFeatures( fids );
+}
+
 void QgsAttributeTableModel::featuresDeleted( const QgsFeatureIds& fids )
 {
   QList<int> rows;
@@ -93,6 +122,10 @@ void QgsAttributeTableModel::featuresDeleted( const QgsFeatureIds& fids )
       rows << row;
   }
 
+  // features which are not fetched yet have no rows
+  if ( rows.isEmpty() )
+    return;
+
   qSort( rows );
 
   int lastRow = -1;
@@ -236,6 +269,9 @@ void QgsAttributeTableModel::layerDeleted()
 {
   QgsDebugMsg( "entered." );
 
+  mRowsPending = false;
+  mPendingIdsRead = false;
+  mPendingIds.clear();
   removeRows( 0, rowCount() );
 
   mAttributeWidgetCaches.clear();
@@ -357,36 +393,207 @@ void QgsAttributeTableModel::loadLayer()
     removeRows( 0, rowCount() );
   }
 
-  QgsFeatureIterator features = mLayerCache->getFeatures( mFeatureRequest );
+  mRowsPending = true;
+  mHasLastPageId = false;
+  mPendingIdsRead = false;
+  mPendingIds.clear();
+
+  connect( mLayerCache, SIGNAL( invalidated() ), this, SLOT( loadLayer() ), Qt::UniqueConnection );
+
+  endResetModel();
+
+  // a sorted table needs all the rows, a fully cached layer has them at hand and
+  // feature id filters select few rows anyway
+  if ( mFetchRowsOnDemand && mCachedField == -1 && !mLayerCache->hasFullCache() &&
+       mFeatureRequest.filterType() != QgsFeatureRequest::FilterFid &&
+       mFeatureRequest.filterType() != QgsFeatureRequest::FilterFids )
+  {
+    fetchMore( QModelIndex() );
+  }
+  else
+  {
+    fetchAllRows();
+  }
+}
 
-  int i = 0;
+QgsFeatureRequest QgsAttributeTableModel::rowRequest() const
+{
+  QgsFeatureRequest request( mFeatureRequest );
 
+  const QgsFields& fields = layer()->fields();
+  QgsAttributeList attributes;
+  bool needsGeometry = request.flags().testFlag( QgsFeatureRequest::ExactIntersect );
+
+  if ( request.filterType() == QgsFeatureRequest::FilterExpression )
+  {
+    Q_FOREACH ( const QString& column, request.filterExpression()->referencedColumns() )
+    {
+      int idx = fields.fieldNameIndex( column );
+      if ( idx == -1 )
+        return request;
+      attributes << idx;
+    }
+    needsGeometry = needsGeometry || request.filterExpression()->needsGeometry();
+  }
+
+  if ( mCachedField != -1 )
+    attributes << mCachedField;
+
+  request.setSubsetOfAttributes( attributes );
+  if ( !needsGeometry )
+    request.setFlags( request.flags() | QgsFeatureRequest::NoGeometry );
+
+  return request;
+}
+
+QgsFeatureRequest QgsAttributeTableModel::pageRequest( int count ) const
+{
+  QgsFeatureRequest request = rowRequest();
+  request.setOrderBy( QgsFeatureRequest::OrderBy() << QgsFeatureRequest::OrderByClause( "$id" ) );
+  request.setLimit( count );
+
+  if ( mHasLastPageId )
+  {
+    QString resume = QString( "$id > %1" ).arg( mLastPageId );
+    if ( request.filterType() == QgsFeatureRequest::FilterExpression )
+      request.setFilterExpression( QString( "(%1) AND %2" ).arg( request.filterExpression()->expression(), resume ) );
+    else
+      request.setFilterExpression( resume );
+  }
+
+  return request;
+}
+
+int QgsAttributeTableModel::readRowIds( QgsFeatureIterator& it, QList<QgsFeatureId>& ids, bool progress )
+{
   QTime t;
   t.start();
 
   QgsFeature feat;
-  while ( features.nextFeature( feat ) )
+  bool cancel = false;
+  int read = 0;
+  while ( it.nextFeature( feat ) )
   {
-    ++i;
+    ++read;
+    mLastPageId = feat.id();
+    mHasLastPageId = true;
 
-    if ( t.elapsed() > 1000 )
+    ids << feat.id();
+    if ( mCachedField != -1 )
+      mFieldCache[ feat.id()] = feat.attribute( mCachedField );
+
+    if ( progress && t.elapsed() > 1000 )
     {
-      bool cancel = false;
-      emit progress( i, cancel );
+      emit progress( mRowIdMap.size() + ids.size(), cancel );
       if ( cancel )
         break;
 
       t.restart();
     }
-    mFeat = feat;
-    featureAdded( feat.id() );
   }
+  it.close();
+
+  return read;
+}
+
+void QgsAttributeTableModel::fetchRows( int count )
+{
+  if ( !mRowsPending )
+    return;
+
+  // Pages only read the ids, avoiding to pull every feature through the cache. The
+  // attributes are read once the rows are shown. The remaining rows are read at once,
+  // rows of previous pages are skipped.
+  QList<QgsFeatureId> ids;
+  if ( count >= 0 && !mPendingIdsRead )
+  {
+    QgsFeatureIterator it = layer()->getFeatures( pageRequest( count ) );
+    if ( it.hasNativeLimit() )
+    {
+      // a page which is not full was the last one
+      mRowsPending = readRowIds( it, ids, false ) == count;
+    }
+    else
+    {
+      // Without ordering and filtering by id in the provider, every page would read and sort
+      // all the features. The ids are read in one pass instead and appended page by page.
+      it.close();
+      it = layer()->getFeatures( rowRequest() );
+      readRowIds( it, mPendingIds, false );
+      mPendingIdsRead = true;
+    }
+  }
+  else if ( !mPendingIdsRead )
+  {
+    QgsFeatureIterator it;
+    if ( mFetchRowsOnDemand && !mLayerCache->hasFullCache() )
+      it = layer()->getFeatures( rowRequest() );
+    else
+      it = mLayerCache->getFeatures( mFeatureRequest );
 
-  emit finished();
+    readRowIds( it, ids, true );
+    mRowsPending = false;
+  }
 
-  connect( mLayerCache, SIGNAL( invalidated() ), this, SLOT( loadLayer() ), Qt::UniqueConnection );
+  if ( mPendingIdsRead )
+  {
+    int n = count >= 0 ? qMin( count, mPendingIds.size() ) : mPendingIds.size();
+    ids = mPendingIds.mid( 0, n );
+    mPendingIds = mPendingIds.mid( n );
+    mRowsPending = !mPendingIds.isEmpty();
+  }
 
-  endResetModel();
+  // features deleted since the rows were fetched may still be returned
+  QgsVectorLayerEditBuffer* editBuffer = layer()->editBuffer();
+  QgsFeatureIds deletedIds = editBuffer ? editBuffer->deletedFeatureIds() : QgsFeatureIds();
+
+  int n = mRowIdMap.size();
+  int last = n - 1;
+  Q_FOREACH ( QgsFeatureId fid, ids )
+  {
+    // features added while fetching are already in the table
+    if ( !mIdRowMap.contains( fid ) && !deletedIds.contains( fid ) )
+      ++last;
+  }
+
+  if ( last >= n )
+  {
+    beginInsertRows( QModelIndex(), n, last );
+
+    Q_FOREACH ( QgsFeatureId fid, ids )
+    {
+      if ( mIdRowMap.contains( fid ) || deletedIds.contains( fid ) )
+        continue;
+
+      mIdRowMap.insert( fid, n );
+      mRowIdMap.insert( n, fid );
+      ++n;
+    }
+
+    endInsertRows();
+  }
+
+  if ( count < 0 )
+    emit finished();
+}
+
+bool QgsAttributeTableModel::canFetchMore( const QModelIndex &parent ) const
+{
+  return !parent.isValid() && mRowsPending;
+}
+
+void QgsAttributeTableModel::fetchMore( const QModelIndex &parent )
+{
+  // number of rows fetched at once
+  const int fetchCount = 1000;
+
+  if ( !parent.isValid() )
+    fetchRows( fetchCount );
+}
+
+void QgsAttributeTableModel::fetchAllRows()
+{
+  fetchRows( -1 );
 }
 
 void QgsAttributeTableModel::fieldConditionalStyleChanged( const QString &fieldName )
@@ -489,6 +696,15 @@ int QgsAttributeTableModel::rowCount( const QModelIndex &parent ) const
   return mRowIdMap.size();
 }
 
+int QgsAttributeTableModel::totalRowCount() const
+{
+  if ( !mRowsPending || mFeatureRequest.filterType() != QgsFeatureRequest::FilterNone || !layer() )
+    return rowCount();
+
+  long count = layer()->featureCount();
+  return count < 0 ? rowCount() : ( int ) count;
+}
+
 int QgsAttributeTableModel::columnCount( const QModelIndex &parent ) const
 {
   Q_UNUSED( parent );
@@ -573,7 +789,7 @@ QVariant QgsAttributeTableModel::data( const QModelIndex &index, int role ) cons
   QVariant val;
 
   // if we don't have the row in current cache, load it from layer first
-  if ( mCachedField == fieldId )
+  if ( mCachedField == fieldId && mFieldCache.contains( rowId ) )
   {
     val = mFieldCache[ rowId ];
   }
@@ -581,6 +797,8 @@ QVariant QgsAttributeTableModel::data( const QModelIndex &index, int role ) cons
   {
     if ( mFeat.id() != rowId || !mFeat.isValid() )
     {
+      prefetchRows( index.row() );
+
       if ( !loadFeatureAtId( rowId ) )
         return QVariant( "ERROR" );
 
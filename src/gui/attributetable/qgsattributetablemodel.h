@@ -70,6 +70,14 @@ class GUI_EXPORT QgsAttributeTableModel: public QAbstractTableModel
      */
     virtual int rowCount( const QModelIndex &parent = QModelIndex() ) const override;
 
+    /**
+     * Returns the number of rows the model will have once all rows are fetched.
+     * If rows are fetched on demand and the request does not filter features, this
+     * is the feature count reported by the layer, otherwise the number of rows loaded.
+     * @note added in 2.12
+     */
+    int totalRowCount() const;
+
     /**
      * Returns the number of columns
      * @param parent parent index
@@ -222,6 +230,44 @@ class GUI_EXPORT QgsAttributeTableModel: public QAbstractTableModel
      */
     const QgsAttributeEditorContext& editorContext() const { return mEditorContext; }
 
+    /**
+     * Sets whether rows are fetched on demand. If enabled, loadLayer() only reads the
+     * ids of the first rows and further rows are read when a view scrolls to the end
+     * of the table, so that large layers are shown without reading every feature first.
+     * Sorting or filtering the table still fetches all the rows.
+     * Disabled by default.
+     *
+     * @param onDemand true to fetch rows on demand
+     * @note added in 2.12
+     */
+    void setFetchRowsOnDemand( bool onDemand ) { mFetchRowsOnDemand = onDemand; }
+
+    /**
+     * Returns whether rows are fetched on demand.
+     * @see setFetchRowsOnDemand()
+     * @note added in 2.12
+     */
+    bool fetchRowsOnDemand() const { return mFetchRowsOnDemand; }
+
+    /**
+     * Returns true if there are rows which have not been fetched yet.
+     * @param parent parent index
+     */
+    virtual bool canFetchMore( const QModelIndex &parent ) const override;
+
+    /**
+     * Fetches the next batch of rows.
+     * @param parent parent index
+     */
+    virtual void fetchMore( const QModelIndex &parent ) override;
+
+    /**
+     * Fetches all the rows which have not been fetched yet. Needed before sorting or
+     * filtering the whole table. Emits progress() if this takes long.
+     * @note added in 2.12
+     */
+    void fetchAllRows();
+
   public slots:
     /**
      * Loads the layer into the model
@@ -319,8 +365,63 @@ class GUI_EXPORT QgsAttributeTableModel: public QAbstractTableModel
      */
     virtual bool loadFeatureAtId( QgsFeatureId fid ) const;
 
+    /**
+     * Starts loading the rows ahead of the given row in the direction the table
+     * is being scrolled into the layer cache in the background
+     *
+     * @param  row     the row which is being displayed
+     */
+    void prefetchRows( int row ) const;
+
+    /**
+     * Returns the request used to read the ids of the rows fetched on demand, it
+     * only fetches the attributes and geometry needed to filter and sort the rows.
+     */
+    QgsFeatureRequest rowRequest() const;
+
+    /**
+     * Returns the request reading the next page of rows. Pages are read in the order of
+     * the feature ids and each one starts after the last id of the previous page, so that
+     * no iterator (and no pooled provider connection) is kept open between pages.
+     * Only used if the provider orders, filters and limits the features itself.
+     *
+     * @param  count   the number of rows of the page
+     */
+    QgsFeatureRequest pageRequest( int count ) const;
+
+    /**
+     * Reads the ids of the features returned by an iterator
+     *
+     * @param  it        the iterator to read
+     * @param  ids       the list the ids are appended to
+     * @param  progress  emit progress() if reading takes long, and stop if it is canceled
+     * @return the number of features read
+     */
+    int readRowIds( QgsFeatureIterator& it, QList<QgsFeatureId>& ids, bool progress );
+
+    /**
+     * Appends rows which have not been fetched yet
+     *
+     * @param  count   the maximum number of rows to append, -1 to append all
+     */
+    void fetchRows( int count );
+
     QgsFeatureRequest mFeatureRequest;
 
+    /** True if there are rows which have not been fetched yet */
+    bool mRowsPending;
+    /** True if a page of rows has been fetched, whose last feature id is mLastPageId */
+    bool mHasLastPageId;
+    QgsFeatureId mLastPageId;
+    /** True if the ids of all the rows have been read at once, the rows are then appended from mPendingIds */
+    bool mPendingIdsRead;
+    /** Ids read at once whose rows have not been appended yet */
+    QList<QgsFeatureId> mPendingIds;
+    bool mFetchRowsOnDemand;
+
+    /** The last row loaded, used to find out the direction of scrolling */
+    mutable int mLastLoadedRow;
+
     /** The currently cached column */
     int mCachedField;
     /** Allows caching of one specific column (used for sorting) */
@@ -219,6 +219,10 @@ void QgsDualView::initLayerCache( QgsVectorLayer* layer, bool cacheGeometry )
   int cacheSize = settings.value( "/qgis/attributeTableRowCache", "10000" ).toInt();
   mLayerCache = new QgsVectorLayerCache( layer, cacheSize, this );
   mLayerCache->setCacheGeometry( cacheGeometry );
+  // optional limit of the memory used by the cache in MB, replaces the row limit
+  int cacheMemory = settings.value( "/qgis/attributeTableCacheMemory", 0 ).toInt();
+  if ( cacheMemory > 0 )
+    mLayerCache->setCacheMemoryLimit(( qint64 ) cacheMemory * 1024 * 1024 );
   if ( 0 == cacheSize || 0 == ( QgsVectorDataProvider::SelectAtId & mLayerCache->layer()->dataProvider()->capabilities() ) )
   {
     connect( mLayerCache, SIGNAL( progress( int, bool & ) ), this, SLOT( progress( int, bool & ) ) );
@@ -237,6 +241,7 @@ void QgsDualView::initModels( QgsMapCanvas* mapCanvas, const QgsFeatureRequest&
   mMasterModel = new QgsAttributeTableModel( mLayerCache, this );
   mMasterModel->setRequest( request );
   mMasterModel->setEditorContext( mEditorContext );
+  mMasterModel->setFetchRowsOnDemand( true );
 
   connect( mMasterModel, SIGNAL( progress( int, bool & ) ), this, SLOT( progress( int, bool & ) ) );
   connect( mMasterModel, SIGNAL( finished() ), this, SLOT( finished() ) );
@@ -338,11 +343,15 @@ void QgsDualView::previewColumnChanged( QObject* action )
 
 int QgsDualView::featureCount()
 {
-  return mMasterModel->rowCount();
+  return mMasterModel->totalRowCount();
 }
 
 int QgsDualView::filteredFeatureCount()
 {
+  // all the rows are fetched if they are filtered
+  if ( mFilterModel->filterMode() == QgsAttributeTableFilterModel::ShowAll )
+    return mMasterModel->totalRowCount();
+
   return mFilterModel->rowCount();
 }
 
@@ -255,8 +255,6 @@ bool QgsDelimitedTextFeatureIterator::wantGeometry( QgsGeometry *geom ) const
 
 bool QgsDelimitedTextFeatureIterator::nextFeatureInternal( QgsFeature& feature )
 {
-  QStringList tokens;
-
   QgsDelimitedTextFile *file = mSource->mFile;
 
   // If the iterator is not scanning the file, then it will have requested a specific
@@ -275,19 +273,16 @@ bool QgsDelimitedTextFeatureIterator::nextFeatureInternal( QgsFeature& feature )
 
     feature.setValid( false );
 
-    QgsDelimitedTextFile::Status status = file->nextRecord( tokens );
+    QgsDelimitedTextFile::Status status = file->nextRecord( mRecord );
     if ( status == QgsDelimitedTextFile::RecordEOF ) break;
     if ( status != QgsDelimitedTextFile::RecordOk ) continue;
 
     // We ignore empty records, such as added randomly by spreadsheets
 
-    if ( QgsDelimitedTextProvider::recordIsEmpty( tokens ) ) continue;
+    if ( mRecord.isEmpty() ) continue;
 
     QgsFeatureId fid = file->recordId();
 
-    while ( tokens.size() < mSource->mFieldCount )
-      tokens.append( QString::null );
-
     QgsGeometry *geom = 0;
 
     // Load the geometry if required
@@ -297,11 +292,11 @@ bool QgsDelimitedTextFeatureIterator::nextFeatureInternal( QgsFeature& feature )
       bool nullGeom = false;
       if ( mSource->mGeomRep == QgsDelimitedTextProvider::GeomAsWkt )
       {
-        geom = loadGeometryWkt( tokens, nullGeom );
+        geom = loadGeometryWkt( mRecord, nullGeom );
       }
       else if ( mSource->mGeomRep == QgsDelimitedTextProvider::GeomAsXy )
       {
-        geom = loadGeometryXY( tokens, nullGeom );
+        geom = loadGeometryXY( mRecord, nullGeom );
       }
 
       if (( !geom && !nullGeom ) || ( nullGeom && mTestGeometry ) )
@@ -332,13 +327,13 @@ bool QgsDelimitedTextFeatureIterator::nextFeatureInternal( QgsFeature& feature )
       for ( QgsAttributeList::const_iterator i = attrs.begin(); i != attrs.end(); ++i )
       {
         int fieldIdx = *i;
-        fetchAttribute( feature, fieldIdx, tokens );
+        fetchAttribute( feature, fieldIdx, mRecord );
       }
     }
     else
     {
       for ( int idx = 0; idx < mSource->mFields.count(); ++idx )
-        fetchAttribute( feature, idx, tokens );
+        fetchAttribute( feature, idx, mRecord );
     }
 
     // If the iterator hasn't already filtered out the subset, then do it now
@@ -366,10 +361,10 @@ bool QgsDelimitedTextFeatureIterator::setNextFeatureId( qint64 fid )
 
 
 
-QgsGeometry* QgsDelimitedTextFeatureIterator::loadGeometryWkt( const QStringList& tokens, bool &isNull )
+QgsGeometry* QgsDelimitedTextFeatureIterator::loadGeometryWkt( const QgsDelimitedTextRecord& record, bool &isNull )
 {
   QgsGeometry* geom = 0;
-  QString sWkt = tokens[mSource->mWktFieldIndex];
+  QString sWkt = record.string( mSource->mWktFieldIndex );
   if ( sWkt.isEmpty() )
   {
     isNull = true;
@@ -392,18 +387,16 @@ QgsGeometry* QgsDelimitedTextFeatureIterator::loadGeometryWkt( const QStringList
   return geom;
 }
 
-QgsGeometry* QgsDelimitedTextFeatureIterator::loadGeometryXY( const QStringList& tokens, bool &isNull )
+QgsGeometry* QgsDelimitedTextFeatureIterator::loadGeometryXY( const QgsDelimitedTextRecord& record, bool &isNull )
 {
-  QString sX = tokens[mSource->mXFieldIndex];
-  QString sY = tokens[mSource->mYFieldIndex];
-  if ( sX.isEmpty() && sY.isEmpty() )
+  if ( record.isFieldEmpty( mSource->mXFieldIndex ) && record.isFieldEmpty( mSource->mYFieldIndex ) )
   {
     isNull = true;
     return 0;
   }
   isNull = false;
   QgsPoint pt;
-  bool ok = QgsDelimitedTextProvider::pointFromXY( sX, sY, pt, mSource->mDecimalPoint, mSource->mXyDms );
+  bool ok = QgsDelimitedTextProvider::pointFromXY( record, mSource->mXFieldIndex, mSource->mYFieldIndex, pt, mSource->mDecimalPoint, mSource->mXyDms );
 
   if ( ok && wantGeometry( pt ) )
   {
@@ -414,20 +407,19 @@ QgsGeometry* QgsDelimitedTextFeatureIterator::loadGeometryXY( const QStringList&
 
 
 
-void QgsDelimitedTextFeatureIterator::fetchAttribute( QgsFeature& feature, int fieldIdx, const QStringList& tokens )
+void QgsDelimitedTextFeatureIterator::fetchAttribute( QgsFeature& feature, int fieldIdx, const QgsDelimitedTextRecord& record )
 {
   if ( fieldIdx < 0 || fieldIdx >= mSource->attributeColumns.count() ) return;
   int column = mSource->attributeColumns[fieldIdx];
-  if ( column < 0 || column >= tokens.count() ) return;
-  const QString &value = tokens[column];
+  // Records with fewer fields than the file are padded with null fields
+  if ( column < 0 || column >= qMax( record.size(), mSource->mFieldCount ) ) return;
   QVariant val;
   switch ( mSource->mFields.at( fieldIdx ).type() )
   {
     case QVariant::Int:
     {
       int ivalue = 0;
-      bool ok = false;
-      if ( ! value.isEmpty() ) ivalue = value.toInt( &ok );
+      bool ok = record.toInt( column, ivalue );
       if ( ok )
         val = QVariant( ivalue );
       else
@@ -437,18 +429,7 @@ void QgsDelimitedTextFeatureIterator::fetchAttribute( QgsFeature& feature, int f
     case QVariant::Double:
     {
       double dvalue = 0.0;
-      bool ok = false;
-      if ( ! value.isEmpty() )
-      {
-        if ( mSource->mDecimalPoint.isEmpty() )
-        {
-          dvalue = value.toDouble( &ok );
-        }
-        else
-        {
-          dvalue = QString( value ).replace( mSource->mDecimalPoint, "." ).toDouble( &ok );
-        }
-      }
+      bool ok = record.toDouble( column, dvalue, mSource->mDecimalPoint );
       if ( ok )
       {
         val = QVariant( dvalue );
@@ -460,7 +441,7 @@ void QgsDelimitedTextFeatureIterator::fetchAttribute( QgsFeature& feature, int f
       break;
     }
     default:
-      val = QVariant( value );
+      val = QVariant( record.string( column ) );
       break;
   }
   feature.setAttribute( fieldIdx, val );
@@ -491,6 +472,7 @@ QgsDelimitedTextFeatureSource::QgsDelimitedTextFeatureSource( const QgsDelimited
 {
   mFile = new QgsDelimitedTextFile();
   mFile->setFromUrl( p->mFile->url() );
+  mFile->setLineIndex( p->mFile->lineIndex(), p->mFile->lineIndexFileSize() );
 
   mExpressionContext << QgsExpressionContextUtils::globalScope()
   << QgsExpressionContextUtils::projectScope();
@@ -86,10 +86,12 @@ class QgsDelimitedTextFeatureIterator : public QgsAbstractFeatureIteratorFromSou
     bool setNextFeatureId( qint64 fid );
 
     bool nextFeatureInternal( QgsFeature& feature );
-    QgsGeometry* loadGeometryWkt( const QStringList& tokens, bool &isNull );
-    QgsGeometry* loadGeometryXY( const QStringList& tokens, bool &isNull );
-    void fetchAttribute( QgsFeature& feature, int fieldIdx, const QStringList& tokens );
+    QgsGeometry* loadGeometryWkt( const QgsDelimitedTextRecord& record, bool &isNull );
+    QgsGeometry* loadGeometryXY( const QgsDelimitedTextRecord& record, bool &isNull );
+    void fetchAttribute( QgsFeature& feature, int fieldIdx, const QgsDelimitedTextRecord& record );
 
+    //! Current record, reused to avoid reallocating its buffers
+    QgsDelimitedTextRecord mRecord;
     QList<QgsFeatureId> mFeatureIds;
     IteratorMode mMode;
     long mNextId;
@@ -19,6 +19,8 @@
 #include "qgslogger.h"
 
 #include <QtGlobal>
+#include <QtAlgorithms>
+#include <QtConcurrentMap>
 #include <QFile>
 #include <QFileInfo>
 #include <QDataStream>
@@ -27,15 +29,252 @@
 #include <QTextCodec>
 #include <QStringList>
 #include <QRegExp>
+#include <QThread>
 #include <QUrl>
 
+#include <cstring>
+#include <limits>
+
+// Nominal size of the chunks scanned in parallel by scanRecords()
+static const qint64 SCAN_CHUNK_SIZE = 4 * 1024 * 1024;
+
+// Number of lines between the entries of the line index of a mapped file
+static const long LINE_INDEX_STEP = 256;
+
+static bool lineOffsetLessThan( const QgsDelimitedTextFile::LineOffset &a, const QgsDelimitedTextFile::LineOffset &b )
+{
+  return a.line < b.line;
+}
+
+// Parse an integer of the form [-]digits with at most 18 digits, so that it cannot
+// overflow.  Returns false for any other form, which is left to QString to convert.
+static bool parsePlainInteger( const char *s, int length, qint64 &value )
+{
+  const char *end = s + length;
+  bool negative = s < end && *s == '-';
+  if ( negative ) s++;
+  if ( s == end || end - s > 18 ) return false;
+  qint64 v = 0;
+  for ( ; s < end; s++ )
+  {
+    unsigned int digit = static_cast<unsigned char>( *s ) - '0';
+    if ( digit > 9 ) return false;
+    v = v * 10 + digit;
+  }
+  value = negative ? -v : v;
+  return true;
+}
+
+// Parse a number of the form [-]digits[.digits][e[+-]digits] with at most 15
+// significant digits and a decimal exponent within +/-22.  The mantissa and the
+// power of ten are then exact doubles, so that a single multiplication or
+// division gives the correctly rounded value.  Returns false for any other
+// form, which is left to QString to convert.
+static bool parsePlainDouble( const char *s, int length, int decimalPoint, double &value )
+{
+  static const double powers[] =
+  {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+
+  const char *end = s + length;
+  bool negative = s < end && *s == '-';
+  if ( negative ) s++;
+
+  quint64 mantissa = 0;
+  int digits = 0;
+  int intDigits = 0;
+  int fracDigits = 0;
+  int exponent = 0;
+  bool point = false;
+  for ( ; s < end; s++ )
+  {
+    unsigned char c = *s;
+    if ( c >= '0' && c <= '9' )
+    {
+      if ( point ) fracDigits++; else intDigits++;
+      if ( mantissa == 0 && c == '0' )
+      {
+        if ( point ) exponent--;
+        continue;
+      }
+      if ( ++digits > 15 ) return false;
+      mantissa = mantissa * 10 + ( c - '0' );
+      if ( point ) exponent--;
+    }
+    else if (( c == '.' || c == decimalPoint ) && ! point )
+    {
+      point = true;
+    }
+    else
+    {
+      break;
+    }
+  }
+  if ( intDigits == 0 || ( point && fracDigits == 0 ) ) return false;
+
+  if ( s < end )
+  {
+    if ( *s != 'e' && *s != 'E' ) return false;
+    s++;
+    bool negativeExponent = s < end && ( *s == '-' || *s == '+' );
+    if ( negativeExponent ) negativeExponent = *s++ == '-';
+    if ( s == end ) return false;
+    int e = 0;
+    for ( ; s < end; s++ )
+    {
+      unsigned int digit = static_cast<unsigned char>( *s ) - '0';
+      if ( digit > 9 ) return false;
+      if ( e < 10000 ) e = e * 10 + digit;
+    }
+    exponent += negativeExponent ? -e : e;
+  }
+
+  double v = static_cast<double>( mantissa );
+  if ( mantissa != 0 )
+  {
+    if ( exponent < -22 || exponent > 22 ) return false;
+    v = exponent < 0 ? v / powers[-exponent] : v * powers[exponent];
+  }
+  value = negative ? -v : v;
+  return true;
+}
+
+QgsDelimitedTextRecord::QgsDelimitedTextRecord()
+    : mUsed( 0 )
+    , mCodec( 0 )
+    , mHasStrings( false )
+{
+  // Reserved vectors keep their capacity when cleared
+  mFields.reserve( 32 );
+}
+
+void QgsDelimitedTextRecord::clear()
+{
+  mUsed = 0;
+  mFields.resize( 0 );
+  mStrings.clear();
+  mHasStrings = false;
+}
+
+char *QgsDelimitedTextRecord::reserve( int count )
+{
+  if ( mData.size() < mUsed + count )
+    mData.resize( qMax( mUsed + count, 2 * mData.size() ) );
+  return mData.data();
+}
+
+void QgsDelimitedTextRecord::setStrings( const QStringList &strings )
+{
+  clear();
+  mStrings = strings;
+  mHasStrings = true;
+}
+
+bool QgsDelimitedTextRecord::isEmpty() const
+{
+  for ( int i = 0; i < size(); i++ )
+  {
+    if ( ! isFieldEmpty( i ) ) return false;
+  }
+  return true;
+}
+
+bool QgsDelimitedTextRecord::isFieldEmpty( int i ) const
+{
+  if ( mHasStrings ) return i < 0 || i >= mStrings.size() || mStrings.at( i ).isEmpty();
+  return i < 0 || i >= mFields.size() || mFields.at( i ).length == 0;
+}
+
+QString QgsDelimitedTextRecord::string( int i ) const
+{
+  if ( mHasStrings ) return i >= 0 && i < mStrings.size() ? mStrings.at( i ) : QString();
+  if ( i < 0 || i >= mFields.size() ) return QString();
+  const Field &field = mFields.at( i );
+  if ( field.null ) return QString();
+  if ( field.length == 0 ) return QString( "" );
+  return mCodec->toUnicode( mData.constData() + field.start, field.length );
+}
+
+QStringList QgsDelimitedTextRecord::strings() const
+{
+  if ( mHasStrings ) return mStrings;
+  QStringList result;
+  for ( int i = 0; i < mFields.size(); i++ )
+    result.append( string( i ) );
+  return result;
+}
+
+bool QgsDelimitedTextRecord::toInt( int i, int &value ) const
+{
+  if ( isFieldEmpty( i ) ) return false;
+  if ( ! mHasStrings )
+  {
+    const Field &field = mFields.at( i );
+    qint64 v;
+    if ( parsePlainInteger( mData.constData() + field.start, field.length, v ) )
+    {
+      if ( v < std::numeric_limits<int>::min() || v > std::numeric_limits<int>::max() ) return false;
+      value = static_cast<int>( v );
+      return true;
+    }
+  }
+  bool ok;
+  value = string( i ).toInt( &ok );
+  return ok;
+}
+
+bool QgsDelimitedTextRecord::toLongLong( int i, qlonglong &value ) const
+{
+  if ( isFieldEmpty( i ) ) return false;
+  if ( ! mHasStrings )
+  {
+    const Field &field = mFields.at( i );
+    qint64 v;
+    if ( parsePlainInteger( mData.constData() + field.start, field.length, v ) )
+    {
+      value = v;
+      return true;
+    }
+  }
+  bool ok;
+  value = string( i ).toLongLong( &ok );
+  return ok;
+}
+
+bool QgsDelimitedTextRecord::toDouble( int i, double &value, const QString &decimalPoint ) const
+{
+  if ( isFieldEmpty( i ) ) return false;
+  if ( ! mHasStrings && decimalPoint.size() <= 1 )
+  {
+    const Field &field = mFields.at( i );
+    int point = decimalPoint.isEmpty() ? -1 : decimalPoint.at( 0 ).unicode();
+    if ( point < 0x80 && parsePlainDouble( mData.constData() + field.start, field.length, point, value ) )
+      return true;
+  }
+  bool ok;
+  QString s = string( i );
+  if ( ! decimalPoint.isEmpty() ) s.replace( decimalPoint, "." );
+  value = s.toDouble( &ok );
+  return ok;
+}
+
 
 QgsDelimitedTextFile::QgsDelimitedTextFile( QString url ) :
     mFileName( QString() ),
     mEncoding( "UTF-8" ),
     mFile( 0 ),
     mStream( 0 ),
-    mUseWatcher( true ),
+    mMapData( 0 ),
+    mMapSize( 0 ),
+    mMapStart( 0 ),
+    mMapPos( 0 ),
+    mRecordPos( 0 ),
+    mCodec( 0 ),
+    mUtf8( false ),
+    mLineIndexFileSize( -1 ),
+    mUseWatcher( false ),
     mWatcher( 0 ),
     mDefinitionValid( false ),
     mUseHeader( true ),
@@ -75,9 +314,13 @@ void QgsDelimitedTextFile::close()
   }
   if ( mFile )
   {
+    if ( mMapData )
+      mFile->unmap( reinterpret_cast<uchar *>( const_cast<char *>( mMapData ) ) );
     delete mFile;
     mFile = 0;
   }
+  mMapData = 0;
+  mMapSize = 0;
   if ( mWatcher )
   {
     delete mWatcher;
@@ -102,7 +345,7 @@ bool QgsDelimitedTextFile::open()
       delete mFile;
       mFile = 0;
     }
-    if ( mFile )
+    if ( mFile && ! mapFile() )
     {
       mStream = new QTextStream( mFile );
       if ( ! mEncoding.isEmpty() )
@@ -110,6 +353,9 @@ bool QgsDelimitedTextFile::open()
         QTextCodec *codec =  QTextCodec::codecForName( mEncoding.toAscii() );
         mStream->setCodec( codec );
       }
+    }
+    if ( mFile )
+    {
       if ( mUseWatcher )
       {
         mWatcher = new QFileSystemWatcher();
@@ -121,9 +367,120 @@ bool QgsDelimitedTextFile::open()
   return mFile != 0;
 }
 
+// Decode the file as bytes if the delimiters can be recognised without decoding it,
+// that is they are ASCII characters and the encoding represents ASCII characters
+// as single bytes which are never part of other characters.
+bool QgsDelimitedTextFile::mapFile()
+{
+  // A watched file is expected to be changed by other programs.  Reading the
+  // pages of a mapped file which has been truncated raises SIGBUS, so it is
+  // read through the stream instead.
+  if ( mUseWatcher ) return false;
+  if ( mType != DelimTypeCSV ) return false;
+  QString specialChars = mDelimChars + mQuoteChar + mEscapeChar;
+  for ( int i = 0; i < specialChars.size(); i++ )
+  {
+    if ( specialChars[i].unicode() >= 0x80 ) return false;
+  }
+
+  QTextCodec *codec = mEncoding.isEmpty() ? QTextCodec::codecForLocale() : QTextCodec::codecForName( mEncoding.toAscii() );
+  if ( ! codec ) return false;
+
+  qint64 size = mFile->size();
+  if ( size <= 0 ) return false;
+  uchar *data = mFile->map( 0, size );
+  if ( ! data )
+  {
+    QgsDebugMsg( "Data file " + mFileName + " could not be memory mapped" );
+    return false;
+  }
+
+  // QTextStream detects byte order marks and switches to the matching codec
+  qint64 start = 0;
+  if ( size >= 3 && data[0] == 0xef && data[1] == 0xbb && data[2] == 0xbf )
+  {
+    codec = QTextCodec::codecForName( "UTF-8" );
+    start = 3;
+  }
+  else if ( size >= 2 && (( data[0] == 0xff && data[1] == 0xfe ) || ( data[0] == 0xfe && data[1] == 0xff ) ) )
+  {
+    codec = 0;
+  }
+  else if ( size >= 4 && data[0] == 0 && data[1] == 0 && data[2] == 0xfe && data[3] == 0xff )
+  {
+    codec = 0;
+  }
+
+  int mib = codec ? codec->mibEnum() : 0;
+  bool asciiCompatible =
+    mib == 3 ||                        // US-ASCII
+    ( mib >= 4 && mib <= 13 ) ||       // ISO-8859-1 to ISO-8859-10
+    ( mib >= 109 && mib <= 112 ) ||    // ISO-8859-13 to ISO-8859-16
+    mib == 106 ||                      // UTF-8
+    mib == 2084 || mib == 2088 ||      // KOI8-R, KOI8-U
+    ( mib >= 2250 && mib <= 2258 );    // windows-1250 to windows-1258
+  if ( ! asciiCompatible )
+  {
+    mFile->unmap( data );
+    return false;
+  }
+
+  mMapData = reinterpret_cast<const char *>( data );
+  mMapSize = size;
+  mMapStart = start;
+  mMapPos = start;
+  mCodec = codec;
+  mUtf8 = mib == 106;
+
+  // Classify the bytes for the parser.  Whitespace beyond ASCII is recognised as for
+  // QChar::isSpace, by decoding UTF-8 sequences or the single bytes of other encodings.
+  for ( int c = 0; c < 256; c++ )
+  {
+    unsigned char cls = 0;
+    if ( c < 0x80 )
+    {
+      QChar ch( c );
+      if ( mDelimChars.contains( ch ) ) cls |= CharDelim;
+      if ( mQuoteChar.contains( ch ) ) cls |= CharQuote;
+      if ( mEscapeChar.contains( ch ) ) cls |= CharEscape;
+      if ( ch.isSpace() ) cls |= CharSpace;
+    }
+    else if ( mUtf8 )
+    {
+      cls = CharMultiByte;
+    }
+    else
+    {
+      char b = c;
+      QString decoded = codec->toUnicode( &b, 1 );
+      if ( decoded.size() == 1 && decoded[0].isSpace() ) cls |= CharSpace;
+    }
+    mCharClass[c] = cls;
+  }
+
+  QgsDebugMsg( "Data file " + mFileName + " is memory mapped" );
+  return true;
+}
+
+void QgsDelimitedTextFile::setLineIndex( const QVector<LineOffset> &index, qint64 fileSize )
+{
+  mLineIndex = index;
+  mLineIndexFileSize = fileSize;
+}
+
+void QgsDelimitedTextFile::setScanCounts( int maxFieldCount, long recordCount )
+{
+  // Open the file first, as opening it clears the record count
+  if ( ! mFile ) reset();
+  if ( maxFieldCount > mMaxFieldCount ) mMaxFieldCount = maxFieldCount;
+  if ( recordCount > mMaxRecordNumber ) mMaxRecordNumber = recordCount;
+}
+
 void QgsDelimitedTextFile::updateFile()
 {
   close();
+  mLineIndex.clear();
+  mLineIndexFileSize = -1;
   emit fileUpdated();
 }
 
@@ -157,8 +514,13 @@ bool QgsDelimitedTextFile::setFromUrl( const QUrl &url )
     mEncoding = url.queryItemValue( "encoding" );
   }
 
-  //
-  if ( url.hasQueryItem( "useWatcher" ) )
+  // The file is watched if the layer is set to watch it, useWatcher is
+  // the former name of the option
+  if ( url.hasQueryItem( "watchFile" ) )
+  {
+    mUseWatcher = url.queryItemValue( "watchFile" ).toUpper().startsWith( 'Y' );
+  }
+  else if ( url.hasQueryItem( "useWatcher" ) )
   {
     mUseWatcher = ! url.queryItemValue( "useWatcher" ).toUpper().startsWith( 'N' );
   }
@@ -269,9 +631,9 @@ QUrl QgsDelimitedTextFile::url()
     url.addQueryItem( "encoding", mEncoding );
   }
 
-  if ( !mUseWatcher )
+  if ( mUseWatcher )
   {
-    url.addQueryItem( "useWatcher", "no" );
+    url.addQueryItem( "watchFile", "yes" );
   }
 
   url.addQueryItem( "type", type() );
@@ -518,6 +880,19 @@ QgsDelimitedTextFile::Status QgsDelimitedTextFile::nextRecord( QStringList &reco
   record.clear();
   Status status = RecordOk;
 
+  if ( ! mFile )
+  {
+    status = reset();
+    if ( status != RecordOk ) return RecordEOF;
+  }
+  if ( mMapData )
+  {
+    QgsDelimitedTextRecord bytesRecord;
+    status = nextMappedRecord( bytesRecord );
+    if ( status == RecordOk ) record = bytesRecord.strings();
+    return status;
+  }
+
   if ( mHoldCurrentRecord )
   {
     mHoldCurrentRecord = false;
@@ -555,15 +930,27 @@ QgsDelimitedTextFile::Status  QgsDelimitedTextFile::reset()
   if ( ! isValid() || ! open() ) return InvalidDefinition;
 
   // Reset the file pointer
-  mStream->seek( 0 );
+  if ( mMapData )
+    mMapPos = mMapStart;
+  else
+    mStream->seek( 0 );
   mLineNumber = 0;
   mRecordNumber = -1;
   mRecordLineNumber = -1;
+  mHoldCurrentRecord = false;
 
   // Skip header lines
   for ( int i = mSkipLines; i-- > 0; )
   {
-    if ( mStream->readLine().isNull() ) return RecordEOF;
+    if ( mMapData )
+    {
+      if ( mMapPos >= mMapSize ) return RecordEOF;
+      const char *eol;
+      const char *next;
+      findLineEnd( mMapData + mMapPos, mMapData + mMapSize, eol, next );
+      mMapPos = next - mMapData;
+    }
+    else if ( mStream->readLine().isNull() ) return RecordEOF;
     mLineNumber++;
   }
   // Read the column names
@@ -601,6 +988,45 @@ QgsDelimitedTextFile::Status QgsDelimitedTextFile::nextLine( QString &buffer, bo
 
 bool QgsDelimitedTextFile::setNextLineNumber( long nextLineNumber )
 {
+  if ( mMapData )
+  {
+    // Jump to the closest indexed line before the requested line, unless
+    // it is quicker to read on from the current line
+    if ( ! mLineIndex.isEmpty() && mLineIndexFileSize == mMapSize )
+    {
+      LineOffset target;
+      target.line = nextLineNumber;
+      target.offset = 0;
+      QVector<LineOffset>::const_iterator it = qUpperBound( mLineIndex.constBegin(), mLineIndex.constEnd(), target, lineOffsetLessThan );
+      if ( it != mLineIndex.constBegin() )
+      {
+        --it;
+        if ( it->line - 1 > mLineNumber || mLineNumber > nextLineNumber - 1 )
+        {
+          mRecordNumber = -1;
+          mMapPos = it->offset;
+          mLineNumber = it->line - 1;
+        }
+      }
+    }
+    if ( mLineNumber > nextLineNumber - 1 )
+    {
+      mRecordNumber = -1;
+      mMapPos = mMapStart;
+      mLineNumber = 0;
+    }
+    while ( mLineNumber < nextLineNumber - 1 )
+    {
+      if ( mMapPos >= mMapSize ) return false;
+      const char *eol;
+      const char *next;
+      findLineEnd( mMapData + mMapPos, mMapData + mMapSize, eol, next );
+      mMapPos = next - mMapData;
+      mLineNumber++;
+    }
+    return true;
+  }
+
   if ( ! mStream ) return false;
   if ( mLineNumber > nextLineNumber - 1 )
   {
@@ -838,6 +1264,501 @@ QgsDelimitedTextFile::Status QgsDelimitedTextFile::parseQuoted( QString &buffer,
   return status;
 }
 
+QgsDelimitedTextFile::Status QgsDelimitedTextFile::nextRecord( QgsDelimitedTextRecord &record )
+{
+  record.clear();
+  if ( ! mFile )
+  {
+    Status status = reset();
+    if ( status != RecordOk ) return RecordEOF;
+  }
+  if ( mMapData ) return nextMappedRecord( record );
+
+  QStringList fields;
+  Status status = nextRecord( fields );
+  record.setStrings( fields );
+  return status;
+}
+
+QgsDelimitedTextFile::Status QgsDelimitedTextFile::nextMappedRecord( QgsDelimitedTextRecord &record )
+{
+  const char *end = mMapData + mMapSize;
+
+  // Parse the current record again rather than keeping a copy of it
+  if ( mHoldCurrentRecord )
+  {
+    mHoldCurrentRecord = false;
+    const char *p = mMapData + mRecordPos;
+    long lines = mRecordLineNumber - 1;
+    int maxFieldCount = mMaxFieldCount;
+    return parseQuotedBytes( p, end, record, lines, maxFieldCount );
+  }
+
+  // Invalidate the record line number, in get EOF
+  mRecordLineNumber = -1;
+
+  // Find the first non-blank line to read
+  const char *p = mMapData + mMapPos;
+  long lines = mLineNumber;
+  skipBlankLines( p, end, lines );
+  mLineNumber = lines;
+  mMapPos = p - mMapData;
+  if ( p >= end ) return RecordEOF;
+
+  mRecordLineNumber = mLineNumber + 1;
+  mRecordPos = mMapPos;
+  if ( mRecordNumber >= 0 )
+  {
+    mRecordNumber++;
+    if ( mRecordNumber > mMaxRecordNumber ) mMaxRecordNumber = mRecordNumber;
+  }
+  Status status = parseQuotedBytes( p, end, record, lines, mMaxFieldCount );
+  mLineNumber = lines;
+  mMapPos = p - mMapData;
+  return status;
+}
+
+void QgsDelimitedTextFile::findLineEnd( const char *p, const char *end, const char *&eol, const char *&next )
+{
+  const char *nl = static_cast<const char *>( memchr( p, '\n', end - p ) );
+  if ( nl )
+  {
+    eol = nl;
+    next = nl + 1;
+  }
+  else
+  {
+    eol = end;
+    next = end;
+  }
+  // As QTextStream::readLine, strip a carriage return before the new line or at the end of the file
+  if ( eol > p && eol[-1] == '\r' ) eol--;
+}
+
+int QgsDelimitedTextFile::charLength( const char *p, const char *end, bool &isSpace ) const
+{
+  unsigned char c = *p;
+  unsigned char cls = mCharClass[c];
+  if ( !( cls & CharMultiByte ) )
+  {
+    isSpace = cls & CharSpace;
+    return 1;
+  }
+
+  // Decode the UTF-8 sequence to check for whitespace.  Invalid bytes are
+  // taken as single (non whitespace) characters.
+  isSpace = false;
+  int length;
+  uint ucs;
+  if ( c >= 0xc0 && c < 0xe0 )
+  {
+    length = 2;
+    ucs = c & 0x1f;
+  }
+  else if ( c >= 0xe0 && c < 0xf0 )
+  {
+    length = 3;
+    ucs = c & 0x0f;
+  }
+  else if ( c >= 0xf0 && c < 0xf8 )
+  {
+    length = 4;
+    ucs = c & 0x07;
+  }
+  else
+  {
+    return 1;
+  }
+  if ( end - p < length ) return 1;
+  for ( int i = 1; i < length; i++ )
+  {
+    unsigned char b = p[i];
+    if (( b & 0xc0 ) != 0x80 ) return 1;
+    ucs = ( ucs << 6 ) | ( b & 0x3f );
+  }
+  isSpace = ucs <= 0xffff && QChar( static_cast<ushort>( ucs ) ).isSpace();
+  return length;
+}
+
+void QgsDelimitedTextFile::skipBlankLines( const char *&p, const char *end, long &lines ) const
+{
+  while ( p < end )
+  {
+    const char *eol;
+    const char *next;
+    findLineEnd( p, end, eol, next );
+    if ( eol != p ) break;
+    lines++;
+    p = next;
+  }
+}
+
+QgsDelimitedTextFile::Status QgsDelimitedTextFile::parseQuotedBytes( const char *&p, const char *end, QgsDelimitedTextRecord &record, long &lines, int &maxFieldCount ) const
+{
+  record.clear();
+  record.mCodec = mCodec;
+
+  Status status = RecordOk;
+  bool escaped = false; // Next char is escaped
+  bool quoted = false;  // In quotes
+  char quoteChar = 0;   // Actual quote character used to open quotes
+  bool started = false; // Non-blank chars in field or quotes started
+  bool ended = false;   // Quoted field ended
+
+  const char *eol;
+  const char *next;
+  findLineEnd( p, end, eol, next );
+  lines++;
+  const char *cp = p;
+
+  // Bytes of the record are copied to the record buffer, which has room for the
+  // current line plus a new line.  Fields are delimited by offsets into the buffer.
+  char *buffer = record.reserve( eol - cp + 1 );
+  int used = record.mUsed;
+  int fieldStart = used;
+
+  while ( true )
+  {
+    // If end of line then if escaped or buffered then try to get more...
+    if ( cp >= eol )
+    {
+      if ( quoted || escaped )
+      {
+        if ( next >= end )
+        {
+          status = RecordInvalid;
+          break;
+        }
+        cp = next;
+        findLineEnd( cp, end, eol, next );
+        lines++;
+        record.mUsed = used;
+        buffer = record.reserve( eol - cp + 1 );
+        buffer[used++] = '\n';
+        escaped = false;
+        continue;
+      }
+      break;
+    }
+
+    bool isSpace;
+    int length = charLength( cp, eol, isSpace );
+    char c = *cp;
+    const char *charStart = cp;
+    cp += length;
+
+    // If escaped, then just append the character
+    if ( escaped )
+    {
+      memcpy( buffer + used, charStart, length );
+      used += length;
+      escaped = false;
+      continue;
+    }
+
+    // Determine if this is a special character, as in parseQuoted.  Multibyte
+    // characters are never special.
+    unsigned char cls = mCharClass[static_cast<unsigned char>( c )];
+    bool isQuote = false;
+    bool isEscape = false;
+    bool isDelim = cls & CharDelim;
+    if ( ! isDelim )
+    {
+      bool isQuoteChar = cls & CharQuote;
+      isQuote = quoted ? c == quoteChar : isQuoteChar;
+      isEscape = cls & CharEscape;
+      if ( isQuoteChar && isEscape ) isEscape = isQuote;
+    }
+
+    // Start or end of quote ...
+    if ( isQuote )
+    {
+      // quote char in quoted field
+      if ( quoted )
+      {
+        // if is also escape and next character is quote, then
+        // escape the quote..
+        if ( isEscape && cp < eol && *cp == quoteChar )
+        {
+          buffer[used++] = quoteChar;
+          cp++;
+        }
+        // Otherwise end of quoted field
+        else
+        {
+          quoted = false;
+          ended =  true;
+        }
+      }
+      // quote char at start of field .. start of quoted fields
+      else if ( ! started )
+      {
+        used = fieldStart;
+        quoteChar = c;
+        quoted = true;
+        started = true;
+      }
+      // Cannot have a quote embedded in a field
+      else
+      {
+        record.clear();
+        p = next;
+        return RecordInvalid;
+      }
+    }
+    // If escape char, then next char is escaped...
+    else if ( isEscape )
+    {
+      escaped = true;
+    }
+    // If within quotes, then append to the string
+    else if ( quoted )
+    {
+      memcpy( buffer + used, charStart, length );
+      used += length;
+    }
+    // If it is a delimiter, then end of field...
+    else if ( isDelim )
+    {
+      record.mUsed = used;
+      appendFieldBytes( record, fieldStart, used == fieldStart, ended, maxFieldCount );
+
+      // Clear the field
+      fieldStart = used;
+      started = false;
+      ended = false;
+    }
+    // Whitespace is permitted before the start of a field, or
+    // after the end..
+    else if ( isSpace )
+    {
+      if ( ! ended )
+      {
+        memcpy( buffer + used, charStart, length );
+        used += length;
+      }
+    }
+    // Other chars permitted if not after quoted field
+    else
+    {
+      if ( ended )
+      {
+        record.clear();
+        p = next;
+        return RecordInvalid;
+      }
+      memcpy( buffer + used, charStart, length );
+      used += length;
+      started = true;
+    }
+  }
+  record.mUsed = used;
+
+  // If reached the end of the record, then add the last field...
+  if ( started )
+  {
+    appendFieldBytes( record, fieldStart, used == fieldStart, ended, maxFieldCount );
+  }
+  p = next;
+  return status;
+}
+
+void QgsDelimitedTextFile::appendFieldBytes( QgsDelimitedTextRecord &record, int start, bool null, bool quoted, int &maxFieldCount ) const
+{
+  if ( mMaxFields > 0 && record.mFields.size() >= mMaxFields ) return;
+
+  QgsDelimitedTextRecord::Field field;
+  field.start = start;
+  field.length = record.mUsed - start;
+  field.null = null;
+
+  if ( ! quoted )
+  {
+    if ( mTrimFields )
+    {
+      const char *data = record.mData.constData();
+      const char *first = data + field.start;
+      const char *last = first + field.length;
+      bool isSpace = true;
+      while ( first < last )
+      {
+        int length = charLength( first, last, isSpace );
+        if ( ! isSpace ) break;
+        first += length;
+      }
+      while ( last > first )
+      {
+        // Find the start of the last character, which may be multibyte
+        const char *c = last - 1;
+        if ( mUtf8 )
+        {
+          while ( c > first && last - c < 4 && ( static_cast<unsigned char>( *c ) & 0xc0 ) == 0x80 ) c--;
+        }
+        if ( charLength( c, last, isSpace ) != last - c || ! isSpace ) break;
+        last = c;
+      }
+      field.start = first - data;
+      field.length = last - first;
+    }
+    if ( mDiscardEmptyFields && field.length == 0 ) return;
+  }
+  record.mFields.append( field );
+
+  // Keep track of maximum number of non-empty fields in a record
+  if ( record.mFields.size() > maxFieldCount && field.length > 0 )
+  {
+    maxFieldCount = record.mFields.size();
+  }
+}
+
+bool QgsDelimitedTextFile::scanRecords( QgsDelimitedTextScanner &scanner )
+{
+  if ( reset() != RecordOk || ! mMapData ) return false;
+
+  const char *begin = mMapData + mMapPos;
+  const char *end = mMapData + mMapSize;
+
+  // Split the file into chunks starting at the beginning of a line.  The
+  // number of chunks is a few times the number of threads to balance the load.
+  int maxChunks = qMax( 1, QThread::idealThreadCount() ) * 4;
+  int nChunks = static_cast<int>( qBound( static_cast<qint64>( 1 ), ( end - begin ) / SCAN_CHUNK_SIZE, static_cast<qint64>( maxChunks ) ) );
+
+  QList<ScanChunk> chunks;
+  const char *chunkStart = begin;
+  for ( int i = 1; i <= nChunks; i++ )
+  {
+    const char *chunkEnd = end;
+    if ( i < nChunks )
+    {
+      chunkEnd = begin + ( end - begin ) * i / nChunks;
+      if ( chunkEnd <= chunkStart ) continue;
+      const char *eol;
+      findLineEnd( chunkEnd, end, eol, chunkEnd );
+    }
+    ScanChunk chunk;
+    chunk.file = this;
+    chunk.scan = 0;
+    chunk.start = chunkStart;
+    chunk.end = chunkEnd;
+    chunk.stop = chunkStart;
+    chunk.lines = 0;
+    chunk.records = 0;
+    chunk.maxFieldCount = 0;
+    chunks.append( chunk );
+    chunkStart = chunkEnd;
+    if ( chunkStart >= end ) break;
+  }
+
+  for ( int i = 0; i < chunks.size(); i++ )
+    chunks[i].scan = scanner.createChunkScan();
+
+  if ( chunks.size() > 1 )
+  {
+    QtConcurrent::blockingMap( chunks, &QgsDelimitedTextFile::scanChunk );
+
+    // A chunk which does not end where the next one starts has a record with
+    // new lines in quotes crossing the chunk boundary, and the next chunk was
+    // parsed from within that record.  Parse the file as a single chunk then.
+    bool aligned = true;
+    for ( int i = 0; i + 1 < chunks.size(); i++ )
+    {
+      if ( chunks[i].stop != chunks[i + 1].start ) aligned = false;
+    }
+    if ( ! aligned )
+    {
+      QgsDebugMsg( "Delimited text file has records crossing scan chunks - scanning sequentially" );
+      for ( int i = 1; i < chunks.size(); i++ )
+        delete chunks[i].scan;
+      ScanChunk chunk = chunks[0];
+      delete chunk.scan;
+      chunk.scan = scanner.createChunkScan();
+      chunk.end = end;
+      chunk.stop = begin;
+      chunk.lines = 0;
+      chunk.records = 0;
+      chunk.maxFieldCount = 0;
+      chunk.lineIndex.clear();
+      chunks.clear();
+      chunks.append( chunk );
+      scanChunk( chunks[0] );
+    }
+  }
+  else
+  {
+    scanChunk( chunks[0] );
+  }
+
+  // Merge the chunks in file order.  Line numbers are only known now.
+  long firstLine = mLineNumber + 1;
+  long records = 0;
+  mLineIndex.clear();
+  LineOffset start;
+  start.line = 1;
+  start.offset = mMapStart;
+  mLineIndex.append( start );
+  for ( int i = 0; i < chunks.size(); i++ )
+  {
+    ScanChunk &chunk = chunks[i];
+    scanner.mergeChunkScan( chunk.scan, firstLine );
+    delete chunk.scan;
+    chunk.scan = 0;
+
+    for ( int j = 0; j < chunk.lineIndex.size(); j++ )
+    {
+      LineOffset entry = chunk.lineIndex.at( j );
+      entry.line += firstLine;
+      mLineIndex.append( entry );
+    }
+    firstLine += chunk.lines;
+    records += chunk.records;
+    if ( chunk.maxFieldCount > mMaxFieldCount ) mMaxFieldCount = chunk.maxFieldCount;
+  }
+  mLineIndexFileSize = mMapSize;
+
+  // Leave the file at the end, as after reading all records
+  mLineNumber = firstLine - 1;
+  mMapPos = mMapSize;
+  mRecordLineNumber = -1;
+  mRecordNumber = records;
+  if ( records > mMaxRecordNumber ) mMaxRecordNumber = records;
+  return true;
+}
+
+void QgsDelimitedTextFile::scanChunk( ScanChunk &chunk )
+{
+  const QgsDelimitedTextFile *file = chunk.file;
+  const char *fileEnd = file->mMapData + file->mMapSize;
+  const char *p = chunk.start;
+  long lines = 0;
+  long indexedLine = 0;
+  QgsDelimitedTextRecord record;
+
+  while ( true )
+  {
+    // Blank lines at the end of the chunk are counted by the next chunk
+    file->skipBlankLines( p, chunk.end, lines );
+
+    // Records starting beyond the end of the chunk belong to the next chunk
+    if ( p >= chunk.end ) break;
+
+    if ( lines - indexedLine >= LINE_INDEX_STEP )
+    {
+      LineOffset entry;
+      entry.line = lines;
+      entry.offset = p - file->mMapData;
+      chunk.lineIndex.append( entry );
+      indexedLine = lines;
+    }
+
+    long lineOffset = lines;
+    Status status = file->parseQuotedBytes( p, fileEnd, record, lines, chunk.maxFieldCount );
+    chunk.records++;
+    chunk.scan->addRecord( lineOffset, status, record );
+  }
+  chunk.stop = p;
+  chunk.lines = lines;
+}
+
 bool QgsDelimitedTextFile::isValid()
 {
   return mDefinitionValid && QFile::exists( mFileName ) && QFileInfo( mFileName ).size() > 0;
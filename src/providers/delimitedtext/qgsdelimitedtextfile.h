@@ -22,14 +22,110 @@
 #include <QRegExp>
 #include <QUrl>
 #include <QObject>
+#include <QVector>
 
 class QgsFeature;
 class QgsField;
+class QgsDelimitedTextChunkScan;
+class QgsDelimitedTextScanner;
 class QFile;
 class QFileSystemWatcher;
+class QTextCodec;
 class QTextStream;
 
 
+/**
+\class QgsDelimitedTextRecord
+\brief A record read by QgsDelimitedTextFile.
+*
+* Records of memory mapped files keep the bytes of their fields, which are only
+* decoded if a field is requested as a string.  Numbers are converted straight
+* from the bytes.  Records read through a text stream hold the parsed strings.
+*/
+
+class QgsDelimitedTextRecord
+{
+  public:
+
+    QgsDelimitedTextRecord();
+
+    /** Remove all fields
+     */
+    void clear();
+
+    /** Return the number of fields
+     */
+    int size() const { return mHasStrings ? mStrings.size() : mFields.size(); }
+
+    /** Return true if all fields are empty (such as records added randomly by spreadsheets)
+     */
+    bool isEmpty() const;
+
+    /** Return true if the field is empty or missing
+     *  @param i  The index of the field
+     */
+    bool isFieldEmpty( int i ) const;
+
+    /** Return the field as a string.  Missing fields and fields without any
+     *  characters are returned as null strings.
+     *  @param i  The index of the field
+     */
+    QString string( int i ) const;
+
+    /** Return all fields as strings
+     */
+    QStringList strings() const;
+
+    /** Convert the field to an integer
+     *  @param i  The index of the field
+     *  @param value  Receives the value
+     *  @return ok  True if the field is a valid integer
+     */
+    bool toInt( int i, int &value ) const;
+
+    /** Convert the field to a 64 bit integer
+     *  @param i  The index of the field
+     *  @param value  Receives the value
+     *  @return ok  True if the field is a valid 64 bit integer
+     */
+    bool toLongLong( int i, qlonglong &value ) const;
+
+    /** Convert the field to a double
+     *  @param i  The index of the field
+     *  @param value  Receives the value
+     *  @param decimalPoint  If not empty, accepted in place of '.'
+     *  @return ok  True if the field is a valid number
+     */
+    bool toDouble( int i, double &value, const QString &decimalPoint = QString() ) const;
+
+    /** Set the fields to strings parsed from a text stream
+     */
+    void setStrings( const QStringList &strings );
+
+  private:
+
+    struct Field
+    {
+      int start;
+      int length;
+      // True if no character was added to the field (as opposed to an empty quoted field)
+      bool null;
+    };
+
+    // Reserve room for count more bytes
+    char *reserve( int count );
+
+    QByteArray mData;
+    int mUsed;
+    QVector<Field> mFields;
+    QTextCodec *mCodec;
+    QStringList mStrings;
+    bool mHasStrings;
+
+    friend class QgsDelimitedTextFile;
+};
+
+
 /**
 \class QgsDelimitedTextFile
 \brief Delimited text file parser extracts records from a QTextStream as a QStringList.
@@ -65,6 +161,12 @@ class QTextStream;
 *   The field is ignored for csv and whitespace
 * - quoteChar, optional, a single character used for quoting plain fields
 * - escapeChar, optional, a single characer used for escaping (may be the same as quoteChar)
+* - watchFile, optional, yes to notify of changes to the file made by other programs
+*
+* Character delimited files with ASCII delimiter, quote and escape characters in
+* an ASCII compatible encoding (UTF-8, Latin-1 and similar) are memory mapped and
+* parsed as bytes rather than through a QTextStream, unless the file is watched.
+* The records of a mapped file can also be scanned in parallel with scanRecords().
 */
 
 // Note: this has been implemented as a single class rather than a set of classes based
@@ -242,6 +344,58 @@ class QgsDelimitedTextFile : public QObject
      */
     Status nextRecord( QStringList &fields );
 
+    /** Reads the next record from the file.  For a memory mapped file the
+     *  fields are kept as bytes and only decoded on request.
+     *  @param record  The record to populate
+     *  @return status The result of trying to parse a record, as for the
+     *                 string list version.
+     */
+    Status nextRecord( QgsDelimitedTextRecord &record );
+
+    /** Scans all data records of a memory mapped file.  The file is split into
+     *  line aligned chunks which are parsed in parallel, each by a chunk scan
+     *  created by the scanner.  The chunks are then merged in file order.  If a
+     *  record spans the boundary of two chunks (a quoted field with new lines)
+     *  the whole file is scanned as a single chunk instead.  The file is left
+     *  at its end, and the line index used by setNextRecordId() is built.
+     *  @param scanner  Creates and merges the chunk scans
+     *  @return scanned  False if the file cannot be read or is not memory mapped,
+     *                   in which case the scanner is not used.
+     */
+    bool scanRecords( QgsDelimitedTextScanner &scanner );
+
+    /** The position of a line in the file, used to index a memory mapped file
+     */
+    struct LineOffset
+    {
+      long line;
+      qint64 offset;
+    };
+
+    /** Return the line index built by scanRecords(), which has the offset
+     *  of every few lines of the file
+     */
+    QVector<LineOffset> lineIndex() const { return mLineIndex; }
+
+    /** Set the line index, as built by scanRecords() for another instance
+     *  reading the same file.  It is only used as long as the file has the
+     *  same size as when it was built.
+     *  @param index  The index
+     *  @param fileSize  The size of the file the index was built for
+     */
+    void setLineIndex( const QVector<LineOffset> &index, qint64 fileSize );
+
+    /** Return the size of the file the line index was built for
+     */
+    qint64 lineIndexFileSize() const { return mLineIndexFileSize; }
+
+    /** Restore the counts found by an earlier scan of the same file, so that
+     *  fieldNames() and recordCount() are valid without reading the records
+     *  @param maxFieldCount  The maximum number of fields in a record
+     *  @param recordCount  The number of records in the file
+     */
+    void setScanCounts( int maxFieldCount, long recordCount );
+
     /** Return the line number of the start of the last record read
      *  @return linenumber  The line number of the start of the record
      */
@@ -290,7 +444,8 @@ class QgsDelimitedTextFile : public QObject
      */
     static QString decodeChars( QString string );
 
-    /** Set to use or not use a QFileWatcher to notify of changes to the file
+    /** Set to use or not use a QFileWatcher to notify of changes to the file.
+     * A watched file is not memory mapped.
      * @param useWatcher True to use a watcher, false otherwise
      */
 
@@ -314,6 +469,12 @@ class QgsDelimitedTextFile : public QObject
      */
     bool open();
 
+    /** Memory map the open file if it can be parsed as bytes
+     *
+     * @return mapped  True if the file is mapped
+     */
+    bool mapFile();
+
     /** Close the text file
      */
     void close();
@@ -343,6 +504,56 @@ class QgsDelimitedTextFile : public QObject
      */
     void appendField( QStringList &record, QString field, bool quoted = false );
 
+    // Parsing of memory mapped files.  These functions only read the definition
+    // and may be called concurrently for different chunks of the file.
+
+    /** Character classes of the bytes of a mapped file */
+    enum CharClass
+    {
+      CharDelim = 1,
+      CharQuote = 2,
+      CharEscape = 4,
+      CharSpace = 8,
+      CharMultiByte = 16
+    };
+
+    /** Find the end of the line starting at p, excluding the end of line
+     *  characters, and the start of the following line */
+    static void findLineEnd( const char *p, const char *end, const char *&eol, const char *&next );
+
+    /** Return the length of the (possibly multibyte) character at p, and whether it is whitespace */
+    int charLength( const char *p, const char *end, bool &isSpace ) const;
+
+    /** Skip blank lines, counting them in lines */
+    void skipBlankLines( const char *&p, const char *end, long &lines ) const;
+
+    /** Parse the record starting at p, which is advanced to the following line.
+     *  Equivalent to parseQuoted for bytes. */
+    Status parseQuotedBytes( const char *&p, const char *end, QgsDelimitedTextRecord &record, long &lines, int &maxFieldCount ) const;
+
+    /** Add the field ending at the used bytes of the record, as appendField */
+    void appendFieldBytes( QgsDelimitedTextRecord &record, int start, bool null, bool quoted, int &maxFieldCount ) const;
+
+    /** Read the next record of a mapped file */
+    Status nextMappedRecord( QgsDelimitedTextRecord &record );
+
+    /** Part of a mapped file scanned by scanRecords() */
+    struct ScanChunk
+    {
+      const QgsDelimitedTextFile *file;
+      QgsDelimitedTextChunkScan *scan;
+      const char *start;
+      const char *end;
+      const char *stop;
+      long lines;
+      long records;
+      int maxFieldCount;
+      QVector<LineOffset> lineIndex;
+    };
+
+    /** Parse the records of a chunk, run by scanRecords() in a worker thread */
+    static void scanChunk( ScanChunk &chunk );
+
     // Pointer to the currently selected parser
     Status( QgsDelimitedTextFile::*mParser )( QString &buffer, QStringList &fields );
 
@@ -350,6 +561,18 @@ class QgsDelimitedTextFile : public QObject
     QString mEncoding;
     QFile *mFile;
     QTextStream *mStream;
+
+    // Memory mapping of the file, if used instead of the stream
+    const char *mMapData;
+    qint64 mMapSize;
+    qint64 mMapStart;
+    qint64 mMapPos;
+    qint64 mRecordPos;
+    QTextCodec *mCodec;
+    bool mUtf8;
+    unsigned char mCharClass[256];
+    QVector<LineOffset> mLineIndex;
+    qint64 mLineIndexFileSize;
     bool mUseWatcher;
     QFileSystemWatcher *mWatcher;
 
@@ -385,4 +608,47 @@ class QgsDelimitedTextFile : public QObject
     QRegExp mDefaultFieldRegexp;
 };
 
+
+/**
+\class QgsDelimitedTextChunkScan
+\brief Receives the records of one chunk of a file scanned by QgsDelimitedTextFile::scanRecords().
+*/
+
+class QgsDelimitedTextChunkScan
+{
+  public:
+    virtual ~QgsDelimitedTextChunkScan() {}
+
+    /** Called for each record of the chunk in file order, possibly in a worker thread.
+     *  @param lineOffset  The line of the start of the record relative to the first line
+     *                     of the chunk (0 for the first line)
+     *  @param status  RecordOk or RecordInvalid
+     *  @param record  The record, empty unless the status is RecordOk
+     */
+    virtual void addRecord( long lineOffset, QgsDelimitedTextFile::Status status, const QgsDelimitedTextRecord &record ) = 0;
+};
+
+/**
+\class QgsDelimitedTextScanner
+\brief Creates and merges the chunk scans of QgsDelimitedTextFile::scanRecords().
+*/
+
+class QgsDelimitedTextScanner
+{
+  public:
+    virtual ~QgsDelimitedTextScanner() {}
+
+    /** Create the scan of a chunk.  Ownership is transferred to the caller.
+     */
+    virtual QgsDelimitedTextChunkScan *createChunkScan() = 0;
+
+    /** Merge a finished chunk scan, called in file order in the thread which
+     *  called scanRecords().
+     *  @param scan  The chunk scan
+     *  @param firstLine  The line number of the first line of the chunk, which
+     *                    the line offsets of the records are relative to
+     */
+    virtual void mergeChunkScan( QgsDelimitedTextChunkScan *scan, long firstLine ) = 0;
+};
+
 #endif
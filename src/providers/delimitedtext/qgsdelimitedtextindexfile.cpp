@@ -0,0 +1,252 @@
+/***************************************************************************
+  qgsdelimitedtextindexfile.cpp -  Cached scan results of a delimited text file
+  -------------------
+          begin                : October 2015
+          copyright            : (C) 2015 by the QGIS project
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgsdelimitedtextindexfile.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSettings>
+
+#include "qgsapplication.h"
+#include "qgslogger.h"
+
+static const quint32 INDEX_FILE_MAGIC = 0x51445449; // "QDTI"
+static const qint32 INDEX_FILE_VERSION = 1;
+
+QgsDelimitedTextIndexFile::QgsDelimitedTextIndexFile()
+    : mEmptyRecords( 0 )
+    , mBadFormatRecords( 0 )
+    , mIncompatibleGeometry( 0 )
+    , mInvalidGeometry( 0 )
+    , mEmptyGeometry( 0 )
+    , mNumberFeatures( 0 )
+    , mWkbType( 0 )
+    , mGeometryType( 0 )
+    , mWktHasPrefix( false )
+    , mWktHasZM( false )
+    , mExtraInvalidLines( 0 )
+    , mMaxFieldCount( 0 )
+    , mRecordCount( -1 )
+    , mHasSubsetIndex( false )
+    , mHasSpatialIndex( false )
+{
+}
+
+QString QgsDelimitedTextIndexFile::cacheDirectory()
+{
+  // Next to the network cache, in the same directory
+  QSettings settings;
+  QString directory = settings.value( "cache/directory", QgsApplication::qgisSettingsDirPath() + "cache" ).toString();
+  return QDir::cleanPath( directory + "/delimitedtext" );
+}
+
+qint64 QgsDelimitedTextIndexFile::cacheSize()
+{
+  QSettings settings;
+  return settings.value( "cache/delimitedTextSize", 50 * 1024 * 1024 ).toLongLong();
+}
+
+QString QgsDelimitedTextIndexFile::cacheFileName( const QString &fileName, const QString &key )
+{
+  // Cache files are named after a hash of the absolute name of the data file
+  // and the layer definition, so that each definition has its own file
+  QByteArray name = QFileInfo( fileName ).absoluteFilePath().toUtf8() + '\n' + key.toUtf8();
+  QString hash = QString( QCryptographicHash::hash( name, QCryptographicHash::Md5 ).toHex() );
+  return cacheDirectory() + "/" + hash + ".idx";
+}
+
+void QgsDelimitedTextIndexFile::trimCache( qint64 maxSize )
+{
+  // Keep the most recently written files which fit in the cache
+  QDir dir( cacheDirectory() );
+  QFileInfoList files = dir.entryInfoList( QStringList() << "*.idx", QDir::Files, QDir::Time );
+  qint64 size = 0;
+  Q_FOREACH ( const QFileInfo &file, files )
+  {
+    size += file.size();
+    if ( size > maxSize )
+    {
+      QgsDebugMsg( "Removing index file " + file.fileName() );
+      QFile::remove( file.absoluteFilePath() );
+    }
+  }
+}
+
+bool QgsDelimitedTextIndexFile::read( const QString &fileName, const QString &key )
+{
+  if ( cacheSize() <= 0 ) return false;
+
+  QFileInfo info( fileName );
+  if ( ! info.exists() ) return false;
+
+  QFile file( cacheFileName( fileName, key ) );
+  if ( ! file.open( QIODevice::ReadOnly ) ) return false;
+
+  QDataStream in( &file );
+  in.setVersion( QDataStream::Qt_4_7 );
+
+  quint32 magic;
+  qint32 version;
+  QString fileKey;
+  qint64 fileSize;
+  qint64 modified;
+  in >> magic >> version;
+  if ( magic != INDEX_FILE_MAGIC || version != INDEX_FILE_VERSION ) return false;
+  in >> fileKey >> fileSize >> modified;
+  if ( fileKey != key || fileSize != info.size() || modified != info.lastModified().toMSecsSinceEpoch() )
+  {
+    QgsDebugMsg( "Index file of " + fileName + " is out of date" );
+    return false;
+  }
+
+  qint64 emptyRecords, badFormatRecords, incompatibleGeometry, invalidGeometry, emptyGeometry, numberFeatures, recordCount;
+  double xMin, yMin, xMax, yMax;
+  qint32 wkbType, geometryType, extraInvalidLines, maxFieldCount;
+  in >> emptyRecords >> badFormatRecords >> incompatibleGeometry >> invalidGeometry >> emptyGeometry >> numberFeatures;
+  in >> xMin >> yMin >> xMax >> yMax;
+  in >> wkbType >> geometryType >> mWktHasPrefix >> mWktHasZM;
+  in >> mIsEmpty >> mCouldBeInt >> mCouldBeLongLong >> mCouldBeDouble;
+  in >> mInvalidLines >> extraInvalidLines;
+  in >> maxFieldCount >> recordCount;
+
+  mEmptyRecords = emptyRecords;
+  mBadFormatRecords = badFormatRecords;
+  mIncompatibleGeometry = incompatibleGeometry;
+  mInvalidGeometry = invalidGeometry;
+  mEmptyGeometry = emptyGeometry;
+  mNumberFeatures = numberFeatures;
+  mExtent.set( xMin, yMin, xMax, yMax );
+  mWkbType = wkbType;
+  mGeometryType = geometryType;
+  mExtraInvalidLines = extraInvalidLines;
+  mMaxFieldCount = maxFieldCount;
+  mRecordCount = recordCount;
+
+  qint32 size;
+  in >> size;
+  if ( in.status() != QDataStream::Ok || size < 0 ) return false;
+  mLineIndex.resize( size );
+  for ( int i = 0; i < size; i++ )
+  {
+    qint64 line;
+    in >> line >> mLineIndex[i].offset;
+    mLineIndex[i].line = line;
+  }
+
+  in >> mHasSubsetIndex >> size;
+  if ( in.status() != QDataStream::Ok || size < 0 ) return false;
+  mSubsetIndex.clear();
+  mSubsetIndex.reserve( size );
+  for ( int i = 0; i < size; i++ )
+  {
+    quint64 id;
+    in >> id;
+    mSubsetIndex.append( id );
+  }
+
+  in >> mHasSpatialIndex >> size;
+  if ( in.status() != QDataStream::Ok || size < 0 ) return false;
+  mSpatialIndex.resize( size );
+  for ( int i = 0; i < size; i++ )
+  {
+    in >> mSpatialIndex[i].first >> xMin >> yMin >> xMax >> yMax;
+    mSpatialIndex[i].second.set( xMin, yMin, xMax, yMax );
+  }
+
+  if ( in.status() != QDataStream::Ok )
+  {
+    QgsDebugMsg( "Index file of " + fileName + " is truncated" );
+    return false;
+  }
+
+  QgsDebugMsg( "Read index file of " + fileName );
+  return true;
+}
+
+bool QgsDelimitedTextIndexFile::write( const QString &fileName, const QString &key ) const
+{
+  qint64 maxSize = cacheSize();
+  if ( maxSize <= 0 ) return false;
+
+  QFileInfo info( fileName );
+  if ( ! info.exists() ) return false;
+
+  QString cacheName = cacheFileName( fileName, key );
+  if ( ! QDir().mkpath( QFileInfo( cacheName ).absolutePath() ) ) return false;
+
+  // Write to a temporary file first so that an interrupted write does not
+  // leave a truncated index file
+  QString tmpName = cacheName + ".tmp";
+  QFile file( tmpName );
+  if ( ! file.open( QIODevice::WriteOnly | QIODevice::Truncate ) ) return false;
+
+  QDataStream out( &file );
+  out.setVersion( QDataStream::Qt_4_7 );
+
+  out << INDEX_FILE_MAGIC << INDEX_FILE_VERSION;
+  out << key << ( qint64 ) info.size() << ( qint64 ) info.lastModified().toMSecsSinceEpoch();
+
+  out << ( qint64 ) mEmptyRecords << ( qint64 ) mBadFormatRecords << ( qint64 ) mIncompatibleGeometry
+  << ( qint64 ) mInvalidGeometry << ( qint64 ) mEmptyGeometry << ( qint64 ) mNumberFeatures;
+  out << mExtent.xMinimum() << mExtent.yMinimum() << mExtent.xMaximum() << mExtent.yMaximum();
+  out << ( qint32 ) mWkbType << ( qint32 ) mGeometryType << mWktHasPrefix << mWktHasZM;
+  out << mIsEmpty << mCouldBeInt << mCouldBeLongLong << mCouldBeDouble;
+  out << mInvalidLines << ( qint32 ) mExtraInvalidLines;
+  out << ( qint32 ) mMaxFieldCount << ( qint64 ) mRecordCount;
+
+  out << ( qint32 ) mLineIndex.size();
+  for ( int i = 0; i < mLineIndex.size(); i++ )
+  {
+    out << ( qint64 ) mLineIndex.at( i ).line << mLineIndex.at( i ).offset;
+  }
+
+  out << mHasSubsetIndex << ( qint32 ) mSubsetIndex.size();
+  for ( int i = 0; i < mSubsetIndex.size(); i++ )
+  {
+    out << ( quint64 ) mSubsetIndex.at( i );
+  }
+
+  out << mHasSpatialIndex << ( qint32 ) mSpatialIndex.size();
+  for ( int i = 0; i < mSpatialIndex.size(); i++ )
+  {
+    const QgsRectangle &rect = mSpatialIndex.at( i ).second;
+    out << mSpatialIndex.at( i ).first << rect.xMinimum() << rect.yMinimum() << rect.xMaximum() << rect.yMaximum();
+  }
+
+  bool ok = out.status() == QDataStream::Ok;
+  file.close();
+  if ( ok && file.error() == QFile::NoError )
+  {
+    QFile::remove( cacheName );
+    ok = QFile::rename( tmpName, cacheName );
+  }
+  else
+  {
+    ok = false;
+  }
+  if ( ! ok )
+  {
+    QgsDebugMsg( "Cannot write index file " + cacheName );
+    QFile::remove( tmpName );
+  }
+
+  trimCache( maxSize );
+  return ok && QFile::exists( cacheName );
+}
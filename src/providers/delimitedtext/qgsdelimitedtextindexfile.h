@@ -0,0 +1,120 @@
+/***************************************************************************
+  qgsdelimitedtextindexfile.h -  Cached scan results of a delimited text file
+  -------------------
+          begin                : October 2015
+          copyright            : (C) 2015 by the QGIS project
+ ***************************************************************************/
+
+/***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSDELIMITEDTEXTINDEXFILE_H
+#define QGSDELIMITEDTEXTINDEXFILE_H
+
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "qgsfeature.h"
+#include "qgsrectangle.h"
+#include "qgsdelimitedtextfile.h"
+
+/**
+ * \class QgsDelimitedTextIndexFile
+ * \brief The results of scanning a delimited text file, saved to a cache file
+ *
+ * Scanning a large file to find the field types, extent and feature count
+ * dominates the time taken to open a delimited text layer.  The provider saves
+ * the results of the scan, along with the line index of the data file and the
+ * subset and spatial indexes, to a cache file in the delimitedtext folder of
+ * the cache directory (the cache/directory setting, by default the cache folder
+ * of the QGIS settings directory).  When the same file is opened again with the
+ * same layer definition the scan is skipped as long as the size and
+ * modification time of the data file have not changed.
+ *
+ * Each data file has a cache file per layer definition.  The cache files are
+ * limited to the size set by the cache/delimitedTextSize setting, 50 MB by
+ * default, the files written least recently are removed first.  A size of
+ * 0 disables the cache files.
+ */
+
+class QgsDelimitedTextIndexFile
+{
+  public:
+
+    QgsDelimitedTextIndexFile();
+
+    /** Read the scan results for a data file.
+     *  @param fileName  The name of the data file
+     *  @param key  Identifies the layer definition the file was scanned with
+     *  @return valid  True if the cache file exists, was written for the same
+     *                 definition and the data file has not changed since
+     */
+    bool read( const QString &fileName, const QString &key );
+
+    /** Write the scan results for a data file.
+     *  @param fileName  The name of the data file
+     *  @param key  Identifies the layer definition the file was scanned with
+     *  @return written  True if the cache file was written
+     */
+    bool write( const QString &fileName, const QString &key ) const;
+
+    // Record counts of the scan
+    long mEmptyRecords;
+    long mBadFormatRecords;
+    long mIncompatibleGeometry;
+    long mInvalidGeometry;
+    long mEmptyGeometry;
+    long mNumberFeatures;
+
+    // Geometry of the layer
+    QgsRectangle mExtent;
+    int mWkbType;
+    int mGeometryType;
+    bool mWktHasPrefix;
+    bool mWktHasZM;
+
+    // Potential types of the fields
+    QList<bool> mIsEmpty;
+    QList<bool> mCouldBeInt;
+    QList<bool> mCouldBeLongLong;
+    QList<bool> mCouldBeDouble;
+
+    QStringList mInvalidLines;
+    int mExtraInvalidLines;
+
+    // State of the data file after the scan
+    int mMaxFieldCount;
+    long mRecordCount;
+    QVector<QgsDelimitedTextFile::LineOffset> mLineIndex;
+
+    // Indexes, which are only valid if they were built by the scan
+    bool mHasSubsetIndex;
+    QList<quintptr> mSubsetIndex;
+    bool mHasSpatialIndex;
+    QVector< QPair<QgsFeatureId, QgsRectangle> > mSpatialIndex;
+
+  private:
+
+    //! The directory of the cache files
+    static QString cacheDirectory();
+
+    //! The maximum size of the cache files in bytes
+    static qint64 cacheSize();
+
+    //! The name of the cache file of a data file and layer definition
+    static QString cacheFileName( const QString &fileName, const QString &key );
+
+    //! Remove the cache files written least recently until they fit in maxSize bytes
+    static void trimCache( qint64 maxSize );
+};
+
+#endif
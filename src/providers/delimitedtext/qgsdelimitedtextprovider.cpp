@@ -31,6 +31,7 @@
 #include "qgsdataprovider.h"
 #include "qgsexpression.h"
 #include "qgsfeature.h"
+#include "qgsfeatureiterator.h"
 #include "qgsfield.h"
 #include "qgsgeometry.h"
 #include "qgslogger.h"
@@ -43,6 +44,7 @@
 #include "qgsdelimitedtextsourceselect.h"
 #include "qgsdelimitedtextfeatureiterator.h"
 #include "qgsdelimitedtextfile.h"
+#include "qgsdelimitedtextindexfile.h"
 
 static const QString TEXT_PROVIDER_KEY = "delimitedtext";
 static const QString TEXT_PROVIDER_DESCRIPTION = "Delimited text data provider";
@@ -313,6 +315,345 @@ bool QgsDelimitedTextProvider::createSpatialIndex()
   return true;
 }
 
+// Scanning of memory mapped files in parallel chunks.  QgsDelimitedTextFileChunkScan
+// does the per record part of scanFile() for one chunk, in a worker thread, and
+// QgsDelimitedTextFileScan merges the results of the chunks in file order.
+
+class QgsDelimitedTextFileScan;
+
+class QgsDelimitedTextFileChunkScan : public QgsDelimitedTextChunkScan
+{
+  public:
+    enum InvalidRecord
+    {
+      InvalidFormat,
+      InvalidXY
+    };
+
+    explicit QgsDelimitedTextFileChunkScan( const QgsDelimitedTextFileScan *fileScan );
+
+    virtual void addRecord( long lineOffset, QgsDelimitedTextFile::Status status, const QgsDelimitedTextRecord &record ) override;
+
+    void addInvalidRecord( long lineOffset, InvalidRecord type );
+
+    const QgsDelimitedTextFileScan *mFileScan;
+
+    long mEmptyRecords;
+    long mBadFormatRecords;
+    long mInvalidGeometry;
+    long mEmptyGeometry;
+    long mNumberFeatures;
+
+    // Extent of the points, and whether the first feature of the chunk is a point
+    QgsRectangle mExtent;
+    bool mHasPoints;
+    bool mFirstIsPoint;
+
+    QList<bool> mIsEmpty;
+    QList<bool> mCouldBeInt;
+    QList<bool> mCouldBeLongLong;
+    QList<bool> mCouldBeDouble;
+
+    // Record ids are line offsets within the chunk until merged
+    QVector<long> mSubsetIndex;
+    QVector< QPair<long, QgsPoint> > mIndexPoints;
+    QList< QPair<long, InvalidRecord> > mInvalidRecords;
+    long mExtraInvalidRecords;
+};
+
+class QgsDelimitedTextFileScan : public QgsDelimitedTextScanner
+{
+  public:
+    QgsDelimitedTextFileScan( const QgsDelimitedTextProvider *provider, bool buildSubsetIndex, bool buildSpatialIndex );
+
+    virtual QgsDelimitedTextChunkScan *createChunkScan() override;
+    virtual void mergeChunkScan( QgsDelimitedTextChunkScan *scan, long firstLine ) override;
+
+    const QgsDelimitedTextProvider *mProvider;
+    bool mBuildSubsetIndex;
+    bool mBuildSpatialIndex;
+
+    long mEmptyRecords;
+    long mBadFormatRecords;
+    long mInvalidGeometry;
+    long mEmptyGeometry;
+    long mNumberFeatures;
+    QgsRectangle mExtent;
+    bool mHasPointType;
+
+    QList<bool> mIsEmpty;
+    QList<bool> mCouldBeInt;
+    QList<bool> mCouldBeLongLong;
+    QList<bool> mCouldBeDouble;
+
+    QList<quintptr> mSubsetIndex;
+    QVector< QPair<QgsFeatureId, QgsRectangle> > mIndexEntries;
+    QStringList mInvalidLines;
+    int mExtraInvalidLines;
+};
+
+QgsDelimitedTextFileChunkScan::QgsDelimitedTextFileChunkScan( const QgsDelimitedTextFileScan *fileScan )
+    : mFileScan( fileScan )
+    , mEmptyRecords( 0 )
+    , mBadFormatRecords( 0 )
+    , mInvalidGeometry( 0 )
+    , mEmptyGeometry( 0 )
+    , mNumberFeatures( 0 )
+    , mHasPoints( false )
+    , mFirstIsPoint( false )
+    , mExtraInvalidRecords( 0 )
+{
+}
+
+void QgsDelimitedTextFileChunkScan::addInvalidRecord( long lineOffset, InvalidRecord type )
+{
+  if ( mInvalidRecords.size() < mFileScan->mProvider->mMaxInvalidLines )
+    mInvalidRecords.append( qMakePair( lineOffset, type ) );
+  else
+    mExtraInvalidRecords++;
+}
+
+void QgsDelimitedTextFileChunkScan::addRecord( long lineOffset, QgsDelimitedTextFile::Status status, const QgsDelimitedTextRecord &record )
+{
+  const QgsDelimitedTextProvider *provider = mFileScan->mProvider;
+
+  if ( status != QgsDelimitedTextFile::RecordOk )
+  {
+    mBadFormatRecords++;
+    addInvalidRecord( lineOffset, InvalidFormat );
+    return;
+  }
+  // Skip over empty records
+  if ( record.isEmpty() )
+  {
+    mEmptyRecords++;
+    return;
+  }
+
+  if ( provider->mGeomRep == QgsDelimitedTextProvider::GeomAsXy )
+  {
+    if ( record.isFieldEmpty( provider->mXFieldIndex ) && record.isFieldEmpty( provider->mYFieldIndex ) )
+    {
+      mEmptyGeometry++;
+      mNumberFeatures++;
+    }
+    else
+    {
+      QgsPoint pt;
+      if ( ! QgsDelimitedTextProvider::pointFromXY( record, provider->mXFieldIndex, provider->mYFieldIndex, pt, provider->mDecimalPoint, provider->mXyDms ) )
+      {
+        mInvalidGeometry++;
+        addInvalidRecord( lineOffset, InvalidXY );
+        return;
+      }
+
+      if ( mHasPoints )
+      {
+        mExtent.combineExtentWith( pt.x(), pt.y() );
+      }
+      else
+      {
+        mExtent.set( pt.x(), pt.y(), pt.x(), pt.y() );
+        mHasPoints = true;
+        mFirstIsPoint = mNumberFeatures == 0;
+      }
+      mNumberFeatures++;
+      if ( mFileScan->mBuildSpatialIndex && qIsFinite( pt.x() ) && qIsFinite( pt.y() ) )
+        mIndexPoints.append( qMakePair( lineOffset, pt ) );
+    }
+  }
+  else
+  {
+    mNumberFeatures++;
+  }
+
+  if ( mFileScan->mBuildSubsetIndex ) mSubsetIndex.append( lineOffset );
+
+  // Assess the potential types of each column, as in scanFile()
+  for ( int i = 0; i < record.size(); i++ )
+  {
+    if ( record.isFieldEmpty( i ) )
+      continue;
+
+    while ( mCouldBeInt.size() <= i )
+    {
+      mIsEmpty.append( true );
+      mCouldBeInt.append( false );
+      mCouldBeLongLong.append( false );
+      mCouldBeDouble.append( false );
+    }
+
+    if ( mIsEmpty[i] )
+    {
+      mIsEmpty[i] = false;
+      mCouldBeInt[i] = true;
+      mCouldBeLongLong[i] = true;
+      mCouldBeDouble[i] = true;
+    }
+
+    if ( mCouldBeInt[i] )
+    {
+      int value;
+      mCouldBeInt[i] = record.toInt( i, value );
+    }
+
+    if ( mCouldBeLongLong[i] && ! mCouldBeInt[i] )
+    {
+      qlonglong value;
+      mCouldBeLongLong[i] = record.toLongLong( i, value );
+    }
+
+    if ( mCouldBeDouble[i] && ! mCouldBeLongLong[i] )
+    {
+      double value;
+      mCouldBeDouble[i] = record.toDouble( i, value, provider->mDecimalPoint );
+    }
+  }
+}
+
+QgsDelimitedTextFileScan::QgsDelimitedTextFileScan( const QgsDelimitedTextProvider *provider, bool buildSubsetIndex, bool buildSpatialIndex )
+    : mProvider( provider )
+    , mBuildSubsetIndex( buildSubsetIndex )
+    , mBuildSpatialIndex( buildSpatialIndex )
+    , mEmptyRecords( 0 )
+    , mBadFormatRecords( 0 )
+    , mInvalidGeometry( 0 )
+    , mEmptyGeometry( 0 )
+    , mNumberFeatures( 0 )
+    , mHasPointType( false )
+    , mExtraInvalidLines( 0 )
+{
+}
+
+QgsDelimitedTextChunkScan *QgsDelimitedTextFileScan::createChunkScan()
+{
+  return new QgsDelimitedTextFileChunkScan( this );
+}
+
+void QgsDelimitedTextFileScan::mergeChunkScan( QgsDelimitedTextChunkScan *scan, long firstLine )
+{
+  QgsDelimitedTextFileChunkScan *chunk = static_cast<QgsDelimitedTextFileChunkScan *>( scan );
+
+  mEmptyRecords += chunk->mEmptyRecords;
+  mBadFormatRecords += chunk->mBadFormatRecords;
+  mInvalidGeometry += chunk->mInvalidGeometry;
+  mEmptyGeometry += chunk->mEmptyGeometry;
+
+  for ( int i = 0; i < chunk->mInvalidRecords.size(); i++ )
+  {
+    if ( mInvalidLines.size() >= mProvider->mMaxInvalidLines )
+    {
+      mExtraInvalidLines++;
+      continue;
+    }
+    long recordId = firstLine + chunk->mInvalidRecords.at( i ).first;
+    if ( chunk->mInvalidRecords.at( i ).second == QgsDelimitedTextFileChunkScan::InvalidFormat )
+      mInvalidLines.append( QgsDelimitedTextProvider::tr( "Invalid record format at line %1" ).arg( recordId ) );
+    else
+      mInvalidLines.append( QgsDelimitedTextProvider::tr( "Invalid X or Y fields at line %1" ).arg( recordId ) );
+  }
+  mExtraInvalidLines += chunk->mExtraInvalidRecords;
+
+  // As for a sequential scan the extent starts with the first feature, which
+  // might have an empty geometry.
+  if ( chunk->mHasPoints )
+  {
+    if ( mNumberFeatures == 0 && chunk->mFirstIsPoint )
+    {
+      mExtent = chunk->mExtent;
+      mHasPointType = true;
+    }
+    else
+    {
+      mExtent.combineExtentWith( &chunk->mExtent );
+    }
+  }
+  mNumberFeatures += chunk->mNumberFeatures;
+
+  for ( int i = 0; i < chunk->mIsEmpty.size(); i++ )
+  {
+    while ( mIsEmpty.size() <= i )
+    {
+      mIsEmpty.append( true );
+      mCouldBeInt.append( false );
+      mCouldBeLongLong.append( false );
+      mCouldBeDouble.append( false );
+    }
+    if ( chunk->mIsEmpty.at( i ) )
+      continue;
+    if ( mIsEmpty.at( i ) )
+    {
+      mIsEmpty[i] = false;
+      mCouldBeInt[i] = chunk->mCouldBeInt.at( i );
+      mCouldBeLongLong[i] = chunk->mCouldBeLongLong.at( i );
+      mCouldBeDouble[i] = chunk->mCouldBeDouble.at( i );
+    }
+    else
+    {
+      mCouldBeInt[i] = mCouldBeInt.at( i ) && chunk->mCouldBeInt.at( i );
+      mCouldBeLongLong[i] = mCouldBeLongLong.at( i ) && chunk->mCouldBeLongLong.at( i );
+      mCouldBeDouble[i] = mCouldBeDouble.at( i ) && chunk->mCouldBeDouble.at( i );
+    }
+  }
+
+  for ( int i = 0; i < chunk->mSubsetIndex.size(); i++ )
+    mSubsetIndex.append( firstLine + chunk->mSubsetIndex.at( i ) );
+
+  for ( int i = 0; i < chunk->mIndexPoints.size(); i++ )
+  {
+    const QgsPoint &pt = chunk->mIndexPoints.at( i ).second;
+    mIndexEntries.append( qMakePair( QgsFeatureId( firstLine + chunk->mIndexPoints.at( i ).first ), QgsRectangle( pt, pt ) ) );
+  }
+}
+
+namespace
+{
+  // Feeds the bounding boxes found by a scan, or read from the index file, to
+  // the bulk loading of the spatial index
+  class QgsDelimitedTextIndexIterator : public QgsAbstractFeatureIterator
+  {
+    public:
+      explicit QgsDelimitedTextIndexIterator( const QVector< QPair<QgsFeatureId, QgsRectangle> > &entries )
+          : QgsAbstractFeatureIterator( QgsFeatureRequest() )
+          , mEntries( entries )
+          , mNext( 0 )
+      {
+      }
+
+      virtual bool rewind() override
+      {
+        mNext = 0;
+        return true;
+      }
+
+      virtual bool close() override
+      {
+        mClosed = true;
+        return true;
+      }
+
+    protected:
+      virtual bool fetchFeature( QgsFeature &feature ) override
+      {
+        if ( mNext >= mEntries.size() )
+          return false;
+        const QgsRectangle &rect = mEntries.at( mNext ).second;
+        feature.setFeatureId( mEntries.at( mNext ).first );
+        if ( rect.width() == 0 && rect.height() == 0 )
+          feature.setGeometry( QgsGeometry::fromPoint( rect.center() ) );
+        else
+          feature.setGeometry( QgsGeometry::fromRect( rect ) );
+        feature.setValid( true );
+        mNext++;
+        return true;
+      }
+
+    private:
+      QVector< QPair<QgsFeatureId, QgsRectangle> > mEntries;
+      int mNext;
+  };
+}
+
 // Really want to merge scanFile and rescan into single code.  Currently the reason
 // this is not done is that scanFile is done initially to create field names and, rescan
 // file includes building subset expression and assumes field names/types are already
@@ -410,7 +751,88 @@ void QgsDelimitedTextProvider::scanFile( bool buildIndexes )
   QList<bool> couldBeLongLong;
   QList<bool> couldBeDouble;
 
-  while ( true )
+  // Bounding boxes of the features, bulk loaded into the spatial index
+  QVector< QPair<QgsFeatureId, QgsRectangle> > spatialIndexEntries;
+
+  // Reuse the results of the last scan if neither the file nor the layer
+  // definition have changed since.  The subset expression is applied after
+  // the scan, so is not part of the definition.
+
+  QUrl url = QUrl::fromEncoded( dataSourceUri().toAscii() );
+  url.removeAllQueryItems( "subset" );
+  url.removeAllQueryItems( "quiet" );
+  QString indexKey = QString::fromAscii( url.toEncoded() );
+
+  QgsDelimitedTextIndexFile indexFile;
+  bool fromIndexFile = indexFile.read( mFile->fileName(), indexKey )
+                       && ( indexFile.mHasSubsetIndex || ! buildSubsetIndex )
+                       && ( indexFile.mHasSpatialIndex || ! buildSpatialIndex );
+  bool scanned = fromIndexFile;
+  if ( fromIndexFile )
+  {
+    QgsDebugMsg( "Using index file for " + mFile->fileName() );
+    nEmptyRecords = indexFile.mEmptyRecords;
+    nBadFormatRecords = indexFile.mBadFormatRecords;
+    nIncompatibleGeometry = indexFile.mIncompatibleGeometry;
+    nInvalidGeometry = indexFile.mInvalidGeometry;
+    nEmptyGeometry = indexFile.mEmptyGeometry;
+    mNumberFeatures = indexFile.mNumberFeatures;
+    mExtent = indexFile.mExtent;
+    mWkbType = ( QGis::WkbType ) indexFile.mWkbType;
+    mGeometryType = ( QGis::GeometryType ) indexFile.mGeometryType;
+    mWktHasPrefix = indexFile.mWktHasPrefix;
+    mWktHasZM = indexFile.mWktHasZM;
+    isEmpty = indexFile.mIsEmpty;
+    couldBeInt = indexFile.mCouldBeInt;
+    couldBeLongLong = indexFile.mCouldBeLongLong;
+    couldBeDouble = indexFile.mCouldBeDouble;
+    mInvalidLines = indexFile.mInvalidLines;
+    mNExtraInvalidLines = indexFile.mExtraInvalidLines;
+    if ( buildSubsetIndex ) mSubsetIndex = indexFile.mSubsetIndex;
+    if ( buildSpatialIndex ) spatialIndexEntries = indexFile.mSpatialIndex;
+
+    mFile->setScanCounts( indexFile.mMaxFieldCount, indexFile.mRecordCount );
+    if ( ! indexFile.mLineIndex.isEmpty() )
+      mFile->setLineIndex( indexFile.mLineIndex, QFileInfo( mFile->fileName() ).size() );
+  }
+
+  // Memory mapped files are scanned in parallel chunks.  WKT geometries are
+  // always scanned sequentially, as the geometry type of the layer is taken from
+  // the first valid geometry and later geometries of other types are discarded.
+
+  if ( ! scanned && mGeomRep != GeomAsWkt )
+  {
+    QgsDelimitedTextFileScan scan( this, buildSubsetIndex, buildSpatialIndex );
+    scanned = mFile->scanRecords( scan );
+    if ( scanned )
+    {
+      nEmptyRecords = scan.mEmptyRecords;
+      nBadFormatRecords = scan.mBadFormatRecords;
+      nInvalidGeometry = scan.mInvalidGeometry;
+      nEmptyGeometry = scan.mEmptyGeometry;
+      mNumberFeatures = scan.mNumberFeatures;
+      mExtent = scan.mExtent;
+      if ( scan.mHasPointType )
+      {
+        mWkbType = QGis::WKBPoint;
+        mGeometryType = QGis::Point;
+      }
+      else if ( mGeomRep == GeomNone && mNumberFeatures > 0 )
+      {
+        mWkbType = QGis::WKBNoGeometry;
+      }
+      isEmpty = scan.mIsEmpty;
+      couldBeInt = scan.mCouldBeInt;
+      couldBeLongLong = scan.mCouldBeLongLong;
+      couldBeDouble = scan.mCouldBeDouble;
+      mSubsetIndex = scan.mSubsetIndex;
+      mInvalidLines = scan.mInvalidLines;
+      mNExtraInvalidLines = scan.mExtraInvalidLines;
+      spatialIndexEntries = scan.mIndexEntries;
+    }
+  }
+
+  while ( ! scanned )
   {
     QgsDelimitedTextFile::Status status = mFile->nextRecord( parts );
     if ( status == QgsDelimitedTextFile::RecordEOF ) break;
@@ -473,13 +895,7 @@ void QgsDelimitedTextProvider::scanFile( bool buildIndexes )
               }
               if ( buildSpatialIndex )
               {
-                QgsFeature f;
-                f.setFeatureId( mFile->recordId() );
-                f.setGeometry( geom );
-                mSpatialIndex->insertFeature( f );
-                // Feature now has ownership of geometry, so set to null
-                // here to avoid deleting twice.
-                geom = 0;
+                spatialIndexEntries.append( qMakePair( QgsFeatureId( mFile->recordId() ), geom->boundingBox() ) );
               }
             }
             else
@@ -531,10 +947,7 @@ void QgsDelimitedTextProvider::scanFile( bool buildIndexes )
           mNumberFeatures++;
           if ( buildSpatialIndex && qIsFinite( pt.x() ) && qIsFinite( pt.y() ) )
           {
-            QgsFeature f;
-            f.setFeatureId( mFile->recordId() );
-            f.setGeometry( QgsGeometry::fromPoint( pt ) );
-            mSpatialIndex->insertFeature( f );
+            spatialIndexEntries.append( qMakePair( QgsFeatureId( mFile->recordId() ), QgsRectangle( pt, pt ) ) );
           }
         }
         else
@@ -612,6 +1025,45 @@ void QgsDelimitedTextProvider::scanFile( bool buildIndexes )
     }
   }
 
+  // Bulk load the spatial index, which needs at least one entry
+
+  if ( buildSpatialIndex && ! spatialIndexEntries.isEmpty() )
+  {
+    delete mSpatialIndex;
+    mSpatialIndex = new QgsSpatialIndex( QgsFeatureIterator( new QgsDelimitedTextIndexIterator( spatialIndexEntries ) ) );
+  }
+
+  // Save the results of the scan for the next time the file is opened
+
+  if ( ! fromIndexFile && mGeometryType != QGis::UnknownGeometry )
+  {
+    indexFile.mEmptyRecords = nEmptyRecords;
+    indexFile.mBadFormatRecords = nBadFormatRecords;
+    indexFile.mIncompatibleGeometry = nIncompatibleGeometry;
+    indexFile.mInvalidGeometry = nInvalidGeometry;
+    indexFile.mEmptyGeometry = nEmptyGeometry;
+    indexFile.mNumberFeatures = mNumberFeatures;
+    indexFile.mExtent = mExtent;
+    indexFile.mWkbType = mWkbType;
+    indexFile.mGeometryType = mGeometryType;
+    indexFile.mWktHasPrefix = mWktHasPrefix;
+    indexFile.mWktHasZM = mWktHasZM;
+    indexFile.mIsEmpty = isEmpty;
+    indexFile.mCouldBeInt = couldBeInt;
+    indexFile.mCouldBeLongLong = couldBeLongLong;
+    indexFile.mCouldBeDouble = couldBeDouble;
+    indexFile.mInvalidLines = mInvalidLines;
+    indexFile.mExtraInvalidLines = mNExtraInvalidLines;
+    indexFile.mMaxFieldCount = mFile->fieldNames().size();
+    indexFile.mRecordCount = mFile->recordCount();
+    indexFile.mLineIndex = mFile->lineIndex();
+    indexFile.mHasSubsetIndex = buildSubsetIndex;
+    indexFile.mSubsetIndex = mSubsetIndex;
+    indexFile.mHasSpatialIndex = buildSpatialIndex;
+    indexFile.mSpatialIndex = spatialIndexEntries;
+    indexFile.write( mFile->fileName(), indexKey );
+  }
+
   // Now create the attribute fields.  Field types are integer by preference,
   // failing that double, failing that text.
 
@@ -897,6 +1349,26 @@ bool QgsDelimitedTextProvider::pointFromXY( QString &sX, QString &sY, QgsPoint &
   return false;
 }
 
+bool QgsDelimitedTextProvider::pointFromXY( const QgsDelimitedTextRecord &record, int xIndex, int yIndex, QgsPoint &pt, const QString& decimalPoint, bool xyDms )
+{
+  if ( xyDms )
+  {
+    QString sX = record.string( xIndex );
+    QString sY = record.string( yIndex );
+    return pointFromXY( sX, sY, pt, decimalPoint, xyDms );
+  }
+
+  // Convert the coordinates straight from the bytes of the record
+  double x, y;
+  if ( record.toDouble( xIndex, x, decimalPoint ) && record.toDouble( yIndex, y, decimalPoint ) )
+  {
+    pt.setX( x );
+    pt.setY( y );
+    return true;
+  }
+  return false;
+}
+
 QString QgsDelimitedTextProvider::storageType() const
 {
   return "Delimited text file";
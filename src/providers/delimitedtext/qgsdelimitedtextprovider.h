@@ -32,6 +32,8 @@ class QFile;
 class QTextStream;
 
 class QgsDelimitedTextFeatureIterator;
+class QgsDelimitedTextFileScan;
+class QgsDelimitedTextFileChunkScan;
 class QgsExpression;
 class QgsSpatialIndex;
 
@@ -233,6 +235,7 @@ class QgsDelimitedTextProvider : public QgsVectorDataProvider
 
     static QgsGeometry *geomFromWkt( QString &sWkt, bool wktHasPrefixRegexp, bool wktHasZM );
     static bool pointFromXY( QString &sX, QString &sY, QgsPoint &point, const QString& decimalPoint, bool xyDms );
+    static bool pointFromXY( const QgsDelimitedTextRecord &record, int xIndex, int yIndex, QgsPoint &point, const QString& decimalPoint, bool xyDms );
     static double dmsStringToDouble( const QString &sX, bool *xOk );
 
     // mLayerValid defines whether the layer has been loaded as a valid layer
@@ -318,6 +321,8 @@ class QgsDelimitedTextProvider : public QgsVectorDataProvider
 
     friend class QgsDelimitedTextFeatureIterator;
     friend class QgsDelimitedTextFeatureSource;
+    friend class QgsDelimitedTextFileScan;
+    friend class QgsDelimitedTextFileChunkScan;
 };
 
 #endif
@@ -94,6 +94,44 @@ int CPL_STDCALL progressCallback( double dfComplete,
   return true;
 }
 
+//
+// GDAL keeps computed statistics in the PAM (.aux.xml) but cannot tell exact cached
+// statistics from approximate ones, see https://trac.osgeo.org/gdal/ticket/4857.
+// Exact statistics are therefore marked with a copy of their values in a metadata
+// item, cached statistics are exact as long as they match the copy.
+//
+static const char *EXACT_STATISTICS_ITEM = "QGIS_EXACT_STATISTICS";
+
+static void markExactStatistics( GDALRasterBandH theBand, double theMin, double theMax, double theMean, double theStdDev )
+{
+  QString myValues = QString( "%1 %2 %3 %4" )
+                     .arg( theMin, 0, 'g', 17 ).arg( theMax, 0, 'g', 17 )
+                     .arg( theMean, 0, 'g', 17 ).arg( theStdDev, 0, 'g', 17 );
+  GDALSetMetadataItem( theBand, EXACT_STATISTICS_ITEM, myValues.toUtf8().constData(), NULL );
+}
+
+static bool isExactStatistics( GDALRasterBandH theBand, double theMin, double theMax, double theMean, double theStdDev )
+{
+  const char *myItem = GDALGetMetadataItem( theBand, EXACT_STATISTICS_ITEM, NULL );
+  if ( !myItem )
+    return false;
+
+  QStringList myValues = QString( myItem ).split( ' ' );
+  if ( myValues.size() != 4 )
+    return false;
+
+  // cached values are stored as text => compare significant digits
+  double myCached[] = { theMin, theMax, theMean, theStdDev };
+  for ( int i = 0; i < 4; i++ )
+  {
+    bool ok;
+    double myValue = myValues[i].toDouble( &ok );
+    if ( !ok || !qgsDoubleNearSig( myValue, myCached[i], 10 ) )
+      return false;
+  }
+  return true;
+}
+
 QgsGdalProvider::QgsGdalProvider( const QString &uri, QgsError error )
     : QgsRasterDataProvider( uri )
     , mUpdate( false )
@@ -2281,8 +2319,12 @@ bool QgsGdalProvider::hasStatistics( int theBandNo,
   // (from all raster pixels) are not available/cached, it should return CE_Warning.
   // Instead, it is giving estimated (from sample) cached statistics and it returns CE_None.
   // see above and https://trac.osgeo.org/gdal/ticket/4857
-  // -> Cannot used cached GDAL stats for exact
-  if ( !bApproxOK ) return false;
+  // -> Cached GDAL stats are only exact if marked by bandStatistics()
+  if ( !bApproxOK )
+  {
+    return GDALGetRasterStatistics( myGdalBand, false, false, &dfMin, &dfMax, &dfMean, &dfStdDev ) == CE_None &&
+           isExactStatistics( myGdalBand, dfMin, dfMax, dfMean, dfStdDev );
+  }
 
   CPLErr myerval = GDALGetRasterStatistics( myGdalBand, bApproxOK, true, pdfMin, pdfMax, pdfMean, pdfStdDev );
 
@@ -2369,20 +2411,32 @@ QgsRasterBandStats QgsGdalProvider::bandStatistics( int theBandNo, int theStats,
   // try to fetch the cached stats (bForce=FALSE)
   // GDALGetRasterStatistics() do not work correctly with bApproxOK=false and bForce=false/true
   // see above and https://trac.osgeo.org/gdal/ticket/4857
-  // -> Cannot used cached GDAL stats for exact
+  // -> Cached GDAL stats are only used for exact if marked as exact
 
   CPLErr myerval =
-    GDALGetRasterStatistics( myGdalBand, bApproxOK, true, &pdfMin, &pdfMax, &pdfMean, &pdfStdDev );
+    GDALGetRasterStatistics( myGdalBand, bApproxOK, bApproxOK, &pdfMin, &pdfMax, &pdfMean, &pdfStdDev );
 
   QgsDebugMsg( QString( "myerval = %1" ).arg( myerval ) );
 
+  if ( !bApproxOK && CE_None == myerval && !isExactStatistics( myGdalBand, pdfMin, pdfMax, pdfMean, pdfStdDev ) )
+  {
+    QgsDebugMsg( "Cached GDAL statistics are not exact" );
+    myerval = CE_Warning;
+  }
+
   // if cached stats are not found, compute them
-  if ( !bApproxOK || CE_None != myerval )
+  if ( CE_None != myerval )
   {
     QgsDebugMsg( "Calculating statistics by GDAL" );
     myerval = GDALComputeRasterStatistics( myGdalBand, bApproxOK,
                                            &pdfMin, &pdfMax, &pdfMean, &pdfStdDev,
                                            progressCallback, &myProg );
+
+    // statistics are written to the PAM with the dataset, so they are reused by other sessions
+    if ( !bApproxOK && CE_None == myerval )
+    {
+      markExactStatistics( myGdalBand, pdfMin, pdfMax, pdfMean, pdfStdDev );
+    }
   }
   else
   {
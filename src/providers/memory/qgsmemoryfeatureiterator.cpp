@@ -15,16 +15,19 @@
 #include "qgsmemoryfeatureiterator.h"
 #include "qgsmemoryprovider.h"
 
+#include "qgsfeaturebatch.h"
 #include "qgsgeometry.h"
 #include "qgslogger.h"
-#include "qgsspatialindex.h"
 #include "qgsmessagelog.h"
 
+#include <QScopedPointer>
+
 
 
 QgsMemoryFeatureIterator::QgsMemoryFeatureIterator( QgsMemoryFeatureSource* source, bool ownSource, const QgsFeatureRequest& request )
     : QgsAbstractFeatureIteratorFromSource<QgsMemoryFeatureSource>( source, ownSource, request )
     , mSelectRectGeom( 0 )
+    , mPosition( 0 )
     , mSubsetExpression( 0 )
 {
   if ( !mSource->mSubsetString.isEmpty() )
@@ -38,24 +41,26 @@ QgsMemoryFeatureIterator::QgsMemoryFeatureIterator( QgsMemoryFeatureSource* sour
     mSelectRectGeom = QgsGeometry::fromRect( request.filterRect() );
   }
 
-  // if there's spatial index, use it!
-  // (but don't use it when selection rect is not specified)
-  if ( !mRequest.filterRect().isNull() && mSource->mSpatialIndex )
+  if ( mRequest.filterType() == QgsFeatureRequest::FilterFid )
   {
-    mUsingFeatureIdList = true;
-    mFeatureIdList = mSource->mSpatialIndex->intersects( mRequest.filterRect() );
-    QgsDebugMsg( "Features returned by spatial index: " + QString::number( mFeatureIdList.count() ) );
+    // a selection rect is checked against the bounding box, exactly in acceptRow()
+    mUsingRowList = true;
+    const QgsMemoryFeatureStore& features = mSource->mFeatures;
+    int row = features.row( mRequest.filterFid() );
+    if ( row >= 0 && ( mRequest.filterRect().isNull() ||
+                       ( features.hasGeometry( row ) && features.boundingBox( row ).intersects( mRequest.filterRect() ) ) ) )
+      mRowList.append( row );
   }
-  else if ( mRequest.filterType() == QgsFeatureRequest::FilterFid )
+  else if ( !mRequest.filterRect().isNull() )
   {
-    mUsingFeatureIdList = true;
-    QgsFeatureMap::const_iterator it = mSource->mFeatures.find( mRequest.filterFid() );
-    if ( it != mSource->mFeatures.end() )
-      mFeatureIdList.append( mRequest.filterFid() );
+    // the spatial index is always there, use it when a selection rect is specified
+    mUsingRowList = true;
+    mRowList = mSource->mFeatures.intersects( mRequest.filterRect() );
+    QgsDebugMsg( "Features returned by spatial index: " + QString::number( mRowList.count() ) );
   }
   else
   {
-    mUsingFeatureIdList = false;
+    mUsingRowList = false;
   }
 
   rewind();
@@ -76,111 +81,91 @@ bool QgsMemoryFeatureIterator::fetchFeature( QgsFeature& feature )
   if ( mClosed )
     return false;
 
-  if ( mUsingFeatureIdList )
-    return nextFeatureUsingList( feature );
-  else
-    return nextFeatureTraverseAll( feature );
+  int row = nextRow();
+  if ( row < 0 )
+  {
+    close();
+    return false;
+  }
+
+  mSource->mFeatures.feature( row, feature, !( mRequest.flags() & QgsFeatureRequest::NoGeometry ) );
+  feature.setFields( mSource->mFields ); // allow name-based attribute lookups
+  return true;
 }
 
 
-bool QgsMemoryFeatureIterator::nextFeatureUsingList( QgsFeature& feature )
+int QgsMemoryFeatureIterator::fetchFeatures( QgsFeatureBatch& batch, int maxCount )
 {
-  bool hasFeature = false;
-
-  // option 1: we have a list of features to traverse
-  while ( mFeatureIdListIterator != mFeatureIdList.constEnd() )
-  {
-    if ( !mRequest.filterRect().isNull() && mRequest.flags() & QgsFeatureRequest::ExactIntersect )
-    {
-      // do exact check in case we're doing intersection
-      if ( mSource->mFeatures[*mFeatureIdListIterator].geometry() && mSource->mFeatures[*mFeatureIdListIterator].geometry()->intersects( mSelectRectGeom ) )
-        hasFeature = true;
-    }
-    else
-      hasFeature = true;
-
-    if ( mSubsetExpression )
-    {
-      mSource->mExpressionContext.setFeature( mSource->mFeatures[*mFeatureIdListIterator] );
-      if ( !mSubsetExpression->evaluate( &mSource->mExpressionContext ).toBool() )
-        hasFeature = false;
-    }
-
-    if ( hasFeature )
-      break;
+  if ( mClosed )
+    return 0;
 
-    ++mFeatureIdListIterator;
-  }
+  batch.setFields( mSource->mFields );
+  bool fetchGeometry = !( mRequest.flags() & QgsFeatureRequest::NoGeometry );
 
-  // copy feature
-  if ( hasFeature )
+  int row;
+  while ( batch.size() < maxCount && ( row = nextRow() ) >= 0 )
   {
-    feature = mSource->mFeatures[*mFeatureIdListIterator];
-    ++mFeatureIdListIterator;
+    mSource->mFeatures.addToBatch( row, batch, fetchGeometry );
   }
-  else
-    close();
 
-  if ( hasFeature )
-    feature.setFields( mSource->mFields ); // allow name-based attribute lookups
+  if ( batch.isEmpty() )
+    close();
 
-  return hasFeature;
+  return batch.size();
 }
 
 
-bool QgsMemoryFeatureIterator::nextFeatureTraverseAll( QgsFeature& feature )
+int QgsMemoryFeatureIterator::nextRow()
 {
-  bool hasFeature = false;
+  const QgsMemoryFeatureStore& features = mSource->mFeatures;
 
-  // option 2: traversing the whole layer
-  while ( mSelectIterator != mSource->mFeatures.constEnd() )
+  for ( ;; )
   {
-    if ( mRequest.filterRect().isNull() )
+    int row;
+    if ( mUsingRowList )
     {
-      // selection rect empty => using all features
-      hasFeature = true;
+      // option 1: we have a list of rows to traverse
+      if ( mPosition >= mRowList.size() )
+        return -1;
+      row = mRowList.at( mPosition++ );
     }
     else
     {
-      if ( mRequest.flags() & QgsFeatureRequest::ExactIntersect )
-      {
-        // using exact test when checking for intersection
-        if ( mSelectIterator->constGeometry() && mSelectIterator->constGeometry()->intersects( mSelectRectGeom ) )
-          hasFeature = true;
-      }
-      else
-      {
-        // check just bounding box against rect when not using intersection
-        if ( mSelectIterator->constGeometry() && mSelectIterator->constGeometry()->boundingBox().intersects( mRequest.filterRect() ) )
-          hasFeature = true;
-      }
+      // option 2: traversing the whole layer
+      if ( mPosition >= features.rowCount() )
+        return -1;
+      row = mPosition++;
+      if ( features.isDeleted( row ) )
+        continue;
     }
 
-    if ( mSubsetExpression )
-    {
-      mSource->mExpressionContext.setFeature( *mSelectIterator );
-      if ( !mSubsetExpression->evaluate( &mSource->mExpressionContext ).toBool() )
-        hasFeature = false;
-    }
+    if ( acceptRow( row ) )
+      return row;
+  }
+}
 
-    if ( hasFeature )
-      break;
 
-    ++mSelectIterator;
+bool QgsMemoryFeatureIterator::acceptRow( int row )
+{
+  if ( mSelectRectGeom )
+  {
+    // do exact check in case we're doing intersection
+    QScopedPointer<QgsGeometry> geometry( mSource->mFeatures.geometry( row ) );
+    if ( !geometry || !geometry->intersects( mSelectRectGeom ) )
+      return false;
   }
 
-  // copy feature
-  if ( hasFeature )
+  if ( mSubsetExpression )
   {
-    feature = mSelectIterator.value();
-    ++mSelectIterator;
-    feature.setValid( true );
-    feature.setFields( mSource->mFields ); // allow name-based attribute lookups
+    QgsFeature feature;
+    mSource->mFeatures.feature( row, feature );
+    feature.setFields( mSource->mFields );
+    mSource->mExpressionContext.setFeature( feature );
+    if ( !mSubsetExpression->evaluate( &mSource->mExpressionContext ).toBool() )
+      return false;
   }
-  else
-    close();
 
-  return hasFeature;
+  return true;
 }
 
 bool QgsMemoryFeatureIterator::rewind()
@@ -188,10 +173,7 @@ bool QgsMemoryFeatureIterator::rewind()
   if ( mClosed )
     return false;
 
-  if ( mUsingFeatureIdList )
-    mFeatureIdListIterator = mFeatureIdList.constBegin();
-  else
-    mSelectIterator = mSource->mFeatures.constBegin();
+  mPosition = 0;
 
   return true;
 }
@@ -214,8 +196,7 @@ bool QgsMemoryFeatureIterator::close()
 
 QgsMemoryFeatureSource::QgsMemoryFeatureSource( const QgsMemoryProvider* p )
     : mFields( p->mFields )
-    , mFeatures( p->mFeatures )
-    , mSpatialIndex( p->mSpatialIndex ? new QgsSpatialIndex( *p->mSpatialIndex ) : 0 )  // just shallow copy
+    , mFeatures( p->mFeatures )  // implicitly shared
     , mSubsetString( p->mSubsetString )
 {
   mExpressionContext << QgsExpressionContextUtils::globalScope()
@@ -225,7 +206,6 @@ QgsMemoryFeatureSource::QgsMemoryFeatureSource( const QgsMemoryProvider* p )
 
 QgsMemoryFeatureSource::~QgsMemoryFeatureSource()
 {
-  delete mSpatialIndex;
 }
 
 QgsFeatureIterator QgsMemoryFeatureSource::getFeatures( const QgsFeatureRequest& request )
@@ -17,13 +17,10 @@
 
 #include "qgsfeatureiterator.h"
 #include "qgsexpressioncontext.h"
+#include "qgsmemoryfeaturestore.h"
 
 class QgsMemoryProvider;
 
-typedef QMap<QgsFeatureId, QgsFeature> QgsFeatureMap;
-
-class QgsSpatialIndex;
-
 
 class QgsMemoryFeatureSource : public QgsAbstractFeatureSource
 {
@@ -35,8 +32,7 @@ class QgsMemoryFeatureSource : public QgsAbstractFeatureSource
 
   protected:
     QgsFields mFields;
-    QgsFeatureMap mFeatures;
-    QgsSpatialIndex* mSpatialIndex;
+    QgsMemoryFeatureStore mFeatures;
     QString mSubsetString;
     QgsExpressionContext mExpressionContext;
 
@@ -62,14 +58,22 @@ class QgsMemoryFeatureIterator : public QgsAbstractFeatureIteratorFromSource<Qgs
     //! fetch next feature, return true on success
     virtual bool fetchFeature( QgsFeature& feature ) override;
 
-    bool nextFeatureUsingList( QgsFeature& feature );
-    bool nextFeatureTraverseAll( QgsFeature& feature );
+    //! copy features straight from the feature store into the batch
+    virtual int fetchFeatures( QgsFeatureBatch& batch, int maxCount ) override;
+    virtual bool providesBatches() const override { return true; }
+
+    //! returns the next row of the traversal, or -1 at the end
+    int nextRow();
+
+    //! returns whether the row passes the exact intersection test and the subset expression
+    bool acceptRow( int row );
 
     QgsGeometry* mSelectRectGeom;
-    QgsFeatureMap::const_iterator mSelectIterator;
-    bool mUsingFeatureIdList;
-    QList<QgsFeatureId> mFeatureIdList;
-    QList<QgsFeatureId>::const_iterator mFeatureIdListIterator;
+    //! rows found by the spatial index or the feature id filter
+    bool mUsingRowList;
+    QVector<int> mRowList;
+    //! position in the row list, or row of the traversal of all rows
+    int mPosition;
     QgsExpression* mSubsetExpression;
 
 };
@@ -0,0 +1,695 @@
+/***************************************************************************
+    qgsmemoryfeaturestore.cpp
+    ---------------------
+    begin                : October 2015
+    copyright            : (C) 2015 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include "qgsmemoryfeaturestore.h"
+
+#include "qgsfeaturebatch.h"
+#include "qgsgeometry.h"
+#include "qgslogger.h"
+
+#include <QDate>
+#include <QPair>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+
+const int QgsMemoryFeatureStore::sBlockSize = 4 * 1024 * 1024;
+const int QgsMemoryFeatureStore::sNodeSize = 16;
+
+namespace
+{
+  /** Converts a value to an integer unless that would truncate or round it,
+   * which QVariant::toLongLong() does silently */
+  bool toExactInteger( const QVariant& value, qint64& result )
+  {
+    switch ( value.type() )
+    {
+      case QVariant::Int:
+      case QVariant::UInt:
+      case QVariant::LongLong:
+        result = value.toLongLong();
+        return true;
+      case QVariant::ULongLong:
+        result = value.toLongLong();
+        return value.toULongLong() <= ( quint64 ) std::numeric_limits<qint64>::max();
+      case QVariant::Double:
+      {
+        // 2^63 is the first double beyond the range of qint64
+        double d = value.toDouble();
+        if ( d != std::floor( d ) || d < -9223372036854775808.0 || d >= 9223372036854775808.0 )
+          return false;
+        result = ( qint64 ) d;
+        return true;
+      }
+      case QVariant::String:
+      {
+        bool ok;
+        result = value.toString().trimmed().toLongLong( &ok );
+        return ok;
+      }
+      default:
+        return false;
+    }
+  }
+
+  //! Converts a value to a double unless that would round it
+  bool toExactDouble( const QVariant& value, double& result )
+  {
+    switch ( value.type() )
+    {
+      case QVariant::Double:
+      case QVariant::Int:
+      case QVariant::UInt:
+        result = value.toDouble();
+        return true;
+      case QVariant::LongLong:
+      case QVariant::ULongLong:
+      {
+        // integers up to 2^53 are exact doubles
+        const qint64 maxExact = Q_INT64_C( 1 ) << 53;
+        result = value.toDouble();
+        return value.type() == QVariant::LongLong ? qAbs( value.toLongLong() ) <= maxExact : value.toULongLong() <= ( quint64 ) maxExact;
+      }
+      case QVariant::String:
+      {
+        bool ok;
+        result = value.toString().trimmed().toDouble( &ok );
+        return ok;
+      }
+      default:
+        return false;
+    }
+  }
+
+  //! Position of the cell (x,y) of a 65536 x 65536 grid along the Hilbert curve
+  quint32 hilbertIndex( quint32 x, quint32 y )
+  {
+    quint32 d = 0;
+    for ( quint32 s = 1 << 15; s > 0; s >>= 1 )
+    {
+      quint32 rx = ( x & s ) > 0;
+      quint32 ry = ( y & s ) > 0;
+      d += s * s * (( 3 * rx ) ^ ry );
+      if ( ry == 0 )
+      {
+        if ( rx == 1 )
+        {
+          x = s - 1 - x;
+          y = s - 1 - y;
+        }
+        qSwap( x, y );
+      }
+    }
+    return d;
+  }
+}
+
+
+void QgsMemoryFeatureStore::Column::resize( int size )
+{
+  if ( !others.isEmpty() && size < nulls.size() )
+  {
+    QHash<int, QVariant>::iterator it = others.begin();
+    while ( it != others.end() )
+    {
+      if ( it.key() >= size )
+        it = others.erase( it );
+      else
+        ++it;
+    }
+  }
+
+  switch ( type )
+  {
+    case QVariant::Int:
+    case QVariant::Date:
+      ints.resize( size );
+      break;
+    case QVariant::LongLong:
+      longs.resize( size );
+      break;
+    case QVariant::Double:
+      doubles.resize( size );
+      break;
+    case QVariant::String:
+      strings.resize( size );
+      break;
+    default:
+      variants.resize( size );
+      break;
+  }
+
+  int oldSize = nulls.size();
+  nulls.resize( size );
+  if ( size > oldSize )
+    nulls.fill( true, oldSize, size );
+}
+
+void QgsMemoryFeatureStore::Column::set( int row, const QVariant& value )
+{
+  if ( !others.isEmpty() )
+    others.remove( row );
+
+  bool ok = !value.isNull();
+  if ( ok )
+  {
+    switch ( type )
+    {
+      case QVariant::Int:
+      {
+        qint64 v = 0;
+        ok = toExactInteger( value, v ) && v >= std::numeric_limits<int>::min() && v <= std::numeric_limits<int>::max();
+        ints[row] = ok ? v : 0;
+        break;
+      }
+      case QVariant::Date:
+      {
+        QDate date = value.toDate();
+        ok = date.isValid() && ( value.type() != QVariant::DateTime || value.toDateTime().time() == QTime( 0, 0 ) );
+        ints[row] = ok ? date.toJulianDay() : 0;
+        break;
+      }
+      case QVariant::LongLong:
+      {
+        qint64 v = 0;
+        ok = toExactInteger( value, v );
+        longs[row] = ok ? v : 0;
+        break;
+      }
+      case QVariant::Double:
+      {
+        double v = 0;
+        ok = toExactDouble( value, v );
+        doubles[row] = ok ? v : 0;
+        break;
+      }
+      case QVariant::String:
+        ok = value.type() == QVariant::String || value.canConvert( QVariant::String );
+        strings[row] = ok ? value.toString() : QString();
+        break;
+      default:
+        variants[row] = value;
+        break;
+    }
+
+    // values which would be truncated or rounded are kept as they are
+    if ( !ok )
+      others.insert( row, value );
+  }
+  nulls.setBit( row, value.isNull() );
+}
+
+QVariant QgsMemoryFeatureStore::Column::get( int row ) const
+{
+  if ( !others.isEmpty() )
+  {
+    QHash<int, QVariant>::const_iterator it = others.constFind( row );
+    if ( it != others.constEnd() )
+      return it.value();
+  }
+
+  if ( nulls.testBit( row ) )
+    return QVariant( type );
+
+  switch ( type )
+  {
+    case QVariant::Int:
+      return QVariant( ints.at( row ) );
+    case QVariant::Date:
+      return QVariant( QDate::fromJulianDay( ints.at( row ) ) );
+    case QVariant::LongLong:
+      return QVariant( longs.at( row ) );
+    case QVariant::Double:
+      return QVariant( doubles.at( row ) );
+    case QVariant::String:
+      return QVariant( strings.at( row ) );
+    default:
+      return variants.at( row );
+  }
+}
+
+void QgsMemoryFeatureStore::Column::copy( int from, int to )
+{
+  switch ( type )
+  {
+    case QVariant::Int:
+    case QVariant::Date:
+      ints[to] = ints.at( from );
+      break;
+    case QVariant::LongLong:
+      longs[to] = longs.at( from );
+      break;
+    case QVariant::Double:
+      doubles[to] = doubles.at( from );
+      break;
+    case QVariant::String:
+      strings[to] = strings.at( from );
+      break;
+    default:
+      variants[to] = variants.at( from );
+      break;
+  }
+  nulls.setBit( to, nulls.testBit( from ) );
+
+  if ( !others.isEmpty() )
+  {
+    QHash<int, QVariant>::const_iterator it = others.constFind( from );
+    if ( it != others.constEnd() )
+      others.insert( to, it.value() );
+    else
+      others.remove( to );
+  }
+}
+
+
+QgsMemoryFeatureStore::Data::Data()
+    : deletedCount( 0 )
+    , wkbBytes( 0 )
+    , garbageBytes( 0 )
+    , extentDirty( false )
+    , indexedRows( 0 )
+{
+  extent.setMinimal();
+}
+
+
+QgsMemoryFeatureStore::QgsMemoryFeatureStore()
+    : d( new Data() )
+{
+}
+
+void QgsMemoryFeatureStore::addAttribute( QVariant::Type type )
+{
+  Column column;
+  column.type = type == QVariant::Invalid ? QVariant::String : type;
+  column.resize( d->ids.size() );
+  d->columns.append( column );
+}
+
+void QgsMemoryFeatureStore::deleteAttribute( int idx )
+{
+  if ( idx >= 0 && idx < d->columns.size() )
+    d->columns.remove( idx );
+}
+
+void QgsMemoryFeatureStore::addFeature( QgsFeatureId id, const QgsAttributes& attributes, const QgsGeometry* geometry )
+{
+  Q_ASSERT( d->ids.isEmpty() || id > d->ids.last() );
+
+  int row = d->ids.size();
+  d->ids.append( id );
+  d->deleted.resize( row + 1 );
+  d->stale.resize( row + 1 );
+  d->geometries.append( GeometryRef() );
+  d->boxes.append( QgsRectangle() );
+
+  for ( int i = 0; i < d->columns.size(); ++i )
+  {
+    Column& column = d->columns[i];
+    column.resize( row + 1 );
+    if ( i < attributes.size() )
+      column.set( row, attributes.at( i ) );
+  }
+
+  setGeometry( row, geometry );
+}
+
+bool QgsMemoryFeatureStore::deleteFeature( QgsFeatureId id )
+{
+  int r = row( id );
+  if ( r < 0 )
+    return false;
+
+  d->deleted.setBit( r );
+  d->deletedCount++;
+
+  // release the attribute and geometry data
+  for ( int i = 0; i < d->columns.size(); ++i )
+    d->columns[i].set( r, QVariant() );
+  setGeometry( r, 0 );
+  return true;
+}
+
+bool QgsMemoryFeatureStore::changeAttributeValue( QgsFeatureId id, int idx, const QVariant& value )
+{
+  if ( idx < 0 || idx >= d->columns.size() )
+    return false;
+
+  int r = row( id );
+  if ( r < 0 )
+    return false;
+
+  d->columns[idx].set( r, value );
+  return true;
+}
+
+bool QgsMemoryFeatureStore::changeGeometry( QgsFeatureId id, const QgsGeometry* geometry )
+{
+  int r = row( id );
+  if ( r < 0 )
+    return false;
+
+  setGeometry( r, geometry );
+  return true;
+}
+
+void QgsMemoryFeatureStore::setGeometry( int row, const QgsGeometry* geometry )
+{
+  GeometryRef& ref = d->geometries[row];
+  if ( ref.size > 0 )
+  {
+    // the old geometry stays in its block until the store is compacted
+    d->garbageBytes += ref.size;
+    d->wkbBytes -= ref.size;
+    d->extentDirty = true;
+  }
+  ref = GeometryRef();
+  d->boxes[row] = QgsRectangle();
+
+  // the index still has the previous bounding box of an indexed row
+  if ( row < d->indexedRows && !d->stale.testBit( row ) )
+  {
+    d->stale.setBit( row );
+    d->staleRows.append( row );
+  }
+
+  if ( !geometry || geometry->wkbSize() == 0 )
+    return;
+
+  int size = geometry->wkbSize();
+  if ( d->blocks.isEmpty() || d->blocks.last().size() + size > sBlockSize )
+  {
+    d->blocks.append( QByteArray() );
+    d->blocks.last().reserve( qMax( size, sBlockSize ) );
+  }
+
+  QByteArray& block = d->blocks.last();
+  ref.block = d->blocks.size() - 1;
+  ref.offset = block.size();
+  ref.size = size;
+  block.append( reinterpret_cast<const char*>( geometry->asWkb() ), size );
+  d->wkbBytes += size;
+
+  d->boxes[row] = geometry->boundingBox();
+  if ( !d->extentDirty )
+    d->extent.unionRect( d->boxes.at( row ) );
+}
+
+void QgsMemoryFeatureStore::updateIndex()
+{
+  int rows = d->ids.size();
+
+  if ( d->deletedCount > 1024 && 2 * d->deletedCount > rows )
+  {
+    compact();
+  }
+  else if ( d->garbageBytes > 4 * sBlockSize && d->garbageBytes > d->wkbBytes )
+  {
+    compact();
+  }
+
+  if ( d->extentDirty )
+  {
+    d->extent.setMinimal();
+    for ( int row = 0; row < d->ids.size(); ++row )
+    {
+      if ( d->geometries.at( row ).size > 0 )
+        d->extent.unionRect( d->boxes.at( row ) );
+    }
+    d->extentDirty = false;
+  }
+
+  // rebuilding costs O(n log n): rebuild when the rows checked one by one
+  // grow by a fraction of the indexed rows to amortize it
+  int unindexed = d->ids.size() - d->indexedRows + d->staleRows.size();
+  if ( unindexed > qMax( 256, d->indexedRows / 8 ) )
+    buildIndex();
+}
+
+void QgsMemoryFeatureStore::rebuildIndex()
+{
+  updateIndex();
+  if ( d->indexedRows < d->ids.size() || !d->staleRows.isEmpty() )
+    buildIndex();
+}
+
+void QgsMemoryFeatureStore::compact()
+{
+  QgsDebugMsg( QString( "compacting %1 rows with %2 deleted, %3 of %4 bytes of geometries unused" )
+               .arg( d->ids.size() ).arg( d->deletedCount ).arg( d->garbageBytes ).arg( d->garbageBytes + d->wkbBytes ) );
+
+  Data* data = d.data();
+  int rows = data->ids.size();
+
+  QList<QByteArray> blocks;
+  int to = 0;
+  for ( int from = 0; from < rows; ++from )
+  {
+    if ( data->deleted.testBit( from ) )
+      continue;
+
+    data->ids[to] = data->ids.at( from );
+    for ( int i = 0; i < data->columns.size(); ++i )
+      data->columns[i].copy( from, to );
+    data->boxes[to] = data->boxes.at( from );
+
+    GeometryRef ref = data->geometries.at( from );
+    if ( ref.size > 0 )
+    {
+      if ( blocks.isEmpty() || blocks.last().size() + ref.size > sBlockSize )
+      {
+        blocks.append( QByteArray() );
+        blocks.last().reserve( qMax( ref.size, sBlockSize ) );
+      }
+
+      QByteArray& block = blocks.last();
+      block.append( data->blocks.at( ref.block ).constData() + ref.offset, ref.size );
+      ref.block = blocks.size() - 1;
+      ref.offset = block.size() - ref.size;
+    }
+    data->geometries[to] = ref;
+    to++;
+  }
+
+  data->ids.resize( to );
+  for ( int i = 0; i < data->columns.size(); ++i )
+    data->columns[i].resize( to );
+  data->boxes.resize( to );
+  data->geometries.resize( to );
+  data->blocks = blocks;
+  data->garbageBytes = 0;
+  data->deleted = QBitArray( to );
+  data->deletedCount = 0;
+
+  // the rows moved, so the index is rebuilt
+  data->stale = QBitArray( to );
+  data->staleRows.clear();
+  data->indexedRows = 0;
+  buildIndex();
+}
+
+void QgsMemoryFeatureStore::buildIndex()
+{
+  Data* data = d.data();
+  int rows = data->ids.size();
+
+  data->indexRows.clear();
+  data->indexNodes.clear();
+  data->levelOffsets.clear();
+  data->levelSizes.clear();
+  data->stale = QBitArray( rows );
+  data->staleRows.clear();
+  data->indexedRows = rows;
+
+  QgsRectangle extent;
+  extent.setMinimal();
+  QVector< QPair<quint32, int> > items;
+  items.reserve( rows - data->deletedCount );
+  for ( int row = 0; row < rows; ++row )
+  {
+    if ( data->geometries.at( row ).size > 0 )
+    {
+      extent.unionRect( data->boxes.at( row ) );
+      items.append( qMakePair( 0u, row ) );
+    }
+  }
+
+  if ( items.isEmpty() )
+    return;
+
+  // sort the rows along a Hilbert curve over the extent, so that the rows
+  // of a node are close together
+  double width = extent.width() > 0 ? extent.width() : 1;
+  double height = extent.height() > 0 ? extent.height() : 1;
+  for ( int i = 0; i < items.size(); ++i )
+  {
+    const QgsRectangle& box = data->boxes.at( items.at( i ).second );
+    quint32 x = ( quint32 )( 65535 * (( box.xMinimum() + box.xMaximum() ) / 2 - extent.xMinimum() ) / width );
+    quint32 y = ( quint32 )( 65535 * (( box.yMinimum() + box.yMaximum() ) / 2 - extent.yMinimum() ) / height );
+    items[i].first = hilbertIndex( x, y );
+  }
+  qSort( items );
+
+  data->indexRows.resize( items.size() );
+  for ( int i = 0; i < items.size(); ++i )
+    data->indexRows[i] = items.at( i ).second;
+
+  // pack the levels bottom up
+  data->levelOffsets << 0;
+  data->levelSizes << items.size();
+  int level = 0;
+  while ( data->levelSizes.at( level ) > 1 )
+  {
+    int childCount = data->levelSizes.at( level );
+    int childOffset = data->levelOffsets.at( level );
+    int size = ( childCount + sNodeSize - 1 ) / sNodeSize;
+    int offset = data->indexNodes.size();
+
+    for ( int node = 0; node < size; ++node )
+    {
+      QgsRectangle box;
+      box.setMinimal();
+      int end = qMin( childCount, ( node + 1 ) * sNodeSize );
+      for ( int child = node * sNodeSize; child < end; ++child )
+        box.unionRect( level == 0 ? data->boxes.at( data->indexRows.at( child ) ) : data->indexNodes.at( childOffset + child ) );
+      data->indexNodes.append( box );
+    }
+
+    data->levelOffsets << offset;
+    data->levelSizes << size;
+    level++;
+  }
+}
+
+int QgsMemoryFeatureStore::row( QgsFeatureId id ) const
+{
+  // rows are ordered by feature id
+  QVector<QgsFeatureId>::const_iterator it = qBinaryFind( d->ids.constBegin(), d->ids.constEnd(), id );
+  if ( it == d->ids.constEnd() )
+    return -1;
+
+  int r = it - d->ids.constBegin();
+  return d->deleted.testBit( r ) ? -1 : r;
+}
+
+QVariant QgsMemoryFeatureStore::attribute( int row, int idx ) const
+{
+  return d->columns.at( idx ).get( row );
+}
+
+const unsigned char* QgsMemoryFeatureStore::wkb( int row ) const
+{
+  const GeometryRef& ref = d->geometries.at( row );
+  return reinterpret_cast<const unsigned char*>( d->blocks.at( ref.block ).constData() ) + ref.offset;
+}
+
+QgsGeometry* QgsMemoryFeatureStore::geometry( int row ) const
+{
+  int size = d->geometries.at( row ).size;
+  if ( size <= 0 )
+    return 0;
+
+  unsigned char* copy = new unsigned char[size];
+  memcpy( copy, wkb( row ), size );
+  QgsGeometry* geometry = new QgsGeometry();
+  geometry->fromWkb( copy, size );
+  return geometry;
+}
+
+void QgsMemoryFeatureStore::feature( int row, QgsFeature& feature, bool fetchGeometry ) const
+{
+  feature.setFeatureId( d->ids.at( row ) );
+  feature.setValid( true );
+
+  int count = d->columns.size();
+  if ( feature.attributes().size() != count )
+    feature.initAttributes( count );
+  for ( int i = 0; i < count; ++i )
+    feature.setAttribute( i, d->columns.at( i ).get( row ) );
+
+  int size = d->geometries.at( row ).size;
+  if ( fetchGeometry && size > 0 )
+  {
+    // the geometry takes ownership of its wkb, it cannot point into the blocks
+    unsigned char* copy = new unsigned char[size];
+    memcpy( copy, wkb( row ), size );
+    feature.setGeometryAndOwnership( copy, size );
+  }
+  else
+  {
+    feature.setGeometry( 0 );
+  }
+}
+
+void QgsMemoryFeatureStore::addToBatch( int row, QgsFeatureBatch& batch, bool fetchGeometry ) const
+{
+  int batchRow = batch.addFeature( d->ids.at( row ) );
+
+  for ( int i = 0; i < d->columns.size(); ++i )
+    batch.setAttribute( batchRow, i, d->columns.at( i ).get( row ) );
+
+  if ( fetchGeometry && d->geometries.at( row ).size > 0 )
+    batch.setGeometryWkb( batchRow, wkb( row ), d->geometries.at( row ).size );
+}
+
+QVector<int> QgsMemoryFeatureStore::intersects( const QgsRectangle& rect ) const
+{
+  QVector<int> rows;
+
+  // packed index
+  if ( !d->levelSizes.isEmpty() )
+  {
+    QVector< QPair<int, int> > stack;
+    stack.append( qMakePair( d->levelSizes.size() - 1, 0 ) );
+    while ( !stack.isEmpty() )
+    {
+      QPair<int, int> item = stack.last();
+      stack.pop_back();
+      int level = item.first;
+      int node = item.second;
+
+      if ( level == 0 )
+      {
+        int row = d->indexRows.at( node );
+        if ( !d->stale.testBit( row ) && d->geometries.at( row ).size > 0 && d->boxes.at( row ).intersects( rect ) )
+          rows.append( row );
+        continue;
+      }
+
+      if ( !d->indexNodes.at( d->levelOffsets.at( level ) + node ).intersects( rect ) )
+        continue;
+
+      int end = qMin( d->levelSizes.at( level - 1 ), ( node + 1 ) * sNodeSize );
+      for ( int child = node * sNodeSize; child < end; ++child )
+        stack.append( qMakePair( level - 1, child ) );
+    }
+  }
+
+  // rows changed or added after the index was built
+  Q_FOREACH ( int row, d->staleRows )
+  {
+    if ( d->geometries.at( row ).size > 0 && d->boxes.at( row ).intersects( rect ) )
+      rows.append( row );
+  }
+  for ( int row = d->indexedRows; row < d->ids.size(); ++row )
+  {
+    if ( d->geometries.at( row ).size > 0 && d->boxes.at( row ).intersects( rect ) )
+      rows.append( row );
+  }
+
+  // deleted rows have no geometry, so they are never found
+  qSort( rows );
+  return rows;
+}
@@ -0,0 +1,199 @@
+/***************************************************************************
+    qgsmemoryfeaturestore.h
+    ---------------------
+    begin                : October 2015
+    copyright            : (C) 2015 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#ifndef QGSMEMORYFEATURESTORE_H
+#define QGSMEMORYFEATURESTORE_H
+
+#include "qgsfeature.h"
+#include "qgsrectangle.h"
+
+#include <QBitArray>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QSharedData>
+#include <QString>
+#include <QVariant>
+#include <QVector>
+
+class QgsFeatureBatch;
+class QgsGeometry;
+
+/**
+ * Column oriented storage of the features of the memory provider.
+ *
+ * Features are kept in rows ordered by feature id. Attributes are stored in
+ * one typed array per field, geometries as WKB in large shared blocks along
+ * with their bounding boxes. Deleted rows are only flagged until they make up
+ * half of the rows, the store is compacted then.
+ *
+ * A packed R-tree over the bounding boxes answers rectangle queries. Rows added
+ * or changed after it was built are checked one by one until they are numerous
+ * enough for updateIndex() to rebuild it.
+ *
+ * The store is implicitly shared: copies for feature sources are cheap and only
+ * the arrays that are modified afterwards get detached.
+ */
+class QgsMemoryFeatureStore
+{
+  public:
+    QgsMemoryFeatureStore();
+
+    //! Appends a field of the given type, null for all features
+    void addAttribute( QVariant::Type type );
+
+    //! Removes the field at the index
+    void deleteAttribute( int idx );
+
+    //! Number of fields
+    int attributeCount() const { return d->columns.size(); }
+
+    /** Appends a feature. Its id must be greater than the ids of all stored features.
+     * Attributes beyond the fields are dropped. Values are converted to the type of
+     * their field, those which the conversion would truncate or round are kept as they are.
+     */
+    void addFeature( QgsFeatureId id, const QgsAttributes& attributes, const QgsGeometry* geometry );
+
+    //! Removes a feature, returns false if it does not exist
+    bool deleteFeature( QgsFeatureId id );
+
+    //! Changes an attribute value, returns false if the feature or field does not exist
+    bool changeAttributeValue( QgsFeatureId id, int idx, const QVariant& value );
+
+    //! Changes the geometry (0 removes it), returns false if the feature does not exist
+    bool changeGeometry( QgsFeatureId id, const QgsGeometry* geometry );
+
+    /** Compacts the store if enough rows are deleted, updates the extent and rebuilds
+     * the spatial index if enough rows are not covered. To be called after edits.
+     */
+    void updateIndex();
+
+    //! Rebuilds the spatial index now, so that it covers all rows
+    void rebuildIndex();
+
+    //! Number of features
+    int count() const { return d->ids.size() - d->deletedCount; }
+
+    //! Extent of the geometries, a minimal rectangle if there are none. Valid after updateIndex().
+    QgsRectangle extent() const { return d->extent; }
+
+    //! Number of rows, including deleted ones
+    int rowCount() const { return d->ids.size(); }
+
+    //! Returns the row of a feature or -1 if it does not exist
+    int row( QgsFeatureId id ) const;
+
+    //! Returns whether the feature of the row was deleted
+    bool isDeleted( int row ) const { return d->deleted.testBit( row ); }
+
+    //! Feature id of the row
+    QgsFeatureId id( int row ) const { return d->ids.at( row ); }
+
+    //! Attribute value of the row
+    QVariant attribute( int row, int idx ) const;
+
+    //! Returns whether the row has a geometry
+    bool hasGeometry( int row ) const { return d->geometries.at( row ).size > 0; }
+
+    //! Bounding box of the geometry of the row
+    const QgsRectangle& boundingBox( int row ) const { return d->boxes.at( row ); }
+
+    //! Returns a new geometry of the row, or 0 if it has none. The caller takes ownership.
+    QgsGeometry* geometry( int row ) const;
+
+    //! Sets id, attributes and geometry of the feature to those of the row
+    void feature( int row, QgsFeature& feature, bool fetchGeometry = true ) const;
+
+    //! Appends the feature of the row to the batch, which must have matching fields
+    void addToBatch( int row, QgsFeatureBatch& batch, bool fetchGeometry = true ) const;
+
+    //! Returns the rows with a bounding box intersecting the rectangle, ascending
+    QVector<int> intersects( const QgsRectangle& rect ) const;
+
+  private:
+    //! Typed values of a field. Only the array of the field type is used.
+    struct Column
+    {
+      Column() : type( QVariant::Invalid ) {}
+
+      QVariant::Type type;
+      QVector<int> ints;        //!< Int and Date (julian day)
+      QVector<qint64> longs;    //!< LongLong
+      QVector<double> doubles;  //!< Double
+      QVector<QString> strings; //!< String
+      QVector<QVariant> variants; //!< other types
+      QBitArray nulls;          //!< null flags of the typed arrays
+      //! values which cannot be converted to the type without loss, by row
+      QHash<int, QVariant> others;
+
+      void resize( int size );
+      void set( int row, const QVariant& value );
+      QVariant get( int row ) const;
+      void copy( int from, int to );
+    };
+
+    //! Location of a geometry in the WKB blocks
+    struct GeometryRef
+    {
+      GeometryRef() : block( 0 ), offset( 0 ), size( 0 ) {}
+
+      int block;
+      int offset;
+      int size;
+    };
+
+    class Data : public QSharedData
+    {
+      public:
+        Data();
+
+        QVector<Column> columns;
+        QVector<QgsFeatureId> ids;
+        QBitArray deleted;
+        int deletedCount;
+
+        QVector<GeometryRef> geometries;
+        QVector<QgsRectangle> boxes;
+        QList<QByteArray> blocks;
+        qint64 wkbBytes;
+        qint64 garbageBytes;
+
+        QgsRectangle extent;
+        bool extentDirty;
+
+        //! Rows below are in the packed index, unless they are stale
+        int indexedRows;
+        //! Indexed rows whose geometry changed since the index was built
+        QBitArray stale;
+        QVector<int> staleRows;
+        //! Rows of the leaves of the index, in index order
+        QVector<int> indexRows;
+        //! Boxes of the inner nodes, level by level from the leaves up
+        QVector<QgsRectangle> indexNodes;
+        //! Offset into indexNodes and size of each level, level 0 are the leaves
+        QVector<int> levelOffsets;
+        QVector<int> levelSizes;
+    };
+
+    const unsigned char* wkb( int row ) const;
+    void setGeometry( int row, const QgsGeometry* geometry );
+    void compact();
+    void buildIndex();
+
+    QSharedDataPointer<Data> d;
+
+    static const int sBlockSize;
+    static const int sNodeSize;
+};
+
+#endif // QGSMEMORYFEATURESTORE_H
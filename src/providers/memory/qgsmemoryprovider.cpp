@@ -20,7 +20,6 @@
 #include "qgsfield.h"
 #include "qgsgeometry.h"
 #include "qgslogger.h"
-#include "qgsspatialindex.h"
 #include "qgscoordinatereferencesystem.h"
 
 #include <QUrl>
@@ -32,7 +31,6 @@ static const QString TEXT_PROVIDER_DESCRIPTION = "Memory provider";
 
 QgsMemoryProvider::QgsMemoryProvider( QString uri )
     : QgsVectorDataProvider( uri )
-    , mSpatialIndex( 0 )
 {
   // Initialize the geometry with the uri to support old style uri's
   // (ie, just 'point', 'line', 'polygon')
@@ -158,16 +156,11 @@ QgsMemoryProvider::QgsMemoryProvider( QString uri )
     addAttributes( attributes );
   }
 
-  if ( url.hasQueryItem( "index" ) && url.queryItemValue( "index" ) == "yes" )
-  {
-    createSpatialIndex();
-  }
-
+  // the "index=yes" item of older uris is ignored, features are always indexed
 }
 
 QgsMemoryProvider::~QgsMemoryProvider()
 {
-  delete mSpatialIndex;
 }
 
 QgsAbstractFeatureSource* QgsMemoryProvider::featureSource() const
@@ -229,10 +222,6 @@ QString QgsMemoryProvider::dataSourceUri( bool expandAuthConfig ) const
     }
     uri.addQueryItem( "crs", crsDef );
   }
-  if ( mSpatialIndex )
-  {
-    uri.addQueryItem( "index", "yes" );
-  }
 
   QgsAttributeList attrs = const_cast<QgsMemoryProvider *>( this )->attributeIndexes();
   for ( int i = 0; i < attrs.size(); i++ )
@@ -295,15 +284,9 @@ bool QgsMemoryProvider::addFeatures( QgsFeatureList & flist )
   // TODO: sanity checks of fields and geometries
   for ( QgsFeatureList::iterator it = flist.begin(); it != flist.end(); ++it )
   {
-    mFeatures[mNextFeatureId] = *it;
-    QgsFeature& newfeat = mFeatures[mNextFeatureId];
-    newfeat.setFeatureId( mNextFeatureId );
+    mFeatures.addFeature( mNextFeatureId, it->attributes(), it->constGeometry() );
     it->setFeatureId( mNextFeatureId );
 
-    // update spatial index
-    if ( mSpatialIndex )
-      mSpatialIndex->insertFeature( newfeat );
-
     mNextFeatureId++;
   }
 
@@ -316,17 +299,7 @@ bool QgsMemoryProvider::deleteFeatures( const QgsFeatureIds & id )
 {
   for ( QgsFeatureIds::const_iterator it = id.begin(); it != id.end(); ++it )
   {
-    QgsFeatureMap::iterator fit = mFeatures.find( *it );
-
-    // check whether such feature exists
-    if ( fit == mFeatures.end() )
-      continue;
-
-    // update spatial index
-    if ( mSpatialIndex )
-      mSpatialIndex->deleteFeature( *fit );
-
-    mFeatures.erase( fit );
+    mFeatures.deleteFeature( *it );
   }
 
   updateExtent();
@@ -353,14 +326,7 @@ bool QgsMemoryProvider::addAttributes( const QList<QgsField> &attributes )
     }
     // add new field as a last one
     mFields.append( *it );
-
-    for ( QgsFeatureMap::iterator fit = mFeatures.begin(); fit != mFeatures.end(); ++fit )
-    {
-      QgsFeature& f = fit.value();
-      QgsAttributes attr = f.attributes();
-      attr.append( QVariant() );
-      f.setAttributes( attr );
-    }
+    mFeatures.addAttribute( it->type() );
   }
   return true;
 }
@@ -375,14 +341,7 @@ bool QgsMemoryProvider::deleteAttributes( const QgsAttributeIds& attributes )
   {
     int idx = *it;
     mFields.remove( idx );
-
-    for ( QgsFeatureMap::iterator fit = mFeatures.begin(); fit != mFeatures.end(); ++fit )
-    {
-      QgsFeature& f = fit.value();
-      QgsAttributes attr = f.attributes();
-      attr.remove( idx );
-      f.setAttributes( attr );
-    }
+    mFeatures.deleteAttribute( idx );
   }
   return true;
 }
@@ -391,13 +350,9 @@ bool QgsMemoryProvider::changeAttributeValues( const QgsChangedAttributesMap & a
 {
   for ( QgsChangedAttributesMap::const_iterator it = attr_map.begin(); it != attr_map.end(); ++it )
   {
-    QgsFeatureMap::iterator fit = mFeatures.find( it.key() );
-    if ( fit == mFeatures.end() )
-      continue;
-
     const QgsAttributeMap& attrs = it.value();
     for ( QgsAttributeMap::const_iterator it2 = attrs.begin(); it2 != attrs.end(); ++it2 )
-      fit->setAttribute( it2.key(), it2.value() );
+      mFeatures.changeAttributeValue( it.key(), it2.key(), it2.value() );
   }
   return true;
 }
@@ -406,19 +361,7 @@ bool QgsMemoryProvider::changeGeometryValues( QgsGeometryMap & geometry_map )
 {
   for ( QgsGeometryMap::const_iterator it = geometry_map.begin(); it != geometry_map.end(); ++it )
   {
-    QgsFeatureMap::iterator fit = mFeatures.find( it.key() );
-    if ( fit == mFeatures.end() )
-      continue;
-
-    // update spatial index
-    if ( mSpatialIndex )
-      mSpatialIndex->deleteFeature( *fit );
-
-    fit->setGeometry( it.value() );
-
-    // update spatial index
-    if ( mSpatialIndex )
-      mSpatialIndex->insertFeature( *fit );
+    mFeatures.changeGeometry( it.key(), &it.value() );
   }
 
   updateExtent();
@@ -448,16 +391,7 @@ bool QgsMemoryProvider::setSubsetString( QString theSQL, bool updateFeatureCount
 
 bool QgsMemoryProvider::createSpatialIndex()
 {
-  if ( !mSpatialIndex )
-  {
-    mSpatialIndex = new QgsSpatialIndex();
-
-    // add existing features to index
-    for ( QgsFeatureMap::iterator it = mFeatures.begin(); it != mFeatures.end(); ++it )
-    {
-      mSpatialIndex->insertFeature( *it );
-    }
-  }
+  mFeatures.rebuildIndex();
   return true;
 }
 
@@ -471,18 +405,15 @@ int QgsMemoryProvider::capabilities() const
 
 void QgsMemoryProvider::updateExtent()
 {
+  mFeatures.updateIndex();
+
   if ( mFeatures.count() == 0 )
   {
     mExtent = QgsRectangle();
   }
   else
   {
-    mExtent.setMinimal();
-    Q_FOREACH ( const QgsFeature& feat, mFeatures )
-    {
-      if ( feat.constGeometry() )
-        mExtent.unionRect( feat.constGeometry()->boundingBox() );
-    }
+    mExtent = mFeatures.extent();
   }
 }
 
@@ -15,12 +15,9 @@
 
 #include "qgsvectordataprovider.h"
 #include "qgscoordinatereferencesystem.h"
+#include "qgsmemoryfeaturestore.h"
 
 
-typedef QMap<QgsFeatureId, QgsFeature> QgsFeatureMap;
-
-class QgsSpatialIndex;
-
 class QgsMemoryFeatureIterator;
 
 class QgsMemoryProvider : public QgsVectorDataProvider
@@ -120,7 +117,8 @@ class QgsMemoryProvider : public QgsVectorDataProvider
     virtual bool supportsSubsetString() override { return true; }
 
     /**
-     * Creates a spatial index
+     * Rebuilds the spatial index, which always exists, so that it also covers the
+     * features added or changed since it was last built rather than checking them one by one.
      * @return true in case of success
      */
     virtual bool createSpatialIndex() override;
@@ -171,13 +169,10 @@ class QgsMemoryProvider : public QgsVectorDataProvider
     QGis::WkbType mWkbType;
     QgsRectangle mExtent;
 
-    // features
-    QgsFeatureMap mFeatures;
+    // features, with their spatial index
+    QgsMemoryFeatureStore mFeatures;
     QgsFeatureId mNextFeatureId;
 
-    // indexing
-    QgsSpatialIndex* mSpatialIndex;
-
     QString mSubsetString;
 
     friend class QgsMemoryFeatureSource;
@@ -0,0 +1,90 @@
+/***************************************************************************
+    qgsogrexpressioncompiler.cpp
+    ---------------------
+    begin                : October 2015
+    copyright            : (C) 2015 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgsogrexpressioncompiler.h"
+
+#include "qgsogrprovider.h"
+
+QgsOgrExpressionCompiler::QgsOgrExpressionCompiler( QgsOgrFeatureSource* source )
+    : QgsSqlExpressionCompiler( source->mFields, QgsSqlExpressionCompiler::LikeIsCaseInsensitive )
+    , mSource( source )
+{
+}
+
+QgsSqlExpressionCompiler::Result QgsOgrExpressionCompiler::compile( const QgsExpression* exp )
+{
+  // these drivers pass attribute filters through to the database, whose SQL
+  // dialect differs from OGR SQL
+  if ( mSource->mDriverName == "MySQL" ||
+       mSource->mDriverName == "PostgreSQL" ||
+       mSource->mDriverName == "OCI" ||
+       mSource->mDriverName == "ODBC" ||
+       mSource->mDriverName == "PGeo" ||
+       mSource->mDriverName == "MSSQLSpatial" )
+    return Fail;
+
+  return QgsSqlExpressionCompiler::compile( exp );
+}
+
+QString QgsOgrExpressionCompiler::quotedIdentifier( const QString& identifier )
+{
+  return QString::fromUtf8( QgsOgrUtils::quotedIdentifier( identifier.toUtf8(), mSource->mDriverName ) );
+}
+
+QString QgsOgrExpressionCompiler::quotedValue( const QVariant& value, bool& ok )
+{
+  // OGR SQL has no boolean type and only compares NULL with IS
+  if ( value.isNull() || value.type() == QVariant::Bool )
+  {
+    ok = false;
+    return QString();
+  }
+
+  return QgsSqlExpressionCompiler::quotedValue( value, ok );
+}
+
+QgsSqlExpressionCompiler::Result QgsOgrExpressionCompiler::compileNode( const QgsExpression::Node* node, QString& result )
+{
+  if ( node->nodeType() == QgsExpression::ntBinaryOperator )
+  {
+    const QgsExpression::NodeBinaryOperator* n = static_cast<const QgsExpression::NodeBinaryOperator*>( node );
+
+    switch ( n->op() )
+    {
+      case QgsExpression::boIs:
+      case QgsExpression::boIsNot:
+      {
+        // only IS [NOT] NULL is supported
+        if ( n->opRight()->nodeType() != QgsExpression::ntLiteral ||
+             !static_cast<const QgsExpression::NodeLiteral*>( n->opRight() )->value().isNull() )
+          return Fail;
+
+        QString left;
+        if ( compileNode( n->opLeft(), left ) != Complete )
+          return Fail;
+
+        result = "(" + left + ( n->op() == QgsExpression::boIs ? " IS NULL)" : " IS NOT NULL)" );
+        return Complete;
+      }
+
+      case QgsExpression::boConcat:
+        return Fail;
+
+      default:
+        break;
+    }
+  }
+
+  return QgsSqlExpressionCompiler::compileNode( node, result );
+}
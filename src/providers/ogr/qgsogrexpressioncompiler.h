@@ -0,0 +1,45 @@
+/***************************************************************************
+    qgsogrexpressioncompiler.h
+    ---------------------
+    begin                : October 2015
+    copyright            : (C) 2015 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSOGREXPRESSIONCOMPILER_H
+#define QGSOGREXPRESSIONCOMPILER_H
+
+#include "qgssqlexpressioncompiler.h"
+#include "qgsexpression.h"
+#include "qgsogrfeatureiterator.h"
+
+/**
+ * Translates filter expressions to attribute filters in the OGR SQL dialect,
+ * to be set with OGR_L_SetAttributeFilter().
+ */
+class QgsOgrExpressionCompiler : public QgsSqlExpressionCompiler
+{
+  public:
+
+    explicit QgsOgrExpressionCompiler( QgsOgrFeatureSource* source );
+
+    virtual Result compile( const QgsExpression* exp ) override;
+
+  protected:
+
+    virtual QString quotedIdentifier( const QString& identifier ) override;
+    virtual QString quotedValue( const QVariant& value, bool& ok ) override;
+    virtual Result compileNode( const QgsExpression::Node* node, QString& str ) override;
+
+  private:
+
+    QgsOgrFeatureSource* mSource;
+};
+
+#endif // QGSOGREXPRESSIONCOMPILER_H
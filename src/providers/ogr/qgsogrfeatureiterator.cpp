@@ -15,15 +15,20 @@
 #include "qgsogrfeatureiterator.h"
 
 #include "qgsogrprovider.h"
+#include "qgsogrexpressioncompiler.h"
 #include "qgsogrgeometrysimplifier.h"
 
 #include "qgsapplication.h"
+#include "qgsfeaturebatch.h"
 #include "qgsgeometry.h"
 #include "qgslogger.h"
 #include "qgsmessagelog.h"
 
 #include <QTextCodec>
 #include <QFile>
+#include <QSettings>
+
+#include <cpl_error.h>
 
 // using from provider:
 // - setRelevantFields(), mRelevantFieldsForNextFeature
@@ -37,6 +42,8 @@ QgsOgrFeatureIterator::QgsOgrFeatureIterator( QgsOgrFeatureSource* source, bool
     : QgsAbstractFeatureIteratorFromSource<QgsOgrFeatureSource>( source, ownSource, request )
     , ogrLayer( 0 )
     , mSubsetStringSet( false )
+    , mAttributeFilterSet( false )
+    , mExpressionCompiled( false )
     , mGeometrySimplifier( NULL )
 {
   mFeatureFetched = false;
@@ -82,6 +89,30 @@ QgsOgrFeatureIterator::QgsOgrFeatureIterator( QgsOgrFeatureSource* source, bool
     OGR_L_SetSpatialFilter( ogrLayer, 0 );
   }
 
+  if ( request.filterType() == QgsFeatureRequest::FilterExpression
+       && QgsSqlExpressionCompiler::compilationEnabled() )
+  {
+    QgsOgrExpressionCompiler compiler = QgsOgrExpressionCompiler( source );
+
+    // a partially compiled expression still reduces the features read,
+    // but has to be evaluated on each feature
+    QgsSqlExpressionCompiler::Result result = compiler.compile( request.filterExpression() );
+    if ( result == QgsSqlExpressionCompiler::Complete || result == QgsSqlExpressionCompiler::Partial )
+    {
+      QByteArray whereClause = mSource->mEncoding->fromUnicode( compiler.result() );
+      if ( OGR_L_SetAttributeFilter( ogrLayer, whereClause.constData() ) == OGRERR_NONE )
+      {
+        mAttributeFilterSet = true;
+        mExpressionCompiled = result == QgsSqlExpressionCompiler::Complete;
+      }
+      else
+      {
+        QgsDebugMsg( QString( "OGR rejected the compiled expression %1: %2" ).arg( compiler.result(), CPLGetLastErrorMsg() ) );
+        OGR_L_SetAttributeFilter( ogrLayer, 0 );
+      }
+    }
+  }
+
   //start with first feature
   rewind();
 }
@@ -194,6 +225,47 @@ bool QgsOgrFeatureIterator::fetchFeature( QgsFeature& feature )
 }
 
 
+bool QgsOgrFeatureIterator::nextFeatureFilterExpression( QgsFeature& f )
+{
+  if ( !mExpressionCompiled )
+    return QgsAbstractFeatureIterator::nextFeatureFilterExpression( f );
+  else
+    return fetchFeature( f );
+}
+
+
+int QgsOgrFeatureIterator::fetchFeatures( QgsFeatureBatch& batch, int maxCount )
+{
+  if ( mClosed )
+    return 0;
+
+  if ( !providesBatches() )
+    return QgsAbstractFeatureIterator::fetchFeatures( batch, maxCount );
+
+  batch.setFields( mSource->mFields );
+
+  OGRFeatureH fet;
+  while ( batch.size() < maxCount && ( fet = OGR_L_GetNextFeature( ogrLayer ) ) )
+  {
+    readFeature( fet, batch );
+    OGR_F_Destroy( fet );
+  }
+
+  if ( batch.isEmpty() )
+    close();
+
+  return batch.size();
+}
+
+bool QgsOgrFeatureIterator::providesBatches() const
+{
+  // these need a QgsGeometry of each feature anyway
+  return mRequest.filterType() != QgsFeatureRequest::FilterFid
+         && !( mRequest.flags() & QgsFeatureRequest::ExactIntersect )
+         && mSource->mOgrGeometryTypeFilter == wkbUnknown;
+}
+
+
 bool QgsOgrFeatureIterator::rewind()
 {
   if ( mClosed )
@@ -212,6 +284,12 @@ bool QgsOgrFeatureIterator::close()
 
   iteratorClosed();
 
+  // the layer is reused by the next iterator of the pooled connection
+  if ( mAttributeFilterSet )
+  {
+    OGR_L_SetAttributeFilter( ogrLayer, 0 );
+  }
+
   if ( mSubsetStringSet )
   {
     OGR_DS_ReleaseResultSet( mConn->ds, ogrLayer );
@@ -226,17 +304,23 @@ bool QgsOgrFeatureIterator::close()
 
 
 void QgsOgrFeatureIterator::getFeatureAttribute( OGRFeatureH ogrFet, QgsFeature & f, int attindex )
+{
+  QVariant value;
+  if ( featureAttribute( ogrFet, attindex, value ) )
+    f.setAttribute( attindex, value );
+}
+
+
+bool QgsOgrFeatureIterator::featureAttribute( OGRFeatureH ogrFet, int attindex, QVariant& value )
 {
   OGRFieldDefnH fldDef = OGR_F_GetFieldDefnRef( ogrFet, attindex );
 
   if ( ! fldDef )
   {
     QgsDebugMsg( "ogrFet->GetFieldDefnRef(attindex) returns NULL" );
-    return;
+    return false;
   }
 
-  QVariant value;
-
   if ( OGR_F_IsFieldSet( ogrFet, attindex ) )
   {
     switch ( mSource->mFields.at( attindex ).type() )
@@ -265,7 +349,7 @@ void QgsOgrFeatureIterator::getFeatureAttribute( OGRFeatureH ogrFet, QgsFeature
     value = QVariant( QString::null );
   }
 
-  f.setAttribute( attindex, value );
+  return true;
 }
 
 
@@ -332,6 +416,47 @@ bool QgsOgrFeatureIterator::readFeature( OGRFeatureH fet, QgsFeature& feature )
 }
 
 
+bool QgsOgrFeatureIterator::readFeature( OGRFeatureH fet, QgsFeatureBatch& batch )
+{
+  OGRGeometryH geom = mFetchGeometry ? OGR_F_GetGeometryRef( fet ) : 0;
+  if ( !geom && !mRequest.filterRect().isNull() )
+    return false;
+
+  int row = batch.addFeature( OGR_F_GetFID( fet ) );
+
+  if ( geom && !( mRequest.flags() & QgsFeatureRequest::NoGeometry ) )
+  {
+    if ( mGeometrySimplifier )
+      mGeometrySimplifier->simplifyGeometry( geom );
+
+    // export the wkb representation straight into the batch
+    int memorySize = OGR_G_WkbSize( geom );
+    OGR_G_ExportToWkb( geom, ( OGRwkbByteOrder ) QgsApplication::endian(), batch.allocateGeometryWkb( row, memorySize ) );
+  }
+
+  QVariant value;
+  if ( mRequest.flags() & QgsFeatureRequest::SubsetOfAttributes )
+  {
+    const QgsAttributeList& attrs = mRequest.subsetOfAttributes();
+    for ( QgsAttributeList::const_iterator it = attrs.begin(); it != attrs.end(); ++it )
+    {
+      if ( featureAttribute( fet, *it, value ) )
+        batch.setAttribute( row, *it, value );
+    }
+  }
+  else
+  {
+    for ( int idx = 0; idx < mSource->mFields.count(); ++idx )
+    {
+      if ( featureAttribute( fet, idx, value ) )
+        batch.setAttribute( row, idx, value );
+    }
+  }
+
+  return true;
+}
+
+
 QgsOgrFeatureSource::QgsOgrFeatureSource( const QgsOgrProvider* p )
 {
   mFilePath = p->filePath();
@@ -43,6 +43,7 @@ class QgsOgrFeatureSource : public QgsAbstractFeatureSource
     QString mDriverName;
 
     friend class QgsOgrFeatureIterator;
+    friend class QgsOgrExpressionCompiler;
 };
 
 class QgsOgrFeatureIterator : public QgsAbstractFeatureIteratorFromSource<QgsOgrFeatureSource>
@@ -62,6 +63,13 @@ class QgsOgrFeatureIterator : public QgsAbstractFeatureIteratorFromSource<QgsOgr
     //! fetch next feature, return true on success
     virtual bool fetchFeature( QgsFeature& feature ) override;
 
+    //! fetch features directly into the batch, without intermediate QgsFeature and QgsGeometry
+    virtual int fetchFeatures( QgsFeatureBatch& batch, int maxCount ) override;
+    virtual bool providesBatches() const override;
+
+    //! skips the local evaluation if the filter expression was set as attribute filter
+    virtual bool nextFeatureFilterExpression( QgsFeature& f ) override;
+
     //! Setup the simplification of geometries to fetch using the specified simplify method
     virtual bool prepareSimplification( const QgsSimplifyMethod& simplifyMethod ) override;
 
@@ -71,6 +79,12 @@ class QgsOgrFeatureIterator : public QgsAbstractFeatureIteratorFromSource<QgsOgr
     //! Get an attribute associated with a feature
     void getFeatureAttribute( OGRFeatureH ogrFet, QgsFeature & f, int attindex );
 
+    //! Reads feature into a new row of the batch, returns false if the feature is skipped
+    bool readFeature( OGRFeatureH fet, QgsFeatureBatch& batch );
+
+    //! Get the value of an attribute of an OGR feature, returns false if the field does not exist
+    bool featureAttribute( OGRFeatureH ogrFet, int attindex, QVariant& value );
+
     bool mFeatureFetched;
 
     QgsOgrConn* mConn;
@@ -78,6 +92,12 @@ class QgsOgrFeatureIterator : public QgsAbstractFeatureIteratorFromSource<QgsOgr
 
     bool mSubsetStringSet;
 
+    //! Set to true, if the compiled filter expression was set as attribute filter of the layer
+    bool mAttributeFilterSet;
+
+    //! Set to true, if the attribute filter matches the filter expression exactly
+    bool mExpressionCompiled;
+
     //! Set to true, if geometry is in the requested columns
     bool mFetchGeometry;
 
@@ -28,10 +28,14 @@
 #include "qgswkbtypes.h"
 
 #include <QApplication>
+#include <QDate>
 #include <QSettings>
 #include <QThread>
+#include <QtEndian>
 
 #include <climits>
+#include <cmath>
+#include <limits>
 
 // for htonl
 #ifdef Q_OS_WIN
@@ -1127,6 +1131,18 @@ int QgsPostgresConn::PQsendQuery( QString query )
   return ::PQsendQuery( mConn, query.toUtf8() );
 }
 
+int QgsPostgresConn::PQputCopyData( const QByteArray &data )
+{
+  Q_ASSERT( mConn );
+  return ::PQputCopyData( mConn, data.constData(), data.size() );
+}
+
+int QgsPostgresConn::PQputCopyEnd( const QString &errorMessage )
+{
+  Q_ASSERT( mConn );
+  return ::PQputCopyEnd( mConn, errorMessage.isNull() ? 0 : errorMessage.toUtf8().constData() );
+}
+
 bool QgsPostgresConn::begin()
 {
   if ( mTransaction )
@@ -1273,6 +1289,218 @@ QString QgsPostgresConn::fieldExpression( const QgsField &fld, QString expr )
   }
 }
 
+// oids of the built-in types decoded by getBinaryValue() (see catalog/pg_type.h)
+enum
+{
+  BoolOid = 16,
+  Int8Oid = 20,
+  Int2Oid = 21,
+  Int4Oid = 23,
+  TextOid = 25,
+  Float4Oid = 700,
+  Float8Oid = 701,
+  DateOid = 1082,
+  TimeOid = 1083,
+  TimestampOid = 1114,
+  NumericOid = 1700
+};
+
+QString QgsPostgresConn::binaryFieldExpression( const QgsField &fld )
+{
+  const QString &type = fld.typeName();
+  if ( type == "bool" || type == "int2" || type == "int4" || type == "int8" ||
+       type == "float4" || type == "float8" || type == "numeric" || type == "date" ||
+       (( type == "timestamp" || type == "time" ) && binaryDateTimes() ) )
+  {
+    // casting to the type itself also resolves domains to their base type
+    return QString( "%1::%2" ).arg( quotedIdentifier( fld.name() ), type );
+  }
+
+  return fieldExpression( fld );
+}
+
+bool QgsPostgresConn::binaryDateTimes()
+{
+  // timestamps and times are exposed with their text representation, which getBinaryValue()
+  // only reproduces for the ISO date style and 64 bit integer microseconds (the defaults).
+  // The text of timestamptz and timetz values depends on the session time zone, they are
+  // always fetched as text.
+  const char *dateStyle = ::PQparameterStatus( mConn, "DateStyle" );
+  const char *integerDateTimes = ::PQparameterStatus( mConn, "integer_datetimes" );
+  return dateStyle && integerDateTimes &&
+         QString( dateStyle ).startsWith( "ISO" ) && qstrcmp( integerDateTimes, "on" ) == 0;
+}
+
+// text representation of a time of day in microseconds in ISO style, ie. HH:MM:SS[.ffffff]
+static QString binaryTimeText( qint64 usecs )
+{
+  qint64 secs = usecs / 1000000;
+  int fraction = usecs % 1000000;
+
+  QString text = QString( "%1:%2:%3" )
+                 .arg( secs / 3600, 2, 10, QChar( '0' ) )
+                 .arg(( secs / 60 ) % 60, 2, 10, QChar( '0' ) )
+                 .arg( secs % 60, 2, 10, QChar( '0' ) );
+
+  if ( fraction > 0 )
+  {
+    QString digits = QString( "%1" ).arg( fraction, 6, 10, QChar( '0' ) );
+    while ( digits.endsWith( '0' ) )
+      digits.chop( 1 );
+    text += '.' + digits;
+  }
+
+  return text;
+}
+
+// text representation of a timestamp in microseconds since 2000-01-01 in ISO style
+static QString binaryTimestampText( qint64 usecs )
+{
+  if ( usecs == std::numeric_limits<qint64>::max() )
+    return "infinity";
+  if ( usecs == std::numeric_limits<qint64>::min() )
+    return "-infinity";
+
+  const qint64 usecsPerDay = Q_INT64_C( 86400000000 );
+  qint64 days = usecs / usecsPerDay;
+  usecs %= usecsPerDay;
+  if ( usecs < 0 )
+  {
+    days--;
+    usecs += usecsPerDay;
+  }
+
+  // there is no year 0 in QDate, 1 BC is year -1
+  QDate date = QDate( 2000, 1, 1 ).addDays( days );
+  QString text = QString( "%1-%2-%3 %4" )
+                 .arg( qAbs( date.year() ), 4, 10, QChar( '0' ) )
+                 .arg( date.month(), 2, 10, QChar( '0' ) )
+                 .arg( date.day(), 2, 10, QChar( '0' ) )
+                 .arg( binaryTimeText( usecs ) );
+
+  return date.year() < 0 ? text + " BC" : text;
+}
+
+static double binaryNumericValue( const uchar *p, int len )
+{
+  // numeric: ndigits, weight, sign and dscale followed by ndigits base 10000 digits
+  if ( len < 8 )
+    return std::numeric_limits<double>::quiet_NaN();
+
+  int ndigits = qFromBigEndian<qint16>( p );
+  int weight = qFromBigEndian<qint16>( p + 2 );
+  quint16 sign = qFromBigEndian<quint16>( p + 4 );
+  if ( sign == 0xC000 || len < 8 + 2 * ndigits )
+    return std::numeric_limits<double>::quiet_NaN();
+
+  const uchar *digits = p + 8;
+  double value;
+  int exponent = weight - ndigits + 1;
+  if ( ndigits <= 3 && qAbs( exponent ) <= 5 )
+  {
+    // at most 12 decimal digits scaled by an exact power of ten: the result is correctly rounded
+    qint64 mantissa = 0;
+    for ( int i = 0; i < ndigits; ++i )
+      mantissa = mantissa * 10000 + qFromBigEndian<qint16>( digits + 2 * i );
+
+    double scale = std::pow( 10000.0, qAbs( exponent ) );
+    value = exponent < 0 ? mantissa / scale : mantissa * scale;
+  }
+  else
+  {
+    // let the string conversion do the rounding
+    QByteArray str;
+    str.reserve( 4 * ndigits + 8 );
+    for ( int i = 0; i < ndigits; ++i )
+      str += QByteArray::number( qFromBigEndian<qint16>( digits + 2 * i ) ).rightJustified( 4, '0' );
+    str += 'e' + QByteArray::number( 4 * exponent );
+    value = str.toDouble();
+  }
+
+  return sign == 0x4000 ? -value : value;
+}
+
+QVariant QgsPostgresConn::getBinaryValue( QgsPostgresResult &queryResult, int row, int col, QVariant::Type type )
+{
+  PGresult *res = queryResult.result();
+  if ( ::PQgetisnull( res, row, col ) )
+    return QVariant( type );
+
+  const uchar *p = reinterpret_cast<const uchar *>( ::PQgetvalue( res, row, col ) );
+  int len = ::PQgetlength( res, row, col );
+
+  QVariant value;
+  switch ( ::PQftype( res, col ) )
+  {
+    case BoolOid:
+      // booleans are exposed with their text representation
+      value = QString( len > 0 && p[0] ? "t" : "f" );
+      break;
+
+    case Int2Oid:
+      value = ( int ) qFromBigEndian<qint16>( p );
+      break;
+
+    case Int4Oid:
+      value = ( int ) qFromBigEndian<qint32>( p );
+      break;
+
+    case Int8Oid:
+      value = ( qlonglong ) qFromBigEndian<qint64>( p );
+      break;
+
+    case Float4Oid:
+    {
+      quint32 bits = qFromBigEndian<quint32>( p );
+      float f;
+      memcpy( &f, &bits, sizeof( f ) );
+      value = ( double ) f;
+      break;
+    }
+
+    case Float8Oid:
+    {
+      quint64 bits = qFromBigEndian<quint64>( p );
+      double d;
+      memcpy( &d, &bits, sizeof( d ) );
+      value = d;
+      break;
+    }
+
+    case NumericOid:
+      value = binaryNumericValue( p, len );
+      break;
+
+    case DateOid:
+    {
+      // days since 2000-01-01, +/-infinity are not representable
+      qint32 days = qFromBigEndian<qint32>( p );
+      if ( days == INT_MAX || days == INT_MIN )
+        return QVariant( type );
+      value = QDate( 2000, 1, 1 ).addDays( days );
+      break;
+    }
+
+    case TimeOid:
+      // microseconds since midnight
+      value = binaryTimeText( qFromBigEndian<qint64>( p ) );
+      break;
+
+    case TimestampOid:
+      value = binaryTimestampText( qFromBigEndian<qint64>( p ) );
+      break;
+
+    default:
+      // everything else was converted to text
+      return QgsVectorDataProvider::convertValue( type, QString::fromUtf8( reinterpret_cast<const char *>( p ), len ) );
+  }
+
+  if ( value.type() != type && !value.convert( type ) )
+    return QVariant( type );
+
+  return value;
+}
+
 void QgsPostgresConn::deduceEndian()
 {
   // need to store the PostgreSQL endian format used in binary cursors
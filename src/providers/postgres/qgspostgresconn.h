@@ -243,6 +243,8 @@ class QgsPostgresConn : public QObject
     PGresult *PQgetResult();
     PGresult *PQprepare( QString stmtName, QString query, int nParams, const Oid *paramTypes );
     PGresult *PQexecPrepared( QString stmtName, const QStringList &params );
+    int PQputCopyData( const QByteArray &data );
+    int PQputCopyEnd( const QString &errorMessage = QString::null );
 
     bool begin();
     bool commit();
@@ -299,6 +301,26 @@ class QgsPostgresConn : public QObject
 
     QString fieldExpression( const QgsField &fld, QString expr = "%1" );
 
+    /** Returns the expression to fetch a field with a binary cursor. Numbers, dates, booleans,
+     * timestamps and times are fetched in their binary representation, all other types as
+     * text (see fieldExpression()). The values are decoded with getBinaryValue().
+     * @note added in 2.12
+     */
+    QString binaryFieldExpression( const QgsField &fld );
+
+    /** Returns true if timestamps and times can be fetched in their binary representation,
+     * which requires the ISO date style and integer date times on the server.
+     * @note added in 2.12
+     */
+    bool binaryDateTimes();
+
+    /** Decodes a value of a binary cursor fetched with binaryFieldExpression() or
+     * fieldExpression() into a value of given type. Returns a null value of that type
+     * for nulls and values that cannot be converted.
+     * @note added in 2.12
+     */
+    static QVariant getBinaryValue( QgsPostgresResult &queryResult, int row, int col, QVariant::Type type );
+
     QString connInfo() const { return mConnInfo; }
 
     static const int sGeomTypeSelectLimit;
@@ -16,202 +16,71 @@
 #include "qgspostgresexpressioncompiler.h"
 
 QgsPostgresExpressionCompiler::QgsPostgresExpressionCompiler( QgsPostgresFeatureSource* source )
-    : mResult( None )
+    : QgsSqlExpressionCompiler( source->mFields )
     , mSource( source )
 {
 }
 
-QgsPostgresExpressionCompiler::~QgsPostgresExpressionCompiler()
+QString QgsPostgresExpressionCompiler::quotedIdentifier( const QString& identifier )
 {
-
+  return QgsPostgresConn::quotedIdentifier( identifier );
 }
 
-QgsPostgresExpressionCompiler::Result QgsPostgresExpressionCompiler::compile( const QgsExpression* exp )
+QString QgsPostgresExpressionCompiler::quotedValue( const QVariant& value, bool& ok )
 {
-  if ( exp->rootNode() )
-    return compile( exp->rootNode(), mResult );
-  else
-    return Fail;
+  ok = true;
+  return QgsPostgresConn::quotedValue( value );
 }
 
-QgsPostgresExpressionCompiler::Result QgsPostgresExpressionCompiler::compile( const QgsExpression::Node* node, QString& result )
+QgsSqlExpressionCompiler::Result QgsPostgresExpressionCompiler::compileNode( const QgsExpression::Node* node, QString& result )
 {
-  switch ( node->nodeType() )
+  if ( node->nodeType() == QgsExpression::ntFunction )
   {
-    case QgsExpression::ntUnaryOperator:
-    {
-      const QgsExpression::NodeUnaryOperator* n = static_cast<const QgsExpression::NodeUnaryOperator*>( node );
-      switch ( n->op() )
-      {
-        case QgsExpression::uoNot:
-          break;
-
-        case QgsExpression::uoMinus:
-          break;
-      }
-
-      break;
-    }
-
-    case QgsExpression::ntBinaryOperator:
+    // the feature id is the value of an integer primary key
+    const QgsExpression::NodeFunction* n = static_cast<const QgsExpression::NodeFunction*>( node );
+    if ( QgsExpression::Functions()[n->fnIndex()]->name() == "$id" && mSource->mPrimaryKeyType == pktInt )
     {
-      const QgsExpression::NodeBinaryOperator* n = static_cast<const QgsExpression::NodeBinaryOperator*>( node );
-
-      QString op;
-      switch ( n->op() )
-      {
-        case QgsExpression::boEQ:
-          op = "=";
-          break;
-
-        case QgsExpression::boGE:
-          op = ">=";
-          break;
-
-        case QgsExpression::boGT:
-          op = ">";
-          break;
-
-        case QgsExpression::boLE:
-          op = "<=";
-          break;
-
-        case QgsExpression::boLT:
-          op = "<";
-          break;
-
-        case QgsExpression::boIs:
-          op = "IS";
-          break;
-
-        case QgsExpression::boIsNot:
-          op = "IS NOT";
-          break;
-
-        case QgsExpression::boLike:
-          op = "LIKE";
-          break;
-
-        case QgsExpression::boILike:
-          op = "ILIKE";
-          break;
-
-        case QgsExpression::boNotLike:
-          op = "NOT LIKE";
-          break;
-
-        case QgsExpression::boNotILike:
-          op = "NOT ILIKE";
-          break;
-
-        case QgsExpression::boOr:
-          op = "OR";
-          break;
-
-        case QgsExpression::boAnd:
-          op = "AND";
-          break;
-
-        case QgsExpression::boNE:
-          op = "<>";
-          break;
-
-        case QgsExpression::boMul:
-          op = "*";
-          break;
-
-        case QgsExpression::boPlus:
-          op = "+";
-          break;
-
-        case QgsExpression::boMinus:
-          op = "-";
-          break;
-
-        case QgsExpression::boDiv:
-          return Fail;  // handle cast to real
-
-        case QgsExpression::boMod:
-          op = "%";
-          break;
-
-        case QgsExpression::boConcat:
-          op = "||";
-          break;
-
-        case QgsExpression::boIntDiv:
-          return Fail;  // handle cast to int
-
-        case QgsExpression::boPow:
-          op = "^";
-          break;
-
-        case QgsExpression::boRegexp:
-          op = "~";
-          break;
-      }
-
-      if ( op.isNull() )
-        return Fail;
-
-      QString left;
-      Result lr( compile( n->opLeft(), left ) );
-
-      QString right;
-      Result rr( compile( n->opRight(), right ) );
-
-      result = left + " " + op + " " + right;
-      return ( lr == Complete && rr == Complete ) ? Complete : Fail;
-    }
-
-    case QgsExpression::ntLiteral:
-    {
-      const QgsExpression::NodeLiteral* n = static_cast<const QgsExpression::NodeLiteral*>( node );
-      result = QgsPostgresConn::quotedValue( n->value() );
+      result = quotedIdentifier( mSource->mFields.at( mSource->mPrimaryKeyAttrs.at( 0 ) ).name() );
       return Complete;
     }
+    return Fail;
+  }
 
-    case QgsExpression::ntColumnRef:
+  if ( node->nodeType() == QgsExpression::ntBinaryOperator )
+  {
+    const QgsExpression::NodeBinaryOperator* n = static_cast<const QgsExpression::NodeBinaryOperator*>( node );
+
+    QString op;
+    switch ( n->op() )
     {
-      const QgsExpression::NodeColumnRef* n = static_cast<const QgsExpression::NodeColumnRef*>( node );
+      case QgsExpression::boMod:
+        op = "%";
+        break;
 
-      if ( mSource->mFields.indexFromName( n->name() ) == -1 )
-        // Not a provider field
-        return Fail;
+      case QgsExpression::boPow:
+        op = "^";
+        break;
 
-      result = QgsPostgresConn::quotedIdentifier( n->name() );
+      case QgsExpression::boRegexp:
+        op = "~";
+        break;
 
-      return Complete;
+      default:
+        break;
     }
 
-    case QgsExpression::ntInOperator:
+    if ( !op.isNull() )
     {
-      const QgsExpression::NodeInOperator* n = static_cast<const QgsExpression::NodeInOperator*>( node );
-      QStringList list;
-
-      Q_FOREACH ( const QgsExpression::Node* ln, n->list()->list() )
-      {
-        QString s;
-        Result r = compile( ln, s );
-        if ( r == Complete )
-          list << s;
-        else
-          return r;
-      }
+      QString left;
+      Result lr( compileNode( n->opLeft(), left ) );
 
-      QString nd;
-      Result rn = compile( n->node(), nd );
-      if ( rn != Complete )
-        return rn;
+      QString right;
+      Result rr( compileNode( n->opRight(), right ) );
 
-      result = QString( "%1 %2IN(%3)" ).arg( nd, n->isNotIn() ? "NOT " : "", list.join( "," ) );
-      return Complete;
+      result = "(" + left + " " + op + " " + right + ")";
+      return ( lr == Complete && rr == Complete ) ? Complete : Fail;
     }
-
-    case QgsExpression::ntFunction:
-    case QgsExpression::ntCondition:
-      break;
   }
 
-  return Fail;
+  return QgsSqlExpressionCompiler::compileNode( node, result );
 }
@@ -12,12 +12,14 @@
  *   (at your option) any later version.                                   *
  *                                                                         *
  ***************************************************************************/
+#include "qgsapplication.h"
 #include "qgsgeometry.h"
 #include "qgspostgresconnpool.h"
 #include "qgspostgresexpressioncompiler.h"
 #include "qgspostgresfeatureiterator.h"
 #include "qgspostgresprovider.h"
 #include "qgspostgrestransaction.h"
+#include "qgstwkbreader.h"
 
 #include "qgslogger.h"
 #include "qgsmessagelog.h"
@@ -25,18 +27,38 @@
 #include <QObject>
 #include <QSettings>
 
+#include <cmath>
 
 const int QgsPostgresFeatureIterator::sFeatureQueueSize = 2000;
+const int QgsPostgresFeatureIterator::sMaxFetchSize = 100000;
+const int QgsPostgresFeatureIterator::sMaxFetchBytes = 16 * 1024 * 1024;
 
 
-QgsPostgresFeatureIterator::QgsPostgresFeatureIterator( QgsPostgresFeatureSource* source, bool ownSource, const QgsFeatureRequest& request )
+QgsPostgresFeatureIterator::QgsPostgresFeatureIterator( QgsPostgresFeatureSource* source, bool ownSource, const QgsFeatureRequest& request,
+    QgsPostgresConn* conn, const QString& partitionClause )
     : QgsAbstractFeatureIteratorFromSource<QgsPostgresFeatureSource>( source, ownSource, request )
+    , mFeatureQueueRow( 0 )
     , mFeatureQueueSize( sFeatureQueueSize )
     , mFetched( 0 )
+    , mFetchResultRow( 0 )
+    , mFetchResultRows( 0 )
+    , mFetchPending( false )
+    , mCursorExhausted( false )
+    , mFetchSize( sFeatureQueueSize )
     , mFetchGeometry( false )
+    , mFetchTwkb( false )
+    , mUseTwkb( QSettings().value( "/qgis/postgres/twkbGeometries", true ).toBool() )
+    , mBinaryAttributes( QSettings().value( "/qgis/postgres/binaryAttributes", true ).toBool() )
     , mExpressionCompiled( false )
+    , mOrderByCompiled( false )
+    , mLimitCompiled( false )
 {
-  if ( !source->mTransactionConnection )
+  if ( conn )
+  {
+    mConn = conn;
+    mIsTransactionConnection = false;
+  }
+  else if ( !source->mTransactionConnection )
   {
     mConn = QgsPostgresConnPool::instance()->acquireConnection( mSource->mConnInfo );
     mIsTransactionConnection = false;
@@ -76,14 +98,17 @@ QgsPostgresFeatureIterator::QgsPostgresFeatureIterator( QgsPostgresFeatureSource
     whereClause = QgsPostgresUtils::andWhereClauses( whereClause, fidsWhereClause );
   }
   else if ( request.filterType() == QgsFeatureRequest::FilterExpression
-            && QSettings().value( "/qgis/postgres/compileExpressions", false ).toBool() )
+            && QgsSqlExpressionCompiler::compilationEnabled() )
   {
     QgsPostgresExpressionCompiler compiler = QgsPostgresExpressionCompiler( source );
 
-    if ( compiler.compile( request.filterExpression() ) == QgsPostgresExpressionCompiler::Complete )
+    // a partially compiled expression still reduces the rows fetched,
+    // but has to be evaluated on each feature
+    QgsSqlExpressionCompiler::Result result = compiler.compile( request.filterExpression() );
+    if ( result == QgsSqlExpressionCompiler::Complete || result == QgsSqlExpressionCompiler::Partial )
     {
       whereClause = QgsPostgresUtils::andWhereClauses( whereClause, compiler.result() );
-      mExpressionCompiled = true;
+      mExpressionCompiled = result == QgsSqlExpressionCompiler::Complete;
     }
   }
 
@@ -95,7 +120,37 @@ QgsPostgresFeatureIterator::QgsPostgresFeatureIterator( QgsPostgresFeatureSource
     whereClause += "(" + mSource->mSqlWhereClause + ")";
   }
 
-  if ( !declareCursor( whereClause ) )
+  whereClause = QgsPostgresUtils::andWhereClauses( whereClause, partitionClause );
+
+  QStringList orderByParts;
+  if ( !request.orderBy().isEmpty() && QgsSqlExpressionCompiler::compilationEnabled() )
+  {
+    mOrderByCompiled = true;
+    Q_FOREACH ( const QgsFeatureRequest::OrderByClause& clause, request.orderBy() )
+    {
+      QgsPostgresExpressionCompiler compiler = QgsPostgresExpressionCompiler( source );
+      QgsExpression expression( clause.expression() );
+      if ( compiler.compile( &expression ) != QgsSqlExpressionCompiler::Complete )
+      {
+        mOrderByCompiled = false;
+        break;
+      }
+
+      orderByParts << QString( "%1 %2 %3" ).arg( compiler.result(),
+                      clause.ascending() ? "ASC" : "DESC",
+                      clause.nullsFirst() ? "NULLS FIRST" : "NULLS LAST" );
+    }
+  }
+
+  // the server can only stop at the limit if it returns exactly the features to return
+  long limit = -1;
+  if ( request.limit() >= 0 &&
+       ( request.filterType() != QgsFeatureRequest::FilterExpression || mExpressionCompiled ) &&
+       ( request.orderBy().isEmpty() || mOrderByCompiled ) )
+    limit = request.limit();
+  mLimitCompiled = limit >= 0;
+
+  if ( !declareCursor( whereClause, mOrderByCompiled ? orderByParts.join( "," ) : QString(), limit ) )
   {
     mClosed = true;
     iteratorClosed();
@@ -103,6 +158,9 @@ QgsPostgresFeatureIterator::QgsPostgresFeatureIterator( QgsPostgresFeatureSource
   }
 
   mFetched = 0;
+
+  // let the server start working on the first block right away
+  sendFetch();
 }
 
 
@@ -119,57 +177,168 @@ bool QgsPostgresFeatureIterator::fetchFeature( QgsFeature& feature )
   if ( mClosed )
     return false;
 
-  if ( mFeatureQueue.empty() )
+  if ( mFeatureQueueRow >= mFeatureQueue.size() )
   {
-    QString fetch = QString( "FETCH FORWARD %1 FROM %2" ).arg( mFeatureQueueSize ).arg( mCursorName );
-    QgsDebugMsgLevel( QString( "fetching %1 features." ).arg( mFeatureQueueSize ), 4 );
-    if ( mConn->PQsendQuery( fetch ) == 0 ) // fetch features asynchronously
-    {
-      QgsMessageLog::logMessage( QObject::tr( "Fetching from cursor %1 failed\nDatabase error: %2" ).arg( mCursorName, mConn->PQerrorMessage() ), QObject::tr( "PostGIS" ) );
-    }
-
-    QgsPostgresResult queryResult;
-    for ( ;; )
-    {
-      queryResult = mConn->PQgetResult();
-      if ( !queryResult.result() )
-        break;
+    fetchBlock( mFeatureQueue, mFeatureQueueSize );
+    mFeatureQueueRow = 0;
+  }
 
-      if ( queryResult.PQresultStatus() != PGRES_TUPLES_OK )
-      {
-        QgsMessageLog::logMessage( QObject::tr( "Fetching from cursor %1 failed\nDatabase error: %2" ).arg( mCursorName, mConn->PQerrorMessage() ), QObject::tr( "PostGIS" ) );
-        break;
-      }
+  if ( mFeatureQueue.isEmpty() )
+  {
+    QgsDebugMsg( QString( "Finished after %1 features" ).arg( mFetched ) );
+    close();
 
-      int rows = queryResult.PQntuples();
-      if ( rows == 0 )
-        continue;
+    mSource->mShared->ensureFeaturesCountedAtLeast( mFetched );
 
-      for ( int row = 0; row < rows; row++ )
-      {
-        mFeatureQueue.enqueue( QgsFeature() );
-        getFeature( queryResult, row, mFeatureQueue.back() );
-      } // for each row in queue
-    }
+    return false;
   }
 
-  if ( mFeatureQueue.empty() )
+  mFeatureQueue.feature( mFeatureQueueRow++, feature );
+  mFetched++;
+
+  return true;
+}
+
+int QgsPostgresFeatureIterator::fetchFeatures( QgsFeatureBatch& batch, int maxCount )
+{
+  if ( mClosed )
+    return 0;
+
+  // features already fetched into the queue go first
+  if ( mFeatureQueueRow < mFeatureQueue.size() )
+    return QgsAbstractFeatureIterator::fetchFeatures( batch, qMin( maxCount, mFeatureQueue.size() - mFeatureQueueRow ) );
+
+  fetchBlock( batch, maxCount );
+
+  if ( batch.isEmpty() )
   {
     QgsDebugMsg( QString( "Finished after %1 features" ).arg( mFetched ) );
     close();
 
     mSource->mShared->ensureFeaturesCountedAtLeast( mFetched );
 
+    return 0;
+  }
+
+  mFetched += batch.size();
+  return batch.size();
+}
+
+void QgsPostgresFeatureIterator::fetchBlock( QgsFeatureBatch& batch, int count )
+{
+  batch.clear();
+  batch.setFields( mSource->mFields );
+
+  while ( batch.size() < count )
+  {
+    if ( mFetchResultRow >= mFetchResultRows && !receiveFetch() )
+      break;
+
+    int rows = qMin( mFetchResultRows, mFetchResultRow + count - batch.size() );
+    for ( ; mFetchResultRow < rows; mFetchResultRow++ )
+    {
+      getFeature( mFetchResult, mFetchResultRow, batch );
+    }
+  }
+}
+
+void QgsPostgresFeatureIterator::sendFetch()
+{
+  if ( mFetchPending || mCursorExhausted )
+    return;
+
+  QString fetch = QString( "FETCH FORWARD %1 FROM %2" ).arg( mFetchSize ).arg( mCursorName );
+  QgsDebugMsgLevel( QString( "fetching %1 features." ).arg( mFetchSize ), 4 );
+  if ( mConn->PQsendQuery( fetch ) == 0 ) // fetch features asynchronously
+  {
+    QgsMessageLog::logMessage( QObject::tr( "Fetching from cursor %1 failed\nDatabase error: %2" ).arg( mCursorName, mConn->PQerrorMessage() ), QObject::tr( "PostGIS" ) );
+    mCursorExhausted = true;
+    return;
+  }
+
+  mFetchPending = true;
+  mFetchTime.start();
+}
+
+bool QgsPostgresFeatureIterator::receiveFetch()
+{
+  mFetchResult = ( PGresult * ) 0;
+  mFetchResultRow = 0;
+  mFetchResultRows = 0;
+
+  if ( !mFetchPending )
     return false;
+
+  QTime waitTime;
+  waitTime.start();
+
+  for ( ;; )
+  {
+    PGresult *res = mConn->PQgetResult();
+    if ( !res )
+      break;
+
+    if ( ::PQresultStatus( res ) != PGRES_TUPLES_OK )
+    {
+      QgsMessageLog::logMessage( QObject::tr( "Fetching from cursor %1 failed\nDatabase error: %2" ).arg( mCursorName, mConn->PQerrorMessage() ), QObject::tr( "PostGIS" ) );
+      ::PQclear( res );
+      mCursorExhausted = true;
+      continue;
+    }
+
+    mFetchResult = res;
+    mFetchResultRows = ::PQntuples( res );
   }
+  mFetchPending = false;
 
-  feature = mFeatureQueue.dequeue();
-  mFetched++;
+  int rows = mFetchResultRows;
+  if ( rows < mFetchSize )
+  {
+    mCursorExhausted = true;
+  }
+  else
+  {
+    int waited = waitTime.elapsed();
 
-  feature.setValid( true );
-  feature.setFields( mSource->mFields ); // allow name-based attribute lookups
+    // If the consumer had to wait for the rows, the latency of the FETCH was not hidden
+    // behind the processing of the previous block: fetch more rows at once, as long as
+    // a block does not get too big to be kept in memory.
+    if ( waited > 0 && mFetchSize < sMaxFetchSize )
+    {
+      int rowBytes = 0;
+      for ( int col = 0; col < mFetchResult.PQnfields(); col++ )
+        rowBytes += ::PQgetlength( mFetchResult.result(), 0, col );
+
+      int maxSize = qBound( sFeatureQueueSize, sMaxFetchBytes / qMax( 1, rowBytes ), sMaxFetchSize );
+      mFetchSize = qMin( 2 * mFetchSize, maxSize );
+      QgsDebugMsgLevel( QString( "waited %1 of %2 ms for %3 rows of about %4 bytes: fetch size is now %5" )
+                        .arg( waited ).arg( mFetchTime.elapsed() ).arg( rows ).arg( rowBytes ).arg( mFetchSize ), 3 );
+    }
 
-  return true;
+    // prefetch the next block while this one is consumed
+    sendFetch();
+  }
+
+  return rows > 0;
+}
+
+void QgsPostgresFeatureIterator::discardFetch()
+{
+  if ( mFetchPending )
+  {
+    QgsPostgresResult queryResult;
+    do
+    {
+      queryResult = mConn->PQgetResult();
+    }
+    while ( queryResult.result() );
+    mFetchPending = false;
+  }
+
+  mFetchResult = ( PGresult * ) 0;
+  mFetchResultRow = 0;
+  mFetchResultRows = 0;
+  mCursorExhausted = false;
 }
 
 bool QgsPostgresFeatureIterator::nextFeatureFilterExpression( QgsFeature& f )
@@ -201,6 +370,12 @@ bool QgsPostgresFeatureIterator::prepareSimplification( const QgsSimplifyMethod&
   return QgsAbstractFeatureIterator::prepareSimplification( simplifyMethod );
 }
 
+bool QgsPostgresFeatureIterator::prepareOrderBy( const QList<QgsFeatureRequest::OrderByClause>& orderBys )
+{
+  Q_UNUSED( orderBys )
+  return mOrderByCompiled;
+}
+
 bool QgsPostgresFeatureIterator::providerCanSimplify( QgsSimplifyMethod::MethodType methodType ) const
 {
   return methodType == QgsSimplifyMethod::OptimizeForRendering || methodType == QgsSimplifyMethod::PreserveTopology;
@@ -211,11 +386,16 @@ bool QgsPostgresFeatureIterator::rewind()
   if ( mClosed )
     return false;
 
+  discardFetch();
+
   // move cursor to first record
   mConn->PQexecNR( QString( "move absolute 0 in %1" ).arg( mCursorName ) );
   mFeatureQueue.clear();
+  mFeatureQueueRow = 0;
   mFetched = 0;
 
+  sendFetch();
+
   return true;
 }
 
@@ -224,6 +404,7 @@ bool QgsPostgresFeatureIterator::close()
   if ( mClosed )
     return false;
 
+  discardFetch();
   mConn->closeCursor( mCursorName );
 
   if ( !mIsTransactionConnection )
@@ -236,10 +417,8 @@ bool QgsPostgresFeatureIterator::close()
   }
   mConn = 0;
 
-  while ( !mFeatureQueue.empty() )
-  {
-    mFeatureQueue.dequeue();
-  }
+  mFeatureQueue.clear();
+  mFeatureQueueRow = 0;
 
   iteratorClosed();
 
@@ -320,7 +499,7 @@ QString QgsPostgresFeatureIterator::whereClauseRect()
 
 
 
-bool QgsPostgresFeatureIterator::declareCursor( const QString& whereClause )
+bool QgsPostgresFeatureIterator::declareCursor( const QString& whereClause, const QString& orderBy, long limit )
 {
   mFetchGeometry = !( mRequest.flags() & QgsFeatureRequest::NoGeometry ) && !mSource->mGeometryColumn.isNull();
 
@@ -355,11 +534,13 @@ bool QgsPostgresFeatureIterator::declareCursor( const QString& whereClause )
                    geom );
     }
 
+    QGis::WkbType layerGeomType = mSource->mRequestedGeomType != QGis::WKBUnknown
+                                  ? mSource->mRequestedGeomType
+                                  : mSource->mDetectedGeomType;
+
     if ( !mRequest.simplifyMethod().forceLocalOptimization() &&
          mRequest.simplifyMethod().methodType() != QgsSimplifyMethod::NoSimplification &&
-         QGis::flatType( QGis::singleType( mSource->mRequestedGeomType != QGis::WKBUnknown
-                                           ? mSource->mRequestedGeomType
-                                           : mSource->mDetectedGeomType ) ) != QGis::WKBPoint )
+         QGis::flatType( QGis::singleType( layerGeomType ) ) != QGis::WKBPoint )
     {
       geom = QString( "%1(%2,%3)" )
              .arg( mRequest.simplifyMethod().methodType() == QgsSimplifyMethod::OptimizeForRendering
@@ -369,10 +550,32 @@ bool QgsPostgresFeatureIterator::declareCursor( const QString& whereClause )
                  .arg( mRequest.simplifyMethod().tolerance() * 0.8 ); //-> Default factor for the maximum displacement distance for simplification, similar as GeoServer does
     }
 
-    geom = QString( "%1(%2,'%3')" )
-           .arg( mConn->majorVersion() < 2 ? "asbinary" : "st_asbinary",
-                 geom,
-                 QgsPostgresProvider::endianString() );
+    // Geometries simplified for rendering are fetched as TWKB (PostGIS 2.2+), quantized
+    // to the decimal digits that still resolve the tolerance. The integer deltas take
+    // a few bytes per vertex instead of 16 and more for WKB. The decoder writes little
+    // endian WKB and knows no curves, so the layer type must be known.
+    mFetchTwkb = mUseTwkb &&
+                 ( mConn->majorVersion() > 2 || ( mConn->majorVersion() == 2 && mConn->minorVersion() >= 2 ) ) &&
+                 QgsApplication::endian() == QgsApplication::NDR &&
+                 !mRequest.simplifyMethod().forceLocalOptimization() &&
+                 mRequest.simplifyMethod().methodType() == QgsSimplifyMethod::OptimizeForRendering &&
+                 mRequest.simplifyMethod().tolerance() > 0 &&
+                 layerGeomType != QGis::WKBUnknown &&
+                 QGis::flatType( QGis::singleType( layerGeomType ) ) != QGis::WKBPoint;
+
+    if ( mFetchTwkb )
+    {
+      int precision = qBound( -7, ( int ) std::ceil( -std::log10( mRequest.simplifyMethod().tolerance() ) ), 7 );
+      int precisionZM = qBound( 0, precision, 7 );
+      geom = QString( "st_astwkb(%1,%2,%3,%3)" ).arg( geom, QString::number( precision ), QString::number( precisionZM ) );
+    }
+    else
+    {
+      geom = QString( "%1(%2,'%3')" )
+             .arg( mConn->majorVersion() < 2 ? "asbinary" : "st_asbinary",
+                   geom,
+                   QgsPostgresProvider::endianString() );
+    }
 
     query += delim + geom;
     delim = ",";
@@ -415,7 +618,8 @@ bool QgsPostgresFeatureIterator::declareCursor( const QString& whereClause )
     if ( mSource->mPrimaryKeyAttrs.contains( idx ) )
       continue;
 
-    query += delim + mConn->fieldExpression( mSource->mFields.at( idx ) );
+    const QgsField &fld = mSource->mFields.at( idx );
+    query += delim + ( mBinaryAttributes ? mConn->binaryFieldExpression( fld ) : mConn->fieldExpression( fld ) );
   }
 
   query += " FROM " + mSource->mQuery;
@@ -423,6 +627,12 @@ bool QgsPostgresFeatureIterator::declareCursor( const QString& whereClause )
   if ( !whereClause.isEmpty() )
     query += QString( " WHERE %1" ).arg( whereClause );
 
+  if ( !orderBy.isEmpty() )
+    query += QString( " ORDER BY %1" ).arg( orderBy );
+
+  if ( limit >= 0 )
+    query += QString( " LIMIT %1" ).arg( limit );
+
   if ( !mConn->openCursor( mCursorName, query ) )
   {
 
@@ -436,20 +646,66 @@ bool QgsPostgresFeatureIterator::declareCursor( const QString& whereClause )
 }
 
 
-bool QgsPostgresFeatureIterator::getFeature( QgsPostgresResult &queryResult, int row, QgsFeature &feature )
+bool QgsPostgresFeatureIterator::getFeature( QgsPostgresResult &queryResult, int row, QgsFeatureBatch &batch )
 {
-  feature.initAttributes( mSource->mFields.count() );
+  // geometry comes first, then the primary key columns and the attributes
+  int col = mFetchGeometry ? 1 : 0;
 
-  int col = 0;
+  QgsFeatureId fid = 0;
+  QVariant pkValue;
+  QList<QVariant> primaryKeyVals;
+
+  switch ( mSource->mPrimaryKeyType )
+  {
+    case pktOid:
+    case pktTid:
+    case pktInt:
+      fid = mConn->getBinaryInt( queryResult, row, col++ );
+      pkValue = fid;
+      break;
+
+    case pktFidMap:
+    {
+      Q_FOREACH ( int idx, mSource->mPrimaryKeyAttrs )
+      {
+        const QgsField &fld = mSource->mFields.at( idx );
+
+        primaryKeyVals << QgsPostgresProvider::convertValue( fld.type(), queryResult.PQgetvalue( row, col ) );
+        col++;
+      }
+
+      fid = mSource->mShared->lookupFid( QVariant( primaryKeyVals ) );
+
+    }
+    break;
+
+    case pktUnknown:
+      Q_ASSERT( !"FAILURE: cannot get feature with unknown primary key" );
+      return false;
+  }
+
+  int batchRow = batch.addFeature( fid );
+  QgsDebugMsgLevel( QString( "fid=%1" ).arg( fid ), 4 );
 
   if ( mFetchGeometry )
   {
-    int returnedLength = ::PQgetlength( queryResult.result(), row, col );
-    if ( returnedLength > 0 )
+    int returnedLength = ::PQgetlength( queryResult.result(), row, 0 );
+    if ( mFetchTwkb )
     {
-      unsigned char *featureGeom = new unsigned char[returnedLength + 1];
-      memcpy( featureGeom, PQgetvalue( queryResult.result(), row, col ), returnedLength );
-      memset( featureGeom + returnedLength, 0, 1 );
+      if ( returnedLength > 0 )
+      {
+        const unsigned char *twkb = reinterpret_cast<const unsigned char *>( ::PQgetvalue( queryResult.result(), row, 0 ) );
+        int wkbSize = QgsTwkbReader::toWkb( twkb, returnedLength, mTwkbBuffer );
+        if ( wkbSize > 0 )
+          batch.setGeometryWkb( batchRow, reinterpret_cast<const unsigned char *>( mTwkbBuffer.constData() ), wkbSize );
+        else
+          QgsDebugMsg( QString( "Could not decode TWKB geometry of feature %1" ).arg( fid ) );
+      }
+    }
+    else if ( returnedLength > 0 )
+    {
+      unsigned char *featureGeom = batch.allocateGeometryWkb( batchRow, returnedLength );
+      memcpy( featureGeom, PQgetvalue( queryResult.result(), row, 0 ), returnedLength );
 
       unsigned int wkbType;
       memcpy( &wkbType, featureGeom + 1, sizeof( wkbType ) );
@@ -490,87 +746,279 @@ bool QgsPostgresFeatureIterator::getFeature( QgsPostgresResult &queryResult, int
           }
         }
       }
-
-      feature.setGeometryAndOwnership( featureGeom, returnedLength + 1 );
     }
-    else
+  }
+
+  bool subsetOfAttributes = mRequest.flags() & QgsFeatureRequest::SubsetOfAttributes;
+  const QgsAttributeList& fetchAttributes = mRequest.subsetOfAttributes();
+
+  // primary key attributes
+  if ( mSource->mPrimaryKeyType == pktInt )
+  {
+    if ( !subsetOfAttributes || fetchAttributes.contains( mSource->mPrimaryKeyAttrs[0] ) )
+      batch.setAttribute( batchRow, mSource->mPrimaryKeyAttrs[0], pkValue );
+  }
+  else if ( mSource->mPrimaryKeyType == pktFidMap )
+  {
+    for ( int i = 0; i < mSource->mPrimaryKeyAttrs.size(); ++i )
     {
-      feature.setGeometryAndOwnership( 0, 0 );
+      int idx = mSource->mPrimaryKeyAttrs.at( i );
+      if ( !subsetOfAttributes || fetchAttributes.contains( idx ) )
+        batch.setAttribute( batchRow, idx, primaryKeyVals.at( i ) );
     }
+  }
 
-    col++;
+  // iterate attributes
+  if ( subsetOfAttributes )
+  {
+    Q_FOREACH ( int idx, fetchAttributes )
+      getFeatureAttribute( idx, queryResult, row, col, batch, batchRow );
+  }
+  else
+  {
+    for ( int idx = 0; idx < mSource->mFields.count(); ++idx )
+      getFeatureAttribute( idx, queryResult, row, col, batch, batchRow );
   }
 
-  QgsFeatureId fid = 0;
+  return true;
+}
 
-  bool subsetOfAttributes = mRequest.flags() & QgsFeatureRequest::SubsetOfAttributes;
-  const QgsAttributeList& fetchAttributes = mRequest.subsetOfAttributes();
+void QgsPostgresFeatureIterator::getFeatureAttribute( int idx, QgsPostgresResult& queryResult, int row, int& col, QgsFeatureBatch& batch, int batchRow )
+{
+  if ( mSource->mPrimaryKeyAttrs.contains( idx ) )
+    return;
 
-  switch ( mSource->mPrimaryKeyType )
+  batch.setAttribute( batchRow, idx, QgsPostgresConn::getBinaryValue( queryResult, row, col, mSource->mFields.at( idx ).type() ) );
+
+  col++;
+}
+
+
+//  ------------------
+
+const int QgsPostgresParallelFeatureIterator::sBlockSize = 2000;
+
+QgsPostgresParallelFeatureIterator::QgsPostgresParallelFeatureIterator( QgsPostgresFeatureSource* source, bool ownSource, const QgsFeatureRequest& request )
+    : QgsAbstractFeatureIteratorFromSource<QgsPostgresFeatureSource>( source, ownSource, request )
+    , mCurrentPartition( 0 )
+    , mFeatureQueueRow( 0 )
+{
+  if ( !openPartitions() )
   {
-    case pktOid:
-    case pktTid:
-    case pktInt:
-      fid = mConn->getBinaryInt( queryResult, row, col++ );
-      if ( mSource->mPrimaryKeyType == pktInt &&
-           ( !subsetOfAttributes || fetchAttributes.contains( mSource->mPrimaryKeyAttrs[0] ) ) )
-        feature.setAttribute( mSource->mPrimaryKeyAttrs[0], fid );
+    close();
+  }
+}
+
+QgsPostgresParallelFeatureIterator::~QgsPostgresParallelFeatureIterator()
+{
+  close();
+}
+
+bool QgsPostgresParallelFeatureIterator::canSplit( const QgsPostgresFeatureSource* source, const QgsFeatureRequest& request )
+{
+  // a transaction has a single connection, feature id filters select few features anyway
+  // and ordered or limited scans have to be read in one piece
+  return request.flags() & QgsFeatureRequest::ParallelScan &&
+         request.orderBy().isEmpty() &&
+         request.limit() < 0 &&
+         !source->mTransactionConnection &&
+         source->mPrimaryKeyType == pktInt &&
+         source->mPrimaryKeyAttrs.size() == 1 &&
+         request.filterType() != QgsFeatureRequest::FilterFid &&
+         request.filterType() != QgsFeatureRequest::FilterFids;
+}
+
+bool QgsPostgresParallelFeatureIterator::openPartitions()
+{
+  // The first connection may wait for the pool like any other iterator. Further ones
+  // are only taken if they are free: waiting for them could deadlock this thread.
+  QgsPostgresConn* conn = QgsPostgresConnPool::instance()->acquireConnection( mSource->mConnInfo );
+  if ( !conn )
+    return false;
+
+  QList<QgsPostgresConn*> conns;
+  conns << conn;
+
+  // one connection of the pool is always left for rendering and other iterators
+  int poolConns = CONN_POOL_MAX_CONCURRENT_CONNS - 1;
+  int maxConns = qBound( 1, QSettings().value( "/qgis/postgres/parallelScanConnections", poolConns ).toInt(), poolConns );
+  while ( conns.size() < maxConns )
+  {
+    conn = QgsPostgresConnPool::instance()->tryAcquireConnection( mSource->mConnInfo );
+    if ( !conn )
       break;
+    conns << conn;
+  }
 
-    case pktFidMap:
+  QStringList clauses = partitionClauses( conns.first(), conns.size() );
+  QgsDebugMsg( QString( "scanning in %1 partitions" ).arg( clauses.size() ) );
+
+  for ( int i = 0; i < conns.size(); i++ )
+  {
+    if ( i < clauses.size() )
     {
-      QList<QVariant> primaryKeyVals;
+      // the iterator releases the connection when it is closed
+      mPartitions << QgsFeatureIterator( new QgsPostgresFeatureIterator( mSource, false, mRequest, conns.at( i ), clauses.at( i ) ) );
+    }
+    else
+    {
+      QgsPostgresConnPool::instance()->releaseConnection( conns.at( i ) );
+    }
+  }
 
-      Q_FOREACH ( int idx, mSource->mPrimaryKeyAttrs )
-      {
-        const QgsField &fld = mSource->mFields.at( idx );
+  mCurrentPartition = 0;
+  return true;
+}
 
-        QVariant v = QgsPostgresProvider::convertValue( fld.type(), queryResult.PQgetvalue( row, col ) );
-        primaryKeyVals << v;
+void QgsPostgresParallelFeatureIterator::closePartitions()
+{
+  for ( int i = 0; i < mPartitions.size(); i++ )
+    mPartitions[i].close();
+  mPartitions.clear();
+}
 
-        if ( !subsetOfAttributes || fetchAttributes.contains( idx ) )
-          feature.setAttribute( idx, v );
+QStringList QgsPostgresParallelFeatureIterator::partitionClauses( QgsPostgresConn* conn, int count )
+{
+  QStringList clauses;
+  if ( count < 2 )
+    return clauses << QString();
 
-        col++;
-      }
+  QString pk = QgsPostgresConn::quotedIdentifier( mSource->mFields.at( mSource->mPrimaryKeyAttrs.at( 0 ) ).name() );
+  QString sql = QString( "SELECT min(%1),max(%1) FROM %2" ).arg( pk, mSource->mQuery );
+  if ( !mSource->mSqlWhereClause.isEmpty() )
+    sql += " WHERE " + mSource->mSqlWhereClause;
 
-      fid = mSource->mShared->lookupFid( QVariant( primaryKeyVals ) );
+  QgsPostgresResult result = conn->PQexec( sql );
+  if ( result.PQresultStatus() != PGRES_TUPLES_OK || result.PQntuples() != 1 || result.PQgetisnull( 0, 0 ) )
+    return clauses << QString();
 
-    }
-    break;
+  qint64 minKey = result.PQgetvalue( 0, 0 ).toLongLong();
+  qint64 maxKey = result.PQgetvalue( 0, 1 ).toLongLong();
 
-    case pktUnknown:
-      Q_ASSERT( !"FAILURE: cannot get feature with unknown primary key" );
-      return false;
+  // equal key ranges, the first and last one are open so that no feature can be missed.
+  // The range is computed unsigned, as bigint keys can span more than INT64_MAX.
+  quint64 range = ( quint64 ) maxKey - ( quint64 ) minKey;
+  quint64 step = range / count + 1;
+  QString lower;
+  for ( int i = 1; i < count; i++ )
+  {
+    // step * i > range, without overflowing
+    if ( step > range / i )
+      break;
+
+    QString upper = QString::number(( qint64 )(( quint64 ) minKey + step * i ) );
+    clauses << ( lower.isNull()
+                 ? QString( "%1<%2" ).arg( pk, upper )
+                 : QString( "%1>=%2 AND %1<%3" ).arg( pk, lower, upper ) );
+    lower = upper;
   }
 
-  feature.setFeatureId( fid );
-  QgsDebugMsgLevel( QString( "fid=%1" ).arg( fid ), 4 );
+  clauses << ( lower.isNull() ? QString() : QString( "%1>=%2" ).arg( pk, lower ) );
+  return clauses;
+}
 
-  // iterate attributes
-  if ( subsetOfAttributes )
+bool QgsPostgresParallelFeatureIterator::fetchFeature( QgsFeature& feature )
+{
+  feature.setValid( false );
+
+  if ( mClosed )
+    return false;
+
+  if ( mFeatureQueueRow >= mFeatureQueue.size() )
   {
-    Q_FOREACH ( int idx, fetchAttributes )
-      getFeatureAttribute( idx, queryResult, row, col, feature );
+    fetchBlock( mFeatureQueue, sBlockSize );
+    mFeatureQueueRow = 0;
   }
-  else
+
+  if ( mFeatureQueue.isEmpty() )
   {
-    for ( int idx = 0; idx < mSource->mFields.count(); ++idx )
-      getFeatureAttribute( idx, queryResult, row, col, feature );
+    close();
+    return false;
   }
 
+  mFeatureQueue.feature( mFeatureQueueRow++, feature );
   return true;
 }
 
-void QgsPostgresFeatureIterator::getFeatureAttribute( int idx, QgsPostgresResult& queryResult, int row, int& col, QgsFeature& feature )
+int QgsPostgresParallelFeatureIterator::fetchFeatures( QgsFeatureBatch& batch, int maxCount )
 {
-  if ( mSource->mPrimaryKeyAttrs.contains( idx ) )
-    return;
+  if ( mClosed )
+    return 0;
 
-  QVariant v = QgsPostgresProvider::convertValue( mSource->mFields.at( idx ).type(), queryResult.PQgetvalue( row, col ) );
-  feature.setAttribute( idx, v );
+  // features already fetched into the queue go first
+  if ( mFeatureQueueRow < mFeatureQueue.size() )
+    return QgsAbstractFeatureIterator::fetchFeatures( batch, qMin( maxCount, mFeatureQueue.size() - mFeatureQueueRow ) );
 
-  col++;
+  fetchBlock( batch, maxCount );
+
+  if ( batch.isEmpty() )
+  {
+    close();
+    return 0;
+  }
+
+  return batch.size();
+}
+
+void QgsPostgresParallelFeatureIterator::fetchBlock( QgsFeatureBatch& batch, int count )
+{
+  batch.clear();
+
+  while ( !mPartitions.isEmpty() )
+  {
+    mCurrentPartition %= mPartitions.size();
+    if ( mPartitions[mCurrentPartition].nextFeatures( batch, count ) > 0 )
+    {
+      mCurrentPartition++;
+      return;
+    }
+
+    // the partition is exhausted and has released its connection
+    mPartitions.removeAt( mCurrentPartition );
+  }
+}
+
+bool QgsPostgresParallelFeatureIterator::nextFeatureFilterExpression( QgsFeature& f )
+{
+  return fetchFeature( f );
+}
+
+bool QgsPostgresParallelFeatureIterator::nextFeatureFilterFids( QgsFeature& f )
+{
+  return fetchFeature( f );
+}
+
+bool QgsPostgresParallelFeatureIterator::prepareSimplification( const QgsSimplifyMethod& simplifyMethod )
+{
+  Q_UNUSED( simplifyMethod );
+  return false;
+}
+
+bool QgsPostgresParallelFeatureIterator::rewind()
+{
+  if ( mClosed )
+    return false;
+
+  closePartitions();
+  mFeatureQueue.clear();
+  mFeatureQueueRow = 0;
+
+  return openPartitions();
+}
+
+bool QgsPostgresParallelFeatureIterator::close()
+{
+  if ( mClosed )
+    return false;
+
+  closePartitions();
+  mFeatureQueue.clear();
+  mFeatureQueueRow = 0;
+
+  iteratorClosed();
+
+  mClosed = true;
+  return true;
 }
 
 
@@ -617,5 +1065,8 @@ QgsPostgresFeatureSource::~QgsPostgresFeatureSource()
 
 QgsFeatureIterator QgsPostgresFeatureSource::getFeatures( const QgsFeatureRequest& request )
 {
+  if ( QgsPostgresParallelFeatureIterator::canSplit( this, request ) )
+    return QgsFeatureIterator( new QgsPostgresParallelFeatureIterator( this, false, request ) );
+
   return QgsFeatureIterator( new QgsPostgresFeatureIterator( this, false, request ) );
 }
@@ -16,11 +16,13 @@
 #define QGSPOSTGRESFEATUREITERATOR_H
 
 #include "qgsfeatureiterator.h"
-
-#include <QQueue>
+#include "qgsfeaturebatch.h"
 
 #include "qgspostgresprovider.h"
 
+#include <QByteArray>
+#include <QTime>
+
 class QgsPostgresProvider;
 class QgsPostgresResult;
 class QgsPostgresTransaction;
@@ -62,6 +64,7 @@ class QgsPostgresFeatureSource : public QgsAbstractFeatureSource
     QgsPostgresConn* mTransactionConnection;
 
     friend class QgsPostgresFeatureIterator;
+    friend class QgsPostgresParallelFeatureIterator;
     friend class QgsPostgresExpressionCompiler;
 };
 
@@ -71,7 +74,15 @@ class QgsPostgresConn;
 class QgsPostgresFeatureIterator : public QgsAbstractFeatureIteratorFromSource<QgsPostgresFeatureSource>
 {
   public:
-    QgsPostgresFeatureIterator( QgsPostgresFeatureSource* source, bool ownSource, const QgsFeatureRequest &request );
+    /** Creates an iterator over the features of the source matching the request.
+     * @param source feature source
+     * @param ownSource whether the iterator deletes the source when it is closed
+     * @param request feature request
+     * @param conn pooled connection to use instead of acquiring one, released to the pool when the iterator closes
+     * @param partitionClause additional where clause restricting the iterator to a part of the features
+     */
+    QgsPostgresFeatureIterator( QgsPostgresFeatureSource* source, bool ownSource, const QgsFeatureRequest &request,
+                                QgsPostgresConn* conn = 0, const QString& partitionClause = QString() );
 
     ~QgsPostgresFeatureIterator();
 
@@ -85,19 +96,37 @@ class QgsPostgresFeatureIterator : public QgsAbstractFeatureIteratorFromSource<Q
     //! fetch next feature, return true on success
     virtual bool fetchFeature( QgsFeature& feature ) override;
 
+    //! fetch features straight from the cursor into the batch
+    virtual int fetchFeatures( QgsFeatureBatch& batch, int maxCount ) override;
+    virtual bool providesBatches() const override { return true; }
+
     //! fetch next feature filter expression
     bool nextFeatureFilterExpression( QgsFeature& f ) override;
 
     //! Setup the simplification of geometries to fetch using the specified simplify method
     virtual bool prepareSimplification( const QgsSimplifyMethod& simplifyMethod ) override;
 
+    //! The features are ordered by the server if all the expressions could be compiled
+    virtual bool prepareOrderBy( const QList<QgsFeatureRequest::OrderByClause>& orderBys ) override;
+
+    //! The server stops at the limit if it filters and orders the features itself
+    virtual bool providesLimit() const override { return mLimitCompiled; }
+
     QgsPostgresConn* mConn;
 
 
     QString whereClauseRect();
-    bool getFeature( QgsPostgresResult &queryResult, int row, QgsFeature &feature );
-    void getFeatureAttribute( int idx, QgsPostgresResult& queryResult, int row, int& col, QgsFeature& feature );
-    bool declareCursor( const QString& whereClause );
+    //! decodes the next count features from the cursor into the (cleared) batch
+    void fetchBlock( QgsFeatureBatch& batch, int count );
+    //! sends the next FETCH without waiting for its result
+    void sendFetch();
+    //! waits for the result of the pending FETCH and prefetches the next block. Returns false if there are no more rows.
+    bool receiveFetch();
+    //! drops the pending FETCH and the rows not decoded yet
+    void discardFetch();
+    bool getFeature( QgsPostgresResult &queryResult, int row, QgsFeatureBatch &batch );
+    void getFeatureAttribute( int idx, QgsPostgresResult& queryResult, int row, int& col, QgsFeatureBatch& batch, int batchRow );
+    bool declareCursor( const QString& whereClause, const QString& orderBy = QString(), long limit = -1 );
 
     QString mCursorName;
 
@@ -105,7 +134,10 @@ class QgsPostgresFeatureIterator : public QgsAbstractFeatureIteratorFromSource<Q
      * Feature queue that GetNextFeature will retrieve from
      * before the next fetch from PostgreSQL
      */
-    QQueue<QgsFeature> mFeatureQueue;
+    QgsFeatureBatch mFeatureQueue;
+
+    //! Next row of the feature queue to retrieve
+    int mFeatureQueueRow;
 
     //! Maximal size of the feature queue
     int mFeatureQueueSize;
@@ -113,18 +145,129 @@ class QgsPostgresFeatureIterator : public QgsAbstractFeatureIteratorFromSource<Q
     //! Number of retrieved features
     int mFetched;
 
+    /**
+     * Result of the last FETCH. Its rows are decoded when they are consumed,
+     * while the next FETCH is already on its way.
+     */
+    QgsPostgresResult mFetchResult;
+
+    //! Next row of the fetch result to decode
+    int mFetchResultRow;
+
+    //! Number of rows of the fetch result
+    int mFetchResultRows;
+
+    //! Set if a FETCH was sent and its result was not received yet
+    bool mFetchPending;
+
+    //! Set once a FETCH returned less rows than requested
+    bool mCursorExhausted;
+
+    //! Number of rows requested per FETCH, grows if the consumer has to wait for the rows
+    int mFetchSize;
+
+    //! Time since the pending FETCH was sent
+    QTime mFetchTime;
+
     //! Set to true, if geometry is in the requested columns
     bool mFetchGeometry;
 
+    //! Set to true, if the geometry is fetched as TWKB
+    bool mFetchTwkb;
+
+    //! Set to false, if geometries simplified for rendering must not be fetched as TWKB
+    bool mUseTwkb;
+
+    //! WKB of the last decoded TWKB geometry, reused for all features
+    QByteArray mTwkbBuffer;
+
+    //! Set to true, if numbers, dates and booleans are fetched in binary representation
+    bool mBinaryAttributes;
+
     bool mIsTransactionConnection;
 
     static const int sFeatureQueueSize;
+    static const int sMaxFetchSize;
+    static const int sMaxFetchBytes;
 
   private:
     //! returns whether the iterator supports simplify geometries on provider side
     virtual bool providerCanSimplify( QgsSimplifyMethod::MethodType methodType ) const override;
 
     bool mExpressionCompiled;
+    bool mOrderByCompiled;
+    bool mLimitCompiled;
+};
+
+
+/**
+ * Iterator that splits a scan into primary key ranges, each read by a
+ * QgsPostgresFeatureIterator on its own pooled connection.
+ *
+ * The partitions are consumed round robin a block at a time. As every
+ * partition prefetches its next block, all backends keep reading while
+ * the features of one of them are decoded. Features come in no particular
+ * order.
+ */
+class QgsPostgresParallelFeatureIterator : public QgsAbstractFeatureIteratorFromSource<QgsPostgresFeatureSource>
+{
+  public:
+    QgsPostgresParallelFeatureIterator( QgsPostgresFeatureSource* source, bool ownSource, const QgsFeatureRequest &request );
+
+    ~QgsPostgresParallelFeatureIterator();
+
+    //! reset the iterator to the starting position
+    virtual bool rewind() override;
+
+    //! end of iterating: free the resources / lock
+    virtual bool close() override;
+
+    //! returns whether a request on the source can be split into several scans
+    static bool canSplit( const QgsPostgresFeatureSource* source, const QgsFeatureRequest &request );
+
+  protected:
+    //! fetch next feature, return true on success
+    virtual bool fetchFeature( QgsFeature& feature ) override;
+
+    //! fetch the next block of a partition into the batch
+    virtual int fetchFeatures( QgsFeatureBatch& batch, int maxCount ) override;
+    virtual bool providesBatches() const override { return true; }
+
+    //! the partitions filter the features themselves
+    virtual bool nextFeatureFilterExpression( QgsFeature& f ) override;
+
+    //! the partitions filter the features themselves
+    virtual bool nextFeatureFilterFids( QgsFeature& f ) override;
+
+    //! the partitions simplify the geometries themselves
+    virtual bool prepareSimplification( const QgsSimplifyMethod& simplifyMethod ) override;
+
+  private:
+    //! acquires the connections and starts an iterator for each partition
+    bool openPartitions();
+
+    //! closes the iterators of all partitions
+    void closePartitions();
+
+    //! returns where clauses splitting the primary key range into at most count parts
+    QStringList partitionClauses( QgsPostgresConn* conn, int count );
+
+    //! fills the (cleared) batch with up to count features of the next partition that has some left
+    void fetchBlock( QgsFeatureBatch& batch, int count );
+
+    //! iterators of the partitions that have features left
+    QList<QgsFeatureIterator> mPartitions;
+
+    //! partition to take the next block from
+    int mCurrentPartition;
+
+    //! features of the last block, for fetchFeature()
+    QgsFeatureBatch mFeatureQueue;
+
+    //! Next row of the feature queue to retrieve
+    int mFeatureQueueRow;
+
+    static const int sBlockSize;
 };
 
 #endif // QGSPOSTGRESFEATUREITERATOR_H
@@ -24,7 +24,13 @@
 #include <qgsrectangle.h>
 #include <qgscoordinatereferencesystem.h>
 
+#include <QDate>
 #include <QMessageBox>
+#include <QSettings>
+#include <QTime>
+#include <QtEndian>
+
+#include <limits>
 
 #include "qgsvectorlayerimport.h"
 #include "qgsprovidercountcalcevent.h"
@@ -34,6 +40,7 @@
 #include "qgspostgresconnpool.h"
 #include "qgspgsourceselect.h"
 #include "qgspostgresdataitems.h"
+#include "qgspostgresexpressioncompiler.h"
 #include "qgspostgresfeatureiterator.h"
 #include "qgspostgrestransaction.h"
 #include "qgslogger.h"
@@ -41,6 +48,8 @@
 const QString POSTGRES_KEY = "postgres";
 const QString POSTGRES_DESCRIPTION = "PostgreSQL/PostGIS data provider";
 
+const int QgsPostgresProvider::sCopyMinFeatures = 50;
+
 
 QgsPostgresProvider::QgsPostgresProvider( QString const & uri )
     : QgsVectorDataProvider( uri )
@@ -54,6 +63,7 @@ QgsPostgresProvider::QgsPostgresProvider( QString const & uri )
     , mUseEstimatedMetadata( false )
     , mSelectAtIdDisabled( false )
     , mEnabledCapabilities( 0 )
+    , mCopySupported( -1 )
     , mConnectionRO( 0 )
     , mConnectionRW( 0 )
     , mTransaction( 0 )
@@ -374,7 +384,7 @@ QgsFeatureIterator QgsPostgresProvider::getFeatures( const QgsFeatureRequest& re
   }
 
   QgsPostgresFeatureSource* featureSrc = static_cast<QgsPostgresFeatureSource*>( featureSource() );
-  return QgsFeatureIterator( new QgsPostgresFeatureIterator( featureSrc, false, request ) );
+  return featureSrc->getFeatures( request );
 }
 
 
@@ -1053,6 +1063,10 @@ bool QgsPostgresProvider::hasSufficientPermsAndCapabilities()
       if ( testAccess.PQresultStatus() == PGRES_TUPLES_OK && testAccess.PQntuples() == 1 )
       {
         mEnabledCapabilities |= QgsVectorDataProvider::AddAttributes | QgsVectorDataProvider::DeleteAttributes;
+
+        // owners may create indexes
+        if ( !mGeometryColumn.isNull() )
+          mEnabledCapabilities |= QgsVectorDataProvider::CreateSpatialIndex;
       }
     }
   }
@@ -1410,6 +1424,176 @@ void QgsPostgresProvider::uniqueValues( int index, QList<QVariant> &uniqueValues
   }
 }
 
+bool QgsPostgresProvider::aggregate( const QList<QgsAggregateCalculator::Aggregate>& aggregates, const QString& expression, const QString& groupByExpression,
+                                     const QgsAggregateCalculator::AggregateParameters& parameters, QgsAggregateCalculator::GroupResults& results )
+{
+  bool compile = QgsSqlExpressionCompiler::compilationEnabled();
+  QgsPostgresFeatureSource source( this );
+
+  // plain fields are always used, other expressions only if they compile completely
+  int fieldIndex = mAttributeFields.indexFromName( expression );
+  QString valueSql;
+  if ( fieldIndex != -1 )
+  {
+    // e.g. the range of dates would be a number of days in SQL, but fails locally
+    QVariant::Type type = mAttributeFields.at( fieldIndex ).type();
+    bool numericField = type == QVariant::Int || type == QVariant::LongLong || type == QVariant::Double;
+    Q_FOREACH ( QgsAggregateCalculator::Aggregate aggregate, aggregates )
+    {
+      if ( !numericField && QgsAggregateCalculator::isNumeric( aggregate ) )
+        return false;
+    }
+    valueSql = quotedIdentifier( expression );
+  }
+  else
+  {
+    QgsExpression exp( expression );
+    QgsPostgresExpressionCompiler compiler( &source );
+    if ( !compile || exp.hasParserError() || compiler.compile( &exp ) != QgsSqlExpressionCompiler::Complete )
+      return false;
+    valueSql = compiler.result();
+  }
+
+  // the values of other group expressions would come back as strings
+  int groupIndex = -1;
+  if ( !groupByExpression.isEmpty() )
+  {
+    groupIndex = mAttributeFields.indexFromName( groupByExpression );
+    if ( groupIndex == -1 )
+      return false;
+  }
+
+  QString whereClause = mSqlWhereClause;
+  if ( !parameters.filter.isEmpty() )
+  {
+    QgsExpression filter( parameters.filter );
+    QgsPostgresExpressionCompiler compiler( &source );
+    if ( !compile || filter.hasParserError() || compiler.compile( &filter ) != QgsSqlExpressionCompiler::Complete )
+      return false;
+    whereClause = whereClause.isEmpty() ? compiler.result() : QString( "(%1) AND (%2)" ).arg( whereClause, compiler.result() );
+  }
+
+  bool percentiles = connectionRO()->pgVersion() >= 90400;
+  QStringList columns;
+  Q_FOREACH ( QgsAggregateCalculator::Aggregate aggregate, aggregates )
+  {
+    QString column;
+    switch ( aggregate )
+    {
+      case QgsAggregateCalculator::Count:
+        column = QString( "count(%1)" ).arg( valueSql );
+        break;
+      case QgsAggregateCalculator::CountDistinct:
+        column = QString( "count(DISTINCT %1)" ).arg( valueSql );
+        break;
+      case QgsAggregateCalculator::CountMissing:
+        column = QString( "count(*)-count(%1)" ).arg( valueSql );
+        break;
+      case QgsAggregateCalculator::Min:
+      case QgsAggregateCalculator::Max:
+        // the value has to be converted to the type of the field
+        if ( fieldIndex == -1 )
+          return false;
+        column = QString( "%1(%2)" ).arg( aggregate == QgsAggregateCalculator::Min ? "min" : "max", valueSql );
+        break;
+      case QgsAggregateCalculator::Sum:
+        column = QString( "sum(%1)" ).arg( valueSql );
+        break;
+      case QgsAggregateCalculator::Mean:
+        column = QString( "avg(%1)" ).arg( valueSql );
+        break;
+      case QgsAggregateCalculator::StDev:
+        column = QString( "stddev_pop(%1)" ).arg( valueSql );
+        break;
+      case QgsAggregateCalculator::StDevSample:
+        column = QString( "stddev_samp(%1)" ).arg( valueSql );
+        break;
+      case QgsAggregateCalculator::Range:
+        column = QString( "max(%1)-min(%1)" ).arg( valueSql );
+        break;
+      case QgsAggregateCalculator::Median:
+      case QgsAggregateCalculator::FirstQuartile:
+      case QgsAggregateCalculator::ThirdQuartile:
+      case QgsAggregateCalculator::Percentile:
+      {
+        if ( !percentiles )
+          return false;
+        double fraction = aggregate == QgsAggregateCalculator::Median ? 0.5
+                          : aggregate == QgsAggregateCalculator::FirstQuartile ? 0.25
+                          : aggregate == QgsAggregateCalculator::ThirdQuartile ? 0.75
+                          : qBound( 0.0, parameters.percentile, 1.0 );
+        column = QString( "percentile_cont(%1) WITHIN GROUP (ORDER BY %2)" ).arg( qgsDoubleToString( fraction ), valueSql );
+        break;
+      }
+      case QgsAggregateCalculator::InterQuartileRange:
+        if ( !percentiles )
+          return false;
+        column = QString( "percentile_cont(0.75) WITHIN GROUP (ORDER BY %1)-percentile_cont(0.25) WITHIN GROUP (ORDER BY %1)" ).arg( valueSql );
+        break;
+      case QgsAggregateCalculator::StringConcatenate:
+        column = QString( "string_agg((%1)::text,%2)" ).arg( valueSql, quotedValue( parameters.delimiter ) );
+        break;
+    }
+    columns << column;
+  }
+
+  QString groupSql = groupIndex == -1 ? QString() : quotedIdentifier( groupByExpression );
+  if ( !groupSql.isEmpty() )
+    columns << groupSql;
+
+  QString sql = QString( "SELECT %1 FROM %2" ).arg( columns.join( "," ), mQuery );
+  if ( !whereClause.isEmpty() )
+    sql += QString( " WHERE %1" ).arg( whereClause );
+  if ( !groupSql.isEmpty() )
+    sql += QString( " GROUP BY %1" ).arg( groupSql );
+
+  QgsPostgresResult res( connectionRO()->PQexec( sql ) );
+  if ( res.PQresultStatus() != PGRES_TUPLES_OK )
+  {
+    QgsDebugMsg( QString( "Aggregate query failed: %1" ).arg( sql ) );
+    return false;
+  }
+
+  for ( int row = 0; row < res.PQntuples(); ++row )
+  {
+    QgsAggregateCalculator::GroupResult result;
+    for ( int i = 0; i < aggregates.size(); ++i )
+    {
+      QgsAggregateCalculator::Aggregate aggregate = aggregates.at( i );
+      bool isNull = res.PQgetisnull( row, i );
+      QString value = res.PQgetvalue( row, i );
+      switch ( aggregate )
+      {
+        case QgsAggregateCalculator::Count:
+        case QgsAggregateCalculator::CountDistinct:
+        case QgsAggregateCalculator::CountMissing:
+          result.values << QVariant( value.toLongLong() );
+          break;
+        case QgsAggregateCalculator::Min:
+        case QgsAggregateCalculator::Max:
+          result.values << ( isNull ? QVariant( mAttributeFields.at( fieldIndex ).type() ) : convertValue( mAttributeFields.at( fieldIndex ).type(), value ) );
+          break;
+        case QgsAggregateCalculator::StringConcatenate:
+          result.values << ( isNull ? QVariant( QVariant::String ) : QVariant( value ) );
+          break;
+        default:
+          result.values << ( isNull ? QVariant( QVariant::Double ) : QVariant( value.toDouble() ) );
+          break;
+      }
+    }
+
+    if ( groupIndex != -1 )
+    {
+      const QgsField& fld = mAttributeFields.at( groupIndex );
+      int col = aggregates.size();
+      result.group = res.PQgetisnull( row, col ) ? QVariant( fld.type() ) : convertValue( fld.type(), res.PQgetvalue( row, col ) );
+    }
+    results << result;
+  }
+
+  return true;
+}
+
 void QgsPostgresProvider::enumValues( int index, QStringList& enumList )
 {
   enumList.clear();
@@ -1699,6 +1883,13 @@ bool QgsPostgresProvider::addFeatures( QgsFeatureList &flist )
   }
   conn->lock();
 
+  if ( flist.size() >= sCopyMinFeatures && canCopyFeatures() )
+  {
+    bool returnvalue = copyFeatures( conn, flist );
+    conn->unlock();
+    return returnvalue;
+  }
+
   bool returnvalue = true;
 
   try
@@ -1886,44 +2077,491 @@ bool QgsPostgresProvider::addFeatures( QgsFeatureList &flist )
     }
 
     // update feature ids
-    if ( mPrimaryKeyType == pktInt || mPrimaryKeyType == pktFidMap )
+    setFeatureIdsFromPrimaryKey( flist );
+
+    conn->PQexecNR( "DEALLOCATE addfeatures" );
+    conn->commit();
+
+    mShared->addFeaturesCounted( flist.size() );
+  }
+  catch ( PGException &e )
+  {
+    pushError( tr( "PostGIS error while adding features: %1" ).arg( e.errorMessage() ) );
+    conn->rollback();
+    conn->PQexecNR( "DEALLOCATE addfeatures" );
+    returnvalue = false;
+  }
+
+  conn->unlock();
+  return returnvalue;
+}
+
+void QgsPostgresProvider::setFeatureIdsFromPrimaryKey( QgsFeatureList &flist )
+{
+  if ( mPrimaryKeyType != pktInt && mPrimaryKeyType != pktFidMap )
+    return;
+
+  for ( QgsFeatureList::iterator features = flist.begin(); features != flist.end(); ++features )
+  {
+    QgsAttributes attrs = features->attributes();
+
+    if ( mPrimaryKeyType == pktInt )
     {
-      for ( QgsFeatureList::iterator features = flist.begin(); features != flist.end(); ++features )
+      features->setFeatureId( STRING_TO_FID( attrs.at( mPrimaryKeyAttrs.at( 0 ) ) ) );
+    }
+    else
+    {
+      QList<QVariant> primaryKeyVals;
+
+      Q_FOREACH ( int idx, mPrimaryKeyAttrs )
       {
-        QgsAttributes attrs = features->attributes();
+        primaryKeyVals << attrs.at( idx );
+      }
+
+      features->setFeatureId( mShared->lookupFid( QVariant( primaryKeyVals ) ) );
+    }
+    QgsDebugMsgLevel( QString( "new fid=%1" ).arg( features->id() ), 4 );
+  }
+}
+
+bool QgsPostgresProvider::canCopyFeatures()
+{
+  // the ids of copied rows can only be determined from their primary key values
+  if ( mPrimaryKeyType != pktInt && mPrimaryKeyType != pktFidMap )
+    return false;
+
+  // COPY cannot apply the conversions topology and geography columns need
+  if ( !mGeometryColumn.isNull() && mSpatialColType != sctGeometry )
+    return false;
+
+  if ( mCopySupported < 0 )
+  {
+    // views only accept INSERT
+    QgsPostgresResult res( connectionRO()->PQexec( QString( "SELECT relkind FROM pg_class WHERE oid=regclass(%1)::oid" ).arg( quotedValue( mQuery ) ) ) );
+    mCopySupported = res.PQresultStatus() == PGRES_TUPLES_OK && res.PQntuples() == 1 && res.PQgetvalue( 0, 0 ) == "r" ? 1 : 0;
+  }
 
-        if ( mPrimaryKeyType == pktInt )
+  return mCopySupported == 1;
+}
+
+void QgsPostgresProvider::fillDefaultValues( QgsPostgresConn *conn, QgsFeatureList &flist, const QList<int> &fieldIds )
+{
+  // Instead of one "SELECT default" per feature and attribute like paramValue(),
+  // evaluate the default once for every feature that needs it, e.g. to get a
+  // block of values of a sequence.
+  Q_FOREACH ( int idx, fieldIds )
+  {
+    QString defVal = defaultValue( idx ).toString();
+    if ( defVal.isNull() )
+      continue;
+
+    QList<int> rows;
+    for ( int i = 0; i < flist.size(); i++ )
+    {
+      const QgsAttributes &attrs = flist.at( i ).attributes();
+      if ( idx >= attrs.size() || attrs.at( idx ).isNull() || attrs.at( idx ).toString() == defVal )
+        rows << i;
+    }
+
+    if ( rows.isEmpty() )
+      continue;
+
+    QgsPostgresResult result( conn->PQexec( QString( "SELECT %1 FROM generate_series(1,%2)" ).arg( defVal ).arg( rows.size() ) ) );
+    if ( result.PQresultStatus() != PGRES_TUPLES_OK )
+      throw PGException( result );
+
+    const QgsField &fld = field( idx );
+    for ( int i = 0; i < rows.size(); i++ )
+    {
+      QgsFeature &f = flist[ rows.at( i ) ];
+      if ( f.attributes().size() <= idx )
+      {
+        QgsAttributes attrs = f.attributes();
+        attrs.resize( mAttributeFields.count() );
+        f.setAttributes( attrs );
+      }
+      f.setAttribute( idx, convertValue( fld.type(), result.PQgetvalue( i, 0 ) ) );
+    }
+  }
+}
+
+// types that are written in binary COPY format, all others force the text format
+static bool isCopyBinaryType( const QString &typeName )
+{
+  return typeName == "int2" || typeName == "int4" || typeName == "int8" ||
+         typeName == "float4" || typeName == "float8" || typeName == "bool" ||
+         typeName == "text" || typeName == "varchar" || typeName == "bpchar" ||
+         typeName == "date";
+}
+
+static void appendCopyInt16( QByteArray &buf, qint16 value )
+{
+  uchar data[2];
+  qToBigEndian( value, data );
+  buf.append( reinterpret_cast<const char *>( data ), sizeof( data ) );
+}
+
+static void appendCopyInt32( QByteArray &buf, qint32 value )
+{
+  uchar data[4];
+  qToBigEndian( value, data );
+  buf.append( reinterpret_cast<const char *>( data ), sizeof( data ) );
+}
+
+static void appendCopyInt64( QByteArray &buf, qint64 value )
+{
+  uchar data[8];
+  qToBigEndian( value, data );
+  buf.append( reinterpret_cast<const char *>( data ), sizeof( data ) );
+}
+
+// converts the WKB of a geometry into EWKB with the given srid
+static QByteArray geometryEwkb( const QgsGeometry *geom, int srid, bool forceMulti )
+{
+  QScopedPointer<QgsGeometry> multi;
+  if ( forceMulti && !QGis::isMultiType( geom->wkbType() ) )
+  {
+    multi.reset( new QgsGeometry( *geom ) );
+    multi->convertToMultiType();
+    geom = multi.data();
+  }
+
+  const unsigned char *wkb = geom->asWkb();
+  int size = geom->wkbSize();
+  if ( !wkb || size < 5 )
+    return QByteArray();
+
+  if ( srid <= 0 )
+    return QByteArray( reinterpret_cast<const char *>( wkb ), size );
+
+  // the type gets the srid flag (0x20000000) and is followed by the srid
+  bool littleEndian = wkb[0] == 1;
+  quint32 type = littleEndian ? qFromLittleEndian<quint32>( wkb + 1 ) : qFromBigEndian<quint32>( wkb + 1 );
+  type |= 0x20000000;
+
+  QByteArray ewkb( size + 4, 0 );
+  uchar *out = reinterpret_cast<uchar *>( ewkb.data() );
+  out[0] = wkb[0];
+  if ( littleEndian )
+  {
+    qToLittleEndian( type, out + 1 );
+    qToLittleEndian( ( quint32 ) srid, out + 5 );
+  }
+  else
+  {
+    qToBigEndian( type, out + 1 );
+    qToBigEndian( ( quint32 ) srid, out + 5 );
+  }
+  memcpy( out + 9, wkb + 5, size - 5 );
+  return ewkb;
+}
+
+// appends a value in binary COPY format, returns false if it cannot be converted to the column type
+static bool appendCopyBinaryValue( QByteArray &buf, const QString &typeName, const QVariant &value )
+{
+  if ( value.isNull() )
+  {
+    appendCopyInt32( buf, -1 );
+    return true;
+  }
+
+  bool ok = true;
+  if ( typeName == "int2" )
+  {
+    int v = value.toInt( &ok );
+    // smallint values out of range would be truncated silently
+    ok = ok && v >= std::numeric_limits<qint16>::min() && v <= std::numeric_limits<qint16>::max();
+    appendCopyInt32( buf, 2 );
+    appendCopyInt16( buf, v );
+  }
+  else if ( typeName == "int4" )
+  {
+    int v = value.toInt( &ok );
+    appendCopyInt32( buf, 4 );
+    appendCopyInt32( buf, v );
+  }
+  else if ( typeName == "int8" )
+  {
+    qlonglong v = value.toLongLong( &ok );
+    appendCopyInt32( buf, 8 );
+    appendCopyInt64( buf, v );
+  }
+  else if ( typeName == "float4" )
+  {
+    float v = value.toDouble( &ok );
+    quint32 bits;
+    memcpy( &bits, &v, sizeof( bits ) );
+    appendCopyInt32( buf, 4 );
+    appendCopyInt32( buf, bits );
+  }
+  else if ( typeName == "float8" )
+  {
+    double v = value.toDouble( &ok );
+    quint64 bits;
+    memcpy( &bits, &v, sizeof( bits ) );
+    appendCopyInt32( buf, 8 );
+    appendCopyInt64( buf, bits );
+  }
+  else if ( typeName == "bool" )
+  {
+    QString v = value.toString().trimmed().toLower();
+    ok = v == "t" || v == "true" || v == "1" || v == "y" || v == "yes" || v == "on" ||
+         v == "f" || v == "false" || v == "0" || v == "n" || v == "no" || v == "off";
+    appendCopyInt32( buf, 1 );
+    buf.append( v == "t" || v == "true" || v == "1" || v == "y" || v == "yes" || v == "on" ? '\1' : '\0' );
+  }
+  else if ( typeName == "date" )
+  {
+    QDate v = value.toDate();
+    ok = v.isValid();
+    appendCopyInt32( buf, 4 );
+    appendCopyInt32( buf, QDate( 2000, 1, 1 ).daysTo( v ) );
+  }
+  else
+  {
+    QByteArray v = value.toString().toUtf8();
+    appendCopyInt32( buf, v.size() );
+    buf.append( v );
+  }
+
+  return ok;
+}
+
+// appends a value in text COPY format
+static void appendCopyTextValue( QByteArray &buf, const QVariant &value )
+{
+  if ( value.isNull() )
+  {
+    buf.append( "\\N" );
+    return;
+  }
+
+  QByteArray v = value.toString().toUtf8();
+  for ( int i = 0; i < v.size(); i++ )
+  {
+    char c = v.at( i );
+    switch ( c )
+    {
+      case '\\':
+        buf.append( "\\\\" );
+        break;
+      case '\t':
+        buf.append( "\\t" );
+        break;
+      case '\n':
+        buf.append( "\\n" );
+        break;
+      case '\r':
+        buf.append( "\\r" );
+        break;
+      default:
+        buf.append( c );
+    }
+  }
+}
+
+bool QgsPostgresProvider::copyFeatures( QgsPostgresConn *conn, QgsFeatureList &flist )
+{
+  QTime time;
+  time.start();
+
+  bool copying = false;
+  bool returnvalue = true;
+
+  try
+  {
+    conn->begin();
+
+    QStringList columns;
+    QList<int> fieldIds;
+    bool binary = true;
+
+    if ( !mGeometryColumn.isNull() )
+      columns << quotedIdentifier( mGeometryColumn );
+
+    for ( int idx = 0; idx < mAttributeFields.count(); ++idx )
+    {
+      const QgsField &fld = mAttributeFields.at( idx );
+      if ( fld.name() == mGeometryColumn )
+        continue;
+
+      columns << quotedIdentifier( fld.name() );
+      fieldIds << idx;
+      binary = binary && isCopyBinaryType( fld.typeName() );
+    }
+
+    fillDefaultValues( conn, flist, fieldIds );
+
+    int srid = ( mRequestedSrid.isEmpty() ? mDetectedSrid : mRequestedSrid ).toInt();
+    bool forceMulti = QGis::isMultiType( geometryType() );
+
+    QString copy = QString( "COPY %1(%2) FROM STDIN%3" )
+                   .arg( mQuery, columns.join( "," ), binary ? " WITH BINARY" : "" );
+    QgsPostgresResult result( conn->PQexec( copy, false ) );
+    if ( result.PQresultStatus() != PGRES_COPY_IN )
+      throw PGException( result );
+    copying = true;
+
+    QByteArray buf;
+    if ( binary )
+    {
+      // signature, flags and header extension length
+      buf.append( "PGCOPY\n\377\r\n\0", 11 );
+      appendCopyInt32( buf, 0 );
+      appendCopyInt32( buf, 0 );
+    }
+
+    for ( QgsFeatureList::const_iterator features = flist.constBegin(); features != flist.constEnd(); ++features )
+    {
+      const QgsAttributes &attrs = features->attributes();
+
+      QByteArray geom;
+      if ( !mGeometryColumn.isNull() && features->constGeometry() )
+        geom = geometryEwkb( features->constGeometry(), srid, forceMulti );
+
+      if ( binary )
+      {
+        appendCopyInt16( buf, columns.size() );
+
+        if ( !mGeometryColumn.isNull() )
         {
-          features->setFeatureId( STRING_TO_FID( attrs.at( mPrimaryKeyAttrs.at( 0 ) ) ) );
+          appendCopyInt32( buf, geom.isNull() ? -1 : geom.size() );
+          buf.append( geom );
         }
-        else
-        {
-          QList<QVariant> primaryKeyVals;
 
-          Q_FOREACH ( int idx, mPrimaryKeyAttrs )
-          {
-            primaryKeyVals << attrs.at( idx );
-          }
+        Q_FOREACH ( int idx, fieldIds )
+        {
+          const QgsField &fld = mAttributeFields.at( idx );
+          QVariant value = idx < attrs.size() ? attrs.at( idx ) : QVariant();
+          if ( !appendCopyBinaryValue( buf, fld.typeName(), value ) )
+            throw PGException( tr( "invalid value %1 for field %2 of type %3" ).arg( value.toString(), fld.name(), fld.typeName() ) );
+        }
+      }
+      else
+      {
+        QString delim;
+        if ( !mGeometryColumn.isNull() )
+        {
+          // geometry input accepts hex encoded EWKB
+          if ( geom.isNull() )
+            buf.append( "\\N" );
+          else
+            buf.append( geom.toHex() );
+          delim = "\t";
+        }
 
-          features->setFeatureId( mShared->lookupFid( QVariant( primaryKeyVals ) ) );
+        Q_FOREACH ( int idx, fieldIds )
+        {
+          buf.append( delim );
+          appendCopyTextValue( buf, idx < attrs.size() ? attrs.at( idx ) : QVariant() );
+          delim = "\t";
         }
-        QgsDebugMsgLevel( QString( "new fid=%1" ).arg( features->id() ), 4 );
+        buf.append( '\n' );
+      }
+
+      // stream the data instead of building all rows in memory
+      if ( buf.size() > 1024 * 1024 )
+      {
+        if ( conn->PQputCopyData( buf ) != 1 )
+          throw PGException( conn->PQerrorMessage() );
+        buf.clear();
       }
     }
 
-    conn->PQexecNR( "DEALLOCATE addfeatures" );
+    if ( binary )
+      appendCopyInt16( buf, -1 );
+
+    if ( conn->PQputCopyData( buf ) != 1 || conn->PQputCopyEnd() != 1 )
+      throw PGException( conn->PQerrorMessage() );
+    copying = false;
+
+    for ( ;; )
+    {
+      result = conn->PQgetResult();
+      if ( !result.result() )
+        break;
+
+      if ( result.PQresultStatus() != PGRES_COMMAND_OK )
+        throw PGException( result );
+    }
+
+    setFeatureIdsFromPrimaryKey( flist );
+
     conn->commit();
 
     mShared->addFeaturesCounted( flist.size() );
+
+    QgsDebugMsg( QString( "%1 features copied in %2 ms (%3 format)" )
+                 .arg( flist.size() ).arg( time.elapsed() ).arg( binary ? "binary" : "text" ) );
   }
   catch ( PGException &e )
   {
     pushError( tr( "PostGIS error while adding features: %1" ).arg( e.errorMessage() ) );
+
+    if ( copying )
+    {
+      conn->PQputCopyEnd( "failed" );
+    }
+
+    // consume the results of an aborted COPY
+    QgsPostgresResult result;
+    do
+    {
+      result = conn->PQgetResult();
+    }
+    while ( result.result() );
+
     conn->rollback();
-    conn->PQexecNR( "DEALLOCATE addfeatures" );
     returnvalue = false;
   }
 
+  return returnvalue;
+}
+
+bool QgsPostgresProvider::createSpatialIndex()
+{
+  if ( mIsQuery || mGeometryColumn.isNull() || ( mSpatialColType != sctGeometry && mSpatialColType != sctGeography ) )
+    return false;
+
+  QgsPostgresConn* conn = connectionRW();
+  if ( !conn )
+  {
+    return false;
+  }
+  conn->lock();
+
+  bool returnvalue = true;
+
+  QString sql = QString( "SELECT 1 FROM pg_index i"
+                         " JOIN pg_class c ON c.oid=i.indexrelid"
+                         " JOIN pg_am am ON am.oid=c.relam"
+                         " JOIN pg_attribute a ON a.attrelid=i.indrelid AND a.attnum=ANY(i.indkey)"
+                         " WHERE i.indrelid=regclass(%1)::oid AND a.attname=%2 AND am.amname='gist'" )
+                .arg( quotedValue( mQuery ), quotedValue( mGeometryColumn ) );
+  QgsPostgresResult result( conn->PQexec( sql ) );
+  if ( result.PQresultStatus() != PGRES_TUPLES_OK )
+  {
+    pushError( tr( "PostGIS error while creating spatial index: %1" ).arg( result.PQresultErrorMessage() ) );
+    returnvalue = false;
+  }
+  else if ( result.PQntuples() == 0 )
+  {
+    // same name as the spatial index DB Manager creates
+    sql = QString( "CREATE INDEX %1 ON %2 USING GIST(%3)" )
+          .arg( quotedIdentifier( QString( "sidx_%1_%2" ).arg( mTableName, mGeometryColumn ) ),
+                mQuery,
+                quotedIdentifier( mGeometryColumn ) );
+    if ( !conn->PQexecNR( sql ) )
+    {
+      pushError( tr( "PostGIS error while creating spatial index: %1" ).arg( conn->PQerrorMessage() ) );
+      returnvalue = false;
+    }
+  }
+
+  // update the planner statistics, e.g. after a bulk load
+  if ( returnvalue )
+    conn->PQexecNR( QString( "ANALYZE %1" ).arg( mQuery ) );
+
   conn->unlock();
   return returnvalue;
 }
@@ -165,6 +165,12 @@ class QgsPostgresProvider : public QgsVectorDataProvider
      *  @param values reference to the list of unique values */
     virtual void uniqueValues( int index, QList<QVariant> &uniqueValues, int limit = -1 ) override;
 
+    /** Calculates the aggregates in a single query. Expressions other than plain fields
+     * are only used if expression compilation is enabled and they compile completely.
+     */
+    virtual bool aggregate( const QList<QgsAggregateCalculator::Aggregate>& aggregates, const QString& expression, const QString& groupByExpression,
+                            const QgsAggregateCalculator::AggregateParameters& parameters, QgsAggregateCalculator::GroupResults& results ) override;
+
     /** Returns the possible enum values of an attribute. Returns an empty stringlist if a provider does not support enum types
       or if the given attribute is not an enum type.
      * @param index the index of the attribute
@@ -221,6 +227,11 @@ class QgsPostgresProvider : public QgsVectorDataProvider
      */
     bool changeGeometryValues( QgsGeometryMap & geometry_map ) override;
 
+    /** Creates a GiST index on the geometry column, unless there already is one,
+     * and analyzes the table
+     */
+    bool createSpatialIndex() override;
+
     //! Get the postgres connection
     PGconn * pgConnection();
 
@@ -440,6 +451,10 @@ class QgsPostgresProvider : public QgsVectorDataProvider
           : mWhat( r.PQresultErrorMessage() )
       {}
 
+      explicit PGException( const QString &what )
+          : mWhat( what )
+      {}
+
       PGException( const PGException &e )
           : mWhat( e.errorMessage() )
       {}
@@ -467,6 +482,24 @@ class QgsPostgresProvider : public QgsVectorDataProvider
 
     QString paramValue( QString fieldvalue, const QString &defaultValue ) const;
 
+    //! Returns true if features can be added with COPY instead of INSERT
+    bool canCopyFeatures();
+
+    //! Adds features with COPY, in one transaction
+    bool copyFeatures( QgsPostgresConn *conn, QgsFeatureList &flist );
+
+    //! Evaluates the defaults of null attributes of added features
+    void fillDefaultValues( QgsPostgresConn *conn, QgsFeatureList &flist, const QList<int> &fieldIds );
+
+    //! Sets the ids of added features from their primary key attributes
+    void setFeatureIdsFromPrimaryKey( QgsFeatureList &flist );
+
+    //! Whether the relation accepts COPY (-1: not determined yet)
+    int mCopySupported;
+
+    //! Minimum number of features added with COPY
+    static const int sCopyMinFeatures;
+
     QgsPostgresConn *mConnectionRO; //! read-only database connection (initially)
     QgsPostgresConn *mConnectionRW; //! read-write database connection (on update)
 
@@ -0,0 +1,308 @@
+/***************************************************************************
+    qgsspatialiteblobreader.cpp
+    ---------------------
+    begin                : October 2015
+    copyright            : (C) 2015 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include "qgsspatialiteblobreader.h"
+
+#include <QtEndian>
+
+#include <cstring>
+
+namespace
+{
+  // markers of the SpatiaLite BLOB format
+  const unsigned char BlobStart = 0x00;
+  const unsigned char BlobMbrEnd = 0x7C;
+  const unsigned char BlobEntity = 0x69;
+  const unsigned char BlobEnd = 0xFE;
+
+  // start of the geometry class, after the SRID and the MBR
+  const int BlobHeaderSize = 39;
+
+  // simple feature types, SpatiaLite adds 1000 for Z, 2000 for M and 3000 for ZM
+  enum
+  {
+    BlobPoint = 1,
+    BlobLineString,
+    BlobPolygon,
+    BlobMultiPoint,
+    BlobMultiLineString,
+    BlobMultiPolygon,
+    BlobGeometryCollection
+  };
+
+  // added to the type of linestrings and polygons with compressed vertices
+  const int BlobCompressed = 1000000;
+
+  // flag of 2.5D types in GEOS WKB
+  const quint32 Wkb25DFlag = 0x80000000;
+
+  class BlobDecoder
+  {
+    public:
+      BlobDecoder( const unsigned char* blob, int size, QByteArray& buffer )
+          : mP( blob )
+          , mEnd( blob + size )
+          , mBuffer( buffer )
+          , mPos( 0 )
+          , mOk( true )
+          , mLittleEndian( true )
+      {
+      }
+
+      int decode()
+      {
+        if ( mEnd - mP < BlobHeaderSize + 5 || mP[0] != BlobStart || mP[BlobHeaderSize - 1] != BlobMbrEnd || mEnd[-1] != BlobEnd )
+          return -1;
+        if ( mP[1] != 0x00 && mP[1] != 0x01 )
+          return -1;
+
+        mLittleEndian = mP[1] == 0x01;
+        mP += BlobHeaderSize;
+        mEnd--;
+
+        readGeometry( readInt() );
+        return mOk && mP == mEnd ? mPos : -1;
+      }
+
+    private:
+      const unsigned char* mP;
+      const unsigned char* mEnd;
+      QByteArray& mBuffer;
+      int mPos;
+      bool mOk;
+      bool mLittleEndian;
+
+      bool need( int bytes )
+      {
+        if ( !mOk || mEnd - mP < bytes )
+        {
+          mOk = false;
+          return false;
+        }
+        return true;
+      }
+
+      quint32 readInt()
+      {
+        if ( !need( 4 ) )
+          return 0;
+        quint32 value = mLittleEndian ? qFromLittleEndian<quint32>( mP ) : qFromBigEndian<quint32>( mP );
+        mP += 4;
+        return value;
+      }
+
+      double readDouble()
+      {
+        if ( !need( 8 ) )
+          return 0.0;
+        quint64 bits = mLittleEndian ? qFromLittleEndian<quint64>( mP ) : qFromBigEndian<quint64>( mP );
+        mP += 8;
+        double value;
+        memcpy( &value, &bits, sizeof( value ) );
+        return value;
+      }
+
+      float readFloat()
+      {
+        if ( !need( 4 ) )
+          return 0.0f;
+        quint32 bits = mLittleEndian ? qFromLittleEndian<quint32>( mP ) : qFromBigEndian<quint32>( mP );
+        mP += 4;
+        float value;
+        memcpy( &value, &bits, sizeof( value ) );
+        return value;
+      }
+
+      //! Reads a count and checks that the remaining data can hold at least minBytes per element
+      quint32 readCount( int minBytes )
+      {
+        quint32 count = readInt();
+        if ( ( quint64 ) count * minBytes > ( quint64 )( mEnd - mP ) )
+        {
+          mOk = false;
+          return 0;
+        }
+        return count;
+      }
+
+      void write( const void* data, int size )
+      {
+        if ( mPos + size > mBuffer.size() )
+          mBuffer.resize( qMax( mPos + size, 2 * mBuffer.size() ) );
+        memcpy( mBuffer.data() + mPos, data, size );
+        mPos += size;
+      }
+
+      void writeUInt( quint32 value )
+      {
+        unsigned char data[4];
+        qToLittleEndian( value, data );
+        write( data, sizeof( data ) );
+      }
+
+      void writeDouble( double value )
+      {
+        quint64 bits;
+        memcpy( &bits, &value, sizeof( bits ) );
+        unsigned char data[8];
+        qToLittleEndian( bits, data );
+        write( data, sizeof( data ) );
+      }
+
+      void writeHeader( int type, bool is3D )
+      {
+        char byteOrder = 1;
+        write( &byteOrder, 1 );
+        writeUInt( is3D ? type | Wkb25DFlag : type );
+      }
+
+      //! Copies a vertex, hasZ and hasM describe the input, Z is written if either is set
+      void readVertex( bool hasZ, bool hasM, double* last = 0 )
+      {
+        double x = readDouble();
+        double y = readDouble();
+        double z = hasZ ? readDouble() : 0.0;
+        if ( hasM )
+          readDouble();
+
+        writeDouble( x );
+        writeDouble( y );
+        if ( hasZ || hasM )
+          writeDouble( z );
+
+        if ( last )
+        {
+          last[0] = x;
+          last[1] = y;
+          last[2] = z;
+        }
+      }
+
+      void readPoints( bool hasZ, bool hasM, bool compressed )
+      {
+        int vertexBytes = ( 2 + ( hasZ ? 1 : 0 ) + ( hasM ? 1 : 0 ) ) * 8;
+        // intermediate vertices of compressed lines are float offsets to the previous vertex,
+        // M values are not compressed
+        int compressedBytes = ( 2 + ( hasZ ? 1 : 0 ) ) * 4 + ( hasM ? 8 : 0 );
+
+        quint32 nPoints = readCount( compressed ? compressedBytes : vertexBytes );
+        writeUInt( nPoints );
+        if ( !compressed )
+        {
+          for ( quint32 i = 0; i < nPoints && mOk; ++i )
+            readVertex( hasZ, hasM );
+          return;
+        }
+
+        double last[3] = { 0.0, 0.0, 0.0 };
+        for ( quint32 i = 0; i < nPoints && mOk; ++i )
+        {
+          if ( i == 0 || i == nPoints - 1 )
+          {
+            readVertex( hasZ, hasM, last );
+            continue;
+          }
+
+          last[0] += readFloat();
+          last[1] += readFloat();
+          if ( hasZ )
+            last[2] += readFloat();
+          if ( hasM )
+            readDouble();
+
+          writeDouble( last[0] );
+          writeDouble( last[1] );
+          if ( hasZ || hasM )
+            writeDouble( last[2] );
+        }
+      }
+
+      void readGeometry( quint32 blobType )
+      {
+        if ( !mOk )
+          return;
+
+        bool compressed = blobType >= ( quint32 ) BlobCompressed;
+        if ( compressed )
+          blobType -= BlobCompressed;
+
+        int type = blobType % 1000;
+        int dims = blobType / 1000;
+        bool hasZ = dims == 1 || dims == 3;
+        bool hasM = dims == 2 || dims == 3;
+        bool is3D = dims != 0;
+
+        if ( type < BlobPoint || type > BlobGeometryCollection || dims > 3 )
+        {
+          mOk = false;
+          return;
+        }
+        if ( compressed && type != BlobLineString && type != BlobPolygon )
+        {
+          mOk = false;
+          return;
+        }
+
+        writeHeader( type, is3D );
+
+        switch ( type )
+        {
+          case BlobPoint:
+            readVertex( hasZ, hasM );
+            break;
+
+          case BlobLineString:
+            readPoints( hasZ, hasM, compressed );
+            break;
+
+          case BlobPolygon:
+          {
+            quint32 nRings = readCount( 4 );
+            writeUInt( nRings );
+            for ( quint32 i = 0; i < nRings && mOk; ++i )
+              readPoints( hasZ, hasM, compressed );
+            break;
+          }
+
+          case BlobMultiPoint:
+          case BlobMultiLineString:
+          case BlobMultiPolygon:
+          case BlobGeometryCollection:
+          {
+            // each part has an entity marker and its own type
+            quint32 nParts = readCount( 5 );
+            writeUInt( nParts );
+            for ( quint32 i = 0; i < nParts && mOk; ++i )
+            {
+              if ( !need( 1 ) || *mP++ != BlobEntity )
+              {
+                mOk = false;
+                return;
+              }
+              readGeometry( readInt() );
+            }
+            break;
+          }
+        }
+      }
+  };
+}
+
+int QgsSpatiaLiteBlobReader::toWkb( const unsigned char* blob, int size, QByteArray& buffer )
+{
+  if ( !blob || size <= 0 )
+    return -1;
+
+  BlobDecoder decoder( blob, size, buffer );
+  return decoder.decode();
+}
@@ -0,0 +1,43 @@
+/***************************************************************************
+    qgsspatialiteblobreader.h
+    ---------------------
+    begin                : October 2015
+    copyright            : (C) 2015 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#ifndef QGSSPATIALITEBLOBREADER_H
+#define QGSSPATIALITEBLOBREADER_H
+
+#include <QByteArray>
+
+/**
+ * Decodes geometries stored in the internal BLOB format of SpatiaLite.
+ *
+ * The WKB written is the same as returned by AsBinary() after conversion by
+ * QgsSpatiaLiteProvider::convertToGeosWKB(): 2D geometries keep their type,
+ * geometries with Z are written as 2.5D and M values are dropped (a geometry
+ * with M but no Z gets Z values of 0). Compressed linestrings and polygons are
+ * expanded.
+ */
+class QgsSpatiaLiteBlobReader
+{
+  public:
+    /**
+     * Converts a SpatiaLite geometry BLOB to little endian WKB.
+     * The WKB is written to the start of buffer, which is grown if it is too small
+     * but never shrunk, so that it can be reused for the next geometry.
+     * @param blob SpatiaLite geometry
+     * @param size size of the geometry
+     * @param buffer receives the WKB
+     * @returns size of the WKB or -1 if the BLOB is malformed or of an unsupported format
+     */
+    static int toWkb( const unsigned char* blob, int size, QByteArray& buffer );
+};
+
+#endif // QGSSPATIALITEBLOBREADER_H
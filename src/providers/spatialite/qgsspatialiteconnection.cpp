@@ -702,6 +702,7 @@ error:
 
 
 QMap < QString, QgsSqliteHandle * > QgsSqliteHandle::handles;
+const int QgsSqliteHandle::sMaxCachedStatements = 32;
 
 
 bool QgsSqliteHandle::checkMetadata( sqlite3 *handle )
@@ -814,6 +815,13 @@ void QgsSqliteHandle::closeAll()
 
 void QgsSqliteHandle::sqliteClose()
 {
+  Q_FOREACH ( sqlite3_stmt *stmt, mStatements )
+  {
+    sqlite3_finalize( stmt );
+  }
+  mStatements.clear();
+  mStatementOrder.clear();
+
   if ( sqlite_handle )
   {
     QgsSLConnect::sqlite3_close( sqlite_handle );
@@ -821,3 +829,43 @@ void QgsSqliteHandle::sqliteClose()
   }
 }
 
+sqlite3_stmt *QgsSqliteHandle::prepareStatement( const QString &sql )
+{
+  sqlite3_stmt *stmt = mStatements.take( sql );
+  if ( stmt )
+  {
+    mStatementOrder.removeOne( sql );
+    return stmt;
+  }
+
+  if ( sqlite3_prepare_v2( sqlite_handle, sql.toUtf8().constData(), -1, &stmt, NULL ) != SQLITE_OK )
+  {
+    sqlite3_finalize( stmt );
+    return NULL;
+  }
+  return stmt;
+}
+
+void QgsSqliteHandle::releaseStatement( sqlite3_stmt *stmt )
+{
+  if ( !stmt )
+    return;
+
+  QString sql = QString::fromUtf8( sqlite3_sql( stmt ) );
+  if ( mStatements.contains( sql ) )
+  {
+    // the same SQL was prepared twice, keep only one statement
+    sqlite3_finalize( stmt );
+    return;
+  }
+
+  sqlite3_reset( stmt );
+  sqlite3_clear_bindings( stmt );
+  mStatements.insert( sql, stmt );
+  mStatementOrder.append( sql );
+
+  while ( mStatementOrder.size() > sMaxCachedStatements )
+  {
+    sqlite3_finalize( mStatements.take( mStatementOrder.takeFirst() ) );
+  }
+}
@@ -15,6 +15,7 @@
 #ifndef QGSSPATIALITECONNECTION_H
 #define QGSSPATIALITECONNECTION_H
 
+#include <QHash>
 #include <QStringList>
 #include <QObject>
 
@@ -150,6 +151,20 @@ class QgsSqliteHandle
     //
     void sqliteClose();
 
+    /**
+     * Returns a prepared statement for the SQL, or NULL if it cannot be prepared.
+     * A statement given back with releaseStatement() for the same SQL is reused,
+     * so that repeated requests with bound parameters are not compiled again.
+     * The statement must be released or finalized by the caller.
+     */
+    sqlite3_stmt *prepareStatement( const QString &sql );
+
+    /**
+     * Resets a statement from prepareStatement() and keeps it for reuse. Only the
+     * most recently released statements are kept, older ones are finalized.
+     */
+    void releaseStatement( sqlite3_stmt *stmt );
+
     static QgsSqliteHandle *openDb( const QString & dbPath, bool shared = true );
     static bool checkMetadata( sqlite3 * handle );
     static void closeDb( QgsSqliteHandle * &handle );
@@ -166,6 +181,12 @@ class QgsSqliteHandle
     sqlite3 *sqlite_handle;
     QString mDbPath;
 
+    //! released statements by SQL, and their SQL from the least recently released
+    QHash<QString, sqlite3_stmt *> mStatements;
+    QStringList mStatementOrder;
+
+    static const int sMaxCachedStatements;
+
     static QMap < QString, QgsSqliteHandle * > handles;
 };
 
@@ -0,0 +1,115 @@
+/***************************************************************************
+    qgsspatialiteexpressioncompiler.cpp
+    ---------------------
+    begin                : October 2015
+    copyright            : (C) 2015 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#include "qgsspatialiteexpressioncompiler.h"
+
+#include "qgsspatialiteprovider.h"
+
+QgsSpatiaLiteExpressionCompiler::QgsSpatiaLiteExpressionCompiler( QgsSpatiaLiteFeatureSource* source )
+    : QgsSqlExpressionCompiler( source->mFields, QgsSqlExpressionCompiler::LikeIsCaseInsensitive )
+    , mSource( source )
+{
+}
+
+QString QgsSpatiaLiteExpressionCompiler::quotedIdentifier( const QString& identifier )
+{
+  return QgsSpatiaLiteProvider::quotedIdentifier( identifier );
+}
+
+QgsSqlExpressionCompiler::Result QgsSpatiaLiteExpressionCompiler::compileNode( const QgsExpression::Node* node, QString& result )
+{
+  if ( node->nodeType() != QgsExpression::ntFunction )
+    return QgsSqlExpressionCompiler::compileNode( node, result );
+
+  const QgsExpression::NodeFunction* n = static_cast<const QgsExpression::NodeFunction*>( node );
+  QString name = QgsExpression::Functions()[n->fnIndex()]->name();
+
+  if ( name == "$id" )
+  {
+    // the feature id is the ROWID or the primary key of a query, without key the rows are numbered
+    if ( mSource->mPrimaryKey.isEmpty() )
+      return Fail;
+
+    result = !mSource->isQuery ? "ROWID" : quotedIdentifier( mSource->mPrimaryKey );
+    return Complete;
+  }
+
+  QString function;
+  if ( name == "intersects" )
+    function = "Intersects";
+  else if ( name == "contains" )
+    function = "Contains";
+  else if ( name == "within" )
+    function = "Within";
+  else if ( name == "disjoint" )
+    function = "Disjoint";
+  else if ( name == "touches" )
+    function = "Touches";
+  else if ( name == "crosses" )
+    function = "Crosses";
+  else if ( name == "overlaps" )
+    function = "Overlaps";
+  else if ( name == "intersects_bbox" )
+    function = "MbrIntersects";
+  else
+    return Fail;
+
+  if ( !n->args() || n->args()->count() != 2 )
+    return Fail;
+
+  QString first, second;
+  if ( compileGeometry( n->args()->list().at( 0 ), first ) != Complete ||
+       compileGeometry( n->args()->list().at( 1 ), second ) != Complete )
+    return Fail;
+
+  // the predicates return -1 for invalid arguments, which SQLite would take as true
+  result = QString( "(%1(%2, %3) = 1)" ).arg( function, first, second );
+  return Complete;
+}
+
+QgsSqlExpressionCompiler::Result QgsSpatiaLiteExpressionCompiler::compileGeometry( const QgsExpression::Node* node, QString& result )
+{
+  if ( node->nodeType() != QgsExpression::ntFunction )
+    return Fail;
+
+  const QgsExpression::NodeFunction* n = static_cast<const QgsExpression::NodeFunction*>( node );
+  QString name = QgsExpression::Functions()[n->fnIndex()]->name();
+
+  if ( name == "$geometry" )
+  {
+    if ( mSource->mGeometryColumn.isNull() )
+      return Fail;
+
+    result = quotedIdentifier( mSource->mGeometryColumn );
+    return Complete;
+  }
+
+  if ( name == "geom_from_wkt" && n->args() && n->args()->count() == 1 )
+  {
+    const QgsExpression::Node* arg = n->args()->list().at( 0 );
+    if ( arg->nodeType() != QgsExpression::ntLiteral )
+      return Fail;
+
+    QVariant wkt = static_cast<const QgsExpression::NodeLiteral*>( arg )->value();
+    if ( wkt.type() != QVariant::String )
+      return Fail;
+
+    // the geometry is in the layer CRS, predicates between geometries of different SRIDs fail
+    bool ok;
+    result = QString( "GeomFromText(%1, %2)" ).arg( quotedValue( wkt, ok ) ).arg( mSource->mSrid );
+    return ok ? Complete : Fail;
+  }
+
+  return Fail;
+}
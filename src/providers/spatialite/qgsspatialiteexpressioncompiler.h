@@ -0,0 +1,48 @@
+/***************************************************************************
+    qgsspatialiteexpressioncompiler.h
+    ---------------------
+    begin                : October 2015
+    copyright            : (C) 2015 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+
+#ifndef QGSSPATIALITEEXPRESSIONCOMPILER_H
+#define QGSSPATIALITEEXPRESSIONCOMPILER_H
+
+#include "qgssqlexpressioncompiler.h"
+#include "qgsexpression.h"
+#include "qgsspatialitefeatureiterator.h"
+
+/**
+ * Translates filter expressions to SQLite WHERE clauses.
+ *
+ * Besides the operators, the spatial predicates between the feature geometry
+ * and constant geometries from geom_from_wkt() are translated to the
+ * corresponding SpatiaLite functions.
+ */
+class QgsSpatiaLiteExpressionCompiler : public QgsSqlExpressionCompiler
+{
+  public:
+
+    explicit QgsSpatiaLiteExpressionCompiler( QgsSpatiaLiteFeatureSource* source );
+
+  protected:
+
+    virtual QString quotedIdentifier( const QString& identifier ) override;
+    virtual Result compileNode( const QgsExpression::Node* node, QString& str ) override;
+
+  private:
+
+    //! compiles an argument of a spatial predicate, which must be $geometry or a geometry from WKT
+    Result compileGeometry( const QgsExpression::Node* node, QString& str );
+
+    QgsSpatiaLiteFeatureSource* mSource;
+};
+
+#endif // QGSSPATIALITEEXPRESSIONCOMPILER_H
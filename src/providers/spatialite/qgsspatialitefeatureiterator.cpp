@@ -14,18 +14,34 @@
  ***************************************************************************/
 #include "qgsspatialitefeatureiterator.h"
 
+#include "qgsspatialiteblobreader.h"
 #include "qgsspatialiteconnection.h"
 #include "qgsspatialiteconnpool.h"
+#include "qgsspatialiteexpressioncompiler.h"
 #include "qgsspatialiteprovider.h"
 
+#include "qgsfeaturebatch.h"
 #include "qgslogger.h"
 #include "qgsmessagelog.h"
 
+#include <QSettings>
+#include <QtAlgorithms>
+
+#include <cstdlib>
+
+// largest number of feature ids bound to a single statement for FilterFids requests
+static const int FID_BATCH_SIZE = 64;
 
 
 QgsSpatiaLiteFeatureIterator::QgsSpatiaLiteFeatureIterator( QgsSpatiaLiteFeatureSource* source, bool ownSource, const QgsFeatureRequest& request )
     : QgsAbstractFeatureIteratorFromSource<QgsSpatiaLiteFeatureSource>( source, ownSource, request )
     , sqliteStatement( NULL )
+    , mFidParam( 0 )
+    , mFidBatchSize( 0 )
+    , mNextFid( 0 )
+    , mExpressionCompiled( false )
+    , mOrderByCompiled( false )
+    , mLimitCompiled( false )
 {
 
   mHandle = QgsSpatiaLiteConnPool::instance()->acquireConnection( mSource->mSqlitePath );
@@ -49,6 +65,24 @@ QgsSpatiaLiteFeatureIterator::QgsSpatiaLiteFeatureIterator( QgsSpatiaLiteFeature
   {
     whereClause += whereClauseFids();
   }
+  else if ( request.filterType() == QgsFeatureRequest::FilterExpression
+            && QgsSqlExpressionCompiler::compilationEnabled() )
+  {
+    QgsSpatiaLiteExpressionCompiler compiler = QgsSpatiaLiteExpressionCompiler( source );
+
+    // a partially compiled expression still reduces the rows fetched,
+    // but has to be evaluated on each feature
+    QgsSqlExpressionCompiler::Result result = compiler.compile( request.filterExpression() );
+    if ( result == QgsSqlExpressionCompiler::Complete || result == QgsSqlExpressionCompiler::Partial )
+    {
+      if ( !whereClause.isEmpty() )
+      {
+        whereClause += " AND ";
+      }
+      whereClause += compiler.result();
+      mExpressionCompiled = result == QgsSqlExpressionCompiler::Complete;
+    }
+  }
 
   if ( !mSource->mSubsetString.isEmpty() )
   {
@@ -59,8 +93,40 @@ QgsSpatiaLiteFeatureIterator::QgsSpatiaLiteFeatureIterator( QgsSpatiaLiteFeature
     whereClause += "( " + mSource->mSubsetString + ")";
   }
 
+  // the ids of a FilterFids request are bound in batches, each of which would be ordered on its own
+  QStringList orderByParts;
+  if ( !request.orderBy().isEmpty() &&
+       request.filterType() != QgsFeatureRequest::FilterFids &&
+       QgsSqlExpressionCompiler::compilationEnabled() )
+  {
+    mOrderByCompiled = true;
+    Q_FOREACH ( const QgsFeatureRequest::OrderByClause& clause, request.orderBy() )
+    {
+      QgsSpatiaLiteExpressionCompiler compiler = QgsSpatiaLiteExpressionCompiler( source );
+      QgsExpression expression( clause.expression() );
+      if ( compiler.compile( &expression ) != QgsSqlExpressionCompiler::Complete )
+      {
+        mOrderByCompiled = false;
+        break;
+      }
+
+      // SQLite sorts NULL as the smallest value and has no NULLS FIRST / LAST
+      orderByParts << QString( "(%1) IS NULL %2" ).arg( compiler.result(), clause.nullsFirst() ? "DESC" : "ASC" )
+      << QString( "%1 %2" ).arg( compiler.result(), clause.ascending() ? "ASC" : "DESC" );
+    }
+  }
+
+  // SQLite can only stop at the limit if it returns exactly the features to return
+  long limit = -1;
+  if ( request.limit() >= 0 &&
+       request.filterType() != QgsFeatureRequest::FilterFids &&
+       ( request.filterType() != QgsFeatureRequest::FilterExpression || mExpressionCompiled ) &&
+       ( request.orderBy().isEmpty() || mOrderByCompiled ) )
+    limit = request.limit();
+  mLimitCompiled = limit >= 0;
+
   // preparing the SQL statement
-  if ( !prepareStatement( whereClause ) )
+  if ( !prepareStatement( whereClause, mOrderByCompiled ? orderByParts.join( "," ) : QString(), limit ) )
   {
     // some error occurred
     sqliteStatement = NULL;
@@ -91,8 +157,6 @@ bool QgsSpatiaLiteFeatureIterator::fetchFeature( QgsFeature& feature )
 
   if ( !getFeature( sqliteStatement, feature ) )
   {
-    sqlite3_finalize( sqliteStatement );
-    sqliteStatement = NULL;
     close();
     return false;
   }
@@ -102,6 +166,42 @@ bool QgsSpatiaLiteFeatureIterator::fetchFeature( QgsFeature& feature )
 }
 
 
+bool QgsSpatiaLiteFeatureIterator::nextFeatureFilterExpression( QgsFeature& f )
+{
+  if ( !mExpressionCompiled )
+    return QgsAbstractFeatureIterator::nextFeatureFilterExpression( f );
+  else
+    return fetchFeature( f );
+}
+
+
+int QgsSpatiaLiteFeatureIterator::fetchFeatures( QgsFeatureBatch& batch, int maxCount )
+{
+  if ( mClosed )
+    return 0;
+
+  if ( sqliteStatement == NULL )
+  {
+    QgsDebugMsg( "Invalid current SQLite statement" );
+    close();
+    return 0;
+  }
+
+  batch.setFields( mSource->mFields );
+
+  while ( batch.size() < maxCount )
+  {
+    if ( !getFeature( sqliteStatement, batch ) )
+    {
+      close();
+      break;
+    }
+  }
+
+  return batch.size();
+}
+
+
 bool QgsSpatiaLiteFeatureIterator::rewind()
 {
   if ( mClosed )
@@ -110,7 +210,8 @@ bool QgsSpatiaLiteFeatureIterator::rewind()
   if ( sqlite3_reset( sqliteStatement ) == SQLITE_OK )
   {
     mRowNumber = 0;
-    return true;
+    mNextFid = 0;
+    return mFids.isEmpty() || bindNextFids();
   }
   else
   {
@@ -127,7 +228,8 @@ bool QgsSpatiaLiteFeatureIterator::close()
 
   if ( sqliteStatement )
   {
-    sqlite3_finalize( sqliteStatement );
+    // keep the statement for the next request with the same SQL
+    mHandle->releaseStatement( sqliteStatement );
     sqliteStatement = NULL;
   }
 
@@ -141,7 +243,14 @@ bool QgsSpatiaLiteFeatureIterator::close()
 ////
 
 
-bool QgsSpatiaLiteFeatureIterator::prepareStatement( QString whereClause )
+bool QgsSpatiaLiteFeatureIterator::prepareOrderBy( const QList<QgsFeatureRequest::OrderByClause>& orderBys )
+{
+  Q_UNUSED( orderBys )
+  return mOrderByCompiled;
+}
+
+
+bool QgsSpatiaLiteFeatureIterator::prepareStatement( QString whereClause, const QString& orderBy, long limit )
 {
   if ( !mHandle )
     return false;
@@ -172,7 +281,8 @@ bool QgsSpatiaLiteFeatureIterator::prepareStatement( QString whereClause )
 
     if ( mFetchGeometry )
     {
-      sql += QString( ", AsBinary(%1)" ).arg( QgsSpatiaLiteProvider::quotedIdentifier( mSource->mGeometryColumn ) );
+      // the BLOB is decoded by QgsSpatiaLiteBlobReader rather than with AsBinary()
+      sql += QString( ", %1" ).arg( QgsSpatiaLiteProvider::quotedIdentifier( mSource->mGeometryColumn ) );
       mGeomColIdx = colIdx;
     }
     sql += QString( " FROM %1" ).arg( mSource->mQuery );
@@ -180,12 +290,36 @@ bool QgsSpatiaLiteFeatureIterator::prepareStatement( QString whereClause )
     if ( !whereClause.isEmpty() )
       sql += QString( " WHERE %1" ).arg( whereClause );
 
-    if ( sqlite3_prepare_v2( mHandle->handle(), sql.toUtf8().constData(), -1, &sqliteStatement, NULL ) != SQLITE_OK )
+    if ( !orderBy.isEmpty() )
+      sql += QString( " ORDER BY %1" ).arg( orderBy );
+
+    if ( limit >= 0 )
+      sql += QString( " LIMIT %1" ).arg( limit );
+
+    // values are bound as parameters so that the statement can be reused for other filters
+    sqliteStatement = mHandle->prepareStatement( sql );
+    if ( !sqliteStatement )
     {
       // some error occurred
       QgsMessageLog::logMessage( QObject::tr( "SQLite error: %2\nSQL: %1" ).arg( sql, sqlite3_errmsg( mHandle->handle() ) ), QObject::tr( "SpatiaLite" ) );
       return false;
     }
+
+    for ( int i = 0; i < mBindValues.size(); ++i )
+    {
+      const QVariant& value = mBindValues.at( i );
+      if ( value.type() == QVariant::Double )
+        sqlite3_bind_double( sqliteStatement, i + 1, value.toDouble() );
+      else
+        sqlite3_bind_int64( sqliteStatement, i + 1, value.toLongLong() );
+    }
+
+    if ( !mFids.isEmpty() && !bindNextFids() )
+    {
+      sqlite3_finalize( sqliteStatement );
+      sqliteStatement = NULL;
+      return false;
+    }
   }
   catch ( QgsSpatiaLiteProvider::SLFieldNotFound )
   {
@@ -203,7 +337,8 @@ QString QgsSpatiaLiteFeatureIterator::quotedPrimaryKey()
 
 QString QgsSpatiaLiteFeatureIterator::whereClauseFid()
 {
-  return QString( "%1=%2" ).arg( quotedPrimaryKey() ).arg( mRequest.filterFid() );
+  mBindValues << QVariant( mRequest.filterFid() );
+  return QString( "%1=?" ).arg( quotedPrimaryKey() );
 }
 
 QString QgsSpatiaLiteFeatureIterator::whereClauseFids()
@@ -211,20 +346,46 @@ QString QgsSpatiaLiteFeatureIterator::whereClauseFids()
   if ( mRequest.filterFids().isEmpty() )
     return "";
 
+  // The ids are bound in batches to a statement with a fixed number of parameters,
+  // which is rounded up to a power of two so that few different statements are needed
+  mFids = mRequest.filterFids().toList();
+  qSort( mFids );
+  mFidBatchSize = 1;
+  while ( mFidBatchSize < mFids.size() && mFidBatchSize < FID_BATCH_SIZE )
+    mFidBatchSize *= 2;
+  mFidParam = mBindValues.size() + 1;
+
   QString expr = QString( "%1 IN (" ).arg( quotedPrimaryKey() ), delim;
-  Q_FOREACH ( const QgsFeatureId featureId, mRequest.filterFids() )
+  for ( int i = 0; i < mFidBatchSize; ++i )
   {
-    expr += delim + QString::number( featureId );
+    expr += delim + "?";
     delim = ",";
   }
   expr += ")";
   return expr;
 }
 
+bool QgsSpatiaLiteFeatureIterator::bindNextFids()
+{
+  if ( mNextFid >= mFids.size() )
+    return false;
+
+  // the last batch is padded by repeating its last id
+  for ( int i = 0; i < mFidBatchSize; ++i )
+  {
+    QgsFeatureId fid = mFids.at( qMin( mNextFid + i, mFids.size() - 1 ) );
+    if ( sqlite3_bind_int64( sqliteStatement, mFidParam + i, fid ) != SQLITE_OK )
+      return false;
+  }
+  mNextFid += mFidBatchSize;
+  return true;
+}
+
 QString QgsSpatiaLiteFeatureIterator::whereClauseRect()
 {
   QgsRectangle rect = mRequest.filterRect();
   QString whereClause;
+  int firstBindValue = mBindValues.size();
 
   if ( mRequest.flags() & QgsFeatureRequest::ExactIntersect )
   {
@@ -241,10 +402,9 @@ QString QgsSpatiaLiteFeatureIterator::whereClauseRect()
     if ( mSource->spatialIndexRTree )
     {
       // using the RTree spatial index
-      QString mbrFilter = QString( "xmin <= %1 AND " ).arg( qgsDoubleToString( rect.xMaximum() ) );
-      mbrFilter += QString( "xmax >= %1 AND " ).arg( qgsDoubleToString( rect.xMinimum() ) );
-      mbrFilter += QString( "ymin <= %1 AND " ).arg( qgsDoubleToString( rect.yMaximum() ) );
-      mbrFilter += QString( "ymax >= %1" ).arg( qgsDoubleToString( rect.yMinimum() ) );
+      QString mbrFilter = "xmin <= ? AND xmax >= ? AND ymin <= ? AND ymax >= ?";
+      mBindValues << QVariant( rect.xMaximum() ) << QVariant( rect.xMinimum() )
+      << QVariant( rect.yMaximum() ) << QVariant( rect.yMinimum() );
       QString idxName = QString( "idx_%1_%2" ).arg( mSource->mIndexTable, mSource->mIndexGeometry );
       whereClause += QString( "%1 IN (SELECT pkid FROM %2 WHERE %3)" )
                      .arg( quotedPrimaryKey(),
@@ -269,6 +429,8 @@ QString QgsSpatiaLiteFeatureIterator::whereClauseRect()
   else
   {
     whereClause = "1";
+    while ( mBindValues.size() > firstBindValue )
+      mBindValues.removeLast();
   }
   return whereClause;
 }
@@ -276,11 +438,9 @@ QString QgsSpatiaLiteFeatureIterator::whereClauseRect()
 
 QString QgsSpatiaLiteFeatureIterator::mbr( const QgsRectangle& rect )
 {
-  return QString( "%1, %2, %3, %4" )
-         .arg( qgsDoubleToString( rect.xMinimum() ),
-               qgsDoubleToString( rect.yMinimum() ),
-               qgsDoubleToString( rect.xMaximum() ),
-               qgsDoubleToString( rect.yMaximum() ) );
+  mBindValues << QVariant( rect.xMinimum() ) << QVariant( rect.yMinimum() )
+  << QVariant( rect.xMaximum() ) << QVariant( rect.yMaximum() );
+  return "?, ?, ?, ?";
 }
 
 
@@ -297,11 +457,17 @@ QString QgsSpatiaLiteFeatureIterator::fieldName( const QgsField& fld )
 }
 
 
-bool QgsSpatiaLiteFeatureIterator::getFeature( sqlite3_stmt *stmt, QgsFeature &feature )
+bool QgsSpatiaLiteFeatureIterator::nextRow( sqlite3_stmt *stmt )
 {
-  bool subsetAttributes = mRequest.flags() & QgsFeatureRequest::SubsetOfAttributes;
-
   int ret = sqlite3_step( stmt );
+  while ( ret == SQLITE_DONE && mNextFid < mFids.size() )
+  {
+    // continue with the next batch of feature ids
+    sqlite3_reset( stmt );
+    if ( !bindNextFids() )
+      return false;
+    ret = sqlite3_step( stmt );
+  }
   if ( ret == SQLITE_DONE )
   {
     // there are no more rows to fetch
@@ -313,6 +479,15 @@ bool QgsSpatiaLiteFeatureIterator::getFeature( sqlite3_stmt *stmt, QgsFeature &f
     QgsMessageLog::logMessage( QObject::tr( "SQLite error getting feature: %1" ).arg( QString::fromUtf8( sqlite3_errmsg( mHandle->handle() ) ) ), QObject::tr( "SpatiaLite" ) );
     return false;
   }
+  return true;
+}
+
+bool QgsSpatiaLiteFeatureIterator::getFeature( sqlite3_stmt *stmt, QgsFeature &feature )
+{
+  bool subsetAttributes = mRequest.flags() & QgsFeatureRequest::SubsetOfAttributes;
+
+  if ( !nextRow( stmt ) )
+    return false;
 
   // one valid row has been fetched from the result set
   if ( !mFetchGeometry )
@@ -369,6 +544,41 @@ bool QgsSpatiaLiteFeatureIterator::getFeature( sqlite3_stmt *stmt, QgsFeature &f
   return true;
 }
 
+bool QgsSpatiaLiteFeatureIterator::getFeature( sqlite3_stmt *stmt, QgsFeatureBatch &batch )
+{
+  bool subsetAttributes = mRequest.flags() & QgsFeatureRequest::SubsetOfAttributes;
+
+  if ( !nextRow( stmt ) )
+    return false;
+
+  // first column always contains the ROWID (or the primary key), otherwise autoincrement a row number
+  int row = batch.addFeature( mHasPrimaryKey ? QgsFeatureId( sqlite3_column_int64( stmt, 0 ) ) : QgsFeatureId( ++mRowNumber ) );
+
+  int n_columns = sqlite3_column_count( stmt );
+  for ( int ic = 1; ic < n_columns; ic++ )
+  {
+    if ( mFetchGeometry && ic == mGeomColIdx )
+    {
+      getFeatureGeometry( stmt, ic, batch, row );
+    }
+    else if ( subsetAttributes )
+    {
+      if ( ic <= mRequest.subsetOfAttributes().size() )
+      {
+        int attrIndex = mRequest.subsetOfAttributes()[ic-1];
+        batch.setAttribute( row, attrIndex, getFeatureAttribute( stmt, ic, mSource->mFields.at( attrIndex ).type() ) );
+      }
+    }
+    else
+    {
+      int attrIndex = ic - 1;
+      batch.setAttribute( row, attrIndex, getFeatureAttribute( stmt, ic, mSource->mFields.at( attrIndex ).type() ) );
+    }
+  }
+
+  return true;
+}
+
 QVariant QgsSpatiaLiteFeatureIterator::getFeatureAttribute( sqlite3_stmt* stmt, int ic, const QVariant::Type& type )
 {
   if ( sqlite3_column_type( stmt, ic ) == SQLITE_INTEGER )
@@ -402,20 +612,51 @@ QVariant QgsSpatiaLiteFeatureIterator::getFeatureAttribute( sqlite3_stmt* stmt,
   return QVariant( type );
 }
 
+int QgsSpatiaLiteFeatureIterator::geometryWkb( sqlite3_stmt* stmt, int ic )
+{
+  if ( sqlite3_column_type( stmt, ic ) != SQLITE_BLOB )
+    return -1; // NULL geometry
+
+  const unsigned char *blob = ( const unsigned char * ) sqlite3_column_blob( stmt, ic );
+  int blob_size = sqlite3_column_bytes( stmt, ic );
+  int size = QgsSpatiaLiteBlobReader::toWkb( blob, blob_size, mWkbBuffer );
+  if ( size >= 0 )
+    return size;
+
+  // formats not handled by the reader (e.g. TinyPoint) are converted by libspatialite
+  gaiaGeomCollPtr geom = gaiaFromSpatiaLiteBlobWkb( blob, blob_size );
+  if ( !geom )
+    return -1;
+
+  unsigned char *wkb = NULL;
+  int wkb_size = 0;
+  gaiaToWkb( geom, &wkb, &wkb_size );
+  gaiaFreeGeomColl( geom );
+  if ( !wkb )
+    return -1;
+
+  unsigned char *featureGeom = NULL;
+  size_t geom_size = 0;
+  QgsSpatiaLiteProvider::convertToGeosWKB( wkb, wkb_size, &featureGeom, &geom_size );
+  free( wkb );
+  if ( !featureGeom )
+    return -1;
+
+  if ( mWkbBuffer.size() < ( int ) geom_size )
+    mWkbBuffer.resize( geom_size );
+  memcpy( mWkbBuffer.data(), featureGeom, geom_size );
+  delete [] featureGeom;
+  return geom_size;
+}
+
 void QgsSpatiaLiteFeatureIterator::getFeatureGeometry( sqlite3_stmt* stmt, int ic, QgsFeature& feature )
 {
-  if ( sqlite3_column_type( stmt, ic ) == SQLITE_BLOB )
-  {
-    unsigned char *featureGeom = NULL;
-    size_t geom_size = 0;
-    const void *blob = sqlite3_column_blob( stmt, ic );
-    size_t blob_size = sqlite3_column_bytes( stmt, ic );
-    QgsSpatiaLiteProvider::convertToGeosWKB(( const unsigned char * )blob, blob_size,
-                                            &featureGeom, &geom_size );
-    if ( featureGeom )
-      feature.setGeometryAndOwnership( featureGeom, geom_size );
-    else
-      feature.setGeometryAndOwnership( 0, 0 );
+  int size = geometryWkb( stmt, ic );
+  if ( size > 0 )
+  {
+    unsigned char *featureGeom = new unsigned char[size];
+    memcpy( featureGeom, mWkbBuffer.constData(), size );
+    feature.setGeometryAndOwnership( featureGeom, size );
   }
   else
   {
@@ -424,6 +665,13 @@ void QgsSpatiaLiteFeatureIterator::getFeatureGeometry( sqlite3_stmt* stmt, int i
   }
 }
 
+void QgsSpatiaLiteFeatureIterator::getFeatureGeometry( sqlite3_stmt* stmt, int ic, QgsFeatureBatch& batch, int row )
+{
+  int size = geometryWkb( stmt, ic );
+  if ( size > 0 )
+    batch.setGeometryWkb( row, ( const unsigned char * ) mWkbBuffer.constData(), size );
+}
+
 
 QgsSpatiaLiteFeatureSource::QgsSpatiaLiteFeatureSource( const QgsSpatiaLiteProvider* p )
     : mGeometryColumn( p->mGeometryColumn )
@@ -438,6 +686,7 @@ QgsSpatiaLiteFeatureSource::QgsSpatiaLiteFeatureSource( const QgsSpatiaLiteProvi
     , spatialIndexRTree( p->spatialIndexRTree )
     , spatialIndexMbrCache( p->spatialIndexMbrCache )
     , mSqlitePath( p->mSqlitePath )
+    , mSrid( p->mSrid )
 {
 }
 
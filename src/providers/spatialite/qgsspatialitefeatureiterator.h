@@ -47,8 +47,10 @@ class QgsSpatiaLiteFeatureSource : public QgsAbstractFeatureSource
     bool spatialIndexRTree;
     bool spatialIndexMbrCache;
     QString mSqlitePath;
+    int mSrid;
 
     friend class QgsSpatiaLiteFeatureIterator;
+    friend class QgsSpatiaLiteExpressionCompiler;
 };
 
 class QgsSpatiaLiteFeatureIterator : public QgsAbstractFeatureIteratorFromSource<QgsSpatiaLiteFeatureSource>
@@ -69,16 +71,37 @@ class QgsSpatiaLiteFeatureIterator : public QgsAbstractFeatureIteratorFromSource
     //! fetch next feature, return true on success
     virtual bool fetchFeature( QgsFeature& feature ) override;
 
+    //! fetch rows straight into the batch
+    virtual int fetchFeatures( QgsFeatureBatch& batch, int maxCount ) override;
+    virtual bool providesBatches() const override { return true; }
+
+    //! skips the local evaluation if the filter expression was compiled completely
+    virtual bool nextFeatureFilterExpression( QgsFeature& f ) override;
+
+    //! the features are ordered by SQLite if all the expressions could be compiled
+    virtual bool prepareOrderBy( const QList<QgsFeatureRequest::OrderByClause>& orderBys ) override;
+
+    //! SQLite stops at the limit if it filters and orders the features itself
+    virtual bool providesLimit() const override { return mLimitCompiled; }
+
     QString whereClauseRect();
     QString whereClauseFid();
     QString whereClauseFids();
+    //! binds the next batch of ids of a FilterFids request, returns false if there are no more
+    bool bindNextFids();
     QString mbr( const QgsRectangle& rect );
-    bool prepareStatement( QString whereClause );
+    bool prepareStatement( QString whereClause, const QString& orderBy = QString(), long limit = -1 );
     QString quotedPrimaryKey();
     bool getFeature( sqlite3_stmt *stmt, QgsFeature &feature );
+    bool getFeature( sqlite3_stmt *stmt, QgsFeatureBatch &batch );
+    //! steps to the next row of the statement, returns false at the end or on errors
+    bool nextRow( sqlite3_stmt *stmt );
     QString fieldName( const QgsField& fld );
     QVariant getFeatureAttribute( sqlite3_stmt* stmt, int ic, const QVariant::Type& type );
+    //! decodes the geometry BLOB of the column into mWkbBuffer, returns the WKB size or -1 for NULL or invalid geometries
+    int geometryWkb( sqlite3_stmt* stmt, int ic );
     void getFeatureGeometry( sqlite3_stmt* stmt, int ic, QgsFeature& feature );
+    void getFeatureGeometry( sqlite3_stmt* stmt, int ic, QgsFeatureBatch& batch, int row );
 
     //! wrapper of the SQLite database connection
     QgsSqliteHandle* mHandle;
@@ -96,6 +119,27 @@ class QgsSpatiaLiteFeatureIterator : public QgsAbstractFeatureIteratorFromSource
 
     bool mHasPrimaryKey;
     QgsFeatureId mRowNumber;
+
+    //! Set to true, if the where clause matches the filter expression exactly
+    bool mExpressionCompiled;
+
+    //! Set to true, if the statement orders the features
+    bool mOrderByCompiled;
+
+    //! Set to true, if the statement stops at the limit of the request
+    bool mLimitCompiled;
+
+    //! values bound to the parameters of the where clause, in order
+    QList<QVariant> mBindValues;
+
+    //! ids of a FilterFids request, bound in batches starting at parameter mFidParam
+    QList<QgsFeatureId> mFids;
+    int mFidParam;
+    int mFidBatchSize;
+    int mNextFid;
+
+    //! WKB of the current geometry, reused between features
+    QByteArray mWkbBuffer;
 };
 
 #endif // QGSSPATIALITEFEATUREITERATOR_H
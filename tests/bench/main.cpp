@@ -83,6 +83,8 @@ void usage( std::string const & appName )
             << "\t[--quality]\trenderer hint(s), comma separated, possible values: Antialiasing,TextAntialiasing,SmoothPixmapTransform,NonCosmeticDefaultPen\n"
             << "\t[--parallel]\trender layers in parallel instead of sequentially\n"
             << "\t[--print type]\twhat kind of time to print, possible values: wall,total,user,sys. Default is total.\n"
+            << "\t[--iterate batchsize]\tread all features of the vector layers instead of rendering,\n"
+            << "\t\t\tbatchsize features at once or feature by feature if 0\n"
             << "\t[--help]\t\tthis text\n\n"
             << "  FILES:\n"
             << "    Files specified on the command line can include rasters,\n"
@@ -139,6 +141,7 @@ int main( int argc, char *argv[] )
   QString myQuality = "";
   bool myParallel = false;
   QString myPrintTime = "total";
+  int myIterateBatchSize = -1;
 
   // This behaviour will set initial extent of map canvas, but only if
   // there are no command line arguments. This gives a usable map
@@ -179,6 +182,7 @@ int main( int argc, char *argv[] )
       {"quality", required_argument, 0, 'q'},
       {"parallel", no_argument, 0, 'P'},
       {"print", required_argument, 0, 'R'},
+      {"iterate", required_argument, 0, 'I'},
       {0, 0, 0, 0}
     };
 
@@ -256,6 +260,10 @@ int main( int argc, char *argv[] )
         myPrintTime = optarg;
         break;
 
+      case 'I':
+        myIterateBatchSize = QString( optarg ).toInt();
+        break;
+
       case '?':
         usage( argv[0] );
         return 2;   // XXX need standard exit codes
@@ -344,6 +352,10 @@ int main( int argc, char *argv[] )
     {
       myPrintTime = argv[++i];
     }
+    else if ( i + 1 < argc && ( arg == "--iterate" || arg == "-I" ) )
+    {
+      myIterateBatchSize = QString( argv[++i] ).toInt();
+    }
     else
     {
       myFileList.append( QDir::toNativeSeparators( QFileInfo( QFile::decodeName( argv[i] ) ).absoluteFilePath() ) );
@@ -581,7 +593,10 @@ int main( int argc, char *argv[] )
     }
   }
 
-  qbench->render();
+  if ( myIterateBatchSize >= 0 )
+    qbench->iterate( myIterateBatchSize );
+  else
+    qbench->render();
 
   if ( mySnapshotFileName != "" )
   {
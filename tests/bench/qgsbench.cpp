@@ -38,11 +38,13 @@
 #include "qgsversion.h"
 #endif
 #include "qgsbench.h"
+#include "qgsfeaturebatch.h"
 #include "qgslogger.h"
 #include "qgsmaplayerregistry.h"
 #include "qgsmaprendererparalleljob.h"
 #include "qgsmaprenderersequentialjob.h"
 #include "qgsproject.h"
+#include "qgsvectorlayer.h"
 
 const char *pre[] = { "user", "sys", "total", "wall" };
 
@@ -225,7 +227,54 @@ void QgsBench::render()
     delete job;
   }
 
+  logTimes();
+}
+
+void QgsBench::iterate( int batchSize )
+{
+  QgsDebugMsg( "entered" );
 
+  QList<QgsVectorLayer*> layers;
+  Q_FOREACH ( QgsMapLayer* layer, QgsMapLayerRegistry::instance()->mapLayers() )
+  {
+    QgsVectorLayer* vl = qobject_cast<QgsVectorLayer*>( layer );
+    if ( vl )
+      layers << vl;
+  }
+
+  qint64 count = 0;
+  for ( int i = 0; i < mIterations; i++ )
+  {
+    count = 0;
+
+    start();
+    Q_FOREACH ( QgsVectorLayer* vl, layers )
+    {
+      QgsFeatureIterator fit = vl->getFeatures();
+      if ( batchSize > 0 )
+      {
+        QgsFeatureBatch batch;
+        while ( fit.nextFeatures( batch, batchSize ) > 0 )
+          count += batch.size();
+      }
+      else
+      {
+        QgsFeature f;
+        while ( fit.nextFeature( f ) )
+          count++;
+      }
+    }
+    elapsed();
+  }
+
+  mLogMap.insert( "batch_size", batchSize );
+  mLogMap.insert( "features", count );
+
+  logTimes();
+}
+
+void QgsBench::logTimes()
+{
   mLogMap.insert( "iterations", mTimes.size() );
   mLogMap.insert( "revision", QGSVERSION );
 
@@ -284,6 +333,8 @@ void QgsBench::saveSnapsot( const QString & fileName )
 void QgsBench::printLog( const QString& printTime )
 {
   std::cout << "iterations: " << mLogMap["iterations"].toString().toAscii().constData() << std::endl;
+  if ( mLogMap.contains( "features" ) )
+    std::cout << "features: " << mLogMap["features"].toString().toAscii().constData() << std::endl;
 
   bool validPrintTime = false;
   for ( int x = 0; x < 4; ++x )
@@ -305,6 +356,14 @@ void QgsBench::printLog( const QString& printTime )
     std::cout << s.toAscii().constData() << std::endl;
     ++i;
   }
+
+  // throughput of feature iteration
+  double avg = totalMap["avg"].toDouble();
+  if ( mLogMap.contains( "features" ) && avg > 0 )
+  {
+    QString s = printTime + "_features_per_second: " + QString::number( mLogMap["features"].toLongLong() / avg, 'f', 0 );
+    std::cout << s.toAscii().constData() << std::endl;
+  }
 }
 
 QString QgsBench::serialize( const QMap<QString, QVariant>& theMap, int level )
@@ -320,6 +379,9 @@ QString QgsBench::serialize( const QMap<QString, QVariant>& theMap, int level )
       case QMetaType::Int:
         list.append( space2 + "\"" + i.key() + "\": " + QString( "%1" ).arg( i.value().toInt() ) );
         break;
+      case QMetaType::LongLong:
+        list.append( space2 + "\"" + i.key() + "\": " + QString( "%1" ).arg( i.value().toLongLong() ) );
+        break;
       case QMetaType::Double:
         list.append( space2 + "\"" + i.key() + "\": " + QString( "%1" ).arg( i.value().toDouble(), 0, 'f', 3 ) );
         break;
@@ -44,6 +44,12 @@ class QgsBench :  public QObject
 
     void render();
 
+    /** Reads all features of all vector layers instead of rendering them.
+     * @param batchSize number of features fetched at once with nextFeatures(),
+     * 0 to fetch feature by feature with nextFeature()
+     */
+    void iterate( int batchSize );
+
     void printLog( const QString& printTime );
 
     bool openProject( const QString & fileName );
@@ -64,6 +70,9 @@ class QgsBench :  public QObject
     void readProject( const QDomDocument &doc );
 
   private:
+    // calculate statistics of the measured times and add them to the log
+    void logTimes();
+
     // snapshot image width
     int mWidth;
 
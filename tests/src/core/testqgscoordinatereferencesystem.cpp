@@ -20,6 +20,7 @@ Email                : sherman at mrcc dot com
 
 //header for class being tested
 #include <qgscoordinatereferencesystem.h>
+#include <qgscrsdatabaseindex.h>
 #include <qgis.h>
 #include <qgsvectorlayer.h>
 
@@ -44,6 +45,8 @@ class TestQgsCoordinateReferenceSystem: public QObject
     void createFromESRIWkt();
     void createFromSrsId();
     void createFromProj4();
+    void createFromProj4ParameterOrder();
+    void databaseIndex();
     void isValid();
     void validate();
     void equality();
@@ -284,6 +287,51 @@ void TestQgsCoordinateReferenceSystem::createFromProj4()
   QVERIFY( myCrs.createFromProj4( GEOPROJ4 ) );
   debugPrint( myCrs );
 }
+void TestQgsCoordinateReferenceSystem::createFromProj4ParameterOrder()
+{
+  //parameters in a different order than in srs.db must still match the definition
+  QgsCoordinateReferenceSystem myCrs;
+  QVERIFY( myCrs.createFromProj4( "+no_defs +datum=WGS84 +proj=longlat" ) );
+  QCOMPARE( myCrs.srsid(), GEOCRS_ID );
+  QCOMPARE( myCrs.authid(), QString( "EPSG:4326" ) );
+}
+void TestQgsCoordinateReferenceSystem::databaseIndex()
+{
+  QgsCrsDatabaseIndex* index = QgsCrsDatabaseIndex::instance();
+  QVERIFY( index->isValid() );
+
+  QgsCrsDatabaseRecord record;
+  QVERIFY( index->recordByAuthId( "epsg:4326", record ) );
+  QCOMPARE( record.srsId, GEOCRS_ID );
+  QCOMPARE( record.srid, GEOSRID );
+  QVERIFY( record.isGeo );
+
+  QVERIFY( index->recordBySrsId( GEOCRS_ID, record ) );
+  QCOMPARE( record.authId, QString( "EPSG:4326" ) );
+
+  QVERIFY( index->recordBySrid( GEOSRID, record ) );
+  QCOMPARE( record.srsId, GEOCRS_ID );
+
+  QVERIFY( index->recordByParameters( GEOPROJ4, record ) );
+  QCOMPARE( record.srsId, GEOCRS_ID );
+
+  QVERIFY( !index->recordByAuthId( "EPSG:999999", record ) );
+  QVERIFY( !index->recordBySrsId( -5, record ) );
+
+  //lookups must agree with the crs created from the database
+  QgsCoordinateReferenceSystem myCrs;
+  myCrs.createFromSrsId( GEOCRS_ID );
+  QCOMPARE( myCrs.toProj4(), record.parameters );
+
+  //definitions shared by several crs resolve to the first non deprecated one
+  QString sharedProj4 = "+proj=longlat +ellps=GRS80 +towgs84=0,0,0,0,0,0,0 +no_defs";
+  QVERIFY( index->recordByParameters( sharedProj4, record ) );
+  QCOMPARE( record.authId, QString( "EPSG:4140" ) );
+  QVERIFY( index->recordByParameterSet( "+no_defs +towgs84=0,0,0,0,0,0,0 +ellps=GRS80 +proj=longlat", record ) );
+  QCOMPARE( record.authId, QString( "EPSG:4140" ) );
+  QVERIFY( myCrs.createFromProj4( sharedProj4 ) );
+  QCOMPARE( myCrs.authid(), QString( "EPSG:4140" ) );
+}
 void TestQgsCoordinateReferenceSystem::isValid()
 {
   QgsCoordinateReferenceSystem myCrs;
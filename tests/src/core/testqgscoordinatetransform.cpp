@@ -17,6 +17,7 @@
 #include "qgscoordinatetransform.h"
 #include "qgsapplication.h"
 #include <QObject>
+#include <QPolygonF>
 #include <QtTest/QtTest>
 
 class TestQgsCoordinateTransform: public QObject
@@ -27,6 +28,10 @@ class TestQgsCoordinateTransform: public QObject
     void initTestCase();
     void cleanupTestCase();
     void transformBoundingBox();
+    void transformStridedCoords();
+    void transformPolygon();
+    void shortCircuitEquivalentCrs();
+    void releasedDefinitions();
 
   private:
 
@@ -73,5 +78,107 @@ void TestQgsCoordinateTransform::transformBoundingBox()
   QVERIFY( qgsDoubleNear( resultRect.yMaximum(), expectedRect.yMaximum(), 0.001 ) );
 }
 
+void TestQgsCoordinateTransform::transformStridedCoords()
+{
+  QgsCoordinateReferenceSystem sourceSrs;
+  sourceSrs.createFromSrid( 4326 );
+  QgsCoordinateReferenceSystem destSrs;
+  destSrs.createFromSrid( 3857 );
+  QgsCoordinateTransform tr( sourceSrs, destSrs );
+
+  //interleaved x/y/z buffer, as found in vertex arrays
+  double xyz[] = { 0.0, 0.0, 0.0, 10.0, 20.0, 0.0, -30.0, 45.0, 0.0 };
+  tr.transformStridedCoords( 3, xyz, xyz + 1, xyz + 2, 3 );
+
+  //separate arrays
+  double x[] = { 0.0, 10.0, -30.0 };
+  double y[] = { 0.0, 20.0, 45.0 };
+  double z[] = { 0.0, 0.0, 0.0 };
+  tr.transformCoords( 3, x, y, z );
+
+  for ( int i = 0; i < 3; ++i )
+  {
+    QVERIFY( qgsDoubleNear( xyz[3 * i], x[i], 0.001 ) );
+    QVERIFY( qgsDoubleNear( xyz[3 * i + 1], y[i], 0.001 ) );
+  }
+
+  //no z values
+  double xy[] = { 10.0, 20.0 };
+  tr.transformStridedCoords( 1, xy, xy + 1, 0, 2 );
+  QgsPoint expected = tr.transform( 10.0, 20.0 );
+  QVERIFY( qgsDoubleNear( xy[0], expected.x(), 0.001 ) );
+  QVERIFY( qgsDoubleNear( xy[1], expected.y(), 0.001 ) );
+
+  //reverse
+  tr.transformStridedCoords( 1, xy, xy + 1, 0, 2, QgsCoordinateTransform::ReverseTransform );
+  QVERIFY( qgsDoubleNear( xy[0], 10.0, 0.000001 ) );
+  QVERIFY( qgsDoubleNear( xy[1], 20.0, 0.000001 ) );
+}
+
+void TestQgsCoordinateTransform::transformPolygon()
+{
+  QgsCoordinateReferenceSystem sourceSrs;
+  sourceSrs.createFromSrid( 4326 );
+  QgsCoordinateReferenceSystem destSrs;
+  destSrs.createFromSrid( 3857 );
+  QgsCoordinateTransform tr( sourceSrs, destSrs );
+
+  QPolygonF poly;
+  poly << QPointF( 0, 0 ) << QPointF( 10, 20 ) << QPointF( -30, 45 );
+  QPolygonF original = poly;
+  tr.transformPolygon( poly );
+
+  QCOMPARE( poly.size(), original.size() );
+  for ( int i = 0; i < poly.size(); ++i )
+  {
+    QgsPoint expected = tr.transform( original.at( i ).x(), original.at( i ).y() );
+    QVERIFY( qgsDoubleNear( poly.at( i ).x(), expected.x(), 0.001 ) );
+    QVERIFY( qgsDoubleNear( poly.at( i ).y(), expected.y(), 0.001 ) );
+  }
+}
+
+void TestQgsCoordinateTransform::shortCircuitEquivalentCrs()
+{
+  QgsCoordinateReferenceSystem sourceSrs;
+  sourceSrs.createFromSrid( 4326 );
+  QgsCoordinateReferenceSystem destSrs;
+  destSrs.createFromProj4( sourceSrs.toProj4() );
+
+  QgsCoordinateTransform tr( sourceSrs, destSrs );
+  QVERIFY( tr.isShortCircuited() );
+
+  QgsCoordinateReferenceSystem mercator;
+  mercator.createFromSrid( 3857 );
+  QgsCoordinateTransform tr2( sourceSrs, mercator );
+  QVERIFY( !tr2.isShortCircuited() );
+}
+
+void TestQgsCoordinateTransform::releasedDefinitions()
+{
+  QgsCoordinateReferenceSystem wgs84;
+  wgs84.createFromSrid( 4326 );
+
+  //custom definitions are released with the last transform using them, and their ids reused
+  QgsCoordinateReferenceSystem custom;
+  custom.createFromProj4( "+proj=tmerc +lat_0=0 +lon_0=9 +k=0.9996 +x_0=500000 +y_0=0 +ellps=WGS84 +units=m +no_defs" );
+  QgsCoordinateTransform* tr = new QgsCoordinateTransform( wgs84, custom );
+  QgsPoint first = tr->transform( 9.0, 45.0 );
+  QVERIFY( qgsDoubleNear( first.x(), 500000.0, 0.001 ) );
+  delete tr;
+
+  QgsCoordinateReferenceSystem edited;
+  edited.createFromProj4( "+proj=tmerc +lat_0=0 +lon_0=15 +k=0.9996 +x_0=500000 +y_0=0 +ellps=WGS84 +units=m +no_defs" );
+  QgsCoordinateTransform tr2( wgs84, edited );
+  QgsPoint second = tr2.transform( 15.0, 45.0 );
+  QVERIFY( qgsDoubleNear( second.x(), 500000.0, 0.001 ) );
+  QVERIFY( qgsDoubleNear( second.y(), first.y(), 0.001 ) );
+
+  //changing the crs of a transform releases the definition it used before
+  tr2.setDestCRS( custom );
+  QgsPoint third = tr2.transform( 9.0, 45.0 );
+  QVERIFY( qgsDoubleNear( third.x(), first.x(), 0.001 ) );
+  QVERIFY( qgsDoubleNear( third.y(), first.y(), 0.001 ) );
+}
+
 QTEST_MAIN( TestQgsCoordinateTransform )
 #include "testqgscoordinatetransform.moc"
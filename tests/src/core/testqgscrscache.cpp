@@ -0,0 +1,132 @@
+/***************************************************************************
+     testqgscrscache.cpp
+     -------------------
+    Date                 : October 2015
+    Copyright            : (C) 2015 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include <QtTest/QtTest>
+#include <QObject>
+#include <QSharedPointer>
+#include <QString>
+#include <QtConcurrentMap>
+
+#include "qgsapplication.h"
+#include "qgscrscache.h"
+#include "qgscoordinatetransform.h"
+
+// looks up crs and transforms over and over, every fourth task also invalidates the cached crs.
+// Result is set to 1 if all crs were valid and matched the requested ones.
+static void _lookupCrs( int& result )
+{
+  bool invalidate = result % 4 == 0;
+  result = 1;
+  for ( int i = 0; i < 50; ++i )
+  {
+    QgsCoordinateReferenceSystem crs = QgsCRSCache::instance()->crsByAuthId( "EPSG:4326" );
+    if ( !crs.isValid() || crs.authid() != "EPSG:4326" )
+      result = 0;
+
+    crs = QgsCRSCache::instance()->crsBySrsId( GEOCRS_ID );
+    if ( !crs.isValid() || crs.srsid() != GEOCRS_ID )
+      result = 0;
+
+    crs = QgsCRSCache::instance()->crsByProj4( GEOPROJ4 );
+    if ( !crs.isValid() || crs.srsid() != GEOCRS_ID )
+      result = 0;
+
+    QSharedPointer<const QgsCoordinateTransform> ct = QgsCoordinateTransformCache::instance()->sharedTransform( "EPSG:4326", "EPSG:3857" );
+    if ( !ct || ct->destCRS().authid() != "EPSG:3857" )
+      result = 0;
+
+    if ( invalidate )
+      QgsCRSCache::instance()->updateCRSCache( "EPSG:4326" );
+  }
+}
+
+class TestQgsCrsCache: public QObject
+{
+    Q_OBJECT
+  private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void lookups();
+    void concurrentLookups();
+    void retiredTransforms();
+};
+
+void TestQgsCrsCache::initTestCase()
+{
+  QgsApplication::init();
+  QgsApplication::initQgis();
+}
+
+void TestQgsCrsCache::cleanupTestCase()
+{
+  QgsApplication::exitQgis();
+}
+
+void TestQgsCrsCache::lookups()
+{
+  QgsCRSCache* cache = QgsCRSCache::instance();
+  cache->resetStatistics();
+
+  QgsCoordinateReferenceSystem crs = cache->crsByAuthId( "EPSG:3857" );
+  QVERIFY( crs.isValid() );
+  QCOMPARE( crs.authid(), QString( "EPSG:3857" ) );
+  crs = cache->crsByEpsgId( 3857 );
+  QCOMPARE( crs.authid(), QString( "EPSG:3857" ) );
+  QVERIFY( cache->hits() >= 1 );
+
+  QVERIFY( !cache->crsByAuthId( "EPSG:999999" ).isValid() );
+
+  // the returned crs are copies, invalidating the cache does not affect them
+  cache->updateCRSCache( "EPSG:3857" );
+  QCOMPARE( crs.authid(), QString( "EPSG:3857" ) );
+}
+
+void TestQgsCrsCache::concurrentLookups()
+{
+  QList<int> results;
+  for ( int i = 0; i < 16; ++i )
+    results << i;
+  QtConcurrent::blockingMap( results, _lookupCrs );
+
+  Q_FOREACH ( int result, results )
+  {
+    QCOMPARE( result, 1 );
+  }
+}
+
+void TestQgsCrsCache::retiredTransforms()
+{
+  QgsCoordinateTransformCache* cache = QgsCoordinateTransformCache::instance();
+  QSharedPointer<const QgsCoordinateTransform> ct = cache->sharedTransform( "EPSG:4326", "EPSG:32633" );
+  QVERIFY( ct );
+  QCOMPARE( cache->sharedTransform( "EPSG:4326", "EPSG:32633" ).data(), ct.data() );
+
+  // an invalidated transform stays usable for its users and is deleted by the last of them
+  QWeakPointer<const QgsCoordinateTransform> retired( ct );
+  QgsCRSCache::instance()->updateCRSCache( "EPSG:32633" );
+  QCOMPARE( ct->destCRS().authid(), QString( "EPSG:32633" ) );
+  QVERIFY( cache->sharedTransform( "EPSG:4326", "EPSG:32633" ).data() != ct.data() );
+  ct.clear();
+  QVERIFY( retired.isNull() );
+
+  // transforms without shared ownership are kept
+  const QgsCoordinateTransform* lent = cache->transform( "EPSG:4326", "EPSG:32633" );
+  retired = cache->sharedTransform( "EPSG:4326", "EPSG:32633" );
+  QCOMPARE( retired.data(), lent );
+  QgsCRSCache::instance()->updateCRSCache( "EPSG:32633" );
+  QVERIFY( !retired.isNull() );
+  QCOMPARE( lent->destCRS().authid(), QString( "EPSG:32633" ) );
+}
+
+QTEST_MAIN( TestQgsCrsCache )
+#include "testqgscrscache.moc"
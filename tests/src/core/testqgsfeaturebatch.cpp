@@ -0,0 +1,275 @@
+/***************************************************************************
+     testqgsfeaturebatch.cpp
+     -----------------------
+    Date                 : October 2015
+    Copyright            : (C) 2015 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include <QtTest/QtTest>
+#include <QObject>
+#include <QString>
+
+#include "qgsapplication.h"
+#include "qgsfeaturebatch.h"
+#include "qgsfeature.h"
+#include "qgsfeatureiterator.h"
+#include "qgsfield.h"
+#include "qgsgeometry.h"
+#include "qgspoint.h"
+#include "qgsvectordataprovider.h"
+#include "qgsvectorlayer.h"
+
+class TestQgsFeatureBatch: public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void initTestCase();// will be called before the first testfunction is executed.
+    void cleanupTestCase();// will be called after the last testfunction was executed.
+    void init();// will be called before each testfunction is executed.
+    void cleanup();// will be called after every testfunction.
+    void addFeatures();
+    void featureView();
+    void reuse();
+    void changeFields();
+    void nextFeatures();
+    void nextFeaturesFiltered();
+    void nativeBatches();
+
+  private:
+    QgsFields mFields;
+    QgsVectorLayer* mLayer;
+};
+
+void TestQgsFeatureBatch::initTestCase()
+{
+  QgsApplication::init();
+  QgsApplication::initQgis();
+
+  mFields.append( QgsField( "name", QVariant::String ) );
+  mFields.append( QgsField( "value", QVariant::Int ) );
+
+  mLayer = new QgsVectorLayer( "Point?field=name:string&field=value:integer", "layer", "memory" );
+  QVERIFY( mLayer->isValid() );
+  QgsFeatureList features;
+  for ( int i = 1; i <= 25; ++i )
+  {
+    QgsFeature f( mLayer->dataProvider()->fields(), i );
+    f.setAttribute( "name", QString::number( i ) );
+    f.setAttribute( "value", i );
+    f.setGeometry( QgsGeometry::fromPoint( QgsPoint( i, i ) ) );
+    features << f;
+  }
+  mLayer->dataProvider()->addFeatures( features );
+}
+
+void TestQgsFeatureBatch::cleanupTestCase()
+{
+  delete mLayer;
+  QgsApplication::exitQgis();
+}
+
+void TestQgsFeatureBatch::init()
+{
+}
+
+void TestQgsFeatureBatch::cleanup()
+{
+}
+
+void TestQgsFeatureBatch::addFeatures()
+{
+  QgsFeatureBatch batch;
+  batch.setFields( mFields );
+  QVERIFY( batch.isEmpty() );
+
+  int row = batch.addFeature( 5 );
+  QCOMPARE( row, 0 );
+  batch.setAttribute( row, 0, QString( "a" ) );
+  batch.setAttribute( row, 1, 1 );
+  QScopedPointer<QgsGeometry> point( QgsGeometry::fromPoint( QgsPoint( 1, 2 ) ) );
+  batch.setGeometry( row, point.data() );
+
+  QgsFeature f( mFields, 7 );
+  QgsAttributes attrs;
+  attrs << QString( "b" ) << 2;
+  f.setAttributes( attrs );
+  row = batch.addFeature( f );
+  QCOMPARE( row, 1 );
+
+  QCOMPARE( batch.size(), 2 );
+  QCOMPARE( batch.id( 0 ), QgsFeatureId( 5 ) );
+  QCOMPARE( batch.id( 1 ), QgsFeatureId( 7 ) );
+  QCOMPARE( batch.attribute( 0, 0 ), QVariant( "a" ) );
+  QCOMPARE( batch.attribute( 1, 1 ), QVariant( 2 ) );
+  QVERIFY( batch.hasGeometry( 0 ) );
+  QVERIFY( !batch.hasGeometry( 1 ) );
+  QVERIFY( !batch.geometryWkb( 1 ) );
+  QCOMPARE( batch.geometryWkbSize( 0 ), ( int ) point->wkbSize() );
+  QVERIFY( memcmp( batch.geometryWkb( 0 ), point->asWkb(), point->wkbSize() ) == 0 );
+}
+
+void TestQgsFeatureBatch::featureView()
+{
+  QgsFeatureBatch batch;
+  batch.setFields( mFields );
+  int row = batch.addFeature( 3 );
+  batch.setAttribute( row, 0, QString( "a" ) );
+  QScopedPointer<QgsGeometry> point( QgsGeometry::fromPoint( QgsPoint( 1, 2 ) ) );
+  batch.setGeometry( row, point.data() );
+  row = batch.addFeature( 4 );
+  batch.setAttribute( row, 1, 5 );
+
+  QgsFeature f;
+  QVERIFY( batch.feature( 0, f ) );
+  QVERIFY( f.isValid() );
+  QCOMPARE( f.id(), QgsFeatureId( 3 ) );
+  QCOMPARE( f.attributes().size(), 2 );
+  QCOMPARE( f.attribute( "name" ), QVariant( "a" ) );
+  QVERIFY( f.attribute( 1 ).isNull() );
+  QVERIFY( f.constGeometry() );
+  QCOMPARE( f.constGeometry()->asPoint(), QgsPoint( 1, 2 ) );
+
+  // reusing the feature must not leak values of the previous row
+  QVERIFY( batch.feature( 1, f ) );
+  QCOMPARE( f.id(), QgsFeatureId( 4 ) );
+  QVERIFY( f.attribute( 0 ).isNull() );
+  QCOMPARE( f.attribute( 1 ), QVariant( 5 ) );
+  QVERIFY( !f.constGeometry() );
+
+  QVERIFY( !batch.feature( 2, f ) );
+  QCOMPARE( batch.feature( 1 ).attribute( 1 ), QVariant( 5 ) );
+}
+
+void TestQgsFeatureBatch::reuse()
+{
+  QgsFeatureBatch batch;
+  batch.setFields( mFields );
+  QScopedPointer<QgsGeometry> point( QgsGeometry::fromPoint( QgsPoint( 1, 2 ) ) );
+  for ( int i = 0; i < 100; ++i )
+  {
+    int row = batch.addFeature( i );
+    batch.setAttribute( row, 0, QString::number( i ) );
+    batch.setGeometry( row, point.data() );
+  }
+  int arenaSize = batch.arenaSize();
+  QCOMPARE( arenaSize, 100 * ( int ) point->wkbSize() );
+
+  batch.clear();
+  QVERIFY( batch.isEmpty() );
+  QCOMPARE( batch.arenaSize(), 0 );
+
+  // values of the previous fill are reset
+  int row = batch.addFeature( 1000 );
+  QVERIFY( batch.attribute( row, 0 ).isNull() );
+  QVERIFY( !batch.hasGeometry( row ) );
+  batch.setGeometry( row, point.data() );
+  QCOMPARE( batch.feature( row ).constGeometry()->asPoint(), QgsPoint( 1, 2 ) );
+}
+
+void TestQgsFeatureBatch::changeFields()
+{
+  QgsFeatureBatch batch;
+  batch.setFields( mFields );
+  batch.addFeature( 1 );
+
+  // same number of fields keeps the features
+  batch.setFields( mFields );
+  QCOMPARE( batch.size(), 1 );
+
+  QgsFields fields = mFields;
+  fields.append( QgsField( "other", QVariant::Double ) );
+  batch.setFields( fields );
+  QVERIFY( batch.isEmpty() );
+  int row = batch.addFeature( 2 );
+  batch.setAttribute( row, 2, 1.5 );
+  QCOMPARE( batch.feature( row ).attributes().size(), 3 );
+  QCOMPARE( batch.attribute( row, 2 ), QVariant( 1.5 ) );
+}
+
+void TestQgsFeatureBatch::nextFeatures()
+{
+  // batches must contain the same features as iterating feature by feature
+  QMap<QgsFeatureId, QgsFeature> expected;
+  QgsFeature f;
+  QgsFeatureIterator fit = mLayer->getFeatures();
+  while ( fit.nextFeature( f ) )
+    expected.insert( f.id(), f );
+  QCOMPARE( expected.size(), 25 );
+
+  QgsFeatureBatch batch;
+  QList<int> sizes;
+  int count = 0;
+  fit = mLayer->getFeatures();
+  while ( fit.nextFeatures( batch, 10 ) > 0 )
+  {
+    sizes << batch.size();
+    for ( int row = 0; row < batch.size(); ++row )
+    {
+      QVERIFY( batch.feature( row, f ) );
+      QVERIFY( expected.contains( f.id() ) );
+      QCOMPARE( f.attributes(), expected.value( f.id() ).attributes() );
+      QCOMPARE( f.attribute( "value" ), QVariant( int( f.id() ) ) );
+      QCOMPARE( f.constGeometry()->asPoint(), expected.value( f.id() ).constGeometry()->asPoint() );
+      count++;
+    }
+  }
+  QCOMPARE( sizes, QList<int>() << 10 << 10 << 5 );
+  QCOMPARE( count, 25 );
+  QVERIFY( batch.isEmpty() );
+
+  // without geometry
+  fit = mLayer->getFeatures( QgsFeatureRequest().setFlags( QgsFeatureRequest::NoGeometry ) );
+  QCOMPARE( fit.nextFeatures( batch, 100 ), 25 );
+  QVERIFY( !batch.hasGeometry( 0 ) );
+}
+
+void TestQgsFeatureBatch::nextFeaturesFiltered()
+{
+  QgsFeatureBatch batch;
+
+  QgsFeatureIterator fit = mLayer->getFeatures( QgsFeatureRequest().setFilterExpression( "value > 20" ) );
+  QCOMPARE( fit.nextFeatures( batch, 100 ), 5 );
+  for ( int row = 0; row < batch.size(); ++row )
+    QVERIFY( batch.attribute( row, 1 ).toInt() > 20 );
+  QCOMPARE( fit.nextFeatures( batch, 100 ), 0 );
+
+  fit = mLayer->getFeatures( QgsFeatureRequest().setFilterFids( QgsFeatureIds() << 3 << 7 ) );
+  QCOMPARE( fit.nextFeatures( batch, 100 ), 2 );
+
+  fit = mLayer->getFeatures( QgsFeatureRequest().setFilterRect( QgsRectangle( 0.5, 0.5, 4.5, 4.5 ) ) );
+  QCOMPARE( fit.nextFeatures( batch, 100 ), 4 );
+
+  // invalid iterator
+  QCOMPARE( QgsFeatureIterator().nextFeatures( batch ), 0 );
+}
+
+void TestQgsFeatureBatch::nativeBatches()
+{
+  // the memory provider fills batches directly
+  QVERIFY( mLayer->getFeatures().hasNativeBatches() );
+  QVERIFY( mLayer->getFeatures( QgsFeatureRequest().setFilterRect( QgsRectangle( 0.5, 0.5, 4.5, 4.5 ) ) ).hasNativeBatches() );
+  QVERIFY( mLayer->dataProvider()->getFeatures().hasNativeBatches() );
+
+  // these are filled feature by feature
+  QVERIFY( !mLayer->getFeatures( QgsFeatureRequest().setFilterExpression( "value > 20" ) ).hasNativeBatches() );
+  QVERIFY( !mLayer->getFeatures( QgsFeatureRequest().setFilterFids( QgsFeatureIds() << 3 << 7 ) ).hasNativeBatches() );
+  QVERIFY( !mLayer->getFeatures( QgsFeatureRequest().setFilterFid( 3 ) ).hasNativeBatches() );
+  QVERIFY( !mLayer->getFeatures( QgsFeatureRequest().setLimit( 5 ) ).hasNativeBatches() );
+  QVERIFY( !QgsFeatureIterator().hasNativeBatches() );
+
+  // the edit buffer changes the provider features
+  QVERIFY( mLayer->startEditing() );
+  QVERIFY( !mLayer->getFeatures().hasNativeBatches() );
+  QVERIFY( mLayer->rollBack() );
+  QVERIFY( mLayer->getFeatures().hasNativeBatches() );
+}
+
+QTEST_MAIN( TestQgsFeatureBatch )
+#include "testqgsfeaturebatch.moc"
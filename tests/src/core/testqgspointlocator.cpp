@@ -15,6 +15,7 @@
 
 #include <QtTest/QtTest>
 #include <QObject>
+#include <QSignalSpy>
 #include <QString>
 
 #include "qgsapplication.h"
@@ -241,6 +242,132 @@ class TestQgsPointLocator : public QObject
       mVL->rollBack();
     }
 
+    void testInitInBackground()
+    {
+      QgsPointLocator loc( mVL );
+      QSignalSpy spy( &loc, SIGNAL( initFinished( bool ) ) );
+      loc.initInBackground();
+      QVERIFY( loc.isIndexing() || loc.hasIndex() );
+
+      // a feature added while indexing is applied once the index is ready
+      mVL->startEditing();
+      QgsFeature ff( 0 );
+      QgsPolygon polygon;
+      QgsPolyline polyline;
+      polyline << QgsPoint( 10, 11 ) << QgsPoint( 11, 10 ) << QgsPoint( 11, 11 ) << QgsPoint( 10, 11 );
+      polygon << polyline;
+      ff.setGeometry( QgsGeometry::fromPolygon( polygon ) );
+      QVERIFY( mVL->addFeature( ff ) );
+
+      loc.waitForIndexingFinished();
+      QVERIFY( !loc.isIndexing() );
+      QVERIFY( loc.hasIndex() );
+      QCOMPARE( spy.count(), 1 );
+      QCOMPARE( spy.at( 0 ).at( 0 ).toBool(), true );
+
+      QgsPointLocator::Match m = loc.nearestVertex( QgsPoint( 12, 12 ), 999 );
+      QVERIFY( m.isValid() );
+      QCOMPARE( m.point(), QgsPoint( 11, 11 ) );
+
+      mVL->rollBack();
+    }
+
+    void testMultiPartAndHoles()
+    {
+      QgsVectorLayer* vlPoly = new QgsVectorLayer( "Polygon", "p", "memory" );
+      QgsFeature ff( 0 );
+      ff.setGeometry( QgsGeometry::fromWkt( "POLYGON((0 0, 10 0, 10 10, 0 10, 0 0),(4 4, 6 4, 6 6, 4 6, 4 4))" ) );
+      QgsFeatureList flist;
+      flist << ff;
+      vlPoly->dataProvider()->addFeatures( flist );
+
+      QgsPointLocator locPoly( vlPoly );
+      QCOMPARE( locPoly.pointInPolygon( QgsPoint( 2, 2 ) ).count(), 1 );
+      QCOMPARE( locPoly.pointInPolygon( QgsPoint( 5, 5 ) ).count(), 0 ); // in the hole
+      QCOMPARE( locPoly.pointInPolygon( QgsPoint( 4, 5 ) ).count(), 1 ); // on the boundary of the hole
+
+      // vertices of the hole follow those of the exterior ring
+      QgsPointLocator::Match mV = locPoly.nearestVertex( QgsPoint( 6.1, 6.1 ), 1 );
+      QVERIFY( mV.isValid() );
+      QCOMPARE( mV.point(), QgsPoint( 6, 6 ) );
+      QCOMPARE( mV.vertexIndex(), 7 );
+
+      QgsVectorLayer* vlLine = new QgsVectorLayer( "MultiLineString", "l", "memory" );
+      QgsFeature fl( 0 );
+      fl.setGeometry( QgsGeometry::fromWkt( "MULTILINESTRING((0 0, 1 0),(0 2, 1 2, 2 2))" ) );
+      flist.clear();
+      flist << fl;
+      vlLine->dataProvider()->addFeatures( flist );
+
+      QgsPointLocator locLine( vlLine );
+      QgsPointLocator::Match mE = locLine.nearestEdge( QgsPoint( 1.5, 2.1 ), 1 );
+      QVERIFY( mE.isValid() );
+      QCOMPARE( mE.vertexIndex(), 3 );
+      QgsPoint pt1, pt2;
+      mE.edgePoints( pt1, pt2 );
+      QCOMPARE( pt1, QgsPoint( 1, 2 ) );
+      QCOMPARE( pt2, QgsPoint( 2, 2 ) );
+
+      // no segment between the parts
+      QCOMPARE( locLine.edgesInRect( QgsRectangle( 0.9, 0.5, 1.1, 1.5 ) ).count(), 0 );
+
+      delete vlPoly;
+      delete vlLine;
+    }
+
+    void testIndexSegments()
+    {
+      // a zig-zag line with more vertices than fit into a single index entry
+      QgsVectorLayer* vl = new QgsVectorLayer( "LineString", "l", "memory" );
+      QgsPolyline polyline;
+      for ( int i = 0; i < 100; ++i )
+        polyline << QgsPoint( i, i % 2 );
+      QgsFeature ff( 0 );
+      ff.setGeometry( QgsGeometry::fromPolyline( polyline ) );
+      QgsFeatureList flist;
+      flist << ff;
+      vl->dataProvider()->addFeatures( flist );
+
+      QgsPointLocator loc( vl );
+      loc.setIndexGranularity( QgsPointLocator::IndexSegments );
+      QCOMPARE( loc.indexGranularity(), QgsPointLocator::IndexSegments );
+
+      QgsPointLocator::Match mV = loc.nearestVertex( QgsPoint( 71.1, 1.2 ), 0.5 );
+      QVERIFY( mV.isValid() );
+      QCOMPARE( mV.point(), QgsPoint( 71, 1 ) );
+      QCOMPARE( mV.vertexIndex(), 71 );
+
+      // the vertex shared by two runs of segments
+      mV = loc.nearestVertex( QgsPoint( 32, 0.1 ), 0.5 );
+      QVERIFY( mV.isValid() );
+      QCOMPARE( mV.vertexIndex(), 32 );
+
+      QgsPointLocator::Match mE = loc.nearestEdge( QgsPoint( 64.5, 0.6 ), 0.5 );
+      QVERIFY( mE.isValid() );
+      QCOMPARE( mE.vertexIndex(), 64 );
+      QgsPoint pt1, pt2;
+      mE.edgePoints( pt1, pt2 );
+      QCOMPARE( pt1, QgsPoint( 64, 0 ) );
+      QCOMPARE( pt2, QgsPoint( 65, 1 ) );
+
+      // each segment is reported once
+      QCOMPARE( loc.edgesInRect( QgsRectangle( 31.5, -1, 33.5, 2 ) ).count(), 3 );
+
+      // the index follows the edits of the layer
+      vl->startEditing();
+      QgsGeometry* newGeom = new QgsGeometry( *ff.constGeometry() );
+      newGeom->moveVertex( 70, 5, 71 );
+      vl->changeGeometry( flist.at( 0 ).id(), newGeom );
+      delete newGeom;
+      mV = loc.nearestVertex( QgsPoint( 70.1, 4.9 ), 0.5 );
+      QVERIFY( mV.isValid() );
+      QCOMPARE( mV.vertexIndex(), 71 );
+      QVERIFY( !loc.nearestVertex( QgsPoint( 71, 1 ), 0.5 ).isValid() );
+      vl->rollBack();
+
+      delete vl;
+    }
+
     void testExtent()
     {
       QgsRectangle bbox1( 10, 10, 11, 11 ); // out of layer's bounds
@@ -35,6 +35,12 @@
 #include <qgsmaprenderer.h>
 #include <qgssinglebandgrayrenderer.h>
 #include <qgssinglebandpseudocolorrenderer.h>
+#include <qgsmultibandcolorrenderer.h>
+#include <qgscontrastenhancement.h>
+#include <qgsrasterdrawer.h>
+#include <qgsrasteriterator.h>
+#include <qgsrasterviewport.h>
+#include <qgsmaptopixel.h>
 #include <qgsvectorcolorrampv2.h>
 #include <qgscptcityarchive.h>
 
@@ -76,10 +82,13 @@ class TestQgsRasterLayer : public QObject
     void checkDimensions();
     void checkStats();
     void checkScaleOffset();
+    void checkGenericStats();
     void buildExternalOverviews();
     void registry();
     void transparency();
     void setRenderer();
+    void lookupRenderers();
+    void parallelParts();
   private:
     bool render( const QString& theFileName );
     bool setQml( const QString& theType );
@@ -112,6 +121,43 @@ class TestSignalReceiver : public QObject
     }
 };
 
+/** Raster input returning the same generated values as integer or as floating point blocks.
+ * Renderers look up the colors of integer blocks in tables and process floating point
+ * blocks pixel by pixel, comparing both outputs checks the tables.
+ */
+class TestBlockInterface : public QgsRasterInterface
+{
+  public:
+    TestBlockInterface( QGis::DataType dataType, bool hasNoDataValue )
+        : mDataType( dataType )
+        , mHasNoDataValue( hasNoDataValue )
+    {}
+
+    QgsRasterInterface *clone() const override { return new TestBlockInterface( mDataType, mHasNoDataValue ); }
+    QGis::DataType dataType( int bandNo ) const override { Q_UNUSED( bandNo ); return mDataType; }
+    int bandCount() const override { return 3; }
+
+    QgsRasterBlock *block( int bandNo, const QgsRectangle &extent, int width, int height ) override
+    {
+      Q_UNUSED( extent );
+      // -1 is no data, either as no data value or in the no data bitmap
+      QgsRasterBlock *block = mHasNoDataValue ? new QgsRasterBlock( mDataType, width, height, -1 ) : new QgsRasterBlock( mDataType, width, height );
+      for ( qgssize i = 0; i < ( qgssize )width * height; i++ )
+      {
+        int value = ( int )(( i * 7 * bandNo ) % 300 ) - 1;
+        if ( value == -1 )
+          block->setIsNoData( i );
+        else
+          block->setValue( i, value );
+      }
+      return block;
+    }
+
+  private:
+    QGis::DataType mDataType;
+    bool mHasNoDataValue;
+};
+
 //runs before all tests
 void TestQgsRasterLayer::initTestCase()
 {
@@ -452,6 +498,47 @@ void TestQgsRasterLayer::checkScaleOffset()
   delete myRasterLayer;
 }
 
+void TestQgsRasterLayer::checkGenericStats()
+{
+  mReport += "<h2>Check generic stats</h2>\n";
+
+  QgsRasterLayer * myGdalLayer = new QgsRasterLayer( mTestDataDir + "landsat.tif", "landsat" );
+  QgsRasterLayer * myGenericLayer = new QgsRasterLayer( mTestDataDir + "landsat.tif", "landsat" );
+  QVERIFY( myGdalLayer->isValid() );
+  QVERIFY( myGenericLayer->isValid() );
+
+  // custom no data values force the generic statistics, computed from blocks read in parallel
+  QgsRasterRangeList myNoData;
+  myNoData << QgsRasterRange( -1000, -999 );
+  myGenericLayer->dataProvider()->setUserNoDataValue( 1, myNoData );
+
+  int myStats = QgsRasterBandStats::Min | QgsRasterBandStats::Max | QgsRasterBandStats::Mean;
+  QgsRasterBandStats myGdalStatistics = myGdalLayer->dataProvider()->bandStatistics( 1, myStats );
+  QgsRasterBandStats myGenericStatistics = myGenericLayer->dataProvider()->bandStatistics( 1, myStats );
+  mReport += QString( "gdal mean = %1 generic mean = %2<br>\n" ).arg( myGdalStatistics.mean ).arg( myGenericStatistics.mean );
+
+  QCOMPARE( myGenericStatistics.minimumValue, myGdalStatistics.minimumValue );
+  QCOMPARE( myGenericStatistics.maximumValue, myGdalStatistics.maximumValue );
+  QVERIFY( qgsDoubleNearSig( myGenericStatistics.mean, myGdalStatistics.mean, 10 ) );
+  QVERIFY( myGenericStatistics.elementCount > 0 );
+  QVERIFY( qgsDoubleNear( myGenericStatistics.sum / myGenericStatistics.elementCount, myGenericStatistics.mean ) );
+
+  // all values are within the statistics range => every value is counted once
+  QgsRasterHistogram myHistogram = myGenericLayer->dataProvider()->histogram( 1, 100, myGenericStatistics.minimumValue, myGenericStatistics.maximumValue );
+  QVERIFY( myHistogram.valid );
+  QCOMPARE(( qgssize ) myHistogram.nonNullCount, myGenericStatistics.elementCount );
+  qgssize myCount = 0;
+  Q_FOREACH ( int myBinCount, myHistogram.histogramVector )
+  {
+    myCount += myBinCount;
+  }
+  QCOMPARE( myCount, myGenericStatistics.elementCount );
+
+  delete myGdalLayer;
+  delete myGenericLayer;
+  mReport += "<p>Passed</p>";
+}
+
 void TestQgsRasterLayer::buildExternalOverviews()
 {
   //before we begin delete any old ovr file (if it exists)
@@ -603,5 +690,111 @@ void TestQgsRasterLayer::setRenderer()
   QCOMPARE( mpRasterLayer->renderer(), renderer );
 }
 
+static QgsContrastEnhancement* testContrastEnhancement()
+{
+  QgsContrastEnhancement* ce = new QgsContrastEnhancement( QGis::Int16 );
+  ce->setMinimumValue( 20 );
+  ce->setMaximumValue( 250 );
+  ce->setContrastEnhancementAlgorithm( QgsContrastEnhancement::StretchToMinimumMaximum );
+  return ce;
+}
+
+void TestQgsRasterLayer::lookupRenderers()
+{
+  QgsRectangle extent( 0, 0, 40, 30 );
+
+  for ( int noDataValue = 0; noDataValue < 2; noDataValue++ )
+  {
+    // integer blocks are rendered with lookup tables, floating point blocks pixel by pixel
+    TestBlockInterface tableInput( QGis::Int16, noDataValue );
+    TestBlockInterface pixelInput( QGis::Float32, noDataValue );
+
+    QList<QgsRasterRenderer*> tableRenderers;
+    QList<QgsRasterRenderer*> pixelRenderers;
+    for ( int i = 0; i < 2; i++ )
+    {
+      QgsRasterInterface* input = i == 0 ? ( QgsRasterInterface* ) &tableInput : ( QgsRasterInterface* ) &pixelInput;
+      QList<QgsRasterRenderer*>& renderers = i == 0 ? tableRenderers : pixelRenderers;
+
+      QgsSingleBandGrayRenderer* grayRenderer = new QgsSingleBandGrayRenderer( input, 1 );
+      grayRenderer->setContrastEnhancement( testContrastEnhancement() );
+      renderers << grayRenderer;
+
+      QgsRasterShader* rasterShader = new QgsRasterShader();
+      QgsColorRampShader* colorRampShader = new QgsColorRampShader();
+      colorRampShader->setColorRampType( QgsColorRampShader::INTERPOLATED );
+      QList<QgsColorRampShader::ColorRampItem> colorRampItems;
+      colorRampItems << QgsColorRampShader::ColorRampItem( 0, QColor( "#0000ff" ) );
+      colorRampItems << QgsColorRampShader::ColorRampItem( 150, QColor( "#ffff00" ) );
+      colorRampItems << QgsColorRampShader::ColorRampItem( 300, QColor( "#ff0000" ) );
+      colorRampShader->setColorRampItemList( colorRampItems );
+      rasterShader->setRasterShaderFunction( colorRampShader );
+      renderers << new QgsSingleBandPseudoColorRenderer( input, 2, rasterShader );
+
+      renderers << new QgsMultiBandColorRenderer( input, 1, 2, 3, testContrastEnhancement(), testContrastEnhancement(), testContrastEnhancement() );
+    }
+
+    for ( int i = 0; i < tableRenderers.size(); i++ )
+    {
+      QgsRasterBlock* tableBlock = tableRenderers.at( i )->block( 1, extent, 40, 30 );
+      QgsRasterBlock* pixelBlock = pixelRenderers.at( i )->block( 1, extent, 40, 30 );
+      QVERIFY( !tableBlock->isEmpty() );
+      QCOMPARE( tableBlock->image(), pixelBlock->image() );
+      delete tableBlock;
+      delete pixelBlock;
+    }
+
+    qDeleteAll( tableRenderers );
+    qDeleteAll( pixelRenderers );
+  }
+}
+
+void TestQgsRasterLayer::parallelParts()
+{
+  int width = 300;
+  int height = 200;
+  QgsRectangle extent = mpLandsatRasterLayer->extent();
+
+  // parts much smaller than the viewport, so that the drawer reads them in parallel
+  QgsRasterIterator iterator( mpLandsatRasterLayer->pipe()->last() );
+  iterator.setMaximumTileWidth( 64 );
+  iterator.setMaximumTileHeight( 48 );
+
+  QgsRasterViewPort viewPort;
+  viewPort.mTopLeftPoint = QgsPoint( 0, 0 );
+  viewPort.mBottomRightPoint = QgsPoint( width, height );
+  viewPort.mWidth = width;
+  viewPort.mHeight = height;
+  viewPort.mDrawnExtent = extent;
+  QgsMapToPixel mapToPixel( extent.width() / width, extent.center().x(), extent.center().y(), width, height, 0 );
+
+  QImage parallelImage( width, height, QImage::Format_ARGB32_Premultiplied );
+  parallelImage.fill( 0 );
+  QPainter parallelPainter( &parallelImage );
+  QgsRasterDrawer drawer( &iterator );
+  drawer.draw( &parallelPainter, &viewPort, &mapToPixel );
+  parallelPainter.end();
+
+  // the same parts read one after the other
+  QImage sequentialImage( width, height, QImage::Format_ARGB32_Premultiplied );
+  sequentialImage.fill( 0 );
+  QPainter sequentialPainter( &sequentialImage );
+  iterator.startRasterRead( 1, width, height, extent );
+  int nCols, nRows, topLeftCol, topLeftRow;
+  QgsRasterBlock* block = 0;
+  int parts = 0;
+  while ( iterator.readNextRasterPart( 1, nCols, nRows, &block, topLeftCol, topLeftRow ) )
+  {
+    QVERIFY( block );
+    sequentialPainter.drawImage( QPoint( topLeftCol, topLeftRow ), block->image() );
+    delete block;
+    parts++;
+  }
+  sequentialPainter.end();
+
+  QVERIFY( parts > 4 );
+  QCOMPARE( parallelImage, sequentialImage );
+}
+
 QTEST_MAIN( TestQgsRasterLayer )
 #include "testqgsrasterlayer.moc"
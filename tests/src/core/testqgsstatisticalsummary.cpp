@@ -33,6 +33,9 @@ class TestQgsStatisticSummary: public QObject
     void cleanup();// will be called after every testfunction.
     void stats();
     void maxMin();
+    void streaming();
+    void merge();
+    void approximate();
 
   private:
 
@@ -133,5 +136,96 @@ void TestQgsStatisticSummary::maxMin()
   QCOMPARE( s.max(), -5.0 );
 }
 
+void TestQgsStatisticSummary::streaming()
+{
+  QList<double> values;
+  values << 6 << 7 << 15 << 36 << 39 << 40 << 41 << 42 << 43 << 47 << 49 << 50 << 58 << 7;
+
+  QgsStatisticalSummary list( QgsStatisticalSummary::All );
+  list.calculate( values );
+
+  QgsStatisticalSummary stream( QgsStatisticalSummary::All );
+  Q_FOREACH ( double value, values )
+    stream.addValue( value );
+  stream.finalize();
+
+  QCOMPARE( stream.count(), list.count() );
+  QCOMPARE( stream.sum(), list.sum() );
+  QVERIFY( qgsDoubleNear( stream.mean(), list.mean(), 0.000001 ) );
+  QVERIFY( qgsDoubleNear( stream.stDev(), list.stDev(), 0.000001 ) );
+  QCOMPARE( stream.median(), list.median() );
+  QCOMPARE( stream.firstQuartile(), list.firstQuartile() );
+  QCOMPARE( stream.thirdQuartile(), list.thirdQuartile() );
+  QCOMPARE( stream.variety(), 13 );
+  QCOMPARE( stream.majority(), 7.0 );
+}
+
+void TestQgsStatisticSummary::merge()
+{
+  QList<double> first;
+  first << 4 << 2 << 3 << 2;
+  QList<double> second;
+  second << 5 << 8 << 9;
+
+  QgsStatisticalSummary whole( QgsStatisticalSummary::All );
+  whole.calculate( first + second );
+
+  QgsStatisticalSummary a( QgsStatisticalSummary::All );
+  a.addValues( first );
+  QgsStatisticalSummary b( QgsStatisticalSummary::All );
+  b.addValues( second );
+  a.merge( b );
+  a.finalize();
+
+  QCOMPARE( a.count(), 7 );
+  QCOMPARE( a.sum(), whole.sum() );
+  QVERIFY( qgsDoubleNear( a.mean(), whole.mean(), 0.000001 ) );
+  QVERIFY( qgsDoubleNear( a.stDev(), whole.stDev(), 0.000001 ) );
+  QVERIFY( qgsDoubleNear( a.sampleStDev(), whole.sampleStDev(), 0.000001 ) );
+  QCOMPARE( a.min(), 2.0 );
+  QCOMPARE( a.max(), 9.0 );
+  QCOMPARE( a.median(), 4.0 );
+  QCOMPARE( a.variety(), 6 );
+  QCOMPARE( a.majority(), 2.0 );
+
+  // merging into an empty summary
+  QgsStatisticalSummary empty( QgsStatisticalSummary::All );
+  empty.merge( b );
+  empty.finalize();
+  QCOMPARE( empty.count(), 3 );
+  QCOMPARE( empty.median(), 8.0 );
+}
+
+void TestQgsStatisticSummary::approximate()
+{
+  QgsStatisticalSummary s( QgsStatisticalSummary::All );
+  s.setExact( false );
+  s.setRelativeError( 0.01 );
+
+  QgsStatisticalSummary part( QgsStatisticalSummary::All );
+  part.setExact( false );
+  part.setRelativeError( 0.01 );
+
+  // 20000 distinct values from -5000 to 14999, half of them in a second summary
+  for ( int i = 0; i < 20000; ++i )
+  {
+    if ( i % 2 == 0 )
+      s.addValue( i - 5000 );
+    else
+      part.addValue( i - 5000 );
+  }
+  s.merge( part );
+  s.finalize();
+
+  QCOMPARE( s.count(), 20000 );
+  QCOMPARE( s.min(), -5000.0 );
+  QCOMPARE( s.max(), 14999.0 );
+  QVERIFY( qgsDoubleNear( s.mean(), 4999.5, 0.000001 ) );
+  QVERIFY( qgsDoubleNear( s.median(), 5000, 5000 * 0.01 ) );
+  QVERIFY( qgsDoubleNear( s.firstQuartile(), 0, 2 ) );
+  QVERIFY( qgsDoubleNear( s.thirdQuartile(), 10000, 10000 * 0.01 ) );
+  QVERIFY( qAbs( s.variety() - 20000 ) < 20000 * 0.03 );
+}
+
 QTEST_MAIN( TestQgsStatisticSummary )
 #include "testqgsstatisticalsummary.moc"
@@ -0,0 +1,147 @@
+/***************************************************************************
+     testqgstwkbreader.cpp
+     ---------------------
+    Date                 : October 2015
+    Copyright            : (C) 2015 by the QGIS project
+ ***************************************************************************
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ ***************************************************************************/
+#include <QtTest/QtTest>
+#include <QObject>
+#include <QString>
+
+#include "qgsgeometry.h"
+#include "qgstwkbreader.h"
+
+class TestQgsTwkbReader: public QObject
+{
+    Q_OBJECT
+
+  private slots:
+    void initTestCase();// will be called before the first testfunction is executed.
+    void cleanupTestCase();// will be called after the last testfunction was executed.
+    void init();// will be called before each testfunction is executed.
+    void cleanup();// will be called after every testfunction.
+    void point();
+    void lineString();
+    void polygon();
+    void multiPointZ();
+    void multiLineString();
+    void empty();
+    void malformed();
+    void reuseBuffer();
+
+  private:
+    //! decodes a TWKB given as hex string and returns its WKT
+    QString wkt( const char* hex );
+};
+
+void TestQgsTwkbReader::initTestCase()
+{
+}
+
+void TestQgsTwkbReader::cleanupTestCase()
+{
+}
+
+void TestQgsTwkbReader::init()
+{
+}
+
+void TestQgsTwkbReader::cleanup()
+{
+}
+
+QString TestQgsTwkbReader::wkt( const char* hex )
+{
+  QByteArray twkb = QByteArray::fromHex( hex );
+  QByteArray buffer;
+  int size = QgsTwkbReader::toWkb( reinterpret_cast<const unsigned char*>( twkb.constData() ), twkb.size(), buffer );
+  if ( size < 0 )
+    return "invalid";
+
+  unsigned char* wkb = new unsigned char[size];
+  memcpy( wkb, buffer.constData(), size );
+  QgsGeometry geom;
+  geom.fromWkb( wkb, size );
+  return geom.exportToWkt();
+}
+
+void TestQgsTwkbReader::point()
+{
+  // ST_AsTWKB('POINT(1 2)')
+  QCOMPARE( wkt( "01000204" ), QString( "Point (1 2)" ) );
+  // precision 1: POINT(1.5 -2.5)
+  QCOMPARE( wkt( "21001e31" ), QString( "Point (1.5 -2.5)" ) );
+  // precision -1 (zig-zag encoded 1): POINT(20 -30)
+  QCOMPARE( wkt( "11000405" ), QString( "Point (20 -30)" ) );
+}
+
+void TestQgsTwkbReader::lineString()
+{
+  // ST_AsTWKB('LINESTRING(1 1,5 5)')
+  QCOMPARE( wkt( "02000202020808" ), QString( "LineString (1 1, 5 5)" ) );
+  // with size and bounding box: LINESTRING(1 1,5 5)
+  QCOMPARE( wkt( "020309020802080202020808" ), QString( "LineString (1 1, 5 5)" ) );
+}
+
+void TestQgsTwkbReader::polygon()
+{
+  // POLYGON((0 0,1 0,1 1,0 1,0 0)), the deltas continue over the points
+  QCOMPARE( wkt( "0300010500000200000201000001" ), QString( "Polygon ((0 0, 1 0, 1 1, 0 1, 0 0))" ) );
+}
+
+void TestQgsTwkbReader::multiPointZ()
+{
+  // MULTIPOINT Z (1 2 3,4 5 6), the second point is a delta of the first one
+  QCOMPARE( wkt( "04080102020406060606" ), QString( "MultiPointZ ((1 2 3),(4 5 6))" ) );
+}
+
+void TestQgsTwkbReader::multiLineString()
+{
+  // MULTILINESTRING((0 0,1 1),(2 2,3 3)) with id list (ids 1 and 2)
+  QCOMPARE( wkt( "050402020402000002020202020202" ), QString( "MultiLineString ((0 0, 1 1),(2 2, 3 3))" ) );
+}
+
+void TestQgsTwkbReader::empty()
+{
+  // empty geometries have no coordinates
+  QCOMPARE( wkt( "0210" ), QString( "LineString ()" ) );
+}
+
+void TestQgsTwkbReader::malformed()
+{
+  // truncated
+  QCOMPARE( wkt( "020002020208" ), QString( "invalid" ) );
+  // unknown type
+  QCOMPARE( wkt( "0900" ), QString( "invalid" ) );
+  // more points than bytes
+  QCOMPARE( wkt( "0200ff0102" ), QString( "invalid" ) );
+
+  QByteArray buffer;
+  QCOMPARE( QgsTwkbReader::toWkb( 0, 0, buffer ), -1 );
+}
+
+void TestQgsTwkbReader::reuseBuffer()
+{
+  QByteArray line = QByteArray::fromHex( "02000202020808" );
+  QByteArray point = QByteArray::fromHex( "01000204" );
+
+  QByteArray buffer;
+  int lineSize = QgsTwkbReader::toWkb( reinterpret_cast<const unsigned char*>( line.constData() ), line.size(), buffer );
+  QCOMPARE( lineSize, 1 + 4 + 4 + 2 * 2 * 8 );
+  int capacity = buffer.size();
+
+  // a smaller geometry is written to the start of the buffer, which is not shrunk
+  int pointSize = QgsTwkbReader::toWkb( reinterpret_cast<const unsigned char*>( point.constData() ), point.size(), buffer );
+  QCOMPARE( pointSize, 1 + 4 + 2 * 8 );
+  QCOMPARE( buffer.size(), capacity );
+}
+
+QTEST_MAIN( TestQgsTwkbReader )
+#include "testqgstwkbreader.moc"
@@ -51,6 +51,10 @@ class TestVectorLayerCache : public QObject
     void testCacheAttrActions(); // Test attribute add/ attribute delete
     void testFeatureActions();   // Test adding/removing features works
     void testSubsetRequest();
+    void testMemoryLimit();      // Test the cache stays within a memory limit and returns the same features
+    void testLazyGeometry();
+    void testMemoryCost();       // Test changed features are accounted for with their new size
+    void testPrefetch();
 
     void onCommittedFeaturesAdded( const QString&, const QgsFeatureList& );
 
@@ -218,6 +222,125 @@ void TestVectorLayerCache::testSubsetRequest()
   QVERIFY( a == f.attribute( 3 ) );
 }
 
+void TestVectorLayerCache::testMemoryLimit()
+{
+  mVectorLayerCache->setCacheMemoryLimit( 2000 );
+  QCOMPARE( mVectorLayerCache->cacheMemoryLimit(), ( qint64 )2000 );
+
+  QgsFeature f;
+  QgsFeatureIterator it = mVectorLayerCache->getFeatures( QgsFeatureRequest().setFlags( QgsFeatureRequest::NoGeometry ) );
+  int i = 0;
+  while ( it.nextFeature( f ) )
+  {
+    i++;
+  }
+  it.close();
+
+  QCOMPARE( i, 17 );
+  QVERIFY( mVectorLayerCache->cacheMemoryUsed() > 0 );
+  QVERIFY( mVectorLayerCache->cacheMemoryUsed() <= 2000 );
+  QVERIFY( mVectorLayerCache->cacheSize() < 17 );
+
+  // the cached features are the same as those of the layer
+  QgsFeatureIterator layerIt = mPointsLayer->getFeatures( QgsFeatureRequest().setFlags( QgsFeatureRequest::NoGeometry ) );
+  QgsFeature lf;
+  while ( layerIt.nextFeature( lf ) )
+  {
+    if ( !mVectorLayerCache->isFidCached( lf.id() ) )
+      continue;
+
+    QVERIFY( mVectorLayerCache->featureAtId( lf.id(), f ) );
+    QCOMPARE( f.attributes(), lf.attributes() );
+  }
+
+  // back to a limit on the number of features
+  mVectorLayerCache->setCacheSize( 10 );
+  QVERIFY( mVectorLayerCache->cacheMemoryLimit() < 0 );
+  QCOMPARE( mVectorLayerCache->cacheSize(), 10 );
+}
+
+void TestVectorLayerCache::testLazyGeometry()
+{
+  QgsFeature f;
+  QgsFeatureIterator it = mVectorLayerCache->getFeatures( QgsFeatureRequest().setFilterFid( 3 ).setFlags( QgsFeatureRequest::NoGeometry ) );
+  QVERIFY( it.nextFeature( f ) );
+  it.close();
+  QVERIFY( mVectorLayerCache->isFidCached( 3 ) );
+
+  // the geometry is loaded once it is needed
+  QgsFeature lf;
+  mPointsLayer->getFeatures( QgsFeatureRequest().setFilterFid( 3 ) ).nextFeature( lf );
+  QVERIFY( mVectorLayerCache->featureAtId( 3, f ) );
+  QVERIFY( f.constGeometry() );
+  QCOMPARE( f.constGeometry()->exportToWkt(), lf.constGeometry()->exportToWkt() );
+}
+
+void TestVectorLayerCache::testMemoryCost()
+{
+  mVectorLayerCache->setCacheMemoryLimit( 1000 );
+
+  // starting to edit updates the fields, which empties the cache
+  mPointsLayer->startEditing();
+
+  QgsFeature f;
+  QVERIFY( mVectorLayerCache->featureAtId( 1, f ) );
+  QVERIFY( mVectorLayerCache->featureAtId( 2, f ) );
+  qint64 used = mVectorLayerCache->cacheMemoryUsed();
+  QVERIFY( used > 0 );
+
+  // a short value keeps the feature in the cache and is accounted for
+  QVERIFY( mPointsLayer->changeAttributeValue( 2, 0, QString( 100, 'x' ) ) );
+  QVERIFY( mVectorLayerCache->isFidCached( 2 ) );
+  QVERIFY( mVectorLayerCache->cacheMemoryUsed() > used );
+
+  // the feature no longer fits in the cache once its value grows beyond the limit
+  QVERIFY( mPointsLayer->changeAttributeValue( 1, 0, QString( 2000, 'x' ) ) );
+  QVERIFY( !mVectorLayerCache->isFidCached( 1 ) );
+  QVERIFY( mVectorLayerCache->cacheMemoryUsed() <= 1000 );
+
+  mPointsLayer->rollBack();
+}
+
+void TestVectorLayerCache::testPrefetch()
+{
+  QgsFeatureIds fids;
+  fids << 1 << 2 << 3;
+
+  Q_FOREACH ( QgsFeatureId fid, fids )
+    QVERIFY( !mVectorLayerCache->isFidCached( fid ) );
+
+  mVectorLayerCache->prefetchFeatures( fids );
+  QVERIFY( mVectorLayerCache->isPrefetching() );
+  while ( mVectorLayerCache->isPrefetching() )
+    QCoreApplication::processEvents();
+
+  // the features have been cached by the prefetch, nothing else has read them
+  Q_FOREACH ( QgsFeatureId fid, fids )
+    QVERIFY( mVectorLayerCache->isFidCached( fid ) );
+
+  Q_FOREACH ( QgsFeatureId fid, fids )
+  {
+    QgsFeature f, lf;
+    mPointsLayer->getFeatures( QgsFeatureRequest().setFilterFid( fid ) ).nextFeature( lf );
+    QVERIFY( mVectorLayerCache->featureAtId( fid, f ) );
+    QCOMPARE( f.attributes(), lf.attributes() );
+  }
+
+  // features prefetched while the layer changes are dropped
+  fids.clear();
+  fids << 4 << 5;
+  mPointsLayer->startEditing();
+  mVectorLayerCache->prefetchFeatures( fids );
+  QVERIFY( mVectorLayerCache->isPrefetching() );
+  QVERIFY( mPointsLayer->changeAttributeValue( 6, 0, "changed" ) );
+  while ( mVectorLayerCache->isPrefetching() )
+    QCoreApplication::processEvents();
+  mPointsLayer->rollBack();
+
+  Q_FOREACH ( QgsFeatureId fid, fids )
+    QVERIFY( !mVectorLayerCache->isFidCached( fid ) );
+}
+
 void TestVectorLayerCache::onCommittedFeaturesAdded( const QString& layerId, const QgsFeatureList& features )
 {
   Q_UNUSED( layerId )
@@ -18,8 +18,8 @@ import shutil
 import glob
 
 from qgis.core import QGis, QgsField, QgsPoint, QgsVectorLayer, QgsFeatureRequest, QgsFeature, QgsProviderRegistry, \
-    QgsGeometry, NULL
-from PyQt4.QtCore import QSettings
+    QgsGeometry, QgsRectangle, NULL
+from PyQt4.QtCore import QSettings, QDate
 from utilities import (unitTestDataPath,
                        getQgisTestApp,
                        unittest,
@@ -171,6 +171,152 @@ class TestPyQgsMemoryProvider(TestCase, ProviderTestCase):
         myProvider = myMemoryLayer.dataProvider()
         assert myProvider is not None
 
+    def testEditing(self):
+        """Test the columnar storage and its spatial index through edits"""
+        layer = QgsVectorLayer('Point?field=name:string&field=count:integer&field=day:date', 'test', 'memory')
+        provider = layer.dataProvider()
+        provider.addAttributes([QgsField("big", QVariant.LongLong), QgsField("size", QVariant.Double)])
+
+        features = []
+        for i in range(3000):
+            f = QgsFeature()
+            f.setAttributes(['f%d' % i, i, QDate(2015, 1, 1).addDays(i), NULL, i * 0.5])
+            if i % 10:
+                f.setGeometry(QgsGeometry.fromPoint(QgsPoint(i % 100, i / 100)))
+            features.append(f)
+        res, features = provider.addFeatures(features)
+        assert res
+        ids = [f.id() for f in features]
+        assert provider.featureCount() == 3000
+        assert provider.extent().toString() == QgsRectangle(1, 0, 99, 29).toString(), provider.extent().toString()
+
+        f = provider.getFeatures(QgsFeatureRequest(ids[1234])).next()
+        assert f.attributes() == ['f1234', 1234, QDate(2015, 1, 1).addDays(1234), NULL, 617.0], f.attributes()
+        assert f.geometry().asPoint() == QgsPoint(34, 12)
+
+        # features without geometry are not found by a rectangle
+        rect = QgsRectangle(10.5, 9.5, 11.5, 20.5)
+        assert set(f['count'] for f in provider.getFeatures(QgsFeatureRequest(rect))) == set([1011, 1111, 1211, 1311, 1411, 1511, 1611, 1711, 1811, 1911, 2011])
+
+        # an iterator keeps the features of the time it was created
+        it = provider.getFeatures()
+
+        assert provider.changeGeometryValues({ids[1011]: QgsGeometry.fromPoint(QgsPoint(50, 50)),
+                                              ids[1010]: QgsGeometry.fromPoint(QgsPoint(11, 15))})
+        assert provider.changeAttributeValues({ids[1011]: {1: 'not a number', 3: 12345678901}})
+        assert provider.deleteFeatures(ids[2000:])
+        assert provider.featureCount() == 2000
+
+        assert len([f for f in it]) == 3000
+
+        assert set(f['count'] for f in provider.getFeatures(QgsFeatureRequest(rect))) == set([1010, 1111, 1211, 1311, 1411, 1511, 1611, 1711, 1811, 1911])
+        f = provider.getFeatures(QgsFeatureRequest(ids[1011])).next()
+        assert f['count'] == 'not a number'
+        assert f['big'] == 12345678901
+        assert f.geometry().asPoint() == QgsPoint(50, 50)
+        assert len([f for f in provider.getFeatures(QgsFeatureRequest(ids[2500]))]) == 0
+
+        # deleting most of the features compacts the storage
+        assert provider.deleteFeatures(ids[10:2000])
+        assert [f['count'] for f in provider.getFeatures()] == range(10)
+        assert [f['count'] for f in provider.getFeatures(QgsFeatureRequest(QgsRectangle(0, 0, 100, 100)))] == range(1, 10)
+
+        # new features get new ids
+        f = QgsFeature()
+        f.setAttributes(['new'])
+        res, features = provider.addFeatures([f])
+        assert features[0].id() > ids[-1]
+        assert provider.featureCount() == 11
+
+        assert provider.deleteAttributes([0, 2])
+        f = provider.getFeatures(QgsFeatureRequest(ids[5])).next()
+        assert f.attributes() == [5, NULL, 2.5], f.attributes()
+
+
+    def testValueConversion(self):
+        """Test values are only converted to the field type when nothing is lost"""
+        layer = QgsVectorLayer('None?field=count:integer&field=day:date&field=size:double', 'test', 'memory')
+        provider = layer.dataProvider()
+        provider.addAttributes([QgsField("big", QVariant.LongLong)])
+
+        values = [[12, QDate(2015, 10, 1), 0.5, 5000000000],
+                  [12.0, '2015-10-01', 1, 12.0],
+                  ['12', NULL, '0.25', '5000000000'],
+                  [3.7, 'not a date', 9007199254740993, 2.5],
+                  [5000000000, '2015-13-01', 'small', 1e19]]
+        features = []
+        for attributes in values:
+            f = QgsFeature()
+            f.setAttributes(attributes)
+            features.append(f)
+        res, features = provider.addFeatures(features)
+        assert res
+
+        found = [f.attributes() for f in provider.getFeatures()]
+        assert found[0] == [12, QDate(2015, 10, 1), 0.5, 5000000000], found[0]
+        assert found[1] == [12, QDate(2015, 10, 1), 1.0, 12], found[1]
+        assert found[2] == [12, NULL, 0.25, 5000000000], found[2]
+        # values which would be rounded or truncated are kept as they are
+        assert found[3] == [3.7, 'not a date', 9007199254740993, 2.5], found[3]
+        assert found[4] == [5000000000, '2015-13-01', 'small', 1e19], found[4]
+
+        # changed values as well
+        assert provider.changeAttributeValues({features[0].id(): {0: 2.5}, features[3].id(): {0: 4.0}})
+        found = [f.attributes() for f in provider.getFeatures()]
+        assert found[0][0] == 2.5, found[0]
+        assert found[3][0] == 4, found[3]
+
+    def testFilterFidAndRect(self):
+        """Test a feature id request with a rectangle only returns the feature within the rectangle"""
+        layer = QgsVectorLayer('Point?field=name:string', 'test', 'memory')
+        provider = layer.dataProvider()
+        features = []
+        for i in range(10):
+            f = QgsFeature()
+            f.setAttributes(['f%d' % i])
+            if i != 5:
+                f.setGeometry(QgsGeometry.fromPoint(QgsPoint(i, i)))
+            features.append(f)
+        res, features = provider.addFeatures(features)
+        assert res
+
+        def names(fid, rect):
+            request = QgsFeatureRequest(fid).setFilterRect(rect)
+            return [f['name'] for f in provider.getFeatures(request)]
+
+        assert names(features[2].id(), QgsRectangle(1.5, 1.5, 3.5, 3.5)) == ['f2']
+        assert names(features[7].id(), QgsRectangle(1.5, 1.5, 3.5, 3.5)) == []
+        # a feature without geometry is not within any rectangle
+        assert names(features[5].id(), QgsRectangle(-100, -100, 100, 100)) == []
+        assert names(features[5].id(), QgsRectangle()) == ['f5']
+
+    def testCreateSpatialIndex(self):
+        """Test creating the spatial index covers features added since it was built"""
+        layer = QgsVectorLayer('Point?field=count:integer', 'test', 'memory')
+        provider = layer.dataProvider()
+        assert provider.capabilities() & provider.CreateSpatialIndex
+
+        def addPoints(first, count):
+            features = []
+            for i in range(first, first + count):
+                f = QgsFeature()
+                f.setAttributes([i])
+                f.setGeometry(QgsGeometry.fromPoint(QgsPoint(i % 100, i / 100)))
+                features.append(f)
+            res, features = provider.addFeatures(features)
+            assert res
+
+        addPoints(0, 2000)
+        # fewer features than rebuild the index on their own
+        addPoints(2000, 100)
+        rect = QgsRectangle(9.5, 18.5, 10.5, 20.5)
+        expected = set([1910, 2010])
+        assert set(f['count'] for f in provider.getFeatures(QgsFeatureRequest(rect))) == expected
+
+        assert provider.createSpatialIndex()
+        assert set(f['count'] for f in provider.getFeatures(QgsFeatureRequest(rect))) == expected
+        assert provider.featureCount() == 2100
+
 
 if __name__ == '__main__':
     unittest.main()
@@ -17,8 +17,8 @@ import os
 import sys
 from qgis.core import NULL
 
-from qgis.core import QgsVectorLayer, QgsFeatureRequest, QgsFeature, QgsProviderRegistry
-from PyQt4.QtCore import QSettings
+from qgis.core import QgsVectorLayer, QgsFeatureRequest, QgsFeature, QgsGeometry, QgsPoint, QgsRectangle, QgsProviderRegistry
+from PyQt4.QtCore import QSettings, QDate
 from utilities import (unitTestDataPath,
                        getQgisTestApp,
                        unittest,
@@ -48,10 +48,10 @@ class TestPyQgsPostgresProvider(TestCase, ProviderTestCase):
         """Run after all tests"""
 
     def enableCompiler(self):
-        QSettings().setValue(u'/qgis/postgres/compileExpressions', True)
+        QSettings().setValue(u'/qgis/compileExpressions', True)
 
     def disableCompiler(self):
-        QSettings().setValue(u'/qgis/postgres/compileExpressions', False)
+        QSettings().setValue(u'/qgis/compileExpressions', False)
 
 # HERE GO THE PROVIDER SPECIFIC TESTS
     def testDefaultValue(self):
@@ -85,5 +85,157 @@ class TestPyQgsPostgresProvider(TestCase, ProviderTestCase):
         test_table(self.dbconn, 'mls2d', 'MultiLineString ((0 0, 1 1),(2 2, 3 3))')
         test_table(self.dbconn, 'mls3d', 'MultiLineStringZ ((0 0 0, 1 1 1),(2 2 2, 3 3 3))')
 
+    def testCopyFeatures(self):
+        """ larger lists of features are added with COPY """
+        vl = QgsVectorLayer(self.dbconn + ' sslmode=disable key=\'pk\' srid=4326 type=MULTIPOINT table="qgis_test"."bulk_load" (geom) sql=', 'bulk', 'postgres')
+        assert(vl.isValid())
+        provider = vl.dataProvider()
+
+        features = []
+        for i in range(100):
+            f = QgsFeature(provider.fields())
+            # pk and name from their defaults
+            f.setAttributes([NULL, NULL if i % 2 else 'name %d' % i, i * 0.5, QDate(2015, 10, 1 + i % 28)])
+            f.setGeometry(QgsGeometry.fromPoint(QgsPoint(i, -i)))
+            features.append(f)
+
+        res, features = provider.addFeatures(features)
+        assert res
+
+        ids = [f.id() for f in features]
+        assert len(set(ids)) == 100
+        for f in features:
+            assert f.id() == f['pk']
+
+        for f in features:
+            g = vl.getFeatures(QgsFeatureRequest(f.id())).next()
+            i = int(g['value'] * 2)
+            assert g['name'] == ('qgis' if i % 2 else 'name %d' % i), g['name']
+            assert g['day'] == QDate(2015, 10, 1 + i % 28)
+            assert g.geometry().exportToWkt() == 'MultiPoint ((%d %d))' % (i, -i), g.geometry().exportToWkt()
+
+        assert provider.deleteFeatures(ids)
+
+    def testCopySmallintRange(self):
+        """ smallint values out of range are rejected rather than truncated """
+        vl = QgsVectorLayer(self.dbconn + ' sslmode=disable key=\'pk\' srid=4326 type=MULTIPOINT table="qgis_test"."bulk_load" (geom) sql=', 'bulk', 'postgres')
+        assert(vl.isValid())
+        provider = vl.dataProvider()
+
+        def rankedFeatures(rank):
+            features = []
+            for i in range(60):
+                f = QgsFeature(provider.fields())
+                f.setAttributes([NULL, 'name %d' % i, i * 0.5, QDate(2015, 10, 1), rank])
+                f.setGeometry(QgsGeometry.fromPoint(QgsPoint(i, -i)))
+                features.append(f)
+            return features
+
+        for rank in [32768, -32769, 100000]:
+            res, features = provider.addFeatures(rankedFeatures(rank))
+            assert not res
+            assert len([f for f in provider.getFeatures()]) == 0
+
+        res, features = provider.addFeatures(rankedFeatures(-32768))
+        assert res
+        ids = [f.id() for f in features]
+        assert set(f['rank'] for f in provider.getFeatures()) == set([-32768])
+
+        assert provider.deleteFeatures(ids)
+
+    def testBinaryDateTimes(self):
+        """ timestamps and times decoded from their binary representation match their text """
+        vl = QgsVectorLayer(self.dbconn + ' sslmode=disable key=\'pk\' table="qgis_test"."date_times" sql=', 'date_times', 'postgres')
+        assert(vl.isValid())
+
+        def values():
+            return dict((f['pk'], f.attributes()) for f in vl.getFeatures())
+
+        settings = QSettings()
+        settings.setValue(u'/qgis/postgres/binaryAttributes', False)
+        try:
+            expected = values()
+        finally:
+            settings.remove(u'/qgis/postgres/binaryAttributes')
+
+        assert len(expected) == 7
+        assert expected[1][1] == '2015-10-01 12:34:56', expected[1]
+        assert expected[3][1] == '0044-03-15 10:00:00 BC', expected[3]
+        assert expected[3][3] == '24:00:00', expected[3]
+        assert values() == expected, values()
+
+    def testParallelScan(self):
+        """ features read over several connections are the same as those of a single cursor """
+        def features(request):
+            return dict((f.id(), (f.attributes(), f.geometry().exportToWkt() if f.geometry() else None)) for f in self.provider.getFeatures(request))
+
+        for request in [QgsFeatureRequest(),
+                        QgsFeatureRequest().setFlags(QgsFeatureRequest.NoGeometry),
+                        QgsFeatureRequest().setFilterExpression('cnt > 100'),
+                        QgsFeatureRequest().setFilterRect(QgsRectangle(-71, 66, -65, 79))]:
+            expected = features(QgsFeatureRequest(request))
+            assert expected
+
+            request.setFlags(request.flags() | QgsFeatureRequest.ParallelScan)
+            assert features(request) == expected
+
+            self.enableCompiler()
+            assert features(request) == expected
+            self.disableCompiler()
+
+        # fid filters are not split, but still honour the request
+        request = QgsFeatureRequest().setFilterFids([1, 3]).setFlags(QgsFeatureRequest.ParallelScan)
+        assert set(f.id() for f in self.provider.getFeatures(request)) == set([1, 3])
+
+    def testParallelScanPartitions(self):
+        """ a table with more rows than partitions is split and leaves a pooled connection free """
+        vl = QgsVectorLayer(self.dbconn + ' sslmode=disable key=\'pk\' srid=4326 type=MULTIPOINT table="qgis_test"."bulk_load" (geom) sql=', 'bulk', 'postgres')
+        assert(vl.isValid())
+        provider = vl.dataProvider()
+
+        features = []
+        for i in range(50):
+            f = QgsFeature(provider.fields())
+            f.setAttributes([NULL, 'name %d' % i, i * 0.5, QDate(2015, 10, 1 + i % 28)])
+            f.setGeometry(QgsGeometry.fromPoint(QgsPoint(i, -i)))
+            features.append(f)
+        res, features = provider.addFeatures(features)
+        assert res
+        ids = [f.id() for f in features]
+
+        expected = dict((f.id(), f.attributes()) for f in provider.getFeatures())
+        assert len(expected) == 50
+
+        request = QgsFeatureRequest().setFlags(QgsFeatureRequest.ParallelScan)
+        for connections in [2, 3]:
+            QSettings().setValue(u'/qgis/postgres/parallelScanConnections', connections)
+            it = provider.getFeatures(request)
+            f = QgsFeature()
+            assert it.nextFeature(f)
+            found = {f.id(): f.attributes()}
+
+            # another iterator does not wait for the connections held by the scan
+            assert len([g for g in provider.getFeatures(QgsFeatureRequest(ids[0]))]) == 1
+
+            while it.nextFeature(f):
+                assert f.id() not in found
+                found[f.id()] = f.attributes()
+            assert found == expected
+        QSettings().remove(u'/qgis/postgres/parallelScanConnections')
+
+        assert provider.deleteFeatures(ids)
+
+    def testParallelScanWideKeys(self):
+        """ keys spanning the whole integer range are split without losing features """
+        vl = QgsVectorLayer(self.dbconn + ' sslmode=disable key=\'pk\' table="qgis_test"."wide_keys" sql=', 'wide_keys', 'postgres')
+        assert(vl.isValid())
+
+        request = QgsFeatureRequest().setFlags(QgsFeatureRequest.ParallelScan)
+        for connections in [2, 3]:
+            QSettings().setValue(u'/qgis/postgres/parallelScanConnections', connections)
+            names = sorted(f['name'] for f in vl.dataProvider().getFeatures(request))
+            assert names == ['max', 'min', 'minus one', 'zero'], names
+        QSettings().remove(u'/qgis/postgres/parallelScanConnections')
+
 if __name__ == '__main__':
     unittest.main()
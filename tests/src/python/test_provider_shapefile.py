@@ -55,6 +55,12 @@ class TestPyQgsPostgresProvider(TestCase, ProviderTestCase):
         shutil.rmtree(cls.basetestpath, True)
         shutil.rmtree(cls.repackfilepath, True)
 
+    def enableCompiler(self):
+        QSettings().setValue(u'/qgis/compileExpressions', True)
+
+    def disableCompiler(self):
+        QSettings().setValue(u'/qgis/compileExpressions', False)
+
     def testRepack(self):
         vl = QgsVectorLayer(u'{}|layerid=0'.format(self.repackfile), u'test', u'ogr')
 
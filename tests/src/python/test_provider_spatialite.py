@@ -17,7 +17,8 @@ import os
 import tempfile
 import sys
 
-from qgis.core import QgsVectorLayer, QgsPoint, QgsFeature
+from qgis.core import QgsVectorLayer, QgsPoint, QgsFeature, QgsFeatureRequest, QgsRectangle
+from PyQt4.QtCore import QSettings
 
 from utilities import (unitTestDataPath,
                        getQgisTestApp,
@@ -103,6 +104,35 @@ class TestQgsSpatialiteProvider(TestCase, ProviderTestCase):
         sql += "VALUES (2, 'toto', GeomFromText('POLYGON((0 0,1 0,1 1,0 1,0 0))', 4326))"
         cur.execute(sql)
 
+        # tables with compressed and 3D geometries
+        sql = "CREATE TABLE test_compressed (id INTEGER NOT NULL PRIMARY KEY)"
+        cur.execute(sql)
+        sql = "SELECT AddGeometryColumn('test_compressed', 'geometry', 4326, 'LINESTRING', 'XY')"
+        cur.execute(sql)
+        sql = "INSERT INTO test_compressed (id, geometry) "
+        sql += "VALUES (1, CompressGeometry(GeomFromText('LINESTRING(1 2,3 4.5,5 6)', 4326)))"
+        cur.execute(sql)
+
+        sql = "CREATE TABLE test_z (id INTEGER NOT NULL PRIMARY KEY)"
+        cur.execute(sql)
+        sql = "SELECT AddGeometryColumn('test_z', 'geometry', 4326, 'POINT', 'XYZ')"
+        cur.execute(sql)
+        sql = "INSERT INTO test_z (id, geometry) "
+        sql += "VALUES (1, GeomFromText('POINTZ(1 2 3)', 4326))"
+        cur.execute(sql)
+
+        # table with many features and a spatial index
+        sql = "CREATE TABLE test_fids (id INTEGER NOT NULL PRIMARY KEY, name TEXT NOT NULL)"
+        cur.execute(sql)
+        sql = "SELECT AddGeometryColumn('test_fids', 'geometry', 4326, 'POINT', 'XY')"
+        cur.execute(sql)
+        for i in range(1, 201):
+            sql = "INSERT INTO test_fids (id, name, geometry) "
+            sql += "VALUES (%d, 'f%d', MakePoint(%d, 0, 4326))" % (i, i, i)
+            cur.execute(sql)
+        sql = "SELECT CreateSpatialIndex('test_fids', 'geometry')"
+        cur.execute(sql)
+
         cur.execute("COMMIT")
         con.close()
 
@@ -114,6 +144,12 @@ class TestQgsSpatialiteProvider(TestCase, ProviderTestCase):
         #    os.remove(cls.dbname)
         pass
 
+    def enableCompiler(self):
+        QSettings().setValue(u'/qgis/compileExpressions', True)
+
+    def disableCompiler(self):
+        QSettings().setValue(u'/qgis/compileExpressions', False)
+
     def setUp(self):
         """Run before each test."""
         pass
@@ -193,6 +229,61 @@ class TestQgsSpatialiteProvider(TestCase, ProviderTestCase):
         fields = [f.name() for f in l.dataProvider().fields()]
         assert('Geometry' not in fields)
 
+    def test_geometry_blobs(self):
+        """Test decoding of compressed and 3D geometries"""
+        l = QgsVectorLayer("dbname=%s table=test_compressed (geometry)" % self.dbname, "test_compressed", "spatialite")
+        assert(l.isValid())
+        f = next(l.getFeatures())
+        self.assertEqual(f.geometry().exportToWkt(), 'LineString (1 2, 3 4.5, 5 6)')
+
+        l = QgsVectorLayer("dbname=%s table=test_z (geometry)" % self.dbname, "test_z", "spatialite")
+        assert(l.isValid())
+        f = next(l.getFeatures())
+        self.assertEqual(f.geometry().exportToWkt(), 'PointZ (1 2 3)')
+
+    def test_bound_filters(self):
+        """Test fid and rectangle filters, which are bound to reused statements"""
+        l = QgsVectorLayer("dbname=%s table=test_fids (geometry) key='id'" % self.dbname, "test_fids", "spatialite")
+        assert(l.isValid())
+
+        # more ids than fit in one batch
+        ids = set(range(1, 200, 2))
+        fids = sorted(f.id() for f in l.getFeatures(QgsFeatureRequest().setFilterFids(ids)))
+        self.assertEqual(fids, sorted(ids))
+
+        # a few ids, fewer than the padded batch
+        fids = sorted(f.id() for f in l.getFeatures(QgsFeatureRequest().setFilterFids(set([3, 7, 11]))))
+        self.assertEqual(fids, [3, 7, 11])
+
+        for fid in (5, 17, 150):
+            f = next(l.getFeatures(QgsFeatureRequest(fid)))
+            self.assertEqual(f['name'], 'f%d' % fid)
+
+        for xmin, xmax in ((10.5, 12.5), (100.5, 103.5)):
+            request = QgsFeatureRequest().setFilterRect(QgsRectangle(xmin, -1, xmax, 1))
+            fids = sorted(f.id() for f in l.getFeatures(request))
+            self.assertEqual(fids, range(int(xmin) + 1, int(xmax) + 1))
+
+    def test_compiled_filters(self):
+        """Test spatial predicates and partially compiled expressions"""
+        l = QgsVectorLayer("dbname=%s table=test_fids (geometry) key='id'" % self.dbname, "test_fids", "spatialite")
+        assert(l.isValid())
+
+        expressions = [
+            ("intersects($geometry, geom_from_wkt('POLYGON((9.5 -1, 12.5 -1, 12.5 1, 9.5 1, 9.5 -1))'))", [10, 11, 12]),
+            ("within($geometry, geom_from_wkt('POLYGON((9.5 -1, 12.5 -1, 12.5 1, 9.5 1, 9.5 -1))')) AND id > 10", [11, 12]),
+            ("bbox($geometry, geom_from_wkt('LINESTRING(99.5 0, 101.5 0)')) AND id / 2 = 50", [100]),
+            ("name LIKE 'F19_' AND id % 2 = 0", []),
+            ("name ILIKE 'F19_' AND id % 2 = 0", [190, 192, 194, 196, 198]),
+            ("name LIKE 'f19_' OR id = 1", [1] + range(190, 200)),
+        ]
+        for compiled in (False, True):
+            QSettings().setValue(u'/qgis/compileExpressions', compiled)
+            for expression, expected in expressions:
+                fids = sorted(f.id() for f in l.getFeatures(QgsFeatureRequest().setFilterExpression(expression)))
+                self.assertEqual(fids, expected, 'Expected {} and got {} when testing expression "{}"'.format(expected, fids, expression))
+        QSettings().setValue(u'/qgis/compileExpressions', False)
+
 
 if __name__ == '__main__':
     unittest.main()
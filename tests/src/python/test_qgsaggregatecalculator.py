@@ -0,0 +1,161 @@
+# -*- coding: utf-8 -*-
+"""QGIS Unit tests for QgsAggregateCalculator.
+
+.. note:: This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+"""
+__author__ = 'QGIS project'
+__date__ = '2015-10-20'
+__copyright__ = 'Copyright 2015, The QGIS Project'
+# This will get replaced with a git SHA1 when you do a git archive
+__revision__ = '$Format:%H$'
+
+import qgis
+
+from qgis.core import QgsVectorLayer, QgsFeature, QgsAggregateCalculator
+from PyQt4.QtCore import QPyNullVariant
+from utilities import (getQgisTestApp,
+                       TestCase,
+                       unittest
+                       )
+QGISAPP, CANVAS, IFACE, PARENT = getQgisTestApp()
+
+
+class TestQgsAggregateCalculator(TestCase):
+
+    def createLayer(self):
+        layer = QgsVectorLayer('Point?field=name:string&field=value:integer&field=cls:string', 'aggregates', 'memory')
+        features = []
+        for name, value, cls in [('a', 4, 'x'), ('b', 2, 'y'), ('c', None, 'x'), ('d', 8, 'x'), ('e', 6, 'y')]:
+            feat = QgsFeature(layer.pendingFields())
+            feat['name'] = name
+            feat['value'] = value
+            feat['cls'] = cls
+            features.append(feat)
+        layer.dataProvider().addFeatures(features)
+        return layer
+
+    def testNumeric(self):
+        calculator = QgsAggregateCalculator(self.createLayer())
+        calculator.setPercentile(0.1)
+
+        expected = [(QgsAggregateCalculator.Count, 4),
+                    (QgsAggregateCalculator.CountDistinct, 4),
+                    (QgsAggregateCalculator.CountMissing, 1),
+                    (QgsAggregateCalculator.Min, 2),
+                    (QgsAggregateCalculator.Max, 8),
+                    (QgsAggregateCalculator.Sum, 20),
+                    (QgsAggregateCalculator.Mean, 5),
+                    (QgsAggregateCalculator.Median, 5),
+                    (QgsAggregateCalculator.StDev, 2.2360680),
+                    (QgsAggregateCalculator.StDevSample, 2.5819889),
+                    (QgsAggregateCalculator.Range, 6),
+                    (QgsAggregateCalculator.FirstQuartile, 3.5),
+                    (QgsAggregateCalculator.ThirdQuartile, 6.5),
+                    (QgsAggregateCalculator.InterQuartileRange, 3),
+                    (QgsAggregateCalculator.Percentile, 2.6)]
+        for aggregate, value in expected:
+            result, ok = calculator.calculate(aggregate, 'value')
+            self.assertTrue(ok)
+            self.assertAlmostEqual(float(result), value, 5, QgsAggregateCalculator.displayName(aggregate))
+
+        result, ok = calculator.calculate(QgsAggregateCalculator.Sum, '"value" * 2')
+        self.assertTrue(ok)
+        self.assertEqual(result, 40)
+
+    def testStrings(self):
+        calculator = QgsAggregateCalculator(self.createLayer())
+        calculator.setDelimiter(',')
+
+        result, ok = calculator.calculate(QgsAggregateCalculator.StringConcatenate, 'name')
+        self.assertTrue(ok)
+        self.assertEqual(result, 'a,b,c,d,e')
+
+        result, ok = calculator.calculate(QgsAggregateCalculator.Max, 'name')
+        self.assertTrue(ok)
+        self.assertEqual(result, 'e')
+
+        result, ok = calculator.calculate(QgsAggregateCalculator.CountDistinct, 'cls')
+        self.assertTrue(ok)
+        self.assertEqual(result, 2)
+
+        # numeric aggregates of strings fail
+        result, ok = calculator.calculate(QgsAggregateCalculator.Sum, 'name')
+        self.assertFalse(ok)
+
+    def testInvalidExpression(self):
+        calculator = QgsAggregateCalculator(self.createLayer())
+        result, ok = calculator.calculate(QgsAggregateCalculator.Sum, '"value" +')
+        self.assertFalse(ok)
+
+    def testFilters(self):
+        layer = self.createLayer()
+        calculator = QgsAggregateCalculator(layer)
+
+        calculator.setFilter('"value" > 3')
+        result, ok = calculator.calculate(QgsAggregateCalculator.Count, 'value')
+        self.assertTrue(ok)
+        self.assertEqual(result, 3)
+
+        # aggregates of no values
+        calculator.setFilter('"value" > 100')
+        result, ok = calculator.calculate(QgsAggregateCalculator.Count, 'value')
+        self.assertTrue(ok)
+        self.assertEqual(result, 0)
+        result, ok = calculator.calculate(QgsAggregateCalculator.Sum, 'value')
+        self.assertTrue(ok)
+        self.assertTrue(isinstance(result, QPyNullVariant))
+
+        calculator.setFilter('')
+        ids = [f.id() for f in layer.getFeatures() if f['name'] in ('a', 'b')]
+        calculator.setFidsFilter(set(ids))
+        result, ok = calculator.calculate(QgsAggregateCalculator.Sum, 'value')
+        self.assertTrue(ok)
+        self.assertEqual(result, 6)
+
+    def testGrouped(self):
+        calculator = QgsAggregateCalculator(self.createLayer())
+
+        results, ok = calculator.calculateGrouped(QgsAggregateCalculator.Sum, 'value', 'cls')
+        self.assertTrue(ok)
+        self.assertEqual([(r.group, r.values) for r in results], [('x', [12]), ('y', [8])])
+
+        results, ok = calculator.calculateGrouped(QgsAggregateCalculator.Count, 'name', '"value" > 4')
+        self.assertTrue(ok)
+        self.assertEqual([r.values[0] for r in results], [1, 2, 2])
+        self.assertTrue(isinstance(results[0].group, QPyNullVariant))
+
+    def testProviderMinMax(self):
+        # min and max of plain fields are answered by the provider
+        calculator = QgsAggregateCalculator(self.createLayer())
+        result, ok = calculator.calculate(QgsAggregateCalculator.Min, 'value')
+        self.assertTrue(ok)
+        self.assertEqual(result, 2)
+        result, ok = calculator.calculate(QgsAggregateCalculator.Max, 'value')
+        self.assertTrue(ok)
+        self.assertEqual(result, 8)
+
+        # a layer without values has no extremes
+        empty = QgsVectorLayer('Point?field=value:integer', 'empty', 'memory')
+        result, ok = QgsAggregateCalculator(empty).calculate(QgsAggregateCalculator.Min, 'value')
+        self.assertTrue(ok)
+        self.assertTrue(isinstance(result, QPyNullVariant))
+
+    def testEditBuffer(self):
+        layer = self.createLayer()
+        calculator = QgsAggregateCalculator(layer)
+
+        layer.startEditing()
+        feat = QgsFeature(layer.pendingFields())
+        feat['value'] = 10
+        layer.addFeature(feat)
+
+        result, ok = calculator.calculate(QgsAggregateCalculator.Max, 'value')
+        self.assertTrue(ok)
+        self.assertEqual(result, 10)
+        layer.rollBack()
+
+if __name__ == '__main__':
+    unittest.main()
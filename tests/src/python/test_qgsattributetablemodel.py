@@ -12,6 +12,8 @@ __copyright__ = 'Copyright 2015, The QGIS Project'
 # This will get replaced with a git SHA1 when you do a git archive
 __revision__ = '$Format:%H$'
 
+from PyQt4.QtCore import QModelIndex
+
 from qgis.gui import QgsAttributeTableModel, QgsEditorWidgetRegistry
 from qgis.core import QgsFeature, QgsGeometry, QgsPoint, QgsVectorLayer, QgsVectorLayerCache, NULL
 
@@ -84,5 +86,38 @@ class TestQgsAttributeTableModel(TestCase):
 
         assert self.am.columnCount() == 1, self.am.columnCount()
 
+    def testFetchRowsOnDemand(self):
+        layer = QgsVectorLayer("Point?field=fldint:integer", "ondemand", "memory")
+        features = list()
+        for i in range(2500):
+            f = QgsFeature()
+            f.setAttributes([i])
+            f.setGeometry(QgsGeometry.fromPoint(QgsPoint(i, i)))
+            features.append(f)
+        assert layer.dataProvider().addFeatures(features)
+
+        cache = QgsVectorLayerCache(layer, 100)
+        am = QgsAttributeTableModel(cache)
+        am.setFetchRowsOnDemand(True)
+        am.loadLayer()
+
+        # only the first batch of rows is loaded, the total comes from the layer
+        self.assertEqual(am.rowCount(), 1000)
+        self.assertEqual(am.totalRowCount(), 2500)
+        self.assertTrue(am.canFetchMore(QModelIndex()))
+
+        am.fetchMore(QModelIndex())
+        self.assertEqual(am.rowCount(), 2000)
+
+        # a feature deleted before its row is fetched is not shown
+        assert layer.startEditing()
+        assert layer.deleteFeature(am.rowToId(1999) + 100)
+        am.fetchAllRows()
+        self.assertEqual(am.rowCount(), 2499)
+        self.assertFalse(am.canFetchMore(QModelIndex()))
+        self.assertEqual(len(set([am.rowToId(i) for i in range(am.rowCount())])), 2499)
+
+        assert layer.rollBack()
+
 if __name__ == '__main__':
     unittest.main()
@@ -27,6 +27,7 @@ import qgis
 
 import os
 import re
+import shutil
 import tempfile
 import inspect
 import time
@@ -36,7 +37,8 @@ rebuildTests = 'REBUILD_DELIMITED_TEXT_TESTS' in os.environ
 
 from PyQt4.QtCore import (QCoreApplication,
                           QUrl,
-                          QObject
+                          QObject,
+                          QSettings
                           )
 
 from qgis.core import (QgsProviderRegistry,
@@ -312,6 +314,28 @@ def runTest(file, requests, **params):
     assert len(failures) == 0, "\n".join(failures)
 
 
+def createTempFile(text):
+    # Write a data file for a test, returns its name
+    (filehandle, filename) = tempfile.mkstemp(suffix='.csv')
+    if os.name == "nt":
+        filename = filename.replace("\\", "/")
+    with os.fdopen(filehandle, "w") as f:
+        f.write(text)
+    return filename
+
+
+def delimitedTextLayer(filename, **params):
+    # Create a layer for a data file.  Watched files are read through a stream
+    # rather than memory mapped
+    url = QUrl.fromLocalFile(filename)
+    url.addQueryItem('type', 'csv')
+    for k in params.keys():
+        url.addQueryItem(k, params[k])
+    layer = QgsVectorLayer(url.toString(), u'test', u'delimitedtext')
+    assert layer.isValid(), "{} is invalid".format(filename)
+    return layer
+
+
 class TestQgsDelimitedTextProviderXY(TestCase, ProviderTestCase):
 
     @classmethod
@@ -728,5 +752,188 @@ class TestQgsDelimitedTextProviderOther(TestCase):
         requests = None
         runTest(filename, requests, **params)
 
+    def test_039_index_file(self):
+        # Scan results are reused from the index file until the file changes.
+        # The index files are written to a temporary cache directory
+        settings = QSettings()
+        cacheDirectory = settings.value('cache/directory')
+        cacheSize = settings.value('cache/delimitedTextSize')
+        tmpCache = tempfile.mkdtemp()
+        settings.setValue('cache/directory', tmpCache)
+        indexDirectory = os.path.join(tmpCache, 'delimitedtext')
+
+        def restoreSetting(key, value):
+            if value is None:
+                settings.remove(key)
+            else:
+                settings.setValue(key, value)
+
+        filename = createTempFile("id,x,y,name\n1,10,20,rabbit\n2,30,40,pooh\n\n3,50,60,tigger\n")
+        try:
+            def layerSummary(spatialIndex='yes'):
+                layer = delimitedTextLayer(filename, xField='x', yField='y', spatialIndex=spatialIndex, watchFile='no')
+                request = QgsFeatureRequest().setFilterRect(QgsRectangle(25, 35, 95, 65))
+                return (layer.featureCount(),
+                        layer.extent().toString(),
+                        [field.typeName() for field in layer.pendingFields()],
+                        sorted([f.id() for f in layer.getFeatures(request)]),
+                        [f['name'] for f in layer.getFeatures(QgsFeatureRequest(5))])
+
+            scanned = layerSummary()
+            self.assertEqual(scanned[0], 3)
+            self.assertEqual(scanned[2], ['integer', 'integer', 'integer', 'text'])
+            self.assertEqual(scanned[3], [3, 5])
+            self.assertEqual(scanned[4], ['tigger'])
+            self.assertEqual(len(os.listdir(indexDirectory)), 1)
+            self.assertEqual(layerSummary(), scanned)
+
+            # Changing the file without changing its size and modification time
+            # shows the results come from the index file rather than a scan
+            stat = os.stat(filename)
+            with file(filename, 'w') as f:
+                f.write("id,x,y,name\n1,10,20,rabbit\n2,30,40,pooh\n\n3,90,60,tiggex\n")
+            os.utime(filename, (stat.st_atime, stat.st_mtime))
+            cached = layerSummary()
+            self.assertEqual(cached[1], scanned[1])
+            self.assertEqual(cached[3], [3, 5])
+            self.assertEqual(cached[4], ['tiggex'])
+
+            # Another layer definition has its own index file
+            time.sleep(1)
+            other = layerSummary('no')
+            self.assertNotEqual(other[1], scanned[1])
+            self.assertEqual(len(os.listdir(indexDirectory)), 2)
+
+            time.sleep(1)
+            with file(filename, 'w') as f:
+                f.write("id,x,y,name\n1,10.5,20,rabbit\n2,30,40,pooh\n")
+            rescanned = layerSummary()
+            self.assertEqual(rescanned[0], 2)
+            self.assertEqual(rescanned[2], ['integer', 'double', 'integer', 'text'])
+            self.assertEqual(rescanned[3], [3])
+
+            # The least recently written index files are removed to fit in the cache
+            newest = max([os.path.join(indexDirectory, f) for f in os.listdir(indexDirectory)], key=os.path.getmtime)
+            settings.setValue('cache/delimitedTextSize', os.path.getsize(newest))
+            time.sleep(1)
+            layerSummary('no')
+            self.assertEqual(len(os.listdir(indexDirectory)), 1)
+
+            # A cache size of 0 disables the index files
+            settings.setValue('cache/delimitedTextSize', 0)
+            layerSummary()
+            self.assertEqual(len(os.listdir(indexDirectory)), 1)
+        finally:
+            restoreSetting('cache/directory', cacheDirectory)
+            restoreSetting('cache/delimitedTextSize', cacheSize)
+            shutil.rmtree(tmpCache, True)
+            os.remove(filename)
+
+    def test_040_chunked_scan(self):
+        # A file spanning several scan chunks gives the same layer as reading
+        # it through a stream
+        rows = 200000
+        lines = ['id,x,y,name,value']
+        for i in range(rows):
+            lines.append('{0},{1},{2},record {0:06d} of the chunked scan,{3}'.format(i, i % 360 - 180, i % 170 - 85, i * 0.25))
+        filename = createTempFile('\n'.join(lines) + '\n')
+        assert os.path.getsize(filename) > 3 * 4 * 1024 * 1024
+
+        mapped = delimitedTextLayer(filename, xField='x', yField='y')
+        streamed = delimitedTextLayer(filename, xField='x', yField='y', watchFile='yes')
+        self.assertEqual(mapped.featureCount(), rows)
+        self.assertEqual(streamed.featureCount(), rows)
+        self.assertEqual(mapped.extent().toString(), streamed.extent().toString())
+        self.assertEqual([field.typeName() for field in mapped.pendingFields()],
+                         [field.typeName() for field in streamed.pendingFields()])
+
+        # The feature ids are the line numbers
+        for fid in [rows + 1, 2, rows / 2, 257, 258, 1000, 513]:
+            f = mapped.getFeatures(QgsFeatureRequest(fid)).next()
+            g = streamed.getFeatures(QgsFeatureRequest(fid)).next()
+            self.assertEqual(f['id'], fid - 2)
+            self.assertEqual(f.attributes(), g.attributes())
+            self.assertEqual(f.geometry().exportToWkt(), g.geometry().exportToWkt())
+
+        request = QgsFeatureRequest().setFilterRect(QgsRectangle(-10, -10, 10, 10))
+        self.assertEqual(sorted([f.id() for f in mapped.getFeatures(request)]),
+                         sorted([f.id() for f in streamed.getFeatures(request)]))
+
+        del mapped
+        del streamed
+        os.remove(filename)
+
+    def test_041_quoted_newlines_across_chunks(self):
+        # A quoted field with new lines crossing the scan chunks makes the
+        # file scanned sequentially
+        lines = 800000
+        text = 'id,description\n1,"' + 'quoted line\n' * lines + '"\n2,second\n3,"with, comma"\n'
+        filename = createTempFile(text)
+        assert os.path.getsize(filename) > 2 * 4 * 1024 * 1024
+
+        for layer in [delimitedTextLayer(filename, geomType='none'),
+                      delimitedTextLayer(filename, geomType='none', watchFile='yes')]:
+            self.assertEqual(layer.featureCount(), 3)
+            features = [f for f in layer.getFeatures()]
+            self.assertEqual([f.id() for f in features], [2, lines + 3, lines + 4])
+            self.assertEqual([f['id'] for f in features], [1, 2, 3])
+            self.assertEqual(len(features[0]['description']), len('quoted line\n') * lines)
+            self.assertEqual(features[2]['description'], 'with, comma')
+            f = layer.getFeatures(QgsFeatureRequest(lines + 3)).next()
+            self.assertEqual(f['description'], 'second')
+
+        os.remove(filename)
+
+    def test_042_line_index(self):
+        # Features are read by id from the line index, backwards and forwards
+        rows = 3000
+        filename = createTempFile('id,name\n' + ''.join(['{0},name {0}\n'.format(i) for i in range(rows)]))
+        layer = delimitedTextLayer(filename, geomType='none')
+        self.assertEqual(layer.featureCount(), rows)
+
+        for fid in [2900, 10, 1500, 1501, 1499, 300, 257, 256, 258, rows + 1, 2, 1024]:
+            f = layer.getFeatures(QgsFeatureRequest(fid)).next()
+            self.assertEqual(f.id(), fid)
+            self.assertEqual(f['id'], fid - 2)
+            self.assertEqual(f['name'], 'name {0}'.format(fid - 2))
+
+        self.assertEqual([f['id'] for f in layer.getFeatures()], range(rows))
+
+        # A line index of a file which has changed since is not used
+        del layer
+        with file(filename, 'w') as f:
+            f.write('id,name\n' + ''.join(['{0},other {0}\n'.format(i) for i in range(rows / 2)]))
+        layer = delimitedTextLayer(filename, geomType='none')
+        f = layer.getFeatures(QgsFeatureRequest(1000)).next()
+        self.assertEqual(f['name'], 'other 998')
+
+        del layer
+        os.remove(filename)
+
+    def test_043_plain_numbers(self):
+        # Numbers converted from the bytes of the file are the same as those
+        # converted by QString
+        ints = ['0', '-0', '7', '-2147483648', '2147483647', '0042', '1', '-1', '100', '12', '99', '3']
+        longs = ['123456789012345678', '-123456789012345678', '1234567890123456789', '-9223372036854775808',
+                 '9223372036854775807', '1', '0', '-1', '4294967296', '000000000000000000001', '55', '-55']
+        doubles = ['0.1', '-1.5e-3', '1e22', '1e23', '123456789012345.6', '0.000000000000000000001234',
+                   '1.7976931348623157e308', '12345678901234567890', '5.', '.5', '1E5', '2.5e+10']
+        lines = ['i,l,d'] + [','.join(values) for values in zip(ints, longs, doubles)]
+        filename = createTempFile('\n'.join(lines) + '\n')
+
+        mapped = delimitedTextLayer(filename, geomType='none')
+        streamed = delimitedTextLayer(filename, geomType='none', watchFile='yes')
+        self.assertEqual([field.typeName() for field in mapped.pendingFields()], ['integer', 'longlong', 'double'])
+
+        features = [f for f in mapped.getFeatures()]
+        self.assertEqual([f['i'] for f in features], [int(v) for v in ints])
+        self.assertEqual([f['l'] for f in features], [long(v) for v in longs])
+        self.assertEqual([f['d'] for f in features], [float(v) for v in doubles])
+        self.assertEqual([f.attributes() for f in features], [f.attributes() for f in streamed.getFeatures()])
+
+        del mapped
+        del streamed
+        os.remove(filename)
+
 if __name__ == '__main__':
     unittest.main()
@@ -81,6 +81,40 @@ class TestQgsFeatureIterator(TestCase):
         myMessage = '\nExpected: {0} features\nGot: {1} features'.format(repr(expectedIds), repr(ids))
         assert ids == expectedIds, myMessage
 
+    def test_OrderByAndLimit(self):
+        layer = QgsVectorLayer('Point?field=name:string&field=value:integer', 'ordered', 'memory')
+        for name, value in [('a', 3), ('b', None), ('c', 1), ('d', 2), ('e', 1)]:
+            feat = QgsFeature(layer.pendingFields())
+            feat['name'] = name
+            feat['value'] = value
+            layer.dataProvider().addFeatures([feat])
+
+        def names(request):
+            return [feat['name'] for feat in layer.getFeatures(request)]
+
+        # NULL values come last in ascending and first in descending order, ties keep the provider order
+        self.assertEqual(names(QgsFeatureRequest().addOrderBy('value')), ['c', 'e', 'd', 'a', 'b'])
+        self.assertEqual(names(QgsFeatureRequest().addOrderBy('value', False)), ['b', 'a', 'd', 'c', 'e'])
+        self.assertEqual(names(QgsFeatureRequest().addOrderBy('value', True, True)), ['b', 'c', 'e', 'd', 'a'])
+        self.assertEqual(names(QgsFeatureRequest().addOrderBy('value').addOrderBy('name', False)), ['e', 'c', 'd', 'a', 'b'])
+        self.assertEqual(names(QgsFeatureRequest().addOrderBy('"value" * -1')), ['a', 'd', 'c', 'e', 'b'])
+
+        # the limit applies after ordering and filtering
+        self.assertEqual(names(QgsFeatureRequest().setLimit(2)), ['a', 'b'])
+        self.assertEqual(names(QgsFeatureRequest().addOrderBy('value', False).setLimit(2)), ['b', 'a'])
+        self.assertEqual(names(QgsFeatureRequest().setFilterExpression('value < 3').addOrderBy('name', False).setLimit(2)), ['e', 'd'])
+        self.assertEqual(names(QgsFeatureRequest().addOrderBy('value').setLimit(0)), [])
+
+        # ordering by an attribute which is not fetched
+        request = QgsFeatureRequest().addOrderBy('value').setSubsetOfAttributes(['name'], layer.pendingFields())
+        self.assertEqual(names(request), ['c', 'e', 'd', 'a', 'b'])
+
+        # rewinding returns the same features again
+        it = layer.getFeatures(QgsFeatureRequest().addOrderBy('value').setLimit(3))
+        first = [feat['name'] for feat in it]
+        it.rewind()
+        self.assertEqual([feat['name'] for feat in it], first)
+
     def addFeatures(self, vl):
         feat = QgsFeature()
         fields = vl.pendingFields()
@@ -187,3 +187,36 @@ CREATE TABLE qgis_test.mls3d(
 );
 
 INSERT INTO qgis_test.mls3d values (1, 'srid=4326;MultiLineString((0 0 0, 1 1 1),(2 2 2, 3 3 3))'::geometry);
+
+CREATE TABLE qgis_test.bulk_load(
+       pk SERIAL PRIMARY KEY,
+       name text DEFAULT 'qgis',
+       value float8,
+       day date,
+       rank int2,
+       geom Geometry(MultiPoint,4326)
+);
+
+CREATE TABLE qgis_test.date_times(
+       pk int PRIMARY KEY,
+       stamp timestamp,
+       stamp_tz timestamptz,
+       clock time
+);
+
+INSERT INTO qgis_test.date_times values
+  (1, '2015-10-01 12:34:56', '2015-10-01 12:34:56+02', '12:34:56'),
+  (2, '1999-12-31 23:59:59.5', '1999-12-31 23:59:59.5+00', '23:59:59.123456'),
+  (3, '0044-03-15 10:00:00 BC', NULL, '24:00:00'),
+  (4, '12345-01-01 00:00:00.01', '1970-01-01 00:00:00+00', '00:00:00'),
+  (5, 'infinity', 'infinity', NULL),
+  (6, '-infinity', '-infinity', '00:00:00.000001'),
+  (7, NULL, NULL, NULL);
+
+CREATE TABLE qgis_test.wide_keys(
+       pk int PRIMARY KEY,
+       name text
+);
+
+INSERT INTO qgis_test.wide_keys values
+  (-2147483648, 'min'), (-1, 'minus one'), (0, 'zero'), (2147483647, 'max');